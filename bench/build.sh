@@ -0,0 +1,43 @@
+#!/bin/bash -eu
+
+# Micro-benchmarks for some of the hot paths in the core: they're linked
+# against the objects of an already configured and built tree (so run
+# ./configure and make first), and then run with no arguments, e.g.:
+#
+#	./bench/build.sh && ./bench/out/twcc_bench
+#
+# Most benchmarks accept the number of iterations as their only argument.
+
+SCRIPTPATH="$( cd "$(dirname "$0")" ; pwd -P )"
+JANUSSRC="$(dirname $SCRIPTPATH)/src"
+
+# Set working paths and compiler from the environment
+OUT=${OUT-"$SCRIPTPATH/out"}
+BENCH_CC=${CC-"cc"}
+# Benchmarks make sense with optimizations turned on, and no sanitizers
+BENCH_CFLAGS=${CFLAGS-"-O2 -g"}
+
+# Janus objects needed by the benchmarks
+JANUS_OBJECTS="janus-log.o janus-utils.o janus-rtcp.o janus-rtp.o janus-events.o"
+for obj in $JANUS_OBJECTS; do
+	if [ ! -f "$JANUSSRC/$obj" ]; then
+		echo "Missing $JANUSSRC/$obj, build Janus first"
+		exit 1
+	fi
+done
+
+# Dependencies
+DEPS_CFLAGS="$(pkg-config --cflags glib-2.0 jansson)"
+DEPS_LIB="$(pkg-config --libs glib-2.0 jansson zlib) -pthread -lm"
+
+mkdir -p $OUT
+benchmarks=$(find $SCRIPTPATH -maxdepth 1 -name "*.c")
+for sourceFile in $benchmarks; do
+	name=$(basename $sourceFile .c)
+	echo "Building benchmark: $name"
+	objects=""
+	for obj in $JANUS_OBJECTS; do
+		objects="$objects $JANUSSRC/$obj"
+	done
+	$BENCH_CC $BENCH_CFLAGS $DEPS_CFLAGS -I$JANUSSRC $sourceFile $objects -o $OUT/$name $DEPS_LIB
+done
@@ -0,0 +1,169 @@
+/* Serialization cost of event handler events: compares the size and the
+ * CPU time per event of compact JSON and MessagePack, for events sent one
+ * by one and grouped in batches, with and without gzip compression on top
+ * (as janus_sampleevh can do). The events are modelled on what the core
+ * generates the most, that is media stats and plugin events. */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <glib.h>
+#include <jansson.h>
+#include "../src/debug.h"
+#include "../src/events.h"
+#include "../src/utils.h"
+#include "../src/events/eventhandler.h"
+
+int janus_log_level = LOG_NONE;
+gboolean janus_log_timestamps = FALSE;
+gboolean janus_log_colors = FALSE;
+char *janus_log_global_prefix = NULL;
+int lock_debug = 0;
+int refcount_debug = 0;
+
+/* This is to avoid linking with openSSL */
+int RAND_bytes(uint8_t *key, int len) {
+	return 0;
+}
+
+static gint64 bench_cpu_time(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return (ts.tv_sec*G_USEC_PER_SEC*1000) + ts.tv_nsec;
+}
+
+/* Envelope as created by janus_events_notify_handlers */
+static json_t *bench_event(int type, int subtype, guint64 id, json_t *body) {
+	json_t *event = json_object();
+	json_object_set_new(event, "emitter", json_string("MyJanusInstance"));
+	json_object_set_new(event, "type", json_integer(type));
+	if(subtype > 0)
+		json_object_set_new(event, "subtype", json_integer(subtype));
+	json_object_set_new(event, "timestamp", json_integer(1700000000000000 + id*20000));
+	json_object_set_new(event, "session_id", json_integer(4729318529174051 + id));
+	json_object_set_new(event, "handle_id", json_integer(2870531487160214 + id));
+	json_object_set_new(event, "opaque_id", json_string("videoroomtest-8vB5xWq2Jh3k"));
+	json_object_set_new(event, "event", body);
+	return event;
+}
+
+static json_t *bench_media_stats(guint64 id) {
+	json_t *body = json_object();
+	json_object_set_new(body, "mid", json_string("1"));
+	json_object_set_new(body, "mindex", json_integer(1));
+	json_object_set_new(body, "media", json_string("video"));
+	json_object_set_new(body, "codec", json_string("vp8"));
+	json_object_set_new(body, "base", json_integer(90000));
+	json_object_set_new(body, "rtt", json_integer(23 + id%7));
+	json_object_set_new(body, "lost", json_integer(id%5));
+	json_object_set_new(body, "lost-by-remote", json_integer(0));
+	json_object_set_new(body, "jitter-local", json_integer(11));
+	json_object_set_new(body, "jitter-remote", json_integer(8));
+	json_object_set_new(body, "in-link-quality", json_integer(100));
+	json_object_set_new(body, "in-media-link-quality", json_integer(100));
+	json_object_set_new(body, "out-link-quality", json_integer(99));
+	json_object_set_new(body, "out-media-link-quality", json_integer(100));
+	json_object_set_new(body, "packets-received", json_integer(182734 + id*50));
+	json_object_set_new(body, "packets-sent", json_integer(1283 + id));
+	json_object_set_new(body, "bytes-received", json_integer(187239781 + id*55000));
+	json_object_set_new(body, "bytes-sent", json_integer(98231 + id*80));
+	json_object_set_new(body, "bytes-received-lastsec", json_integer(132871));
+	json_object_set_new(body, "bytes-sent-lastsec", json_integer(122));
+	json_object_set_new(body, "nacks-received", json_integer(12));
+	json_object_set_new(body, "nacks-sent", json_integer(31));
+	json_object_set_new(body, "retransmissions-received", json_integer(29));
+	return bench_event(JANUS_EVENT_TYPE_MEDIA, JANUS_EVENT_SUBTYPE_MEDIA_STATS, id, body);
+}
+
+static json_t *bench_plugin_event(guint64 id) {
+	json_t *data = json_object();
+	json_object_set_new(data, "event", json_string("subscribed"));
+	json_object_set_new(data, "room", json_integer(1234));
+	json_object_set_new(data, "feed", json_integer(8236412378 + id%4));
+	json_object_set_new(data, "private_id", json_integer(3829749324));
+	json_object_set_new(data, "display", json_string("Publisher"));
+	json_object_set_new(data, "audio", json_true());
+	json_object_set_new(data, "video", json_true());
+	json_object_set_new(data, "bitrate", json_real(512.5));
+	json_t *body = json_object();
+	json_object_set_new(body, "plugin", json_string("janus.plugin.videoroom"));
+	json_object_set_new(body, "data", data);
+	return bench_event(JANUS_EVENT_TYPE_PLUGIN, 0, id, body);
+}
+
+typedef struct bench_result {
+	gint64 cpu;
+	size_t bytes;
+} bench_result;
+
+/* Serialize the same list of events (or batches) over and over */
+static void bench_run(json_t **events, int count, int iterations, janus_events_format format,
+		gboolean compress, bench_result *result) {
+	result->cpu = 0;
+	result->bytes = 0;
+	int i = 0, j = 0;
+	gint64 start = bench_cpu_time();
+	for(i=0; i<iterations; i++) {
+		for(j=0; j<count; j++) {
+			size_t len = 0;
+			char *payload = janus_events_serialize(events[j], format, JSON_COMPACT | JSON_PRESERVE_ORDER, &len);
+			if(payload == NULL)
+				abort();
+			if(compress) {
+				/* Same sizing as janus_sampleevh */
+				size_t zlen = len + 64;
+				char *compressed = g_malloc(zlen);
+				len = janus_gzip_compress(-1, payload, len, compressed, zlen);
+				g_free(compressed);
+				if(len == 0)
+					abort();
+			}
+			if(i == 0)
+				result->bytes += len;
+			free(payload);
+		}
+	}
+	result->cpu = bench_cpu_time() - start;
+}
+
+int main(int argc, char *argv[]) {
+	int iterations = argc > 1 ? atoi(argv[1]) : 200;
+	if(iterations < 1)
+		iterations = 1;
+	int batch = 100, total = 1000, i = 0, j = 0;
+	/* Mix of media stats and plugin events, 4:1 */
+	json_t *events[1000];
+	for(i=0; i<total; i++)
+		events[i] = (i%5 == 4) ? bench_plugin_event(i) : bench_media_stats(i);
+	json_t *batches[10];
+	for(i=0; i<total/batch; i++) {
+		batches[i] = json_array();
+		for(j=0; j<batch; j++)
+			json_array_append(batches[i], events[i*batch+j]);
+	}
+	printf("%d events (80%% media stats, 20%% plugin events), %d iterations\n", total, iterations);
+	printf("%-12s %-8s %-8s %14s %14s\n", "format", "batch", "gzip", "bytes/event", "ns/event");
+	janus_events_format formats[] = { JANUS_EVENTS_FORMAT_JSON, JANUS_EVENTS_FORMAT_MSGPACK };
+	int f = 0, b = 0, z = 0;
+	for(b=0; b<2; b++) {
+		for(z=0; z<2; z++) {
+			for(f=0; f<2; f++) {
+				bench_result result;
+				if(b == 0)
+					bench_run(events, total, iterations, formats[f], z, &result);
+				else
+					bench_run(batches, total/batch, iterations, formats[f], z, &result);
+				printf("%-12s %-8d %-8s %14.1f %14.1f\n", janus_events_format_to_string(formats[f]),
+					b ? batch : 1, z ? "yes" : "no", (double)result.bytes/total,
+					(double)result.cpu/((double)total*iterations));
+			}
+		}
+	}
+	for(i=0; i<total/batch; i++)
+		json_decref(batches[i]);
+	for(i=0; i<total; i++)
+		json_decref(events[i]);
+	return 0;
+}
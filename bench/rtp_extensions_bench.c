@@ -0,0 +1,200 @@
+/* Cost of parsing the RTP extensions of incoming packets: compares the
+ * single pass janus_rtp_header_extensions_parse with invoking the
+ * individual janus_rtp_header_extension_parse_* helpers for each of the
+ * negotiated extensions, as the core used to do for each packet, on audio
+ * and video packets carrying the extensions browsers typically send. */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <time.h>
+#include <arpa/inet.h>
+
+#include <glib.h>
+#include "../src/debug.h"
+#include "../src/rtp.h"
+#include "../src/utils.h"
+#include "../src/plugins/plugin.h"
+
+int janus_log_level = LOG_NONE;
+gboolean janus_log_timestamps = FALSE;
+gboolean janus_log_colors = FALSE;
+char *janus_log_global_prefix = NULL;
+int lock_debug = 0;
+int refcount_debug = 0;
+
+/* This is to avoid linking with openSSL */
+int RAND_bytes(uint8_t *key, int len) {
+	return 0;
+}
+
+static gint64 bench_cpu_time(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return (ts.tv_sec*G_USEC_PER_SEC*1000) + ts.tv_nsec;
+}
+
+/* Negotiated extension IDs */
+#define BENCH_AUDIO_LEVEL			1
+#define BENCH_ABS_SEND_TIME			2
+#define BENCH_TRANSPORT_WIDE_CC		3
+#define BENCH_MID					4
+#define BENCH_PLAYOUT_DELAY			6
+#define BENCH_VIDEO_ORIENTATION		7
+#define BENCH_ABS_CAPTURE_TIME		8
+#define BENCH_DEPENDENCY_DESC		9
+#define BENCH_VIDEO_LAYERS			10
+#define BENCH_RID					11
+#define BENCH_REPAIRED_RID			12
+
+/* Append a one-byte extension element */
+static int bench_add_extension(char *buf, int offset, int id, const uint8_t *value, int len) {
+	buf[offset] = (id << 4) | (len - 1);
+	memcpy(buf + offset + 1, value, len);
+	return offset + 1 + len;
+}
+
+/* Create an RTP packet with the extensions browsers send for audio or video */
+static int bench_create_packet(char *buf, gboolean video) {
+	memset(buf, 0, 1500);
+	janus_rtp_header *rtp = (janus_rtp_header *)buf;
+	rtp->version = 2;
+	rtp->extension = 1;
+	rtp->type = video ? 96 : 111;
+	rtp->seq_number = htons(1234);
+	rtp->timestamp = htonl(5678);
+	rtp->ssrc = htonl(video ? 0x2222 : 0x1111);
+	int offset = 16;
+	uint8_t value[16] = { 0 };
+	if(!video) {
+		value[0] = 0x80 | 42;
+		offset = bench_add_extension(buf, offset, BENCH_AUDIO_LEVEL, value, 1);
+	}
+	value[0] = 0x12; value[1] = 0x34; value[2] = 0x56;
+	offset = bench_add_extension(buf, offset, BENCH_ABS_SEND_TIME, value, 3);
+	value[0] = 0x01; value[1] = 0x02;
+	offset = bench_add_extension(buf, offset, BENCH_TRANSPORT_WIDE_CC, value, 2);
+	if(video) {
+		value[0] = 0x00; value[1] = 0x00; value[2] = 0x00;
+		offset = bench_add_extension(buf, offset, BENCH_PLAYOUT_DELAY, value, 3);
+		value[0] = 0x01;
+		offset = bench_add_extension(buf, offset, BENCH_VIDEO_ORIENTATION, value, 1);
+		uint8_t dd[8] = { 0x80, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07 };
+		offset = bench_add_extension(buf, offset, BENCH_DEPENDENCY_DESC, dd, sizeof(dd));
+	}
+	uint8_t abs_capture[8] = { 0xe6, 0x1b, 0x3a, 0x10, 0x00, 0x00, 0x00, 0x00 };
+	offset = bench_add_extension(buf, offset, BENCH_ABS_CAPTURE_TIME, abs_capture, sizeof(abs_capture));
+	/* Padding, and extension header */
+	while((offset - 16) % 4)
+		buf[offset++] = 0;
+	janus_rtp_header_extension *ext = (janus_rtp_header_extension *)(buf + 12);
+	ext->type = htons(0xBEDE);
+	ext->length = htons((offset - 16) / 4);
+	/* Payload */
+	return offset + (video ? 1100 : 80);
+}
+
+/* What the core did before the single pass parser, that is walking the
+ * extensions block once for each of the negotiated extensions */
+static void bench_parse_individually(char *buf, int len, gboolean video, janus_plugin_rtp_extensions *extensions, int *transport_seq_num) {
+	uint16_t seq = 0;
+	if(janus_rtp_header_extension_parse_transport_wide_cc(buf, len, BENCH_TRANSPORT_WIDE_CC, &seq) == 0)
+		*transport_seq_num = seq;
+	if(!video) {
+		gboolean vad = FALSE;
+		int level = -1;
+		if(janus_rtp_header_extension_parse_audio_level(buf, len, BENCH_AUDIO_LEVEL, &vad, &level) == 0) {
+			extensions->audio_level = level;
+			extensions->audio_level_vad = vad;
+		}
+	}
+	if(video) {
+		gboolean c = FALSE, f = FALSE, r1 = FALSE, r0 = FALSE;
+		if(janus_rtp_header_extension_parse_video_orientation(buf, len, BENCH_VIDEO_ORIENTATION, &c, &f, &r1, &r0) == 0) {
+			extensions->video_rotation = 0;
+			if(r1 && r0)
+				extensions->video_rotation = 270;
+			else if(r1)
+				extensions->video_rotation = 180;
+			else if(r0)
+				extensions->video_rotation = 90;
+			extensions->video_back_camera = c;
+			extensions->video_flipped = f;
+		}
+		uint16_t min = 0, max = 0;
+		if(janus_rtp_header_extension_parse_playout_delay(buf, len, BENCH_PLAYOUT_DELAY, &min, &max) == 0) {
+			extensions->min_delay = min;
+			extensions->max_delay = max;
+		}
+		uint8_t dd[256];
+		int dd_len = sizeof(dd);
+		if(janus_rtp_header_extension_parse_dependency_desc(buf, len, BENCH_DEPENDENCY_DESC, dd, &dd_len) == 0 && dd_len > 0) {
+			extensions->dd_len = dd_len;
+			memcpy(extensions->dd_content, dd, dd_len);
+		}
+	}
+	uint64_t abs_ts = 0;
+	if(janus_rtp_header_extension_parse_abs_capture_time(buf, len, BENCH_ABS_CAPTURE_TIME, &abs_ts) == 0)
+		extensions->abs_capture_ts = abs_ts;
+	int8_t spatial_layers = -1, temporal_layers = -1;
+	if(janus_rtp_header_extension_parse_video_layers_allocation(buf, len, BENCH_VIDEO_LAYERS, &spatial_layers, &temporal_layers) == 0) {
+		extensions->spatial_layers = spatial_layers;
+		extensions->temporal_layers = temporal_layers;
+	}
+}
+
+int main(int argc, char *argv[]) {
+	int iterations = argc > 1 ? atoi(argv[1]) : 10000000;
+	if(iterations < 1)
+		iterations = 1;
+	janus_rtp_extension_map map;
+	janus_rtp_extension_map_reset(&map);
+	janus_rtp_extension_map_set(&map, BENCH_AUDIO_LEVEL, JANUS_RTP_EXTENSION_AUDIO_LEVEL);
+	janus_rtp_extension_map_set(&map, BENCH_ABS_SEND_TIME, JANUS_RTP_EXTENSION_ABS_SEND_TIME);
+	janus_rtp_extension_map_set(&map, BENCH_TRANSPORT_WIDE_CC, JANUS_RTP_EXTENSION_TRANSPORT_WIDE_CC);
+	janus_rtp_extension_map_set(&map, BENCH_MID, JANUS_RTP_EXTENSION_MID);
+	janus_rtp_extension_map_set(&map, BENCH_PLAYOUT_DELAY, JANUS_RTP_EXTENSION_PLAYOUT_DELAY);
+	janus_rtp_extension_map_set(&map, BENCH_VIDEO_ORIENTATION, JANUS_RTP_EXTENSION_VIDEO_ORIENTATION);
+	janus_rtp_extension_map_set(&map, BENCH_ABS_CAPTURE_TIME, JANUS_RTP_EXTENSION_ABS_CAPTURE_TIME);
+	janus_rtp_extension_map_set(&map, BENCH_DEPENDENCY_DESC, JANUS_RTP_EXTENSION_DEPENDENCY_DESC);
+	janus_rtp_extension_map_set(&map, BENCH_VIDEO_LAYERS, JANUS_RTP_EXTENSION_VIDEO_LAYERS);
+	janus_rtp_extension_map_set(&map, BENCH_RID, JANUS_RTP_EXTENSION_RID);
+	janus_rtp_extension_map_set(&map, BENCH_REPAIRED_RID, JANUS_RTP_EXTENSION_REPAIRED_RID);
+	printf("%d iterations per packet type\n", iterations);
+	printf("%-8s %16s %16s\n", "packet", "individual ns", "single pass ns");
+	int v = 0, i = 0;
+	for(v=0; v<2; v++) {
+		gboolean video = (v == 1);
+		char buf[1500];
+		int len = bench_create_packet(buf, video);
+		/* Make sure both approaches see the same thing */
+		janus_plugin_rtp_extensions individual, single;
+		memset(&individual, 0, sizeof(individual));
+		memset(&single, 0, sizeof(single));
+		int transport_seq_num = -1;
+		janus_rtp_header_extensions_info info;
+		bench_parse_individually(buf, len, video, &individual, &transport_seq_num);
+		janus_rtp_header_extensions_parse(buf, len, &map, &single, &info);
+		if(memcmp(&individual, &single, sizeof(individual)) != 0 || transport_seq_num != info.transport_seq_num) {
+			printf("Parsers disagree on the %s packet\n", video ? "video" : "audio");
+			return 1;
+		}
+		gint64 start = bench_cpu_time();
+		for(i=0; i<iterations; i++) {
+			memset(&individual, 0, sizeof(individual));
+			bench_parse_individually(buf, len, video, &individual, &transport_seq_num);
+			__asm__ __volatile__("" : : "g"(&individual) : "memory");
+		}
+		gint64 individual_time = bench_cpu_time() - start;
+		start = bench_cpu_time();
+		for(i=0; i<iterations; i++) {
+			memset(&single, 0, sizeof(single));
+			janus_rtp_header_extensions_parse(buf, len, &map, &single, &info);
+			__asm__ __volatile__("" : : "g"(&single) : "memory");
+		}
+		gint64 single_time = bench_cpu_time() - start;
+		printf("%-8s %16.1f %16.1f\n", video ? "video" : "audio",
+			(double)individual_time/iterations, (double)single_time/iterations);
+	}
+	return 0;
+}
@@ -0,0 +1,149 @@
+/* Memory and CPU cost of keeping sent video packets around for RFC4588
+ * retransmissions: compares each subscriber keeping a copy of its own of
+ * what it sent, with subscribers only keeping the header they sent and a
+ * reference to a janus_rtp_shared_packet the publisher's payload was
+ * copied to once, as the VideoRoom does with shared_retransmissions. */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <time.h>
+#include <arpa/inet.h>
+
+#include <glib.h>
+#include "../src/debug.h"
+#include "../src/rtp.h"
+#include "../src/utils.h"
+
+int janus_log_level = LOG_NONE;
+gboolean janus_log_timestamps = FALSE;
+gboolean janus_log_colors = FALSE;
+char *janus_log_global_prefix = NULL;
+int lock_debug = 0;
+int refcount_debug = 0;
+
+/* This is to avoid linking with openSSL */
+int RAND_bytes(uint8_t *key, int len) {
+	return 0;
+}
+
+static gint64 bench_cpu_time(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return (ts.tv_sec*G_USEC_PER_SEC*1000) + ts.tv_nsec;
+}
+
+/* Packets a subscriber keeps for retransmissions, oldest first */
+typedef struct bench_subscriber {
+	janus_rtp_packet **packets;
+	int head, count;
+} bench_subscriber;
+
+static gsize bench_allocated = 0;
+
+/* Store a sent packet the way janus_ice_outgoing_traffic_handle does */
+static janus_rtp_packet *bench_store(char *buf, int len, janus_rtp_shared_packet *shared) {
+	int plen = 0;
+	char *payload = janus_rtp_payload(buf, len, &plen);
+	size_t hsize = payload - buf;
+	janus_rtp_packet *p = g_malloc(sizeof(janus_rtp_packet));
+	if(shared != NULL && shared->length == plen) {
+		p->data = g_malloc(hsize);
+		p->length = hsize;
+		memcpy(p->data, buf, hsize);
+		janus_rtp_shared_packet_ref(shared);
+		p->shared = shared;
+	} else {
+		janus_rtp_header *header = (janus_rtp_header *)buf;
+		guint16 original_seq = header->seq_number;
+		p->data = g_malloc(len+2);
+		p->length = len+2;
+		memcpy(p->data, buf, hsize);
+		memcpy(p->data+hsize, &original_seq, 2);
+		memcpy(p->data+hsize+2, payload, plen);
+		p->shared = NULL;
+	}
+	bench_allocated += p->length;
+	return p;
+}
+
+static void bench_free(janus_rtp_packet *p) {
+	bench_allocated -= p->length;
+	g_free(p->data);
+	janus_rtp_shared_packet_unref(p->shared);
+	g_free(p);
+}
+
+int main(int argc, char *argv[]) {
+	int subscribers = argc > 1 ? atoi(argv[1]) : 50;
+	if(subscribers < 1)
+		subscribers = 1;
+	/* A 2mbps publisher sending 1200 bytes packets, 60 seconds, and
+	 * packets kept for 500ms (nack_queue_ms is between 200 and 1000) */
+	int bitrate = 2000000, size = 1200, seconds = 60, window_ms = 500;
+	int rate = bitrate/8/size, window = rate*window_ms/1000, total = rate*seconds;
+	char buf[1500];
+	memset(buf, 0x55, sizeof(buf));
+	janus_rtp_header *rtp = (janus_rtp_header *)buf;
+	memset(rtp, 0, 12);
+	rtp->version = 2;
+	rtp->type = 96;
+	int len = 12 + size;
+	printf("%d subscribers, %d packets/s of %d bytes, kept for %dms (%d packets)\n",
+		subscribers, rate, size, window_ms, window);
+	printf("%-8s %16s %16s %16s\n", "mode", "retained bytes", "ns/packet", "saved (admin)");
+	int mode = 0;
+	for(mode=0; mode<2; mode++) {
+		gboolean shared_mode = (mode == 1);
+		janus_rtp_shared_stats *stats = shared_mode ? janus_rtp_shared_stats_create() : NULL;
+		bench_subscriber *subs = g_malloc0(subscribers*sizeof(bench_subscriber));
+		int s = 0, i = 0;
+		for(s=0; s<subscribers; s++)
+			subs[s].packets = g_malloc0(window*sizeof(janus_rtp_packet *));
+		gsize peak = 0;
+		bench_allocated = 0;
+		gint saved = 0;
+		gint64 start = bench_cpu_time();
+		for(i=0; i<total; i++) {
+			rtp->seq_number = htons(i & 0xFFFF);
+			/* The plugin creates a shared copy once per publisher packet */
+			janus_rtp_shared_packet *shared = shared_mode ? janus_rtp_shared_packet_create(buf, len, stats) : NULL;
+			for(s=0; s<subscribers; s++) {
+				bench_subscriber *sub = &subs[s];
+				if(sub->count == window) {
+					/* Oldest packet is out of the window */
+					bench_free(sub->packets[sub->head]);
+					sub->head = (sub->head + 1) % window;
+					sub->count--;
+				}
+				sub->packets[(sub->head + sub->count) % window] = bench_store(buf, len, shared);
+				sub->count++;
+			}
+			/* The plugin releases its own reference once it relayed the packet */
+			janus_rtp_shared_packet_unref(shared);
+			gsize retained = bench_allocated + (stats ? (gsize)g_atomic_int_get(&stats->bytes) : 0);
+			if(retained > peak) {
+				peak = retained;
+				saved = janus_rtp_shared_stats_saved_bytes(stats);
+			}
+		}
+		gint64 elapsed = bench_cpu_time() - start;
+		for(s=0; s<subscribers; s++) {
+			while(subs[s].count > 0) {
+				bench_free(subs[s].packets[subs[s].head]);
+				subs[s].head = (subs[s].head + 1) % window;
+				subs[s].count--;
+			}
+			g_free(subs[s].packets);
+		}
+		g_free(subs);
+		printf("%-8s %16"SCNu64" %16.1f %16d\n", shared_mode ? "shared" : "private",
+			(guint64)peak, (double)elapsed/((double)total*subscribers), saved);
+		if(stats != NULL && (g_atomic_int_get(&stats->packets) != 0 || g_atomic_int_get(&stats->bytes) != 0)) {
+			printf("Shared packets leaked\n");
+			return 1;
+		}
+		janus_rtp_shared_stats_destroy(stats);
+	}
+	return 0;
+}
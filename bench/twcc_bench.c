@@ -0,0 +1,110 @@
+/* Cost of the transport-wide CC receive path: simulates a PeerConnection
+ * receiving video at a fixed packet rate, with some losses and reordering,
+ * and measures the time spent tracking each packet in the receive history,
+ * and the time spent building all the feedback messages on each tick of
+ * the TWCC timer (200ms by default, as in the core). */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <glib.h>
+#include "../src/debug.h"
+#include "../src/rtcp.h"
+#include "../src/utils.h"
+
+int janus_log_level = LOG_NONE;
+gboolean janus_log_timestamps = FALSE;
+gboolean janus_log_colors = FALSE;
+char *janus_log_global_prefix = NULL;
+int lock_debug = 0;
+int refcount_debug = 0;
+
+/* This is to avoid linking with openSSL */
+int RAND_bytes(uint8_t *key, int len) {
+	return 0;
+}
+
+static gint64 bench_cpu_time(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return (ts.tv_sec*G_USEC_PER_SEC*1000) + ts.tv_nsec;
+}
+
+/* Deterministic PRNG, so that all runs see the same traffic */
+static guint32 bench_seed = 0x12345678;
+static guint32 bench_random(void) {
+	bench_seed ^= bench_seed << 13;
+	bench_seed ^= bench_seed >> 17;
+	bench_seed ^= bench_seed << 5;
+	return bench_seed;
+}
+
+int main(int argc, char *argv[]) {
+	int seconds = argc > 1 ? atoi(argv[1]) : 600;
+	if(seconds < 1)
+		seconds = 1;
+	/* 2000 packets per second, 1% loss, 1% of packets swapped with the next one */
+	int rate = 2000, period = 200, loss = 10, reorder = 10;
+	int per_tick = rate*period/1000, ticks = seconds*1000/period;
+	/* Same sizing as the core */
+	janus_rtcp_transport_wide_cc_history *history = janus_rtcp_transport_wide_cc_history_create(period*8 > 1024 ? period*8 : 1024);
+	guint32 *seqs = g_malloc(per_tick*sizeof(guint32));
+	char rtcpbuf[1300];
+	guint32 seq = 1;
+	guint64 now = 1000000, received = 0, messages = 0, bytes = 0;
+	guint8 feedback_packet_count = 0;
+	gint64 add_time = 0, feedback_time = 0, max_feedback_time = 0;
+	int i = 0, j = 0;
+	for(i=0; i<ticks; i++) {
+		/* Prepare the packets we'll receive in this period */
+		int count = 0;
+		for(j=0; j<per_tick; j++, seq++) {
+			if(bench_random() % 1000 < (guint32)loss)
+				continue;
+			seqs[count++] = seq;
+		}
+		for(j=0; j<count-1; j++) {
+			if(bench_random() % 1000 < (guint32)reorder) {
+				guint32 temp = seqs[j];
+				seqs[j] = seqs[j+1];
+				seqs[j+1] = temp;
+				j++;
+			}
+		}
+		/* Receive them */
+		gint64 start = bench_cpu_time();
+		for(j=0; j<count; j++) {
+			now += 1000000/rate;
+			janus_rtcp_transport_wide_cc_history_add(history, seqs[j], now);
+		}
+		add_time += bench_cpu_time() - start;
+		received += count;
+		/* Send feedback for them, as the TWCC timer does */
+		start = bench_cpu_time();
+		while(janus_rtcp_transport_wide_cc_history_pending(history) > 0) {
+			int len = janus_rtcp_transport_wide_cc_feedback(rtcpbuf, sizeof(rtcpbuf),
+				1, 2, feedback_packet_count++, history, JANUS_RTCP_TWCC_MAX_PACKETS);
+			if(len <= 0)
+				break;
+			messages++;
+			bytes += len;
+		}
+		gint64 elapsed = bench_cpu_time() - start;
+		feedback_time += elapsed;
+		if(elapsed > max_feedback_time)
+			max_feedback_time = elapsed;
+	}
+	printf("%d seconds at %d packets/s (%d.%d%% loss, %d.%d%% reordered), feedback every %dms\n",
+		seconds, rate, loss/10, loss%10, reorder/10, reorder%10, period);
+	printf("  packets received:   %"SCNu64"\n", received);
+	printf("  feedback messages:  %"SCNu64" (%"SCNu64" bytes)\n", messages, bytes);
+	printf("  history update:     %.1f ns/packet\n", (double)add_time/received);
+	printf("  feedback per tick:  %.2f us avg, %.2f us max\n",
+		(double)feedback_time/ticks/1000, (double)max_feedback_time/1000);
+	printf("  total per packet:   %.1f ns\n", (double)(add_time + feedback_time)/received);
+	g_free(seqs);
+	janus_rtcp_transport_wide_cc_history_destroy(history);
+	return 0;
+}
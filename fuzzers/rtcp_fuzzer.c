@@ -12,12 +12,33 @@ gboolean janus_log_timestamps = FALSE;
 gboolean janus_log_colors = FALSE;
 char *janus_log_global_prefix = NULL;
 int lock_debug = 0;
+int refcount_debug = 0;
 
 /* This is to avoid linking with openSSL */
 int RAND_bytes(uint8_t *key, int len) {
 	return 0;
 }
 
+/* Helper to count the messages in a parsed compound packet, and the NACKed sequence numbers:
+ * the latter must match the summary, or the core wouldn't retransmit all the packets */
+static void janus_rtcp_compound_check(char *packet, janus_rtcp_compound *compound, int *messages, int *nacks) {
+	*messages = 0;
+	*nacks = 0;
+	janus_rtcp_compound_iter iter = { 0 };
+	const janus_rtcp_block *block = NULL;
+	while((block = janus_rtcp_compound_next(packet, compound, &iter)) != NULL) {
+		(*messages)++;
+		if(block->type != JANUS_RTCP_BLOCK_NACK)
+			continue;
+		janus_rtcp_nack *nack = (janus_rtcp_nack *)((janus_rtcp_fb *)(packet + block->offset))->fci;
+		int i = 0;
+		for(i=0; i<block->count; i++)
+			*nacks += 1 + __builtin_popcount(ntohs(nack[i].blp));
+	}
+	if(*nacks != compound->nacks)
+		abort();
+}
+
 int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
 	/* Sanity Checks */
 	/* Max UDP payload with MTU=1500 */
@@ -35,19 +56,23 @@ int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
 	/* Do some copies of input data */
 	uint8_t copy_data0[size], copy_data1[size],
 		copy_data2[size], copy_data3[size],
-			copy_data4[size], copy_data5[size];
-	uint8_t *copy_data[6] = { copy_data0, copy_data1,
+			copy_data4[size], copy_data5[size],
+				copy_data6[size], filter_data[size];
+	uint8_t *copy_data[7] = { copy_data0, copy_data1,
 			copy_data2, copy_data3,
-				copy_data4, copy_data5 };
+				copy_data4, copy_data5,
+					copy_data6 };
 	int idx, newlen;
-	for (idx=0; idx < 6; idx++) {
+	for (idx=0; idx < 7; idx++) {
 		memcpy(copy_data[idx], data, size);
 	}
 	idx = 0;
 	/* Create some void RTCP contexts */
-	janus_rtcp_context ctx0, ctx1;
+	janus_rtcp_context ctx0, ctx1, ctx2;
 	memset(&ctx0, 0, sizeof(janus_rtcp_context));
 	memset(&ctx1, 0, sizeof(janus_rtcp_context));
+	memset(&ctx2, 0, sizeof(janus_rtcp_context));
+	janus_rtcp_compound compound;
 
 	/* Targets */
 	/* Functions that just read data */
@@ -64,6 +89,25 @@ int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
 	janus_rtcp_fix_ssrc(&ctx0, (char *)copy_data[idx++], size, 1, 2, 2);
 	janus_rtcp_parse(&ctx1, (char *)copy_data[idx++], size);
 	janus_rtcp_remove_nacks((char *)copy_data[idx++], size);
+	if(janus_rtcp_parse_compound((char *)copy_data[idx], size, &compound) == 0) {
+		janus_rtcp_compound_update_context(&ctx2, (char *)copy_data[idx], &compound);
+		/* All NACKs must be visible to the core, even when there are more messages than
+		 * blocks, and none of them must be left once they've been removed */
+		int messages = 0, nacks = 0;
+		janus_rtcp_compound_check((char *)copy_data[idx], &compound, &messages, &nacks);
+		int newsize = janus_rtcp_compound_remove((char *)copy_data[idx], size, &compound, JANUS_RTCP_BLOCK_NACK);
+		int left = 0, left_nacks = 0;
+		janus_rtcp_compound_check((char *)copy_data[idx], &compound, &left, &left_nacks);
+		if(newsize < size && (left_nacks > 0 || compound.nacks > 0 || left >= messages))
+			abort();
+		if(janus_rtcp_parse_compound((char *)copy_data[idx], newsize, &compound) == 0) {
+			janus_rtcp_compound_check((char *)copy_data[idx], &compound, &left, &left_nacks);
+			if(newsize < size && left_nacks > 0)
+				abort();
+		}
+	}
+	idx++;
+	janus_rtcp_filter_into((char *)data, size, (char *)filter_data, size);
 	/* Functions that allocate new memory */
 	char *output_data = janus_rtcp_filter((char *)data, size, &newlen);
 	GQueue *queue = g_queue_new();
@@ -0,0 +1,58 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#include <glib.h>
+#include "../src/debug.h"
+#include "../src/utils.h"
+#include "../src/rtp.h"
+
+int janus_log_level = LOG_NONE;
+gboolean janus_log_timestamps = FALSE;
+gboolean janus_log_colors = FALSE;
+char *janus_log_global_prefix = NULL;
+int lock_debug = 0;
+int refcount_debug = 0;
+
+/* This is to avoid linking with openSSL */
+int RAND_bytes(uint8_t *key, int len) {
+	return 0;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+	/* Sanity Checks */
+	/* Max UDP payload with MTU=1500 */
+	if (size > 1472) return 0;
+	/* libnice checks that a packet length is positive */
+	if (size <= 0) return 0;
+	/* Janus checks for a minimum packet length
+	 * and the RTP header type value */
+	if (!janus_is_rtp((char *)data, size)) return 0;
+
+	/* Map all the extensions we know about to some IDs: we use the
+	 * same IDs as the individual parsers in rtp_fuzzer.c, and more */
+	janus_rtp_extension_map map;
+	janus_rtp_extension_map_reset(&map);
+	int type = JANUS_RTP_EXTENSION_AUDIO_LEVEL;
+	for (type = JANUS_RTP_EXTENSION_AUDIO_LEVEL; type <= JANUS_RTP_EXTENSION_VIDEO_LAYERS; type++) {
+		/* One-byte IDs (1-11) and two-byte IDs (16-26) */
+		janus_rtp_extension_map_set(&map, type, type);
+		janus_rtp_extension_map_set(&map, type + 15, type);
+	}
+
+	/* Single pass RTP extensions parser */
+	janus_plugin_rtp_extensions extensions;
+	memset(&extensions, 0, sizeof(extensions));
+	janus_rtp_header_extensions_info info;
+	janus_rtp_header_extensions_parse((char *)data, size, &map, &extensions, &info);
+	/* Make sure the SDES items point inside the packet */
+	if (info.mid && (info.mid < (char *)data || info.mid + info.mid_len > (char *)data + size)) abort();
+	if (info.rid && (info.rid < (char *)data || info.rid + info.rid_len > (char *)data + size)) abort();
+	if (info.repaired_rid && (info.repaired_rid < (char *)data ||
+			info.repaired_rid + info.repaired_rid_len > (char *)data + size)) abort();
+	/* Try with a partial output too */
+	janus_rtp_header_extensions_parse((char *)data, size, &map, NULL, &info);
+	janus_rtp_header_extensions_parse((char *)data, size, &map, &extensions, NULL);
+
+	return 0;
+}
@@ -12,6 +12,7 @@ gboolean janus_log_timestamps = FALSE;
 gboolean janus_log_colors = FALSE;
 char *janus_log_global_prefix = NULL;
 int lock_debug = 0;
+int refcount_debug = 0;
 
 /* This is to avoid linking with openSSL */
 int RAND_bytes(uint8_t *key, int len) {
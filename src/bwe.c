@@ -0,0 +1,287 @@
+/*! \file    bwe.c
+ * \author   Lorenzo Miniero <lorenzo@meetecho.com>
+ * \copyright GNU General Public License v3
+ * \brief    Send-side bandwidth estimation
+ * \details  Implementation of a simple send-side bandwidth estimator,
+ * that the core uses to figure out how much media it can send on a
+ * PeerConnection. The estimator keeps track of the packets we send with
+ * a transport-wide sequence number, and matches them with the
+ * transport-wide CC feedback the peer sends back: the estimate is then
+ * computed out of a delay-based controller (looking at the trend of the
+ * inter-group delay variations, much like Google Congestion Control
+ * does) and a loss-based controller. The result is passed to plugins
+ * via the \c estimated_bandwidth callback, so that they can decide, e.g.,
+ * which simulcast substream or SVC layer to send to a subscriber.
+ *
+ * \ingroup protocols
+ * \ref protocols
+ */
+
+#include <math.h>
+
+#include "bwe.h"
+#include "rtcp.h"
+#include "debug.h"
+
+/* Packets sent within this many microseconds are considered a single burst */
+#define JANUS_BWE_BURST_TIME		5000
+/* Smoothing coefficient for the accumulated delay */
+#define JANUS_BWE_SMOOTHING			0.9
+/* Gain applied to the trend before comparing it to the threshold */
+#define JANUS_BWE_TREND_GAIN		4.0
+/* How the threshold adapts to the trend, when increasing and decreasing */
+#define JANUS_BWE_THRESHOLD_K_UP	0.0087
+#define JANUS_BWE_THRESHOLD_K_DOWN	0.039
+/* How long (in ms) the trend must exceed the threshold before we call it overuse */
+#define JANUS_BWE_OVERUSE_TIME		10
+/* Window (in microseconds) we compute the acknowledged bitrate on */
+#define JANUS_BWE_ACKED_WINDOW		500000
+/* How far above the acknowledged bitrate (ratio, and bits per second) increases can push the estimate */
+#define JANUS_BWE_ACKED_RATIO		1.5
+#define JANUS_BWE_ACKED_HEADROOM	10000
+
+const char *janus_bwe_status_str(janus_bwe_status status) {
+	switch(status) {
+		case janus_bwe_status_start:
+			return "start";
+		case janus_bwe_status_normal:
+			return "normal";
+		case janus_bwe_status_overuse:
+			return "overuse";
+		case janus_bwe_status_underuse:
+			return "underuse";
+		default:
+			break;
+	}
+	return NULL;
+}
+
+janus_bwe_context *janus_bwe_context_create(void) {
+	janus_bwe_context *bwe = g_malloc0(sizeof(janus_bwe_context));
+	bwe->threshold = 12.5;
+	bwe->estimate = JANUS_BWE_START_BITRATE;
+	return bwe;
+}
+
+void janus_bwe_context_destroy(janus_bwe_context *bwe) {
+	g_free(bwe);
+}
+
+void janus_bwe_context_add_inflight(janus_bwe_context *bwe, guint16 seq, gint64 sent, int size) {
+	if(bwe == NULL)
+		return;
+	janus_bwe_packet *p = &bwe->history[seq & (JANUS_BWE_HISTORY_SIZE-1)];
+	p->sent = sent;
+	p->seq = seq;
+	p->size = size > G_MAXUINT16 ? G_MAXUINT16 : size;
+	p->received = 0;
+	p->lost = 0;
+}
+
+/* Linear regression on the delay samples we have */
+static double janus_bwe_context_trendline_slope(janus_bwe_context *bwe) {
+	guint i = 0, n = bwe->trend_count;
+	double sum_x = 0, sum_y = 0;
+	for(i=0; i<n; i++) {
+		sum_x += bwe->trend_x[i];
+		sum_y += bwe->trend_y[i];
+	}
+	double avg_x = sum_x/n, avg_y = sum_y/n;
+	double num = 0, den = 0;
+	for(i=0; i<n; i++) {
+		num += (bwe->trend_x[i] - avg_x) * (bwe->trend_y[i] - avg_y);
+		den += (bwe->trend_x[i] - avg_x) * (bwe->trend_x[i] - avg_x);
+	}
+	return den != 0 ? num/den : bwe->trend;
+}
+
+/* Update the trendline with a new delay variation sample, and check if we're overusing the link */
+static void janus_bwe_context_trendline_update(janus_bwe_context *bwe, double delta_ms, gint64 arrival) {
+	if(bwe->first_arrival == 0)
+		bwe->first_arrival = arrival;
+	bwe->num_deltas++;
+	bwe->accumulated_delay += delta_ms;
+	bwe->smoothed_delay = JANUS_BWE_SMOOTHING * bwe->smoothed_delay +
+		(1 - JANUS_BWE_SMOOTHING) * bwe->accumulated_delay;
+	bwe->trend_x[bwe->trend_index] = (double)(arrival - bwe->first_arrival)/1000;
+	bwe->trend_y[bwe->trend_index] = bwe->smoothed_delay;
+	bwe->trend_index = (bwe->trend_index + 1) % JANUS_BWE_TRENDLINE_WINDOW;
+	if(bwe->trend_count < JANUS_BWE_TRENDLINE_WINDOW) {
+		bwe->trend_count++;
+		if(bwe->trend_count < JANUS_BWE_TRENDLINE_WINDOW)
+			return;
+	}
+	bwe->trend = janus_bwe_context_trendline_slope(bwe);
+	/* Compare the trend to the adaptive threshold */
+	double modified = (bwe->num_deltas < 60 ? bwe->num_deltas : 60) * bwe->trend * JANUS_BWE_TREND_GAIN;
+	if(modified > bwe->threshold) {
+		if(bwe->overuse_start == 0)
+			bwe->overuse_start = arrival;
+		bwe->overuse_count++;
+		if((arrival - bwe->overuse_start)/1000 > JANUS_BWE_OVERUSE_TIME && bwe->overuse_count > 1 &&
+				bwe->trend >= bwe->prev_trend) {
+			if(bwe->status != janus_bwe_status_overuse)
+				JANUS_LOG(LOG_HUGE, "[BWE] Overuse detected (trend=%.4f, threshold=%.2f)\n", modified, bwe->threshold);
+			bwe->status = janus_bwe_status_overuse;
+			bwe->overuse_start = 0;
+			bwe->overuse_count = 0;
+		}
+	} else {
+		bwe->status = (modified < -bwe->threshold) ? janus_bwe_status_underuse : janus_bwe_status_normal;
+		bwe->overuse_start = 0;
+		bwe->overuse_count = 0;
+	}
+	bwe->prev_trend = bwe->trend;
+	/* Adapt the threshold, unless this was a spike we should ignore */
+	if(fabs(modified) < bwe->threshold + 15) {
+		double k = fabs(modified) < bwe->threshold ? JANUS_BWE_THRESHOLD_K_DOWN : JANUS_BWE_THRESHOLD_K_UP;
+		gint64 dt = bwe->threshold_updated ? (arrival - bwe->threshold_updated)/1000 : 0;
+		if(dt > 100)
+			dt = 100;
+		bwe->threshold += k * (fabs(modified) - bwe->threshold) * dt;
+		if(bwe->threshold < 6)
+			bwe->threshold = 6;
+		else if(bwe->threshold > 600)
+			bwe->threshold = 600;
+	}
+	bwe->threshold_updated = arrival;
+}
+
+/* Process a single packet in a feedback */
+static void janus_bwe_context_feedback_packet(guint16 seq, gboolean received, gint64 arrival, void *user_data) {
+	janus_bwe_context *bwe = (janus_bwe_context *)user_data;
+	janus_bwe_packet *p = &bwe->history[seq & (JANUS_BWE_HISTORY_SIZE-1)];
+	if(p->sent == 0 || p->seq != seq || p->received)
+		return;
+	if(!received) {
+		if(!p->lost) {
+			p->lost = 1;
+			bwe->fb_lost++;
+		}
+		return;
+	}
+	if(p->lost) {
+		/* A previous feedback said this was lost, but it did arrive */
+		p->lost = 0;
+		if(bwe->fb_lost > 0)
+			bwe->fb_lost--;
+	}
+	p->received = 1;
+	bwe->fb_received++;
+	/* Keep track of the bitrate the peer is receiving */
+	if(bwe->acked_start == 0 || arrival < bwe->acked_start) {
+		bwe->acked_start = arrival;
+		bwe->acked_bytes = 0;
+	}
+	bwe->acked_bytes += p->size;
+	if(arrival > bwe->acked_last)
+		bwe->acked_last = arrival;
+	if(bwe->acked_last - bwe->acked_start >= JANUS_BWE_ACKED_WINDOW) {
+		uint32_t bitrate = (uint32_t)((guint64)bwe->acked_bytes * 8 * G_USEC_PER_SEC / (bwe->acked_last - bwe->acked_start));
+		bwe->acked_bitrate = bwe->acked_bitrate ? (bwe->acked_bitrate*3 + bitrate)/4 : bitrate;
+		bwe->acked_start = bwe->acked_last;
+		bwe->acked_bytes = 0;
+	}
+	/* Group packets sent in a burst, and compare how groups were sent and received */
+	if(!bwe->group_valid) {
+		bwe->group_first_sent = p->sent;
+		bwe->group_sent = p->sent;
+		bwe->group_arrival = arrival;
+		bwe->group_valid = TRUE;
+		return;
+	}
+	if(p->sent < bwe->group_first_sent) {
+		/* Reordered, ignore */
+		return;
+	}
+	if(p->sent - bwe->group_first_sent <= JANUS_BWE_BURST_TIME) {
+		/* Same group */
+		if(p->sent > bwe->group_sent)
+			bwe->group_sent = p->sent;
+		if(arrival > bwe->group_arrival)
+			bwe->group_arrival = arrival;
+		return;
+	}
+	/* New group: compute the delay variation between the two previous ones */
+	if(bwe->prev_group_valid) {
+		gint64 send_delta = bwe->group_sent - bwe->prev_group_sent;
+		gint64 arrival_delta = bwe->group_arrival - bwe->prev_group_arrival;
+		if(arrival_delta < -3*G_USEC_PER_SEC || arrival_delta > 3*G_USEC_PER_SEC) {
+			/* Something's wrong (e.g., the peer reset its clock), start over */
+			bwe->prev_group_valid = FALSE;
+		} else {
+			janus_bwe_context_trendline_update(bwe, (double)(arrival_delta - send_delta)/1000, bwe->group_arrival);
+		}
+	}
+	bwe->prev_group_sent = bwe->group_sent;
+	bwe->prev_group_arrival = bwe->group_arrival;
+	bwe->prev_group_valid = TRUE;
+	bwe->group_first_sent = p->sent;
+	bwe->group_sent = p->sent;
+	bwe->group_arrival = arrival;
+}
+
+int janus_bwe_context_handle_feedback(janus_bwe_context *bwe, char *packet, int len) {
+	if(bwe == NULL || packet == NULL)
+		return -1;
+	return janus_rtcp_transport_wide_cc_parse(packet, len, janus_bwe_context_feedback_packet, bwe);
+}
+
+gboolean janus_bwe_context_update(janus_bwe_context *bwe, gint64 now) {
+	if(bwe == NULL || bwe->status == janus_bwe_status_start)
+		return FALSE;
+	gint64 elapsed = bwe->last_update ? now - bwe->last_update : 0;
+	if(elapsed > G_USEC_PER_SEC)
+		elapsed = G_USEC_PER_SEC;
+	bwe->last_update = now;
+	/* Check how many packets were lost, since the last time we were here */
+	guint32 total = bwe->fb_received + bwe->fb_lost;
+	if(total >= 10) {
+		double loss = (double)bwe->fb_lost / total;
+		bwe->loss = bwe->loss ? (0.75 * bwe->loss + 0.25 * loss) : loss;
+		bwe->fb_received = 0;
+		bwe->fb_lost = 0;
+	}
+	uint32_t estimate = bwe->estimate;
+	if(bwe->status == janus_bwe_status_overuse || bwe->loss > 0.1) {
+		/* Decrease, but not more than once per 200ms, to give the decrease time to have an effect */
+		if(now - bwe->last_decrease >= 200000) {
+			if(bwe->status == janus_bwe_status_overuse) {
+				uint32_t base = (bwe->acked_bitrate > 0 && bwe->acked_bitrate < estimate) ? bwe->acked_bitrate : estimate;
+				estimate = (uint32_t)(base * 0.85);
+				bwe->overuse_seen = TRUE;
+			}
+			if(bwe->loss > 0.1)
+				estimate = (uint32_t)(estimate * (1 - 0.5 * bwe->loss));
+			bwe->last_decrease = now;
+		}
+	} else if(bwe->status == janus_bwe_status_normal && bwe->loss < 0.02) {
+		/* Increase: we're more aggressive until we detect the first congestion */
+		double rate = bwe->overuse_seen ? 0.08 : 0.25;
+		uint32_t increase = (uint32_t)(estimate * rate * elapsed / G_USEC_PER_SEC);
+		estimate += (increase > 1000 ? increase : 1000);
+		/* Don't go too far above what the peer actually received: if we're
+		 * app-limited, nothing is probing the extra bandwidth we'd assume */
+		if(bwe->acked_bitrate > 0) {
+			uint32_t limit = (uint32_t)(bwe->acked_bitrate * JANUS_BWE_ACKED_RATIO) + JANUS_BWE_ACKED_HEADROOM;
+			if(estimate > limit)
+				estimate = bwe->estimate > limit ? bwe->estimate : limit;
+		}
+	}
+	/* Underuse, or some losses: keep the estimate as it is */
+	if(estimate < JANUS_BWE_MIN_BITRATE)
+		estimate = JANUS_BWE_MIN_BITRATE;
+	else if(estimate > JANUS_BWE_MAX_BITRATE)
+		estimate = JANUS_BWE_MAX_BITRATE;
+	bwe->estimate = estimate;
+	/* Notify right away if the estimate went down noticeably, or once per second otherwise */
+	if(bwe->notified == 0 || estimate < bwe->notified*0.85 ||
+			(estimate != bwe->notified && now - bwe->last_notified >= G_USEC_PER_SEC)) {
+		JANUS_LOG(LOG_HUGE, "[BWE] Estimate: %"SCNu32" (acked=%"SCNu32", status=%s, loss=%.2f)\n",
+			estimate, bwe->acked_bitrate, janus_bwe_status_str(bwe->status), bwe->loss);
+		bwe->notified = estimate;
+		bwe->last_notified = now;
+		return TRUE;
+	}
+	return FALSE;
+}
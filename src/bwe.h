@@ -0,0 +1,133 @@
+/*! \file    bwe.h
+ * \author   Lorenzo Miniero <lorenzo@meetecho.com>
+ * \copyright GNU General Public License v3
+ * \brief    Send-side bandwidth estimation (headers)
+ * \details  Implementation of a simple send-side bandwidth estimator,
+ * that the core uses to figure out how much media it can send on a
+ * PeerConnection. The estimator keeps track of the packets we send with
+ * a transport-wide sequence number, and matches them with the
+ * transport-wide CC feedback the peer sends back: the estimate is then
+ * computed out of a delay-based controller (looking at the trend of the
+ * inter-group delay variations, much like Google Congestion Control
+ * does) and a loss-based controller. The result is passed to plugins
+ * via the \c estimated_bandwidth callback, so that they can decide, e.g.,
+ * which simulcast substream or SVC layer to send to a subscriber.
+ *
+ * \ingroup protocols
+ * \ref protocols
+ */
+
+#ifndef JANUS_BWE_H
+#define JANUS_BWE_H
+
+#include <glib.h>
+
+/*! \brief Number of sent packets we keep track of (must be a power of 2) */
+#define JANUS_BWE_HISTORY_SIZE		1024
+/*! \brief Number of delay samples the trendline is computed on */
+#define JANUS_BWE_TRENDLINE_WINDOW	20
+/*! \brief Bitrate we start from, before we get any feedback */
+#define JANUS_BWE_START_BITRATE		1000000
+/*! \brief Lowest estimate we'll ever return */
+#define JANUS_BWE_MIN_BITRATE		30000
+/*! \brief Highest estimate we'll ever return */
+#define JANUS_BWE_MAX_BITRATE		20000000
+
+/*! \brief Status of the delay-based detector */
+typedef enum janus_bwe_status {
+	/*! \brief No feedback yet */
+	janus_bwe_status_start = 0,
+	/*! \brief Delay is stable, we can increase the estimate */
+	janus_bwe_status_normal,
+	/*! \brief Delay is growing, the link is congested */
+	janus_bwe_status_overuse,
+	/*! \brief Delay is decreasing, queues are draining */
+	janus_bwe_status_underuse
+} janus_bwe_status;
+/*! \brief Helper to return a string description of a janus_bwe_status value
+ * @param[in] status The janus_bwe_status value
+ * @returns A string description */
+const char *janus_bwe_status_str(janus_bwe_status status);
+
+/*! \brief Packet we sent, and are waiting feedback for */
+typedef struct janus_bwe_packet {
+	/*! \brief When we sent the packet (monotonic time), 0 if the slot is unused */
+	gint64 sent;
+	/*! \brief Transport-wide sequence number of the packet */
+	guint16 seq;
+	/*! \brief Size of the packet, in bytes */
+	guint16 size;
+	/*! \brief Whether the feedback said the packet was received or lost */
+	guint8 received, lost;
+} janus_bwe_packet;
+
+/*! \brief Send-side bandwidth estimation context
+ * @note The context is not thread safe: the core only updates it from
+ * the loop of the handle that owns the PeerConnection */
+typedef struct janus_bwe_context {
+	/*! \brief Circular history of the packets we sent, indexed by transport-wide sequence number */
+	janus_bwe_packet history[JANUS_BWE_HISTORY_SIZE];
+	/*! \brief Send and arrival time of the current and previous group of packets */
+	gint64 group_first_sent, group_sent, group_arrival, prev_group_sent, prev_group_arrival;
+	/*! \brief Whether the current and previous group of packets are valid */
+	gboolean group_valid, prev_group_valid;
+	/*! \brief Arrival time of the first delay sample, and of the last threshold update */
+	gint64 first_arrival, threshold_updated;
+	/*! \brief Accumulated and smoothed delay variation, in milliseconds */
+	double accumulated_delay, smoothed_delay;
+	/*! \brief Samples the trendline is computed on */
+	double trend_x[JANUS_BWE_TRENDLINE_WINDOW], trend_y[JANUS_BWE_TRENDLINE_WINDOW];
+	/*! \brief Number of samples we have, and where the next one goes */
+	guint trend_count, trend_index, num_deltas;
+	/*! \brief Current and previous trend, and the adaptive threshold we compare it to */
+	double trend, prev_trend, threshold;
+	/*! \brief When the trend started to exceed the threshold, and how many times it did */
+	gint64 overuse_start;
+	guint overuse_count;
+	/*! \brief Status of the delay-based detector */
+	janus_bwe_status status;
+	/*! \brief Bytes acknowledged in the current window, and when the window started (arrival time) */
+	guint32 acked_bytes;
+	gint64 acked_start, acked_last;
+	/*! \brief Bitrate the peer is actually receiving, according to the feedback */
+	uint32_t acked_bitrate;
+	/*! \brief Packets received and lost since the last update */
+	guint32 fb_received, fb_lost;
+	/*! \brief Smoothed loss ratio */
+	double loss;
+	/*! \brief Current estimate, in bits per second */
+	uint32_t estimate;
+	/*! \brief Whether we ever detected an overuse (we're more careful when increasing after that) */
+	gboolean overuse_seen;
+	/*! \brief When we last updated, increased or decreased the estimate */
+	gint64 last_update, last_decrease;
+	/*! \brief Estimate we last notified, and when */
+	uint32_t notified;
+	gint64 last_notified;
+} janus_bwe_context;
+
+/*! \brief Helper to create a new bandwidth estimation context
+ * @returns A new janus_bwe_context instance */
+janus_bwe_context *janus_bwe_context_create(void);
+/*! \brief Helper to destroy a bandwidth estimation context
+ * @param[in] bwe The janus_bwe_context instance to destroy */
+void janus_bwe_context_destroy(janus_bwe_context *bwe);
+/*! \brief Helper to keep track of a packet we just sent with a transport-wide sequence number
+ * @param[in] bwe The janus_bwe_context instance to update
+ * @param[in] seq The transport-wide sequence number of the packet
+ * @param[in] sent When the packet was sent (monotonic time)
+ * @param[in] size The size of the packet, in bytes */
+void janus_bwe_context_add_inflight(janus_bwe_context *bwe, guint16 seq, gint64 sent, int size);
+/*! \brief Helper to process a transport-wide CC feedback message the peer sent
+ * @param[in] bwe The janus_bwe_context instance to update
+ * @param[in] packet The feedback message
+ * @param[in] len The length of the feedback message
+ * @returns The number of packets the feedback reported on, or -1 on errors */
+int janus_bwe_context_handle_feedback(janus_bwe_context *bwe, char *packet, int len);
+/*! \brief Helper to update the estimate, after one or more feedback messages have been processed
+ * @param[in] bwe The janus_bwe_context instance to update
+ * @param[in] now The current monotonic time
+ * @returns TRUE if the estimate changed enough that whoever's interested should be notified, FALSE otherwise */
+gboolean janus_bwe_context_update(janus_bwe_context *bwe, gint64 now);
+
+#endif
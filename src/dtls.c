@@ -131,6 +131,128 @@ gchar *janus_dtls_get_local_fingerprint(void) {
 	return (gchar *)local_fingerprint;
 }
 
+/* Optional pool of workers we offload DTLS handshakes to */
+static GThreadPool *dtls_workers = NULL;
+static guint dtls_workers_num = 0;
+static volatile gint dtls_pending_records = 0;
+static void janus_dtls_srtp_worker(gpointer data, gpointer user_data);
+/* Incoming record waiting for a worker */
+typedef struct janus_dtls_record {
+	/* When the record was queued (monotonic time) */
+	gint64 queued;
+	/* Size and content of the record */
+	uint16_t len;
+	char data[];
+} janus_dtls_record;
+
+/* DTLS session resumption: the server side is handled by the OpenSSL
+ * session cache, while as clients we keep track of the last session
+ * we had with each remote certificate (indexed by its fingerprint) */
+#define DTLS_SESSIONS_MAX		1024
+#define DTLS_SESSION_LIFETIME	300
+static gboolean dtls_resumption = FALSE;
+static GHashTable *dtls_sessions = NULL;
+static janus_mutex dtls_sessions_mutex = JANUS_MUTEX_INITIALIZER;
+
+/* Statistics on handshakes, for the info request */
+#define DTLS_STATS_SAMPLES		512
+typedef struct janus_dtls_samples {
+	guint32 values[DTLS_STATS_SAMPLES];
+	guint count, index;
+} janus_dtls_samples;
+static guint64 dtls_handshakes_started = 0, dtls_handshakes_completed = 0,
+	dtls_handshakes_failed = 0, dtls_handshakes_resumed = 0;
+static janus_dtls_samples dtls_handshake_latency = { 0 }, dtls_queue_delay = { 0 };
+static janus_mutex dtls_stats_mutex = JANUS_MUTEX_INITIALIZER;
+
+/* Helpers to keep track of samples, and compute percentiles on them */
+static void janus_dtls_samples_add(janus_dtls_samples *samples, gint64 value) {
+	samples->values[samples->index] = (guint32)(value > 0 ? value : 0);
+	samples->index = (samples->index + 1) % DTLS_STATS_SAMPLES;
+	if(samples->count < DTLS_STATS_SAMPLES)
+		samples->count++;
+}
+static int janus_dtls_samples_compare(const void *a, const void *b) {
+	guint32 va = *(const guint32 *)a, vb = *(const guint32 *)b;
+	return (va > vb) - (va < vb);
+}
+static json_t *janus_dtls_samples_percentiles(janus_dtls_samples *samples) {
+	if(samples->count == 0)
+		return NULL;
+	guint count = samples->count;
+	guint32 values[DTLS_STATS_SAMPLES];
+	memcpy(values, samples->values, count * sizeof(guint32));
+	qsort(values, count, sizeof(guint32), janus_dtls_samples_compare);
+	json_t *percentiles = json_object();
+	json_object_set_new(percentiles, "p50", json_integer(values[(count - 1) * 50 / 100]));
+	json_object_set_new(percentiles, "p95", json_integer(values[(count - 1) * 95 / 100]));
+	json_object_set_new(percentiles, "p99", json_integer(values[(count - 1) * 99 / 100]));
+	return percentiles;
+}
+
+int janus_dtls_set_handshake_workers(guint workers) {
+	if(workers == 0 || dtls_workers != NULL)
+		return 0;
+	GError *error = NULL;
+	dtls_workers = g_thread_pool_new(janus_dtls_srtp_worker, NULL, workers, TRUE, &error);
+	if(error != NULL) {
+		JANUS_LOG(LOG_FATAL, "Got error %d (%s) trying to launch the DTLS handshake workers...\n",
+			error->code, error->message ? error->message : "??");
+		g_error_free(error);
+		dtls_workers = NULL;
+		return -1;
+	}
+	dtls_workers_num = workers;
+	JANUS_LOG(LOG_INFO, "DTLS handshakes will be offloaded to %u worker threads\n", workers);
+	return 0;
+}
+
+guint janus_dtls_get_handshake_workers(void) {
+	return dtls_workers_num;
+}
+
+void janus_dtls_set_session_resumption(gboolean enabled) {
+	if(!enabled || ssl_ctx == NULL || dtls_resumption)
+		return;
+	/* Cache sessions and hand out tickets when acting as server */
+	SSL_CTX_clear_options(ssl_ctx, SSL_OP_NO_TICKET);
+	SSL_CTX_set_session_cache_mode(ssl_ctx, SSL_SESS_CACHE_SERVER);
+	SSL_CTX_set_session_id_context(ssl_ctx, (const unsigned char *)"janus", strlen("janus"));
+	SSL_CTX_sess_set_cache_size(ssl_ctx, DTLS_SESSIONS_MAX);
+	SSL_CTX_set_timeout(ssl_ctx, DTLS_SESSION_LIFETIME);
+	/* Keep track of the sessions we can resume when acting as client */
+	dtls_sessions = g_hash_table_new_full(g_str_hash, g_str_equal, (GDestroyNotify)g_free, (GDestroyNotify)SSL_SESSION_free);
+	dtls_resumption = TRUE;
+	JANUS_LOG(LOG_INFO, "DTLS session resumption enabled\n");
+}
+
+gboolean janus_dtls_is_session_resumption_enabled(void) {
+	return dtls_resumption;
+}
+
+json_t *janus_dtls_get_handshake_stats(void) {
+	json_t *stats = json_object();
+	json_object_set_new(stats, "workers", json_integer(dtls_workers_num));
+	json_object_set_new(stats, "session-resumption", dtls_resumption ? json_true() : json_false());
+	if(dtls_workers != NULL)
+		json_object_set_new(stats, "queued-records", json_integer(g_atomic_int_get(&dtls_pending_records)));
+	janus_mutex_lock(&dtls_stats_mutex);
+	json_object_set_new(stats, "started", json_integer(dtls_handshakes_started));
+	json_object_set_new(stats, "completed", json_integer(dtls_handshakes_completed));
+	json_object_set_new(stats, "failed", json_integer(dtls_handshakes_failed));
+	if(dtls_resumption)
+		json_object_set_new(stats, "resumed", json_integer(dtls_handshakes_resumed));
+	/* How long handshakes took, and how long records waited for a worker, in microseconds */
+	json_t *latency = janus_dtls_samples_percentiles(&dtls_handshake_latency);
+	if(latency != NULL)
+		json_object_set_new(stats, "latency", latency);
+	json_t *delay = janus_dtls_samples_percentiles(&dtls_queue_delay);
+	if(delay != NULL)
+		json_object_set_new(stats, "queue-delay", delay);
+	janus_mutex_unlock(&dtls_stats_mutex);
+	return stats;
+}
+
 
 #if JANUS_USE_OPENSSL_PRE_1_1_API && !defined(HAVE_BORINGSSL)
 /*
@@ -542,11 +664,27 @@ static void janus_dtls_srtp_free(const janus_refcount *dtls_ref) {
 		}
 		/* FIXME What about dtls->remote_policy and dtls->local_policy? */
 	}
+	if(dtls->pending != NULL) {
+		g_atomic_int_add(&dtls_pending_records, -(gint)g_queue_get_length(dtls->pending));
+		g_queue_free_full(dtls->pending, (GDestroyNotify)g_free);
+		dtls->pending = NULL;
+	}
+	janus_mutex_destroy(&dtls->mutex);
 	g_free(dtls);
 	dtls = NULL;
 }
 
 void janus_dtls_srtp_cleanup(void) {
+	if(dtls_workers != NULL) {
+		g_thread_pool_free(dtls_workers, FALSE, TRUE);
+		dtls_workers = NULL;
+	}
+	janus_mutex_lock(&dtls_sessions_mutex);
+	if(dtls_sessions != NULL) {
+		g_hash_table_destroy(dtls_sessions);
+		dtls_sessions = NULL;
+	}
+	janus_mutex_unlock(&dtls_sessions_mutex);
 	if(ssl_cert != NULL) {
 		X509_free(ssl_cert);
 		ssl_cert = NULL;
@@ -581,6 +719,12 @@ janus_dtls_srtp *janus_dtls_srtp_create(void *ice_pc, janus_dtls_role role) {
 	janus_dtls_srtp *dtls = g_malloc0(sizeof(janus_dtls_srtp));
 	g_atomic_int_set(&dtls->destroyed, 0);
 	janus_refcount_init(&dtls->ref, janus_dtls_srtp_free);
+	janus_mutex_init(&dtls->mutex);
+	if(dtls_workers != NULL) {
+		/* The handshake will be performed by the DTLS workers */
+		dtls->offloaded = TRUE;
+		dtls->pending = g_queue_new();
+	}
 	/* Create SSL context, at last */
 	dtls->srtp_valid = 0;
 	dtls->ssl = SSL_new(ssl_ctx);
@@ -649,17 +793,33 @@ janus_dtls_srtp *janus_dtls_srtp_create(void *ice_pc, janus_dtls_role role) {
 void janus_dtls_srtp_handshake(janus_dtls_srtp *dtls) {
 	if(dtls == NULL || dtls->ssl == NULL)
 		return;
+	janus_mutex_lock(&dtls->mutex);
 	if(dtls->dtls_state == JANUS_DTLS_STATE_CREATED) {
 		/* Starting the handshake now: enforce the role */
 		dtls->dtls_started = janus_get_monotonic_time();
 		if(dtls->dtls_role == JANUS_DTLS_ROLE_CLIENT) {
 			SSL_set_connect_state(dtls->ssl);
+			janus_ice_peerconnection *pc = (janus_ice_peerconnection *)dtls->pc;
+			if(dtls_resumption && pc != NULL && pc->remote_fingerprint != NULL) {
+				/* Check if we can resume a session we had with this peer */
+				char *fingerprint = g_ascii_strup(pc->remote_fingerprint, -1);
+				janus_mutex_lock(&dtls_sessions_mutex);
+				SSL_SESSION *session = dtls_sessions ? g_hash_table_lookup(dtls_sessions, fingerprint) : NULL;
+				if(session != NULL)
+					SSL_set_session(dtls->ssl, session);
+				janus_mutex_unlock(&dtls_sessions_mutex);
+				g_free(fingerprint);
+			}
 		} else {
 			SSL_set_accept_state(dtls->ssl);
 		}
 		dtls->dtls_state = JANUS_DTLS_STATE_TRYING;
+		janus_mutex_lock(&dtls_stats_mutex);
+		dtls_handshakes_started++;
+		janus_mutex_unlock(&dtls_stats_mutex);
 	}
 	SSL_do_handshake(dtls->ssl);
+	janus_mutex_unlock(&dtls->mutex);
 
 	/* Notify event handlers */
 	janus_dtls_notify_state_change(dtls);
@@ -689,6 +849,362 @@ int janus_dtls_srtp_create_sctp(janus_dtls_srtp *dtls) {
 #endif
 }
 
+/* Helper to feed an incoming record to the SSL context, and read whatever is available:
+ * returns the number of bytes read, or -1 if the handshake failed */
+static int janus_dtls_srtp_read(janus_dtls_srtp *dtls, char *buf, uint16_t len, char *data, int size) {
+	janus_ice_peerconnection *pc = (janus_ice_peerconnection *)dtls->pc;
+	janus_ice_handle *handle = pc->handle;
+	int written = BIO_write(dtls->read_bio, buf, len);
+	if(written != len) {
+		JANUS_LOG(LOG_WARN, "[%"SCNu64"]     Only written %d/%d of those bytes on the read BIO...\n", handle->handle_id, written, len);
+	} else {
+		JANUS_LOG(LOG_HUGE, "[%"SCNu64"]     Written %d bytes on the read BIO...\n", handle->handle_id, written);
+	}
+	int read = SSL_read(dtls->ssl, data, size);
+	JANUS_LOG(LOG_HUGE, "[%"SCNu64"]     ... and read %d of them from SSL...\n", handle->handle_id, read);
+	if(read < 0) {
+		unsigned long err = SSL_get_error(dtls->ssl, read);
+		if(err == SSL_ERROR_SSL) {
+			/* Ops, something went wrong with the DTLS handshake */
+			char error[200];
+			ERR_error_string_n(ERR_get_error(), error, 200);
+			JANUS_LOG(LOG_ERR, "[%"SCNu64"] Handshake error: %s\n", handle->handle_id, error);
+			return -1;
+		}
+		return 0;
+	}
+	return read;
+}
+
+/* Helper to verify the peer and set SRTP up, once the DTLS handshake has been completed */
+static void janus_dtls_srtp_handshake_completed(janus_dtls_srtp *dtls) {
+	janus_ice_peerconnection *pc = (janus_ice_peerconnection *)dtls->pc;
+	janus_ice_handle *handle = pc->handle;
+	JANUS_LOG(LOG_VERB, "[%"SCNu64"] DTLS established, yay!\n", handle->handle_id);
+	/* Check the remote fingerprint */
+	X509 *rcert = SSL_get_peer_certificate(dtls->ssl);
+	if(!rcert) {
+		JANUS_LOG(LOG_ERR, "[%"SCNu64"] No remote certificate?? (%s)\n",
+			handle->handle_id, ERR_reason_error_string(ERR_get_error()));
+	} else {
+		unsigned int rsize;
+		unsigned char rfingerprint[EVP_MAX_MD_SIZE];
+		char remote_fingerprint[160];
+		char *rfp = (char *)&remote_fingerprint;
+		if(pc->remote_hashing && !strcasecmp(pc->remote_hashing, "sha-1")) {
+			JANUS_LOG(LOG_VERB, "[%"SCNu64"] Computing sha-1 fingerprint of remote certificate...\n", handle->handle_id);
+			X509_digest(rcert, EVP_sha1(), (unsigned char *)rfingerprint, &rsize);
+		} else {
+			JANUS_LOG(LOG_VERB, "[%"SCNu64"] Computing sha-256 fingerprint of remote certificate...\n", handle->handle_id);
+			X509_digest(rcert, EVP_sha256(), (unsigned char *)rfingerprint, &rsize);
+		}
+		X509_free(rcert);
+		rcert = NULL;
+		unsigned int i = 0;
+		for(i = 0; i < rsize; i++) {
+			g_snprintf(rfp, 4, "%.2X:", rfingerprint[i]);
+			rfp += 3;
+		}
+		*(rfp-1) = 0;
+		JANUS_LOG(LOG_VERB, "[%"SCNu64"] Remote fingerprint (%s) of the client is %s\n",
+			handle->handle_id, pc->remote_hashing ? pc->remote_hashing : "sha-256", remote_fingerprint);
+		if(!strcasecmp(remote_fingerprint, pc->remote_fingerprint ? pc->remote_fingerprint : "(none)")) {
+			JANUS_LOG(LOG_VERB, "[%"SCNu64"]  Fingerprint is a match!\n", handle->handle_id);
+			dtls->dtls_state = JANUS_DTLS_STATE_CONNECTED;
+			dtls->dtls_connected = janus_get_monotonic_time();
+			/* Notify event handlers */
+			janus_dtls_notify_state_change(dtls);
+		} else {
+			/* FIXME NOT a match! MITM? */
+			JANUS_LOG(LOG_ERR, "[%"SCNu64"]  Fingerprint is NOT a match! got %s, expected %s\n", handle->handle_id, remote_fingerprint, pc->remote_fingerprint);
+			dtls->dtls_state = JANUS_DTLS_STATE_FAILED;
+			/* Notify event handlers */
+			janus_dtls_notify_state_change(dtls);
+			goto done;
+		}
+		if(dtls->dtls_state == JANUS_DTLS_STATE_CONNECTED) {
+			/* Which SRTP profile is being negotiated? */
+			const SRTP_PROTECTION_PROFILE *srtp_profile = SSL_get_selected_srtp_profile(dtls->ssl);
+			if(srtp_profile == NULL) {
+				/* Should never happen, but just in case... */
+				JANUS_LOG(LOG_ERR, "[%"SCNu64"] No SRTP profile selected...\n", handle->handle_id);
+				dtls->dtls_state = JANUS_DTLS_STATE_FAILED;
+				/* Notify event handlers */
+				janus_dtls_notify_state_change(dtls);
+				goto done;
+			}
+			JANUS_LOG(LOG_VERB, "[%"SCNu64"] %s\n", handle->handle_id, srtp_profile->name);
+			int key_length = 0, salt_length = 0, master_length = 0;
+			switch(srtp_profile->id) {
+				case SRTP_AES128_CM_SHA1_80:
+				case SRTP_AES128_CM_SHA1_32:
+					key_length = SRTP_MASTER_KEY_LENGTH;
+					salt_length = SRTP_MASTER_SALT_LENGTH;
+					master_length = SRTP_MASTER_LENGTH;
+					break;
+#ifdef HAVE_SRTP_AESGCM
+				case SRTP_AEAD_AES_256_GCM:
+					key_length = SRTP_AESGCM256_MASTER_KEY_LENGTH;
+					salt_length = SRTP_AESGCM256_MASTER_SALT_LENGTH;
+					master_length = SRTP_AESGCM256_MASTER_LENGTH;
+					break;
+				case SRTP_AEAD_AES_128_GCM:
+					key_length = SRTP_AESGCM128_MASTER_KEY_LENGTH;
+					salt_length = SRTP_AESGCM128_MASTER_SALT_LENGTH;
+					master_length = SRTP_AESGCM128_MASTER_LENGTH;
+					break;
+#endif
+				default:
+					/* Will never happen? */
+					JANUS_LOG(LOG_WARN, "[%"SCNu64"] Unsupported SRTP profile %lu\n", handle->handle_id, srtp_profile->id);
+					break;
+			}
+			JANUS_LOG(LOG_VERB, "[%"SCNu64"] Key/Salt/Master: %d/%d/%d\n",
+				handle->handle_id, master_length, key_length, salt_length);
+			/* Complete with SRTP setup */
+			unsigned char material[master_length*2];
+			unsigned char *local_key, *local_salt, *remote_key, *remote_salt;
+			/* Export keying material for SRTP */
+			if(!SSL_export_keying_material(dtls->ssl, material, master_length*2, "EXTRACTOR-dtls_srtp", 19, NULL, 0, 0)) {
+				/* Oops... */
+				JANUS_LOG(LOG_ERR, "[%"SCNu64"] Oops, couldn't extract SRTP keying material for component %d in stream %d?? (%s)\n",
+					handle->handle_id, pc->component_id, pc->stream_id, ERR_reason_error_string(ERR_get_error()));
+				goto done;
+			}
+			/* Key derivation (http://tools.ietf.org/html/rfc5764#section-4.2) */
+			if(dtls->dtls_role == JANUS_DTLS_ROLE_CLIENT) {
+				local_key = material;
+				remote_key = local_key + key_length;
+				local_salt = remote_key + key_length;
+				remote_salt = local_salt + salt_length;
+			} else {
+				remote_key = material;
+				local_key = remote_key + key_length;
+				remote_salt = local_key + key_length;
+				local_salt = remote_salt + salt_length;
+			}
+			/* Build master keys and set SRTP policies */
+				/* Remote (inbound) */
+			switch(srtp_profile->id) {
+				case SRTP_AES128_CM_SHA1_80:
+					srtp_crypto_policy_set_aes_cm_128_hmac_sha1_80(&(dtls->remote_policy.rtp));
+					srtp_crypto_policy_set_aes_cm_128_hmac_sha1_80(&(dtls->remote_policy.rtcp));
+					break;
+				case SRTP_AES128_CM_SHA1_32:
+					srtp_crypto_policy_set_aes_cm_128_hmac_sha1_32(&(dtls->remote_policy.rtp));
+					srtp_crypto_policy_set_aes_cm_128_hmac_sha1_80(&(dtls->remote_policy.rtcp));
+					break;
+#ifdef HAVE_SRTP_AESGCM
+				case SRTP_AEAD_AES_256_GCM:
+					srtp_crypto_policy_set_aes_gcm_256_16_auth(&(dtls->remote_policy.rtp));
+					srtp_crypto_policy_set_aes_gcm_256_16_auth(&(dtls->remote_policy.rtcp));
+					break;
+				case SRTP_AEAD_AES_128_GCM:
+					srtp_crypto_policy_set_aes_gcm_128_16_auth(&(dtls->remote_policy.rtp));
+					srtp_crypto_policy_set_aes_gcm_128_16_auth(&(dtls->remote_policy.rtcp));
+					break;
+#endif
+				default:
+					/* Will never happen? */
+					JANUS_LOG(LOG_WARN, "[%"SCNu64"] Unsupported SRTP profile %s\n", handle->handle_id, srtp_profile->name);
+					break;
+			}
+			dtls->remote_policy.ssrc.type = ssrc_any_inbound;
+			unsigned char remote_policy_key[master_length];
+			dtls->remote_policy.key = (unsigned char *)&remote_policy_key;
+			memcpy(dtls->remote_policy.key, remote_key, key_length);
+			memcpy(dtls->remote_policy.key + key_length, remote_salt, salt_length);
+#if HAS_DTLS_WINDOW_SIZE
+			dtls->remote_policy.window_size = 128;
+			dtls->remote_policy.allow_repeat_tx = 0;
+#endif
+			dtls->remote_policy.next = NULL;
+				/* Local (outbound) */
+			switch(srtp_profile->id) {
+				case SRTP_AES128_CM_SHA1_80:
+					srtp_crypto_policy_set_aes_cm_128_hmac_sha1_80(&(dtls->local_policy.rtp));
+					srtp_crypto_policy_set_aes_cm_128_hmac_sha1_80(&(dtls->local_policy.rtcp));
+					break;
+				case SRTP_AES128_CM_SHA1_32:
+					srtp_crypto_policy_set_aes_cm_128_hmac_sha1_32(&(dtls->local_policy.rtp));
+					srtp_crypto_policy_set_aes_cm_128_hmac_sha1_80(&(dtls->local_policy.rtcp));
+					break;
+#ifdef HAVE_SRTP_AESGCM
+				case SRTP_AEAD_AES_256_GCM:
+					srtp_crypto_policy_set_aes_gcm_256_16_auth(&(dtls->local_policy.rtp));
+					srtp_crypto_policy_set_aes_gcm_256_16_auth(&(dtls->local_policy.rtcp));
+					break;
+				case SRTP_AEAD_AES_128_GCM:
+					srtp_crypto_policy_set_aes_gcm_128_16_auth(&(dtls->local_policy.rtp));
+					srtp_crypto_policy_set_aes_gcm_128_16_auth(&(dtls->local_policy.rtcp));
+					break;
+#endif
+				default:
+					/* Will never happen? */
+					JANUS_LOG(LOG_WARN, "[%"SCNu64"] Unsupported SRTP profile %s\n", handle->handle_id, srtp_profile->name);
+					break;
+			}
+			dtls->local_policy.ssrc.type = ssrc_any_outbound;
+			unsigned char local_policy_key[master_length];
+			dtls->local_policy.key = (unsigned char *)&local_policy_key;
+			memcpy(dtls->local_policy.key, local_key, key_length);
+			memcpy(dtls->local_policy.key + key_length, local_salt, salt_length);
+#if HAS_DTLS_WINDOW_SIZE
+			dtls->local_policy.window_size = 128;
+			dtls->local_policy.allow_repeat_tx = 0;
+#endif
+			dtls->local_policy.next = NULL;
+			/* Create SRTP sessions */
+			srtp_err_status_t res = srtp_create(&(dtls->srtp_in), &(dtls->remote_policy));
+			if(res != srtp_err_status_ok) {
+				/* Something went wrong... */
+				JANUS_LOG(LOG_ERR, "[%"SCNu64"] Oops, error creating inbound SRTP session for component %d in stream %d??\n", handle->handle_id, pc->component_id, pc->stream_id);
+				JANUS_LOG(LOG_ERR, "[%"SCNu64"]  -- %d (%s)\n", handle->handle_id, res, janus_srtp_error_str(res));
+				goto done;
+			}
+			JANUS_LOG(LOG_VERB, "[%"SCNu64"] Created inbound SRTP session for component %d in stream %d\n", handle->handle_id, pc->component_id, pc->stream_id);
+			res = srtp_create(&(dtls->srtp_out), &(dtls->local_policy));
+			if(res != srtp_err_status_ok) {
+				/* Something went wrong... */
+				JANUS_LOG(LOG_ERR, "[%"SCNu64"] Oops, error creating outbound SRTP session for component %d in stream %d??\n", handle->handle_id, pc->component_id, pc->stream_id);
+				JANUS_LOG(LOG_ERR, "[%"SCNu64"]  -- %d (%s)\n", handle->handle_id, res, janus_srtp_error_str(res));
+				goto done;
+			}
+			dtls->srtp_profile = srtp_profile->id;
+			dtls->srtp_valid = 1;
+			JANUS_LOG(LOG_VERB, "[%"SCNu64"] Created outbound SRTP session for component %d in stream %d\n", handle->handle_id, pc->component_id, pc->stream_id);
+#ifdef HAVE_SCTP
+			if(janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_DATA_CHANNELS)) {
+				/* Create SCTP association as well */
+				janus_dtls_srtp_create_sctp(dtls);
+			}
+#endif
+			dtls->ready = 1;
+		}
+done:
+		if(!janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_ALERT) && dtls->srtp_valid) {
+			/* Handshake successfully completed */
+			gboolean resumed = SSL_session_reused(dtls->ssl);
+			janus_mutex_lock(&dtls_stats_mutex);
+			dtls_handshakes_completed++;
+			if(resumed)
+				dtls_handshakes_resumed++;
+			janus_dtls_samples_add(&dtls_handshake_latency, dtls->dtls_connected - dtls->dtls_started);
+			janus_mutex_unlock(&dtls_stats_mutex);
+			if(resumed) {
+				JANUS_LOG(LOG_VERB, "[%"SCNu64"] Resumed a previous DTLS session\n", handle->handle_id);
+			} else if(dtls_resumption && dtls->dtls_role == JANUS_DTLS_ROLE_CLIENT) {
+				/* Keep track of this session, in case this peer comes back */
+				SSL_SESSION *session = SSL_get1_session(dtls->ssl);
+				if(session != NULL) {
+					janus_mutex_lock(&dtls_sessions_mutex);
+					if(dtls_sessions != NULL) {
+						if(g_hash_table_size(dtls_sessions) >= DTLS_SESSIONS_MAX &&
+								!g_hash_table_contains(dtls_sessions, remote_fingerprint)) {
+							/* Too many sessions, get rid of one */
+							GHashTableIter iter;
+							g_hash_table_iter_init(&iter, dtls_sessions);
+							if(g_hash_table_iter_next(&iter, NULL, NULL))
+								g_hash_table_iter_remove(&iter);
+						}
+						g_hash_table_insert(dtls_sessions, g_strdup(remote_fingerprint), session);
+						session = NULL;
+					}
+					janus_mutex_unlock(&dtls_sessions_mutex);
+					if(session != NULL)
+						SSL_SESSION_free(session);
+				}
+			}
+			janus_ice_dtls_handshake_done(handle);
+		} else {
+			janus_mutex_lock(&dtls_stats_mutex);
+			dtls_handshakes_failed++;
+			janus_mutex_unlock(&dtls_stats_mutex);
+			/* Something went wrong in either DTLS or SRTP... tell the plugin about it */
+			janus_dtls_callback(dtls->ssl, SSL_CB_ALERT, 0);
+			janus_flags_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_CLEANING);
+		}
+	}
+}
+
+/* Callback invoked on the loop of the handle, when the workers completed a handshake */
+static gboolean janus_dtls_srtp_offload_done(gpointer user_data) {
+	janus_dtls_srtp *dtls = (janus_dtls_srtp *)user_data;
+	if(g_atomic_int_get(&dtls->destroyed))
+		return G_SOURCE_REMOVE;
+	janus_ice_peerconnection *pc = (janus_ice_peerconnection *)dtls->pc;
+	janus_ice_handle *handle = pc ? pc->handle : NULL;
+	if(handle == NULL || janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_ALERT) ||
+			janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_STOP) || janus_is_stopping())
+		return G_SOURCE_REMOVE;
+	JANUS_LOG(LOG_HUGE, "[%"SCNu64"] DTLS handshake completed by the workers\n", handle->handle_id);
+	janus_dtls_srtp_handshake_completed(dtls);
+	/* From now on, records are processed on the loop: take care of those that were waiting */
+	janus_mutex_lock(&dtls->mutex);
+	dtls->offloaded = FALSE;
+	GQueue *pending = dtls->pending;
+	dtls->pending = NULL;
+	janus_mutex_unlock(&dtls->mutex);
+	janus_dtls_record *record = NULL;
+	while(pending != NULL && (record = g_queue_pop_head(pending)) != NULL) {
+		g_atomic_int_dec_and_test(&dtls_pending_records);
+		janus_dtls_srtp_incoming_msg(dtls, record->data, record->len);
+		g_free(record);
+	}
+	if(pending != NULL)
+		g_queue_free_full(pending, (GDestroyNotify)g_free);
+	return G_SOURCE_REMOVE;
+}
+
+static void janus_dtls_srtp_unref(gpointer user_data) {
+	janus_dtls_srtp *dtls = (janus_dtls_srtp *)user_data;
+	janus_refcount_decrease(&dtls->ref);
+}
+
+/* Thread pool function: process the records queued for a DTLS stack until
+ * the handshake is completed, at which point the loop will take over */
+static void janus_dtls_srtp_worker(gpointer data, gpointer user_data) {
+	janus_dtls_srtp *dtls = (janus_dtls_srtp *)data;
+	char buf[1500];
+	while(TRUE) {
+		janus_mutex_lock(&dtls->mutex);
+		janus_dtls_record *record = NULL;
+		if(!g_atomic_int_get(&dtls->destroyed) && !dtls->offload_done && dtls->pending != NULL)
+			record = g_queue_pop_head(dtls->pending);
+		if(record == NULL) {
+			dtls->scheduled = FALSE;
+			janus_mutex_unlock(&dtls->mutex);
+			break;
+		}
+		g_atomic_int_dec_and_test(&dtls_pending_records);
+		gint64 now = janus_get_monotonic_time();
+		janus_mutex_lock(&dtls_stats_mutex);
+		janus_dtls_samples_add(&dtls_queue_delay, now - record->queued);
+		janus_mutex_unlock(&dtls_stats_mutex);
+		/* The stack can't be destroyed while we hold the lock, so the PeerConnection is still there */
+		janus_ice_peerconnection *pc = (janus_ice_peerconnection *)dtls->pc;
+		janus_ice_handle *handle = pc ? pc->handle : NULL;
+		if(handle != NULL && handle->agent != NULL &&
+				!janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_ALERT) &&
+				!janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_STOP) && !janus_is_stopping()) {
+			janus_dtls_srtp_read(dtls, record->data, record->len, buf, sizeof(buf));
+			if(SSL_is_init_finished(dtls->ssl)) {
+				/* Done, let the loop of the handle check the peer and set SRTP up */
+				dtls->offload_done = TRUE;
+				janus_refcount_increase(&dtls->ref);
+				GSource *source = g_idle_source_new();
+				g_source_set_priority(source, G_PRIORITY_DEFAULT);
+				g_source_set_callback(source, janus_dtls_srtp_offload_done, dtls, janus_dtls_srtp_unref);
+				g_source_attach(source, handle->mainctx);
+				g_source_unref(source);
+			}
+		}
+		janus_mutex_unlock(&dtls->mutex);
+		g_free(record);
+	}
+	janus_refcount_decrease(&dtls->ref);
+}
+
 void janus_dtls_srtp_incoming_msg(janus_dtls_srtp *dtls, char *buf, uint16_t len) {
 	if(dtls == NULL) {
 		JANUS_LOG(LOG_ERR, "No DTLS-SRTP stack, no incoming message...\n");
@@ -716,26 +1232,31 @@ void janus_dtls_srtp_incoming_msg(janus_dtls_srtp *dtls, char *buf, uint16_t len
 		/* Handshake not started yet: maybe we're still waiting for the answer and the DTLS role? */
 		return;
 	}
-	int written = BIO_write(dtls->read_bio, buf, len);
-	if(written != len) {
-		JANUS_LOG(LOG_WARN, "[%"SCNu64"]     Only written %d/%d of those bytes on the read BIO...\n", handle->handle_id, written, len);
-	} else {
-		JANUS_LOG(LOG_HUGE, "[%"SCNu64"]     Written %d bytes on the read BIO...\n", handle->handle_id, written);
-	}
-	/* Try to read data */
-	char data[1500];	/* FIXME */
-	int read = SSL_read(dtls->ssl, &data, 1500);
-	JANUS_LOG(LOG_HUGE, "[%"SCNu64"]     ... and read %d of them from SSL...\n", handle->handle_id, read);
-	if(read < 0) {
-		unsigned long err = SSL_get_error(dtls->ssl, read);
-		if(err == SSL_ERROR_SSL) {
-			/* Ops, something went wrong with the DTLS handshake */
-			char error[200];
-			ERR_error_string_n(ERR_get_error(), error, 200);
-			JANUS_LOG(LOG_ERR, "[%"SCNu64"] Handshake error: %s\n", handle->handle_id, error);
+	if(dtls->offloaded) {
+		/* The handshake is being performed by the DTLS workers: queue the record */
+		janus_mutex_lock(&dtls->mutex);
+		if(dtls->offloaded) {
+			janus_dtls_record *record = g_malloc(sizeof(janus_dtls_record) + len);
+			record->queued = janus_get_monotonic_time();
+			record->len = len;
+			memcpy(record->data, buf, len);
+			g_queue_push_tail(dtls->pending, record);
+			g_atomic_int_inc(&dtls_pending_records);
+			if(!dtls->scheduled && !dtls->offload_done) {
+				dtls->scheduled = TRUE;
+				janus_refcount_increase(&dtls->ref);
+				g_thread_pool_push(dtls_workers, dtls, NULL);
+			}
+			janus_mutex_unlock(&dtls->mutex);
 			return;
 		}
+		janus_mutex_unlock(&dtls->mutex);
 	}
+	/* Try to read data */
+	char data[1500];	/* FIXME */
+	int read = janus_dtls_srtp_read(dtls, buf, len, data, sizeof(data));
+	if(read < 0)
+		return;
 	if(janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_STOP) || janus_is_stopping()) {
 		/* DTLS alert triggered, we should end it here */
 		JANUS_LOG(LOG_VERB, "[%"SCNu64"] Forced to stop it here...\n", handle->handle_id);
@@ -760,234 +1281,34 @@ void janus_dtls_srtp_incoming_msg(janus_dtls_srtp *dtls, char *buf, uint16_t len
 		}
 #endif
 	} else {
-		JANUS_LOG(LOG_VERB, "[%"SCNu64"] DTLS established, yay!\n", handle->handle_id);
-		/* Check the remote fingerprint */
-		X509 *rcert = SSL_get_peer_certificate(dtls->ssl);
-		if(!rcert) {
-			JANUS_LOG(LOG_ERR, "[%"SCNu64"] No remote certificate?? (%s)\n",
-				handle->handle_id, ERR_reason_error_string(ERR_get_error()));
-		} else {
-			unsigned int rsize;
-			unsigned char rfingerprint[EVP_MAX_MD_SIZE];
-			char remote_fingerprint[160];
-			char *rfp = (char *)&remote_fingerprint;
-			if(pc->remote_hashing && !strcasecmp(pc->remote_hashing, "sha-1")) {
-				JANUS_LOG(LOG_VERB, "[%"SCNu64"] Computing sha-1 fingerprint of remote certificate...\n", handle->handle_id);
-				X509_digest(rcert, EVP_sha1(), (unsigned char *)rfingerprint, &rsize);
-			} else {
-				JANUS_LOG(LOG_VERB, "[%"SCNu64"] Computing sha-256 fingerprint of remote certificate...\n", handle->handle_id);
-				X509_digest(rcert, EVP_sha256(), (unsigned char *)rfingerprint, &rsize);
-			}
-			X509_free(rcert);
-			rcert = NULL;
-			unsigned int i = 0;
-			for(i = 0; i < rsize; i++) {
-				g_snprintf(rfp, 4, "%.2X:", rfingerprint[i]);
-				rfp += 3;
-			}
-			*(rfp-1) = 0;
-			JANUS_LOG(LOG_VERB, "[%"SCNu64"] Remote fingerprint (%s) of the client is %s\n",
-				handle->handle_id, pc->remote_hashing ? pc->remote_hashing : "sha-256", remote_fingerprint);
-			if(!strcasecmp(remote_fingerprint, pc->remote_fingerprint ? pc->remote_fingerprint : "(none)")) {
-				JANUS_LOG(LOG_VERB, "[%"SCNu64"]  Fingerprint is a match!\n", handle->handle_id);
-				dtls->dtls_state = JANUS_DTLS_STATE_CONNECTED;
-				dtls->dtls_connected = janus_get_monotonic_time();
-				/* Notify event handlers */
-				janus_dtls_notify_state_change(dtls);
-			} else {
-				/* FIXME NOT a match! MITM? */
-				JANUS_LOG(LOG_ERR, "[%"SCNu64"]  Fingerprint is NOT a match! got %s, expected %s\n", handle->handle_id, remote_fingerprint, pc->remote_fingerprint);
-				dtls->dtls_state = JANUS_DTLS_STATE_FAILED;
-				/* Notify event handlers */
-				janus_dtls_notify_state_change(dtls);
-				goto done;
-			}
-			if(dtls->dtls_state == JANUS_DTLS_STATE_CONNECTED) {
-				/* Which SRTP profile is being negotiated? */
-				const SRTP_PROTECTION_PROFILE *srtp_profile = SSL_get_selected_srtp_profile(dtls->ssl);
-				if(srtp_profile == NULL) {
-					/* Should never happen, but just in case... */
-					JANUS_LOG(LOG_ERR, "[%"SCNu64"] No SRTP profile selected...\n", handle->handle_id);
-					dtls->dtls_state = JANUS_DTLS_STATE_FAILED;
-					/* Notify event handlers */
-					janus_dtls_notify_state_change(dtls);
-					goto done;
-				}
-				JANUS_LOG(LOG_VERB, "[%"SCNu64"] %s\n", handle->handle_id, srtp_profile->name);
-				int key_length = 0, salt_length = 0, master_length = 0;
-				switch(srtp_profile->id) {
-					case SRTP_AES128_CM_SHA1_80:
-					case SRTP_AES128_CM_SHA1_32:
-						key_length = SRTP_MASTER_KEY_LENGTH;
-						salt_length = SRTP_MASTER_SALT_LENGTH;
-						master_length = SRTP_MASTER_LENGTH;
-						break;
-#ifdef HAVE_SRTP_AESGCM
-					case SRTP_AEAD_AES_256_GCM:
-						key_length = SRTP_AESGCM256_MASTER_KEY_LENGTH;
-						salt_length = SRTP_AESGCM256_MASTER_SALT_LENGTH;
-						master_length = SRTP_AESGCM256_MASTER_LENGTH;
-						break;
-					case SRTP_AEAD_AES_128_GCM:
-						key_length = SRTP_AESGCM128_MASTER_KEY_LENGTH;
-						salt_length = SRTP_AESGCM128_MASTER_SALT_LENGTH;
-						master_length = SRTP_AESGCM128_MASTER_LENGTH;
-						break;
-#endif
-					default:
-						/* Will never happen? */
-						JANUS_LOG(LOG_WARN, "[%"SCNu64"] Unsupported SRTP profile %lu\n", handle->handle_id, srtp_profile->id);
-						break;
-				}
-				JANUS_LOG(LOG_VERB, "[%"SCNu64"] Key/Salt/Master: %d/%d/%d\n",
-					handle->handle_id, master_length, key_length, salt_length);
-				/* Complete with SRTP setup */
-				unsigned char material[master_length*2];
-				unsigned char *local_key, *local_salt, *remote_key, *remote_salt;
-				/* Export keying material for SRTP */
-				if(!SSL_export_keying_material(dtls->ssl, material, master_length*2, "EXTRACTOR-dtls_srtp", 19, NULL, 0, 0)) {
-					/* Oops... */
-					JANUS_LOG(LOG_ERR, "[%"SCNu64"] Oops, couldn't extract SRTP keying material for component %d in stream %d?? (%s)\n",
-						handle->handle_id, pc->component_id, pc->stream_id, ERR_reason_error_string(ERR_get_error()));
-					goto done;
-				}
-				/* Key derivation (http://tools.ietf.org/html/rfc5764#section-4.2) */
-				if(dtls->dtls_role == JANUS_DTLS_ROLE_CLIENT) {
-					local_key = material;
-					remote_key = local_key + key_length;
-					local_salt = remote_key + key_length;
-					remote_salt = local_salt + salt_length;
-				} else {
-					remote_key = material;
-					local_key = remote_key + key_length;
-					remote_salt = local_key + key_length;
-					local_salt = remote_salt + salt_length;
-				}
-				/* Build master keys and set SRTP policies */
-					/* Remote (inbound) */
-				switch(srtp_profile->id) {
-					case SRTP_AES128_CM_SHA1_80:
-						srtp_crypto_policy_set_aes_cm_128_hmac_sha1_80(&(dtls->remote_policy.rtp));
-						srtp_crypto_policy_set_aes_cm_128_hmac_sha1_80(&(dtls->remote_policy.rtcp));
-						break;
-					case SRTP_AES128_CM_SHA1_32:
-						srtp_crypto_policy_set_aes_cm_128_hmac_sha1_32(&(dtls->remote_policy.rtp));
-						srtp_crypto_policy_set_aes_cm_128_hmac_sha1_80(&(dtls->remote_policy.rtcp));
-						break;
-#ifdef HAVE_SRTP_AESGCM
-					case SRTP_AEAD_AES_256_GCM:
-						srtp_crypto_policy_set_aes_gcm_256_16_auth(&(dtls->remote_policy.rtp));
-						srtp_crypto_policy_set_aes_gcm_256_16_auth(&(dtls->remote_policy.rtcp));
-						break;
-					case SRTP_AEAD_AES_128_GCM:
-						srtp_crypto_policy_set_aes_gcm_128_16_auth(&(dtls->remote_policy.rtp));
-						srtp_crypto_policy_set_aes_gcm_128_16_auth(&(dtls->remote_policy.rtcp));
-						break;
-#endif
-					default:
-						/* Will never happen? */
-						JANUS_LOG(LOG_WARN, "[%"SCNu64"] Unsupported SRTP profile %s\n", handle->handle_id, srtp_profile->name);
-						break;
-				}
-				dtls->remote_policy.ssrc.type = ssrc_any_inbound;
-				unsigned char remote_policy_key[master_length];
-				dtls->remote_policy.key = (unsigned char *)&remote_policy_key;
-				memcpy(dtls->remote_policy.key, remote_key, key_length);
-				memcpy(dtls->remote_policy.key + key_length, remote_salt, salt_length);
-#if HAS_DTLS_WINDOW_SIZE
-				dtls->remote_policy.window_size = 128;
-				dtls->remote_policy.allow_repeat_tx = 0;
-#endif
-				dtls->remote_policy.next = NULL;
-					/* Local (outbound) */
-				switch(srtp_profile->id) {
-					case SRTP_AES128_CM_SHA1_80:
-						srtp_crypto_policy_set_aes_cm_128_hmac_sha1_80(&(dtls->local_policy.rtp));
-						srtp_crypto_policy_set_aes_cm_128_hmac_sha1_80(&(dtls->local_policy.rtcp));
-						break;
-					case SRTP_AES128_CM_SHA1_32:
-						srtp_crypto_policy_set_aes_cm_128_hmac_sha1_32(&(dtls->local_policy.rtp));
-						srtp_crypto_policy_set_aes_cm_128_hmac_sha1_80(&(dtls->local_policy.rtcp));
-						break;
-#ifdef HAVE_SRTP_AESGCM
-					case SRTP_AEAD_AES_256_GCM:
-						srtp_crypto_policy_set_aes_gcm_256_16_auth(&(dtls->local_policy.rtp));
-						srtp_crypto_policy_set_aes_gcm_256_16_auth(&(dtls->local_policy.rtcp));
-						break;
-					case SRTP_AEAD_AES_128_GCM:
-						srtp_crypto_policy_set_aes_gcm_128_16_auth(&(dtls->local_policy.rtp));
-						srtp_crypto_policy_set_aes_gcm_128_16_auth(&(dtls->local_policy.rtcp));
-						break;
-#endif
-					default:
-						/* Will never happen? */
-						JANUS_LOG(LOG_WARN, "[%"SCNu64"] Unsupported SRTP profile %s\n", handle->handle_id, srtp_profile->name);
-						break;
-				}
-				dtls->local_policy.ssrc.type = ssrc_any_outbound;
-				unsigned char local_policy_key[master_length];
-				dtls->local_policy.key = (unsigned char *)&local_policy_key;
-				memcpy(dtls->local_policy.key, local_key, key_length);
-				memcpy(dtls->local_policy.key + key_length, local_salt, salt_length);
-#if HAS_DTLS_WINDOW_SIZE
-				dtls->local_policy.window_size = 128;
-				dtls->local_policy.allow_repeat_tx = 0;
-#endif
-				dtls->local_policy.next = NULL;
-				/* Create SRTP sessions */
-				srtp_err_status_t res = srtp_create(&(dtls->srtp_in), &(dtls->remote_policy));
-				if(res != srtp_err_status_ok) {
-					/* Something went wrong... */
-					JANUS_LOG(LOG_ERR, "[%"SCNu64"] Oops, error creating inbound SRTP session for component %d in stream %d??\n", handle->handle_id, pc->component_id, pc->stream_id);
-					JANUS_LOG(LOG_ERR, "[%"SCNu64"]  -- %d (%s)\n", handle->handle_id, res, janus_srtp_error_str(res));
-					goto done;
-				}
-				JANUS_LOG(LOG_VERB, "[%"SCNu64"] Created inbound SRTP session for component %d in stream %d\n", handle->handle_id, pc->component_id, pc->stream_id);
-				res = srtp_create(&(dtls->srtp_out), &(dtls->local_policy));
-				if(res != srtp_err_status_ok) {
-					/* Something went wrong... */
-					JANUS_LOG(LOG_ERR, "[%"SCNu64"] Oops, error creating outbound SRTP session for component %d in stream %d??\n", handle->handle_id, pc->component_id, pc->stream_id);
-					JANUS_LOG(LOG_ERR, "[%"SCNu64"]  -- %d (%s)\n", handle->handle_id, res, janus_srtp_error_str(res));
-					goto done;
-				}
-				dtls->srtp_profile = srtp_profile->id;
-				dtls->srtp_valid = 1;
-				JANUS_LOG(LOG_VERB, "[%"SCNu64"] Created outbound SRTP session for component %d in stream %d\n", handle->handle_id, pc->component_id, pc->stream_id);
-#ifdef HAVE_SCTP
-				if(janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_DATA_CHANNELS)) {
-					/* Create SCTP association as well */
-					janus_dtls_srtp_create_sctp(dtls);
-				}
-#endif
-				dtls->ready = 1;
-			}
-done:
-			if(!janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_ALERT) && dtls->srtp_valid) {
-				/* Handshake successfully completed */
-				janus_ice_dtls_handshake_done(handle);
-			} else {
-				/* Something went wrong in either DTLS or SRTP... tell the plugin about it */
-				janus_dtls_callback(dtls->ssl, SSL_CB_ALERT, 0);
-				janus_flags_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_CLEANING);
-			}
-		}
+		janus_dtls_srtp_handshake_completed(dtls);
 	}
 }
 
+
 void janus_dtls_srtp_send_alert(janus_dtls_srtp *dtls) {
 	if(!dtls)
 		return;
 	/* Send alert */
 	janus_refcount_increase(&dtls->ref);
 	if(dtls != NULL && dtls->ssl != NULL) {
+		janus_mutex_lock(&dtls->mutex);
 		SSL_shutdown(dtls->ssl);
+		janus_mutex_unlock(&dtls->mutex);
 	}
 	janus_refcount_decrease(&dtls->ref);
 }
 
 void janus_dtls_srtp_destroy(janus_dtls_srtp *dtls) {
-	if(!dtls || !g_atomic_int_compare_and_exchange(&dtls->destroyed, 0, 1))
+	if(!dtls)
+		return;
+	/* If a worker is processing a record, wait for it to be done */
+	janus_mutex_lock(&dtls->mutex);
+	if(!g_atomic_int_compare_and_exchange(&dtls->destroyed, 0, 1)) {
+		janus_mutex_unlock(&dtls->mutex);
 		return;
+	}
+	janus_mutex_unlock(&dtls->mutex);
 	dtls->ready = 0;
 	dtls->retransmissions = 0;
 #ifdef HAVE_SCTP
@@ -1119,9 +1440,13 @@ gboolean janus_dtls_retry(gpointer stack) {
 		janus_ice_webrtc_hangup(handle, "DTLS timeout");
 		goto stoptimer;
 	}
+	/* If a worker is busy with the handshake, there's nothing to retransmit right now */
+	if(!janus_mutex_trylock(&dtls->mutex))
+		return TRUE;
 	struct timeval timeout = {0};
 	if(DTLSv1_get_timeout(dtls->ssl, &timeout) == 0) {
 		/* failed to get timeout. try again on next iter */
+		janus_mutex_unlock(&dtls->mutex);
 		return TRUE;
 	}
 	guint64 timeout_value = timeout.tv_sec*1000 + timeout.tv_usec/1000;
@@ -1136,11 +1461,13 @@ gboolean janus_dtls_retry(gpointer stack) {
 		if(res == -1 && SSL_get_error(dtls->ssl, res) != SSL_ERROR_WANT_WRITE) {
 			/* DTLSv1_handle_timeout returned an unrecoverable error, fail right away
 			 * Ref.: https://webrtc-review.googlesource.com/c/src/+/260100 */
+			janus_mutex_unlock(&dtls->mutex);
 			JANUS_LOG(LOG_ERR, "[%"SCNu64"] DTLSv1_handle_timeout failed...\n", handle->handle_id);
 			janus_ice_webrtc_hangup(handle, "DTLS error");
 			goto stoptimer;
 		}
 	}
+	janus_mutex_unlock(&dtls->mutex);
 	return TRUE;
 
 stoptimer:
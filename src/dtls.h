@@ -17,10 +17,12 @@
 
 #include <inttypes.h>
 #include <glib.h>
+#include <jansson.h>
 
 #include "rtp.h"
 #include "rtpsrtp.h"
 #include "sctp.h"
+#include "mutex.h"
 #include "refcount.h"
 #include "dtls-bio.h"
 
@@ -45,6 +47,30 @@ void janus_dtls_srtp_cleanup(void);
 gchar *janus_dtls_get_local_fingerprint(void);
 /*! \brief Method to check whether DTLS self-signed certificates are ok (default) or not */
 gboolean janus_dtls_are_selfsigned_certs_ok(void);
+/*! \brief Method to offload DTLS handshakes to a pool of worker threads
+ * \details By default, handshakes are performed on the loop of the handle
+ * the PeerConnection belongs to, which means that the crypto operations
+ * they involve delay the media of all the other handles sharing the same
+ * loop. When workers are configured, handshake records are processed by
+ * the pool instead, and the loop only takes care of the SRTP setup once
+ * the handshake has been completed.
+ * @param[in] workers Number of worker threads to start (0 keeps handshakes on the loops)
+ * @returns 0 in case of success, a negative integer on errors */
+int janus_dtls_set_handshake_workers(guint workers);
+/*! \brief Method to return the number of DTLS handshake workers
+ * @returns The number of workers, 0 if handshakes are not offloaded */
+guint janus_dtls_get_handshake_workers(void);
+/*! \brief Method to enable DTLS session resumption
+ * \details When enabled, we cache sessions when acting as DTLS server, and
+ * hand out session tickets, while as DTLS clients we try to resume the
+ * last session we had with peers presenting the same certificate
+ * @param[in] enabled Whether session resumption should be enabled or not */
+void janus_dtls_set_session_resumption(gboolean enabled);
+/*! \brief Method to check whether DTLS session resumption is enabled or not */
+gboolean janus_dtls_is_session_resumption_enabled(void);
+/*! \brief Method to get statistics on the DTLS handshakes performed so far (for the info request)
+ * @returns A json_t object with the statistics */
+json_t *janus_dtls_get_handshake_stats(void);
 
 
 /*! \brief DTLS roles */
@@ -96,6 +122,16 @@ typedef struct janus_dtls_srtp {
 	int ready;
 	/*! \brief The number of retransmissions that have occurred for this DTLS instance so far */
 	int retransmissions;
+	/*! \brief Whether the handshake is being handled by the DTLS workers, rather than the loop */
+	gboolean offloaded;
+	/*! \brief Whether a DTLS worker is currently processing records for this instance */
+	gboolean scheduled;
+	/*! \brief Whether the DTLS workers completed the handshake, and the loop is taking over */
+	gboolean offload_done;
+	/*! \brief Records waiting to be processed by the DTLS workers */
+	GQueue *pending;
+	/*! \brief Mutex to serialize the access to the SSL context, when handshakes are offloaded */
+	janus_mutex mutex;
 #ifdef HAVE_SCTP
 	/*! \brief SCTP association, if DataChannels are involved */
 	janus_sctp_association *sctp;
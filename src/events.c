@@ -43,6 +43,82 @@ static json_t exit_event;
 static GThread *events_thread;
 void *janus_events_thread(void *data);
 
+/* Aggregation of media statistics, if enabled: handlers that are
+ * interested in aggregates get periodic summaries (per plugin and media
+ * type) instead of the per-handle statistics, plus the raw statistics
+ * of streams that crossed one of the configured thresholds */
+static int stats_window = 0;
+static gboolean stats_by_opaque_id = FALSE;
+static GHashTable *stats_handlers = NULL;
+static int stats_outlier_rtt = 0, stats_outlier_jitter = 0, stats_outlier_lost = 0;
+/* All the following is only accessed by the events thread */
+static GHashTable *stats_handles = NULL, *stats_groups = NULL;
+static gint64 stats_window_start = 0;
+typedef struct janus_events_stats_handle {
+	char *plugin;
+	char *opaque_id;
+	GHashTable *streams;
+} janus_events_stats_handle;
+typedef struct janus_events_stats_stream {
+	gint64 lost;
+	gboolean started;
+	gboolean outlier;
+} janus_events_stats_stream;
+typedef struct janus_events_stats_metric {
+	GArray *values;
+	gint64 sum, min, max;
+} janus_events_stats_metric;
+typedef struct janus_events_stats_group {
+	char *plugin;
+	char *opaque_id;
+	char *media;
+	GHashTable *handles;
+	guint samples;
+	janus_events_stats_metric rtt, jitter_local, jitter_remote, lost;
+} janus_events_stats_group;
+static void janus_events_stats_handle_free(janus_events_stats_handle *h);
+static void janus_events_stats_group_free(janus_events_stats_group *g);
+static void janus_events_stats_track_handle(json_t *event);
+static gboolean janus_events_stats_update(json_t *event);
+static void janus_events_stats_flush(void);
+static gboolean janus_events_handler_wants_aggregates(janus_eventhandler *e);
+static void janus_events_dispatch(json_t *event, int type, gboolean stats, gboolean outlier);
+
+void janus_events_set_stats_aggregation(int window, const char *handlers, gboolean by_opaque_id,
+		int rtt, int jitter, int lost) {
+	if(stats_handlers != NULL) {
+		g_hash_table_destroy(stats_handlers);
+		stats_handlers = NULL;
+	}
+	stats_window = window > 0 ? window : 0;
+	stats_by_opaque_id = by_opaque_id;
+	stats_outlier_rtt = rtt > 0 ? rtt : 0;
+	stats_outlier_jitter = jitter > 0 ? jitter : 0;
+	stats_outlier_lost = lost > 0 ? lost : 0;
+	if(stats_window == 0 || handlers == NULL || !strcasecmp(handlers, "all"))
+		return;
+	/* Only some handlers want aggregated statistics */
+	stats_handlers = g_hash_table_new_full(g_str_hash, g_str_equal, (GDestroyNotify)g_free, NULL);
+	gchar **list = g_strsplit(handlers, ",", -1);
+	int i = 0;
+	for(i=0; list && list[i]; i++) {
+		char *name = g_strstrip(list[i]);
+		if(strlen(name) > 0)
+			g_hash_table_insert(stats_handlers, g_strdup(name), GINT_TO_POINTER(1));
+	}
+	g_strfreev(list);
+}
+
+int janus_events_get_stats_aggregation_window(void) {
+	return stats_window;
+}
+
+gboolean janus_events_is_stats_aggregated(const char *package) {
+	if(stats_window == 0 || package == NULL)
+		return FALSE;
+	return stats_handlers == NULL || g_hash_table_lookup(stats_handlers, package) != NULL;
+}
+
 int janus_events_init(gboolean enabled, char *server_name, GHashTable *handlers) {
 	eventsenabled = enabled;
 	if(eventsenabled) {
@@ -50,6 +126,13 @@ int janus_events_init(gboolean enabled, char *server_name, GHashTable *handlers)
 		if(server_name != NULL)
 			server = g_strdup(server_name);
 		eventhandlers = handlers;
+		if(stats_window > 0) {
+			stats_handles = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+				(GDestroyNotify)g_free, (GDestroyNotify)janus_events_stats_handle_free);
+			stats_groups = g_hash_table_new_full(g_str_hash, g_str_equal,
+				(GDestroyNotify)g_free, (GDestroyNotify)janus_events_stats_group_free);
+			JANUS_LOG(LOG_INFO, "Aggregating media statistics for event handlers every %d seconds\n", stats_window);
+		}
 		/* We setup a thread for passing events to the handlers */
 		GError *error = NULL;
 		events_thread = g_thread_try_new("janus events thread", janus_events_thread, NULL, &error);
@@ -78,6 +161,15 @@ void janus_events_deinit(void) {
 	if(events != NULL)
 		g_async_queue_unref(events);
 	g_free(server);
+	if(stats_handles != NULL)
+		g_hash_table_destroy(stats_handles);
+	stats_handles = NULL;
+	if(stats_groups != NULL)
+		g_hash_table_destroy(stats_groups);
+	stats_groups = NULL;
+	if(stats_handlers != NULL)
+		g_hash_table_destroy(stats_handlers);
+	stats_handlers = NULL;
 }
 
 gboolean janus_events_is_enabled(void) {
@@ -278,36 +370,41 @@ void *janus_events_thread(void *data) {
 	JANUS_LOG(LOG_VERB, "Joining Events handler thread\n");
 	json_t *event = NULL;
 
+	stats_window_start = janus_get_monotonic_time();
 	while(eventsenabled) {
 		/* Any event in queue? */
-		event = g_async_queue_pop(events);
+		if(stats_window > 0) {
+			/* We're aggregating statistics, so don't wait longer than the end of the window */
+			gint64 now = janus_get_monotonic_time();
+			gint64 end = stats_window_start + (gint64)stats_window*G_USEC_PER_SEC;
+			if(now >= end) {
+				janus_events_stats_flush();
+				stats_window_start = now;
+				end = now + (gint64)stats_window*G_USEC_PER_SEC;
+			}
+			event = g_async_queue_timeout_pop(events, end-now);
+			if(event == NULL)
+				continue;
+		} else {
+			event = g_async_queue_pop(events);
+		}
 		if(event == &exit_event)
 			break;
 
-		/* Notify all interested handlers, increasing the event reference to make sure it's not lost because of errors */
 		int type = json_integer_value(json_object_get(event, "type"));
-		guint count = g_hash_table_size(eventhandlers);
-		GHashTableIter iter;
-		gpointer value;
-		g_hash_table_iter_init(&iter, eventhandlers);
-		json_incref(event);
-		while(g_hash_table_iter_next(&iter, NULL, &value)) {
-			janus_eventhandler *e = value;
-			if(e == NULL)
-				continue;
-			if(!janus_flags_is_set(&e->events_mask, type))
-				continue;
-			if(count == 1) {
-				/* Single event handler: pass this instance directly */
-				e->incoming_event(event);
-			} else {
-				/* Multiple event handlers, that may modify the event: pass a copy */
-				json_t *copy = json_deep_copy(event);
-				e->incoming_event(copy);
-				json_decref(copy);
+		gboolean stats = FALSE, outlier = FALSE;
+		if(stats_window > 0) {
+			/* Keep track of which plugin handles are attached to, and aggregate statistics */
+			if(type == JANUS_EVENT_TYPE_HANDLE) {
+				janus_events_stats_track_handle(event);
+			} else if(type == JANUS_EVENT_TYPE_MEDIA &&
+					json_integer_value(json_object_get(event, "subtype")) == JANUS_EVENT_SUBTYPE_MEDIA_STATS) {
+				stats = TRUE;
+				outlier = janus_events_stats_update(event);
 			}
 		}
-		json_decref(event);
+		/* Notify all interested handlers */
+		janus_events_dispatch(event, type, stats, outlier);
 
 		/* Unref the final event reference, interested handlers will have their own reference */
 		json_decref(event);
@@ -323,6 +420,273 @@ void *janus_events_thread(void *data) {
 	return NULL;
 }
 
+/* Helper to pass an event to all interested handlers: statistics are only
+ * passed to handlers that want aggregates when they're outliers */
+static void janus_events_dispatch(json_t *event, int type, gboolean stats, gboolean outlier) {
+	/* Increase the event reference to make sure it's not lost because of errors */
+	guint count = g_hash_table_size(eventhandlers);
+	GHashTableIter iter;
+	gpointer value;
+	g_hash_table_iter_init(&iter, eventhandlers);
+	json_incref(event);
+	while(g_hash_table_iter_next(&iter, NULL, &value)) {
+		janus_eventhandler *e = value;
+		if(e == NULL)
+			continue;
+		if(!janus_flags_is_set(&e->events_mask, type))
+			continue;
+		if(stats && !outlier && janus_events_handler_wants_aggregates(e))
+			continue;
+		if(count == 1) {
+			/* Single event handler: pass this instance directly */
+			e->incoming_event(event);
+		} else {
+			/* Multiple event handlers, that may modify the event: pass a copy */
+			json_t *copy = json_deep_copy(event);
+			e->incoming_event(copy);
+			json_decref(copy);
+		}
+	}
+	json_decref(event);
+}
+
+static gboolean janus_events_handler_wants_aggregates(janus_eventhandler *e) {
+	return janus_events_is_stats_aggregated(e->get_package());
+}
+
+/* Media statistics aggregation */
+static void janus_events_stats_handle_free(janus_events_stats_handle *h) {
+	if(h == NULL)
+		return;
+	g_free(h->plugin);
+	g_free(h->opaque_id);
+	g_hash_table_destroy(h->streams);
+	g_free(h);
+}
+
+static janus_events_stats_handle *janus_events_stats_handle_create(guint64 handle_id) {
+	janus_events_stats_handle *h = g_malloc0(sizeof(janus_events_stats_handle));
+	h->streams = g_hash_table_new_full(g_str_hash, g_str_equal, (GDestroyNotify)g_free, (GDestroyNotify)g_free);
+	g_hash_table_insert(stats_handles, janus_uint64_dup(handle_id), h);
+	return h;
+}
+
+static void janus_events_stats_metric_add(janus_events_stats_metric *m, gint64 value) {
+	if(m->values == NULL) {
+		m->values = g_array_new(FALSE, FALSE, sizeof(gint64));
+		m->min = value;
+		m->max = value;
+	}
+	g_array_append_val(m->values, value);
+	m->sum += value;
+	if(value < m->min)
+		m->min = value;
+	if(value > m->max)
+		m->max = value;
+}
+
+static gint janus_events_stats_compare(gconstpointer a, gconstpointer b) {
+	gint64 va = *(const gint64 *)a, vb = *(const gint64 *)b;
+	return va < vb ? -1 : (va > vb ? 1 : 0);
+}
+
+static json_t *janus_events_stats_metric_summary(janus_events_stats_metric *m) {
+	if(m->values == NULL || m->values->len == 0)
+		return NULL;
+	g_array_sort(m->values, janus_events_stats_compare);
+	guint n = m->values->len;
+	json_t *summary = json_object();
+	json_object_set_new(summary, "sum", json_integer(m->sum));
+	json_object_set_new(summary, "min", json_integer(m->min));
+	json_object_set_new(summary, "max", json_integer(m->max));
+	json_object_set_new(summary, "p50", json_integer(g_array_index(m->values, gint64, (n-1)*50/100)));
+	json_object_set_new(summary, "p95", json_integer(g_array_index(m->values, gint64, (n-1)*95/100)));
+	return summary;
+}
+
+static void janus_events_stats_group_free(janus_events_stats_group *g) {
+	if(g == NULL)
+		return;
+	g_free(g->plugin);
+	g_free(g->opaque_id);
+	g_free(g->media);
+	g_hash_table_destroy(g->handles);
+	if(g->rtt.values)
+		g_array_free(g->rtt.values, TRUE);
+	if(g->jitter_local.values)
+		g_array_free(g->jitter_local.values, TRUE);
+	if(g->jitter_remote.values)
+		g_array_free(g->jitter_remote.values, TRUE);
+	if(g->lost.values)
+		g_array_free(g->lost.values, TRUE);
+	g_free(g);
+}
+
+static void janus_events_stats_track_handle(json_t *event) {
+	json_t *body = json_object_get(event, "event");
+	const char *name = json_string_value(json_object_get(body, "name"));
+	guint64 handle_id = json_integer_value(json_object_get(event, "handle_id"));
+	if(name == NULL || handle_id == 0)
+		return;
+	if(!strcasecmp(name, "detached")) {
+		g_hash_table_remove(stats_handles, &handle_id);
+	} else if(!strcasecmp(name, "attached")) {
+		janus_events_stats_handle *h = g_hash_table_lookup(stats_handles, &handle_id);
+		if(h == NULL)
+			h = janus_events_stats_handle_create(handle_id);
+		g_free(h->plugin);
+		h->plugin = g_strdup(json_string_value(json_object_get(body, "plugin")));
+		g_free(h->opaque_id);
+		h->opaque_id = g_strdup(json_string_value(json_object_get(body, "opaque_id")));
+	}
+}
+
+/* Adds a single media statistics object to the related aggregate, and
+ * returns TRUE if the stream just crossed one of the thresholds */
+static gboolean janus_events_stats_update_info(guint64 handle_id, janus_events_stats_handle *h, json_t *info) {
+	const char *media = json_string_value(json_object_get(info, "media"));
+	if(media == NULL || !strcasecmp(media, "data"))
+		return FALSE;
+	/* Find the aggregate this info belongs to */
+	char key[512];
+	const char *plugin = h->plugin ? h->plugin : "none";
+	const char *opaque_id = (stats_by_opaque_id && h->opaque_id) ? h->opaque_id : "";
+	g_snprintf(key, sizeof(key), "%s|%s|%s", plugin, opaque_id, media);
+	janus_events_stats_group *g = g_hash_table_lookup(stats_groups, key);
+	if(g == NULL) {
+		g = g_malloc0(sizeof(janus_events_stats_group));
+		g->plugin = g_strdup(plugin);
+		g->opaque_id = (stats_by_opaque_id && h->opaque_id) ? g_strdup(h->opaque_id) : NULL;
+		g->media = g_strdup(media);
+		g->handles = g_hash_table_new_full(g_int64_hash, g_int64_equal, (GDestroyNotify)g_free, NULL);
+		g_hash_table_insert(stats_groups, g_strdup(key), g);
+	}
+	if(g_hash_table_lookup(g->handles, &handle_id) == NULL)
+		g_hash_table_insert(g->handles, janus_uint64_dup(handle_id), GINT_TO_POINTER(1));
+	g->samples++;
+	/* Losses are cumulative, so we need the previous value to compute a delta */
+	const char *mid = json_string_value(json_object_get(info, "mid"));
+	g_snprintf(key, sizeof(key), "%s|%s", mid ? mid : "", media);
+	janus_events_stats_stream *stream = g_hash_table_lookup(h->streams, key);
+	if(stream == NULL) {
+		stream = g_malloc0(sizeof(janus_events_stats_stream));
+		g_hash_table_insert(h->streams, g_strdup(key), stream);
+	}
+	gint64 rtt = -1, jitter_local = -1, jitter_remote = -1, lost = -1;
+	json_t *value = json_object_get(info, "rtt");
+	if(value && json_is_integer(value)) {
+		rtt = json_integer_value(value);
+		janus_events_stats_metric_add(&g->rtt, rtt);
+	}
+	value = json_object_get(info, "jitter-local");
+	if(value && json_is_integer(value)) {
+		jitter_local = json_integer_value(value);
+		janus_events_stats_metric_add(&g->jitter_local, jitter_local);
+	}
+	value = json_object_get(info, "jitter-remote");
+	if(value && json_is_integer(value)) {
+		jitter_remote = json_integer_value(value);
+		janus_events_stats_metric_add(&g->jitter_remote, jitter_remote);
+	}
+	value = json_object_get(info, "lost");
+	if(value && json_is_integer(value)) {
+		gint64 total = json_integer_value(value);
+		lost = (stream->started && total > stream->lost) ? total - stream->lost : 0;
+		stream->lost = total;
+		stream->started = TRUE;
+		janus_events_stats_metric_add(&g->lost, lost);
+	}
+	/* Check if this stream crossed any threshold, in either direction */
+	gboolean outlier = (stats_outlier_rtt > 0 && rtt >= stats_outlier_rtt) ||
+		(stats_outlier_jitter > 0 && (jitter_local >= stats_outlier_jitter || jitter_remote >= stats_outlier_jitter)) ||
+		(stats_outlier_lost > 0 && lost >= stats_outlier_lost);
+	if(outlier == stream->outlier)
+		return FALSE;
+	stream->outlier = outlier;
+	return TRUE;
+}
+
+static gboolean janus_events_stats_update(json_t *event) {
+	guint64 handle_id = json_integer_value(json_object_get(event, "handle_id"));
+	janus_events_stats_handle *h = g_hash_table_lookup(stats_handles, &handle_id);
+	if(h == NULL)
+		h = janus_events_stats_handle_create(handle_id);
+	/* Statistics may be combined in a single array */
+	gboolean outlier = FALSE;
+	json_t *body = json_object_get(event, "event");
+	if(json_is_array(body)) {
+		size_t i = 0;
+		for(i=0; i<json_array_size(body); i++) {
+			if(janus_events_stats_update_info(handle_id, h, json_array_get(body, i)))
+				outlier = TRUE;
+		}
+	} else if(json_is_object(body)) {
+		outlier = janus_events_stats_update_info(handle_id, h, body);
+	}
+	return outlier;
+}
+
+static void janus_events_stats_flush(void) {
+	if(stats_groups == NULL || g_hash_table_size(stats_groups) == 0)
+		return;
+	GHashTableIter iter;
+	gpointer value;
+	g_hash_table_iter_init(&iter, stats_groups);
+	while(g_hash_table_iter_next(&iter, NULL, &value)) {
+		janus_events_stats_group *g = value;
+		if(g->samples == 0)
+			continue;
+		json_t *event = json_object();
+		if(server != NULL)
+			json_object_set_new(event, "emitter", json_string(server));
+		json_object_set_new(event, "type", json_integer(JANUS_EVENT_TYPE_MEDIA));
+		json_object_set_new(event, "subtype", json_integer(JANUS_EVENT_SUBTYPE_MEDIA_STATS_AGGREGATE));
+		json_object_set_new(event, "timestamp", json_integer(janus_get_real_time()));
+		json_t *body = json_object();
+		json_object_set_new(body, "plugin", json_string(g->plugin));
+		if(g->opaque_id)
+			json_object_set_new(body, "opaque_id", json_string(g->opaque_id));
+		json_object_set_new(body, "media", json_string(g->media));
+		json_object_set_new(body, "window", json_integer(stats_window));
+		json_object_set_new(body, "handles", json_integer(g_hash_table_size(g->handles)));
+		json_object_set_new(body, "samples", json_integer(g->samples));
+		json_t *summary = janus_events_stats_metric_summary(&g->rtt);
+		if(summary)
+			json_object_set_new(body, "rtt", summary);
+		summary = janus_events_stats_metric_summary(&g->jitter_local);
+		if(summary)
+			json_object_set_new(body, "jitter-local", summary);
+		summary = janus_events_stats_metric_summary(&g->jitter_remote);
+		if(summary)
+			json_object_set_new(body, "jitter-remote", summary);
+		summary = janus_events_stats_metric_summary(&g->lost);
+		if(summary)
+			json_object_set_new(body, "lost", summary);
+		json_object_set_new(event, "event", body);
+		/* Only pass the aggregate to the handlers that are interested in it */
+		guint count = g_hash_table_size(eventhandlers);
+		GHashTableIter hiter;
+		gpointer hvalue;
+		g_hash_table_iter_init(&hiter, eventhandlers);
+		while(g_hash_table_iter_next(&hiter, NULL, &hvalue)) {
+			janus_eventhandler *e = hvalue;
+			if(e == NULL || !janus_flags_is_set(&e->events_mask, JANUS_EVENT_TYPE_MEDIA) ||
+					!janus_events_handler_wants_aggregates(e))
+				continue;
+			if(count == 1) {
+				e->incoming_event(event);
+			} else {
+				json_t *copy = json_deep_copy(event);
+				e->incoming_event(copy);
+				json_decref(copy);
+			}
+		}
+		json_decref(event);
+	}
+	/* Start a new window from scratch */
+	g_hash_table_remove_all(stats_groups);
+}
+
 /* Helper method to change the events mask */
 void janus_events_edit_events_mask(const char *list, janus_flags *target) {
 	if(!list)
@@ -387,3 +751,174 @@ const char *janus_events_type_to_name(int type) {
 	}
 	return (char *)NULL;
 }
+
+/* Serialization formats */
+int janus_events_format_from_string(const char *name) {
+	if(name == NULL)
+		return -1;
+	if(!strcasecmp(name, "json"))
+		return JANUS_EVENTS_FORMAT_JSON;
+	if(!strcasecmp(name, "msgpack") || !strcasecmp(name, "messagepack"))
+		return JANUS_EVENTS_FORMAT_MSGPACK;
+	return -1;
+}
+
+const char *janus_events_format_to_string(janus_events_format format) {
+	switch(format) {
+		case JANUS_EVENTS_FORMAT_JSON:
+			return "json";
+		case JANUS_EVENTS_FORMAT_MSGPACK:
+			return "msgpack";
+		default:
+			break;
+	}
+	return NULL;
+}
+
+const char *janus_events_format_content_type(janus_events_format format) {
+	if(format == JANUS_EVENTS_FORMAT_MSGPACK)
+		return "application/msgpack";
+	return "application/json";
+}
+
+/* MessagePack encoder: we only need to support what a json_t can contain,
+ * so we don't need any external dependency for that, and we write to a
+ * growable buffer allocated with g_realloc: as we never install a custom
+ * GLib memory vtable, that's the system allocator, so the buffer can be
+ * freed the same way as the text json_dumps returns */
+typedef struct janus_events_buffer {
+	char *data;
+	size_t len, size;
+} janus_events_buffer;
+
+static void janus_events_buffer_append(janus_events_buffer *buf, const void *data, size_t len) {
+	if(buf->len + len > buf->size) {
+		size_t size = buf->size ? buf->size : 256;
+		while(buf->len + len > size)
+			size *= 2;
+		buf->data = g_realloc(buf->data, size);
+		buf->size = size;
+	}
+	memcpy(buf->data + buf->len, data, len);
+	buf->len += len;
+}
+
+static void janus_events_msgpack_header(janus_events_buffer *buf, uint8_t code, uint64_t value, int bytes) {
+	uint8_t header[9];
+	header[0] = code;
+	int i = 0;
+	for(i=0; i<bytes; i++)
+		header[1+i] = (value >> (8*(bytes-1-i))) & 0xFF;
+	janus_events_buffer_append(buf, header, 1+bytes);
+}
+
+static void janus_events_msgpack_container(janus_events_buffer *buf, size_t size, uint8_t fixcode, uint8_t code16, uint8_t code32) {
+	if(size < 16)
+		janus_events_msgpack_header(buf, fixcode | size, 0, 0);
+	else if(size < 65536)
+		janus_events_msgpack_header(buf, code16, size, 2);
+	else
+		janus_events_msgpack_header(buf, code32, size, 4);
+}
+
+static void janus_events_msgpack_string(janus_events_buffer *buf, const char *str, size_t len) {
+	if(len < 32)
+		janus_events_msgpack_header(buf, 0xa0 | len, 0, 0);
+	else if(len < 256)
+		janus_events_msgpack_header(buf, 0xd9, len, 1);
+	else if(len < 65536)
+		janus_events_msgpack_header(buf, 0xda, len, 2);
+	else
+		janus_events_msgpack_header(buf, 0xdb, len, 4);
+	if(len > 0)
+		janus_events_buffer_append(buf, str, len);
+}
+
+static void janus_events_msgpack_integer(janus_events_buffer *buf, json_int_t value) {
+	if(value >= 0) {
+		uint64_t v = value;
+		if(v < 128)
+			janus_events_msgpack_header(buf, v, 0, 0);
+		else if(v < 256)
+			janus_events_msgpack_header(buf, 0xcc, v, 1);
+		else if(v < 65536)
+			janus_events_msgpack_header(buf, 0xcd, v, 2);
+		else if(v <= G_MAXUINT32)
+			janus_events_msgpack_header(buf, 0xce, v, 4);
+		else
+			janus_events_msgpack_header(buf, 0xcf, v, 8);
+	} else {
+		if(value >= -32)
+			janus_events_msgpack_header(buf, (uint8_t)(int8_t)value, 0, 0);
+		else if(value >= G_MININT8)
+			janus_events_msgpack_header(buf, 0xd0, (uint8_t)(int8_t)value, 1);
+		else if(value >= G_MININT16)
+			janus_events_msgpack_header(buf, 0xd1, (uint16_t)(int16_t)value, 2);
+		else if(value >= G_MININT32)
+			janus_events_msgpack_header(buf, 0xd2, (uint32_t)(int32_t)value, 4);
+		else
+			janus_events_msgpack_header(buf, 0xd3, (uint64_t)value, 8);
+	}
+}
+
+static void janus_events_msgpack_encode(janus_events_buffer *buf, json_t *json) {
+	switch(json_typeof(json)) {
+		case JSON_OBJECT: {
+			janus_events_msgpack_container(buf, json_object_size(json), 0x80, 0xde, 0xdf);
+			const char *key = NULL;
+			json_t *value = NULL;
+			json_object_foreach(json, key, value) {
+				janus_events_msgpack_string(buf, key, strlen(key));
+				janus_events_msgpack_encode(buf, value);
+			}
+			break;
+		}
+		case JSON_ARRAY: {
+			size_t i = 0, size = json_array_size(json);
+			janus_events_msgpack_container(buf, size, 0x90, 0xdc, 0xdd);
+			for(i=0; i<size; i++)
+				janus_events_msgpack_encode(buf, json_array_get(json, i));
+			break;
+		}
+		case JSON_STRING:
+			janus_events_msgpack_string(buf, json_string_value(json), json_string_length(json));
+			break;
+		case JSON_INTEGER:
+			janus_events_msgpack_integer(buf, json_integer_value(json));
+			break;
+		case JSON_REAL: {
+			double d = json_real_value(json);
+			uint64_t v = 0;
+			memcpy(&v, &d, sizeof(v));
+			janus_events_msgpack_header(buf, 0xcb, v, 8);
+			break;
+		}
+		case JSON_TRUE:
+			janus_events_msgpack_header(buf, 0xc3, 0, 0);
+			break;
+		case JSON_FALSE:
+			janus_events_msgpack_header(buf, 0xc2, 0, 0);
+			break;
+		case JSON_NULL:
+		default:
+			janus_events_msgpack_header(buf, 0xc0, 0, 0);
+			break;
+	}
+}
+
+char *janus_events_serialize(json_t *event, janus_events_format format, size_t json_flags, size_t *len) {
+	if(event == NULL)
+		return NULL;
+	if(format == JANUS_EVENTS_FORMAT_MSGPACK) {
+		janus_events_buffer buf = { 0 };
+		janus_events_msgpack_encode(&buf, event);
+		if(len)
+			*len = buf.len;
+		return buf.data;
+	}
+	/* Plain JSON */
+	char *text = json_dumps(event, json_flags);
+	if(text != NULL && len)
+		*len = strlen(text);
+	return text;
+}
@@ -30,6 +30,30 @@ void janus_events_deinit(void);
  * @returns TRUE if they're enabled, FALSE if not */
 gboolean janus_events_is_enabled(void);
 
+/*! \brief Configure the aggregation of media statistics for event handlers
+ * \details When enabled, handlers interested in aggregates won't receive
+ * media statistics for each handle anymore, but a periodic summary (sum,
+ * min, max, p50 and p95 of RTT, jitter and losses) for each plugin and
+ * media type, plus the statistics of streams that crossed a threshold
+ * @note This must be called before janus_events_init
+ * @param[in] window How often aggregates should be generated, in seconds (0 disables aggregation)
+ * @param[in] handlers Comma separated list of the package names of the handlers that want aggregates (NULL or "all" for all of them)
+ * @param[in] by_opaque_id Whether aggregates should be per opaque_id too, and not only per plugin and media
+ * @param[in] rtt RTT threshold (ms) above which a stream is an outlier (0 to ignore RTT)
+ * @param[in] jitter Jitter threshold above which a stream is an outlier (0 to ignore jitter)
+ * @param[in] lost Losses in a statistics period above which a stream is an outlier (0 to ignore losses) */
+void janus_events_set_stats_aggregation(int window, const char *handlers, gboolean by_opaque_id,
+	int rtt, int jitter, int lost);
+
+/*! \brief Helper method to get the aggregation window of media statistics
+ * @returns The aggregation window in seconds, or 0 if aggregation is disabled */
+int janus_events_get_stats_aggregation_window(void);
+
+/*! \brief Helper method to check whether an event handler gets aggregated media statistics
+ * @param[in] package The package name of the event handler
+ * @returns TRUE if the handler receives aggregates, FALSE otherwise */
+gboolean janus_events_is_stats_aggregated(const char *package);
+
 /*! \brief Notify an event to all interested handlers
  * @note According to the type of event to notify, different arguments may
  * be required and used in order to prepare the actual object to pass to handlers.
@@ -55,4 +79,40 @@ const char *janus_events_type_to_label(int type);
  * @returns The prettified name of the event type, if found, or NULL otherwise */
 const char *janus_events_type_to_name(int type);
 
+
+/*! \brief Serialization formats event handlers can use to ship events */
+typedef enum janus_events_format {
+	/*! \brief Textual JSON (default) */
+	JANUS_EVENTS_FORMAT_JSON = 0,
+	/*! \brief Binary MessagePack encoding of the same JSON structure */
+	JANUS_EVENTS_FORMAT_MSGPACK
+} janus_events_format;
+
+/*! \brief Helper method to parse a serialization format from its name
+ * @param[in] name The format name (e.g., "json" or "msgpack")
+ * @returns The janus_events_format value, or -1 if the name is unknown */
+int janus_events_format_from_string(const char *name);
+
+/*! \brief Helper method to stringify a serialization format
+ * @param[in] format The serialization format
+ * @returns The format name, if found, or NULL otherwise */
+const char *janus_events_format_to_string(janus_events_format format);
+
+/*! \brief Helper method to get the MIME type of a serialization format
+ * @param[in] format The serialization format
+ * @returns The MIME type associated to the format (e.g., "application/json") */
+const char *janus_events_format_content_type(janus_events_format format);
+
+/*! \brief Helper method to serialize an event, or a group of events, in the specified format
+ * \note When grouping events, just pass a JSON array: with MessagePack this
+ * results in a single binary array frame containing all of them, which
+ * means a single write is enough to ship the whole batch. The returned
+ * buffer must be freed with \c free, as with \c json_dumps
+ * @param[in] event The event (or array of events) to serialize
+ * @param[in] format The serialization format to use
+ * @param[in] json_flags The \c json_dumps flags to use, when serializing to JSON
+ * @param[out] len The size of the serialized buffer (no trailing null character counted)
+ * @returns A buffer containing the serialized event, or NULL in case of errors */
+char *janus_events_serialize(json_t *event, janus_events_format format, size_t json_flags, size_t *len);
+
 #endif
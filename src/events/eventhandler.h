@@ -189,6 +189,8 @@ static janus_eventhandler janus_fake_eventhandler_plugin =
 #define JANUS_EVENT_SUBTYPE_MEDIA_SLOWLINK	2
 /*! \brief Media event subtypes: stats */
 #define JANUS_EVENT_SUBTYPE_MEDIA_STATS		3
+/*! \brief Media event subtypes: aggregated stats (no session or handle ID) */
+#define JANUS_EVENT_SUBTYPE_MEDIA_STATS_AGGREGATE	4
 ///@}
 
 #define JANUS_EVENTHANDLER_INIT(...) {			\
@@ -118,6 +118,10 @@ static volatile gint initialized = 0, stopping = 0;
 #define JANUS_MQTTEVH_VERSION_DEFAULT JANUS_MQTTEVH_VERSION_3_1_1
 
 static size_t json_format = JANUS_MQTTEVH_DEFAULT_JSON_FORMAT;
+/* Serialization format (JSON or binary MessagePack) */
+static volatile gint events_format = JANUS_EVENTS_FORMAT_JSON;
+/* Whether events can be grouped in a single publish (only when not publishing per event type) */
+static volatile gint group_events = 0;
 
 
 /* Parameter validation (for tweaking via Admin API) */
@@ -125,7 +129,9 @@ static struct janus_json_parameter request_parameters[] = {
 	{"request", JSON_STRING, JANUS_JSON_PARAM_REQUIRED}
 };
 static struct janus_json_parameter tweak_parameters[] = {
-	{"events", JSON_STRING, 0}
+	{"events", JSON_STRING, 0},
+	{"grouping", JANUS_JSON_BOOL, 0},
+	{"format", JSON_STRING, 0}
 };
 /* Error codes (for the tweaking via Admin API */
 #define JANUS_MQTTEVH_ERROR_INVALID_REQUEST		411
@@ -213,7 +219,7 @@ static void janus_mqttevh_client_disconnect_success(void *context, MQTTAsync_suc
 static void janus_mqttevh_client_disconnect_failure(void *context, MQTTAsync_failureData *response);
 static void janus_mqttevh_client_publish_message_success(void *context, MQTTAsync_successData *response);
 static void janus_mqttevh_client_publish_message_failure(void *context, MQTTAsync_failureData *response);
-static int janus_mqttevh_client_publish_message(janus_mqttevh_context *ctx, const char *topic, int retain, char *payload);
+static int janus_mqttevh_client_publish_message(janus_mqttevh_context *ctx, const char *topic, int retain, char *payload, size_t len);
 int janus_mqttevh_client_get_response_code(MQTTAsync_failureData *response);
 #ifdef MQTTVERSION_5
 /* MQTT v5 interface callbacks */
@@ -223,7 +229,7 @@ static void janus_mqttevh_client_disconnect_success5(void *context, MQTTAsync_su
 static void janus_mqttevh_client_disconnect_failure5(void *context, MQTTAsync_failureData5 *response);
 static void janus_mqttevh_client_publish_message_success5(void *context, MQTTAsync_successData5 *response);
 static void janus_mqttevh_client_publish_message_failure5(void *context, MQTTAsync_failureData5 *response);
-static int janus_mqttevh_client_publish_message5(janus_mqttevh_context *ctx, const char *topic, int retain, char *payload, MQTTProperties *properties);
+static int janus_mqttevh_client_publish_message5(janus_mqttevh_context *ctx, const char *topic, int retain, char *payload, size_t len, MQTTProperties *properties);
 int janus_mqttevh_client_get_response_code5(MQTTAsync_failureData5 *response);
 #endif
 /* MQTT version independent callback implementations */
@@ -233,7 +239,7 @@ static void janus_mqttevh_client_disconnect_success_impl(void *context);
 static void janus_mqttevh_client_disconnect_failure_impl(void *context, int rc);
 static void janus_mqttevh_client_publish_message_success_impl(void *context);
 static void janus_mqttevh_client_publish_message_failure_impl(void *context, int rc);
-int janus_mqttevh_client_publish_message_wrap(void *context, const char *topic, int retain, char *payload);
+int janus_mqttevh_client_publish_message_wrap(void *context, const char *topic, int retain, char *payload, size_t len);
 
 #ifdef MQTTVERSION_5
 /* MQTT 5 specific functions */
@@ -278,6 +284,7 @@ static const char *janus_mqttevh_get_package(void) {
 /* Send an JSON message to a MQTT topic */
 static int janus_mqttevh_send_message(void *context, const char *topic, json_t *message) {
 	char *payload = NULL;
+	size_t len = 0;
 	int rc = 0;
 	janus_mqttevh_context *ctx;
 
@@ -300,17 +307,17 @@ static int janus_mqttevh_send_message(void *context, const char *topic, json_t *
 #endif
 	ctx = (janus_mqttevh_context *)context;
 
-	payload = json_dumps(message, json_format);
+	payload = janus_events_serialize(message, g_atomic_int_get(&events_format), json_format, &len);
 	if(payload == NULL) {
-		JANUS_LOG(LOG_ERR, "Can't convert message to string format\n");
+		JANUS_LOG(LOG_ERR, "Can't serialize message\n");
 		json_decref(message);
 		return 0;
 	}
-	JANUS_LOG(LOG_HUGE, "Converted message to JSON for %s\n", topic);
+	JANUS_LOG(LOG_HUGE, "Serialized message for %s\n", topic);
 	/* Ok, lets' get rid of the message */
 	json_decref(message);
 
-	rc = janus_mqttevh_client_publish_message_wrap(context, topic, ctx->publish.retain, payload);
+	rc = janus_mqttevh_client_publish_message_wrap(context, topic, ctx->publish.retain, payload, len);
 	if(rc != MQTTASYNC_SUCCESS) {
 		JANUS_LOG(LOG_WARN, "Can't publish to MQTT topic: %s, return code: %d\n", ctx->publish.topic, rc);
 	}
@@ -322,7 +329,7 @@ static int janus_mqttevh_send_message(void *context, const char *topic, json_t *
 	return 0;
 }
 
-int janus_mqttevh_client_publish_message_wrap(void *context, const char *topic, int retain, char *payload) {
+int janus_mqttevh_client_publish_message_wrap(void *context, const char *topic, int retain, char *payload, size_t len) {
 	int rc = 0;
 	janus_mqttevh_context *ctx = (janus_mqttevh_context *)context;
 
@@ -330,13 +337,13 @@ int janus_mqttevh_client_publish_message_wrap(void *context, const char *topic,
 	if(ctx->connect.mqtt_version == MQTTVERSION_5) {
 		MQTTProperties properties = MQTTProperties_initializer;
 		janus_mqttevh_add_properties(ctx->publish.add_user_properties, &properties);
-		rc = janus_mqttevh_client_publish_message5(ctx, topic, retain, payload, &properties);
+		rc = janus_mqttevh_client_publish_message5(ctx, topic, retain, payload, len, &properties);
 		MQTTProperties_free(&properties);
 	} else {
-		rc = janus_mqttevh_client_publish_message(ctx, topic, retain, payload);
+		rc = janus_mqttevh_client_publish_message(ctx, topic, retain, payload, len);
 	}
 #else
-	rc = janus_mqttevh_client_publish_message(ctx, topic, retain, payload);
+	rc = janus_mqttevh_client_publish_message(ctx, topic, retain, payload, len);
 #endif
 
 	return rc;
@@ -423,7 +430,8 @@ static void janus_mqttevh_client_connect_success_impl(void *context) {
 	/* Using LWT's retain for initial status message because
 	 * we need to ensure we overwrite LWT if it's retained.
 	 */
-	int rc = janus_mqttevh_client_publish_message_wrap(context, topicbuf, ctx->will.retain, ctx->publish.connect_status);
+	int rc = janus_mqttevh_client_publish_message_wrap(context, topicbuf, ctx->will.retain,
+		ctx->publish.connect_status, strlen(ctx->publish.connect_status));
 
 	if(rc != MQTTASYNC_SUCCESS) {
 		JANUS_LOG(LOG_WARN, "Can't publish to MQTT topic: %s, return code: %d\n", topicbuf, rc);
@@ -456,7 +464,8 @@ static int janus_mqttevh_client_disconnect(janus_mqttevh_context *ctx) {
 	/* Using LWT's retain for disconnect status message because
 	 * we need to ensure we overwrite LWT if it's retained.
 	 */
-	int rc = janus_mqttevh_client_publish_message_wrap(context, topicbuf, 1, ctx->publish.disconnect_status);
+	int rc = janus_mqttevh_client_publish_message_wrap(context, topicbuf, 1,
+		ctx->publish.disconnect_status, strlen(ctx->publish.disconnect_status));
 
 	if(rc != MQTTASYNC_SUCCESS) {
 		JANUS_LOG(LOG_WARN, "Can't publish to MQTT topic: %s, return code: %d\n", topicbuf, rc);
@@ -522,14 +531,14 @@ void janus_mqttevh_client_disconnect_failure_impl(void *context, int rc) {
 
 
 /* Publish mqtt message using paho
- * Payload is a string. JSON objects should be stringified before calling this function.
+ * Payload is a buffer of the provided length. JSON objects should be serialized before calling this function.
  */
-static int janus_mqttevh_client_publish_message(janus_mqttevh_context *ctx, const char *topic, int retain, char *payload) {
+static int janus_mqttevh_client_publish_message(janus_mqttevh_context *ctx, const char *topic, int retain, char *payload, size_t len) {
 	int rc;
 
 	MQTTAsync_message msg = MQTTAsync_message_initializer;
 	msg.payload = payload;
-	msg.payloadlen = strlen(payload);
+	msg.payloadlen = len;
 	msg.qos = ctx->publish.qos;
 	msg.retained = retain;
 
@@ -558,12 +567,12 @@ static int janus_mqttevh_client_publish_message(janus_mqttevh_context *ctx, cons
 }
 
 #ifdef MQTTVERSION_5
-static int janus_mqttevh_client_publish_message5(janus_mqttevh_context *ctx, const char *topic, int retain, char *payload, MQTTProperties *properties) {
+static int janus_mqttevh_client_publish_message5(janus_mqttevh_context *ctx, const char *topic, int retain, char *payload, size_t len, MQTTProperties *properties) {
 	int rc;
 
 	MQTTAsync_message msg = MQTTAsync_message_initializer;
 	msg.payload = payload;
-	msg.payloadlen = strlen(payload);
+	msg.payloadlen = len;
 	msg.qos = ctx->publish.qos;
 	msg.retained = retain;
 	msg.properties = MQTTProperties_copy(properties);
@@ -795,6 +804,21 @@ static int janus_mqttevh_init(const char *config_path) {
 		}
 	}
 
+	/* Should we use a binary format rather than JSON? */
+	item = janus_config_get(config, config_general, janus_config_type_item, "format");
+	if(item && item->value) {
+		int format = janus_events_format_from_string(item->value);
+		if(format < 0)
+			JANUS_LOG(LOG_WARN, "Unsupported format '%s', using default (json)\n", item->value);
+		else
+			g_atomic_int_set(&events_format, format);
+	}
+
+	/* Is grouping of events ok? (only used when not publishing on per-event topics) */
+	item = janus_config_get(config, config_general, janus_config_type_item, "grouping");
+	if(item && item->value)
+		g_atomic_int_set(&group_events, janus_is_true(item->value));
+
 	/* Which events should we subscribe to? */
 	item = janus_config_get(config, config_general, janus_config_type_item, "events");
 	if(item && item->value)
@@ -1145,6 +1169,20 @@ json_t *janus_mqttevh_handle_request(json_t *request) {
 		/* Events */
 		if(json_object_get(request, "events"))
 			janus_events_edit_events_mask(json_string_value(json_object_get(request, "events")), &janus_mqttevh.events_mask);
+		/* Grouping */
+		if(json_object_get(request, "grouping"))
+			g_atomic_int_set(&group_events, json_is_true(json_object_get(request, "grouping")));
+		/* Serialization format */
+		if(json_object_get(request, "format")) {
+			const char *format = json_string_value(json_object_get(request, "format"));
+			int req_format = janus_events_format_from_string(format);
+			if(req_format < 0) {
+				error_code = JANUS_MQTTEVH_ERROR_INVALID_ELEMENT;
+				g_snprintf(error_cause, sizeof(error_cause), "Unsupported format '%s'", format);
+				goto plugin_response;
+			}
+			g_atomic_int_set(&events_format, req_format);
+		}
 	} else {
 		JANUS_LOG(LOG_VERB, "Unknown request '%s'\n", request_text);
 		error_code = JANUS_MQTTEVH_ERROR_INVALID_REQUEST;
@@ -1210,6 +1248,25 @@ static void *janus_mqttevh_handler(void *data) {
 				g_snprintf(topicbuf, sizeof(topicbuf), "%s/%s", ctx->publish.topic, janus_events_type_to_label(type));
 				JANUS_LOG(LOG_DBG, "Debug: MQTT Publish event on %s\n", topicbuf);
 				janus_mqttevh_send_message(ctx, topicbuf, event);
+			} else if(g_atomic_int_get(&group_events)) {
+				/* Group as many queued events as we can (up to a maximum) in a single publish */
+				json_t *output = json_array();
+				json_array_append_new(output, event);
+				int count = 1;
+				while(count < 100 && (event = g_async_queue_try_pop(events)) != NULL) {
+					if(event == &exit_event) {
+						/* Put it back, so that we leave the loop after this publish */
+						g_async_queue_push_front(events, event);
+						break;
+					}
+					type = json_integer_value(json_object_get(event, "type"));
+					ename = janus_events_type_to_name(type);
+					if(ename)
+						json_object_set_new(event, "eventtype", json_string(ename));
+					json_array_append_new(output, event);
+					count++;
+				}
+				janus_mqttevh_send_message(ctx, ctx->publish.topic, output);
 			} else {
 				janus_mqttevh_send_message(ctx, ctx->publish.topic, event);
 			}
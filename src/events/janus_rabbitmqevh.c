@@ -101,6 +101,8 @@ static void janus_rabbitmqevh_event_free(json_t *event) {
 
 /* JSON serialization options */
 static size_t json_format = JSON_INDENT(3) | JSON_PRESERVE_ORDER;
+/* Serialization format (JSON or binary MessagePack) */
+static volatile gint events_format = JANUS_EVENTS_FORMAT_JSON;
 
 #define JANUS_RABBITMQEVH_EXCHANGE_TYPE "fanout"
 
@@ -130,7 +132,8 @@ static struct janus_json_parameter request_parameters[] = {
 };
 static struct janus_json_parameter tweak_parameters[] = {
 	{"events", JSON_STRING, 0},
-	{"grouping", JANUS_JSON_BOOL, 0}
+	{"grouping", JANUS_JSON_BOOL, 0},
+	{"format", JSON_STRING, 0}
 };
 /* Error codes (for the tweaking via Admin API */
 #define JANUS_RABBITMQEVH_ERROR_INVALID_REQUEST		411
@@ -200,6 +203,16 @@ int janus_rabbitmqevh_init(const char *config_path) {
 	if(item && item->value)
 		group_events = janus_is_true(item->value);
 
+	/* Should we use a binary format rather than JSON? */
+	item = janus_config_get(config, config_general, janus_config_type_item, "format");
+	if(item && item->value) {
+		int format = janus_events_format_from_string(item->value);
+		if(format < 0)
+			JANUS_LOG(LOG_WARN, "RabbitMQEventHandler: Unsupported format '%s', using default (json)\n", item->value);
+		else
+			g_atomic_int_set(&events_format, format);
+	}
+
 	/* Handle configuration, starting from the server details */
 	item = janus_config_get(config, config_general, janus_config_type_item, "host");
 	if(item && item->value)
@@ -536,6 +549,17 @@ json_t *janus_rabbitmqevh_handle_request(json_t *request) {
 		/* Grouping */
 		if(json_object_get(request, "grouping"))
 			group_events = json_is_true(json_object_get(request, "grouping"));
+		/* Serialization format */
+		if(json_object_get(request, "format")) {
+			const char *format = json_string_value(json_object_get(request, "format"));
+			int req_format = janus_events_format_from_string(format);
+			if(req_format < 0) {
+				error_code = JANUS_RABBITMQEVH_ERROR_INVALID_ELEMENT;
+				g_snprintf(error_cause, sizeof(error_cause), "Unsupported format '%s'", format);
+				goto plugin_response;
+			}
+			g_atomic_int_set(&events_format, req_format);
+		}
 	} else {
 		JANUS_LOG(LOG_VERB, "RabbitMQEventHandler: Unknown request '%s'\n", request_text);
 		error_code = JANUS_RABBITMQEVH_ERROR_INVALID_REQUEST;
@@ -562,6 +586,7 @@ static void *jns_rmqevh_hdlr(void *data) {
 	JANUS_LOG(LOG_VERB, "RabbitMQEventHandler: joining handler thread\n");
 	json_t *event = NULL, *output = NULL;
 	char *event_text = NULL;
+	size_t event_len = 0;
 	int count = 0, max = group_events ? 100 : 1;
 
 	while(g_atomic_int_get(&initialized) && !g_atomic_int_get(&stopping)) {
@@ -599,10 +624,11 @@ static void *jns_rmqevh_hdlr(void *data) {
 		}
 
 		if(!g_atomic_int_get(&stopping)) {
-			/* Since this a simple plugin, it does the same for all events: so just convert to string... */
-			event_text = json_dumps(output, json_format);
+			/* Since this a simple plugin, it does the same for all events: so just serialize them... */
+			janus_events_format format = g_atomic_int_get(&events_format);
+			event_text = janus_events_serialize(output, format, json_format, &event_len);
 			if(event_text == NULL) {
-				JANUS_LOG(LOG_WARN, "RabbitMQEventHandler: Failed to stringify event, event lost...\n");
+				JANUS_LOG(LOG_WARN, "RabbitMQEventHandler: Failed to serialize event, event lost...\n");
 				/* Nothing we can do... get rid of the event */
 				json_decref(output);
 				output = NULL;
@@ -611,8 +637,10 @@ static void *jns_rmqevh_hdlr(void *data) {
 			amqp_basic_properties_t props;
 			props._flags = 0;
 			props._flags |= AMQP_BASIC_CONTENT_TYPE_FLAG;
-			props.content_type = amqp_cstring_bytes("application/json");
-			amqp_bytes_t message = amqp_cstring_bytes(event_text);
+			props.content_type = amqp_cstring_bytes((char *)janus_events_format_content_type(format));
+			amqp_bytes_t message;
+			message.len = event_len;
+			message.bytes = event_text;
 			janus_mutex_lock(&mutex);
 			int status = amqp_basic_publish(rmq_conn, rmq_channel, rmq_exchange, amqp_cstring_bytes(route_key), 0, 0, &props, message);
 			if(status != AMQP_STATUS_OK) {
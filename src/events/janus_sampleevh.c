@@ -80,6 +80,8 @@ static janus_mutex evh_mutex = JANUS_MUTEX_INITIALIZER;
 
 /* JSON serialization options */
 static size_t json_format = JSON_INDENT(3) | JSON_PRESERVE_ORDER;
+/* Serialization format (JSON or binary MessagePack) */
+static janus_events_format events_format = JANUS_EVENTS_FORMAT_JSON;
 
 /* Compression, if any */
 static gboolean compress = FALSE;
@@ -114,6 +116,7 @@ static struct janus_json_parameter request_parameters[] = {
 static struct janus_json_parameter tweak_parameters[] = {
 	{"events", JSON_STRING, 0},
 	{"grouping", JANUS_JSON_BOOL, 0},
+	{"format", JSON_STRING, 0},
 	{"backend", JSON_STRING, 0},
 	{"backend_user", JSON_STRING, 0},
 	{"backend_pwd", JSON_STRING, 0},
@@ -219,6 +222,16 @@ int janus_sampleevh_init(const char *config_path) {
 						json_format = JSON_INDENT(3) | JSON_PRESERVE_ORDER;
 					}
 				}
+				/* Check if we should use a binary format rather than JSON */
+				item = janus_config_get(config, config_general, janus_config_type_item, "format");
+				if(item && item->value) {
+					int format = janus_events_format_from_string(item->value);
+					if(format < 0) {
+						JANUS_LOG(LOG_WARN, "Unsupported format '%s', using default (json)\n", item->value);
+					} else {
+						events_format = format;
+					}
+				}
 				/* Check if we need any compression */
 				item = janus_config_get(config, config_general, janus_config_type_item, "compress");
 				if(item && item->value && janus_is_true(item->value)) {
@@ -361,6 +374,7 @@ json_t *janus_sampleevh_handle_request(json_t *request) {
 		/* Parameters we can change */
 		const char *req_events = NULL, *req_backend = NULL,
 			*req_backend_user = NULL, *req_backend_pwd = NULL;
+		int req_format = -1;
 		int req_grouping = -1, req_maxretr = -1, req_backoff = -1,
 			req_compress = -1, req_compression = -1;
 		/* Events */
@@ -369,6 +383,16 @@ json_t *janus_sampleevh_handle_request(json_t *request) {
 		/* Grouping */
 		if(json_object_get(request, "grouping"))
 			req_grouping = json_is_true(json_object_get(request, "grouping"));
+		/* Serialization format */
+		if(json_object_get(request, "format")) {
+			const char *format = json_string_value(json_object_get(request, "format"));
+			req_format = janus_events_format_from_string(format);
+			if(req_format < 0) {
+				error_code = JANUS_SAMPLEEVH_ERROR_INVALID_ELEMENT;
+				g_snprintf(error_cause, sizeof(error_cause), "Unsupported format '%s'", format);
+				goto plugin_response;
+			}
+		}
 		/* Compression */
 		if(json_object_get(request, "compress"))
 			req_compress = json_is_true(json_object_get(request, "compress"));
@@ -398,6 +422,8 @@ json_t *janus_sampleevh_handle_request(json_t *request) {
 			janus_events_edit_events_mask(req_events, &janus_sampleevh.events_mask);
 		if(req_grouping > -1)
 			group_events = req_grouping ? TRUE : FALSE;
+		if(req_format > -1)
+			events_format = req_format;
 		if(req_compress > -1)
 			compress = req_compress ? TRUE : FALSE;
 		if(req_compression > -1 && req_compression < 10)
@@ -447,8 +473,10 @@ static void *janus_sampleevh_handler(void *data) {
 	JANUS_LOG(LOG_VERB, "Joining SampleEventHandler handler thread\n");
 	json_t *event = NULL, *output = NULL;
 	char *event_text = NULL;
-	char compressed_text[8192];
-	size_t compressed_len = 0;
+	size_t event_len = 0;
+	janus_events_format format = JANUS_EVENTS_FORMAT_JSON;
+	char *compressed_text = NULL;
+	size_t compressed_size = 0, compressed_len = 0;
 	int count = 0, max = group_events ? 100 : 1;
 	int retransmit = 0;
 	while(g_atomic_int_get(&initialized) && !g_atomic_int_get(&stopping)) {
@@ -706,10 +734,13 @@ static void *janus_sampleevh_handler(void *data) {
 					break;
 			}
 
-			/* Since this a simple plugin, it does the same for all events: so just convert to string... */
-			event_text = json_dumps(output, json_format);
+			/* Since this a simple plugin, it does the same for all events: so just serialize them... */
+			janus_mutex_lock(&evh_mutex);
+			format = events_format;
+			janus_mutex_unlock(&evh_mutex);
+			event_text = janus_events_serialize(output, format, json_format, &event_len);
 			if(event_text == NULL) {
-				JANUS_LOG(LOG_WARN, "Failed to stringify event, event lost...\n");
+				JANUS_LOG(LOG_WARN, "Failed to serialize event, event lost...\n");
 				/* Nothing we can do... get rid of the event */
 				json_decref(output);
 				output = NULL;
@@ -732,14 +763,23 @@ static void *janus_sampleevh_handler(void *data) {
 			curl_easy_setopt(curl, CURLOPT_PASSWORD, backend_pwd);
 		}
 		janus_mutex_unlock(&evh_mutex);
-		headers = curl_slist_append(headers, "Content-Type: application/json");
+		char content_type[64];
+		g_snprintf(content_type, sizeof(content_type), "Content-Type: %s", janus_events_format_content_type(format));
+		headers = curl_slist_append(headers, content_type);
 		/* Check if we need to compress the data */
 		if(compress) {
+			/* Make sure the buffer is large enough for the (possibly grouped) events:
+			 * gzip adds a small overhead on top of the deflate worst case */
+			size_t needed = event_len + event_len/1000 + 64;
+			if(compressed_size < needed) {
+				compressed_size = needed;
+				compressed_text = g_realloc(compressed_text, compressed_size);
+			}
 			compressed_len = janus_gzip_compress(compression,
-				event_text, strlen(event_text),
-				compressed_text, sizeof(compressed_text));
+				event_text, event_len,
+				compressed_text, compressed_size);
 			if(compressed_len == 0) {
-				JANUS_LOG(LOG_ERR, "Failed to compress event (%zu bytes)...\n", strlen(event_text));
+				JANUS_LOG(LOG_ERR, "Failed to compress event (%zu bytes)...\n", event_len);
 				/* Nothing we can do... get rid of the event */
 				if(curl)
 					curl_easy_cleanup(curl);
@@ -752,7 +792,7 @@ static void *janus_sampleevh_handler(void *data) {
 		}
 		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
 		curl_easy_setopt(curl, CURLOPT_POSTFIELDS, compress ? compressed_text : event_text);
-		curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, compress ? compressed_len : strlen(event_text));
+		curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, compress ? compressed_len : event_len);
 		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, janus_sampleehv_write_data);
 		/* Don't wait forever (let's say, 10 seconds) */
 		curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10L);
@@ -791,6 +831,7 @@ done:
 		json_decref(output);
 		output = NULL;
 	}
+	g_free(compressed_text);
 	JANUS_LOG(LOG_VERB, "Leaving SampleEventHandler handler thread\n");
 	return NULL;
 }
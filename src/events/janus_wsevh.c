@@ -96,6 +96,8 @@ static void janus_wsevh_event_free(json_t *event) {
 
 /* JSON serialization options */
 static size_t json_format = JSON_INDENT(3) | JSON_PRESERVE_ORDER;
+/* Serialization format (JSON or binary MessagePack) */
+static volatile gint events_format = JANUS_EVENTS_FORMAT_JSON;
 
 
 /* Parameter validation (for tweaking via Admin API) */
@@ -105,6 +107,7 @@ static struct janus_json_parameter request_parameters[] = {
 static struct janus_json_parameter tweak_parameters[] = {
 	{"events", JSON_STRING, 0},
 	{"grouping", JANUS_JSON_BOOL, 0},
+	{"format", JSON_STRING, 0},
 	{"events_cap_on_reconnect", JANUS_JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE}
 };
 /* Error codes (for the tweaking via Admin API */
@@ -173,6 +176,7 @@ typedef struct janus_wsevh_client {
 	int buflen;				/* Length of the buffer (may be resized after re-allocations) */
 	int bufpending;			/* Data an interrupted previous write couldn't send */
 	int bufoffset;			/* Offset from where the interrupted previous write should resume */
+	enum lws_write_protocol bufmode;	/* Whether the message in the buffer is text or binary */
 	janus_mutex mutex;		/* Mutex to lock/unlock this instance */
 } janus_wsevh_client;
 static janus_wsevh_client *ws_client = NULL;
@@ -355,6 +359,16 @@ int janus_wsevh_init(const char *config_path) {
 	if(item && item->value)
 		group_events = janus_is_true(item->value);
 
+	/* Should we use a binary format rather than JSON? */
+	item = janus_config_get(config, config_general, janus_config_type_item, "format");
+	if(item && item->value) {
+		int format = janus_events_format_from_string(item->value);
+		if(format < 0)
+			JANUS_LOG(LOG_WARN, "Unsupported format '%s', using default (json)\n", item->value);
+		else
+			g_atomic_int_set(&events_format, format);
+	}
+
 	/* Do we need to cap the number of queued events when reconnecting */
 	item = janus_config_get(config, config_general, janus_config_type_item, "events_cap_on_reconnect");
 	if(item && item->value)
@@ -566,6 +580,17 @@ json_t *janus_wsevh_handle_request(json_t *request) {
 		/* Grouping */
 		if(json_object_get(request, "grouping"))
 			group_events = json_is_true(json_object_get(request, "grouping"));
+		/* Serialization format */
+		if(json_object_get(request, "format")) {
+			const char *format = json_string_value(json_object_get(request, "format"));
+			int req_format = janus_events_format_from_string(format);
+			if(req_format < 0) {
+				error_code = JANUS_WSEVH_ERROR_INVALID_ELEMENT;
+				g_snprintf(error_cause, sizeof(error_cause), "Unsupported format '%s'", format);
+				goto plugin_response;
+			}
+			g_atomic_int_set(&events_format, req_format);
+		}
 		/* Whether we should put a cap on queued events when reconnecting */
 		if(json_object_get(request, "events_cap_on_reconnect"))
 			g_atomic_int_set(&events_cap_on_reconnect, json_integer_value(json_object_get(request, "events_cap_on_reconnect")));
@@ -641,8 +666,8 @@ static void *janus_wsevh_thread(void *data) {
 }
 #endif
 
-/* Helper function to pop events from the queue and turn them to string for delivery */
-static char *janus_wsevh_stringify_events(void) {
+/* Helper function to pop events from the queue and serialize them for delivery */
+static char *janus_wsevh_stringify_events(size_t *len, gboolean *binary) {
 	if(!g_atomic_int_get(&initialized) || g_atomic_int_get(&stopping))
 		return NULL;
 	json_t *event = NULL, *output = NULL;
@@ -692,8 +717,10 @@ static char *janus_wsevh_stringify_events(void) {
 	}
 
 	if(!g_atomic_int_get(&stopping)) {
-		/* Since this a simple plugin, it does the same for all events: so just convert to string... */
-		event_text = json_dumps(output, json_format);
+		/* Since this a simple plugin, it does the same for all events: so just serialize them... */
+		janus_events_format format = g_atomic_int_get(&events_format);
+		*binary = (format != JANUS_EVENTS_FORMAT_JSON);
+		event_text = janus_events_serialize(output, format, json_format, len);
 		if(event_text == NULL) {
 			/* Nothing we can do... get rid of the event */
 			json_decref(output);
@@ -763,7 +790,7 @@ static int janus_wsevh_callback(struct lws *wsi, enum lws_callback_reasons reaso
 						&& !g_atomic_int_get(&stopping)) {
 					JANUS_LOG(LOG_VERB, "Completing pending WebSocket write (still need to write last %d bytes)...\n",
 						ws_client->bufpending);
-					int sent = lws_write(wsi, ws_client->buffer + ws_client->bufoffset, ws_client->bufpending, LWS_WRITE_TEXT);
+					int sent = lws_write(wsi, ws_client->buffer + ws_client->bufoffset, ws_client->bufpending, ws_client->bufmode);
 					JANUS_LOG(LOG_VERB, "  -- Sent %d/%d bytes\n", sent, ws_client->bufpending);
 					if(sent > -1 && sent < ws_client->bufpending) {
 						/* We still couldn't send everything that was left, we'll try and complete this in the next round */
@@ -780,29 +807,32 @@ static int janus_wsevh_callback(struct lws *wsi, enum lws_callback_reasons reaso
 					return 0;
 				}
 				/* Shoot all the pending messages */
-				char *event = janus_wsevh_stringify_events();
+				size_t event_len = 0;
+				gboolean binary = FALSE;
+				char *event = janus_wsevh_stringify_events(&event_len, &binary);
 				if(event && !g_atomic_int_get(&stopping)) {
 					/* Gotcha! */
-					int buflen = LWS_PRE + strlen(event);
+					int buflen = LWS_PRE + event_len;
 					if(ws_client->buffer == NULL) {
 						/* Let's allocate a shared buffer */
-						JANUS_LOG(LOG_VERB, "Allocating %d bytes (event is %zu bytes)\n", buflen, strlen(event));
+						JANUS_LOG(LOG_VERB, "Allocating %d bytes (event is %zu bytes)\n", buflen, event_len);
 						ws_client->buflen = buflen;
 						ws_client->buffer = g_malloc0(buflen);
 					} else if(buflen > ws_client->buflen) {
 						/* We need a larger shared buffer */
 						JANUS_LOG(LOG_VERB, "Re-allocating to %d bytes (was %d, event is %zu bytes)\n",
-							buflen, ws_client->buflen, strlen(event));
+							buflen, ws_client->buflen, event_len);
 						ws_client->buflen = buflen;
 						ws_client->buffer = g_realloc(ws_client->buffer, buflen);
 					}
-					memcpy(ws_client->buffer + LWS_PRE, event, strlen(event));
-					JANUS_LOG(LOG_VERB, "Sending WebSocket message (%zu bytes)...\n", strlen(event));
-					int sent = lws_write(wsi, ws_client->buffer + LWS_PRE, strlen(event), LWS_WRITE_TEXT);
-					JANUS_LOG(LOG_VERB, "  -- Sent %d/%zu bytes\n", sent, strlen(event));
-					if(sent > -1 && sent < (int)strlen(event)) {
+					memcpy(ws_client->buffer + LWS_PRE, event, event_len);
+					ws_client->bufmode = binary ? LWS_WRITE_BINARY : LWS_WRITE_TEXT;
+					JANUS_LOG(LOG_VERB, "Sending WebSocket message (%zu bytes)...\n", event_len);
+					int sent = lws_write(wsi, ws_client->buffer + LWS_PRE, event_len, ws_client->bufmode);
+					JANUS_LOG(LOG_VERB, "  -- Sent %d/%zu bytes\n", sent, event_len);
+					if(sent > -1 && sent < (int)event_len) {
 						/* We couldn't send everything in a single write, we'll complete this in the next round */
-						ws_client->bufpending = strlen(event) - sent;
+						ws_client->bufpending = event_len - sent;
 						ws_client->bufoffset = LWS_PRE + sent;
 						JANUS_LOG(LOG_VERB, "  -- Couldn't write all bytes (%d missing), setting offset %d\n",
 							ws_client->bufpending, ws_client->bufoffset);
@@ -26,6 +26,7 @@
 #include <netdb.h>
 #include <fcntl.h>
 #include <stun/usages/bind.h>
+#include <stun/usages/ice.h>
 #include <nice/debug.h>
 
 #include "janus.h"
@@ -73,6 +74,15 @@ char *janus_ice_get_turn_rest_api(void) {
 	return (char *)janus_turnrest_get_backend();
 #endif
 }
+json_t *janus_ice_get_turn_rest_api_stats(void) {
+#ifndef HAVE_TURNRESTAPI
+	return NULL;
+#else
+	if(janus_turnrest_get_backend() == NULL)
+		return NULL;
+	return janus_turnrest_get_stats();
+#endif
+}
 
 /* Force relay settings */
 static gboolean force_relay_allowed = FALSE;
@@ -205,6 +215,17 @@ typedef struct janus_ice_static_event_loop {
 	GMainLoop *mainloop;
 	GThread *thread;
 	uint16_t handles;
+	/* CPU the loop thread is pinned to, if any */
+	int cpu;
+	/* Work done in the current window (only updated by the loop thread) */
+	guint64 packets, bytes;
+	gint64 idle, window_start;
+	/* Load measured in the last window: packets per second, kbps, and busy time (permille) */
+	volatile gint pps, kbps, busy;
+	/* Wheel driving the recurring timers of the handles on this loop, and how
+	 * long advancing it took in the last window (microseconds, average and max) */
+	janus_timer_wheel *timers;
+	volatile gint timers_cost, timers_cost_max;
 	volatile gint destroyed;
 	janus_refcount ref;
 } janus_ice_static_event_loop;
@@ -215,12 +236,74 @@ static void janus_ice_static_event_loop_destroy(janus_ice_static_event_loop *loo
 }
 static void janus_ice_static_event_loop_free(const janus_refcount *loop_ref) {
 	janus_ice_static_event_loop *loop = janus_refcount_containerof(loop_ref, janus_ice_static_event_loop, ref);
+	janus_timer_wheel_destroy(loop->timers);
 	g_free(loop);
 }
 static int static_event_loops = 0;
 static gboolean allow_loop_indication = FALSE;
 static GSList *event_loops = NULL;
 static janus_mutex event_loops_mutex = JANUS_MUTEX_INITIALIZER;
+/* CPUs to pin the loop threads to, if any */
+static GArray *event_loops_cpus = NULL;
+/* Packets per second we assume a new handle will cost, when placing handles on loops */
+#define JANUS_ICE_LOOP_HANDLE_WEIGHT	50
+/* Automatic rebalancing of handles across loops (disabled by default) */
+static guint loops_rebalance_period = 0, loops_rebalance_threshold = 25;
+static GThread *loops_rebalancer = NULL;
+static volatile gint loops_rebalancer_stop = 0;
+/* The loop the current thread is running, used to measure how long loops wait in poll */
+static GPrivate janus_ice_current_loop;
+static gint janus_ice_static_event_loop_poll(GPollFD *ufds, guint nfsd, gint timeout) {
+	janus_ice_static_event_loop *loop = g_private_get(&janus_ice_current_loop);
+	gint64 before = janus_get_monotonic_time();
+	gint res = g_poll(ufds, nfsd, timeout);
+	if(loop != NULL)
+		loop->idle += janus_get_monotonic_time() - before;
+	return res;
+}
+/* Timer to compute the load of a loop, running on the loop itself */
+static gboolean janus_ice_static_event_loop_stats(gpointer user_data) {
+	janus_ice_static_event_loop *loop = (janus_ice_static_event_loop *)user_data;
+	gint64 now = janus_get_monotonic_time();
+	gint64 elapsed = now - loop->window_start;
+	if(elapsed <= 0)
+		return G_SOURCE_CONTINUE;
+	gint64 busy = elapsed - loop->idle;
+	if(busy < 0)
+		busy = 0;
+	g_atomic_int_set(&loop->pps, (gint)(loop->packets * G_USEC_PER_SEC / elapsed));
+	g_atomic_int_set(&loop->kbps, (gint)(loop->bytes * 8 * 1000 / elapsed));
+	g_atomic_int_set(&loop->busy, (gint)(busy * 1000 / elapsed));
+	gint64 cost = 0, cost_max = 0;
+	janus_timer_wheel_cost(loop->timers, &cost, &cost_max);
+	g_atomic_int_set(&loop->timers_cost, (gint)cost);
+	g_atomic_int_set(&loop->timers_cost_max, (gint)cost_max);
+	loop->packets = 0;
+	loop->bytes = 0;
+	loop->idle = 0;
+	loop->window_start = now;
+	return G_SOURCE_CONTINUE;
+}
+/* Timer advancing the wheel of a loop, running on the loop itself */
+static gboolean janus_ice_static_event_loop_timers(gpointer user_data) {
+	janus_ice_static_event_loop *loop = (janus_ice_static_event_loop *)user_data;
+	janus_timer_wheel_advance(loop->timers, janus_get_monotonic_time());
+	return G_SOURCE_CONTINUE;
+}
+/* Helper to account for the work a handle did on a static loop (only called by the loop thread) */
+static inline void janus_ice_static_event_loop_account(janus_ice_handle *handle, int bytes) {
+	janus_ice_static_event_loop *loop = (janus_ice_static_event_loop *)handle->static_event_loop;
+	if(loop == NULL || bytes <= 0)
+		return;
+	loop->packets++;
+	loop->bytes += bytes;
+	handle->loop_packets++;
+}
+/* Helper to estimate the load of a loop: what was measured, plus a baseline for each
+ * handle (so that handles that just attached and have no media yet are accounted for) */
+static guint64 janus_ice_static_event_loop_load(janus_ice_static_event_loop *loop) {
+	return (guint64)g_atomic_int_get(&loop->pps) + (guint64)loop->handles * JANUS_ICE_LOOP_HANDLE_WEIGHT;
+}
 static void *janus_ice_static_event_loop_thread(void *data) {
 	janus_ice_static_event_loop *loop = data;
 	JANUS_LOG(LOG_VERB, "[loop#%d] Event loop thread started\n", loop->id);
@@ -230,8 +313,26 @@ static void *janus_ice_static_event_loop_thread(void *data) {
 		janus_refcount_decrease(&loop->ref);
 		return NULL;
 	}
+	if(loop->cpu > -1 && janus_thread_set_cpu_affinity(loop->cpu) == 0)
+		JANUS_LOG(LOG_INFO, "[loop#%d] Pinned to CPU %d\n", loop->id, loop->cpu);
+	/* Keep track of how busy this loop is */
+	g_private_set(&janus_ice_current_loop, loop);
+	loop->window_start = janus_get_monotonic_time();
+	GSource *stats = g_timeout_source_new_seconds(1);
+	g_source_set_priority(stats, G_PRIORITY_DEFAULT);
+	g_source_set_callback(stats, janus_ice_static_event_loop_stats, loop, NULL);
+	g_source_attach(stats, loop->mainctx);
+	/* All the recurring timers of the handles on this loop are driven by a single source */
+	GSource *timers = g_timeout_source_new(JANUS_TIMER_WHEEL_TICK);
+	g_source_set_priority(timers, G_PRIORITY_DEFAULT);
+	g_source_set_callback(timers, janus_ice_static_event_loop_timers, loop, NULL);
+	g_source_attach(timers, loop->mainctx);
 	JANUS_LOG(LOG_DBG, "[loop#%d] Looping...\n", loop->id);
 	g_main_loop_run(loop->mainloop);
+	g_source_destroy(timers);
+	g_source_unref(timers);
+	g_source_destroy(stats);
+	g_source_unref(stats);
 	/* When the loop quits, we can unref it */
 	g_main_loop_unref(loop->mainloop);
 	g_main_context_unref(loop->mainctx);
@@ -245,6 +346,34 @@ int janus_ice_get_static_event_loops(void) {
 gboolean janus_ice_is_loop_indication_allowed(void) {
 	return allow_loop_indication;
 }
+void janus_ice_set_static_event_loops_affinity(const char *cpus) {
+	if(cpus == NULL || static_event_loops > 0)
+		return;
+	if(event_loops_cpus == NULL)
+		event_loops_cpus = g_array_new(FALSE, FALSE, sizeof(int));
+	gchar **list = g_strsplit(cpus, ",", -1);
+	int i = 0;
+	for(i=0; list[i] != NULL; i++) {
+		char *item = g_strstrip(list[i]);
+		if(*item == '\0')
+			continue;
+		int first = -1, last = -1;
+		if(sscanf(item, "%d-%d", &first, &last) < 2)
+			last = first;
+		if(first < 0 || last < first) {
+			JANUS_LOG(LOG_WARN, "Invalid CPU range '%s' for the event loops, skipping\n", item);
+			continue;
+		}
+		int cpu = 0;
+		for(cpu=first; cpu<=last; cpu++)
+			g_array_append_val(event_loops_cpus, cpu);
+	}
+	g_strfreev(list);
+	if(event_loops_cpus->len == 0) {
+		g_array_free(event_loops_cpus, TRUE);
+		event_loops_cpus = NULL;
+	}
+}
 void janus_ice_set_static_event_loops(int loops, gboolean allow_api) {
 	if(loops == 0)
 		return;
@@ -257,8 +386,11 @@ void janus_ice_set_static_event_loops(int loops, gboolean allow_api) {
 	for(i=0; i<loops; i++) {
 		janus_ice_static_event_loop *loop = g_malloc0(sizeof(janus_ice_static_event_loop));
 		loop->id = static_event_loops;
+		loop->cpu = event_loops_cpus ? g_array_index(event_loops_cpus, int, loop->id % event_loops_cpus->len) : -1;
 		loop->mainctx = g_main_context_new();
 		loop->mainloop = g_main_loop_new(loop->mainctx, FALSE);
+		g_main_context_set_poll_func(loop->mainctx, janus_ice_static_event_loop_poll);
+		loop->timers = janus_timer_wheel_create(janus_get_monotonic_time());
 		janus_refcount_init(&loop->ref, janus_ice_static_event_loop_free);
 		/* Now spawn a thread for this loop */
 		GError *error = NULL;
@@ -296,15 +428,198 @@ json_t *janus_ice_static_event_loops_info(void) {
 		json_t *info = json_object();
 		json_object_set_new(info, "id", json_integer(loop->id));
 		json_object_set_new(info, "handles", json_integer(loop->handles));
+		json_object_set_new(info, "packets-per-second", json_integer(g_atomic_int_get(&loop->pps)));
+		json_object_set_new(info, "kbps", json_integer(g_atomic_int_get(&loop->kbps)));
+		json_object_set_new(info, "busy", json_real((double)g_atomic_int_get(&loop->busy) / 1000));
+		if(loop->cpu > -1)
+			json_object_set_new(info, "cpu", json_integer(loop->cpu));
+		json_t *timers = json_object();
+		json_object_set_new(timers, "scheduled", json_integer(g_atomic_int_get(&loop->timers->count)));
+		json_object_set_new(timers, "tick-cost-avg-us", json_integer(g_atomic_int_get(&loop->timers_cost)));
+		json_object_set_new(timers, "tick-cost-max-us", json_integer(g_atomic_int_get(&loop->timers_cost_max)));
+		json_object_set_new(timers, "overruns", json_integer(g_atomic_int_get(&loop->timers->overruns)));
+		json_object_set_new(info, "timers", timers);
 		json_array_append_new(list, info);
 		l = l->next;
 	}
 	janus_mutex_unlock(&event_loops_mutex);
 	return list;
 }
+
+/* Migration of a handle from a static loop to another */
+typedef struct janus_ice_handle_migration {
+	janus_ice_handle *handle;
+	janus_ice_static_event_loop *loop;
+} janus_ice_handle_migration;
+static void janus_ice_handle_migration_free(gpointer user_data) {
+	janus_ice_handle_migration *migration = (janus_ice_handle_migration *)user_data;
+	janus_refcount_decrease(&migration->loop->ref);
+	janus_refcount_decrease(&migration->handle->ref);
+	g_free(migration);
+}
+static gboolean janus_ice_outgoing_rtcp_handle(gpointer user_data);
+static gboolean janus_ice_outgoing_stats_handle(gpointer user_data);
+static gboolean janus_ice_outgoing_transport_wide_cc_feedback(gpointer user_data);
+static gboolean janus_ice_check_failed(gpointer data);
+static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint component_id, guint len, gchar *buf, gpointer ice);
+static GSource *janus_ice_outgoing_traffic_create(janus_ice_handle *handle, GDestroyNotify destroy);
+static void janus_ice_outgoing_traffic_migrated(GSource *source);
+/* Helper to replace a recurring timer with an equivalent one on a different context */
+static void janus_ice_timer_move(GSource **source, guint interval, gboolean seconds,
+		GSourceFunc func, gpointer data, GMainContext *mainctx) {
+	if(*source == NULL)
+		return;
+	gint priority = g_source_get_priority(*source);
+	g_source_destroy(*source);
+	g_source_unref(*source);
+	*source = seconds ? g_timeout_source_new_seconds(interval) : g_timeout_source_new(interval);
+	g_source_set_priority(*source, priority);
+	g_source_set_callback(*source, func, data, NULL);
+	g_source_attach(*source, mainctx);
+}
+/* Callback invoked on the loop the handle is on, to move it to a different one */
+static gboolean janus_ice_handle_migrate_internal(gpointer user_data) {
+	janus_ice_handle_migration *migration = (janus_ice_handle_migration *)user_data;
+	janus_ice_handle *handle = migration->handle;
+	janus_ice_static_event_loop *target = migration->loop;
+	if(g_atomic_int_get(&handle->destroyed) || janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_ALERT) ||
+			janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_STOP))
+		return G_SOURCE_REMOVE;
+	janus_mutex_lock(&handle->mutex);
+	janus_ice_static_event_loop *loop = (janus_ice_static_event_loop *)handle->static_event_loop;
+	if(loop == NULL || loop == target) {
+		janus_mutex_unlock(&handle->mutex);
+		return G_SOURCE_REMOVE;
+	}
+	/* Move the loop accounting first */
+	janus_mutex_lock(&event_loops_mutex);
+	if(g_atomic_int_get(&handle->destroyed)) {
+		/* The handle is being detached, which takes care of the loop accounting already */
+		janus_mutex_unlock(&event_loops_mutex);
+		janus_mutex_unlock(&handle->mutex);
+		return G_SOURCE_REMOVE;
+	}
+	loop->handles--;
+	target->handles++;
+	janus_refcount_increase(&target->ref);
+	handle->static_event_loop = target;
+	handle->mainctx = target->mainctx;
+	handle->mainloop = target->mainloop;
+	janus_mutex_unlock(&event_loops_mutex);
+	/* Move the recurring timers: we're on the old loop, so none of them can fire in the meanwhile */
+	janus_ice_timer_move(&handle->rtcp_source, 1, TRUE, janus_ice_outgoing_rtcp_handle, handle, target->mainctx);
+	janus_ice_timer_move(&handle->twcc_source, janus_get_twcc_period(), FALSE, janus_ice_outgoing_transport_wide_cc_feedback, handle, target->mainctx);
+	janus_ice_timer_move(&handle->stats_source, 1, TRUE, janus_ice_outgoing_stats_handle, handle, target->mainctx);
+	janus_timer_wheel_move(&handle->rtcp_timer, target->timers);
+	janus_timer_wheel_move(&handle->twcc_timer, target->timers);
+	janus_timer_wheel_move(&handle->stats_timer, target->timers);
+	janus_ice_peerconnection *pc = handle->pc;
+	if(pc != NULL) {
+		janus_ice_timer_move(&pc->icestate_source, 500, FALSE, janus_ice_check_failed, pc, target->mainctx);
+		janus_ice_timer_move(&pc->dtlsrt_source, 50, FALSE, janus_dtls_retry, pc->dtls, target->mainctx);
+	}
+	/* Finally, move the outgoing traffic and the incoming media */
+	if(handle->rtp_source != NULL) {
+		janus_ice_outgoing_traffic_migrated(handle->rtp_source);
+		g_source_destroy(handle->rtp_source);
+		g_source_unref(handle->rtp_source);
+		handle->rtp_source = janus_ice_outgoing_traffic_create(handle, (GDestroyNotify)g_free);
+		g_source_set_priority(handle->rtp_source, G_PRIORITY_DEFAULT);
+		g_source_attach(handle->rtp_source, target->mainctx);
+	}
+	if(handle->agent != NULL && pc != NULL && pc->mux == NULL) {
+		nice_agent_attach_recv(handle->agent, handle->stream_id, 1, target->mainctx,
+			janus_ice_cb_nice_recv, pc);
+	}
+	janus_mutex_unlock(&handle->mutex);
+	g_main_context_wakeup(target->mainctx);
+	JANUS_LOG(LOG_INFO, "[%"SCNu64"] Migrated handle from loop #%d to loop #%d\n", handle->handle_id, loop->id, target->id);
+	janus_refcount_decrease(&loop->ref);
+	return G_SOURCE_REMOVE;
+}
+int janus_ice_handle_migrate(janus_ice_handle *handle, int loop_index) {
+	if(handle == NULL || static_event_loops < 1)
+		return -1;
+	janus_mutex_lock(&event_loops_mutex);
+	janus_ice_static_event_loop *loop = loop_index > -1 ? g_slist_nth_data(event_loops, loop_index) : NULL;
+	if(loop == NULL) {
+		janus_mutex_unlock(&event_loops_mutex);
+		JANUS_LOG(LOG_ERR, "[%"SCNu64"] Invalid loop index %d\n", handle->handle_id, loop_index);
+		return -2;
+	}
+	if(handle->static_event_loop == NULL || handle->static_event_loop == loop) {
+		janus_mutex_unlock(&event_loops_mutex);
+		return 0;
+	}
+	janus_refcount_increase(&loop->ref);
+	janus_mutex_unlock(&event_loops_mutex);
+	/* The ICE agent timers can't be moved, so we only migrate handles that
+	 * either don't have a PeerConnection, or whose PeerConnection is ready */
+	janus_mutex_lock(&handle->mutex);
+	gboolean ready = !handle->agent_created || janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_READY);
+	if(!ready) {
+		janus_mutex_unlock(&handle->mutex);
+		janus_refcount_decrease(&loop->ref);
+		JANUS_LOG(LOG_WARN, "[%"SCNu64"] PeerConnection is being set up, can't migrate the handle now\n", handle->handle_id);
+		return -3;
+	}
+	/* The actual migration is performed on the loop the handle is currently on */
+	janus_ice_handle_migration *migration = g_malloc(sizeof(janus_ice_handle_migration));
+	janus_refcount_increase(&handle->ref);
+	migration->handle = handle;
+	migration->loop = loop;
+	GSource *source = g_idle_source_new();
+	g_source_set_priority(source, G_PRIORITY_DEFAULT);
+	g_source_set_callback(source, janus_ice_handle_migrate_internal, migration, janus_ice_handle_migration_free);
+	g_source_attach(source, handle->mainctx);
+	g_source_unref(source);
+	janus_mutex_unlock(&handle->mutex);
+	return 0;
+}
+
+/* Automatic rebalancing of handles across loops */
+static void janus_ice_static_event_loops_rebalance(void);
+static void *janus_ice_static_event_loops_rebalancer(void *data) {
+	JANUS_LOG(LOG_VERB, "Event loops rebalancer started\n");
+	gint64 last = janus_get_monotonic_time();
+	while(!g_atomic_int_get(&loops_rebalancer_stop)) {
+		g_usleep(100000);
+		gint64 now = janus_get_monotonic_time();
+		if(now - last < (gint64)loops_rebalance_period * G_USEC_PER_SEC)
+			continue;
+		last = now;
+		janus_ice_static_event_loops_rebalance();
+	}
+	JANUS_LOG(LOG_VERB, "Event loops rebalancer stopped\n");
+	return NULL;
+}
+void janus_ice_set_static_event_loops_rebalancing(guint period, guint threshold) {
+	if(period == 0 || static_event_loops < 2 || loops_rebalancer != NULL)
+		return;
+	loops_rebalance_period = period;
+	if(threshold > 0 && threshold <= 100)
+		loops_rebalance_threshold = threshold;
+	GError *error = NULL;
+	loops_rebalancer = g_thread_try_new("loops rebalancer", &janus_ice_static_event_loops_rebalancer, NULL, &error);
+	if(error != NULL) {
+		JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch the event loops rebalancer thread...\n",
+			error->code, error->message ? error->message : "??");
+		g_error_free(error);
+		loops_rebalancer = NULL;
+		return;
+	}
+	JANUS_LOG(LOG_INFO, "Handles will be rebalanced across event loops (checked every %u seconds, %u%% threshold)\n",
+		loops_rebalance_period, loops_rebalance_threshold);
+}
 void janus_ice_stop_static_event_loops(void) {
 	if(static_event_loops < 1)
 		return;
+	/* Stop the rebalancer first, if any */
+	if(loops_rebalancer != NULL) {
+		g_atomic_int_set(&loops_rebalancer_stop, 1);
+		g_thread_join(loops_rebalancer);
+		loops_rebalancer = NULL;
+	}
 	/* Quit all the static loops and wait for the threads to leave */
 	janus_mutex_lock(&event_loops_mutex);
 	GSList *l = event_loops;
@@ -317,6 +632,10 @@ void janus_ice_stop_static_event_loops(void) {
 	}
 	g_slist_free_full(event_loops, (GDestroyNotify)janus_ice_static_event_loop_destroy);
 	janus_mutex_unlock(&event_loops_mutex);
+	if(event_loops_cpus != NULL) {
+		g_array_free(event_loops_cpus, TRUE);
+		event_loops_cpus = NULL;
+	}
 }
 
 /* NAT 1:1 stuff */
@@ -423,6 +742,8 @@ static uint16_t rtp_range_max = 0;
 #define JANUS_ICE_PACKET_TEXT	2
 #define JANUS_ICE_PACKET_BINARY	3
 #define JANUS_ICE_PACKET_SCTP	4
+/* Incoming packet received on a shared socket, in single-port mode */
+#define JANUS_ICE_PACKET_INCOMING	5
 /* Helper to convert packet types to core types */
 static janus_media_type janus_media_type_from_packet(int type) {
 	switch(type) {
@@ -446,6 +767,8 @@ typedef struct janus_ice_queued_packet {
 	char *label;
 	char *protocol;
 	janus_plugin_rtp_extensions extensions;
+	janus_rtp_shared_packet *shared;
+	janus_plugin_data_shared *shared_data;
 	gint length;
 	gint type;
 	gboolean control, control_ext;
@@ -462,27 +785,8 @@ static janus_ice_queued_packet
 	janus_ice_media_stopped,
 	janus_ice_hangup_peerconnection,
 	janus_ice_detach_handle,
-	janus_ice_data_ready;
-
-/* Janus NACKed packet we're tracking (to avoid duplicates) */
-typedef struct janus_ice_nacked_packet {
-	janus_ice_peerconnection_medium *medium;
-	int vindex;
-	guint16 seq_number;
-	guint source_id;
-} janus_ice_nacked_packet;
-static gboolean janus_ice_nacked_packet_cleanup(gpointer user_data) {
-	janus_ice_nacked_packet *pkt = (janus_ice_nacked_packet *)user_data;
-
-	if(pkt->medium && pkt->medium->pc && pkt->medium->pc->handle) {
-		JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Cleaning up NACKed packet %"SCNu16" (SSRC %"SCNu32", vindex %d)...\n",
-			pkt->medium->pc->handle->handle_id, pkt->seq_number, pkt->medium->ssrc_peer[pkt->vindex], pkt->vindex);
-		g_hash_table_remove(pkt->medium->rtx_nacked[pkt->vindex], GUINT_TO_POINTER(pkt->seq_number));
-		g_hash_table_remove(pkt->medium->pending_nacked_cleanup, GUINT_TO_POINTER(pkt->source_id));
-	}
-
-	return G_SOURCE_REMOVE;
-}
+	janus_ice_data_ready,
+	janus_ice_mux_connected;
 
 const char *janus_media_type_str(janus_media_type type) {
 	switch(type) {
@@ -512,28 +816,52 @@ typedef struct janus_ice_outgoing_traffic {
 	GSource parent;
 	janus_ice_handle *handle;
 	GDestroyNotify destroy;
+	/* Set when the handle is moved to a different loop, and this source replaced */
+	gboolean migrated;
 } janus_ice_outgoing_traffic;
 static gboolean janus_ice_outgoing_rtcp_handle(gpointer user_data);
 static gboolean janus_ice_outgoing_stats_handle(gpointer user_data);
 static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janus_ice_queued_packet *pkt);
+static gboolean janus_ice_outgoing_traffic_pace(janus_ice_handle *handle, janus_ice_queued_packet *pkt);
+static void janus_ice_outgoing_traffic_paced(janus_ice_handle *handle);
 static gboolean janus_ice_outgoing_traffic_prepare(GSource *source, gint *timeout) {
 	janus_ice_outgoing_traffic *t = (janus_ice_outgoing_traffic *)source;
-	return (g_async_queue_length(t->handle->queued_packets) > 0);
+	if(g_async_queue_length(t->handle->queued_packets) > 0)
+		return TRUE;
+	/* If we're pacing, make sure we wake up when the next packet can be sent */
+	janus_ice_peerconnection *pc = t->handle->pc;
+	if(pc != NULL && pc->pacer != NULL) {
+		gint64 wait = janus_pacer_next(pc->pacer, janus_get_monotonic_time());
+		if(wait == 0)
+			return TRUE;
+		if(wait > 0) {
+			gint ms = (gint)((wait + 999) / 1000);
+			if(*timeout < 0 || ms < *timeout)
+				*timeout = ms;
+		}
+	}
+	return FALSE;
 }
 static gboolean janus_ice_outgoing_traffic_dispatch(GSource *source, GSourceFunc callback, gpointer user_data) {
 	janus_ice_outgoing_traffic *t = (janus_ice_outgoing_traffic *)source;
 	int ret = G_SOURCE_CONTINUE;
 	janus_ice_queued_packet *pkt = NULL;
 	while((pkt = g_async_queue_try_pop(t->handle->queued_packets)) != NULL) {
+		if(janus_ice_outgoing_traffic_pace(t->handle, pkt))
+			continue;
 		if(janus_ice_outgoing_traffic_handle(t->handle, pkt) == G_SOURCE_REMOVE)
 			ret = G_SOURCE_REMOVE;
 	}
+	if(ret == G_SOURCE_CONTINUE)
+		janus_ice_outgoing_traffic_paced(t->handle);
 	return ret;
 }
 static void janus_ice_outgoing_traffic_finalize(GSource *source) {
 	janus_ice_outgoing_traffic *t = (janus_ice_outgoing_traffic *)source;
 	JANUS_LOG(LOG_VERB, "[%"SCNu64"] Finalizing loop source\n", t->handle->handle_id);
-	if(static_event_loops > 0) {
+	if(t->migrated) {
+		/* The handle lives on in a different loop, just release our reference */
+	} else if(static_event_loops > 0) {
 		/* This handle was sharing an event loop with others */
 		janus_ice_webrtc_free(t->handle);
 		janus_refcount_decrease(&t->handle->ref);
@@ -561,6 +889,10 @@ static GSource *janus_ice_outgoing_traffic_create(janus_ice_handle *handle, GDes
 	t->destroy = destroy;
 	return source;
 }
+static void janus_ice_outgoing_traffic_migrated(GSource *source) {
+	janus_ice_outgoing_traffic *t = (janus_ice_outgoing_traffic *)source;
+	t->migrated = TRUE;
+}
 
 /* Time, in seconds, that should pass with no media (audio or video) being
  * received before Janus notifies you about this with a receiving=false */
@@ -598,6 +930,8 @@ uint janus_get_slowlink_threshold(void) {
 /* Period, in milliseconds, to refer to for sending TWCC feedback */
 #define DEFAULT_TWCC_PERIOD		200
 static uint twcc_period = DEFAULT_TWCC_PERIOD;
+/* Minimum number of packets the TWCC receive history can track between feedbacks */
+#define JANUS_ICE_TWCC_HISTORY_MIN	1024
 void janus_set_twcc_period(uint period) {
 	twcc_period = period;
 	if(twcc_period == 0) {
@@ -611,6 +945,18 @@ uint janus_get_twcc_period(void) {
 	return twcc_period;
 }
 
+/* Multiplier for the pacing rate of outgoing video: pacing is disabled by default */
+static double pacing_multiplier = 0.0;
+void janus_set_pacing_multiplier(double multiplier) {
+	pacing_multiplier = multiplier > 0 ? multiplier : 0.0;
+	if(pacing_multiplier > 0) {
+		JANUS_LOG(LOG_VERB, "Pacing outgoing video at %.2fx\n", pacing_multiplier);
+	}
+}
+double janus_get_pacing_multiplier(void) {
+	return pacing_multiplier;
+}
+
 /* DSCP value, which we can set via libnice: it's disabled by default */
 static int dscp_ef = 0;
 void janus_set_dscp(int dscp) {
@@ -630,6 +976,7 @@ static inline void janus_ice_free_rtp_packet(janus_rtp_packet *pkt) {
 	}
 
 	g_free(pkt->data);
+	janus_rtp_shared_packet_unref(pkt->shared);
 	g_free(pkt);
 }
 
@@ -640,12 +987,15 @@ static void janus_ice_free_queued_packet(janus_ice_queued_packet *pkt) {
 			pkt == &janus_ice_media_stopped ||
 			pkt == &janus_ice_hangup_peerconnection ||
 			pkt == &janus_ice_detach_handle ||
-			pkt == &janus_ice_data_ready) {
+			pkt == &janus_ice_data_ready ||
+			pkt == &janus_ice_mux_connected) {
 		return;
 	}
 	g_free(pkt->data);
 	g_free(pkt->label);
 	g_free(pkt->protocol);
+	janus_rtp_shared_packet_unref(pkt->shared);
+	janus_plugin_data_shared_unref(pkt->shared_data);
 	g_free(pkt);
 }
 
@@ -706,44 +1056,45 @@ static void janus_cleanup_nack_buffer(gint64 now, janus_ice_peerconnection *pc,
 
 #define SEQ_MISSING_WAIT 12000 /*  12ms */
 #define SEQ_NACKED_WAIT 155000 /* 155ms */
-/* janus_seq_info list functions */
-static void janus_seq_append(janus_seq_info **head, janus_seq_info *new_seq) {
-	if(*head == NULL) {
-		new_seq->prev = new_seq;
-		new_seq->next = new_seq;
-		*head = new_seq;
-	} else {
-		janus_seq_info *last_seq = (*head)->prev;
-		new_seq->prev = last_seq;
-		new_seq->next = *head;
-		(*head)->prev = new_seq;
-		last_seq->next = new_seq;
-	}
-}
-static janus_seq_info *janus_seq_pop_head(janus_seq_info **head) {
-	janus_seq_info *pop_seq = *head;
-	if(pop_seq) {
-		janus_seq_info *new_head = pop_seq->next;
-		if(pop_seq == new_head || new_head == NULL) {
-			*head = NULL;
-		} else {
-			*head = new_head;
-			new_head->prev = pop_seq->prev;
-			new_head->prev->next = new_head;
-		}
+/* Helper to copy an SDES item (mid or rid) parsed from an RTP extension to a null-terminated buffer */
+static int janus_ice_copy_sdes_item(const char *item, uint8_t item_len, char *buf, int buf_len) {
+	if(item == NULL || item_len < 1 || buf == NULL || buf_len < 2)
+		return -1;
+	if(item_len > (buf_len-1)) {
+		JANUS_LOG(LOG_WARN, "Buffer is too small (%d > %d), SDES item will be cut\n", item_len, buf_len);
+		item_len = buf_len-1;
 	}
-	return pop_seq;
+	memcpy(buf, item, item_len);
+	*(buf+item_len) = '\0';
+	return 0;
 }
-void janus_seq_list_free(janus_seq_info **head) {
-	if(!*head)
+
+#define SEQ_NACKED_TTL (5*G_USEC_PER_SEC)
+/* janus_seq_window and janus_seq_nacked functions */
+void janus_seq_window_reset(janus_seq_window *window) {
+	if(window == NULL)
 		return;
-	janus_seq_info *cur = *head;
-	do {
-		janus_seq_info *next = cur->next;
-		g_free(cur);
-		cur = next;
-	} while(cur != *head);
-	*head = NULL;
+	window->head = 0;
+	window->count = 0;
+	window->missing = 0;
+}
+static int janus_seq_nacked_get(janus_seq_nacked *nacked, guint16 seq) {
+	if(nacked == NULL)
+		return 0;
+	/* Entries we NACKed too long ago are considered expired */
+	if(nacked->packets[seq & (JANUS_SEQ_NACKED_SIZE-1)].state == 0 ||
+			nacked->packets[seq & (JANUS_SEQ_NACKED_SIZE-1)].seq != seq ||
+			janus_get_monotonic_time() - nacked->packets[seq & (JANUS_SEQ_NACKED_SIZE-1)].ts > SEQ_NACKED_TTL)
+		return 0;
+	return nacked->packets[seq & (JANUS_SEQ_NACKED_SIZE-1)].state;
+}
+static void janus_seq_nacked_set(janus_seq_nacked *nacked, guint16 seq, guint8 state, gint64 now) {
+	if(nacked == NULL)
+		return;
+	nacked->packets[seq & (JANUS_SEQ_NACKED_SIZE-1)].seq = seq;
+	nacked->packets[seq & (JANUS_SEQ_NACKED_SIZE-1)].state = state;
+	if(state == 1)
+		nacked->packets[seq & (JANUS_SEQ_NACKED_SIZE-1)].ts = now;
 }
 static int janus_seq_in_range(guint16 seqn, guint16 start, guint16 len) {
 	/* Supports wrapping sequence (easier with int range) */
@@ -781,6 +1132,73 @@ static void janus_plugin_session_dereference(janus_plugin_session *plugin_sessio
 		janus_refcount_decrease(&plugin_session->ref);
 }
 
+/* Helper to move a handle from the busiest static loop to the least loaded one, if the gap is large enough */
+static void janus_ice_static_event_loops_rebalance(void) {
+	/* Find the busiest and the least loaded loops */
+	janus_ice_static_event_loop *busiest = NULL, *idlest = NULL;
+	guint64 max = 0, min = 0;
+	janus_mutex_lock(&event_loops_mutex);
+	GSList *l = event_loops;
+	while(l) {
+		janus_ice_static_event_loop *loop = (janus_ice_static_event_loop *)l->data;
+		guint64 load = janus_ice_static_event_loop_load(loop);
+		if(busiest == NULL || load > max) {
+			max = load;
+			busiest = loop;
+		}
+		if(idlest == NULL || load < min) {
+			min = load;
+			idlest = loop;
+		}
+		l = l->next;
+	}
+	janus_mutex_unlock(&event_loops_mutex);
+	guint64 gap = max - min;
+	gboolean unbalanced = (busiest != idlest && gap * 100 >= (guint64)loops_rebalance_threshold * max);
+	/* Update the rate of all handles, and look for the one on the busiest loop
+	 * that would best close the gap (ideally, half of it) when moved */
+	janus_ice_handle *candidate = NULL;
+	guint64 distance = 0;
+	gint64 now = janus_get_monotonic_time();
+	janus_mutex_lock(&plugin_sessions_mutex);
+	GHashTableIter iter;
+	gpointer value;
+	g_hash_table_iter_init(&iter, plugin_sessions);
+	while(g_hash_table_iter_next(&iter, NULL, &value)) {
+		janus_plugin_session *session_handle = (janus_plugin_session *)value;
+		janus_ice_handle *handle = (janus_ice_handle *)session_handle->gateway_handle;
+		if(handle == NULL || g_atomic_int_get(&handle->destroyed))
+			continue;
+		guint64 packets = handle->loop_packets;
+		gint64 last = handle->loop_snapshot_time;
+		guint64 rate = 0;
+		if(last > 0 && now > last)
+			rate = (packets - handle->loop_packets_snapshot) * G_USEC_PER_SEC / (now - last);
+		handle->loop_packets_snapshot = packets;
+		handle->loop_snapshot_time = now;
+		if(!unbalanced || last == 0 || handle->static_event_loop != busiest)
+			continue;
+		/* Moving the handle moves its baseline too */
+		rate += JANUS_ICE_LOOP_HANDLE_WEIGHT;
+		if(rate >= gap)
+			continue;
+		guint64 d = rate > gap/2 ? rate - gap/2 : gap/2 - rate;
+		if(candidate == NULL || d < distance) {
+			candidate = handle;
+			distance = d;
+		}
+	}
+	if(candidate != NULL)
+		janus_refcount_increase(&candidate->ref);
+	janus_mutex_unlock(&plugin_sessions_mutex);
+	if(candidate == NULL)
+		return;
+	JANUS_LOG(LOG_VERB, "[%"SCNu64"] Rebalancing event loops, moving handle from loop #%d to loop #%d\n",
+		candidate->handle_id, busiest->id, idlest->id);
+	janus_ice_handle_migrate(candidate, idlest->id);
+	janus_refcount_decrease(&candidate->ref);
+}
+
 
 static void janus_ice_clear_queued_candidates(janus_ice_handle *handle) {
 	if(handle == NULL || handle->queued_candidates == NULL) {
@@ -1011,6 +1429,538 @@ void janus_ice_trickle_destroy(janus_ice_trickle *trickle) {
 
 
 /* libnice initialization */
+static GList *janus_ice_get_local_addresses(guint64 handle_id);
+/* Single-port ICE mode (ICE Lite only): rather than having each PeerConnection
+ * gather its own candidates (and so bind its own sockets), all of them share a
+ * few UDP sockets bound to the same port. Incoming traffic is demultiplexed by
+ * looking at the STUN USERNAME the first time a peer reaches us, and by the
+ * source address after that. Each socket has its own thread, and since the
+ * kernel always dispatches the same 5-tuple to the same SO_REUSEPORT socket,
+ * the address mapping can be per-socket, and so doesn't need any locking */
+typedef struct janus_ice_mux_address {
+	struct sockaddr_storage address;
+	socklen_t address_len;
+} janus_ice_mux_address;
+typedef struct janus_ice_mux_entry {
+	/* Handle this entry belongs to (NULL once the PeerConnection is gone) */
+	janus_ice_handle *handle;
+	/* Local ICE credentials */
+	gchar *ufrag, *pwd;
+	/* Socket and address the peer is reaching us from */
+	int fd;
+	janus_ice_mux_address peer;
+	gboolean connected;
+	janus_mutex mutex;
+	janus_refcount ref;
+} janus_ice_mux_entry;
+typedef struct janus_ice_mux_socket {
+	int fd;
+	int family;
+	GThread *thread;
+} janus_ice_mux_socket;
+static uint16_t janus_ice_mux_port = 0;
+static GSList *janus_ice_mux_candidates = NULL;
+static GList *janus_ice_mux_sockets = NULL;
+static GHashTable *janus_ice_mux_ufrags = NULL;
+static janus_mutex janus_ice_mux_mutex = JANUS_MUTEX_INITIALIZER;
+static volatile gint janus_ice_mux_stopping = 0;
+/* How often the socket threads get rid of addresses of PeerConnections that are gone */
+#define JANUS_ICE_MUX_CLEANUP_PERIOD	(10*G_USEC_PER_SEC)
+/* Size of the buffer we read datagrams in: as libnice, large enough for any UDP datagram */
+#define JANUS_ICE_MUX_BUFFER_SIZE		65536
+static void janus_ice_queue_packet(janus_ice_handle *handle, janus_ice_queued_packet *pkt);
+
+gboolean janus_ice_is_single_port_enabled(void) {
+	return janus_ice_mux_port > 0;
+}
+uint16_t janus_ice_get_single_port(void) {
+	return janus_ice_mux_port;
+}
+
+static void janus_ice_mux_entry_free(const janus_refcount *entry_ref) {
+	janus_ice_mux_entry *entry = janus_refcount_containerof(entry_ref, janus_ice_mux_entry, ref);
+	g_free(entry->ufrag);
+	g_free(entry->pwd);
+	g_free(entry);
+}
+static void janus_ice_mux_entry_unref(janus_ice_mux_entry *entry) {
+	if(entry)
+		janus_refcount_decrease(&entry->ref);
+}
+
+/* Hashing of addresses, for the per-socket mapping */
+static guint janus_ice_mux_address_hash(gconstpointer key) {
+	const janus_ice_mux_address *a = (const janus_ice_mux_address *)key;
+	if(a->address.ss_family == AF_INET) {
+		const struct sockaddr_in *sin = (const struct sockaddr_in *)&a->address;
+		return sin->sin_addr.s_addr ^ ((guint)sin->sin_port << 16);
+	}
+	const struct sockaddr_in6 *sin6 = (const struct sockaddr_in6 *)&a->address;
+	const guint32 *words = (const guint32 *)&sin6->sin6_addr;
+	return words[0] ^ words[1] ^ words[2] ^ words[3] ^ ((guint)sin6->sin6_port << 16);
+}
+static gboolean janus_ice_mux_address_equal(gconstpointer v1, gconstpointer v2) {
+	const janus_ice_mux_address *a1 = (const janus_ice_mux_address *)v1, *a2 = (const janus_ice_mux_address *)v2;
+	if(a1->address.ss_family != a2->address.ss_family)
+		return FALSE;
+	if(a1->address.ss_family == AF_INET) {
+		const struct sockaddr_in *s1 = (const struct sockaddr_in *)&a1->address, *s2 = (const struct sockaddr_in *)&a2->address;
+		return s1->sin_port == s2->sin_port && s1->sin_addr.s_addr == s2->sin_addr.s_addr;
+	}
+	const struct sockaddr_in6 *s1 = (const struct sockaddr_in6 *)&a1->address, *s2 = (const struct sockaddr_in6 *)&a2->address;
+	return s1->sin6_port == s2->sin6_port && !memcmp(&s1->sin6_addr, &s2->sin6_addr, sizeof(struct in6_addr));
+}
+
+/* Register the local credentials of a PeerConnection, so that we can match incoming connectivity checks */
+static void janus_ice_mux_register(janus_ice_peerconnection *pc) {
+	janus_ice_handle *handle = pc->handle;
+	gchar *ufrag = NULL, *pwd = NULL;
+	if(!nice_agent_get_local_credentials(handle->agent, pc->stream_id, &ufrag, &pwd)) {
+		JANUS_LOG(LOG_ERR, "[%"SCNu64"] Couldn't get the local ICE credentials\n", handle->handle_id);
+		return;
+	}
+	janus_ice_mux_entry *entry = (janus_ice_mux_entry *)pc->mux;
+	janus_mutex_lock(&janus_ice_mux_mutex);
+	if(entry == NULL) {
+		entry = g_malloc0(sizeof(janus_ice_mux_entry));
+		entry->handle = handle;
+		entry->fd = -1;
+		janus_mutex_init(&entry->mutex);
+		janus_refcount_init(&entry->ref, janus_ice_mux_entry_free);
+		pc->mux = entry;
+	} else if(entry->ufrag != NULL) {
+		/* ICE restart, get rid of the old credentials */
+		g_hash_table_remove(janus_ice_mux_ufrags, entry->ufrag);
+	}
+	janus_mutex_lock(&entry->mutex);
+	g_free(entry->ufrag);
+	entry->ufrag = ufrag;
+	g_free(entry->pwd);
+	entry->pwd = pwd;
+	janus_mutex_unlock(&entry->mutex);
+	janus_refcount_increase(&entry->ref);
+	g_hash_table_insert(janus_ice_mux_ufrags, g_strdup(ufrag), entry);
+	janus_mutex_unlock(&janus_ice_mux_mutex);
+	JANUS_LOG(LOG_VERB, "[%"SCNu64"] Waiting for connectivity checks on the shared port (ufrag %s)\n", handle->handle_id, ufrag);
+}
+/* Stop demultiplexing traffic for a PeerConnection (the entry is freed with the PeerConnection) */
+static void janus_ice_mux_unregister(janus_ice_peerconnection *pc) {
+	janus_ice_mux_entry *entry = (janus_ice_mux_entry *)pc->mux;
+	if(entry == NULL)
+		return;
+	janus_mutex_lock(&janus_ice_mux_mutex);
+	if(entry->ufrag != NULL)
+		g_hash_table_remove(janus_ice_mux_ufrags, entry->ufrag);
+	janus_mutex_unlock(&janus_ice_mux_mutex);
+	/* Socket threads will drop their mapping to this entry the next time they see it */
+	janus_mutex_lock(&entry->mutex);
+	entry->handle = NULL;
+	janus_mutex_unlock(&entry->mutex);
+}
+
+int janus_ice_peerconnection_send(janus_ice_peerconnection *pc, const char *buf, int len) {
+	if(pc == NULL || pc->handle == NULL || buf == NULL || len < 1)
+		return -1;
+	janus_ice_mux_entry *entry = (janus_ice_mux_entry *)pc->mux;
+	if(entry == NULL) {
+		if(pc->handle->agent == NULL)
+			return -1;
+		return nice_agent_send(pc->handle->agent, pc->stream_id, pc->component_id, len, buf);
+	}
+	/* Single-port mode, send on the socket the peer is using */
+	janus_mutex_lock(&entry->mutex);
+	if(entry->fd < 0) {
+		janus_mutex_unlock(&entry->mutex);
+		return -1;
+	}
+	int sent = sendto(entry->fd, buf, len, 0, (struct sockaddr *)&entry->peer.address, entry->peer.address_len);
+	janus_mutex_unlock(&entry->mutex);
+	return sent;
+}
+
+/* Callback to retrieve the password to validate a connectivity check */
+typedef struct janus_ice_mux_credentials {
+	janus_ice_mux_entry *entry;
+	uint8_t pwd[256];
+} janus_ice_mux_credentials;
+static bool janus_ice_mux_stun_credentials(StunAgent *agent, StunMessage *message,
+		uint8_t *username, uint16_t username_len, uint8_t **password, size_t *password_len, void *user_data) {
+	janus_ice_mux_credentials *credentials = (janus_ice_mux_credentials *)user_data;
+	/* The USERNAME is in the "local:remote" format, we only need the first part */
+	char ufrag[256];
+	uint16_t i = 0;
+	while(i < username_len && i < sizeof(ufrag)-1 && username[i] != ':') {
+		ufrag[i] = username[i];
+		i++;
+	}
+	ufrag[i] = '\0';
+	janus_mutex_lock(&janus_ice_mux_mutex);
+	janus_ice_mux_entry *entry = g_hash_table_lookup(janus_ice_mux_ufrags, ufrag);
+	if(entry == NULL) {
+		janus_mutex_unlock(&janus_ice_mux_mutex);
+		return FALSE;
+	}
+	janus_refcount_increase(&entry->ref);
+	janus_mutex_unlock(&janus_ice_mux_mutex);
+	/* Copy the password, as it may change in case of ICE restarts */
+	janus_mutex_lock(&entry->mutex);
+	size_t len = entry->pwd ? strlen(entry->pwd) : 0;
+	if(len > sizeof(credentials->pwd))
+		len = sizeof(credentials->pwd);
+	if(len > 0)
+		memcpy(credentials->pwd, entry->pwd, len);
+	janus_mutex_unlock(&entry->mutex);
+	credentials->entry = entry;
+	*password = credentials->pwd;
+	*password_len = len;
+	return TRUE;
+}
+
+/* Process a connectivity check received on a shared socket */
+static void janus_ice_mux_incoming_stun(janus_ice_mux_socket *mux_socket, StunAgent *stun, GHashTable *peers,
+		char *buf, int len, janus_ice_mux_address *from) {
+	StunMessage msg;
+	janus_ice_mux_credentials credentials = { 0 };
+	StunValidationStatus status = stun_agent_validate(stun, &msg, (uint8_t *)buf, len,
+		janus_ice_mux_stun_credentials, &credentials);
+	janus_ice_mux_entry *entry = credentials.entry;
+	if(status != STUN_VALIDATION_SUCCESS || entry == NULL ||
+			stun_message_get_class(&msg) != STUN_REQUEST || stun_message_get_method(&msg) != STUN_BINDING) {
+		JANUS_LOG(LOG_HUGE, "Dropping invalid or unexpected STUN message on the shared port (%d)\n", status);
+		janus_ice_mux_entry_unref(entry);
+		return;
+	}
+	/* Send a response: we're ICE Lite, so always controlled */
+	uint8_t rbuf[1280];
+	size_t rlen = sizeof(rbuf);
+	StunMessage reply;
+	bool control = FALSE;
+	StunUsageIceReturn ret = stun_usage_ice_conncheck_create_reply(stun, &msg, &reply, rbuf, &rlen,
+		&from->address, from->address_len, &control, 0, STUN_USAGE_ICE_COMPATIBILITY_RFC5245);
+	if(ret == STUN_USAGE_ICE_RETURN_SUCCESS || ret == STUN_USAGE_ICE_RETURN_ROLE_CONFLICT) {
+		if(sendto(mux_socket->fd, rbuf, rlen, 0, (struct sockaddr *)&from->address, from->address_len) < 0) {
+			JANUS_LOG(LOG_WARN, "Error sending STUN response on the shared port: %d (%s)\n", errno, g_strerror(errno));
+		}
+	}
+	if(ret != STUN_USAGE_ICE_RETURN_SUCCESS) {
+		janus_ice_mux_entry_unref(entry);
+		return;
+	}
+	/* Map this address to the PeerConnection, if it's the first one we see or the peer nominated it */
+	gboolean nominated = stun_usage_ice_conncheck_use_candidate(&msg);
+	janus_mutex_lock(&entry->mutex);
+	if(entry->handle != NULL && (!entry->connected || nominated) &&
+			(entry->fd != mux_socket->fd || !janus_ice_mux_address_equal(&entry->peer, from))) {
+		janus_ice_handle *handle = entry->handle;
+		entry->fd = mux_socket->fd;
+		memcpy(&entry->peer, from, sizeof(janus_ice_mux_address));
+		janus_ice_mux_address *key = g_malloc(sizeof(janus_ice_mux_address));
+		memcpy(key, from, sizeof(janus_ice_mux_address));
+		janus_refcount_increase(&entry->ref);
+		g_hash_table_insert(peers, key, entry);
+		char address[NI_MAXHOST], port[NI_MAXSERV];
+		if(getnameinfo((struct sockaddr *)&from->address, from->address_len, address, sizeof(address),
+				port, sizeof(port), NI_NUMERICHOST | NI_NUMERICSERV) == 0) {
+			JANUS_LOG(LOG_VERB, "[%"SCNu64"] Peer reached us on the shared port from %s:%s%s\n",
+				handle->handle_id, address, port, nominated ? " (nominated)" : "");
+		}
+		if(!entry->connected) {
+			/* Let the handle know it can start the DTLS handshake */
+			entry->connected = TRUE;
+			janus_ice_queue_packet(handle, &janus_ice_mux_connected);
+		}
+	}
+	janus_mutex_unlock(&entry->mutex);
+	janus_ice_mux_entry_unref(entry);
+}
+
+void janus_ice_incoming_packet(janus_ice_handle *handle, const char *buf, int len) {
+	if(handle == NULL || handle->queued_packets == NULL || buf == NULL || len < 1)
+		return;
+	janus_ice_queued_packet *pkt = g_malloc(sizeof(janus_ice_queued_packet));
+	pkt->mindex = -1;
+	pkt->data = g_malloc(len);
+	memcpy(pkt->data, buf, len);
+	pkt->length = len;
+	pkt->type = JANUS_ICE_PACKET_INCOMING;
+	memset(&pkt->extensions, 0, sizeof(pkt->extensions));
+	pkt->control = FALSE;
+	pkt->control_ext = FALSE;
+	pkt->encrypted = TRUE;
+	pkt->retransmission = FALSE;
+	pkt->label = NULL;
+	pkt->protocol = NULL;
+	pkt->shared = NULL;
+	pkt->shared_data = NULL;
+	pkt->added = janus_get_monotonic_time();
+	janus_ice_queue_packet(handle, pkt);
+}
+
+void janus_ice_peerconnection_connected(janus_ice_handle *handle) {
+	if(handle == NULL || handle->queued_packets == NULL)
+		return;
+	janus_mutex_lock(&handle->mutex);
+	janus_ice_peerconnection *pc = handle->pc;
+	if(pc == NULL || pc->connected > 0) {
+		janus_mutex_unlock(&handle->mutex);
+		return;
+	}
+	JANUS_LOG(LOG_VERB, "[%"SCNu64"]   PeerConnection connected outside of libnice, starting DTLS handshake...\n", handle->handle_id);
+	pc->connected = janus_get_monotonic_time();
+	janus_mutex_unlock(&handle->mutex);
+#if GLIB_CHECK_VERSION(2, 46, 0)
+	g_async_queue_push_front(handle->queued_packets, &janus_ice_dtls_handshake);
+#else
+	g_async_queue_push(handle->queued_packets, &janus_ice_dtls_handshake);
+#endif
+	g_main_context_wakeup(handle->mainctx);
+}
+
+/* Hand a packet received on a shared socket to the handle, which will process it in its loop */
+static void janus_ice_mux_incoming(janus_ice_mux_entry *entry, char *buf, int len) {
+	janus_mutex_lock(&entry->mutex);
+	if(entry->handle != NULL)
+		janus_ice_incoming_packet(entry->handle, buf, len);
+	janus_mutex_unlock(&entry->mutex);
+}
+
+/* Helper to get rid of the addresses of PeerConnections that are gone */
+static gboolean janus_ice_mux_peer_is_gone(gpointer key, gpointer value, gpointer user_data) {
+	janus_ice_mux_entry *entry = (janus_ice_mux_entry *)value;
+	janus_ice_mux_address *address = (janus_ice_mux_address *)key;
+	janus_mutex_lock(&entry->mutex);
+	gboolean gone = (entry->handle == NULL || entry->fd != GPOINTER_TO_INT(user_data) ||
+		!janus_ice_mux_address_equal(&entry->peer, address));
+	janus_mutex_unlock(&entry->mutex);
+	return gone;
+}
+
+/* Thread reading from one of the shared sockets */
+static void *janus_ice_mux_thread(void *data) {
+	janus_ice_mux_socket *mux_socket = (janus_ice_mux_socket *)data;
+	JANUS_LOG(LOG_VERB, "Single-port ICE thread started (socket %d)\n", mux_socket->fd);
+	StunAgent stun;
+	stun_agent_init(&stun, STUN_ALL_KNOWN_ATTRIBUTES, STUN_COMPATIBILITY_RFC5389,
+		STUN_AGENT_USAGE_SHORT_TERM_CREDENTIALS | STUN_AGENT_USAGE_USE_FINGERPRINT);
+	GHashTable *peers = g_hash_table_new_full(janus_ice_mux_address_hash, janus_ice_mux_address_equal,
+		(GDestroyNotify)g_free, (GDestroyNotify)janus_ice_mux_entry_unref);
+	char *buffer = g_malloc(JANUS_ICE_MUX_BUFFER_SIZE);
+	janus_ice_mux_address from;
+	struct pollfd fds;
+	gint64 last_cleanup = janus_get_monotonic_time();
+	while(!g_atomic_int_get(&janus_ice_mux_stopping)) {
+		fds.fd = mux_socket->fd;
+		fds.events = POLLIN;
+		fds.revents = 0;
+		int res = poll(&fds, 1, 1000);
+		if(res < 0) {
+			if(errno == EINTR)
+				continue;
+			JANUS_LOG(LOG_ERR, "Error polling the shared ICE socket: %d (%s)\n", errno, g_strerror(errno));
+			break;
+		}
+		/* Read all we can */
+		while(res > 0) {
+			from.address_len = sizeof(from.address);
+			int len = recvfrom(mux_socket->fd, buffer, JANUS_ICE_MUX_BUFFER_SIZE, MSG_DONTWAIT | MSG_TRUNC,
+				(struct sockaddr *)&from.address, &from.address_len);
+			if(len < 0)
+				break;
+			if(len > JANUS_ICE_MUX_BUFFER_SIZE) {
+				/* MSG_TRUNC gives us the actual size: never process a truncated datagram */
+				JANUS_LOG(LOG_WARN, "Datagram too large on the shared ICE socket (%d bytes), dropping it\n", len);
+				continue;
+			}
+			if(len < 2)
+				continue;
+			janus_ice_mux_entry *entry = g_hash_table_lookup(peers, &from);
+			if(!janus_is_dtls(buffer) && !janus_is_rtp(buffer, len) && !janus_is_rtcp(buffer, len)) {
+				/* Probably a connectivity check */
+				janus_ice_mux_incoming_stun(mux_socket, &stun, peers, buffer, len, &from);
+			} else if(entry != NULL) {
+				janus_ice_mux_incoming(entry, buffer, len);
+			}
+		}
+		gint64 now = janus_get_monotonic_time();
+		if(now - last_cleanup >= JANUS_ICE_MUX_CLEANUP_PERIOD) {
+			g_hash_table_foreach_remove(peers, janus_ice_mux_peer_is_gone, GINT_TO_POINTER(mux_socket->fd));
+			last_cleanup = now;
+		}
+	}
+	g_hash_table_destroy(peers);
+	g_free(buffer);
+	JANUS_LOG(LOG_VERB, "Single-port ICE thread leaving (socket %d)\n", mux_socket->fd);
+	return NULL;
+}
+
+/* Helper to create one of the shared sockets */
+static int janus_ice_mux_socket_create(int family, uint16_t port) {
+	int fd = socket(family, SOCK_DGRAM, IPPROTO_UDP);
+	if(fd < 0) {
+		JANUS_LOG(LOG_ERR, "Error creating shared ICE socket: %d (%s)\n", errno, g_strerror(errno));
+		return -1;
+	}
+	int yes = 1;
+	if(setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes)) < 0) {
+		JANUS_LOG(LOG_ERR, "Error setting SO_REUSEPORT on shared ICE socket: %d (%s)\n", errno, g_strerror(errno));
+		close(fd);
+		return -1;
+	}
+	if(family == AF_INET6 && setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &yes, sizeof(yes)) < 0) {
+		JANUS_LOG(LOG_WARN, "Error setting IPV6_V6ONLY on shared ICE socket: %d (%s)\n", errno, g_strerror(errno));
+	}
+	if(dscp_ef > 0) {
+		int tos = dscp_ef << 2;
+		if(setsockopt(fd, family == AF_INET ? IPPROTO_IP : IPPROTO_IPV6,
+				family == AF_INET ? IP_TOS : IPV6_TCLASS, &tos, sizeof(tos)) < 0) {
+			JANUS_LOG(LOG_WARN, "Error setting DSCP on shared ICE socket: %d (%s)\n", errno, g_strerror(errno));
+		}
+	}
+	struct sockaddr_storage address = { 0 };
+	socklen_t address_len = 0;
+	if(family == AF_INET) {
+		struct sockaddr_in *sin = (struct sockaddr_in *)&address;
+		sin->sin_family = AF_INET;
+		sin->sin_port = htons(port);
+		sin->sin_addr.s_addr = INADDR_ANY;
+		address_len = sizeof(struct sockaddr_in);
+	} else {
+		struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)&address;
+		sin6->sin6_family = AF_INET6;
+		sin6->sin6_port = htons(port);
+		sin6->sin6_addr = in6addr_any;
+		address_len = sizeof(struct sockaddr_in6);
+	}
+	if(bind(fd, (struct sockaddr *)&address, address_len) < 0) {
+		JANUS_LOG(LOG_ERR, "Error binding shared ICE socket to port %"SCNu16": %d (%s)\n", port, errno, g_strerror(errno));
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+int janus_ice_set_single_port(uint16_t port, int sockets) {
+	if(port == 0 || janus_ice_mux_port > 0)
+		return -1;
+	if(!janus_ice_lite_enabled) {
+		JANUS_LOG(LOG_WARN, "Single-port ICE mode requires ICE Lite, enabling it\n");
+		janus_ice_lite_enabled = TRUE;
+	}
+	if(janus_ice_tcp_enabled) {
+		JANUS_LOG(LOG_WARN, "Single-port ICE mode only supports UDP, disabling ICE-TCP\n");
+		janus_ice_tcp_enabled = FALSE;
+	}
+	if(sockets < 1)
+		sockets = g_get_num_processors();
+	/* Prepare the host candidates we'll advertise for all PeerConnections */
+	GList *addresses = janus_ice_get_local_addresses(0), *temp = addresses;
+	guint index = 0;
+	gboolean ipv4 = FALSE, ipv6 = FALSE;
+	while(temp) {
+		const char *host = (const char *)temp->data;
+		NiceCandidate *c = nice_candidate_new(NICE_CANDIDATE_TYPE_HOST);
+		if(!nice_address_set_from_string(&c->addr, host)) {
+			nice_candidate_free(c);
+			temp = temp->next;
+			continue;
+		}
+		nice_address_set_port(&c->addr, port);
+		c->base_addr = c->addr;
+		c->transport = NICE_CANDIDATE_TRANSPORT_UDP;
+		c->component_id = 1;
+		/* Host candidate priority, with a decreasing local preference */
+		c->priority = (126 << 24) | ((65535 - index) << 8) | (256 - c->component_id);
+		g_snprintf(c->foundation, sizeof(c->foundation), "%u", index + 1);
+		if(nice_address_ip_version(&c->addr) == 6)
+			ipv6 = TRUE;
+		else
+			ipv4 = TRUE;
+		janus_ice_mux_candidates = g_slist_append(janus_ice_mux_candidates, c);
+		index++;
+		temp = temp->next;
+	}
+	g_list_free_full(addresses, (GDestroyNotify)g_free);
+	if(janus_ice_mux_candidates == NULL) {
+		JANUS_LOG(LOG_ERR, "No local addresses available for single-port ICE mode\n");
+		return -1;
+	}
+	/* Create the shared sockets, and a thread for each of them */
+	janus_ice_mux_ufrags = g_hash_table_new_full(g_str_hash, g_str_equal,
+		(GDestroyNotify)g_free, (GDestroyNotify)janus_ice_mux_entry_unref);
+	int family = 0;
+	for(family=0; family<2; family++) {
+		if((family == 0 && !ipv4) || (family == 1 && !ipv6))
+			continue;
+		int i = 0;
+		for(i=0; i<sockets; i++) {
+			int fd = janus_ice_mux_socket_create(family == 0 ? AF_INET : AF_INET6, port);
+			if(fd < 0)
+				break;
+			janus_ice_mux_socket *mux_socket = g_malloc0(sizeof(janus_ice_mux_socket));
+			mux_socket->fd = fd;
+			mux_socket->family = family == 0 ? AF_INET : AF_INET6;
+			GError *error = NULL;
+			char tname[16];
+			g_snprintf(tname, sizeof(tname), "ice mux %d", g_list_length(janus_ice_mux_sockets));
+			mux_socket->thread = g_thread_try_new(tname, &janus_ice_mux_thread, mux_socket, &error);
+			if(error != NULL) {
+				JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch a single-port ICE thread...\n",
+					error->code, error->message ? error->message : "??");
+				g_error_free(error);
+				close(fd);
+				g_free(mux_socket);
+				break;
+			}
+			janus_ice_mux_sockets = g_list_append(janus_ice_mux_sockets, mux_socket);
+		}
+	}
+	if(janus_ice_mux_sockets == NULL) {
+		g_slist_free_full(janus_ice_mux_candidates, (GDestroyNotify)nice_candidate_free);
+		janus_ice_mux_candidates = NULL;
+		g_hash_table_destroy(janus_ice_mux_ufrags);
+		janus_ice_mux_ufrags = NULL;
+		return -1;
+	}
+	janus_ice_mux_port = port;
+	JANUS_LOG(LOG_INFO, "Single-port ICE mode enabled: port %"SCNu16", %d sockets, %u host candidates\n",
+		janus_ice_mux_port, g_list_length(janus_ice_mux_sockets), g_slist_length(janus_ice_mux_candidates));
+	return 0;
+}
+
+static void janus_ice_mux_deinit(void) {
+	if(janus_ice_mux_port == 0)
+		return;
+	g_atomic_int_set(&janus_ice_mux_stopping, 1);
+	GList *temp = janus_ice_mux_sockets;
+	while(temp) {
+		janus_ice_mux_socket *mux_socket = (janus_ice_mux_socket *)temp->data;
+		g_thread_join(mux_socket->thread);
+		close(mux_socket->fd);
+		temp = temp->next;
+	}
+	g_list_free_full(janus_ice_mux_sockets, (GDestroyNotify)g_free);
+	janus_ice_mux_sockets = NULL;
+	g_slist_free_full(janus_ice_mux_candidates, (GDestroyNotify)nice_candidate_free);
+	janus_ice_mux_candidates = NULL;
+	janus_mutex_lock(&janus_ice_mux_mutex);
+	g_hash_table_destroy(janus_ice_mux_ufrags);
+	janus_ice_mux_ufrags = NULL;
+	janus_mutex_unlock(&janus_ice_mux_mutex);
+	janus_ice_mux_port = 0;
+}
+
+/* Helper to get the local candidates of a PeerConnection: in single-port mode, they're the same for everybody */
+static GSList *janus_ice_get_local_candidates(janus_ice_handle *handle, janus_ice_peerconnection *pc) {
+	if(pc->mux == NULL)
+		return nice_agent_get_local_candidates(handle->agent, pc->stream_id, pc->component_id);
+	GSList *candidates = NULL, *temp = janus_ice_mux_candidates;
+	while(temp) {
+		candidates = g_slist_append(candidates, nice_candidate_copy((NiceCandidate *)temp->data));
+		temp = temp->next;
+	}
+	return candidates;
+}
+
 void janus_ice_init(gboolean ice_lite, gboolean ice_tcp, gboolean full_trickle, gboolean ignore_mdns,
 		gboolean ipv6, gboolean ipv6_linklocal, uint16_t rtp_min_port, uint16_t rtp_max_port) {
 	janus_ice_lite_enabled = ice_lite;
@@ -1064,6 +2014,7 @@ void janus_ice_init(gboolean ice_lite, gboolean ice_tcp, gboolean full_trickle,
 }
 
 void janus_ice_deinit(void) {
+	janus_ice_mux_deinit();
 #ifdef HAVE_TURNRESTAPI
 	janus_turnrest_deinit();
 #endif
@@ -1314,6 +2265,25 @@ int janus_ice_set_turn_rest_api(gchar *api_server, gchar *api_key, gchar *api_me
 #endif
 	return 0;
 }
+int janus_ice_set_turn_rest_api_cache(guint refresh, gchar *username) {
+#ifndef HAVE_TURNRESTAPI
+	JANUS_LOG(LOG_ERR, "Janus has been built with no libcurl support, TURN REST API unavailable\n");
+	return -1;
+#else
+	if(refresh > 100) {
+		JANUS_LOG(LOG_ERR, "Invalid TURN REST API cache refresh percentage: %u\n", refresh);
+		return -1;
+	}
+	janus_turnrest_set_cache(refresh, username);
+	if(refresh > 0) {
+		JANUS_LOG(LOG_INFO, "TURN REST API credentials cached up to %u%% of their TTL\n", refresh);
+	}
+	if(username != NULL) {
+		JANUS_LOG(LOG_INFO, "TURN REST API username: %s\n", username);
+	}
+#endif
+	return 0;
+}
 
 
 /* ICE stuff */
@@ -1445,24 +2415,21 @@ gint janus_ice_handle_attach_plugin(void *core_session, janus_ice_handle *handle
 				automatic_selection = FALSE;
 				handle->mainctx = loop->mainctx;
 				handle->mainloop = loop->mainloop;
+				handle->static_event_loop = loop;
 				loop->handles++;
 				JANUS_LOG(LOG_VERB, "[%"SCNu64"] Manually added handle to loop #%d\n", handle->handle_id, loop->id);
 			}
 		}
 		if(automatic_selection) {
 			/* Pick an available loop automatically (least loaded) */
-			int handles = -1;
+			guint64 load = 0;
 			janus_ice_static_event_loop *loop = NULL;
 			GSList *l = event_loops;
 			while(l) {
 				janus_ice_static_event_loop *el = (janus_ice_static_event_loop *)l->data;
-				if(el->handles == 0) {
-					/* Best option, stop here */
-					loop = el;
-					break;
-				}
-				if(handles == -1 || el->handles < handles) {
-					handles = el->handles;
+				guint64 el_load = janus_ice_static_event_loop_load(el);
+				if(loop == NULL || el_load < load) {
+					load = el_load;
 					loop = el;
 				}
 				l = l->next;
@@ -1579,6 +2546,10 @@ static void janus_ice_handle_free(const janus_refcount *handle_ref) {
 		janus_ice_clear_queued_packets(handle);
 		g_async_queue_unref(handle->queued_packets);
 	}
+	/* Make sure none of our timers is still scheduled on a loop */
+	janus_timer_wheel_remove(&handle->rtcp_timer);
+	janus_timer_wheel_remove(&handle->twcc_timer);
+	janus_timer_wheel_remove(&handle->stats_timer);
 	if(static_event_loops == 0 && handle->mainloop != NULL) {
 		g_main_loop_unref(handle->mainloop);
 		handle->mainloop = NULL;
@@ -1735,15 +2706,67 @@ static void janus_ice_webrtc_free(janus_ice_handle *handle) {
 	JANUS_LOG(LOG_INFO, "[%"SCNu64"] WebRTC resources freed; %p %p\n", handle->handle_id, handle, handle->session);
 }
 
+void janus_ice_peerconnection_update_extmap(janus_ice_peerconnection *pc) {
+	if(pc == NULL)
+		return;
+	janus_rtp_extension_map *map = &pc->extmap;
+	janus_rtp_extension_map_reset(map);
+	/* Outgoing extension templates will need to be compiled again */
+	pc->extmap_generation++;
+	janus_rtp_extension_map_set(map, pc->mid_ext_id, JANUS_RTP_EXTENSION_MID);
+	janus_rtp_extension_map_set(map, pc->rid_ext_id, JANUS_RTP_EXTENSION_RID);
+	janus_rtp_extension_map_set(map, pc->ridrtx_ext_id, JANUS_RTP_EXTENSION_REPAIRED_RID);
+	janus_rtp_extension_map_set(map, pc->audiolevel_ext_id, JANUS_RTP_EXTENSION_AUDIO_LEVEL);
+	janus_rtp_extension_map_set(map, pc->videoorientation_ext_id, JANUS_RTP_EXTENSION_VIDEO_ORIENTATION);
+	janus_rtp_extension_map_set(map, pc->playoutdelay_ext_id, JANUS_RTP_EXTENSION_PLAYOUT_DELAY);
+	janus_rtp_extension_map_set(map, pc->dependencydesc_ext_id, JANUS_RTP_EXTENSION_DEPENDENCY_DESC);
+	janus_rtp_extension_map_set(map, pc->abs_send_time_ext_id, JANUS_RTP_EXTENSION_ABS_SEND_TIME);
+	janus_rtp_extension_map_set(map, pc->abs_capture_time_ext_id, JANUS_RTP_EXTENSION_ABS_CAPTURE_TIME);
+	janus_rtp_extension_map_set(map, pc->videolayers_ext_id, JANUS_RTP_EXTENSION_VIDEO_LAYERS);
+	if(pc->do_transport_wide_cc)
+		janus_rtp_extension_map_set(map, pc->transport_wide_cc_ext_id, JANUS_RTP_EXTENSION_TRANSPORT_WIDE_CC);
+}
+
+/* Helper to publish a snapshot of the estimator and pacer state: only invoked by the
+ * loop of the handle, which is the only thread touching them, once per second */
+static void janus_ice_peerconnection_update_bwe_snapshot(janus_ice_peerconnection *pc) {
+	janus_ice_peerconnection_bwe_snapshot snapshot = { 0 };
+	if(pc->bwe != NULL) {
+		snapshot.bwe = TRUE;
+		snapshot.estimate = pc->bwe->estimate;
+		snapshot.acked_bitrate = pc->bwe->acked_bitrate;
+		snapshot.status = pc->bwe->status;
+		snapshot.loss = pc->bwe->loss;
+	}
+	if(pc->pacer != NULL) {
+		snapshot.pacer = TRUE;
+		snapshot.rate = pc->pacer->rate;
+		snapshot.queued_packets = pc->pacer->count;
+		snapshot.queued_bytes = pc->pacer->queued_bytes;
+		/* Sorting the delays is the expensive part, so we do it before locking */
+		snapshot.delay_samples = janus_pacer_delay_percentiles(pc->pacer,
+			&snapshot.delay_p50, &snapshot.delay_p95, &snapshot.delay_p99);
+	}
+	janus_mutex_lock(&pc->mutex);
+	pc->bwe_snapshot = snapshot;
+	janus_mutex_unlock(&pc->mutex);
+}
+
+void janus_ice_peerconnection_get_bwe_snapshot(janus_ice_peerconnection *pc, janus_ice_peerconnection_bwe_snapshot *snapshot) {
+	if(snapshot == NULL)
+		return;
+	memset(snapshot, 0, sizeof(*snapshot));
+	if(pc == NULL)
+		return;
+	janus_mutex_lock(&pc->mutex);
+	*snapshot = pc->bwe_snapshot;
+	janus_mutex_unlock(&pc->mutex);
+}
+
 void janus_ice_peerconnection_destroy(janus_ice_peerconnection *pc) {
 	if(pc == NULL)
 		return;
-	/* Remove all media instances */
-	g_hash_table_remove_all(pc->media);
-	g_hash_table_remove_all(pc->media_byssrc);
-	g_hash_table_remove_all(pc->media_bymid);
-	g_hash_table_remove_all(pc->media_bytype);
-	/* Get rid of the DTLS stack */
+	/* Get rid of the DTLS stack first, as DTLS workers may still be using the PeerConnection */
 	if(pc->dtlsrt_source != NULL) {
 		g_source_destroy(pc->dtlsrt_source);
 		g_source_unref(pc->dtlsrt_source);
@@ -1754,6 +2777,13 @@ void janus_ice_peerconnection_destroy(janus_ice_peerconnection *pc) {
 		janus_refcount_decrease(&pc->dtls->ref);
 		pc->dtls = NULL;
 	}
+	/* In single-port mode, stop receiving traffic for this PeerConnection */
+	janus_ice_mux_unregister(pc);
+	/* Remove all media instances */
+	g_hash_table_remove_all(pc->media);
+	g_hash_table_remove_all(pc->media_byssrc);
+	g_hash_table_remove_all(pc->media_bymid);
+	g_hash_table_remove_all(pc->media_bytype);
 	janus_ice_handle *handle = pc->handle;
 	if(handle != NULL) {
 		janus_refcount_decrease(&handle->ref);
@@ -1766,6 +2796,8 @@ static void janus_ice_peerconnection_free(const janus_refcount *pc_ref) {
 	janus_ice_peerconnection *pc = janus_refcount_containerof(pc_ref, janus_ice_peerconnection, ref);
 	/* This PeerConnection can be destroyed, free all the resources */
 	pc->handle = NULL;
+	janus_ice_mux_entry_unref((janus_ice_mux_entry *)pc->mux);
+	pc->mux = NULL;
 	g_hash_table_destroy(pc->media);
 	g_hash_table_destroy(pc->media_byssrc);
 	g_hash_table_destroy(pc->media_bymid);
@@ -1783,8 +2815,12 @@ static void janus_ice_peerconnection_free(const janus_refcount *pc_ref) {
 	pc->ruser = NULL;
 	g_free(pc->rpass);
 	pc->rpass = NULL;
-	g_slist_free_full(pc->transport_wide_received_seq_nums, (GDestroyNotify)g_free);
-	pc->transport_wide_received_seq_nums = NULL;
+	janus_rtcp_transport_wide_cc_history_destroy(pc->transport_wide_cc_history);
+	pc->transport_wide_cc_history = NULL;
+	janus_bwe_context_destroy(pc->bwe);
+	pc->bwe = NULL;
+	janus_pacer_destroy(pc->pacer, (GDestroyNotify)janus_ice_free_queued_packet);
+	pc->pacer = NULL;
 	if(pc->candidates != NULL) {
 		GSList *i = NULL, *candidates = pc->candidates;
 		for(i = candidates; i; i = i->next) {
@@ -1832,8 +2868,6 @@ static void janus_ice_peerconnection_free(const janus_refcount *pc_ref) {
 	if(pc->rtx_payload_types_rev != NULL)
 		g_hash_table_destroy(pc->rtx_payload_types_rev);
 	pc->rtx_payload_types_rev = NULL;
-	if(pc->nacks_queue != NULL)
-		g_queue_free(pc->nacks_queue);
 	janus_mutex_destroy(&pc->mutex);
 	g_free(pc);
 }
@@ -1927,28 +2961,12 @@ static void janus_ice_peerconnection_medium_free(const janus_refcount *medium_re
 	medium->rtcp_ctx[1] = NULL;
 	g_free(medium->rtcp_ctx[2]);
 	medium->rtcp_ctx[2] = NULL;
-	if(medium->rtx_nacked[0])
-		g_hash_table_destroy(medium->rtx_nacked[0]);
+	g_free(medium->rtx_nacked[0]);
 	medium->rtx_nacked[0] = NULL;
-	if(medium->rtx_nacked[1])
-		g_hash_table_destroy(medium->rtx_nacked[1]);
+	g_free(medium->rtx_nacked[1]);
 	medium->rtx_nacked[1] = NULL;
-	if(medium->rtx_nacked[2])
-		g_hash_table_destroy(medium->rtx_nacked[2]);
+	g_free(medium->rtx_nacked[2]);
 	medium->rtx_nacked[2] = NULL;
-	if(medium->pending_nacked_cleanup != NULL) {
-		if(g_hash_table_size(medium->pending_nacked_cleanup) > 0) {
-			GHashTableIter iter;
-			gpointer val;
-			g_hash_table_iter_init(&iter, medium->pending_nacked_cleanup);
-			while(g_hash_table_iter_next(&iter, NULL, &val)) {
-				GSource *source = val;
-				g_source_destroy(source);
-			}
-		}
-		g_hash_table_destroy(medium->pending_nacked_cleanup);
-	}
-	medium->pending_nacked_cleanup = NULL;
 	if(medium->retransmit_buffer != NULL) {
 		janus_rtp_packet *p = NULL;
 		while((p = (janus_rtp_packet *)g_queue_pop_head(medium->retransmit_buffer)) != NULL) {
@@ -1962,12 +2980,12 @@ static void janus_ice_peerconnection_medium_free(const janus_refcount *medium_re
 		g_queue_free(medium->retransmit_buffer);
 		g_hash_table_destroy(medium->retransmit_seqs);
 	}
-	if(medium->last_seqs[0])
-		janus_seq_list_free(&medium->last_seqs[0]);
-	if(medium->last_seqs[1])
-		janus_seq_list_free(&medium->last_seqs[1]);
-	if(medium->last_seqs[2])
-		janus_seq_list_free(&medium->last_seqs[2]);
+	g_free(medium->last_seqs[0]);
+	medium->last_seqs[0] = NULL;
+	g_free(medium->last_seqs[1]);
+	medium->last_seqs[1] = NULL;
+	g_free(medium->last_seqs[2]);
+	medium->last_seqs[2] = NULL;
 	janus_mutex_destroy(&medium->mutex);
 	g_free(medium);
 }
@@ -2079,10 +3097,135 @@ stoptimer:
 }
 
 /* Callbacks */
+/* libnice emits its signals on the context the agent was created with, which
+ * is not migrated when the handle moves to a different static loop: when
+ * that happened, signals are copied and re-queued on the loop the handle is
+ * on now, so that they never run concurrently with its media and timers */
+typedef enum janus_ice_nice_signal {
+	janus_ice_nice_signal_gathering_done = 0,
+	janus_ice_nice_signal_state_changed,
+	janus_ice_nice_signal_selected_pair,
+	janus_ice_nice_signal_local_candidate,
+	janus_ice_nice_signal_remote_candidate
+} janus_ice_nice_signal;
+typedef struct janus_ice_deferred_signal {
+	janus_ice_nice_signal type;
+	janus_ice_handle *handle;
+	NiceAgent *agent;
+	guint stream_id, component_id, state;
+#ifndef HAVE_LIBNICE_TCP
+	/* Selected pair, or foundation of a new candidate in local */
+	gchar *local, *remote;
+#else
+	/* Selected pair, or new candidate in local */
+	NiceCandidate *local, *remote;
+#endif
+} janus_ice_deferred_signal;
+static void janus_ice_deferred_signal_free(gpointer user_data) {
+	janus_ice_deferred_signal *signal = (janus_ice_deferred_signal *)user_data;
+#ifndef HAVE_LIBNICE_TCP
+	g_free(signal->local);
+	g_free(signal->remote);
+#else
+	if(signal->local)
+		nice_candidate_free(signal->local);
+	if(signal->remote)
+		nice_candidate_free(signal->remote);
+#endif
+	g_object_unref(signal->agent);
+	janus_refcount_decrease(&signal->handle->ref);
+	g_free(signal);
+}
+static gboolean janus_ice_nice_signal_is_foreign(janus_ice_handle *handle) {
+	return handle->agent_mainctx != handle->mainctx && !g_main_context_is_owner(handle->mainctx);
+}
+static gboolean janus_ice_deferred_signal_dispatch(gpointer user_data);
+static void janus_ice_deferred_signal_queue(janus_ice_deferred_signal *signal) {
+	GSource *source = g_idle_source_new();
+	g_source_set_priority(source, G_PRIORITY_DEFAULT);
+	g_source_set_callback(source, janus_ice_deferred_signal_dispatch, signal, janus_ice_deferred_signal_free);
+	g_source_attach(source, signal->handle->mainctx);
+	g_source_unref(source);
+}
+static janus_ice_deferred_signal *janus_ice_deferred_signal_create(janus_ice_nice_signal type,
+		janus_ice_handle *handle, NiceAgent *agent, guint stream_id, guint component_id) {
+	janus_ice_deferred_signal *signal = g_malloc0(sizeof(janus_ice_deferred_signal));
+	signal->type = type;
+	janus_refcount_increase(&handle->ref);
+	signal->handle = handle;
+	signal->agent = g_object_ref(agent);
+	signal->stream_id = stream_id;
+	signal->component_id = component_id;
+	return signal;
+}
+static void janus_ice_cb_candidate_gathering_done(NiceAgent *agent, guint stream_id, gpointer user_data);
+static void janus_ice_cb_component_state_changed(NiceAgent *agent, guint stream_id, guint component_id, guint state, gpointer ice);
+#ifndef HAVE_LIBNICE_TCP
+static void janus_ice_cb_new_selected_pair (NiceAgent *agent, guint stream_id, guint component_id, gchar *local, gchar *remote, gpointer ice);
+static void janus_ice_cb_new_local_candidate (NiceAgent *agent, guint stream_id, guint component_id, gchar *foundation, gpointer ice);
+static void janus_ice_cb_new_remote_candidate (NiceAgent *agent, guint stream_id, guint component_id, gchar *foundation, gpointer ice);
+#else
+static void janus_ice_cb_new_selected_pair (NiceAgent *agent, guint stream_id, guint component_id, NiceCandidate *local, NiceCandidate *remote, gpointer ice);
+static void janus_ice_cb_new_local_candidate (NiceAgent *agent, NiceCandidate *candidate, gpointer ice);
+static void janus_ice_cb_new_remote_candidate (NiceAgent *agent, NiceCandidate *candidate, gpointer ice);
+#endif
+static gboolean janus_ice_deferred_signal_dispatch(gpointer user_data) {
+	janus_ice_deferred_signal *signal = (janus_ice_deferred_signal *)user_data;
+	janus_ice_handle *handle = signal->handle;
+	if(g_atomic_int_get(&handle->destroyed) || handle->agent != signal->agent)
+		return G_SOURCE_REMOVE;
+	if(!g_main_context_is_owner(handle->mainctx)) {
+		/* The handle was migrated again in the meanwhile, follow it */
+		janus_ice_deferred_signal *moved = janus_ice_deferred_signal_create(signal->type,
+			handle, signal->agent, signal->stream_id, signal->component_id);
+		moved->state = signal->state;
+		moved->local = signal->local;
+		moved->remote = signal->remote;
+		signal->local = NULL;
+		signal->remote = NULL;
+		janus_ice_deferred_signal_queue(moved);
+		return G_SOURCE_REMOVE;
+	}
+	switch(signal->type) {
+		case janus_ice_nice_signal_gathering_done:
+			janus_ice_cb_candidate_gathering_done(signal->agent, signal->stream_id, handle);
+			break;
+		case janus_ice_nice_signal_state_changed:
+			janus_ice_cb_component_state_changed(signal->agent, signal->stream_id, signal->component_id, signal->state, handle);
+			break;
+		case janus_ice_nice_signal_selected_pair:
+			janus_ice_cb_new_selected_pair(signal->agent, signal->stream_id, signal->component_id, signal->local, signal->remote, handle);
+			break;
+#ifndef HAVE_LIBNICE_TCP
+		case janus_ice_nice_signal_local_candidate:
+			janus_ice_cb_new_local_candidate(signal->agent, signal->stream_id, signal->component_id, signal->local, handle);
+			break;
+		case janus_ice_nice_signal_remote_candidate:
+			janus_ice_cb_new_remote_candidate(signal->agent, signal->stream_id, signal->component_id, signal->local, handle);
+			break;
+#else
+		case janus_ice_nice_signal_local_candidate:
+			janus_ice_cb_new_local_candidate(signal->agent, signal->local, handle);
+			break;
+		case janus_ice_nice_signal_remote_candidate:
+			janus_ice_cb_new_remote_candidate(signal->agent, signal->local, handle);
+			break;
+#endif
+		default:
+			break;
+	}
+	return G_SOURCE_REMOVE;
+}
+
 static void janus_ice_cb_candidate_gathering_done(NiceAgent *agent, guint stream_id, gpointer user_data) {
 	janus_ice_handle *handle = (janus_ice_handle *)user_data;
 	if(!handle)
 		return;
+	if(janus_ice_nice_signal_is_foreign(handle)) {
+		janus_ice_deferred_signal_queue(janus_ice_deferred_signal_create(janus_ice_nice_signal_gathering_done,
+			handle, agent, stream_id, 0));
+		return;
+	}
 	JANUS_LOG(LOG_VERB, "[%"SCNu64"] Gathering done for stream %d\n", handle->handle_id, stream_id);
 	handle->cdone++;
 	janus_ice_peerconnection *pc = handle->pc;
@@ -2107,6 +3250,13 @@ static void janus_ice_cb_component_state_changed(NiceAgent *agent, guint stream_
 		/* State changed for a component we don't need anymore (rtcp-mux) */
 		return;
 	}
+	if(janus_ice_nice_signal_is_foreign(handle)) {
+		janus_ice_deferred_signal *signal = janus_ice_deferred_signal_create(janus_ice_nice_signal_state_changed,
+			handle, agent, stream_id, component_id);
+		signal->state = state;
+		janus_ice_deferred_signal_queue(signal);
+		return;
+	}
 	JANUS_LOG(LOG_VERB, "[%"SCNu64"] Component state changed for component %d in stream %d: %d (%s)\n",
 		handle->handle_id, component_id, stream_id, state, janus_get_ice_state_name(state));
 	janus_ice_peerconnection *pc = handle->pc;
@@ -2175,6 +3325,19 @@ static void janus_ice_cb_new_selected_pair (NiceAgent *agent, guint stream_id, g
 		/* New selected pair for a component we don't need anymore (rtcp-mux) */
 		return;
 	}
+	if(janus_ice_nice_signal_is_foreign(handle)) {
+		janus_ice_deferred_signal *signal = janus_ice_deferred_signal_create(janus_ice_nice_signal_selected_pair,
+			handle, agent, stream_id, component_id);
+#ifndef HAVE_LIBNICE_TCP
+		signal->local = g_strdup(local);
+		signal->remote = g_strdup(remote);
+#else
+		signal->local = nice_candidate_copy(local);
+		signal->remote = nice_candidate_copy(remote);
+#endif
+		janus_ice_deferred_signal_queue(signal);
+		return;
+	}
 #ifndef HAVE_LIBNICE_TCP
 	JANUS_LOG(LOG_VERB, "[%"SCNu64"] New selected pair for component %d in stream %d: %s <-> %s\n", handle ? handle->handle_id : 0, component_id, stream_id, local, remote);
 #else
@@ -2299,6 +3462,19 @@ static void janus_ice_cb_new_local_candidate (NiceAgent *agent, NiceCandidate *c
 	janus_ice_handle *handle = (janus_ice_handle *)ice;
 	if(!handle)
 		return;
+	if(janus_ice_nice_signal_is_foreign(handle)) {
+#ifndef HAVE_LIBNICE_TCP
+		janus_ice_deferred_signal *signal = janus_ice_deferred_signal_create(janus_ice_nice_signal_local_candidate,
+			handle, agent, stream_id, component_id);
+		signal->local = g_strdup(foundation);
+#else
+		janus_ice_deferred_signal *signal = janus_ice_deferred_signal_create(janus_ice_nice_signal_local_candidate,
+			handle, agent, candidate->stream_id, candidate->component_id);
+		signal->local = nice_candidate_copy(candidate);
+#endif
+		janus_ice_deferred_signal_queue(signal);
+		return;
+	}
 #ifndef HAVE_LIBNICE_TCP
 	JANUS_LOG(LOG_VERB, "[%"SCNu64"] Discovered new local candidate for component %d in stream %d: foundation=%s\n", handle ? handle->handle_id : 0, component_id, stream_id, foundation);
 #else
@@ -2396,6 +3572,19 @@ static void janus_ice_cb_new_remote_candidate (NiceAgent *agent, NiceCandidate *
 	janus_ice_handle *handle = (janus_ice_handle *)ice;
 	if(!handle)
 		return;
+	if(janus_ice_nice_signal_is_foreign(handle)) {
+#ifndef HAVE_LIBNICE_TCP
+		janus_ice_deferred_signal *signal = janus_ice_deferred_signal_create(janus_ice_nice_signal_remote_candidate,
+			handle, agent, stream_id, component_id);
+		signal->local = g_strdup(foundation);
+#else
+		janus_ice_deferred_signal *signal = janus_ice_deferred_signal_create(janus_ice_nice_signal_remote_candidate,
+			handle, agent, candidate->stream_id, candidate->component_id);
+		signal->local = nice_candidate_copy(candidate);
+#endif
+		janus_ice_deferred_signal_queue(signal);
+		return;
+	}
 #ifndef HAVE_LIBNICE_TCP
 	JANUS_LOG(LOG_VERB, "[%"SCNu64"] Discovered new remote candidate for component %d in stream %d: foundation=%s\n", handle ? handle->handle_id : 0, component_id, stream_id, foundation);
 #else
@@ -2538,6 +3727,88 @@ candidatedone:
 	return;
 }
 
+/* Helper to handle a sequence number a peer NACKed: returns TRUE if we scheduled a retransmission */
+static gboolean janus_ice_handle_nacked_packet(janus_ice_handle *handle, janus_ice_peerconnection_medium *medium,
+		guint16 seqnr, gint64 now) {
+	JANUS_LOG(LOG_DBG, "[%"SCNu64"]   >> %u\n", handle->handle_id, seqnr);
+	/* Check if we have the packet */
+	janus_rtp_packet *p = g_hash_table_lookup(medium->retransmit_seqs, GUINT_TO_POINTER(seqnr));
+	if(p == NULL) {
+		JANUS_LOG(LOG_HUGE, "[%"SCNu64"]   >> >> Can't retransmit packet %u, we don't have it...\n", handle->handle_id, seqnr);
+		return FALSE;
+	}
+	/* Should we retransmit this packet? */
+	if((p->last_retransmit > 0) && (now-p->last_retransmit < p->current_backoff)) {
+		JANUS_LOG(LOG_HUGE, "[%"SCNu64"]   >> >> Packet %u was retransmitted just %"SCNi64"us ago, skipping\n", handle->handle_id, seqnr, now-p->last_retransmit);
+		return FALSE;
+	}
+	JANUS_LOG(LOG_HUGE, "[%"SCNu64"]   >> >> Scheduling %u for retransmission due to NACK\n", handle->handle_id, seqnr);
+	p->last_retransmit = now;
+	if(p->current_backoff == 0) {
+		p->current_backoff = MIN_NACK_IGNORE;
+	} else {
+		p->current_backoff *= 2;
+		if(p->current_backoff > MAX_NACK_IGNORE)
+			p->current_backoff = MAX_NACK_IGNORE;
+	}
+	gboolean video = (medium->type == JANUS_MEDIA_VIDEO);
+	if(p->shared != NULL && (!video || !janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_RFC4588_RTX))) {
+		/* We only reference shared payloads for RFC4588 retransmissions */
+		return FALSE;
+	}
+	/* Enqueue it */
+	janus_ice_queued_packet *pkt = g_malloc(sizeof(janus_ice_queued_packet));
+	pkt->mindex = medium->mindex;
+	if(p->shared == NULL) {
+		pkt->data = g_malloc(p->length+SRTP_MAX_TAG_LEN);
+		memcpy(pkt->data, p->data, p->length);
+		pkt->length = p->length;
+	} else {
+		/* Rebuild the packet from the header we sent and the shared payload,
+		 * with the original sequence number in between as RFC4588 wants */
+		janus_rtp_header *header = (janus_rtp_header *)p->data;
+		pkt->data = g_malloc(p->length+2+p->shared->length+SRTP_MAX_TAG_LEN);
+		memcpy(pkt->data, p->data, p->length);
+		memcpy(pkt->data+p->length, &header->seq_number, 2);
+		memcpy(pkt->data+p->length+2, p->shared->payload, p->shared->length);
+		pkt->length = p->length+2+p->shared->length;
+	}
+	pkt->type = video ? JANUS_ICE_PACKET_VIDEO : JANUS_ICE_PACKET_AUDIO;
+	pkt->extensions = p->extensions;
+	pkt->control = FALSE;
+	pkt->control_ext = FALSE;
+	pkt->retransmission = TRUE;
+	pkt->label = NULL;
+	pkt->protocol = NULL;
+	pkt->shared = NULL;
+	pkt->shared_data = NULL;
+	pkt->added = janus_get_monotonic_time();
+	/* What to send and how depends on whether we're doing RFC4588 or not */
+	if(!video || !janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_RFC4588_RTX)) {
+		/* We're not: just clarify the packet was already encrypted before */
+		pkt->encrypted = TRUE;
+	} else {
+		/* We are: overwrite the RTP header (which means we'll need a new SRTP encrypt) */
+		pkt->encrypted = FALSE;
+		janus_rtp_header *header = (janus_rtp_header *)pkt->data;
+		header->type = medium->rtx_payload_type;
+		header->ssrc = htonl(medium->ssrc_rtx);
+		medium->rtx_seq_number++;
+		header->seq_number = htons(medium->rtx_seq_number);
+	}
+	if(handle->queued_packets != NULL) {
+#if GLIB_CHECK_VERSION(2, 46, 0)
+		g_async_queue_push_front(handle->queued_packets, pkt);
+#else
+		g_async_queue_push(handle->queued_packets, pkt);
+#endif
+		g_main_context_wakeup(handle->mainctx);
+	} else {
+		janus_ice_free_queued_packet(pkt);
+	}
+	return TRUE;
+}
+
 static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint component_id, guint len, gchar *buf, gpointer ice) {
 	janus_ice_peerconnection *pc = (janus_ice_peerconnection *)ice;
 	if(!pc) {
@@ -2558,6 +3829,7 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 		JANUS_LOG(LOG_VERB, "[%"SCNu64"] Forced to stop it here...\n", handle->handle_id);
 		return;
 	}
+	janus_ice_static_event_loop_account(handle, len);
 	/* What is this? */
 	if(janus_is_dtls(buf) || (!janus_is_rtp(buf, len) && !janus_is_rtcp(buf, len))) {
 		/* This is DTLS: either handshake stuff, or data coming from SCTP DataChannels */
@@ -2587,9 +3859,11 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 			janus_ice_peerconnection_medium *medium = g_hash_table_lookup(pc->media_byssrc, GINT_TO_POINTER(packet_ssrc));
 			if(medium == NULL) {
 				/* SSRC not found, try the mid/rid RTP extensions if in use */
-				if(pc->mid_ext_id > 0) {
+				janus_rtp_header_extensions_info sdes;
+				if(pc->mid_ext_id > 0 && janus_rtp_header_extensions_parse(buf, len, &pc->extmap, NULL, &sdes) > 0 &&
+						sdes.mid != NULL) {
 					char sdes_item[16];
-					if(janus_rtp_header_extension_parse_mid(buf, len, pc->mid_ext_id, sdes_item, sizeof(sdes_item)) == 0) {
+					if(janus_ice_copy_sdes_item(sdes.mid, sdes.mid_len, sdes_item, sizeof(sdes_item)) == 0) {
 						medium = g_hash_table_lookup(pc->media_bymid, sdes_item);
 						if(medium != NULL) {
 							/* Found! Associate this SSRC to this stream */
@@ -2602,7 +3876,7 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 								medium->ssrc_peer[0] = packet_ssrc;
 								found = TRUE;
 							} else {
-								if(janus_rtp_header_extension_parse_rid(buf, len, pc->rid_ext_id, sdes_item, sizeof(sdes_item)) == 0) {
+								if(janus_ice_copy_sdes_item(sdes.rid, sdes.rid_len, sdes_item, sizeof(sdes_item)) == 0) {
 									/* Try the RTP stream ID */
 									if(medium->rid[0] != NULL && !strcmp(medium->rid[0], sdes_item)) {
 										JANUS_LOG(LOG_VERB, "[%"SCNu64"]  -- Simulcasting: rid=%s\n", handle->handle_id, sdes_item);
@@ -2620,7 +3894,7 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 										JANUS_LOG(LOG_WARN, "[%"SCNu64"]  -- Simulcasting: unknown rid %s..?\n", handle->handle_id, sdes_item);
 									}
 								} else if(pc->ridrtx_ext_id > 0 &&
-										janus_rtp_header_extension_parse_rid(buf, len, pc->ridrtx_ext_id, sdes_item, sizeof(sdes_item)) == 0) {
+										janus_ice_copy_sdes_item(sdes.repaired_rid, sdes.repaired_rid_len, sdes_item, sizeof(sdes_item)) == 0) {
 									/* Try the repaired RTP stream ID */
 									if(medium->rid[0] != NULL && !strcmp(medium->rid[0], sdes_item)) {
 										JANUS_LOG(LOG_VERB, "[%"SCNu64"]  -- Simulcasting: rid=%s (rtx)\n", handle->handle_id, sdes_item);
@@ -2740,16 +4014,19 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 						}
 					}
 				}
+				/* Parse all the negotiated RTP extensions in one go */
+				janus_plugin_rtp_extensions extensions;
+				janus_plugin_rtp_extensions_reset(&extensions);
+				janus_rtp_header_extensions_info extinfo;
+				janus_rtp_header_extensions_parse(buf, buflen, &pc->extmap, &extensions, &extinfo);
 				/* Check if we need to handle transport wide cc */
 				if(pc->do_transport_wide_cc) {
-					guint16 transport_seq_num;
 					/* Get transport wide seq num */
-					if(janus_rtp_header_extension_parse_transport_wide_cc(buf, buflen, pc->transport_wide_cc_ext_id, &transport_seq_num) == 0) {
+					if(extinfo.transport_seq_num > -1) {
+						guint16 transport_seq_num = extinfo.transport_seq_num;
 						/* Get current timestamp */
 						struct timeval now;
 						gettimeofday(&now,0);
-						/* Create <seq num, time> pair */
-						janus_rtcp_transport_wide_cc_stats *stats = g_malloc0(sizeof(janus_rtcp_transport_wide_cc_stats));
 						/* Check if we have a sequence wrap */
 						if(transport_seq_num<0x0FFF && (pc->transport_wide_cc_last_seq_num&0xFFFF)>0xF000) {
 							/* Increase cycles */
@@ -2759,25 +4036,27 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 						guint32 transport_ext_seq_num = pc->transport_wide_cc_cycles<<16 | transport_seq_num;
 						/* Store last received transport seq num */
 						pc->transport_wide_cc_last_seq_num = transport_seq_num;
-						/* Set stats values */
-						stats->transport_seq_num = transport_ext_seq_num;
-						stats->timestamp = (((guint64)now.tv_sec)*1E6+now.tv_usec);
-						/* Lock and append to received list */
+						/* Lock and store the <seq num, time> pair in the history */
 						janus_mutex_lock(&pc->mutex);
-						pc->transport_wide_received_seq_nums = g_slist_prepend(pc->transport_wide_received_seq_nums, stats);
+						if(pc->transport_wide_cc_history == NULL) {
+							/* Make room for a few feedback periods worth of packets */
+							pc->transport_wide_cc_history = janus_rtcp_transport_wide_cc_history_create(
+								twcc_period*8 > JANUS_ICE_TWCC_HISTORY_MIN ? twcc_period*8 : JANUS_ICE_TWCC_HISTORY_MIN);
+						}
+						janus_rtcp_transport_wide_cc_history_add(pc->transport_wide_cc_history,
+							transport_ext_seq_num, (((guint64)now.tv_sec)*1E6+now.tv_usec));
 						janus_mutex_unlock(&pc->mutex);
 					}
 				}
 				if(medium->do_nacks) {
 					/* Check if this packet is a duplicate: can happen with RFC4588 */
 					guint16 seqno = ntohs(header->seq_number);
-					int nstate = medium->rtx_nacked[vindex] ?
-						GPOINTER_TO_INT(g_hash_table_lookup(medium->rtx_nacked[vindex], GUINT_TO_POINTER(seqno))) : 0;
+					int nstate = janus_seq_nacked_get(medium->rtx_nacked[vindex], seqno);
 					if(nstate == 1) {
 						/* Packet was NACKed and this is the first time we receive it: change state to received */
 						JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Received NACKed packet %"SCNu16" (SSRC %"SCNu32", vindex %d)...\n",
 							handle->handle_id, seqno, packet_ssrc, vindex);
-						g_hash_table_insert(medium->rtx_nacked[vindex], GUINT_TO_POINTER(seqno), GUINT_TO_POINTER(2));
+						janus_seq_nacked_set(medium->rtx_nacked[vindex], seqno, 2, 0);
 					} else if(nstate == 2) {
 						/* We already received this packet: drop it */
 						JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Detected duplicate packet %"SCNu16" (SSRC %"SCNu32", vindex %d)...\n",
@@ -2832,65 +4111,18 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 				}
 				/* Prepare the data to pass to the responsible plugin */
 				janus_plugin_rtp rtp = { .mindex = medium->mindex, .video = video, .buffer = buf, .length = buflen };
-				janus_plugin_rtp_extensions_reset(&rtp.extensions);
-				/* Parse RTP extensions before involving the plugin */
-				if(!video && pc->audiolevel_ext_id != -1) {
-					gboolean vad = FALSE;
-					int level = -1;
-					if(janus_rtp_header_extension_parse_audio_level(buf, buflen,
-							pc->audiolevel_ext_id, &vad, &level) == 0) {
-						rtp.extensions.audio_level = level;
-						rtp.extensions.audio_level_vad = vad;
-					}
-				}
-				if(video && pc->videoorientation_ext_id != -1) {
-					gboolean c = FALSE, f = FALSE, r1 = FALSE, r0 = FALSE;
-					if(janus_rtp_header_extension_parse_video_orientation(buf, buflen,
-							pc->videoorientation_ext_id, &c, &f, &r1, &r0) == 0) {
-						rtp.extensions.video_rotation = 0;
-						if(r1 && r0)
-							rtp.extensions.video_rotation = 270;
-						else if(r1)
-							rtp.extensions.video_rotation = 180;
-						else if(r0)
-							rtp.extensions.video_rotation = 90;
-						rtp.extensions.video_back_camera = c;
-						rtp.extensions.video_flipped = f;
-					}
-				}
-				if(video && pc->playoutdelay_ext_id != -1) {
-					uint16_t min = 0, max = 0;
-					if(janus_rtp_header_extension_parse_playout_delay(buf, buflen,
-							pc->playoutdelay_ext_id, &min, &max) == 0) {
-						rtp.extensions.min_delay = min;
-						rtp.extensions.max_delay = max;
-					}
-				}
-				if(video && pc->dependencydesc_ext_id != -1) {
-					uint8_t dd[256];
-					int len = sizeof(dd);
-					if(janus_rtp_header_extension_parse_dependency_desc(buf, buflen,
-							pc->dependencydesc_ext_id, dd, &len) == 0 && len > 0) {
-						/* We copy the DD bytes as they are: it's up to plugins to parse it, if needed */
-						rtp.extensions.dd_len = len;
-						memcpy(rtp.extensions.dd_content, dd, len);
-					}
-				}
-				if(pc->abs_capture_time_ext_id != -1) {
-					uint64_t abs_ts = 0;
-					if(janus_rtp_header_extension_parse_abs_capture_time(buf, buflen,
-							pc->abs_capture_time_ext_id, &abs_ts) == 0) {
-						rtp.extensions.abs_capture_ts = abs_ts;
-					}
-				}
-				if(pc->videolayers_ext_id != -1) {
-					int8_t spatial_layers = -1, temporal_layers = -1;
-					if(janus_rtp_header_extension_parse_video_layers_allocation(buf, buflen,
-							pc->videolayers_ext_id, &spatial_layers, &temporal_layers) == 0) {
-						/* We copy the VLA bytes as they are: it's up to plugins to parse it, if needed */
-						rtp.extensions.spatial_layers = spatial_layers;
-						rtp.extensions.temporal_layers = temporal_layers;
-					}
+				/* Only pass the RTP extensions that make sense for this kind of media to the plugin */
+				rtp.extensions = extensions;
+				if(video) {
+					rtp.extensions.audio_level = -1;
+					rtp.extensions.audio_level_vad = FALSE;
+				} else {
+					rtp.extensions.video_rotation = -1;
+					rtp.extensions.video_back_camera = FALSE;
+					rtp.extensions.video_flipped = FALSE;
+					rtp.extensions.min_delay = -1;
+					rtp.extensions.max_delay = -1;
+					rtp.extensions.dd_len = 0;
 				}
 				/* Pass the packet to the plugin */
 				janus_plugin *plugin = (janus_plugin *)handle->app;
@@ -2944,18 +4176,17 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 					if(medium->video_is_keyframe(payload, plen)) {
 						if(rtcp_ctx && (int16_t)(new_seqn - rtcp_ctx->max_seq_nr) > 0) {
 							JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Keyframe received with a highest sequence number, resetting NACK queue\n", handle->handle_id);
-							janus_seq_list_free(&medium->last_seqs[vindex]);
+							janus_seq_window_reset(medium->last_seqs[vindex]);
 						}
 					}
 				}
 				guint16 cur_seqn;
-				int last_seqs_len = 0;
 				janus_mutex_lock(&medium->mutex);
-				janus_seq_info **last_seqs = &medium->last_seqs[vindex];
-				janus_seq_info *cur_seq = *last_seqs;
-				if(cur_seq) {
-					cur_seq = cur_seq->prev;
-					cur_seqn = cur_seq->seq;
+				if(medium->last_seqs[vindex] == NULL)
+					medium->last_seqs[vindex] = g_malloc0(sizeof(janus_seq_window));
+				janus_seq_window *window = medium->last_seqs[vindex];
+				if(window->count > 0) {
+					cur_seqn = window->head + window->count - 1;	/* Can wrap */
 				} else {
 					/* First seq, set up to add one seq */
 					cur_seqn = new_seqn - (guint16)1; /* Can wrap */
@@ -2965,76 +4196,73 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 					/* Jump too big, start fresh */
 					JANUS_LOG(LOG_WARN, "[%"SCNu64"] Big sequence number jump %hu -> %hu (%s stream #%d)\n",
 						handle->handle_id, cur_seqn, new_seqn, video ? "video" : "audio", vindex);
-					janus_seq_list_free(last_seqs);
-					cur_seq = NULL;
+					janus_seq_window_reset(window);
 					cur_seqn = new_seqn - (guint16)1;
 				}
 
 				GSList *nacks = NULL;
 				gint64 now = janus_get_monotonic_time();
 
-				if(janus_seq_in_range(new_seqn, cur_seqn, LAST_SEQS_MAX_LEN)) {
-					/* Add new seq objs forward */
-					while(cur_seqn != new_seqn) {
-						cur_seqn += (guint16)1; /* can wrap */
-						janus_seq_info *seq_obj = g_malloc0(sizeof(janus_seq_info));
-						seq_obj->seq = cur_seqn;
-						seq_obj->ts = now;
-						seq_obj->state = (cur_seqn == new_seqn) ? SEQ_RECVED : SEQ_MISSING;
-						janus_seq_append(last_seqs, seq_obj);
-						last_seqs_len++;
-					}
-				}
-				if(cur_seq) {
-					/* Scan old seq objs backwards */
-					while(cur_seq != NULL) {
-						last_seqs_len++;
-						if(cur_seq->seq == new_seqn) {
-							JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Received missed sequence number %"SCNu16" (%s stream #%d)\n",
-								handle->handle_id, cur_seq->seq, video ? "video" : "audio", vindex);
-							cur_seq->state = SEQ_RECVED;
-						} else if(cur_seq->state == SEQ_MISSING && now - cur_seq->ts > SEQ_MISSING_WAIT) {
+				if(window->missing > 0) {
+					/* Scan the seqs we were tracking backwards: if nothing is missing, there's nothing to do */
+					guint16 i = 0, seq = 0;
+					for(i=0; i<window->count; i++) {
+						seq = cur_seqn - i;	/* Can wrap */
+						guint8 *state = &window->state[seq & (JANUS_SEQ_WINDOW_SIZE-1)];
+						gint64 ts = window->ts[seq & (JANUS_SEQ_WINDOW_SIZE-1)];
+						if(seq == new_seqn) {
+							if(*state == SEQ_MISSING || *state == SEQ_NACKED) {
+								JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Received missed sequence number %"SCNu16" (%s stream #%d)\n",
+									handle->handle_id, seq, video ? "video" : "audio", vindex);
+								window->missing--;
+							}
+							*state = SEQ_RECVED;
+						} else if(*state == SEQ_MISSING && now - ts > SEQ_MISSING_WAIT) {
 							JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Missed sequence number %"SCNu16" (%s stream #%d), sending 1st NACK\n",
-								handle->handle_id, cur_seq->seq, video ? "video" : "audio", vindex);
-							nacks = g_slist_prepend(nacks, GUINT_TO_POINTER(cur_seq->seq));
-							cur_seq->state = SEQ_NACKED;
+								handle->handle_id, seq, video ? "video" : "audio", vindex);
+							nacks = g_slist_prepend(nacks, GUINT_TO_POINTER(seq));
+							*state = SEQ_NACKED;
 							if(video && janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_RFC4588_RTX)) {
 								/* Keep track of this sequence number, we need to avoid duplicates */
 								JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Tracking NACKed packet %"SCNu16" (SSRC %"SCNu32", vindex %d)...\n",
-									handle->handle_id, cur_seq->seq, packet_ssrc, vindex);
+									handle->handle_id, seq, packet_ssrc, vindex);
 								if(medium->rtx_nacked[vindex] == NULL)
-									medium->rtx_nacked[vindex] = g_hash_table_new(NULL, NULL);
-								g_hash_table_insert(medium->rtx_nacked[vindex], GUINT_TO_POINTER(cur_seq->seq), GINT_TO_POINTER(1));
-								/* We don't track it forever, though: add a timed source to remove it in a few seconds */
-								janus_ice_nacked_packet *np = g_malloc(sizeof(janus_ice_nacked_packet));
-								np->medium = medium;
-								np->seq_number = cur_seq->seq;
-								np->vindex = vindex;
-								if(medium->pending_nacked_cleanup == NULL)
-									medium->pending_nacked_cleanup = g_hash_table_new(NULL, NULL);
-								GSource *timeout_source = g_timeout_source_new_seconds(5);
-								g_source_set_callback(timeout_source, janus_ice_nacked_packet_cleanup, np, (GDestroyNotify)g_free);
-								np->source_id = g_source_attach(timeout_source, handle->mainctx);
-								g_source_unref(timeout_source);
-								g_hash_table_insert(medium->pending_nacked_cleanup, GUINT_TO_POINTER(np->source_id), timeout_source);
+									medium->rtx_nacked[vindex] = g_malloc0(sizeof(janus_seq_nacked));
+								/* We don't track it forever, though: the entry expires on its own in a few seconds */
+								janus_seq_nacked_set(medium->rtx_nacked[vindex], seq, 1, now);
 							}
-						} else if(cur_seq->state == SEQ_NACKED  && now - cur_seq->ts > SEQ_NACKED_WAIT) {
+						} else if(*state == SEQ_NACKED && now - ts > SEQ_NACKED_WAIT) {
 							JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Missed sequence number %"SCNu16" (%s stream #%d), sending 2nd NACK\n",
-								handle->handle_id, cur_seq->seq, video ? "video" : "audio", vindex);
-							nacks = g_slist_prepend(nacks, GUINT_TO_POINTER(cur_seq->seq));
-							cur_seq->state = SEQ_GIVEUP;
-						}
-						if(cur_seq == *last_seqs) {
-							/* Just processed head */
-							break;
+								handle->handle_id, seq, video ? "video" : "audio", vindex);
+							nacks = g_slist_prepend(nacks, GUINT_TO_POINTER(seq));
+							*state = SEQ_GIVEUP;
+							window->missing--;
 						}
-						cur_seq = cur_seq->prev;
 					}
 				}
-				while(last_seqs_len > LAST_SEQS_MAX_LEN) {
-					janus_seq_info *node = janus_seq_pop_head(last_seqs);
-					g_free(node);
-					last_seqs_len--;
+				if(janus_seq_in_range(new_seqn, cur_seqn, LAST_SEQS_MAX_LEN)) {
+					/* Add new seqs forward */
+					while(cur_seqn != new_seqn) {
+						cur_seqn += (guint16)1; /* can wrap */
+						if(window->count == 0)
+							window->head = cur_seqn;
+						window->count++;
+						window->ts[cur_seqn & (JANUS_SEQ_WINDOW_SIZE-1)] = now;
+						if(cur_seqn == new_seqn) {
+							window->state[cur_seqn & (JANUS_SEQ_WINDOW_SIZE-1)] = SEQ_RECVED;
+						} else {
+							window->state[cur_seqn & (JANUS_SEQ_WINDOW_SIZE-1)] = SEQ_MISSING;
+							window->missing++;
+						}
+						/* Forget the oldest seq, if we're tracking too many */
+						if(window->count > LAST_SEQS_MAX_LEN) {
+							guint8 state = window->state[window->head & (JANUS_SEQ_WINDOW_SIZE-1)];
+							if(state == SEQ_MISSING || state == SEQ_NACKED)
+								window->missing--;
+							window->head++;	/* Can wrap */
+							window->count--;
+						}
+					}
 				}
 
 				guint nacks_count = g_slist_length(nacks);
@@ -3084,22 +4312,47 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 				if(g_atomic_int_get(&handle->dump_packets))
 					janus_text2pcap_dump(handle->text2pcap, JANUS_TEXT2PCAP_RTCP, TRUE, buf, buflen,
 						"[session=%"SCNu64"][handle=%"SCNu64"]", session->session_id, handle->handle_id);
+				/* Validate the compound packet and split it in its messages once: everything
+				 * below (and the plugin) will use the result, rather than scanning it again */
+				janus_rtcp_compound compound;
+				if(janus_rtcp_parse_compound(buf, buflen, &compound) < 0) {
+					/* Drop the packet if the parsing function returns with an error */
+					return;
+				}
 				/* Check if there's an RTCP BYE: in case, let's log it */
-				if(janus_rtcp_has_bye(buf, buflen)) {
+				if(compound.has_bye) {
 					/* Note: we used to use this as a trigger to close the PeerConnection, but not anymore
 					 * Discussion here, https://groups.google.com/forum/#!topic/meetecho-janus/4XtfbYB7Jvc */
 					JANUS_LOG(LOG_VERB, "[%"SCNu64"] Got RTCP BYE on stream %u (component %u)\n", handle->handle_id, stream_id, component_id);
 				}
+				/* Transport-wide CC feedback is about the whole PeerConnection: if we're
+				 * estimating the bandwidth, feed it to the estimator before anything else */
+				if(pc->bwe != NULL) {
+					gboolean twcc = FALSE;
+					janus_rtcp_compound_iter iter = { 0 };
+					const janus_rtcp_block *block = NULL;
+					while((block = janus_rtcp_compound_next(buf, &compound, &iter)) != NULL) {
+						if(block->type == JANUS_RTCP_BLOCK_TWCC &&
+								janus_bwe_context_handle_feedback(pc->bwe, buf + block->offset, block->length) > 0)
+							twcc = TRUE;
+					}
+					if(twcc && janus_bwe_context_update(pc->bwe, janus_get_monotonic_time())) {
+						janus_plugin *plugin = (janus_plugin *)handle->app;
+						if(plugin && plugin->estimated_bandwidth && janus_plugin_session_is_alive(handle->app_handle) &&
+								!g_atomic_int_get(&handle->destroyed))
+							plugin->estimated_bandwidth(handle->app_handle, pc->bwe->estimate);
+					}
+				}
 				/* Is this audio or video? */
 				int video = 0, vindex = 0;
 				/* Bundled streams, should we check the SSRCs? */
-				guint32 rtcp_ssrc = janus_rtcp_get_sender_ssrc(buf, buflen);
+				guint32 rtcp_ssrc = compound.sender_ssrc;
 				janus_ice_peerconnection_medium *medium = g_hash_table_lookup(pc->media_byssrc, GINT_TO_POINTER(rtcp_ssrc));
 				if(medium == NULL) {
 					/* We don't know the remote SSRC: this can happen for recvonly clients
 					 * (see https://groups.google.com/forum/#!topic/discuss-webrtc/5yuZjV7lkNc)
 					 * Check the local SSRC, compare it to what we have */
-					rtcp_ssrc = janus_rtcp_get_receiver_ssrc(buf, buflen);
+					rtcp_ssrc = compound.receiver_ssrc;
 					medium = g_hash_table_lookup(pc->media_byssrc, GINT_TO_POINTER(rtcp_ssrc));
 					if(medium == NULL) {
 						if(rtcp_ssrc > 0) {
@@ -3125,10 +4378,7 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 				/* Let's process this RTCP (compound?) packet, and update the RTCP context for this stream in case */
 				rtcp_context *rtcp_ctx = medium->rtcp_ctx[vindex];
 				uint32_t rtt = rtcp_ctx ? rtcp_ctx->rtt : 0;
-				if(janus_rtcp_parse(rtcp_ctx, buf, buflen) < 0) {
-					/* Drop the packet if the parsing function returns with an error */
-					return;
-				}
+				janus_rtcp_compound_update_context(rtcp_ctx, buf, &compound);
 				if(rtcp_ctx && rtcp_ctx->rtt != rtt) {
 					/* Check the current RTT, to see if we need to update the size of the queue: we take
 					 * the RTT (should we include all media?) and add 100ms just to be conservative */
@@ -3147,96 +4397,43 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 				}
 				JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Got %s RTCP (%d bytes)\n", handle->handle_id, video ? "video" : "audio", buflen);
 				/* See if there's any REMB bitrate to track */
-				uint32_t bitrate = janus_rtcp_get_remb(buf, buflen);
-				if(bitrate > 0)
-					pc->remb_bitrate = bitrate;
+				if(compound.remb_bitrate > 0)
+					pc->remb_bitrate = compound.remb_bitrate;
 
 				/* Now let's see if there are any NACKs to handle */
 				gint64 now = janus_get_monotonic_time();
-				if(pc->nacks_queue == NULL)
-					pc->nacks_queue = g_queue_new();
-				GQueue *nacks = pc->nacks_queue;
-				janus_rtcp_get_nacks(buf, buflen, nacks);
-				guint nacks_count = g_queue_get_length(nacks);
+				guint nacks_count = compound.nacks;
 				if(nacks_count && medium->do_nacks) {
 					/* Handle NACK */
 					JANUS_LOG(LOG_HUGE, "[%"SCNu64"]     Just got some NACKS (%d) we should handle...\n", handle->handle_id, nacks_count);
-					GHashTable *retransmit_seqs = medium->retransmit_seqs;
-					GQueue *queue = (retransmit_seqs != NULL ? nacks : NULL);
 					int retransmits_cnt = 0;
 					janus_mutex_lock(&medium->mutex);
-					while(queue != NULL && g_queue_get_length(queue) > 0) {
-						unsigned int seqnr = GPOINTER_TO_UINT(g_queue_pop_tail(queue));
-						JANUS_LOG(LOG_DBG, "[%"SCNu64"]   >> %u\n", handle->handle_id, seqnr);
-						int in_rb = 0;
-						/* Check if we have the packet */
-						janus_rtp_packet *p = g_hash_table_lookup(retransmit_seqs, GUINT_TO_POINTER(seqnr));
-						if(p == NULL) {
-							JANUS_LOG(LOG_HUGE, "[%"SCNu64"]   >> >> Can't retransmit packet %u, we don't have it...\n", handle->handle_id, seqnr);
-						} else {
-							/* Should we retransmit this packet? */
-							if((p->last_retransmit > 0) && (now-p->last_retransmit < p->current_backoff)) {
-								JANUS_LOG(LOG_HUGE, "[%"SCNu64"]   >> >> Packet %u was retransmitted just %"SCNi64"us ago, skipping\n", handle->handle_id, seqnr, now-p->last_retransmit);
-								g_queue_pop_tail(queue);
-								continue;
-							}
-							in_rb = 1;
-							JANUS_LOG(LOG_HUGE, "[%"SCNu64"]   >> >> Scheduling %u for retransmission due to NACK\n", handle->handle_id, seqnr);
-							p->last_retransmit = now;
-							if(p->current_backoff == 0) {
-								p->current_backoff = MIN_NACK_IGNORE;
-							} else {
-								p->current_backoff *= 2;
-								if(p->current_backoff > MAX_NACK_IGNORE)
-									p->current_backoff = MAX_NACK_IGNORE;
-							}
-							retransmits_cnt++;
-							/* Enqueue it */
-							janus_ice_queued_packet *pkt = g_malloc(sizeof(janus_ice_queued_packet));
-							pkt->mindex = medium->mindex;
-							pkt->data = g_malloc(p->length+SRTP_MAX_TAG_LEN);
-							memcpy(pkt->data, p->data, p->length);
-							pkt->length = p->length;
-							pkt->type = video ? JANUS_ICE_PACKET_VIDEO : JANUS_ICE_PACKET_AUDIO;
-							pkt->extensions = p->extensions;
-							pkt->control = FALSE;
-							pkt->control_ext = FALSE;
-							pkt->retransmission = TRUE;
-							pkt->label = NULL;
-							pkt->protocol = NULL;
-							pkt->added = janus_get_monotonic_time();
-							/* What to send and how depends on whether we're doing RFC4588 or not */
-							if(!video || !janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_RFC4588_RTX)) {
-								/* We're not: just clarify the packet was already encrypted before */
-								pkt->encrypted = TRUE;
-							} else {
-								/* We are: overwrite the RTP header (which means we'll need a new SRTP encrypt) */
-								pkt->encrypted = FALSE;
-								janus_rtp_header *header = (janus_rtp_header *)pkt->data;
-								header->type = medium->rtx_payload_type;
-								header->ssrc = htonl(medium->ssrc_rtx);
-								medium->rtx_seq_number++;
-								header->seq_number = htons(medium->rtx_seq_number);
-							}
-							if(handle->queued_packets != NULL) {
-#if GLIB_CHECK_VERSION(2, 46, 0)
-								g_async_queue_push_front(handle->queued_packets, pkt);
-#else
-								g_async_queue_push(handle->queued_packets, pkt);
-#endif
-								g_main_context_wakeup(handle->mainctx);
-							} else {
-								janus_ice_free_queued_packet(pkt);
+					janus_rtcp_compound_iter iter = { 0 };
+					const janus_rtcp_block *block = NULL;
+					while(medium->retransmit_seqs != NULL && (block = janus_rtcp_compound_next(buf, &compound, &iter)) != NULL) {
+						if(block->type != JANUS_RTCP_BLOCK_NACK)
+							continue;
+						janus_rtcp_nack *nack = (janus_rtcp_nack *)((janus_rtcp_fb *)(buf + block->offset))->fci;
+						uint16_t fi = 0;
+						for(fi=0; fi<block->count; fi++) {
+							uint16_t pid = ntohs(nack[fi].pid);
+							uint16_t blp = ntohs(nack[fi].blp);
+							int j = 0;
+							/* The first sequence number is the PID, the bitmask covers the 16 that follow */
+							for(j=-1; j<16; j++) {
+								if(j >= 0 && !(blp & (1 << j)))
+									continue;
+								if(janus_ice_handle_nacked_packet(handle, medium, (guint16)(pid+j+1), now)) {
+									retransmits_cnt++;
+									if(rtcp_ctx != NULL)
+										g_atomic_int_inc(&rtcp_ctx->nack_count);
+								}
 							}
 						}
-						if(rtcp_ctx != NULL && in_rb) {
-							g_atomic_int_inc(&rtcp_ctx->nack_count);
-						}
-						g_queue_pop_tail(queue);
 					}
 					medium->retransmit_recent_cnt += retransmits_cnt;
-					/* FIXME Remove the NACK compound packet, we've handled it */
-					buflen = janus_rtcp_remove_nacks(buf, buflen);
+					/* Remove the NACKs from the compound packet, we've handled them */
+					buflen = janus_rtcp_compound_remove(buf, buflen, &compound, JANUS_RTCP_BLOCK_NACK);
 					/* Update stats */
 					medium->in_stats.info[vindex].nacks += nacks_count;
 					janus_mutex_unlock(&medium->mutex);
@@ -3263,7 +4460,7 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 					return;
 				}
 
-				janus_plugin_rtcp rtcp = { .mindex = medium->mindex, .video = video, .buffer = buf, .length = buflen };
+				janus_plugin_rtcp rtcp = { .mindex = medium->mindex, .video = video, .buffer = buf, .length = buflen, .compound = &compound };
 				janus_plugin *plugin = (janus_plugin *)handle->app;
 				if(plugin && plugin->incoming_rtcp && handle->app_handle &&
 						!g_atomic_int_get(&handle->app_handle->stopped) &&
@@ -3467,11 +4664,10 @@ void janus_ice_candidates_to_sdp(janus_ice_handle *handle, janus_sdp_mline *mlin
 		JANUS_LOG(LOG_ERR, "[%"SCNu64"]     No stream %d??\n", handle->handle_id, stream_id);
 		return;
 	}
-	NiceAgent *agent = handle->agent;
 	/* Iterate on all */
 	gchar buffer[200];
 	GSList *candidates, *i;
-	candidates = nice_agent_get_local_candidates (agent, stream_id, component_id);
+	candidates = janus_ice_get_local_candidates(handle, pc);
 	JANUS_LOG(LOG_VERB, "[%"SCNu64"] We have %d candidates for Stream #%d, Component #%d\n", handle->handle_id, g_slist_length(candidates), stream_id, component_id);
 	gboolean log_candidates = (pc->local_candidates == NULL);
 	for(i = candidates; i; i = i->next) {
@@ -3569,6 +4765,58 @@ void janus_ice_setup_remote_candidates(janus_ice_handle *handle, guint stream_id
 	pc->process_started = TRUE;
 }
 
+/* Helper to get the list of local addresses we can use for candidates, except those in the ignore list */
+static GList *janus_ice_get_local_addresses(guint64 handle_id) {
+	GList *addresses = NULL;
+	struct ifaddrs *ifaddr, *ifa;
+	int family, s, n;
+	char host[NI_MAXHOST];
+	if(getifaddrs(&ifaddr) == -1) {
+		JANUS_LOG(LOG_ERR, "[%"SCNu64"] Error getting list of interfaces... %d (%s)\n",
+			handle_id, errno, g_strerror(errno));
+		return NULL;
+	}
+	for(ifa = ifaddr, n = 0; ifa != NULL; ifa = ifa->ifa_next, n++) {
+		if(ifa->ifa_addr == NULL)
+			continue;
+		/* Skip interfaces which are not up and running */
+		if(!((ifa->ifa_flags & IFF_UP) && (ifa->ifa_flags & IFF_RUNNING)))
+			continue;
+		/* Skip loopback interfaces */
+		if(ifa->ifa_flags & IFF_LOOPBACK)
+			continue;
+		family = ifa->ifa_addr->sa_family;
+		if(family != AF_INET && family != AF_INET6)
+			continue;
+		/* We only add IPv6 addresses if support for them has been explicitly enabled */
+		if(family == AF_INET6 && !janus_ipv6_enabled)
+			continue;
+		/* Check the interface name first, we can ignore that as well: enforce list would be checked later */
+		if(janus_ice_enforce_list == NULL && ifa->ifa_name != NULL && janus_ice_is_ignored(ifa->ifa_name))
+			continue;
+		s = getnameinfo(ifa->ifa_addr,
+				(family == AF_INET) ? sizeof(struct sockaddr_in) : sizeof(struct sockaddr_in6),
+				host, NI_MAXHOST, NULL, 0, NI_NUMERICHOST);
+		if(s != 0) {
+			JANUS_LOG(LOG_ERR, "[%"SCNu64"] getnameinfo() failed: %s\n", handle_id, gai_strerror(s));
+			continue;
+		}
+		/* Skip 0.0.0.0, :: and, unless otherwise configured, local scoped addresses  */
+		if(!strcmp(host, "0.0.0.0") || !strcmp(host, "::") || (!janus_ipv6_linklocal_enabled && !strncmp(host, "fe80:", 5)))
+			continue;
+		/* Check if this IP address is in the ignore/enforce list: the enforce list has the precedence but the ignore list can then discard candidates */
+		if(janus_ice_enforce_list != NULL) {
+			if(ifa->ifa_name != NULL && !janus_ice_is_enforced(ifa->ifa_name) && !janus_ice_is_enforced(host))
+				continue;
+		}
+		if(janus_ice_is_ignored(host))
+			continue;
+		addresses = g_list_append(addresses, g_strdup(host));
+	}
+	freeifaddrs(ifaddr);
+	return addresses;
+}
+
 int janus_ice_setup_local(janus_ice_handle *handle, gboolean offer, gboolean trickle, janus_dtls_role dtls_role) {
 	if(!handle || g_atomic_int_get(&handle->destroyed))
 		return -1;
@@ -3620,6 +4868,7 @@ int janus_ice_setup_local(janus_ice_handle *handle, gboolean offer, gboolean tri
 		"ice-tcp", janus_ice_tcp_enabled ? TRUE : FALSE,
 #endif
 		NULL);
+	handle->agent_mainctx = handle->mainctx;
 	handle->agent_created = janus_get_monotonic_time();
 	handle->srtp_errors_count = 0;
 	handle->last_srtp_error = 0;
@@ -3685,61 +4934,22 @@ int janus_ice_setup_local(janus_ice_handle *handle, gboolean offer, gboolean tri
 #endif
 		G_CALLBACK (janus_ice_cb_new_remote_candidate), handle);
 
-	/* Add all local addresses, except those in the ignore list */
-	struct ifaddrs *ifaddr, *ifa;
-	int family, s, n;
-	char host[NI_MAXHOST];
-	if(getifaddrs(&ifaddr) == -1) {
-		JANUS_LOG(LOG_ERR, "[%"SCNu64"] Error getting list of interfaces... %d (%s)\n",
-			handle->handle_id, errno, g_strerror(errno));
-	} else {
-		for(ifa = ifaddr, n = 0; ifa != NULL; ifa = ifa->ifa_next, n++) {
-			if(ifa->ifa_addr == NULL)
-				continue;
-			/* Skip interfaces which are not up and running */
-			if(!((ifa->ifa_flags & IFF_UP) && (ifa->ifa_flags & IFF_RUNNING)))
-				continue;
-			/* Skip loopback interfaces */
-			if(ifa->ifa_flags & IFF_LOOPBACK)
-				continue;
-			family = ifa->ifa_addr->sa_family;
-			if(family != AF_INET && family != AF_INET6)
-				continue;
-			/* We only add IPv6 addresses if support for them has been explicitly enabled */
-			if(family == AF_INET6 && !janus_ipv6_enabled)
-				continue;
-			/* Check the interface name first, we can ignore that as well: enforce list would be checked later */
-			if(janus_ice_enforce_list == NULL && ifa->ifa_name != NULL && janus_ice_is_ignored(ifa->ifa_name))
-				continue;
-			s = getnameinfo(ifa->ifa_addr,
-					(family == AF_INET) ? sizeof(struct sockaddr_in) : sizeof(struct sockaddr_in6),
-					host, NI_MAXHOST, NULL, 0, NI_NUMERICHOST);
-			if(s != 0) {
-				JANUS_LOG(LOG_ERR, "[%"SCNu64"] getnameinfo() failed: %s\n", handle->handle_id, gai_strerror(s));
-				continue;
-			}
-			/* Skip 0.0.0.0, :: and, unless otherwise configured, local scoped addresses  */
-			if(!strcmp(host, "0.0.0.0") || !strcmp(host, "::") || (!janus_ipv6_linklocal_enabled && !strncmp(host, "fe80:", 5)))
-				continue;
-			/* Check if this IP address is in the ignore/enforce list: the enforce list has the precedence but the ignore list can then discard candidates */
-			if(janus_ice_enforce_list != NULL) {
-				if(ifa->ifa_name != NULL && !janus_ice_is_enforced(ifa->ifa_name) && !janus_ice_is_enforced(host))
-					continue;
-			}
-			if(janus_ice_is_ignored(host))
-				continue;
-			/* Ok, add interface to the ICE agent */
-			JANUS_LOG(LOG_VERB, "[%"SCNu64"] Adding %s to the addresses to gather candidates for\n", handle->handle_id, host);
-			NiceAddress addr_local;
-			nice_address_init (&addr_local);
-			if(!nice_address_set_from_string (&addr_local, host)) {
-				JANUS_LOG(LOG_WARN, "[%"SCNu64"] Skipping invalid address %s\n", handle->handle_id, host);
-				continue;
-			}
+	/* Add all local addresses, except those in the ignore list (in single-port mode
+	 * we don't gather anything, as all PeerConnections share the same candidates) */
+	GList *addresses = janus_ice_mux_port ? NULL : janus_ice_get_local_addresses(handle->handle_id), *temp = addresses;
+	while(temp) {
+		const char *host = (const char *)temp->data;
+		JANUS_LOG(LOG_VERB, "[%"SCNu64"] Adding %s to the addresses to gather candidates for\n", handle->handle_id, host);
+		NiceAddress addr_local;
+		nice_address_init (&addr_local);
+		if(!nice_address_set_from_string (&addr_local, host)) {
+			JANUS_LOG(LOG_WARN, "[%"SCNu64"] Skipping invalid address %s\n", handle->handle_id, host);
+		} else {
 			nice_agent_add_local_address (handle->agent, &addr_local);
 		}
-		freeifaddrs(ifaddr);
+		temp = temp->next;
 	}
+	g_list_free_full(addresses, (GDestroyNotify)g_free);
 
 	handle->cdone = 0;
 	handle->stream_id = 0;
@@ -3757,7 +4967,9 @@ int janus_ice_setup_local(janus_ice_handle *handle, gboolean offer, gboolean tri
 	pc->handle = handle;
 	pc->dtls_role = dtls_role;
 	janus_mutex_init(&pc->mutex);
-	if(!have_turnrest_credentials) {
+	if(janus_ice_mux_port > 0) {
+		/* Single-port mode, no TURN */
+	} else if(!have_turnrest_credentials) {
 		/* No TURN REST API server and credentials, any static ones? */
 		if(janus_turn_server != NULL) {
 			/* We need relay candidates as well */
@@ -3795,10 +5007,18 @@ int janus_ice_setup_local(janus_ice_handle *handle, gboolean offer, gboolean tri
 	pc->media_bytype = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify)janus_ice_peerconnection_medium_dereference);
 #ifdef HAVE_PORTRANGE
 	/* FIXME: libnice supports this since 0.1.0, but the 0.1.3 on Fedora fails with an undefined reference! */
-	nice_agent_set_port_range(handle->agent, handle->stream_id, 1, rtp_range_min, rtp_range_max);
+	if(janus_ice_mux_port == 0)
+		nice_agent_set_port_range(handle->agent, handle->stream_id, 1, rtp_range_min, rtp_range_max);
 #endif
 	/* Gather now only if we're doing hanf-trickle */
-	if(!janus_full_trickle_enabled && !nice_agent_gather_candidates(handle->agent, handle->stream_id)) {
+	if(janus_ice_mux_port > 0) {
+		/* Single-port mode: our candidates are known already, and traffic
+		 * will reach us on the shared sockets, rather than via libnice */
+		janus_ice_mux_register(pc);
+		pc->gathered = janus_get_monotonic_time();
+		pc->cdone = TRUE;
+		handle->cdone = 1;
+	} else if(!janus_full_trickle_enabled && !nice_agent_gather_candidates(handle->agent, handle->stream_id)) {
 #ifdef HAVE_TURNRESTAPI
 		if(turnrest_credentials != NULL) {
 			janus_turnrest_response_destroy(turnrest_credentials);
@@ -3810,8 +5030,10 @@ int janus_ice_setup_local(janus_ice_handle *handle, gboolean offer, gboolean tri
 		janus_ice_webrtc_hangup(handle, "Gathering error");
 		return -1;
 	}
-	nice_agent_attach_recv(handle->agent, handle->stream_id, 1, g_main_loop_get_context(handle->mainloop),
-		janus_ice_cb_nice_recv, pc);
+	if(pc->mux == NULL) {
+		nice_agent_attach_recv(handle->agent, handle->stream_id, 1, g_main_loop_get_context(handle->mainloop),
+			janus_ice_cb_nice_recv, pc);
+	}
 #ifdef HAVE_TURNRESTAPI
 	if(turnrest_credentials != NULL) {
 		janus_turnrest_response_destroy(turnrest_credentials);
@@ -3846,6 +5068,9 @@ void janus_ice_restart(janus_ice_handle *handle) {
 	/* Restart ICE */
 	if(nice_agent_restart(handle->agent) == FALSE) {
 		JANUS_LOG(LOG_WARN, "[%"SCNu64"] ICE restart failed...\n", handle->handle_id);
+	} else if(handle->pc->mux != NULL) {
+		/* We have new credentials, update the single-port mapping */
+		janus_ice_mux_register(handle->pc);
 	}
 	janus_flags_clear(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_ICE_RESTART);
 }
@@ -3857,11 +5082,10 @@ void janus_ice_resend_trickles(janus_ice_handle *handle) {
 	janus_ice_peerconnection *pc = handle->pc;
 	if(!pc)
 		return;
-	NiceAgent *agent = handle->agent;
 	/* Iterate on all existing local candidates */
 	gchar buffer[200];
 	GSList *candidates, *i;
-	candidates = nice_agent_get_local_candidates (agent, pc->stream_id, pc->component_id);
+	candidates = janus_ice_get_local_candidates(handle, pc);
 	JANUS_LOG(LOG_VERB, "[%"SCNu64"] We have %d candidates for Stream #%d, Component #%d\n",
 		handle->handle_id, g_slist_length(candidates), pc->stream_id, pc->component_id);
 	for(i = candidates; i; i = i->next) {
@@ -3891,9 +5115,59 @@ void janus_ice_resend_trickles(janus_ice_handle *handle) {
 	janus_ice_notify_trickle(handle, NULL);
 }
 
+/* Helpers to write the header of an outgoing RTP extension element, returning where its value starts */
+static char *janus_ice_rtp_extension_write_header(char *index, int id, uint8_t len, gboolean use_2byte) {
+	if(!use_2byte) {
+		*index = (id << 4) + (len - 1);
+		return index + 1;
+	}
+	*index = id;
+	*(index+1) = len;
+	return index + 2;
+}
+/* Compile the template of the extensions that will be in all packets sent on a medium */
+static void janus_ice_rtp_extension_template_compile(janus_ice_handle *handle, janus_ice_peerconnection_medium *medium,
+		janus_ice_rtp_extension_template *template, gboolean use_2byte) {
+	janus_ice_peerconnection *pc = handle->pc;
+	memset(template, 0, sizeof(*template));
+	template->compiled = TRUE;
+	template->generation = pc->extmap_generation;
+	template->mid = medium->mid;
+	template->abs_send_time_offset = -1;
+	template->transport_wide_cc_offset = -1;
+	gboolean video = (medium->type == JANUS_MEDIA_VIDEO);
+	char *index = template->data;
+	/* Check if we need to add the abs-send-time extension */
+	if(video && pc->abs_send_time_ext_id > 0) {
+		index = janus_ice_rtp_extension_write_header(index, pc->abs_send_time_ext_id, 3, use_2byte);
+		template->abs_send_time_offset = index - template->data;
+		index += 3;
+	}
+	/* Check if we need to add the transport-wide CC extension */
+	if(video && pc->transport_wide_cc_ext_id > 0) {
+		index = janus_ice_rtp_extension_write_header(index, pc->transport_wide_cc_ext_id, 2, use_2byte);
+		template->transport_wide_cc_offset = index - template->data;
+		index += 2;
+	}
+	/* Check if we need to add the mid extension */
+	if(pc->mid_ext_id > 0 && medium->mid != NULL) {
+		size_t midlen = strlen(medium->mid);
+		if(midlen > 16) {
+			JANUS_LOG(LOG_WARN, "[%"SCNu64"] mid too large, capping to first 16 characters...\n", handle->handle_id);
+			midlen = 16;
+		}
+		if(midlen > 0) {
+			index = janus_ice_rtp_extension_write_header(index, pc->mid_ext_id, midlen, use_2byte);
+			memcpy(index, medium->mid, midlen);
+			index += midlen;
+		}
+	}
+	template->len = index - template->data;
+}
 static void janus_ice_rtp_extension_update(janus_ice_handle *handle, janus_ice_peerconnection_medium *medium, janus_ice_queued_packet *packet) {
 	if(handle == NULL || handle->pc == NULL || medium == NULL || packet == NULL || packet->data == NULL)
 		return;
+	janus_ice_peerconnection *pc = handle->pc;
 	uint16_t totlen = RTP_HEADER_SIZE;
 	/* Check how large the payload is */
 	int plen = 0;
@@ -3901,226 +5175,29 @@ static void janus_ice_rtp_extension_update(janus_ice_handle *handle, janus_ice_p
 	if(payload != NULL)
 		totlen += plen;
 	/* We need to strip extensions, here, and add those that need to be there manually */
-	uint16_t extlen = 0;
-	char extensions[320];
-	uint16_t extbufsize = sizeof(extensions);
-	janus_rtp_header *header = (janus_rtp_header *)packet->data;
-	header->extension = 0;
-	/* Add core and plugin extensions, if any */
 	gboolean video = (packet->type == JANUS_ICE_PACKET_VIDEO);
-	if(handle->pc->mid_ext_id > 0 || (video && handle->pc->abs_send_time_ext_id > 0) ||
-			(video && handle->pc->transport_wide_cc_ext_id > 0) ||
-			(!video && packet->extensions.audio_level > -1 && handle->pc->audiolevel_ext_id > 0) ||
-			(video && packet->extensions.video_rotation > -1 && handle->pc->videoorientation_ext_id > 0) ||
-			(video && packet->extensions.min_delay > -1 && packet->extensions.max_delay > -1 && handle->pc->playoutdelay_ext_id > 0) ||
-			(video && packet->extensions.dd_len > 0 && handle->pc->dependencydesc_ext_id > 0) ||
-			(packet->extensions.abs_capture_ts > 0 && handle->pc->abs_capture_time_ext_id > 0)) {
-		/* Do we need 2-byte extemsions, or are 1-byte extensions fine? */
-		gboolean use_2byte = (video && packet->extensions.dd_len > 16 && handle->pc->dependencydesc_ext_id > 0);
-		/* Write the extension(s) */
-		header->extension = 1;
-		memset(extensions, 0, sizeof(extensions));
-		janus_rtp_header_extension *extheader = (janus_rtp_header_extension *)extensions;
-		extheader->type = htons(use_2byte ? 0x1000 : 0xBEDE);
-		extheader->length = 0;
-		/* Iterate on all extensions we need */
-		char *index = extensions + 4;
-		extbufsize -= 4;
-		/* Check if we need to add the abs-send-time extension */
-		if(video && handle->pc->abs_send_time_ext_id > 0) {
-			int64_t now = (((janus_get_monotonic_time()/1000) << 18) + 500) / 1000;
-			uint32_t abs_ts = (uint32_t)now & 0x00FFFFFF;
-			uint32_t abs24 = htonl(abs_ts) >> 8;
-			if(!use_2byte) {
-				*index = (handle->pc->abs_send_time_ext_id << 4) + 2;
-				memcpy(index+1, &abs24, 3);
-				index += 4;
-				extlen += 4;
-				extbufsize -= 4;
-			} else {
-				*index = handle->pc->abs_send_time_ext_id;
-				*(index+1) = 3;
-				memcpy(index+2, &abs24, 3);
-				index += 5;
-				extlen += 5;
-				extbufsize -= 5;
-			}
-		}
-		/* Check if we need to add the transport-wide CC extension */
-		if(video && handle->pc->transport_wide_cc_ext_id > 0) {
-			handle->pc->transport_wide_cc_out_seq_num++;
-			uint16_t transSeqNum = htons(handle->pc->transport_wide_cc_out_seq_num);
-			if(!use_2byte) {
-				*index = (handle->pc->transport_wide_cc_ext_id << 4) + 1;
-				memcpy(index+1, &transSeqNum, 2);
-				index += 3;
-				extlen += 3;
-				extbufsize -= 3;
-			} else {
-				*index = handle->pc->transport_wide_cc_ext_id;
-				*(index+1) = 2;
-				memcpy(index+2, &transSeqNum, 2);
-				index += 4;
-				extlen += 4;
-				extbufsize -= 4;
-			}
-		}
-		/* Check if the plugin (or source) included other extensions */
-		if(!video && packet->extensions.audio_level > -1 && handle->pc->audiolevel_ext_id > 0) {
-			/* Add audio-level extension */
-			if(!use_2byte) {
-				*index = (handle->pc->audiolevel_ext_id << 4);
-				*(index+1) = (packet->extensions.audio_level_vad << 7) + (packet->extensions.audio_level & 0x7F);
-				index += 2;
-				extlen += 2;
-				extbufsize -= 2;
-			} else {
-				*index = handle->pc->audiolevel_ext_id;
-				*(index+1) = 1;
-				*(index+2) = (packet->extensions.audio_level_vad << 7) + (packet->extensions.audio_level & 0x7F);
-				index += 3;
-				extlen += 3;
-				extbufsize -= 3;
-			}
-		}
-		if(video && packet->extensions.video_rotation > -1 && handle->pc->videoorientation_ext_id > 0) {
-			/* Add video-orientation extension */
-			gboolean c = (packet->extensions.video_back_camera == TRUE),
-				f = (packet->extensions.video_flipped == TRUE), r1 = FALSE, r0 = FALSE;
-			switch(packet->extensions.video_rotation) {
-				case 270:
-					r1 = TRUE;
-					r0 = TRUE;
-					break;
-				case 180:
-					r1 = TRUE;
-					r0 = FALSE;
-					break;
-				case 90:
-					r1 = FALSE;
-					r0 = TRUE;
-					break;
-				case 0:
-				default:
-					r1 = FALSE;
-					r0 = FALSE;
-					break;
-			}
-			if(!use_2byte) {
-				*index = (handle->pc->videoorientation_ext_id << 4);
-				*(index+1) = (c<<3) + (f<<2) + (r1<<1) + r0;
-				index += 2;
-				extlen += 2;
-				extbufsize -= 2;
-			} else {
-				*index = handle->pc->videoorientation_ext_id;
-				*(index+1) = 1;
-				*(index+2) = (c<<3) + (f<<2) + (r1<<1) + r0;
-				index += 3;
-				extlen += 3;
-				extbufsize -= 3;
-			}
-		}
-		if(video && packet->extensions.min_delay > -1 && packet->extensions.max_delay > -1 && handle->pc->playoutdelay_ext_id > 0) {
-			/* Add playout-delay extension */
-			uint32_t min_delay = (uint32_t)packet->extensions.min_delay;
-			uint32_t max_delay = (uint32_t)packet->extensions.max_delay;
-			uint32_t pd = ((min_delay << 12) & 0x00FFF000) + (max_delay & 0x00000FFF);
-			uint32_t pd24 = htonl(pd) >> 8;
-			if(!use_2byte) {
-				*index = (handle->pc->playoutdelay_ext_id << 4) + 2;
-				memcpy(index+1, &pd24, 3);
-				index += 4;
-				extlen += 4;
-				extbufsize -= 4;
-			} else {
-				*index = handle->pc->playoutdelay_ext_id;
-				*(index+1) = 3;
-				memcpy(index+2, &pd24, 3);
-				index += 5;
-				extlen += 5;
-				extbufsize -= 5;
-			}
-		}
-		/* Check if we need to add the mid extension */
-		if(handle->pc->mid_ext_id > 0) {
-			char *mid = medium->mid;
-			if(mid != NULL) {
-				if(!use_2byte) {
-					size_t midlen = strlen(mid) & 0x0F;
-					if(extbufsize < (midlen + 1)) {
-						JANUS_LOG(LOG_WARN, "[%"SCNu64"] Not enough room for mid extension, skipping it...\n", handle->handle_id);
-					} else {
-						*index = (handle->pc->mid_ext_id << 4) + (midlen ? midlen-1 : 0);
-						memcpy(index+1, mid, midlen);
-						index += (midlen + 1);
-						extlen += (midlen + 1);
-						extbufsize -= (midlen + 1);
-					}
-				} else {
-					size_t midlen = strlen(mid);
-					if(midlen > 16) {
-						JANUS_LOG(LOG_WARN, "[%"SCNu64"] mid too large, capping to first 16 characters...\n", handle->handle_id);
-						midlen = 16;
-					} else if(extbufsize < (midlen + 2)) {
-						JANUS_LOG(LOG_WARN, "[%"SCNu64"] Not enough room for mid extension, skipping it...\n", handle->handle_id);
-					} else {
-						*index = handle->pc->mid_ext_id;
-						*(index+1) = midlen;
-						memcpy(index+2, mid, midlen);
-						index += (midlen + 2);
-						extlen += (midlen + 2);
-						extbufsize -= (midlen + 2);
-					}
-				}
-			}
-		}
-		if(video && packet->extensions.dd_len > 0 && handle->pc->dependencydesc_ext_id > 0) {
-			/* Add dependency descriptor extension */
-			if(extbufsize < (packet->extensions.dd_len + (use_2byte ? 2 : 1))) {
-				JANUS_LOG(LOG_WARN, "[%"SCNu64"] Not enough room for dependency-descriptor extension, skipping it...\n", handle->handle_id);
-			} else {
-				if(!use_2byte) {
-					*index = (handle->pc->dependencydesc_ext_id << 4) + (packet->extensions.dd_len-1);
-					index++;
-					memcpy(index, packet->extensions.dd_content, packet->extensions.dd_len);
-					index += packet->extensions.dd_len;
-					extlen += packet->extensions.dd_len + 1;
-					extbufsize -= packet->extensions.dd_len + 1;
-				} else {
-					*index = handle->pc->dependencydesc_ext_id;
-					*(index+1) = packet->extensions.dd_len;
-					memcpy(index+2, packet->extensions.dd_content, packet->extensions.dd_len);
-					index += packet->extensions.dd_len + 2;
-					extlen += packet->extensions.dd_len + 2;
-					extbufsize -= packet->extensions.dd_len + 2;
-				}
-			}
-		}
-		/* Check if we need to add the abs-capture-time extension */
-		if(packet->extensions.abs_capture_ts > 0 && handle->pc->abs_capture_time_ext_id > 0) {
-			uint64_t abs64 = htonll(packet->extensions.abs_capture_ts);
-			if(!use_2byte) {
-				*index = (handle->pc->abs_capture_time_ext_id << 4) + 7;
-				memcpy(index+1, &abs64, 8);
-				index += 9;
-				extlen += 9;
-				extbufsize -= 9;
-			} else {
-				*index = handle->pc->abs_capture_time_ext_id;
-				*(index+1) = 8;
-				memcpy(index+2, &abs64, 8);
-				index += 10;
-				extlen += 10;
-				extbufsize -= 10;
-			}
-		}
-		/* Calculate the whole length */
-		uint16_t words = extlen/4;
+	/* Do we need 2-byte extemsions, or are 1-byte extensions fine? */
+	gboolean use_2byte = (video && packet->extensions.dd_len > 16 && pc->dependencydesc_ext_id > 0);
+	/* The extensions that are always there come from a template, which we compile only once */
+	janus_ice_rtp_extension_template *template = &medium->rtp_ext_template[use_2byte ? 1 : 0];
+	if(!template->compiled || template->generation != pc->extmap_generation || template->mid != medium->mid)
+		janus_ice_rtp_extension_template_compile(handle, medium, template, use_2byte);
+	/* Check which core and plugin extensions we need to add on top, if any */
+	gboolean audio_level = (!video && packet->extensions.audio_level > -1 && pc->audiolevel_ext_id > 0);
+	gboolean video_orientation = (video && packet->extensions.video_rotation > -1 && pc->videoorientation_ext_id > 0);
+	gboolean playout_delay = (video && packet->extensions.min_delay > -1 && packet->extensions.max_delay > -1 && pc->playoutdelay_ext_id > 0);
+	gboolean dependency_desc = (video && packet->extensions.dd_len > 0 && pc->dependencydesc_ext_id > 0);
+	gboolean abs_capture_time = (packet->extensions.abs_capture_ts > 0 && pc->abs_capture_time_ext_id > 0);
+	/* Compute the size of the extensions block in advance, so that we can write it in place */
+	uint16_t eh = use_2byte ? 2 : 1;
+	uint16_t extlen = template->len + (audio_level ? eh+1 : 0) + (video_orientation ? eh+1 : 0) +
+		(playout_delay ? eh+3 : 0) + (dependency_desc ? eh+packet->extensions.dd_len : 0) + (abs_capture_time ? eh+8 : 0);
+	uint16_t words = 0;
+	if(extlen > 0) {
+		/* Update lengths (taking into account the RFC5285 header) */
+		words = extlen/4;
 		if(extlen%4 != 0)
 			words++;
-		extheader->length = htons(words);
-		/* Update lengths (taking into account the RFC5285 header) */
 		extlen = 4 + (words*4);
 		totlen += extlen;
 	}
@@ -4132,17 +5209,94 @@ static void janus_ice_rtp_extension_update(janus_ice_handle *handle, janus_ice_p
 	payload = payload_start ? (packet->data + payload_start) : NULL;
 	if(payload != NULL && plen > 0 && packet->length != totlen)
 		memmove(packet->data + RTP_HEADER_SIZE + extlen, payload, plen);
-	/* Finally, copy RTP extensions, if any */
-	if(extlen > 0) {
-		/* Copy the extensions after the RTP header */
-		memcpy(packet->data + RTP_HEADER_SIZE, extensions, extlen);
-	}
 	packet->length = totlen;
+	janus_rtp_header *header = (janus_rtp_header *)packet->data;
+	header->extension = (extlen > 0);
+	if(extlen == 0)
+		return;
+	/* Write the extension(s) right after the RTP header */
+	janus_rtp_header_extension *extheader = (janus_rtp_header_extension *)(packet->data + RTP_HEADER_SIZE);
+	extheader->type = htons(use_2byte ? 0x1000 : 0xBEDE);
+	extheader->length = htons(words);
+	char *index = packet->data + RTP_HEADER_SIZE + 4;
+	memcpy(index, template->data, template->len);
+	if(template->abs_send_time_offset > -1) {
+		/* Fill in the abs-send-time value */
+		int64_t now = (((janus_get_monotonic_time()/1000) << 18) + 500) / 1000;
+		uint32_t abs_ts = (uint32_t)now & 0x00FFFFFF;
+		uint32_t abs24 = htonl(abs_ts) >> 8;
+		memcpy(index + template->abs_send_time_offset, &abs24, 3);
+	}
+	if(template->transport_wide_cc_offset > -1) {
+		/* Fill in the transport-wide CC sequence number */
+		pc->transport_wide_cc_out_seq_num++;
+		uint16_t transSeqNum = htons(pc->transport_wide_cc_out_seq_num);
+		memcpy(index + template->transport_wide_cc_offset, &transSeqNum, 2);
+	}
+	index += template->len;
+	/* Check if the plugin (or source) included other extensions */
+	if(audio_level) {
+		/* Add audio-level extension */
+		index = janus_ice_rtp_extension_write_header(index, pc->audiolevel_ext_id, 1, use_2byte);
+		*index = (packet->extensions.audio_level_vad << 7) + (packet->extensions.audio_level & 0x7F);
+		index++;
+	}
+	if(video_orientation) {
+		/* Add video-orientation extension */
+		gboolean c = (packet->extensions.video_back_camera == TRUE),
+			f = (packet->extensions.video_flipped == TRUE), r1 = FALSE, r0 = FALSE;
+		switch(packet->extensions.video_rotation) {
+			case 270:
+				r1 = TRUE;
+				r0 = TRUE;
+				break;
+			case 180:
+				r1 = TRUE;
+				r0 = FALSE;
+				break;
+			case 90:
+				r1 = FALSE;
+				r0 = TRUE;
+				break;
+			case 0:
+			default:
+				r1 = FALSE;
+				r0 = FALSE;
+				break;
+		}
+		index = janus_ice_rtp_extension_write_header(index, pc->videoorientation_ext_id, 1, use_2byte);
+		*index = (c<<3) + (f<<2) + (r1<<1) + r0;
+		index++;
+	}
+	if(playout_delay) {
+		/* Add playout-delay extension */
+		uint32_t min_delay = (uint32_t)packet->extensions.min_delay;
+		uint32_t max_delay = (uint32_t)packet->extensions.max_delay;
+		uint32_t pd = ((min_delay << 12) & 0x00FFF000) + (max_delay & 0x00000FFF);
+		uint32_t pd24 = htonl(pd) >> 8;
+		index = janus_ice_rtp_extension_write_header(index, pc->playoutdelay_ext_id, 3, use_2byte);
+		memcpy(index, &pd24, 3);
+		index += 3;
+	}
+	if(dependency_desc) {
+		/* Add dependency descriptor extension */
+		index = janus_ice_rtp_extension_write_header(index, pc->dependencydesc_ext_id, packet->extensions.dd_len, use_2byte);
+		memcpy(index, packet->extensions.dd_content, packet->extensions.dd_len);
+		index += packet->extensions.dd_len;
+	}
+	if(abs_capture_time) {
+		/* Add abs-capture-time extension */
+		uint64_t abs64 = htonll(packet->extensions.abs_capture_ts);
+		index = janus_ice_rtp_extension_write_header(index, pc->abs_capture_time_ext_id, 8, use_2byte);
+		memcpy(index, &abs64, 8);
+		index += 8;
+	}
+	/* Zero padding, if needed */
+	char *extend = packet->data + RTP_HEADER_SIZE + extlen;
+	if(index < extend)
+		memset(index, 0, extend - index);
 }
 
-static gint rtcp_transport_wide_cc_stats_comparator(gconstpointer item1, gconstpointer item2) {
-	return ((rtcp_transport_wide_cc_stats*)item1)->transport_seq_num - ((rtcp_transport_wide_cc_stats*)item2)->transport_seq_num;
-}
 static gboolean janus_ice_outgoing_transport_wide_cc_feedback(gpointer user_data) {
 	janus_ice_handle *handle = (janus_ice_handle *)user_data;
 	janus_ice_peerconnection *pc = handle->pc;
@@ -4186,83 +5340,26 @@ static gboolean janus_ice_outgoing_transport_wide_cc_feedback(gpointer user_data
 		/* Create a transport wide feedback message */
 		size_t size = 1300;
 		char rtcpbuf[1300];
-		/* Order packet list */
-		pc->transport_wide_received_seq_nums = g_slist_sort(pc->transport_wide_received_seq_nums,
-			rtcp_transport_wide_cc_stats_comparator);
-		/* Create full stats queue */
-		GQueue *packets = g_queue_new();
-		/* For all packets */
-		GSList *it = NULL;
-		for(it = pc->transport_wide_received_seq_nums; it; it = it->next) {
-			/* Get stat */
-			janus_rtcp_transport_wide_cc_stats *stats = (janus_rtcp_transport_wide_cc_stats *)it->data;
-			/* Get transport seq */
-			guint32 transport_seq_num = stats->transport_seq_num;
-			/* Check if it is an out of order  */
-			if(transport_seq_num < pc->transport_wide_cc_last_feedback_seq_num) {
-				/* Skip, it was already reported as lost */
-				g_free(stats);
-				continue;
-			}
-			/* If not first */
-			if(pc->transport_wide_cc_last_feedback_seq_num) {
-				/* For each lost */
-				guint32 i = 0;
-				for(i = pc->transport_wide_cc_last_feedback_seq_num+1; i<transport_seq_num; ++i) {
-					/* Create new stat */
-					janus_rtcp_transport_wide_cc_stats *missing = g_malloc(sizeof(janus_rtcp_transport_wide_cc_stats));
-					/* Add missing packet */
-					missing->transport_seq_num = i;
-					missing->timestamp = 0;
-					/* Add it */
-					g_queue_push_tail(packets, missing);
-				}
-			}
-			/* Store last */
-			pc->transport_wide_cc_last_feedback_seq_num = transport_seq_num;
-			/* Add this one */
-			g_queue_push_tail(packets, stats);
-		}
-		/* Free and reset stats list */
-		g_slist_free(pc->transport_wide_received_seq_nums);
-		pc->transport_wide_received_seq_nums = NULL;
-		/* Create and enqueue RTCP packets */
-		guint packets_len = 0;
-		while((packets_len = g_queue_get_length(packets)) > 0) {
-			GQueue *packets_to_process;
-			/* If we have more than 400 packets to acknowledge, let's send more than one message */
-			if(packets_len > 400) {
-				/* Split the queue into two */
-				GList *new_head = g_queue_peek_nth_link(packets, 400);
-				GList *new_tail = new_head->prev;
-				new_head->prev = NULL;
-				new_tail->next = NULL;
-				packets_to_process = g_queue_new();
-				packets_to_process->head = packets->head;
-				packets_to_process->tail = new_tail;
-				packets_to_process->length = 400;
-				packets->head = new_head;
-				/* packets->tail is unchanged */
-				packets->length = packets_len - 400;
-			} else {
-				packets_to_process = packets;
+		/* Create and enqueue RTCP packets: if we have more than
+		 * JANUS_RTCP_TWCC_MAX_PACKETS packets to acknowledge, we'll send more than one message */
+		while(TRUE) {
+			janus_mutex_lock(&pc->mutex);
+			if(janus_rtcp_transport_wide_cc_history_pending(pc->transport_wide_cc_history) == 0) {
+				janus_mutex_unlock(&pc->mutex);
+				break;
 			}
 			/* Get feedback packet count and increase it for next one */
 			guint8 feedback_packet_count = pc->transport_wide_cc_feedback_count++;
 			/* Create RTCP packet */
 			int len = janus_rtcp_transport_wide_cc_feedback(rtcpbuf, size,
-				medium->ssrc, ssrc_peer, feedback_packet_count, packets_to_process);
+				medium->ssrc, ssrc_peer, feedback_packet_count, pc->transport_wide_cc_history, JANUS_RTCP_TWCC_MAX_PACKETS);
+			janus_mutex_unlock(&pc->mutex);
+			if(len <= 0)
+				break;
 			/* Enqueue it, we'll send it later */
-			if(len > 0) {
-				janus_plugin_rtcp rtcp = { .mindex = medium->mindex, .video = TRUE, .buffer = rtcpbuf, .length = len };
-				janus_ice_relay_rtcp_internal(handle, medium, &rtcp, FALSE);
-			}
-			if(packets_to_process != packets) {
-				g_queue_free(packets_to_process);
-			}
+			janus_plugin_rtcp rtcp = { .mindex = medium->mindex, .video = TRUE, .buffer = rtcpbuf, .length = len };
+			janus_ice_relay_rtcp_internal(handle, medium, &rtcp, FALSE);
 		}
-		/* Free mem */
-		g_queue_free(packets);
 	}
 	return G_SOURCE_CONTINUE;
 }
@@ -4366,6 +5463,8 @@ static gboolean janus_ice_outgoing_stats_handle(gpointer user_data) {
 	janus_ice_peerconnection *pc = handle->pc;
 	if(pc == NULL)
 		return G_SOURCE_CONTINUE;
+	/* Let the Admin API know how the estimator and the pacer are doing */
+	janus_ice_peerconnection_update_bwe_snapshot(pc);
 	/* Iterate on all media */
 	handle->last_event_stats++;
 	janus_ice_peerconnection_medium *medium = NULL;
@@ -4507,6 +5606,9 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 		/* Start gathering candidates */
 		if(handle->agent == NULL) {
 			JANUS_LOG(LOG_WARN, "[%"SCNu64"] No ICE agent, not going to gather candidates...\n", handle->handle_id);
+		} else if(pc != NULL && pc->mux != NULL) {
+			/* Single-port mode, nothing to gather: just trickle the shared candidates */
+			janus_ice_resend_trickles(handle);
 		} else if(!nice_agent_gather_candidates(handle->agent, handle->stream_id)) {
 			JANUS_LOG(LOG_ERR, "[%"SCNu64"] Error gathering candidates...\n", handle->handle_id);
 			janus_ice_webrtc_hangup(handle, "ICE gathering error");
@@ -4526,7 +5628,11 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 			}
 		}
 		guint count = g_slist_length(candidates);
-		if(pc != NULL && count > 0) {
+		if(pc != NULL && count > 0 && pc->mux != NULL) {
+			/* Single-port mode, we're ICE Lite: we'll learn the address from the connectivity checks */
+			if(handle->agent_started == 0)
+				handle->agent_started = janus_get_monotonic_time();
+		} else if(pc != NULL && count > 0) {
 			if(handle->agent_started == 0)
 				handle->agent_started = janus_get_monotonic_time();
 			int added = nice_agent_set_remote_candidates(handle->agent, pc->stream_id, pc->component_id, candidates);
@@ -4606,6 +5712,9 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 			g_source_unref(handle->stats_source);
 			handle->stats_source = NULL;
 		}
+		janus_timer_wheel_remove(&handle->rtcp_timer);
+		janus_timer_wheel_remove(&handle->twcc_timer);
+		janus_timer_wheel_remove(&handle->stats_timer);
 		/* If event handlers are active, send stats one last time */
 		if(janus_events_is_enabled()) {
 			handle->last_event_stats = janus_ice_event_stats_period;
@@ -4653,6 +5762,36 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 				handle->handle_id, plugin ? plugin->get_name() : "??");
 			plugin->data_ready(handle->app_handle);
 		}
+	} else if(pkt == &janus_ice_mux_connected) {
+		/* Single-port mode, the peer reached us: this is what a new selected pair is for libnice */
+		if(pc == NULL || pc->mux == NULL)
+			return G_SOURCE_CONTINUE;
+		janus_ice_mux_entry *entry = (janus_ice_mux_entry *)pc->mux;
+		char address[NI_MAXHOST], port[NI_MAXSERV];
+		janus_mutex_lock(&entry->mutex);
+		int res = getnameinfo((struct sockaddr *)&entry->peer.address, entry->peer.address_len,
+			address, sizeof(address), port, sizeof(port), NI_NUMERICHOST | NI_NUMERICSERV);
+		janus_mutex_unlock(&entry->mutex);
+		g_free(pc->selected_pair);
+		pc->selected_pair = g_strdup_printf("[shared port %"SCNu16"] <-> %s:%s", janus_ice_mux_port,
+			res == 0 ? address : "??", res == 0 ? port : "??");
+		pc->state = NICE_COMPONENT_STATE_READY;
+		if(pc->connected > 0)
+			return G_SOURCE_CONTINUE;
+		JANUS_LOG(LOG_VERB, "[%"SCNu64"]   Peer reached us on the shared port, starting DTLS handshake...\n", handle->handle_id);
+		pc->connected = janus_get_monotonic_time();
+#if GLIB_CHECK_VERSION(2, 46, 0)
+		g_async_queue_push_front(handle->queued_packets, &janus_ice_dtls_handshake);
+#else
+		g_async_queue_push(handle->queued_packets, &janus_ice_dtls_handshake);
+#endif
+		return G_SOURCE_CONTINUE;
+	} else if(pkt != NULL && pkt->type == JANUS_ICE_PACKET_INCOMING) {
+		/* Packet received outside of libnice (e.g., on a shared port), process it as if libnice had given it to us */
+		if(pc != NULL && handle->agent != NULL)
+			janus_ice_cb_nice_recv(handle->agent, pc->stream_id, 1, pkt->length, pkt->data, pc);
+		janus_ice_free_queued_packet(pkt);
+		return G_SOURCE_CONTINUE;
 	}
 	if(!janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_READY)) {
 		janus_ice_free_queued_packet(pkt);
@@ -4661,7 +5800,7 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 	/* Now let's get on with the packet */
 	if(pkt == NULL)
 		return G_SOURCE_CONTINUE;
-	if(pkt->data == NULL || pc == NULL) {
+	if((pkt->data == NULL && pkt->shared_data == NULL) || pc == NULL) {
 		janus_ice_free_queued_packet(pkt);
 		return G_SOURCE_CONTINUE;
 	}
@@ -4707,12 +5846,15 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 		medium->noerrorlog = FALSE;
 		if(pkt->encrypted) {
 			/* Already SRTCP */
-			int sent = nice_agent_send(handle->agent, pc->stream_id, pc->component_id, pkt->length, (const gchar *)pkt->data);
+			int sent = janus_ice_peerconnection_send(pc, (const char *)pkt->data, pkt->length);
+			janus_ice_static_event_loop_account(handle, sent);
 			if(sent < pkt->length) {
 				JANUS_LOG(LOG_ERR, "[%"SCNu64"] ... only sent %d bytes? (was %d)\n", handle->handle_id, sent, pkt->length);
 			}
 		} else {
 			/* Check if there's anything we need to do before sending */
+			janus_rtcp_compound compound;
+			janus_rtcp_parse_compound(pkt->data, pkt->length, &compound);
 			if(pkt->control_ext) {
 				/* Fix all SSRCs before enqueueing, as we need to use the ones for this media
 				 * leg. Note that this is only needed for RTCP packets coming from plugins: the
@@ -4722,7 +5864,7 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 				janus_rtcp_fix_ssrc(NULL, pkt->data, pkt->length, 1,
 					medium->ssrc, medium->ssrc_peer[0]);
 				/* If this is a PLI and we're simulcasting, send a PLI on other layers as well */
-				if(video && janus_rtcp_has_pli(pkt->data, pkt->length)) {
+				if(video && compound.has_pli) {
 					if(medium->ssrc_peer[1]) {
 						char plibuf[12];
 						memset(plibuf, 0, 12);
@@ -4743,8 +5885,7 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 					}
 				}
 			}
-			uint32_t bitrate = janus_rtcp_get_remb(pkt->data, pkt->length);
-			if(bitrate > 0) {
+			if(compound.remb_bitrate > 0) {
 				/* There's a REMB, prepend a RR as it won't work otherwise */
 				int rrlen = 8;
 				char *rtcpbuf = g_malloc0(rrlen+pkt->length+SRTP_MAX_TAG_LEN+4);
@@ -4786,7 +5927,8 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 				JANUS_LOG(LOG_DBG, "[%"SCNu64"] ... SRTCP protect error... %s (len=%d-->%d)...\n", handle->handle_id, janus_srtp_error_str(res), pkt->length, protected);
 			} else {
 				/* Shoot! */
-				int sent = nice_agent_send(handle->agent, pc->stream_id, pc->component_id, protected, pkt->data);
+				int sent = janus_ice_peerconnection_send(pc, pkt->data, protected);
+				janus_ice_static_event_loop_account(handle, sent);
 				if(sent < protected) {
 					JANUS_LOG(LOG_ERR, "[%"SCNu64"] ... only sent %d bytes? (was %d)\n", handle->handle_id, sent, protected);
 				}
@@ -4816,13 +5958,16 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 				/* Already RTP (probably a retransmission?) */
 				janus_rtp_header *header = (janus_rtp_header *)pkt->data;
 				JANUS_LOG(LOG_HUGE, "[%"SCNu64"] ... Retransmitting seq.nr %"SCNu16"\n\n", handle->handle_id, ntohs(header->seq_number));
-				int sent = nice_agent_send(handle->agent, pc->stream_id, pc->component_id, pkt->length, (const gchar *)pkt->data);
+				int sent = janus_ice_peerconnection_send(pc, (const char *)pkt->data, pkt->length);
+				janus_ice_static_event_loop_account(handle, sent);
 				if(sent < pkt->length) {
 					JANUS_LOG(LOG_ERR, "[%"SCNu64"] ... only sent %d bytes? (was %d)\n", handle->handle_id, sent, pkt->length);
 				}
 			} else {
 				/* Prune/update/set RTP extensions */
+				guint16 twcc_seq = pc->transport_wide_cc_out_seq_num;
 				janus_ice_rtp_extension_update(handle, medium, pkt);
+				gboolean twcc_sent = (pc->transport_wide_cc_out_seq_num != twcc_seq);
 				/* Overwrite SSRC */
 				janus_rtp_header *header = (janus_rtp_header *)pkt->data;
 				if(!pkt->retransmission) {
@@ -4876,31 +6021,41 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 				janus_rtp_packet *p = NULL;
 				if(medium->nack_queue_ms > 0 && !pkt->retransmission && pkt->type == JANUS_ICE_PACKET_VIDEO && medium->do_nacks &&
 						janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_RFC4588_RTX)) {
-					/* Save the packet for retransmissions that may be needed later: start by
-					 * making room for two more bytes to store the original sequence number */
-					p = g_malloc(sizeof(janus_rtp_packet));
-					janus_rtp_header *header = (janus_rtp_header *)pkt->data;
-					guint16 original_seq = header->seq_number;
-					p->data = g_malloc(pkt->length+2);
-					p->length = pkt->length+2;
 					/* Check where the payload starts */
 					int plen = 0;
 					char *payload = janus_rtp_payload(pkt->data, pkt->length, &plen);
 					if(plen == 0) {
 						JANUS_LOG(LOG_WARN, "[%"SCNu64"] Discarding outgoing empty RTP packet\n", handle->handle_id);
-						janus_ice_free_rtp_packet(p);
 						janus_ice_free_queued_packet(pkt);
 						return G_SOURCE_CONTINUE;
 					}
 					size_t hsize = payload - pkt->data;
-					/* Copy the header first */
-					memcpy(p->data, pkt->data, hsize);
-					/* Copy the original sequence number */
-					memcpy(p->data+hsize, &original_seq, 2);
+					p = g_malloc(sizeof(janus_rtp_packet));
+					if(pkt->shared != NULL && pkt->shared->length == plen) {
+						/* The plugin gave us a shared copy of the payload: we only save the
+						 * header we're sending, and take over the reference to the payload */
+						p->data = g_malloc(hsize);
+						p->length = hsize;
+						memcpy(p->data, pkt->data, hsize);
+						p->shared = pkt->shared;
+						pkt->shared = NULL;
+					} else {
+						/* Save the packet for retransmissions that may be needed later: start by
+						 * making room for two more bytes to store the original sequence number */
+						janus_rtp_header *header = (janus_rtp_header *)pkt->data;
+						guint16 original_seq = header->seq_number;
+						p->data = g_malloc(pkt->length+2);
+						p->length = pkt->length+2;
+						p->shared = NULL;
+						/* Copy the header first */
+						memcpy(p->data, pkt->data, hsize);
+						/* Copy the original sequence number */
+						memcpy(p->data+hsize, &original_seq, 2);
+						/* Copy the payload */
+						memcpy(p->data+hsize+2, payload, pkt->length - hsize);
+					}
 					/* Copy the extensions struct */
 					p->extensions = pkt->extensions;
-					/* Copy the payload */
-					memcpy(p->data+hsize+2, payload, pkt->length - hsize);
 				}
 				/* Encrypt SRTP */
 				int protected = pkt->length;
@@ -4919,10 +6074,19 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 					janus_ice_free_rtp_packet(p);
 				} else {
 					/* Shoot! */
-					int sent = nice_agent_send(handle->agent, pc->stream_id, pc->component_id, protected, pkt->data);
+					int sent = janus_ice_peerconnection_send(pc, pkt->data, protected);
+					janus_ice_static_event_loop_account(handle, sent);
 					if(sent < protected) {
 						JANUS_LOG(LOG_ERR, "[%"SCNu64"] ... only sent %d bytes? (was %d)\n", handle->handle_id, sent, protected);
 					}
+					if(twcc_sent && sent > 0) {
+						/* Keep track of this packet for the bandwidth estimation, if the plugin is interested or we're pacing */
+						janus_plugin *plugin = (janus_plugin *)handle->app;
+						if(pc->bwe == NULL && (pacing_multiplier > 0 || (plugin && plugin->estimated_bandwidth)))
+							pc->bwe = janus_bwe_context_create();
+						janus_bwe_context_add_inflight(pc->bwe, pc->transport_wide_cc_out_seq_num,
+							janus_get_monotonic_time(), sent);
+					}
 					/* Update stats */
 					if(sent > 0) {
 						/* Update the RTCP context as well */
@@ -4978,6 +6142,7 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 							p->data = g_malloc(protected);
 							memcpy(p->data, pkt->data, protected);
 							p->length = protected;
+							p->shared = NULL;
 							janus_plugin_rtp_extensions_reset(&p->extensions);
 						}
 						p->created = janus_get_monotonic_time();
@@ -5014,8 +6179,10 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 			}
 			medium->noerrorlog = FALSE;
 			/* TODO Support binary data */
-			janus_dtls_wrap_sctp_data(pc->dtls, pkt->label, pkt->protocol,
-				pkt->type == JANUS_ICE_PACKET_TEXT, pkt->data, pkt->length);
+			janus_dtls_wrap_sctp_data(pc->dtls, pkt->label, pkt->protocol, pkt->type == JANUS_ICE_PACKET_TEXT,
+				pkt->shared_data ? pkt->shared_data->buffer : pkt->data, pkt->length);
+			/* Keep track of how long it took for the message to get here, if shared */
+			janus_plugin_data_shared_sent(pkt->shared_data);
 #endif
 		} else if(pkt->type == JANUS_ICE_PACKET_SCTP) {
 			/* SCTP data to push */
@@ -5044,6 +6211,42 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 	return G_SOURCE_CONTINUE;
 }
 
+/* Helper to check whether an outgoing packet should go through the pacer: returns TRUE if it was queued */
+static gboolean janus_ice_outgoing_traffic_pace(janus_ice_handle *handle, janus_ice_queued_packet *pkt) {
+	/* We only pace video: audio, RTCP and data go out right away */
+	if(pacing_multiplier <= 0 || pkt->type != JANUS_ICE_PACKET_VIDEO || pkt->control)
+		return FALSE;
+	janus_ice_peerconnection *pc = handle->pc;
+	if(pc == NULL || !janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_READY) ||
+			janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_ALERT))
+		return FALSE;
+	gint64 now = janus_get_monotonic_time();
+	if(pkt->retransmission) {
+		/* Retransmissions skip the queue, but they count towards the rate */
+		janus_pacer_bypass(pc->pacer, pkt->length, now);
+		return FALSE;
+	}
+	if(pc->pacer == NULL)
+		pc->pacer = janus_pacer_create();
+	janus_pacer_enqueue(pc->pacer, pkt, pkt->length, now);
+	return TRUE;
+}
+
+/* Helper to send the paced packets whose turn has come, if any */
+static void janus_ice_outgoing_traffic_paced(janus_ice_handle *handle) {
+	janus_ice_peerconnection *pc = handle->pc;
+	if(pc == NULL || pc->pacer == NULL || pc->pacer->count == 0)
+		return;
+	/* The rate depends on the estimated bandwidth, if we have one, or on what we're sending */
+	uint32_t bitrate = (pc->bwe != NULL && pc->bwe->status != janus_bwe_status_start) ?
+		pc->bwe->estimate : pc->pacer->input_bitrate;
+	janus_pacer_set_rate(pc->pacer, (uint32_t)(bitrate * pacing_multiplier));
+	gint64 now = janus_get_monotonic_time();
+	janus_ice_queued_packet *pkt = NULL;
+	while(handle->pc == pc && (pkt = janus_pacer_dequeue(pc->pacer, now)) != NULL)
+		janus_ice_outgoing_traffic_handle(handle, pkt);
+}
+
 static void janus_ice_queue_packet(janus_ice_handle *handle, janus_ice_queued_packet *pkt) {
 	/* TODO: There is a potential race condition where the "queued_packets"
 	 * could get released between the condition and pushing the packet. */
@@ -5073,6 +6276,14 @@ void janus_ice_relay_rtp(janus_ice_handle *handle, janus_plugin_rtp *packet) {
 	pkt->retransmission = FALSE;
 	pkt->label = NULL;
 	pkt->protocol = NULL;
+	pkt->shared = NULL;
+	pkt->shared_data = NULL;
+	if(packet->shared != NULL && packet->video &&
+			janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_RFC4588_RTX)) {
+		/* Keep a reference to the shared payload, we may use it for retransmissions */
+		janus_rtp_shared_packet_ref(packet->shared);
+		pkt->shared = packet->shared;
+	}
 	pkt->added = janus_get_monotonic_time();
 	janus_ice_queue_packet(handle, pkt);
 }
@@ -5085,13 +6296,13 @@ void janus_ice_relay_rtcp_internal(janus_ice_handle *handle, janus_ice_peerconne
 	/* We use this internal method to check whether we need to filter RTCP (e.g., to make
 	 * sure we don't just forward any SR/RR from peers/plugins, but use our own) or it has
 	 * already been done, and so this is actually a packet added by the ICE send thread */
-	char *rtcp_buf = packet->buffer;
 	int rtcp_len = packet->length;
 	gboolean has_medium = (medium != NULL);
+	char *rtcp_buf = g_malloc(rtcp_len+SRTP_MAX_TAG_LEN+4);
 	if(filter_rtcp) {
-		/* Strip RR/SR/SDES/NACKs/etc. */
-		rtcp_buf = janus_rtcp_filter(packet->buffer, packet->length, &rtcp_len);
-		if(rtcp_buf == NULL || rtcp_len < 1) {
+		/* Strip RR/SR/SDES/NACKs/etc., copying what's left directly where we'll queue it */
+		rtcp_len = janus_rtcp_filter_into(packet->buffer, packet->length, rtcp_buf, rtcp_len);
+		if(rtcp_len < 1) {
 			g_free(rtcp_buf);
 			return;
 		}
@@ -5104,12 +6315,13 @@ void janus_ice_relay_rtcp_internal(janus_ice_handle *handle, janus_ice_peerconne
 			janus_rtcp_fix_ssrc(NULL, rtcp_buf, rtcp_len, 1,
 				medium->ssrc, medium->ssrc_peer[0]);
 		}
+	} else {
+		memcpy(rtcp_buf, packet->buffer, rtcp_len);
 	}
 	/* Queue this packet */
 	janus_ice_queued_packet *pkt = g_malloc(sizeof(janus_ice_queued_packet));
 	pkt->mindex = (has_medium) ? medium->mindex : packet->mindex;
-	pkt->data = g_malloc(rtcp_len+SRTP_MAX_TAG_LEN+4);
-	memcpy(pkt->data, rtcp_buf, rtcp_len);
+	pkt->data = rtcp_buf;
 	pkt->length = rtcp_len;
 	pkt->type = packet->video ? JANUS_ICE_PACKET_VIDEO : JANUS_ICE_PACKET_AUDIO;
 	memset(&pkt->extensions, 0, sizeof(pkt->extensions));
@@ -5119,12 +6331,10 @@ void janus_ice_relay_rtcp_internal(janus_ice_handle *handle, janus_ice_peerconne
 	pkt->retransmission = FALSE;
 	pkt->label = NULL;
 	pkt->protocol = NULL;
+	pkt->shared = NULL;
+	pkt->shared_data = NULL;
 	pkt->added = janus_get_monotonic_time();
 	janus_ice_queue_packet(handle, pkt);
-	if(rtcp_buf != packet->buffer) {
-		/* We filtered the original packet, deallocate it */
-		g_free(rtcp_buf);
-	}
 }
 
 void janus_ice_relay_rtcp(janus_ice_handle *handle, janus_plugin_rtcp *packet) {
@@ -5167,9 +6377,14 @@ void janus_ice_relay_data(janus_ice_handle *handle, janus_plugin_data *packet) {
 	if(!handle || !handle->pc || handle->queued_packets == NULL || packet == NULL || packet->buffer == NULL || packet->length < 1)
 		return;
 	janus_ice_queued_packet *pkt = g_malloc(sizeof(janus_ice_queued_packet));
-	pkt->data = g_malloc(packet->length);
 	pkt->mindex = -1;
-	memcpy(pkt->data, packet->buffer, packet->length);
+	if(packet->shared != NULL && packet->shared->length == packet->length) {
+		/* The same message is being sent to many peers, reference it rather than copying it */
+		pkt->data = NULL;
+	} else {
+		pkt->data = g_malloc(packet->length);
+		memcpy(pkt->data, packet->buffer, packet->length);
+	}
 	pkt->length = packet->length;
 	pkt->type = packet->binary ? JANUS_ICE_PACKET_BINARY : JANUS_ICE_PACKET_TEXT;
 	memset(&pkt->extensions, 0, sizeof(pkt->extensions));
@@ -5179,6 +6394,12 @@ void janus_ice_relay_data(janus_ice_handle *handle, janus_plugin_data *packet) {
 	pkt->retransmission = FALSE;
 	pkt->label = packet->label ? g_strdup(packet->label) : NULL;
 	pkt->protocol = packet->protocol ? g_strdup(packet->protocol) : NULL;
+	pkt->shared = NULL;
+	pkt->shared_data = NULL;
+	if(pkt->data == NULL) {
+		janus_plugin_data_shared_ref(packet->shared);
+		pkt->shared_data = packet->shared;
+	}
 	pkt->added = janus_get_monotonic_time();
 	janus_ice_queue_packet(handle, pkt);
 }
@@ -5207,6 +6428,8 @@ void janus_ice_relay_sctp(janus_ice_handle *handle, char *buffer, int length) {
 	pkt->retransmission = FALSE;
 	pkt->label = NULL;
 	pkt->protocol = NULL;
+	pkt->shared = NULL;
+	pkt->shared_data = NULL;
 	pkt->added = janus_get_monotonic_time();
 	janus_ice_queue_packet(handle, pkt);
 #endif
@@ -5251,24 +6474,38 @@ void janus_ice_dtls_handshake_done(janus_ice_handle *handle) {
 		return;
 	}
 	janus_flags_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_READY);
-	/* Create a source for RTCP and one for stats */
-	handle->rtcp_source = g_timeout_source_new_seconds(1);
-	g_source_set_priority(handle->rtcp_source, G_PRIORITY_DEFAULT);
-	g_source_set_callback(handle->rtcp_source, janus_ice_outgoing_rtcp_handle, handle, NULL);
-	g_source_attach(handle->rtcp_source, handle->mainctx);
-	if(twcc_period != 1000) {
-		/* The Transport Wide CC feedback period is different, create another source */
-		handle->twcc_source = g_timeout_source_new(twcc_period);
-		g_source_set_priority(handle->twcc_source, G_PRIORITY_DEFAULT);
-		g_source_set_callback(handle->twcc_source, janus_ice_outgoing_transport_wide_cc_feedback, handle, NULL);
-		g_source_attach(handle->twcc_source, handle->mainctx);
-	}
 	handle->last_event_stats = 0;
 	handle->last_srtp_summary = -1;
-	handle->stats_source = g_timeout_source_new_seconds(1);
-	g_source_set_callback(handle->stats_source, janus_ice_outgoing_stats_handle, handle, NULL);
-	g_source_set_priority(handle->stats_source, G_PRIORITY_DEFAULT);
-	g_source_attach(handle->stats_source, handle->mainctx);
+	janus_ice_static_event_loop *loop = (janus_ice_static_event_loop *)handle->static_event_loop;
+	if(loop != NULL) {
+		/* We're on a static loop: schedule RTCP and stats (and TWCC, if
+		 * needed) on its timer wheel, rather than adding sources to it */
+		janus_timer_init(&handle->rtcp_timer, 1000, janus_ice_outgoing_rtcp_handle, handle);
+		janus_timer_wheel_add(loop->timers, &handle->rtcp_timer);
+		if(twcc_period != 1000) {
+			janus_timer_init(&handle->twcc_timer, twcc_period, janus_ice_outgoing_transport_wide_cc_feedback, handle);
+			janus_timer_wheel_add(loop->timers, &handle->twcc_timer);
+		}
+		janus_timer_init(&handle->stats_timer, 1000, janus_ice_outgoing_stats_handle, handle);
+		janus_timer_wheel_add(loop->timers, &handle->stats_timer);
+	} else {
+		/* Create a source for RTCP and one for stats */
+		handle->rtcp_source = g_timeout_source_new_seconds(1);
+		g_source_set_priority(handle->rtcp_source, G_PRIORITY_DEFAULT);
+		g_source_set_callback(handle->rtcp_source, janus_ice_outgoing_rtcp_handle, handle, NULL);
+		g_source_attach(handle->rtcp_source, handle->mainctx);
+		if(twcc_period != 1000) {
+			/* The Transport Wide CC feedback period is different, create another source */
+			handle->twcc_source = g_timeout_source_new(twcc_period);
+			g_source_set_priority(handle->twcc_source, G_PRIORITY_DEFAULT);
+			g_source_set_callback(handle->twcc_source, janus_ice_outgoing_transport_wide_cc_feedback, handle, NULL);
+			g_source_attach(handle->twcc_source, handle->mainctx);
+		}
+		handle->stats_source = g_timeout_source_new_seconds(1);
+		g_source_set_callback(handle->stats_source, janus_ice_outgoing_stats_handle, handle, NULL);
+		g_source_set_priority(handle->stats_source, G_PRIORITY_DEFAULT);
+		g_source_attach(handle->stats_source, handle->mainctx);
+	}
 	janus_mutex_unlock(&handle->mutex);
 	JANUS_LOG(LOG_INFO, "[%"SCNu64"] The DTLS handshake has been completed\n", handle->handle_id);
 	/* Notify the plugin that the WebRTC PeerConnection is ready to be used */
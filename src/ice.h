@@ -28,6 +28,9 @@
 #include "dtls.h"
 #include "sctp.h"
 #include "rtcp.h"
+#include "bwe.h"
+#include "pacer.h"
+#include "timerwheel.h"
 #include "text2pcap.h"
 #include "utils.h"
 #include "ip-utils.h"
@@ -78,6 +81,11 @@ int janus_ice_set_turn_server(gchar *turn_server, uint16_t turn_port, gchar *tur
  * @param[in] api_timeout total timeout for HTTP method in seconds
  * @returns 0 in case of success, a negative integer on errors */
 int janus_ice_set_turn_rest_api(gchar *api_server, gchar *api_key, gchar *api_method, uint api_timeout);
+/*! \brief Method to configure the caching of credentials retrieved via TURN REST API
+ * @param[in] refresh Percentage of the credentials TTL after which they must be refreshed (0 disables the cache)
+ * @param[in] username Username to use for all requests, so that credentials are shared by all handles (NULL to use the opaque_id/session_id)
+ * @returns 0 in case of success, a negative integer on errors */
+int janus_ice_set_turn_rest_api_cache(guint refresh, gchar *username);
 /*! \brief Method to get the STUN server IP address
  * @returns The currently used STUN server IP address, if available, or NULL if not */
 char *janus_ice_get_stun_server(void);
@@ -93,6 +101,9 @@ uint16_t janus_ice_get_turn_port(void);
 /*! \brief Method to get the specified TURN REST API backend, if any
  * @returns The currently specified  TURN REST API backend, if available, or NULL if not */
 char *janus_ice_get_turn_rest_api(void);
+/*! \brief Method to get statistics on the TURN REST API client (cache hits/misses, latency)
+ * @returns A JSON object with the statistics, if a backend is configured, or NULL if not */
+json_t *janus_ice_get_turn_rest_api_stats(void);
 /*! \brief Method to enable applications to force Janus to use TURN */
 void janus_ice_allow_force_relay(void);
 /*! \brief Method to check whether applications are allowed to force Janus to use TURN
@@ -127,6 +138,23 @@ gboolean janus_ice_is_ignored(const char *ip);
 /*! \brief Method to check whether ICE Lite mode is enabled or not (still WIP)
  * @returns true if ICE-TCP support is enabled/supported, false otherwise */
 gboolean janus_ice_is_ice_lite_enabled(void);
+/*! \brief Method to enable the single-port ICE mode, where all PeerConnections share the same UDP port
+ * \details In this mode, handles don't gather candidates (and so don't bind any socket)
+ * on their own: a few shared sockets (bound with \c SO_REUSEPORT to the same port) receive
+ * all traffic, which is demultiplexed by looking at the STUN USERNAME of connectivity
+ * checks first, and by the source address after that. All PeerConnections advertise the
+ * same host candidates. This implicitly enables ICE Lite, and disables ICE-TCP and TURN.
+ * @note This must be called after janus_ice_init
+ * @param[in] port The UDP port to bind the shared sockets to
+ * @param[in] sockets How many sockets (and threads) to create per address family (0 means one per CPU)
+ * @returns 0 in case of success, a negative integer otherwise */
+int janus_ice_set_single_port(uint16_t port, int sockets);
+/*! \brief Method to check whether the single-port ICE mode is enabled or not
+ * @returns true if the single-port ICE mode is enabled, false otherwise */
+gboolean janus_ice_is_single_port_enabled(void);
+/*! \brief Method to get the port all PeerConnections share, in single-port ICE mode
+ * @returns The shared port, or 0 if the single-port ICE mode is disabled */
+uint16_t janus_ice_get_single_port(void);
 /*! \brief Method to check whether ICE-TCP support is enabled/supported or not (still WIP)
  * @returns true if ICE-TCP support is enabled/supported, false otherwise */
 gboolean janus_ice_is_ice_tcp_enabled(void);
@@ -208,6 +236,14 @@ void janus_set_twcc_period(uint period);
 /*! \brief Method to get the current TWCC period (see above)
  * @returns The current TWCC period */
 uint janus_get_twcc_period(void);
+/*! \brief Method to enable pacing of the outgoing video, which is disabled by default: when
+ * enabled, video packets are queued and released at a rate that's the multiplier applied to
+ * the estimated bandwidth (if available) or to the bitrate of the video being sent
+ * @param[in] multiplier The multiplier to use for the pacing rate (0 to disable) */
+void janus_set_pacing_multiplier(double multiplier);
+/*! \brief Method to get the current pacing multiplier (see above)
+ * @returns The current pacing multiplier (0 if pacing is disabled) */
+double janus_get_pacing_multiplier(void);
 /*! \brief Method to modify the DSCP value to set, which is disabled by default
  * @param[in] dscp The new DSCP value (0 to disable) */
 void janus_set_dscp(int dscp);
@@ -326,21 +362,48 @@ void janus_ice_notify_hangup(janus_ice_handle *handle, const char *reason);
 gboolean janus_plugin_session_is_alive(janus_plugin_session *plugin_session);
 
 
-/*! \brief A helper struct for determining when to send NACKs */
-typedef struct janus_seq_info {
-	gint64 ts;
-	guint16 seq;
-	guint16 state;
-	struct janus_seq_info *next;
-	struct janus_seq_info *prev;
-} janus_seq_info;
-void janus_seq_list_free(janus_seq_info **head);
+/*! \brief Number of slots in the window of recently received sequence numbers (must be a power of two, and not smaller than LAST_SEQS_MAX_LEN) */
+#define JANUS_SEQ_WINDOW_SIZE	256
+/*! \brief A helper struct for determining when to send NACKs: a fixed
+ * size window of the most recent sequence numbers, indexed by the
+ * sequence number itself, with the state of each of them */
+typedef struct janus_seq_window {
+	/*! \brief Oldest sequence number we're tracking */
+	guint16 head;
+	/*! \brief How many sequence numbers we're tracking (up to LAST_SEQS_MAX_LEN) */
+	guint16 count;
+	/*! \brief How many of the tracked sequence numbers are still missing or NACKed */
+	guint16 missing;
+	/*! \brief State of each sequence number */
+	guint8 state[JANUS_SEQ_WINDOW_SIZE];
+	/*! \brief When each sequence number was first tracked */
+	gint64 ts[JANUS_SEQ_WINDOW_SIZE];
+} janus_seq_window;
+/*! \brief Helper method to reset a window of recently received sequence numbers
+ * @param[in] window The janus_seq_window instance to reset */
+void janus_seq_window_reset(janus_seq_window *window);
 enum {
 	SEQ_MISSING,
 	SEQ_NACKED,
 	SEQ_GIVEUP,
 	SEQ_RECVED
 };
+/*! \brief Number of slots in the map of NACKed sequence numbers (must be a power of two) */
+#define JANUS_SEQ_NACKED_SIZE	1024
+/*! \brief A helper struct to keep track of the packets we NACKed, and
+ * whether a retransmission arrived already, in order to detect duplicates:
+ * entries expire on their own after a few seconds, or when the slot is
+ * reused by a more recent sequence number */
+typedef struct janus_seq_nacked {
+	struct {
+		/*! \brief When the packet was NACKed */
+		gint64 ts;
+		/*! \brief Sequence number of the NACKed packet */
+		guint16 seq;
+		/*! \brief 1 if we NACKed the packet, 2 if we received the retransmission too */
+		guint8 state;
+	} packets[JANUS_SEQ_NACKED_SIZE];
+} janus_seq_nacked;
 
 
 /*! \brief Janus ICE handle */
@@ -369,12 +432,21 @@ struct janus_ice_handle {
 	GMainLoop *mainloop;
 	/*! \brief In case static event loops are used, opaque pointer to the loop */
 	void *static_event_loop;
+	/*! \brief In case static event loops are used, packets this handle sent and received on its loop */
+	guint64 loop_packets;
+	/*! \brief Value of loop_packets when the loops rebalancer last checked, and when that happened */
+	guint64 loop_packets_snapshot;
+	gint64 loop_snapshot_time;
 	/*! \brief GLib thread for the handle and libnice */
 	GThread *thread;
 	/*! \brief GLib sources for outgoing traffic, recurring RTCP, and stats (and optionally TWCC) */
 	GSource *rtp_source, *rtcp_source, *stats_source, *twcc_source;
+	/*! \brief Timers for recurring RTCP, stats and TWCC, used instead of the sources above when the handle is on a static loop */
+	janus_timer rtcp_timer, stats_timer, twcc_timer;
 	/*! \brief libnice ICE agent */
 	NiceAgent *agent;
+	/*! \brief Context the ICE agent was created with, and so emits its signals on, which is not migrated with the handle */
+	GMainContext *agent_mainctx;
 	/*! \brief Monotonic time of when the ICE agent has been created */
 	gint64 agent_created;
 	/*! \brief Monotonic time of when the ICE agent has been started (remote credentials set) */
@@ -423,6 +495,28 @@ struct janus_ice_handle {
 	janus_refcount ref;
 };
 
+/*! \brief Snapshot of the bandwidth estimation and pacer state of a PeerConnection
+ * @note The estimator and the pacer are only ever touched by the loop of the handle:
+ * the loop refreshes this snapshot once per second, and that's all the Admin API reads */
+typedef struct janus_ice_peerconnection_bwe_snapshot {
+	/*! \brief Whether we're estimating the bandwidth, and whether we're pacing */
+	gboolean bwe, pacer;
+	/*! \brief Current estimate, and bitrate the peer is actually receiving, in bits per second */
+	uint32_t estimate, acked_bitrate;
+	/*! \brief Status of the delay-based detector */
+	janus_bwe_status status;
+	/*! \brief Smoothed loss ratio */
+	double loss;
+	/*! \brief Rate we're pacing at, in bits per second */
+	uint32_t rate;
+	/*! \brief Packets and bytes waiting in the pacer queue */
+	guint queued_packets;
+	guint32 queued_bytes;
+	/*! \brief Number of queue delay samples, and their percentiles in microseconds */
+	guint delay_samples;
+	guint32 delay_p50, delay_p95, delay_p99;
+} janus_ice_peerconnection_bwe_snapshot;
+
 /*! \brief Janus handle WebRTC PeerConnection */
 struct janus_ice_peerconnection {
 	/*! \brief Janus ICE handle this stream belongs to */
@@ -457,6 +551,8 @@ struct janus_ice_peerconnection {
 	GSource *dtlsrt_source;
 	/*! \brief DTLS-SRTP stack */
 	janus_dtls_srtp *dtls;
+	/*! \brief In case single-port mode is used, opaque pointer to the shared socket mapping */
+	void *mux;
 	/*! \brief SDES mid RTP extension ID */
 	gint mid_ext_id;
 	/*! \brief RTP Stream extension ID, and the related rtx one */
@@ -479,20 +575,28 @@ struct janus_ice_peerconnection {
 	gboolean do_transport_wide_cc;
 	/*! \brief Transport wide cc rtp ext ID */
 	gint transport_wide_cc_ext_id;
+	/*! \brief Map of the negotiated extension IDs, to parse incoming RTP extensions in a single pass */
+	janus_rtp_extension_map extmap;
+	/*! \brief Incremented any time the negotiated extension IDs change, to invalidate outgoing extension templates */
+	guint extmap_generation;
 	/*! \brief Last sent transport wide seq num */
 	guint16 transport_wide_cc_out_seq_num;
 	/*! \brief Last received transport wide seq num */
 	guint32 transport_wide_cc_last_seq_num;
-	/*! \brief Last transport wide seq num sent on feedback */
-	guint32 transport_wide_cc_last_feedback_seq_num;
 	/*! \brief Transport wide cc transport seq num wrap cycles */
 	guint16 transport_wide_cc_cycles;
 	/*! \brief Transport wide cc rtp ext ID */
 	guint transport_wide_cc_feedback_count;
-	/*! \brief GLib list of transport wide cc stats in reverse received order */
-	GSList *transport_wide_received_seq_nums;
+	/*! \brief Circular history of transport wide cc stats still to send feedback for */
+	janus_rtcp_transport_wide_cc_history *transport_wide_cc_history;
 	/*! \brief Latest REMB feedback we received */
 	uint32_t remb_bitrate;
+	/*! \brief Send-side bandwidth estimation, fed by the transport wide cc feedback we receive (only if the plugin is interested, or we're pacing) */
+	janus_bwe_context *bwe;
+	/*! \brief Pacer for the outgoing video, if pacing is enabled */
+	janus_pacer *pacer;
+	/*! \brief Snapshot of the estimator and pacer state for the Admin API (protected by the mutex) */
+	janus_ice_peerconnection_bwe_snapshot bwe_snapshot;
 	/*! \brief DTLS role of the server for this stream */
 	janus_dtls_role dtls_role;
 	/*! \brief Data exchanged for DTLS handshakes and messages */
@@ -524,8 +628,6 @@ struct janus_ice_peerconnection {
 	GHashTable *rtx_payload_types;
 	/*! \brief Reverse mapping of rtx payload types to actual media-related packet types */
 	GHashTable *rtx_payload_types_rev;
-	/*! \brief Helper queue for storing requested packets from NACKs */
-	GQueue *nacks_queue;
 	/*! \brief Helper flag to avoid flooding the console with the same error all over again */
 	gboolean noerrorlog;
 	/*! \brief Mutex to lock/unlock this stream */
@@ -537,6 +639,24 @@ struct janus_ice_peerconnection {
 };
 
 #define LAST_SEQS_MAX_LEN 160
+/*! \brief Outgoing RTP extensions that are the same for all the packets of a
+ * medium (abs-send-time, transport-wide CC and mid), compiled once in the
+ * format they'll be sent: when sending packets, only the abs-send-time and
+ * transport-wide CC values need to be filled in */
+typedef struct janus_ice_rtp_extension_template {
+	/*! \brief Whether this template has been compiled already */
+	gboolean compiled;
+	/*! \brief PeerConnection extmap generation this template was compiled for */
+	guint generation;
+	/*! \brief mid this template was compiled for */
+	const char *mid;
+	/*! \brief Extension elements, in 1-byte or 2-byte form (without the RFC5285 header) */
+	char data[32];
+	/*! \brief Size of the extension elements */
+	uint16_t len;
+	/*! \brief Offset of the abs-send-time and transport-wide CC values in data, -1 if missing */
+	int16_t abs_send_time_offset, transport_wide_cc_offset;
+} janus_ice_rtp_extension_template;
 /*! \brief A single media in a PeerConnection */
 struct janus_ice_peerconnection_medium {
 	/*! \brief WebRTC PeerConnection this m-line belongs to */
@@ -588,9 +708,7 @@ struct janus_ice_peerconnection_medium {
 	/*! \brief Size of the NACK queue (in ms), dynamically updated per the RTT */
 	uint16_t nack_queue_ms;
 	/*! \brief Map(s) of the NACKed packets (to track retransmissions and avoid duplicates) */
-	GHashTable *rtx_nacked[3];
-	/*! \brief Map of the pending NACKed cleanup callback */
-	GHashTable *pending_nacked_cleanup;
+	janus_seq_nacked *rtx_nacked[3];
 	/*! \brief First received NTP timestamp */
 	gint64 first_ntp_ts[3];
 	/*! \brief First received RTP timestamp */
@@ -616,7 +734,9 @@ struct janus_ice_peerconnection_medium {
 	/*! \brief Number of NACKs sent since last log message */
 	guint nack_sent_recent_cnt;
 	/*! \brief List of recently received sequence numbers (as a support to NACK generation, for each simulcast SSRC) */
-	janus_seq_info *last_seqs[3];
+	janus_seq_window *last_seqs[3];
+	/*! \brief Outgoing RTP extension templates, in 1-byte (0) and 2-byte (1) form */
+	janus_ice_rtp_extension_template rtp_ext_template[2];
 	/*! \brief Stats for incoming data (audio/video/data) */
 	janus_ice_stats in_stats;
 	/*! \brief Stats for outgoing data (audio/video/data) */
@@ -699,6 +819,33 @@ void janus_ice_webrtc_hangup(janus_ice_handle *handle, const char *reason);
 /*! \brief Method to only free resources related to a specific Webrtc PeerConnection allocated by a Janus ICE handle
  * @param[in] pc The Janus ICE component instance to free */
 void janus_ice_peerconnection_destroy(janus_ice_peerconnection *pc);
+/*! \brief Method to send a packet on a PeerConnection, either via libnice or, in single-port mode, on the shared socket
+ * @param[in] pc The Janus ICE component instance to send the packet on
+ * @param[in] buf The packet to send
+ * @param[in] len The length of the packet
+ * @returns The number of bytes sent, or a negative integer in case of errors */
+int janus_ice_peerconnection_send(janus_ice_peerconnection *pc, const char *buf, int len);
+/*! \brief Method to hand the core a packet as if it had been received on a PeerConnection
+ * @note The packet is processed in the loop of the handle, exactly as those libnice
+ * gives us: this is used in single-port mode, and by tools that drive the media path
+ * without going through ICE (e.g., janus-loadgen)
+ * @param[in] handle The Janus ICE handle instance the packet is for
+ * @param[in] buf The packet, as received from the network
+ * @param[in] len The length of the packet */
+void janus_ice_incoming_packet(janus_ice_handle *handle, const char *buf, int len);
+/*! \brief Method to start the DTLS handshake of a PeerConnection whose connectivity was not established by libnice
+ * @note Only meant for tools that deliver packets with janus_ice_incoming_packet (e.g., janus-loadgen)
+ * @param[in] handle The Janus ICE handle instance whose PeerConnection is connected */
+void janus_ice_peerconnection_connected(janus_ice_handle *handle);
+/*! \brief Method to rebuild the map of negotiated RTP extensions of a WebRTC PeerConnection
+ * @note This must be invoked any time the extension IDs of the PeerConnection change
+ * @param[in] pc The Janus ICE PeerConnection instance to update */
+void janus_ice_peerconnection_update_extmap(janus_ice_peerconnection *pc);
+/*! \brief Method to get the latest snapshot of the bandwidth estimation and pacer state of a WebRTC PeerConnection
+ * @note This is safe to invoke from any thread, e.g., the Admin API one
+ * @param[in] pc The Janus ICE PeerConnection instance to query
+ * @param[out] snapshot The snapshot to fill in */
+void janus_ice_peerconnection_get_bwe_snapshot(janus_ice_peerconnection *pc, janus_ice_peerconnection_bwe_snapshot *snapshot);
 ///@}
 
 
@@ -794,6 +941,26 @@ void janus_ice_resend_trickles(janus_ice_handle *handle);
  * @param[in] loops The number of static event loops to start (0 to disable the feature)
  * @param[in] allow_api Whether allocation on a specific loop driven via API should be allowed or not (false by default) */
 void janus_ice_set_static_event_loops(int loops, gboolean allow_api);
+/*! \brief Method to pin the static event loop threads to specific CPUs
+ * @note This must be called before janus_ice_set_static_event_loops, and
+ * is currently only supported on Linux
+ * @param[in] cpus Comma separated list of CPUs and CPU ranges (e.g., "0-3,6"), loops are assigned to them in a round robin fashion */
+void janus_ice_set_static_event_loops_affinity(const char *cpus);
+/*! \brief Method to enable the automatic rebalancing of handles across static event loops
+ * @param[in] period How often to check whether loops are unbalanced, in seconds (0 disables the rebalancer)
+ * @param[in] threshold Difference in load between the busiest and the least busy loops, as a percentage
+ * of the load of the busiest one, above which a handle is migrated */
+void janus_ice_set_static_event_loops_rebalancing(guint period, guint threshold);
+/*! \brief Method to move a handle to a different static event loop
+ * \details The handle sources, and the reception of its media, are moved
+ * to the new loop. Notice that the ICE agent timers (e.g., keepalives)
+ * stay on the loop the agent was created on, as libnice doesn't allow
+ * changing them: for this reason, only handles with no PeerConnection or
+ * with a PeerConnection that is fully set up can be migrated.
+ * @param[in] handle The janus_ice_handle instance to migrate
+ * @param[in] loop_index Index of the static event loop to move the handle to
+ * @returns 0 in case of success, a negative integer otherwise */
+int janus_ice_handle_migrate(janus_ice_handle *handle, int loop_index);
 /*! \brief Method to return the number of static event loops, if enabled
  * @returns The number of static event loops, if configured, or 0 if the feature is disabled */
 int janus_ice_get_static_event_loops(void);
@@ -0,0 +1,2324 @@
+/*! \file    janus-loadgen.c
+ * \author   Lorenzo Miniero <lorenzo@meetecho.com>
+ * \copyright GNU General Public License v3
+ * \brief    Deterministic load generator for the Janus media path
+ * \details  Benchmarking Janus usually means using real browsers, which
+ * makes results hard to reproduce. This tool loads one of the media
+ * plugins (VideoRoom, AudioBridge or Streaming) in-process, together with
+ * the actual core media path, and plays the part of both the transport
+ * and the peers: it creates handles and PeerConnections through the ICE
+ * code exactly as the core does, negotiates them with the plugin, and
+ * then injects RTP packets generated on a fixed schedule (seeded, so that
+ * two runs generate exactly the same traffic).
+ *
+ * Only ICE and DTLS are skipped: once a PeerConnection is negotiated, its
+ * SRTP contexts are created with pseudo-random keys from the seed, and
+ * the PeerConnection is marked as ready as a completed DTLS handshake
+ * would. Packets the fake peers send are SRTP protected and delivered to
+ * the event loop of their handle as if libnice had received them, which
+ * means they go through the whole incoming path (SRTP, RTP extensions,
+ * NACKs, transport-wide CC, event loops and timers); everything the core
+ * sends is captured where it would be handed to libnice (\c nice_agent_send),
+ * where it's unprotected and accounted. Streaming mountpoints receive
+ * plain RTP over UDP on the loopback interface instead, as they would
+ * from an external source. Optionally, some video packets can be dropped
+ * on the way to the core and to subscribers, so that NACKs and
+ * retransmissions are exercised as well.
+ *
+ * At the end of the run the tool prints the throughput (in and out),
+ * the percentiles of the per-packet latency (from when a packet is
+ * generated to when the relayed copy is handed to libnice), the RTCP
+ * feedback the core sent, and the CPU usage of the process and of each
+ * core. Latency is not available for the AudioBridge, since what it
+ * sends is a mix and not a relayed packet. As the fake peers live in the
+ * same process, the CPU time spent generating and protecting their
+ * packets is measured and reported separately, so that it can be
+ * subtracted if needed.
+ *
+ * The tool needs the path to the plugin shared object, and the topology
+ * to create, e.g.:
+ *
+\verbatim
+./janus-loadgen -p /opt/janus/lib/janus/plugins/libjanus_videoroom.so -P 4 -S 20 -d 30 -L 4
+\endverbatim
+ *
+ * creates a VideoRoom with 4 publishers sending audio and video, and 20
+ * subscribers each receiving all of them, for 30 seconds, with handles
+ * spread across 4 static event loops. Use \c --help for a list of all
+ * the available options.
+ *
+ * The tool can also measure how many DataChannel messages per second the
+ * core can handle, in which case no plugin is needed: pairs of handles
+ * are created, whose PeerConnections perform a real DTLS handshake and
+ * establish SCTP associations with each other, and then exchange messages
+ * through the same path plugins use, optionally offloading the SCTP
+ * processing to workers as \c sctp_workers does, e.g.:
+ *
+\verbatim
+./janus-loadgen -c 1000 -t 4 -W 4 -d 30
+\endverbatim
+ *
+ * \ingroup tools
+ * \ref tools
+ */
+
+#include <arpa/inet.h>
+#include <dlfcn.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <jansson.h>
+
+#include "janus.h"
+#include "debug.h"
+#include "dtls.h"
+#include "ice.h"
+#include "mutex.h"
+#include "refcount.h"
+#include "rtcp.h"
+#include "rtp.h"
+#include "rtpsrtp.h"
+#include "sdp.h"
+#include "sdp-utils.h"
+#include "utils.h"
+#include "version.h"
+#include "plugins/plugin.h"
+#ifdef HAVE_SCTP
+#include "sctp.h"
+#endif
+
+int janus_log_level = LOG_WARN;
+gboolean janus_log_timestamps = FALSE;
+gboolean janus_log_colors = TRUE;
+char *janus_log_global_prefix = NULL;
+int lock_debug = 0;
+int refcount_debug = 0;
+
+static volatile gint working = 1, stopping = 0;
+
+/* Signal handler */
+static void janus_loadgen_handle_signal(int signum) {
+	g_atomic_int_set(&working, 0);
+}
+
+/* Supported command-line arguments */
+static const char *plugin_path = NULL;
+static const char *configs_folder = NULL;
+static int publishers = 1, subscribers = 1, feeds = 0, duration = 10, threads = 1;
+static int video_bitrate = 1000, video_fps = 30, keyframe_interval = 2;
+static double speed = 1.0;
+static gint64 seed = 1;
+static gboolean no_video = FALSE, no_srtp = FALSE, json_output = FALSE;
+static int event_loops = 0, loss = 0;
+static int negotiations = 0;
+static int datachannels = 0, sctp_workers = 0, message_size = 256;
+static int log_level = LOG_WARN;
+static GOptionEntry opt_entries[] = {
+	{ "plugin", 'p', 0, G_OPTION_ARG_STRING, &plugin_path, "Path to the plugin shared object to load (VideoRoom, AudioBridge or Streaming)", "path" },
+	{ "configs-folder", 'F', 0, G_OPTION_ARG_STRING, &configs_folder, "Folder to look for the plugin configuration file in (default: none, plugin defaults are used)", "path" },
+	{ "publishers", 'P', 0, G_OPTION_ARG_INT, &publishers, "Number of publishers (AudioBridge: talking participants; Streaming: mountpoints), default=1", "number" },
+	{ "subscribers", 'S', 0, G_OPTION_ARG_INT, &subscribers, "Number of subscribers (AudioBridge: muted participants; Streaming: viewers), default=1", "number" },
+	{ "feeds", 'f', 0, G_OPTION_ARG_INT, &feeds, "VideoRoom only: publishers each subscriber receives (default=0, all of them)", "number" },
+	{ "duration", 'd', 0, G_OPTION_ARG_INT, &duration, "Duration of the test, in seconds (default=10)", "seconds" },
+	{ "threads", 't', 0, G_OPTION_ARG_INT, &threads, "Number of threads injecting the publishers' packets (DataChannels: sending messages), default=1", "number" },
+	{ "event-loops", 'L', 0, G_OPTION_ARG_INT, &event_loops, "Number of static event loops to spread handles across, as event_loops does (default=0, a thread per handle)", "number" },
+	{ "video-bitrate", 'b', 0, G_OPTION_ARG_INT, &video_bitrate, "Bitrate of the video publishers send, in kbps (default=1000)", "kbps" },
+	{ "video-fps", 'r', 0, G_OPTION_ARG_INT, &video_fps, "Frame rate of the video publishers send (default=30)", "fps" },
+	{ "keyframe-interval", 'k', 0, G_OPTION_ARG_INT, &keyframe_interval, "Seconds between video keyframes (default=2)", "seconds" },
+	{ "no-video", 'a', 0, G_OPTION_ARG_NONE, &no_video, "Only send audio (always the case for the AudioBridge)", NULL },
+	{ "loss", 'l', 0, G_OPTION_ARG_INT, &loss, "Percentage of video packets to drop on the way to the core and to subscribers, to exercise NACKs and retransmissions (default=0)", "percent" },
+	{ "speed", 'x', 0, G_OPTION_ARG_DOUBLE, &speed, "Send packets this many times faster than real-time (default=1.0)", "factor" },
+	{ "seed", 's', 0, G_OPTION_ARG_INT64, &seed, "Seed for the generated traffic and SRTP keys (default=1)", "number" },
+	{ "no-srtp", 'n', 0, G_OPTION_ARG_NONE, &no_srtp, "Don't SRTP protect/unprotect packets (as with -e in Janus)", NULL },
+	{ "negotiations", 'N', 0, G_OPTION_ARG_INT, &negotiations, "VideoRoom only: instead of sending media, measure how many publisher renegotiations per second (3 and 30 m-lines) the plugin can handle, with and without parsed SDPs (default=0, disabled)", "number" },
+	{ "datachannels", 'c', 0, G_OPTION_ARG_INT, &datachannels, "Instead of loading a plugin, measure how many DataChannel messages per second this many PeerConnections (in pairs talking to each other) can exchange (default=0, disabled)", "number" },
+	{ "sctp-workers", 'W', 0, G_OPTION_ARG_INT, &sctp_workers, "DataChannels only: number of workers to offload SCTP processing to (default=0, done by the event loops)", "number" },
+	{ "message-size", 'z', 0, G_OPTION_ARG_INT, &message_size, "DataChannels only: size of the messages to send, in bytes (default=256)", "bytes" },
+	{ "json", 'j', 0, G_OPTION_ARG_NONE, &json_output, "Print the results as JSON", NULL },
+	{ "debug-level", 'D', 0, G_OPTION_ARG_INT, &log_level, "Debug/logging level (0=disable debugging, 7=maximum debug level; default=3)", "level" },
+	{ NULL, 0, 0, 0, NULL, NULL, NULL },
+};
+
+/* Scenarios we support */
+typedef enum janus_loadgen_scenario {
+	janus_loadgen_videoroom = 0,
+	janus_loadgen_audiobridge,
+	janus_loadgen_streaming,
+} janus_loadgen_scenario;
+static janus_loadgen_scenario scenario = janus_loadgen_videoroom;
+static janus_plugin *plugin = NULL;
+
+/* Payload types, extension IDs and timing we use for what we generate */
+#define LOADGEN_AUDIO_PT		111
+#define LOADGEN_VIDEO_PT		96
+#define LOADGEN_AUDIO_LEVEL_ID	1
+#define LOADGEN_MID_ID			2
+#define LOADGEN_TWCC_ID			3
+#define LOADGEN_AUDIO_PTIME		20000
+#define LOADGEN_MAX_PAYLOAD		1200
+#define LOADGEN_TIMEOUT			5*G_USEC_PER_SEC
+/* Generated packets are tagged, so that we can compute the latency when we see them again */
+#define LOADGEN_TAG_MAGIC		0x4a4c4730	/* "JLG0" */
+#define LOADGEN_TAG_SIZE		12
+/* Our fake peers don't do ICE, but the core still expects credentials in their SDPs */
+#define LOADGEN_ICE_UFRAG		"loadgen"
+#define LOADGEN_ICE_PWD			"janusloadgenjanusloadgen"
+/* Key we use to find our own data in the libnice agents the core creates */
+#define LOADGEN_AGENT_KEY		"janus-loadgen"
+
+/* Fake core session all handles belong to */
+static janus_session *session = NULL;
+
+/* Fake peer, on the other side of a PeerConnection */
+typedef struct janus_loadgen_peer {
+	/* Peer index, and whether it's sending media */
+	int index;
+	gboolean publisher;
+	/* Handle the core created for this peer */
+	janus_ice_handle *handle;
+	/* ID the plugin assigned to the participant, if any */
+	json_t *id;
+	/* Transaction we're waiting for a response to, and the events we got back */
+	char *transaction;
+	GAsyncQueue *events;
+	/* SRTP keys for what the peer sends and receives, and the peer's own contexts */
+	unsigned char in_key[SRTP_MASTER_LENGTH], out_key[SRTP_MASTER_LENGTH];
+	srtp_t srtp_out, srtp_in;
+	/* Streaming only: where the mountpoint we feed expects packets */
+	struct sockaddr_in audio_addr, video_addr;
+	/* Generation state (only used by the injecting thread) */
+	GRand *rand;
+	uint32_t ssrc[2], timestamp[2];
+	uint16_t seq[2], twcc_seq;
+	gint64 next_audio, next_video;
+	guint32 frames;
+	gboolean talking;
+	int talkspurt;
+	/* Video and rtx payload types the core sends us, as negotiated */
+	int video_pt, rtx_pt;
+	/* Generation stats (only updated by the injecting thread) */
+	guint64 packets_in, bytes_in, errors_in, dropped_in;
+	/* Capture state and stats (updated by the event loop of the handle) */
+	janus_mutex mutex;
+	GRand *loss_rand;
+	guint64 packets_out, bytes_out, errors_out, rtx_out, lost_out, rtcp_out, plis, nacks, twcc;
+	GArray *latencies;
+} janus_loadgen_peer;
+static janus_loadgen_peer **peers = NULL;
+static int peers_num = 0;
+static GHashTable *peers_byhandle = NULL;
+static janus_mutex peers_mutex = JANUS_MUTEX_INITIALIZER;
+static int udp_fd = -1;
+
+/* Injecting threads, and the CPU time they spent being peers rather than the core */
+typedef struct janus_loadgen_thread {
+	int index;
+	GThread *thread;
+	gint64 peer_cpu;
+} janus_loadgen_thread;
+
+
+/* Core methods the ICE code expects janus.c to provide */
+void janus_session_notify_event(janus_session *session, json_t *event) {
+	/* There's no transport to send events to */
+	json_decref(event);
+}
+
+janus_ice_handle *janus_session_handles_find(janus_session *session, guint64 handle_id) {
+	if(session == NULL)
+		return NULL;
+	janus_mutex_lock(&session->mutex);
+	janus_ice_handle *handle = session->ice_handles ?
+		g_hash_table_lookup(session->ice_handles, &handle_id) : NULL;
+	if(handle != NULL)
+		janus_refcount_increase(&handle->ref);
+	janus_mutex_unlock(&session->mutex);
+	return handle;
+}
+
+static void janus_loadgen_handle_dereference(janus_ice_handle *handle) {
+	if(handle)
+		janus_refcount_decrease(&handle->ref);
+}
+
+void janus_session_handles_insert(janus_session *session, janus_ice_handle *handle) {
+	janus_mutex_lock(&session->mutex);
+	if(session->ice_handles == NULL)
+		session->ice_handles = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+			(GDestroyNotify)g_free, (GDestroyNotify)janus_loadgen_handle_dereference);
+	janus_refcount_increase(&handle->ref);
+	g_hash_table_insert(session->ice_handles, janus_uint64_dup(handle->handle_id), handle);
+	janus_mutex_unlock(&session->mutex);
+}
+
+gchar *janus_get_public_ip(guint index) {
+	return (char *)"127.0.0.1";
+}
+
+guint janus_get_public_ip_count(void) {
+	return 0;
+}
+
+void janus_add_public_ip(const char *ip) {
+	/* We never advertise public addresses */
+}
+
+gboolean janus_has_public_ipv4_ip(void) {
+	return FALSE;
+}
+
+gboolean janus_has_public_ipv6_ip(void) {
+	return FALSE;
+}
+
+gint janus_is_stopping(void) {
+	return g_atomic_int_get(&stopping);
+}
+
+gboolean janus_is_webrtc_encryption_enabled(void) {
+	return !no_srtp;
+}
+
+/* Helpers to create and get rid of handles, mirroring what janus.c does */
+static void janus_loadgen_session_free(const janus_refcount *session_ref) {
+	janus_session *session = janus_refcount_containerof(session_ref, janus_session, ref);
+	if(session->ice_handles != NULL)
+		g_hash_table_destroy(session->ice_handles);
+	g_free(session);
+}
+
+static janus_ice_handle *janus_loadgen_handle_create(janus_plugin *p) {
+	janus_ice_handle *handle = janus_ice_handle_create(session, NULL, NULL);
+	if(handle == NULL)
+		return NULL;
+	/* As the core does, we keep a reference while we use the handle */
+	janus_refcount_increase(&handle->ref);
+	if(janus_ice_handle_attach_plugin(session, handle, p, -1) != 0) {
+		janus_refcount_decrease(&handle->ref);
+		return NULL;
+	}
+	return handle;
+}
+
+static void janus_loadgen_handle_remove(janus_ice_handle *handle) {
+	janus_mutex_lock(&session->mutex);
+	janus_ice_handle_destroy(session, handle);
+	g_hash_table_remove(session->ice_handles, &handle->handle_id);
+	janus_mutex_unlock(&session->mutex);
+}
+
+/* Helper to get the handle a plugin session belongs to, if it can still be used, as the core does */
+static janus_ice_handle *janus_loadgen_handle_get(janus_plugin_session *plugin_session) {
+	if(plugin_session == NULL || g_atomic_int_get(&plugin_session->stopped))
+		return NULL;
+	janus_ice_handle *handle = (janus_ice_handle *)plugin_session->gateway_handle;
+	if(handle == NULL || janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_STOP)
+			|| janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_ALERT))
+		return NULL;
+	return handle;
+}
+
+static janus_loadgen_peer *janus_loadgen_peer_find(janus_plugin_session *plugin_session) {
+	if(plugin_session == NULL)
+		return NULL;
+	janus_mutex_lock(&peers_mutex);
+	janus_loadgen_peer *peer = peers_byhandle ? g_hash_table_lookup(peers_byhandle, plugin_session->gateway_handle) : NULL;
+	janus_mutex_unlock(&peers_mutex);
+	return peer;
+}
+
+
+/* SDP processing, as janus.c does it for what peers and plugins send */
+static void janus_loadgen_update_extmaps(janus_ice_peerconnection *pc, janus_sdp *sdp, gboolean offer) {
+	if(pc == NULL)
+		return;
+	/* Offers set the IDs of the extensions, answers disable the ones that were rejected */
+	int mid = 0, rid = 0, ridrtx = 0, twcc = 0, dd = 0, abs_send_time = 0, abs_capture_time = 0,
+		audiolevel = 0, videoorientation = 0, playoutdelay = 0, videolayers = 0;
+	GList *temp = sdp->m_lines;
+	while(temp) {
+		janus_sdp_mline *m = (janus_sdp_mline *)temp->data;
+		GList *tempA = m->attributes;
+		while(tempA) {
+			janus_sdp_attribute *a = (janus_sdp_attribute *)tempA->data;
+			if(a->name && a->value && !strcasecmp(a->name, "extmap")) {
+				int id = atoi(a->value);
+				if(strstr(a->value, JANUS_RTP_EXTMAP_MID))
+					mid = id;
+				else if(strstr(a->value, JANUS_RTP_EXTMAP_REPAIRED_RID))
+					ridrtx = id;
+				else if(strstr(a->value, JANUS_RTP_EXTMAP_RID))
+					rid = id;
+				else if(strstr(a->value, JANUS_RTP_EXTMAP_TRANSPORT_WIDE_CC))
+					twcc = id;
+				else if(strstr(a->value, JANUS_RTP_EXTMAP_DEPENDENCY_DESC))
+					dd = id;
+				else if(strstr(a->value, JANUS_RTP_EXTMAP_ABS_SEND_TIME))
+					abs_send_time = id;
+				else if(strstr(a->value, JANUS_RTP_EXTMAP_ABS_CAPTURE_TIME))
+					abs_capture_time = id;
+				else if(strstr(a->value, JANUS_RTP_EXTMAP_AUDIO_LEVEL))
+					audiolevel = id;
+				else if(strstr(a->value, JANUS_RTP_EXTMAP_VIDEO_ORIENTATION))
+					videoorientation = id;
+				else if(strstr(a->value, JANUS_RTP_EXTMAP_PLAYOUT_DELAY))
+					playoutdelay = id;
+				else if(strstr(a->value, JANUS_RTP_EXTMAP_VIDEO_LAYERS))
+					videolayers = id;
+			}
+			tempA = tempA->next;
+		}
+		temp = temp->next;
+	}
+	if(offer) {
+		pc->mid_ext_id = mid;
+		pc->rid_ext_id = rid;
+		pc->ridrtx_ext_id = ridrtx;
+		pc->audiolevel_ext_id = audiolevel;
+		pc->videoorientation_ext_id = videoorientation;
+		pc->playoutdelay_ext_id = playoutdelay;
+		pc->abs_send_time_ext_id = abs_send_time;
+		pc->abs_capture_time_ext_id = abs_capture_time;
+		pc->videolayers_ext_id = videolayers;
+		pc->do_transport_wide_cc = twcc > 0;
+		pc->transport_wide_cc_ext_id = twcc;
+		pc->dependencydesc_ext_id = dd;
+		return;
+	}
+	if(mid == 0)
+		pc->mid_ext_id = 0;
+	if(twcc == 0) {
+		pc->do_transport_wide_cc = FALSE;
+		pc->transport_wide_cc_ext_id = 0;
+	}
+	if(dd == 0)
+		pc->dependencydesc_ext_id = 0;
+	if(abs_send_time == 0)
+		pc->abs_send_time_ext_id = 0;
+	if(abs_capture_time == 0)
+		pc->abs_capture_time_ext_id = 0;
+	if(videolayers == 0)
+		pc->videolayers_ext_id = 0;
+}
+
+/* Helper to have the core associate the libnice agent it created for a handle with its peer */
+static void janus_loadgen_peer_bind(janus_loadgen_peer *peer) {
+	if(peer->handle->agent != NULL)
+		g_object_set_data(G_OBJECT(peer->handle->agent), LOADGEN_AGENT_KEY, peer);
+}
+
+/* What the core does when a peer sends an SDP: returns the SDP to pass to the plugin */
+static janus_sdp *janus_loadgen_remote_sdp(janus_loadgen_peer *peer, const char *type, const char *text, gboolean *update) {
+	janus_ice_handle *handle = peer->handle;
+	gboolean renegotiation = janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_NEGOTIATED);
+	gboolean offer = !strcasecmp(type, "offer");
+	janus_mutex_lock(&handle->mutex);
+	if(offer) {
+		janus_flags_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_PROCESSING_OFFER);
+		janus_flags_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_GOT_OFFER);
+		janus_flags_clear(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_GOT_ANSWER);
+	} else {
+		janus_flags_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_GOT_ANSWER);
+		if(janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_GOT_OFFER))
+			janus_flags_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_NEGOTIATED);
+	}
+	char error_str[512];
+	error_str[0] = '\0';
+	janus_dtls_role peer_dtls_role = JANUS_DTLS_ROLE_ACTPASS;
+	int audio = 0, video = 0, data = 0;
+	janus_sdp *parsed = janus_sdp_preparse(handle, text, error_str, sizeof(error_str),
+		(offer && !renegotiation ? &peer_dtls_role : NULL), &audio, &video, &data);
+	if(parsed == NULL) {
+		JANUS_LOG(LOG_ERR, "Invalid SDP from peer #%d: %s\n", peer->index, error_str);
+		goto error;
+	}
+	if(!renegotiation && offer) {
+		janus_dtls_role dtls_role = (peer_dtls_role == JANUS_DTLS_ROLE_CLIENT) ? JANUS_DTLS_ROLE_SERVER : JANUS_DTLS_ROLE_CLIENT;
+		if(janus_ice_setup_local(handle, TRUE, TRUE, dtls_role) < 0) {
+			JANUS_LOG(LOG_ERR, "Error setting ICE locally for peer #%d\n", peer->index);
+			goto error;
+		}
+		janus_loadgen_peer_bind(peer);
+	} else if(!renegotiation && handle->agent == NULL) {
+		JANUS_LOG(LOG_ERR, "Unexpected answer from peer #%d\n", peer->index);
+		goto error;
+	}
+	if(janus_sdp_process_remote(handle, parsed, TRUE, renegotiation) < 0) {
+		JANUS_LOG(LOG_ERR, "Error processing the SDP of peer #%d\n", peer->index);
+		goto error;
+	}
+	/* There are no candidates to wait for, which is what handling the answer would be about */
+	if(!offer && !renegotiation)
+		janus_flags_clear(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_PROCESSING_OFFER);
+	if(offer || !renegotiation)
+		janus_loadgen_update_extmaps(handle->pc, parsed, offer);
+	janus_ice_peerconnection_update_extmap(handle->pc);
+	char *tmp = handle->remote_sdp;
+	handle->remote_sdp = g_strdup(text);
+	g_free(tmp);
+	janus_mutex_unlock(&handle->mutex);
+	if(janus_sdp_anonymize(parsed) < 0) {
+		janus_sdp_destroy(parsed);
+		janus_flags_clear(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_PROCESSING_OFFER);
+		return NULL;
+	}
+	janus_flags_clear(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_PROCESSING_OFFER);
+	*update = renegotiation;
+	return parsed;
+
+error:
+	janus_sdp_destroy(parsed);
+	janus_flags_clear(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_PROCESSING_OFFER);
+	janus_mutex_unlock(&handle->mutex);
+	return NULL;
+}
+
+/* What the core does when a plugin sends an SDP: returns the SDP to send to the peer */
+static char *janus_loadgen_local_sdp(janus_loadgen_peer *peer, const char *type, janus_sdp *sdp) {
+	janus_ice_handle *handle = peer->handle;
+	gboolean offer = !strcasecmp(type, "offer");
+	if(offer) {
+		janus_flags_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_GOT_OFFER);
+		janus_flags_clear(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_GOT_ANSWER);
+	} else {
+		janus_flags_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_GOT_ANSWER);
+		if(janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_GOT_OFFER))
+			janus_flags_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_NEGOTIATED);
+	}
+	int audio = 0, video = 0, data = 0;
+	if(janus_sdp_preparse_parsed(handle, sdp, NULL, &audio, &video, &data) < 0) {
+		JANUS_LOG(LOG_ERR, "Invalid SDP from the plugin (peer #%d)\n", peer->index);
+		return NULL;
+	}
+	gboolean updating = FALSE;
+	janus_mutex_lock(&handle->mutex);
+	if(offer && handle->agent == NULL) {
+		/* Negotiate RFC4588 by default, as the core does */
+		janus_flags_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_RFC4588_RTX);
+		if(janus_ice_setup_local(handle, FALSE, TRUE, JANUS_DTLS_ROLE_ACTPASS) < 0 ||
+				janus_sdp_process_local(handle, sdp, FALSE) < 0) {
+			JANUS_LOG(LOG_ERR, "Error processing the plugin SDP (peer #%d)\n", peer->index);
+			janus_mutex_unlock(&handle->mutex);
+			return NULL;
+		}
+		janus_loadgen_peer_bind(peer);
+	} else if(offer) {
+		updating = TRUE;
+		if(handle->pc && janus_sdp_process_local(handle, sdp, TRUE) < 0) {
+			JANUS_LOG(LOG_ERR, "Error processing the plugin SDP (peer #%d)\n", peer->index);
+			janus_mutex_unlock(&handle->mutex);
+			return NULL;
+		}
+	}
+	janus_loadgen_update_extmaps(handle->pc, sdp, offer);
+	janus_ice_peerconnection_update_extmap(handle->pc);
+	janus_mutex_unlock(&handle->mutex);
+	if(janus_sdp_anonymize(sdp) < 0)
+		return NULL;
+	janus_mutex_lock(&handle->mutex);
+	janus_ice_peerconnection *pc = handle->pc;
+	if(pc == NULL) {
+		janus_mutex_unlock(&handle->mutex);
+		return NULL;
+	}
+	/* Keep track of the payload types, and pick the ones for rtx if needed */
+	if(pc->payload_types == NULL)
+		pc->payload_types = g_hash_table_new(NULL, NULL);
+	janus_ice_peerconnection_medium *medium = NULL;
+	uint mi = 0;
+	for(mi=0; mi<g_hash_table_size(pc->media); mi++) {
+		medium = g_hash_table_lookup(pc->media, GUINT_TO_POINTER(mi));
+		janus_sdp_mline *m = medium ? janus_sdp_mline_find_by_index(sdp, medium->mindex) : NULL;
+		if(m == NULL || medium->type == JANUS_MEDIA_DATA)
+			continue;
+		GList *tpt = m->ptypes;
+		while(tpt) {
+			g_hash_table_insert(pc->payload_types, tpt->data, tpt->data);
+			tpt = tpt->next;
+		}
+	}
+	for(mi=0; mi<g_hash_table_size(pc->media); mi++) {
+		medium = g_hash_table_lookup(pc->media, GUINT_TO_POINTER(mi));
+		if(medium == NULL || medium->type != JANUS_MEDIA_VIDEO || medium->rtx_payload_types != NULL ||
+				!janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_RFC4588_RTX))
+			continue;
+		janus_sdp_mline *m = janus_sdp_mline_find_by_index(sdp, medium->mindex);
+		if(m == NULL || m->ptypes == NULL)
+			continue;
+		medium->rtx_payload_types = g_hash_table_new(NULL, NULL);
+		if(pc->rtx_payload_types == NULL)
+			pc->rtx_payload_types = g_hash_table_new(NULL, NULL);
+		if(pc->rtx_payload_types_rev == NULL)
+			pc->rtx_payload_types_rev = g_hash_table_new(NULL, NULL);
+		GList *ptypes = m->ptypes;
+		while(ptypes) {
+			int ptype = GPOINTER_TO_INT(ptypes->data);
+			ptypes = ptypes->next;
+			if(g_hash_table_lookup(pc->rtx_payload_types_rev, GINT_TO_POINTER(ptype)))
+				continue;
+			int rtx_ptype = GPOINTER_TO_INT(g_hash_table_lookup(pc->rtx_payload_types, GINT_TO_POINTER(ptype)));
+			if(rtx_ptype == 0) {
+				rtx_ptype = ptype+1;
+				if(rtx_ptype > 127)
+					rtx_ptype = 96;
+				while(g_hash_table_lookup(pc->payload_types, GINT_TO_POINTER(rtx_ptype)) ||
+						g_hash_table_lookup(pc->rtx_payload_types_rev, GINT_TO_POINTER(rtx_ptype))) {
+					rtx_ptype++;
+					if(rtx_ptype > 127)
+						rtx_ptype = 96;
+					if(rtx_ptype == ptype) {
+						rtx_ptype = -1;
+						break;
+					}
+				}
+			}
+			if(rtx_ptype > 0) {
+				g_hash_table_insert(pc->payload_types, GINT_TO_POINTER(rtx_ptype), GINT_TO_POINTER(rtx_ptype));
+				g_hash_table_insert(pc->rtx_payload_types, GINT_TO_POINTER(ptype), GINT_TO_POINTER(rtx_ptype));
+				g_hash_table_insert(pc->rtx_payload_types_rev, GINT_TO_POINTER(rtx_ptype), GINT_TO_POINTER(ptype));
+				g_hash_table_insert(medium->rtx_payload_types, GINT_TO_POINTER(ptype), GINT_TO_POINTER(rtx_ptype));
+			}
+			medium->do_nacks = TRUE;
+		}
+	}
+	char *merged = janus_sdp_merge(handle, sdp, offer);
+	if(merged == NULL) {
+		JANUS_LOG(LOG_ERR, "Error merging the plugin SDP (peer #%d)\n", peer->index);
+		janus_mutex_unlock(&handle->mutex);
+		return NULL;
+	}
+	if(!updating) {
+		if(offer)
+			janus_flags_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_PROCESSING_OFFER);
+		else
+			janus_flags_clear(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_PROCESSING_OFFER);
+	}
+	char *tmp = handle->local_sdp;
+	handle->local_sdp = g_strdup(merged);
+	janus_mutex_unlock(&handle->mutex);
+	g_free(tmp);
+	return merged;
+}
+
+
+/* Plugin callbacks */
+static int janus_loadgen_push_event(janus_plugin_session *handle, janus_plugin *p, const char *transaction, json_t *message, json_t *jsep);
+static int janus_loadgen_push_event_sdp(janus_plugin_session *handle, janus_plugin *p, const char *transaction, json_t *message, json_t *jsep, janus_sdp *sdp);
+static void janus_loadgen_relay_rtp(janus_plugin_session *handle, janus_plugin_rtp *packet);
+static void janus_loadgen_relay_rtcp(janus_plugin_session *handle, janus_plugin_rtcp *packet);
+static void janus_loadgen_relay_data(janus_plugin_session *handle, janus_plugin_data *packet);
+static void janus_loadgen_send_pli(janus_plugin_session *handle);
+static void janus_loadgen_send_pli_stream(janus_plugin_session *handle, int mindex);
+static void janus_loadgen_send_remb(janus_plugin_session *handle, guint32 bitrate);
+static void janus_loadgen_close_pc(janus_plugin_session *handle);
+static void janus_loadgen_end_session(janus_plugin_session *handle);
+static gboolean janus_loadgen_events_is_enabled(void);
+static void janus_loadgen_notify_event(janus_plugin *p, janus_plugin_session *handle, json_t *event);
+static gboolean janus_loadgen_auth_is_signed(void);
+static gboolean janus_loadgen_auth_is_signature_valid(janus_plugin *p, const char *token);
+static gboolean janus_loadgen_auth_signature_contains(janus_plugin *p, const char *token, const char *descriptor);
+static janus_callbacks janus_loadgen_callbacks =
+	{
+		.push_event = janus_loadgen_push_event,
+		.push_event_sdp = janus_loadgen_push_event_sdp,
+		.relay_rtp = janus_loadgen_relay_rtp,
+		.relay_rtcp = janus_loadgen_relay_rtcp,
+		.relay_data = janus_loadgen_relay_data,
+		.send_pli = janus_loadgen_send_pli,
+		.send_pli_stream = janus_loadgen_send_pli_stream,
+		.send_remb = janus_loadgen_send_remb,
+		.close_pc = janus_loadgen_close_pc,
+		.end_session = janus_loadgen_end_session,
+		.events_is_enabled = janus_loadgen_events_is_enabled,
+		.notify_event = janus_loadgen_notify_event,
+		.auth_is_signed = janus_loadgen_auth_is_signed,
+		.auth_is_signature_valid = janus_loadgen_auth_is_signature_valid,
+		.auth_signature_contains = janus_loadgen_auth_signature_contains,
+	};
+
+static int janus_loadgen_push_event_internal(janus_plugin_session *handle, const char *transaction,
+		json_t *message, json_t *jsep, janus_sdp *sdp) {
+	janus_loadgen_peer *peer = janus_loadgen_peer_find(handle);
+	if(peer == NULL || message == NULL || !janus_plugin_session_is_alive(handle))
+		return -1;
+	/* Whatever the event is, the core processes the SDP it may contain */
+	json_t *merged_jsep = NULL;
+	const char *type = json_string_value(json_object_get(jsep, "type"));
+	const char *text = json_string_value(json_object_get(jsep, "sdp"));
+	if(type != NULL && (sdp != NULL || text != NULL)) {
+		janus_sdp *parsed = sdp;
+		if(parsed == NULL) {
+			char error_str[512];
+			parsed = janus_sdp_parse(text, error_str, sizeof(error_str));
+			if(parsed == NULL) {
+				JANUS_LOG(LOG_ERR, "Error parsing the plugin SDP: %s\n", error_str);
+				return -1;
+			}
+		} else {
+			/* The plugin will get rid of its own reference */
+			janus_refcount_increase(&parsed->ref);
+		}
+		char *merged = janus_loadgen_local_sdp(peer, type, parsed);
+		janus_sdp_destroy(parsed);
+		if(merged == NULL)
+			return -1;
+		merged_jsep = json_pack("{ssss}", "type", type, "sdp", merged);
+		g_free(merged);
+	}
+	/* We only care about responses to our own requests, other events are ignored */
+	janus_mutex_lock(&peer->mutex);
+	if(transaction == NULL || peer->transaction == NULL || strcmp(transaction, peer->transaction)) {
+		janus_mutex_unlock(&peer->mutex);
+		json_decref(merged_jsep);
+		return 0;
+	}
+	janus_mutex_unlock(&peer->mutex);
+	/* The plugin still owns the message, so we make a copy */
+	json_t *event = json_object();
+	json_object_set_new(event, "message", json_deep_copy(message));
+	if(merged_jsep != NULL)
+		json_object_set_new(event, "jsep", merged_jsep);
+	g_async_queue_push(peer->events, event);
+	return 0;
+}
+
+static int janus_loadgen_push_event(janus_plugin_session *handle, janus_plugin *p, const char *transaction, json_t *message, json_t *jsep) {
+	return janus_loadgen_push_event_internal(handle, transaction, message, jsep, NULL);
+}
+
+static int janus_loadgen_push_event_sdp(janus_plugin_session *handle, janus_plugin *p, const char *transaction, json_t *message, json_t *jsep, janus_sdp *sdp) {
+	return janus_loadgen_push_event_internal(handle, transaction, message, jsep, sdp);
+}
+
+static void janus_loadgen_relay_rtp(janus_plugin_session *plugin_session, janus_plugin_rtp *packet) {
+	janus_ice_handle *handle = janus_loadgen_handle_get(plugin_session);
+	if(handle == NULL || packet == NULL || packet->buffer == NULL || packet->length < 1)
+		return;
+	janus_ice_relay_rtp(handle, packet);
+}
+
+static void janus_loadgen_relay_rtcp(janus_plugin_session *plugin_session, janus_plugin_rtcp *packet) {
+	janus_ice_handle *handle = janus_loadgen_handle_get(plugin_session);
+	if(handle == NULL || packet == NULL || packet->buffer == NULL || packet->length < 1)
+		return;
+	janus_ice_relay_rtcp(handle, packet);
+}
+
+static void janus_loadgen_relay_data(janus_plugin_session *plugin_session, janus_plugin_data *packet) {
+	janus_ice_handle *handle = janus_loadgen_handle_get(plugin_session);
+	if(handle == NULL || packet == NULL || packet->buffer == NULL || packet->length < 1)
+		return;
+#ifdef HAVE_SCTP
+	janus_ice_relay_data(handle, packet);
+#endif
+}
+
+static void janus_loadgen_send_pli(janus_plugin_session *plugin_session) {
+	janus_ice_handle *handle = janus_loadgen_handle_get(plugin_session);
+	if(handle != NULL)
+		janus_ice_send_pli(handle);
+}
+
+static void janus_loadgen_send_pli_stream(janus_plugin_session *plugin_session, int mindex) {
+	janus_ice_handle *handle = janus_loadgen_handle_get(plugin_session);
+	if(handle != NULL)
+		janus_ice_send_pli_stream(handle, mindex);
+}
+
+static void janus_loadgen_send_remb(janus_plugin_session *plugin_session, guint32 bitrate) {
+	janus_ice_handle *handle = janus_loadgen_handle_get(plugin_session);
+	if(handle != NULL)
+		janus_ice_send_remb(handle, bitrate);
+}
+
+static void janus_loadgen_close_pc(janus_plugin_session *plugin_session) {
+	/* Hanging up only queues the request, so there's no need to defer it as janus.c does */
+	janus_ice_handle *handle = janus_loadgen_handle_get(plugin_session);
+	if(handle == NULL || !g_atomic_int_compare_and_exchange(&handle->closepc, 0, 1))
+		return;
+	janus_loadgen_peer *peer = janus_loadgen_peer_find(plugin_session);
+	JANUS_LOG(LOG_WARN, "Plugin asked to close the PeerConnection of peer #%d\n", peer ? peer->index : -1);
+	janus_ice_webrtc_hangup(handle, "Close PC");
+}
+
+static void janus_loadgen_end_session(janus_plugin_session *plugin_session) {
+	janus_loadgen_peer *peer = janus_loadgen_peer_find(plugin_session);
+	if(peer != NULL)
+		JANUS_LOG(LOG_WARN, "Plugin asked to end the session of peer #%d\n", peer->index);
+}
+
+static gboolean janus_loadgen_events_is_enabled(void) {
+	return FALSE;
+}
+
+static void janus_loadgen_notify_event(janus_plugin *p, janus_plugin_session *handle, json_t *event) {
+	/* Event handlers are disabled, but the plugin owns the event we get */
+	json_decref(event);
+}
+
+static gboolean janus_loadgen_auth_is_signed(void) {
+	return FALSE;
+}
+
+static gboolean janus_loadgen_auth_is_signature_valid(janus_plugin *p, const char *token) {
+	return FALSE;
+}
+
+static gboolean janus_loadgen_auth_signature_contains(janus_plugin *p, const char *token, const char *descriptor) {
+	return FALSE;
+}
+
+
+/* Fake peers management */
+static int janus_loadgen_srtp_create(srtp_t *session, const unsigned char *key, gboolean inbound) {
+	srtp_policy_t policy;
+	memset(&policy, 0, sizeof(policy));
+	srtp_crypto_policy_set_aes_cm_128_hmac_sha1_80(&policy.rtp);
+	srtp_crypto_policy_set_aes_cm_128_hmac_sha1_80(&policy.rtcp);
+	policy.ssrc.type = inbound ? ssrc_any_inbound : ssrc_any_outbound;
+	unsigned char policy_key[SRTP_MASTER_LENGTH];
+	memcpy(policy_key, key, SRTP_MASTER_LENGTH);
+	policy.key = policy_key;
+#if HAS_DTLS_WINDOW_SIZE
+	policy.window_size = 128;
+	policy.allow_repeat_tx = 0;
+#endif
+	policy.next = NULL;
+	return srtp_create(session, &policy);
+}
+
+static janus_loadgen_peer *janus_loadgen_peer_create(int index, gboolean publisher) {
+	janus_loadgen_peer *peer = g_malloc0(sizeof(janus_loadgen_peer));
+	peer->index = index;
+	peer->publisher = publisher;
+	peer->events = g_async_queue_new_full((GDestroyNotify)json_decref);
+	janus_mutex_init(&peer->mutex);
+	peer->latencies = g_array_new(FALSE, FALSE, sizeof(guint32));
+	peer->video_pt = LOADGEN_VIDEO_PT;
+	/* Everything this peer does derives from the seed and its index */
+	peer->rand = g_rand_new_with_seed((guint32)(seed * 7919 + index));
+	peer->loss_rand = g_rand_new_with_seed((guint32)(seed * 104729 + index));
+	peer->ssrc[0] = g_rand_int(peer->rand);
+	peer->ssrc[1] = g_rand_int(peer->rand);
+	peer->seq[0] = (uint16_t)g_rand_int(peer->rand);
+	peer->seq[1] = (uint16_t)g_rand_int(peer->rand);
+	peer->timestamp[0] = g_rand_int(peer->rand);
+	peer->timestamp[1] = g_rand_int(peer->rand);
+	if(!no_srtp) {
+		int i = 0;
+		for(i=0; i<SRTP_MASTER_LENGTH; i++) {
+			peer->in_key[i] = (unsigned char)g_rand_int_range(peer->rand, 0, 256);
+			peer->out_key[i] = (unsigned char)g_rand_int_range(peer->rand, 0, 256);
+		}
+		if(janus_loadgen_srtp_create(&peer->srtp_out, peer->in_key, FALSE) != srtp_err_status_ok ||
+				janus_loadgen_srtp_create(&peer->srtp_in, peer->out_key, TRUE) != srtp_err_status_ok) {
+			JANUS_LOG(LOG_FATAL, "Error creating the SRTP contexts for peer #%d\n", index);
+			exit(1);
+		}
+	}
+	/* Create the handle and attach it to the plugin, as the core would for an "attach" request */
+	peer->handle = janus_loadgen_handle_create(plugin);
+	if(peer->handle == NULL) {
+		JANUS_LOG(LOG_FATAL, "Error creating the handle for peer #%d\n", index);
+		exit(1);
+	}
+	janus_mutex_lock(&peers_mutex);
+	g_hash_table_insert(peers_byhandle, peer->handle, peer);
+	janus_mutex_unlock(&peers_mutex);
+	return peer;
+}
+
+static void janus_loadgen_peer_destroy(janus_loadgen_peer *peer) {
+	if(peer == NULL)
+		return;
+	if(peer->handle)
+		janus_refcount_decrease(&peer->handle->ref);
+	if(peer->srtp_out)
+		srtp_dealloc(peer->srtp_out);
+	if(peer->srtp_in)
+		srtp_dealloc(peer->srtp_in);
+	g_async_queue_unref(peer->events);
+	g_array_free(peer->latencies, TRUE);
+	g_rand_free(peer->rand);
+	g_rand_free(peer->loss_rand);
+	json_decref(peer->id);
+	g_free(peer->transaction);
+	g_free(peer);
+}
+
+/* Our fake peers don't do ICE and DTLS: once a PeerConnection is negotiated, we
+ * give the core the SRTP contexts the handshake would have created, and let it
+ * know the PeerConnection is ready, which is where media starts flowing */
+static int janus_loadgen_peer_connect(janus_loadgen_peer *peer) {
+	janus_ice_handle *handle = peer->handle;
+	if(!no_srtp) {
+		janus_mutex_lock(&handle->mutex);
+		janus_ice_peerconnection *pc = handle->pc;
+		janus_dtls_srtp *dtls = pc ? pc->dtls : NULL;
+		if(dtls == NULL) {
+			JANUS_LOG(LOG_ERR, "No PeerConnection for peer #%d\n", peer->index);
+			janus_mutex_unlock(&handle->mutex);
+			return -1;
+		}
+		if(janus_loadgen_srtp_create(&dtls->srtp_in, peer->in_key, TRUE) != srtp_err_status_ok ||
+				janus_loadgen_srtp_create(&dtls->srtp_out, peer->out_key, FALSE) != srtp_err_status_ok) {
+			JANUS_LOG(LOG_ERR, "Error creating the SRTP contexts of the core for peer #%d\n", peer->index);
+			janus_mutex_unlock(&handle->mutex);
+			return -1;
+		}
+		dtls->srtp_profile = SRTP_AES128_CM_SHA1_80;
+		dtls->srtp_valid = 1;
+		dtls->ready = 1;
+		dtls->dtls_state = JANUS_DTLS_STATE_CONNECTED;
+		dtls->dtls_connected = janus_get_monotonic_time();
+		pc->connected = dtls->dtls_connected;
+		janus_mutex_unlock(&handle->mutex);
+	}
+	janus_ice_dtls_handshake_done(handle);
+	return 0;
+}
+
+/* Helper to send a request to the plugin on behalf of a peer, as the core would:
+ * synchronous responses are returned right away, for asynchronous ones we wait for
+ * the event; unless told otherwise, SDPs are passed parsed if the plugin supports it */
+static json_t *janus_loadgen_request_full(janus_loadgen_peer *peer, json_t *message, json_t *jsep, gboolean parsed) {
+	char transaction[32];
+	g_snprintf(transaction, sizeof(transaction), "loadgen-%d-%"SCNu32, peer->index, g_random_int());
+	janus_mutex_lock(&peer->mutex);
+	g_free(peer->transaction);
+	peer->transaction = g_strdup(transaction);
+	janus_mutex_unlock(&peer->mutex);
+	janus_sdp *sdp = NULL;
+	json_t *body_jsep = NULL;
+	if(jsep != NULL) {
+		const char *type = json_string_value(json_object_get(jsep, "type"));
+		const char *text = json_string_value(json_object_get(jsep, "sdp"));
+		gboolean update = FALSE;
+		sdp = (type && text) ? janus_loadgen_remote_sdp(peer, type, text, &update) : NULL;
+		if(sdp == NULL) {
+			json_decref(message);
+			json_decref(jsep);
+			return NULL;
+		}
+		body_jsep = json_pack("{ss}", "type", type);
+		if(update)
+			json_object_set_new(body_jsep, "update", json_true());
+		json_decref(jsep);
+		if(!parsed || plugin->handle_message_sdp == NULL) {
+			char *stripped = janus_sdp_write(sdp);
+			janus_sdp_destroy(sdp);
+			sdp = NULL;
+			json_object_set_new(body_jsep, "sdp", json_string(stripped));
+			g_free(stripped);
+		}
+	}
+	janus_plugin_result *result = sdp ?
+		plugin->handle_message_sdp(peer->handle->app_handle, g_strdup(transaction), message, body_jsep, sdp) :
+		plugin->handle_message(peer->handle->app_handle, g_strdup(transaction), message, body_jsep);
+	if(result == NULL)
+		return NULL;
+	json_t *response = NULL;
+	if(result->type == JANUS_PLUGIN_OK) {
+		response = json_object();
+		if(result->content)
+			json_object_set(response, "message", result->content);
+	} else if(result->type == JANUS_PLUGIN_OK_WAIT) {
+		response = g_async_queue_timeout_pop(peer->events, LOADGEN_TIMEOUT);
+		if(response == NULL)
+			JANUS_LOG(LOG_ERR, "Timeout waiting for a response from the plugin (peer #%d)\n", peer->index);
+	} else {
+		JANUS_LOG(LOG_ERR, "Error from the plugin (peer #%d): %s\n", peer->index, result->text ? result->text : "??");
+	}
+	janus_plugin_result_destroy(result);
+	/* Check if this is an application level error */
+	json_t *body = response ? json_object_get(response, "message") : NULL;
+	if(body && json_object_get(body, "error")) {
+		JANUS_LOG(LOG_ERR, "Error from the plugin (peer #%d): %s\n", peer->index,
+			json_string_value(json_object_get(body, "error")));
+		json_decref(response);
+		response = NULL;
+	}
+	return response;
+}
+
+static json_t *janus_loadgen_request(janus_loadgen_peer *peer, json_t *message, json_t *jsep) {
+	return janus_loadgen_request_full(peer, message, jsep, TRUE);
+}
+
+/* Helpers to generate the SDPs our fake peers send */
+static json_t *janus_loadgen_jsep(const char *type, janus_sdp *sdp) {
+	/* The core needs ICE credentials and, unless encryption is disabled, a fingerprint */
+	sdp->attributes = g_list_append(sdp->attributes,
+		janus_sdp_attribute_create("ice-ufrag", "%s", LOADGEN_ICE_UFRAG));
+	sdp->attributes = g_list_append(sdp->attributes,
+		janus_sdp_attribute_create("ice-pwd", "%s", LOADGEN_ICE_PWD));
+	sdp->attributes = g_list_append(sdp->attributes,
+		janus_sdp_attribute_create("fingerprint", "sha-256 %s", janus_dtls_get_local_fingerprint()));
+	char *sdp_string = janus_sdp_write(sdp);
+	janus_sdp_destroy(sdp);
+	if(sdp_string == NULL)
+		return NULL;
+	json_t *jsep = json_pack("{ssss}", "type", type, "sdp", sdp_string);
+	g_free(sdp_string);
+	return jsep;
+}
+
+/* Offers alternate audio and video m-lines: the first one is always audio */
+static janus_sdp *janus_loadgen_offer_sdp(int mlines, janus_sdp_mdirection direction) {
+	janus_sdp *offer = janus_sdp_generate_offer("janus-loadgen", "127.0.0.1",
+		JANUS_SDP_OA_MLINE, JANUS_SDP_AUDIO,
+			JANUS_SDP_OA_MID, "0",
+			JANUS_SDP_OA_PT, LOADGEN_AUDIO_PT,
+			JANUS_SDP_OA_CODEC, "opus",
+			JANUS_SDP_OA_DIRECTION, direction,
+			JANUS_SDP_OA_EXTENSION, JANUS_RTP_EXTMAP_AUDIO_LEVEL, LOADGEN_AUDIO_LEVEL_ID,
+			JANUS_SDP_OA_EXTENSION, JANUS_RTP_EXTMAP_MID, LOADGEN_MID_ID,
+			JANUS_SDP_OA_EXTENSION, JANUS_RTP_EXTMAP_TRANSPORT_WIDE_CC, LOADGEN_TWCC_ID,
+		JANUS_SDP_OA_DONE);
+	if(offer == NULL)
+		return NULL;
+	int i = 0;
+	char mid[16];
+	for(i=1; i<mlines; i++) {
+		g_snprintf(mid, sizeof(mid), "%d", i);
+		if(i % 2) {
+			janus_sdp_generate_offer_mline(offer,
+				JANUS_SDP_OA_MLINE, JANUS_SDP_VIDEO,
+					JANUS_SDP_OA_MID, mid,
+					JANUS_SDP_OA_PT, LOADGEN_VIDEO_PT,
+					JANUS_SDP_OA_CODEC, "vp8",
+					JANUS_SDP_OA_DIRECTION, direction,
+					JANUS_SDP_OA_EXTENSION, JANUS_RTP_EXTMAP_MID, LOADGEN_MID_ID,
+					JANUS_SDP_OA_EXTENSION, JANUS_RTP_EXTMAP_TRANSPORT_WIDE_CC, LOADGEN_TWCC_ID,
+				JANUS_SDP_OA_DONE);
+		} else {
+			janus_sdp_generate_offer_mline(offer,
+				JANUS_SDP_OA_MLINE, JANUS_SDP_AUDIO,
+					JANUS_SDP_OA_MID, mid,
+					JANUS_SDP_OA_PT, LOADGEN_AUDIO_PT,
+					JANUS_SDP_OA_CODEC, "opus",
+					JANUS_SDP_OA_DIRECTION, direction,
+					JANUS_SDP_OA_EXTENSION, JANUS_RTP_EXTMAP_AUDIO_LEVEL, LOADGEN_AUDIO_LEVEL_ID,
+					JANUS_SDP_OA_EXTENSION, JANUS_RTP_EXTMAP_MID, LOADGEN_MID_ID,
+					JANUS_SDP_OA_EXTENSION, JANUS_RTP_EXTMAP_TRANSPORT_WIDE_CC, LOADGEN_TWCC_ID,
+				JANUS_SDP_OA_DONE);
+		}
+	}
+	return offer;
+}
+
+static json_t *janus_loadgen_offer(gboolean video, janus_sdp_mdirection direction) {
+	janus_sdp *offer = janus_loadgen_offer_sdp(video ? 2 : 1, direction);
+	if(offer == NULL)
+		return NULL;
+	return janus_loadgen_jsep("offer", offer);
+}
+
+/* The answer generator doesn't add mids and doesn't negotiate RFC4588, so we
+ * take care of both, and take note of the payload types the core will send */
+static void janus_loadgen_answer_mline(janus_loadgen_peer *peer, janus_sdp_mline *offered, janus_sdp_mline *answered) {
+	int pt = answered->ptypes ? GPOINTER_TO_INT(answered->ptypes->data) : -1;
+	if(answered->type == JANUS_SDP_VIDEO && pt > 0)
+		peer->video_pt = pt;
+	GList *temp = offered->attributes;
+	while(temp) {
+		janus_sdp_attribute *a = (janus_sdp_attribute *)temp->data;
+		temp = temp->next;
+		if(a->name == NULL || a->value == NULL)
+			continue;
+		int rtx_pt = 0, apt = 0;
+		if(!strcasecmp(a->name, "mid")) {
+			janus_sdp_attribute_add_to_mline(answered, janus_sdp_attribute_create("mid", "%s", a->value));
+		} else if(answered->type == JANUS_SDP_VIDEO && pt > 0 && !strcasecmp(a->name, "fmtp") &&
+				sscanf(a->value, "%d apt=%d", &rtx_pt, &apt) == 2 && apt == pt) {
+			answered->ptypes = g_list_append(answered->ptypes, GINT_TO_POINTER(rtx_pt));
+			janus_sdp_attribute_add_to_mline(answered, janus_sdp_attribute_create("rtpmap", "%d rtx/90000", rtx_pt));
+			janus_sdp_attribute_add_to_mline(answered, janus_sdp_attribute_create("fmtp", "%d apt=%d", rtx_pt, pt));
+			peer->rtx_pt = rtx_pt;
+		}
+	}
+}
+
+static json_t *janus_loadgen_answer(janus_loadgen_peer *peer, json_t *jsep) {
+	const char *sdp = json_string_value(json_object_get(jsep, "sdp"));
+	if(sdp == NULL)
+		return NULL;
+	char error_str[512];
+	janus_sdp *offer = janus_sdp_parse(sdp, error_str, sizeof(error_str));
+	if(offer == NULL) {
+		JANUS_LOG(LOG_ERR, "Error parsing the plugin offer: %s\n", error_str);
+		return NULL;
+	}
+	janus_sdp *answer = janus_sdp_generate_answer(offer);
+	GList *temp = offer->m_lines;
+	while(temp) {
+		janus_sdp_mline *m = (janus_sdp_mline *)temp->data;
+		gboolean enabled = (m->type == JANUS_SDP_AUDIO || m->type == JANUS_SDP_VIDEO);
+		janus_sdp_generate_answer_mline(offer, answer, m,
+			JANUS_SDP_OA_MLINE, m->type,
+			JANUS_SDP_OA_ENABLED, enabled,
+			JANUS_SDP_OA_DIRECTION, JANUS_SDP_RECVONLY,
+			JANUS_SDP_OA_ACCEPT_EXTMAP, JANUS_RTP_EXTMAP_MID,
+			JANUS_SDP_OA_ACCEPT_EXTMAP, JANUS_RTP_EXTMAP_TRANSPORT_WIDE_CC,
+			JANUS_SDP_OA_ACCEPT_EXTMAP, JANUS_RTP_EXTMAP_AUDIO_LEVEL,
+			JANUS_SDP_OA_DONE);
+		janus_sdp_mline *am = janus_sdp_mline_find_by_index(answer, m->index);
+		if(enabled && am != NULL)
+			janus_loadgen_answer_mline(peer, m, am);
+		temp = temp->next;
+	}
+	janus_sdp_destroy(offer);
+	return janus_loadgen_jsep("answer", answer);
+}
+
+/* Scenarios setup */
+static int janus_loadgen_setup_videoroom(void) {
+	janus_loadgen_peer *first = peers[0];
+	json_t *response = janus_loadgen_request(first, json_pack("{sssi}",
+		"request", "create", "publishers", publishers), NULL);
+	json_t *room = response ? json_deep_copy(json_object_get(json_object_get(response, "message"), "room")) : NULL;
+	json_decref(response);
+	if(room == NULL)
+		return -1;
+	int i = 0;
+	for(i=0; i<publishers; i++) {
+		janus_loadgen_peer *peer = peers[i];
+		json_t *message = json_pack("{sssssO}", "request", "joinandconfigure", "ptype", "publisher", "room", room);
+		response = janus_loadgen_request(peer, message, janus_loadgen_offer(!no_video, JANUS_SDP_SENDONLY));
+		json_t *body = response ? json_object_get(response, "message") : NULL;
+		if(body == NULL || json_object_get(response, "jsep") == NULL || janus_loadgen_peer_connect(peer) < 0) {
+			json_decref(response);
+			json_decref(room);
+			return -1;
+		}
+		peer->id = json_deep_copy(json_object_get(body, "id"));
+		json_decref(response);
+	}
+	int to_receive = (feeds > 0 && feeds < publishers) ? feeds : publishers;
+	for(i=publishers; i<peers_num; i++) {
+		janus_loadgen_peer *peer = peers[i];
+		json_t *streams = json_array();
+		int j = 0;
+		for(j=0; j<to_receive; j++) {
+			janus_loadgen_peer *feed = peers[(i + j) % publishers];
+			json_array_append_new(streams, json_pack("{sO}", "feed", feed->id));
+		}
+		json_t *message = json_pack("{sssssOso}", "request", "join", "ptype", "subscriber", "room", room, "streams", streams);
+		response = janus_loadgen_request(peer, message, NULL);
+		json_t *answer = response ? janus_loadgen_answer(peer, json_object_get(response, "jsep")) : NULL;
+		json_decref(response);
+		if(answer == NULL) {
+			json_decref(room);
+			return -1;
+		}
+		response = janus_loadgen_request(peer, json_pack("{ss}", "request", "start"), answer);
+		if(response == NULL || janus_loadgen_peer_connect(peer) < 0) {
+			json_decref(response);
+			json_decref(room);
+			return -1;
+		}
+		json_decref(response);
+	}
+	json_decref(room);
+	return 0;
+}
+
+static int janus_loadgen_setup_audiobridge(void) {
+	janus_loadgen_peer *first = peers[0];
+	json_t *response = janus_loadgen_request(first, json_pack("{sssi}",
+		"request", "create", "sampling_rate", 48000), NULL);
+	json_t *room = response ? json_deep_copy(json_object_get(json_object_get(response, "message"), "room")) : NULL;
+	json_decref(response);
+	if(room == NULL)
+		return -1;
+	int i = 0;
+	for(i=0; i<peers_num; i++) {
+		janus_loadgen_peer *peer = peers[i];
+		/* Subscribers join muted, as they won't send anything */
+		json_t *message = json_pack("{sssOsb}", "request", "join", "room", room, "muted", !peer->publisher);
+		response = janus_loadgen_request(peer, message, janus_loadgen_offer(FALSE, JANUS_SDP_SENDRECV));
+		if(response == NULL || json_object_get(response, "jsep") == NULL || janus_loadgen_peer_connect(peer) < 0) {
+			json_decref(response);
+			json_decref(room);
+			return -1;
+		}
+		json_decref(response);
+	}
+	json_decref(room);
+	return 0;
+}
+
+static int janus_loadgen_setup_streaming(void) {
+	udp_fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if(udp_fd < 0) {
+		JANUS_LOG(LOG_FATAL, "Error creating the UDP socket to feed mountpoints\n");
+		return -1;
+	}
+	int i = 0;
+	for(i=0; i<publishers; i++) {
+		janus_loadgen_peer *peer = peers[i];
+		/* Each publisher feeds its own mountpoint */
+		json_t *media = json_array();
+		json_array_append_new(media, json_pack("{sssssisiss}", "type", "audio", "mid", "a",
+			"port", 0, "pt", LOADGEN_AUDIO_PT, "codec", "opus"));
+		if(!no_video) {
+			json_array_append_new(media, json_pack("{sssssisiss}", "type", "video", "mid", "v",
+				"port", 0, "pt", LOADGEN_VIDEO_PT, "codec", "vp8"));
+		}
+		json_t *message = json_pack("{sssssisbso}", "request", "create", "type", "rtp",
+			"id", 1000000+i, "is_private", TRUE, "media", media);
+		json_t *response = janus_loadgen_request(peer, message, NULL);
+		json_t *stream = response ? json_object_get(json_object_get(response, "message"), "stream") : NULL;
+		json_t *ports = stream ? json_object_get(stream, "ports") : NULL;
+		if(ports == NULL || json_array_size(ports) == 0) {
+			JANUS_LOG(LOG_FATAL, "Couldn't figure out the ports of mountpoint #%d\n", i);
+			json_decref(response);
+			return -1;
+		}
+		size_t j = 0;
+		for(j=0; j<json_array_size(ports); j++) {
+			json_t *p = json_array_get(ports, j);
+			const char *type = json_string_value(json_object_get(p, "type"));
+			struct sockaddr_in *addr = (type && !strcasecmp(type, "video")) ? &peer->video_addr : &peer->audio_addr;
+			addr->sin_family = AF_INET;
+			addr->sin_port = htons(json_integer_value(json_object_get(p, "port")));
+			addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		}
+		peer->id = json_deep_copy(json_object_get(stream, "id"));
+		json_decref(response);
+	}
+	for(i=publishers; i<peers_num; i++) {
+		janus_loadgen_peer *peer = peers[i];
+		/* Viewers are spread across mountpoints */
+		janus_loadgen_peer *mp = peers[(i - publishers) % publishers];
+		json_t *response = janus_loadgen_request(peer, json_pack("{sssO}", "request", "watch", "id", mp->id), NULL);
+		json_t *answer = response ? janus_loadgen_answer(peer, json_object_get(response, "jsep")) : NULL;
+		json_decref(response);
+		if(answer == NULL)
+			return -1;
+		response = janus_loadgen_request(peer, json_pack("{ss}", "request", "start"), answer);
+		if(response == NULL || janus_loadgen_peer_connect(peer) < 0) {
+			json_decref(response);
+			return -1;
+		}
+		json_decref(response);
+	}
+	return 0;
+}
+
+/* Negotiations benchmark: the offer goes through the same processing as any
+ * other SDP a peer sends, and is passed to the plugin either as text or parsed */
+static int janus_loadgen_negotiate(janus_loadgen_peer *peer, const char *offer_text, gboolean parsed) {
+	json_t *response = janus_loadgen_request_full(peer, json_pack("{ss}", "request", "configure"),
+		json_pack("{ssss}", "type", "offer", "sdp", offer_text), parsed);
+	int res = (response != NULL && json_object_get(response, "jsep") != NULL) ? 0 : -1;
+	json_decref(response);
+	return res;
+}
+
+static json_t *janus_loadgen_negotiations(janus_loadgen_peer *peer) {
+	json_t *results = json_array();
+	int sizes[] = { 3, 30 };
+	guint s = 0;
+	for(s=0; s<G_N_ELEMENTS(sizes) && g_atomic_int_get(&working); s++) {
+		json_t *offer = janus_loadgen_jsep("offer", janus_loadgen_offer_sdp(sizes[s], JANUS_SDP_SENDONLY));
+		char *offer_text = g_strdup(json_string_value(json_object_get(offer, "sdp")));
+		json_decref(offer);
+		/* The first renegotiation adds the new streams, so we don't count it */
+		if(janus_loadgen_negotiate(peer, offer_text, FALSE) < 0) {
+			JANUS_LOG(LOG_ERR, "Error renegotiating %d m-lines\n", sizes[s]);
+			g_free(offer_text);
+			break;
+		}
+		int mode = 0;
+		for(mode=0; mode<2 && g_atomic_int_get(&working); mode++) {
+			gboolean parsed = (mode == 1);
+			if(parsed && plugin->handle_message_sdp == NULL) {
+				JANUS_LOG(LOG_WARN, "The plugin can't receive parsed SDPs, skipping\n");
+				continue;
+			}
+			int i = 0;
+			gint64 start = janus_get_monotonic_time();
+			for(i=0; i<negotiations && g_atomic_int_get(&working); i++) {
+				if(janus_loadgen_negotiate(peer, offer_text, parsed) < 0)
+					break;
+			}
+			gint64 elapsed = janus_get_monotonic_time() - start;
+			json_array_append_new(results, json_pack("{sisssisf}",
+				"mlines", sizes[s], "sdp", parsed ? "parsed" : "text", "negotiations", i,
+				"per-second", elapsed > 0 ? (double)i * G_USEC_PER_SEC / elapsed : 0.0));
+		}
+		g_free(offer_text);
+	}
+	return results;
+}
+
+
+/* Packets capture: this is where the core hands packets to libnice */
+static gint64 janus_loadgen_find_tag(char *buf, int len) {
+	int plen = 0;
+	char *payload = janus_rtp_payload(buf, len, &plen);
+	if(payload == NULL)
+		return 0;
+	/* The tag is always within the first few bytes of the payload, after codec headers */
+	int i = 0;
+	for(i=0; i<=16 && i+LOADGEN_TAG_SIZE <= plen; i++) {
+		uint32_t magic = 0;
+		memcpy(&magic, payload+i, sizeof(magic));
+		if(ntohl(magic) != LOADGEN_TAG_MAGIC)
+			continue;
+		gint64 received = 0;
+		memcpy(&received, payload+i+sizeof(magic), sizeof(received));
+		return received;
+	}
+	return 0;
+}
+
+/* Helper to NACK a packet we pretended we lost, as a browser would */
+static void janus_loadgen_send_nack(janus_loadgen_peer *peer, uint32_t ssrc, uint16_t seq) {
+	char buf[64];
+	GSList *list = g_slist_append(NULL, GUINT_TO_POINTER(seq));
+	int len = janus_rtcp_nacks(buf, 16, list);
+	g_slist_free(list);
+	if(len <= 0)
+		return;
+	janus_rtcp_fix_ssrc(NULL, buf, len, 1, peer->ssrc[1], ssrc);
+	janus_mutex_lock(&peer->mutex);
+	int res = no_srtp ? srtp_err_status_ok : srtp_protect_rtcp(peer->srtp_out, buf, &len);
+	janus_mutex_unlock(&peer->mutex);
+	if(res == srtp_err_status_ok)
+		janus_ice_incoming_packet(peer->handle, buf, len);
+}
+
+static void janus_loadgen_capture(janus_loadgen_peer *peer, const gchar *data, guint len) {
+	char buf[1500];
+	if(len > sizeof(buf)) {
+		janus_mutex_lock(&peer->mutex);
+		peer->errors_out++;
+		janus_mutex_unlock(&peer->mutex);
+		return;
+	}
+	memcpy(buf, data, len);
+	int buflen = len;
+	if(janus_is_rtp(buf, len)) {
+		janus_mutex_lock(&peer->mutex);
+		int res = no_srtp ? srtp_err_status_ok : srtp_unprotect(peer->srtp_in, buf, &buflen);
+		if(res != srtp_err_status_ok) {
+			peer->errors_out++;
+			janus_mutex_unlock(&peer->mutex);
+			return;
+		}
+		janus_rtp_header *rtp = (janus_rtp_header *)buf;
+		if(peer->rtx_pt > 0 && rtp->type == peer->rtx_pt) {
+			/* Retransmission of a packet we NACKed */
+			peer->rtx_out++;
+			peer->bytes_out += len;
+			janus_mutex_unlock(&peer->mutex);
+			return;
+		}
+		if(loss > 0 && rtp->type == peer->video_pt && g_rand_int_range(peer->loss_rand, 0, 100) < loss) {
+			/* Pretend this packet got lost, and ask for it again */
+			peer->lost_out++;
+			uint32_t ssrc = ntohl(rtp->ssrc);
+			uint16_t seq = ntohs(rtp->seq_number);
+			janus_mutex_unlock(&peer->mutex);
+			janus_loadgen_send_nack(peer, ssrc, seq);
+			return;
+		}
+		peer->packets_out++;
+		peer->bytes_out += len;
+		gint64 received = janus_loadgen_find_tag(buf, buflen);
+		if(received > 0) {
+			guint32 latency = (guint32)(janus_get_monotonic_time() - received);
+			g_array_append_val(peer->latencies, latency);
+		}
+		janus_mutex_unlock(&peer->mutex);
+	} else if(janus_is_rtcp(buf, len)) {
+		janus_mutex_lock(&peer->mutex);
+		int res = no_srtp ? srtp_err_status_ok : srtp_unprotect_rtcp(peer->srtp_in, buf, &buflen);
+		if(res != srtp_err_status_ok) {
+			peer->errors_out++;
+			janus_mutex_unlock(&peer->mutex);
+			return;
+		}
+		peer->rtcp_out++;
+		janus_rtcp_compound compound;
+		if(janus_rtcp_parse_compound(buf, buflen, &compound) == 0) {
+			if(compound.has_pli || compound.has_fir)
+				peer->plis++;
+			peer->nacks += compound.nacks;
+			janus_rtcp_compound_iter iter = { 0 };
+			const janus_rtcp_block *block = NULL;
+			while((block = janus_rtcp_compound_next(buf, &compound, &iter)) != NULL) {
+				if(block->type == JANUS_RTCP_BLOCK_TWCC)
+					peer->twcc++;
+			}
+		}
+		janus_mutex_unlock(&peer->mutex);
+	}
+}
+
+#ifdef HAVE_SCTP
+static void janus_loadgen_datachannels_deliver(NiceAgent *agent, const gchar *buf, guint len);
+#endif
+
+/* We replace the libnice function the core sends packets with */
+gint nice_agent_send(NiceAgent *agent, guint stream_id, guint component_id, guint len, const gchar *buf) {
+	if(agent == NULL || buf == NULL || len == 0)
+		return -1;
+	if(g_atomic_int_get(&stopping)) {
+		/* We're tearing everything down, there's nobody to send this to anymore */
+		return len;
+	}
+#ifdef HAVE_SCTP
+	if(datachannels > 0) {
+		janus_loadgen_datachannels_deliver(agent, buf, len);
+		return len;
+	}
+#endif
+	janus_loadgen_peer *peer = g_object_get_data(G_OBJECT(agent), LOADGEN_AGENT_KEY);
+	if(peer == NULL)
+		return -1;
+	janus_loadgen_capture(peer, buf, len);
+	return len;
+}
+
+
+/* Packets generation */
+static gint64 janus_loadgen_thread_cpu_time(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (ts.tv_sec*G_GINT64_CONSTANT(1000000)) + (ts.tv_nsec/G_GINT64_CONSTANT(1000));
+}
+
+static void janus_loadgen_tag(char *buf, gint64 now) {
+	uint32_t magic = htonl(LOADGEN_TAG_MAGIC);
+	memcpy(buf, &magic, sizeof(magic));
+	memcpy(buf+sizeof(magic), &now, sizeof(now));
+}
+
+static void janus_loadgen_fill(janus_loadgen_peer *peer, char *buf, int len) {
+	int i = 0;
+	for(i=0; i<len; i++)
+		buf[i] = (char)g_rand_int_range(peer->rand, 0, 256);
+}
+
+static int janus_loadgen_rtp_header(janus_loadgen_peer *peer, char *buf, gboolean video, gboolean marker, int level) {
+	janus_rtp_header *rtp = (janus_rtp_header *)buf;
+	memset(rtp, 0, RTP_HEADER_SIZE);
+	rtp->version = 2;
+	rtp->markerbit = marker;
+	rtp->type = video ? LOADGEN_VIDEO_PT : LOADGEN_AUDIO_PT;
+	rtp->seq_number = htons(peer->seq[video]++);
+	rtp->timestamp = htonl(peer->timestamp[video]);
+	rtp->ssrc = htonl(peer->ssrc[video]);
+	/* One-byte header extensions: the audio level for audio and, unless we're
+	 * feeding a mountpoint, the mid and transport-wide sequence number */
+	char *ext = buf + RTP_HEADER_SIZE + 4;
+	int ext_len = 0;
+	if(!video) {
+		ext[ext_len++] = (char)(LOADGEN_AUDIO_LEVEL_ID << 4);
+		ext[ext_len++] = (char)level;
+	}
+	if(scenario != janus_loadgen_streaming) {
+		ext[ext_len++] = (char)(LOADGEN_MID_ID << 4);
+		ext[ext_len++] = video ? '1' : '0';
+		uint16_t twcc_seq = htons(peer->twcc_seq++);
+		ext[ext_len++] = (char)((LOADGEN_TWCC_ID << 4) | 1);
+		memcpy(ext+ext_len, &twcc_seq, sizeof(twcc_seq));
+		ext_len += sizeof(twcc_seq);
+	}
+	if(ext_len == 0)
+		return RTP_HEADER_SIZE;
+	while(ext_len % 4)
+		ext[ext_len++] = 0;
+	rtp->extension = 1;
+	uint16_t profile = htons(0xBEDE), words = htons(ext_len/4);
+	memcpy(buf+RTP_HEADER_SIZE, &profile, 2);
+	memcpy(buf+RTP_HEADER_SIZE+2, &words, 2);
+	return RTP_HEADER_SIZE + 4 + ext_len;
+}
+
+/* Helper to send a generated packet, which the core will receive as if it came from libnice */
+static void janus_loadgen_inject(janus_loadgen_peer *peer, janus_loadgen_thread *thread,
+		char *buf, int len, gboolean video, gint64 cpu_start) {
+	if(scenario == janus_loadgen_streaming) {
+		/* Mountpoints get plain RTP via UDP */
+		struct sockaddr_in *addr = video ? &peer->video_addr : &peer->audio_addr;
+		thread->peer_cpu += janus_loadgen_thread_cpu_time() - cpu_start;
+		if(sendto(udp_fd, buf, len, 0, (struct sockaddr *)addr, sizeof(*addr)) < 0)
+			peer->errors_in++;
+		peer->packets_in++;
+		peer->bytes_in += len;
+		return;
+	}
+	if(video && loss > 0 && g_rand_int_range(peer->rand, 0, 100) < loss) {
+		/* Lose the packet on the way: the core will NACK it */
+		peer->dropped_in++;
+		thread->peer_cpu += janus_loadgen_thread_cpu_time() - cpu_start;
+		return;
+	}
+	janus_mutex_lock(&peer->mutex);
+	int res = no_srtp ? srtp_err_status_ok : srtp_protect(peer->srtp_out, buf, &len);
+	janus_mutex_unlock(&peer->mutex);
+	thread->peer_cpu += janus_loadgen_thread_cpu_time() - cpu_start;
+	if(res != srtp_err_status_ok) {
+		peer->errors_in++;
+		return;
+	}
+	peer->packets_in++;
+	peer->bytes_in += len;
+	janus_ice_incoming_packet(peer->handle, buf, len);
+}
+
+static void janus_loadgen_send_audio(janus_loadgen_peer *peer, janus_loadgen_thread *thread) {
+	gint64 cpu_start = janus_loadgen_thread_cpu_time();
+	char buf[1500+SRTP_MAX_TAG_LEN];
+	/* Alternate talkspurts and silence, as a real participant would */
+	if(peer->talkspurt <= 0) {
+		peer->talking = !peer->talking;
+		peer->talkspurt = g_rand_int_range(peer->rand, 50, 250);
+	}
+	peer->talkspurt--;
+	int level = peer->talking ? g_rand_int_range(peer->rand, 20, 40) : g_rand_int_range(peer->rand, 80, 127);
+	int len = janus_loadgen_rtp_header(peer, buf, FALSE, FALSE, (peer->talking ? 0x80 : 0) | level);
+	/* Opus CELT-only fullband 20ms frame, size depending on whether we're talking */
+	int size = peer->talking ? g_rand_int_range(peer->rand, 60, 120) : g_rand_int_range(peer->rand, 20, 40);
+	buf[len] = (char)0xF8;
+	janus_loadgen_tag(buf+len+1, janus_get_monotonic_time());
+	janus_loadgen_fill(peer, buf+len+1+LOADGEN_TAG_SIZE, size-1-LOADGEN_TAG_SIZE);
+	len += size;
+	peer->timestamp[0] += 960;
+	janus_loadgen_inject(peer, thread, buf, len, FALSE, cpu_start);
+}
+
+static void janus_loadgen_send_video(janus_loadgen_peer *peer, janus_loadgen_thread *thread) {
+	gboolean keyframe = (peer->frames % (keyframe_interval * video_fps)) == 0;
+	int frame_size = video_bitrate * 1000 / 8 / video_fps;
+	if(keyframe)
+		frame_size *= 5;
+	/* Vary the size a bit, deterministically */
+	frame_size += g_rand_int_range(peer->rand, 0, frame_size/5 + 1) - frame_size/10;
+	if(frame_size < 100)
+		frame_size = 100;
+	int sent = 0;
+	gboolean first = TRUE;
+	while(sent < frame_size) {
+		gint64 cpu_start = janus_loadgen_thread_cpu_time();
+		int chunk = frame_size - sent;
+		if(chunk > LOADGEN_MAX_PAYLOAD)
+			chunk = LOADGEN_MAX_PAYLOAD;
+		char buf[1500+SRTP_MAX_TAG_LEN];
+		int len = janus_loadgen_rtp_header(peer, buf, TRUE, sent + chunk >= frame_size, 0);
+		/* VP8 payload descriptor (S bit on the first packet of the frame) */
+		buf[len++] = first ? 0x10 : 0x00;
+		if(first) {
+			/* VP8 payload header: for keyframes, also start code and resolution (640x480) */
+			if(keyframe) {
+				const unsigned char header[] = { 0x10, 0x02, 0x00, 0x9d, 0x01, 0x2a, 0x80, 0x02, 0xe0, 0x01 };
+				memcpy(buf+len, header, sizeof(header));
+				len += sizeof(header);
+			} else {
+				const unsigned char header[] = { 0x11, 0x02, 0x00 };
+				memcpy(buf+len, header, sizeof(header));
+				len += sizeof(header);
+			}
+		}
+		janus_loadgen_tag(buf+len, janus_get_monotonic_time());
+		len += LOADGEN_TAG_SIZE;
+		int filler = chunk - LOADGEN_TAG_SIZE;
+		if(filler > 0) {
+			janus_loadgen_fill(peer, buf+len, filler);
+			len += filler;
+		}
+		janus_loadgen_inject(peer, thread, buf, len, TRUE, cpu_start);
+		sent += chunk;
+		first = FALSE;
+	}
+	peer->frames++;
+	peer->timestamp[1] += 90000 / video_fps;
+}
+
+static void *janus_loadgen_thread_func(void *data) {
+	janus_loadgen_thread *thread = (janus_loadgen_thread *)data;
+	gint64 audio_interval = (gint64)(LOADGEN_AUDIO_PTIME / speed);
+	gint64 video_interval = (gint64)(G_USEC_PER_SEC / video_fps / speed);
+	gint64 start = janus_get_monotonic_time();
+	int i = 0;
+	/* Spread publishers in time, so that they don't all send at the same time */
+	for(i=thread->index; i<publishers; i+=threads) {
+		janus_loadgen_peer *peer = peers[i];
+		peer->next_audio = start + audio_interval * i / publishers;
+		peer->next_video = start + video_interval * i / publishers;
+	}
+	while(g_atomic_int_get(&working)) {
+		gint64 now = janus_get_monotonic_time();
+		gint64 next = now + G_USEC_PER_SEC;
+		for(i=thread->index; i<publishers; i+=threads) {
+			janus_loadgen_peer *peer = peers[i];
+			while(peer->next_audio <= now) {
+				janus_loadgen_send_audio(peer, thread);
+				peer->next_audio += audio_interval;
+			}
+			if(peer->next_audio < next)
+				next = peer->next_audio;
+			if(no_video)
+				continue;
+			while(peer->next_video <= now) {
+				janus_loadgen_send_video(peer, thread);
+				peer->next_video += video_interval;
+			}
+			if(peer->next_video < next)
+				next = peer->next_video;
+		}
+		now = janus_get_monotonic_time();
+		if(next > now)
+			g_usleep(next - now);
+	}
+	return NULL;
+}
+
+/* CPU usage */
+typedef struct janus_loadgen_cpu {
+	guint64 busy, total;
+} janus_loadgen_cpu;
+
+static int janus_loadgen_cpu_read(janus_loadgen_cpu *cores, int max) {
+	/* Only available on Linux */
+	FILE *f = fopen("/proc/stat", "r");
+	if(f == NULL)
+		return 0;
+	char line[512];
+	int count = 0;
+	while(count < max && fgets(line, sizeof(line), f)) {
+		int core = 0;
+		unsigned long long user = 0, nice = 0, system = 0, idle = 0, iowait = 0, irq = 0, softirq = 0, steal = 0;
+		if(sscanf(line, "cpu%d %llu %llu %llu %llu %llu %llu %llu %llu", &core,
+				&user, &nice, &system, &idle, &iowait, &irq, &softirq, &steal) != 9)
+			continue;
+		if(core < 0 || core >= max)
+			continue;
+		cores[core].busy = user + nice + system + irq + softirq + steal;
+		cores[core].total = cores[core].busy + idle + iowait;
+		if(core + 1 > count)
+			count = core + 1;
+	}
+	fclose(f);
+	return count;
+}
+
+static int janus_loadgen_compare_latency(const void *a, const void *b) {
+	guint32 la = *(const guint32 *)a, lb = *(const guint32 *)b;
+	return (la > lb) - (la < lb);
+}
+
+/* Core setup and teardown, in the same order janus.c uses */
+static int janus_loadgen_core_init(void) {
+	if(event_loops > 0)
+		janus_ice_set_static_event_loops(event_loops, FALSE);
+	/* Full-trickle, so that we never wait for candidates we don't need */
+	janus_ice_init(FALSE, FALSE, TRUE, TRUE, FALSE, FALSE, 0, 0);
+	if(janus_dtls_srtp_init(NULL, NULL, NULL, NULL, 1000, FALSE, TRUE) < 0) {
+		JANUS_LOG(LOG_FATAL, "Error initializing DTLS/SRTP\n");
+		return -1;
+	}
+#ifdef HAVE_SCTP
+	if(janus_sctp_init() < 0 || janus_sctp_set_workers(sctp_workers) < 0) {
+		JANUS_LOG(LOG_FATAL, "Error initializing the SCTP stack\n");
+		return -1;
+	}
+#endif
+	session = g_malloc0(sizeof(janus_session));
+	session->session_id = 1;
+	session->last_activity = janus_get_monotonic_time();
+	janus_mutex_init(&session->mutex);
+	janus_refcount_init(&session->ref, janus_loadgen_session_free);
+	peers_byhandle = g_hash_table_new(NULL, NULL);
+	return 0;
+}
+
+static void janus_loadgen_core_deinit(void) {
+	janus_ice_deinit();
+	janus_dtls_srtp_cleanup();
+#ifdef HAVE_SCTP
+	janus_sctp_deinit();
+#endif
+	if(janus_ice_get_static_event_loops() > 0)
+		janus_ice_stop_static_event_loops();
+	if(peers_byhandle != NULL)
+		g_hash_table_destroy(peers_byhandle);
+	if(session != NULL)
+		janus_refcount_decrease(&session->ref);
+}
+
+/* Helpers to get rid of the handles, and then of our own resources */
+static void janus_loadgen_teardown(void) {
+	g_atomic_int_set(&stopping, 1);
+	int i = 0;
+	for(i=0; i<peers_num; i++)
+		janus_loadgen_handle_remove(peers[i]->handle);
+	/* Detaching is asynchronous: give the loops a moment to get rid of the plugin sessions */
+	g_usleep(500000);
+	plugin->destroy();
+	if(udp_fd > -1)
+		close(udp_fd);
+}
+
+static void janus_loadgen_cleanup(void) {
+	int i = 0;
+	for(i=0; i<peers_num; i++)
+		janus_loadgen_peer_destroy(peers[i]);
+	g_free(peers);
+	janus_loadgen_core_deinit();
+	srtp_shutdown();
+}
+
+#ifdef HAVE_SCTP
+/* DataChannels benchmark: pairs of handles, attached to a built-in plugin,
+ * whose PeerConnections perform a real DTLS handshake with each other, and
+ * then exchange messages on the SCTP associations the core creates */
+#define LOADGEN_DATA_WINDOW		32
+#define LOADGEN_DATA_LABEL		"loadgen"
+typedef struct janus_loadgen_association {
+	int index;
+	janus_ice_handle *handle;
+	/* The association we talk to */
+	struct janus_loadgen_association *peer;
+	/* Whether the association is up, and messages sent (only updated by the sending thread) and received */
+	gboolean established;
+	guint64 sent;
+	volatile gint received;
+	gint64 last_progress;
+	janus_mutex mutex;
+	GArray *latencies;
+} janus_loadgen_association;
+static janus_loadgen_association **associations = NULL;
+static volatile gint measuring = 0;
+
+/* Built-in plugin the DataChannels handles are attached to */
+static const char *janus_loadgen_datachannels_get_name(void) {
+	return "janus-loadgen";
+}
+
+static const char *janus_loadgen_datachannels_get_package(void) {
+	return "janus.plugin.loadgen";
+}
+
+static void janus_loadgen_datachannels_create_session(janus_plugin_session *handle, int *error) {
+	/* The association is set as the plugin handle right after attaching */
+	*error = 0;
+}
+
+static void janus_loadgen_datachannels_incoming_data(janus_plugin_session *handle, janus_plugin_data *packet) {
+	janus_loadgen_association *a = handle ? (janus_loadgen_association *)handle->plugin_handle : NULL;
+	if(a == NULL || packet == NULL || packet->buffer == NULL || packet->length < sizeof(gint64))
+		return;
+	gint64 sent = 0;
+	memcpy(&sent, packet->buffer, sizeof(sent));
+	g_atomic_int_inc(&a->received);
+	if(g_atomic_int_get(&measuring)) {
+		guint32 latency = (guint32)(janus_get_monotonic_time() - sent);
+		janus_mutex_lock(&a->mutex);
+		g_array_append_val(a->latencies, latency);
+		janus_mutex_unlock(&a->mutex);
+	}
+}
+
+static void janus_loadgen_datachannels_hangup_media(janus_plugin_session *handle) {
+	/* Nothing to do */
+}
+
+static void janus_loadgen_datachannels_destroy_session(janus_plugin_session *handle, int *error) {
+	handle->plugin_handle = NULL;
+	*error = 0;
+}
+
+static janus_plugin janus_loadgen_datachannels_plugin =
+	JANUS_PLUGIN_INIT (
+		.get_name = janus_loadgen_datachannels_get_name,
+		.get_package = janus_loadgen_datachannels_get_package,
+		.create_session = janus_loadgen_datachannels_create_session,
+		.incoming_data = janus_loadgen_datachannels_incoming_data,
+		.hangup_media = janus_loadgen_datachannels_hangup_media,
+		.destroy_session = janus_loadgen_datachannels_destroy_session,
+	);
+
+/* What a PeerConnection sends is a DTLS record for the other end of the pair,
+ * which gets it as if the network had delivered it to libnice */
+static void janus_loadgen_datachannels_deliver(NiceAgent *agent, const gchar *buf, guint len) {
+	janus_loadgen_association *a = g_object_get_data(G_OBJECT(agent), LOADGEN_AGENT_KEY);
+	if(a == NULL || a->peer == NULL)
+		return;
+	janus_ice_incoming_packet(a->peer->handle, buf, len);
+}
+
+static janus_loadgen_association *janus_loadgen_association_create(int index) {
+	janus_loadgen_association *a = g_malloc0(sizeof(janus_loadgen_association));
+	a->index = index;
+	janus_mutex_init(&a->mutex);
+	a->latencies = g_array_new(FALSE, FALSE, sizeof(guint32));
+	a->handle = janus_loadgen_handle_create(&janus_loadgen_datachannels_plugin);
+	if(a->handle == NULL)
+		return a;
+	a->handle->app_handle->plugin_handle = a;
+	/* Set up the PeerConnection without negotiating it: one end of each pair is the
+	 * DTLS client, and as both use our certificate, that's the fingerprint to expect */
+	janus_ice_handle *handle = a->handle;
+	janus_dtls_role role = (index % 2) ? JANUS_DTLS_ROLE_SERVER : JANUS_DTLS_ROLE_CLIENT;
+	janus_mutex_lock(&handle->mutex);
+	janus_flags_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_DATA_CHANNELS);
+	if(janus_ice_setup_local(handle, role == JANUS_DTLS_ROLE_CLIENT, TRUE, role) < 0 || handle->pc == NULL) {
+		janus_mutex_unlock(&handle->mutex);
+		return a;
+	}
+	janus_ice_peerconnection_medium_create(handle, JANUS_MEDIA_DATA);
+	handle->pc->remote_hashing = g_strdup("sha-256");
+	handle->pc->remote_fingerprint = g_strdup(janus_dtls_get_local_fingerprint());
+	g_object_set_data(G_OBJECT(handle->agent), LOADGEN_AGENT_KEY, a);
+	janus_flags_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_GOT_OFFER);
+	janus_flags_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_GOT_ANSWER);
+	janus_flags_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_NEGOTIATED);
+	janus_mutex_unlock(&handle->mutex);
+	return a;
+}
+
+/* Helper to check whether the SCTP association of a PeerConnection is up */
+static gboolean janus_loadgen_association_is_up(janus_loadgen_association *a) {
+	janus_ice_handle *handle = a->handle;
+	if(!janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_READY))
+		return FALSE;
+	gboolean up = FALSE;
+	janus_mutex_lock(&handle->mutex);
+	janus_ice_peerconnection *pc = handle->pc;
+	janus_sctp_association *sctp = (pc && pc->dtls) ? pc->dtls->sctp : NULL;
+	if(sctp != NULL) {
+		/* Don't open the channel until the association is up, as plugins wouldn't either */
+		struct sctp_status status;
+		socklen_t len = sizeof(status);
+		up = usrsctp_getsockopt(sctp->sock, IPPROTO_SCTP, SCTP_STATUS, &status, &len) == 0 &&
+			status.sstat_state == SCTP_ESTABLISHED && status.sstat_outstrms > 0;
+	}
+	janus_mutex_unlock(&handle->mutex);
+	return up;
+}
+
+static void *janus_loadgen_datachannels_thread_func(void *data) {
+	janus_loadgen_thread *thread = (janus_loadgen_thread *)data;
+	char *message = g_malloc(message_size);
+	memset(message, 'x', message_size);
+	janus_plugin_data packet;
+	janus_plugin_data_reset(&packet);
+	packet.label = (char *)LOADGEN_DATA_LABEL;
+	packet.binary = TRUE;
+	packet.buffer = message;
+	packet.length = message_size;
+	int i = 0;
+	while(g_atomic_int_get(&working)) {
+		/* Keep a window of messages in flight on each of our associations */
+		gint64 now = janus_get_monotonic_time();
+		for(i=0; i<datachannels; i++) {
+			janus_loadgen_association *a = associations[i];
+			if((i / 2) % threads != thread->index)
+				continue;
+			if(!a->established) {
+				if(!janus_loadgen_association_is_up(a))
+					continue;
+				a->established = TRUE;
+			}
+			guint64 received = (guint64)g_atomic_int_get(&a->peer->received);
+			if(received > a->sent)
+				a->sent = received;
+			if(a->last_progress == 0 || received != a->sent)
+				a->last_progress = now;
+			if(now - a->last_progress > G_USEC_PER_SEC) {
+				/* Nothing arrived for a while (e.g., a send failure), open the window again */
+				a->sent = received;
+				a->last_progress = now;
+			}
+			while(a->sent - received < LOADGEN_DATA_WINDOW) {
+				memcpy(message, &now, sizeof(now));
+				janus_ice_relay_data(a->handle, &packet);
+				a->sent++;
+			}
+		}
+		g_usleep(1000);
+	}
+	g_free(message);
+	return NULL;
+}
+
+static guint64 janus_loadgen_datachannels_received(void) {
+	guint64 received = 0;
+	int i = 0;
+	for(i=0; i<datachannels; i++)
+		received += (guint64)g_atomic_int_get(&associations[i]->received);
+	return received;
+}
+
+static int janus_loadgen_datachannels(void) {
+	int pairs = datachannels / 2, i = 0;
+	if(threads > pairs)
+		threads = pairs;
+	/* Create the PeerConnections, and then have them all start their DTLS handshakes */
+	JANUS_LOG(LOG_INFO, "Setting up %d PeerConnections with DataChannels (%d SCTP workers)...\n", datachannels, sctp_workers);
+	associations = g_malloc0(datachannels * sizeof(janus_loadgen_association *));
+	for(i=0; i<datachannels; i++) {
+		associations[i] = janus_loadgen_association_create(i);
+		if(associations[i]->handle == NULL || associations[i]->handle->pc == NULL) {
+			JANUS_LOG(LOG_FATAL, "Error creating PeerConnection #%d\n", i);
+			return 1;
+		}
+	}
+	for(i=0; i<datachannels; i++)
+		associations[i]->peer = associations[i ^ 1];
+	for(i=0; i<datachannels; i++)
+		janus_ice_peerconnection_connected(associations[i]->handle);
+	GError *error = NULL;
+	janus_loadgen_thread *workers = g_malloc0(threads * sizeof(janus_loadgen_thread));
+	for(i=0; i<threads; i++) {
+		workers[i].index = i;
+		char tname[16];
+		g_snprintf(tname, sizeof(tname), "loadgen %d", i);
+		workers[i].thread = g_thread_try_new(tname, janus_loadgen_datachannels_thread_func, &workers[i], &error);
+		if(error != NULL) {
+			JANUS_LOG(LOG_FATAL, "Got error %d (%s) trying to launch the sending thread...\n",
+				error->code, error->message ? error->message : "??");
+			return 1;
+		}
+	}
+	/* Wait for all associations to be up and exchanging messages before measuring */
+	gint64 deadline = janus_get_monotonic_time() + LOADGEN_TIMEOUT;
+	int ready = 0;
+	while(g_atomic_int_get(&working) && ready < datachannels && janus_get_monotonic_time() < deadline) {
+		g_usleep(100000);
+		for(ready=0; ready<datachannels && g_atomic_int_get(&associations[ready]->received) > 0; ready++);
+	}
+	if(ready < datachannels)
+		JANUS_LOG(LOG_WARN, "Only %d/%d associations are exchanging messages, measuring anyway\n", ready, datachannels);
+
+	janus_loadgen_cpu cpu_start[1024], cpu_end[1024];
+	int cores = janus_loadgen_cpu_read(cpu_start, 1024);
+	struct rusage usage_start, usage_end;
+	getrusage(RUSAGE_SELF, &usage_start);
+	guint64 received_start = janus_loadgen_datachannels_received();
+	gint64 run_start = janus_get_monotonic_time();
+	g_atomic_int_set(&measuring, 1);
+	JANUS_LOG(LOG_INFO, "Running for %d seconds...\n", duration);
+	gint64 run_end = run_start + (gint64)duration * G_USEC_PER_SEC;
+	while(g_atomic_int_get(&working) && janus_get_monotonic_time() < run_end)
+		g_usleep(100000);
+	g_atomic_int_set(&measuring, 0);
+	guint64 received = janus_loadgen_datachannels_received() - received_start;
+	gint64 elapsed = janus_get_monotonic_time() - run_start;
+	getrusage(RUSAGE_SELF, &usage_end);
+	janus_loadgen_cpu_read(cpu_end, 1024);
+	g_atomic_int_set(&working, 0);
+	for(i=0; i<threads; i++)
+		g_thread_join(workers[i].thread);
+	g_free(workers);
+
+	/* Gather the results, and tear everything down */
+	guint64 send_failures = 0;
+	GArray *latencies = g_array_new(FALSE, FALSE, sizeof(guint32));
+	for(i=0; i<datachannels; i++) {
+		janus_loadgen_association *a = associations[i];
+		janus_mutex_lock(&a->handle->mutex);
+		janus_ice_peerconnection *pc = a->handle->pc;
+		if(pc != NULL && pc->dtls != NULL && pc->dtls->sctp != NULL) {
+			json_t *stats = janus_sctp_association_stats(pc->dtls->sctp);
+			send_failures += json_integer_value(json_object_get(stats, "send-failures"));
+			json_decref(stats);
+		}
+		janus_mutex_unlock(&a->handle->mutex);
+		janus_mutex_lock(&a->mutex);
+		g_array_append_vals(latencies, a->latencies->data, a->latencies->len);
+		janus_mutex_unlock(&a->mutex);
+	}
+	g_atomic_int_set(&stopping, 1);
+	for(i=0; i<datachannels; i++)
+		janus_loadgen_handle_remove(associations[i]->handle);
+	g_usleep(500000);
+	guint32 p50 = 0, p99 = 0, pmax = 0;
+	if(latencies->len > 0) {
+		qsort(latencies->data, latencies->len, sizeof(guint32), janus_loadgen_compare_latency);
+		guint32 *l = (guint32 *)latencies->data;
+		guint last = latencies->len - 1;
+		p50 = l[(guint64)last * 500 / 1000];
+		p99 = l[(guint64)last * 990 / 1000];
+		pmax = l[last];
+	}
+	double seconds = (double)elapsed / G_USEC_PER_SEC;
+	double cpu_used = (usage_end.ru_utime.tv_sec - usage_start.ru_utime.tv_sec) +
+		(double)(usage_end.ru_utime.tv_usec - usage_start.ru_utime.tv_usec) / G_USEC_PER_SEC +
+		(usage_end.ru_stime.tv_sec - usage_start.ru_stime.tv_sec) +
+		(double)(usage_end.ru_stime.tv_usec - usage_start.ru_stime.tv_usec) / G_USEC_PER_SEC;
+
+	json_t *results = json_object();
+	json_object_set_new(results, "associations", json_integer(datachannels));
+	json_object_set_new(results, "threads", json_integer(threads));
+	json_object_set_new(results, "event-loops", json_integer(event_loops));
+	json_object_set_new(results, "sctp-workers", json_integer(sctp_workers));
+	json_object_set_new(results, "message-size", json_integer(message_size));
+	json_object_set_new(results, "duration", json_real(seconds));
+	json_object_set_new(results, "messages", json_integer(received));
+	json_object_set_new(results, "messages-per-second", json_real(received / seconds));
+	json_object_set_new(results, "mbps", json_real(received * message_size * 8 / seconds / 1000000));
+	json_object_set_new(results, "send-failures", json_integer(send_failures));
+	if(latencies->len > 0) {
+		json_t *latency = json_object();
+		json_object_set_new(latency, "samples", json_integer(latencies->len));
+		json_object_set_new(latency, "p50", json_integer(p50));
+		json_object_set_new(latency, "p99", json_integer(p99));
+		json_object_set_new(latency, "max", json_integer(pmax));
+		json_object_set_new(results, "latency-us", latency);
+	}
+	json_t *cpu = json_object();
+	json_object_set_new(cpu, "usage", json_real(cpu_used * 100 / seconds));
+	json_t *per_core = json_array();
+	for(i=0; i<cores; i++) {
+		guint64 busy = cpu_end[i].busy - cpu_start[i].busy, total = cpu_end[i].total - cpu_start[i].total;
+		json_array_append_new(per_core, json_real(total ? (double)busy * 100 / total : 0));
+	}
+	json_object_set_new(cpu, "cores", per_core);
+	json_object_set_new(results, "cpu", cpu);
+	if(json_output) {
+		char *text = json_dumps(results, JSON_INDENT(3) | JSON_PRESERVE_ORDER);
+		g_print("%s\n", text);
+		free(text);
+	} else {
+		g_print("DataChannels: %d associations, %d threads, %d event loops, %d SCTP workers, %d bytes messages, %.2fs\n",
+			datachannels, threads, event_loops, sctp_workers, message_size, seconds);
+		g_print("  Messages: %"SCNu64" (%.0f/s, %.2f Mbps), %"SCNu64" send failures\n",
+			received, received / seconds, received * message_size * 8 / seconds / 1000000, send_failures);
+		if(latencies->len > 0) {
+			g_print("  Latency:  p50=%"SCNu32"us p99=%"SCNu32"us max=%"SCNu32"us (%u samples)\n",
+				p50, p99, pmax, latencies->len);
+		}
+		g_print("  CPU:      %.1f%%\n", cpu_used * 100 / seconds);
+		for(i=0; i<cores; i++) {
+			guint64 busy = cpu_end[i].busy - cpu_start[i].busy, total = cpu_end[i].total - cpu_start[i].total;
+			g_print("    cpu%-3d %5.1f%%\n", i, total ? (double)busy * 100 / total : 0);
+		}
+	}
+	json_decref(results);
+	g_array_free(latencies, TRUE);
+	for(i=0; i<datachannels; i++) {
+		janus_refcount_decrease(&associations[i]->handle->ref);
+		g_array_free(associations[i]->latencies, TRUE);
+	}
+	janus_loadgen_core_deinit();
+	srtp_shutdown();
+	for(i=0; i<datachannels; i++)
+		g_free(associations[i]);
+	g_free(associations);
+	return received > 0 ? 0 : 1;
+}
+#endif
+
+/* Main Code */
+int main(int argc, char *argv[]) {
+	/* Parse the command-line arguments */
+	GError *error = NULL;
+	GOptionContext *opts = g_option_context_new("");
+	g_option_context_set_help_enabled(opts, TRUE);
+	g_option_context_add_main_entries(opts, opt_entries, NULL);
+	if(!g_option_context_parse(opts, &argc, &argv, &error)) {
+		g_print("%s\n", error->message);
+		g_error_free(error);
+		exit(1);
+	}
+	if((plugin_path == NULL && datachannels == 0) || publishers < 1 || subscribers < 0 || duration < 1 || negotiations < 0 ||
+			threads < 1 || event_loops < 0 || video_fps < 1 || video_bitrate < 1 || keyframe_interval < 1 || speed <= 0 ||
+			loss < 0 || loss > 100 || datachannels < 0 || datachannels % 2 || sctp_workers < 0 ||
+			message_size < (int)sizeof(gint64) || message_size > 65535 || (datachannels > 0 && no_srtp)) {
+		char *help = g_option_context_get_help(opts, TRUE, NULL);
+		g_print("%s", help);
+		g_free(help);
+		g_option_context_free(opts);
+		exit(1);
+	}
+	g_option_context_free(opts);
+	if(datachannels == 0 && threads > publishers)
+		threads = publishers;
+	janus_log_level = log_level;
+	janus_log_init(FALSE, TRUE, NULL, NULL);
+	atexit(janus_log_destroy);
+	signal(SIGINT, janus_loadgen_handle_signal);
+	signal(SIGTERM, janus_loadgen_handle_signal);
+	signal(SIGPIPE, SIG_IGN);
+
+	JANUS_LOG(LOG_INFO, "Janus version: %d (%s)\n", janus_version, janus_version_string);
+	JANUS_LOG(LOG_INFO, "Janus commit: %s\n", janus_build_git_sha);
+	JANUS_LOG(LOG_INFO, "Compiled on:  %s\n\n", janus_build_git_time);
+
+#ifndef HAVE_SCTP
+	if(datachannels > 0) {
+		JANUS_LOG(LOG_FATAL, "Data Channels support not compiled\n");
+		exit(1);
+	}
+#endif
+	/* Initialize the core media path */
+	if(janus_loadgen_core_init() < 0)
+		exit(1);
+#ifdef HAVE_SCTP
+	if(datachannels > 0)
+		return janus_loadgen_datachannels();
+#endif
+
+	/* Load the plugin, exactly as the core would */
+	void *plugin_so = dlopen(plugin_path, RTLD_NOW | RTLD_GLOBAL);
+	if(!plugin_so) {
+		JANUS_LOG(LOG_FATAL, "Couldn't load plugin '%s': %s\n", plugin_path, dlerror());
+		exit(1);
+	}
+	create_p *create = (create_p*) dlsym(plugin_so, "create");
+	const char *dlsym_error = dlerror();
+	if(dlsym_error || create == NULL || (plugin = create()) == NULL) {
+		JANUS_LOG(LOG_FATAL, "Couldn't load symbol 'create': %s\n", dlsym_error ? dlsym_error : "??");
+		exit(1);
+	}
+	if(plugin->get_api_compatibility() < JANUS_PLUGIN_API_VERSION) {
+		JANUS_LOG(LOG_FATAL, "The '%s' plugin was compiled against an older version of the API (%d < %d)\n",
+			plugin->get_package(), plugin->get_api_compatibility(), JANUS_PLUGIN_API_VERSION);
+		exit(1);
+	}
+	const char *package = plugin->get_package();
+	if(!strcasecmp(package, "janus.plugin.videoroom")) {
+		scenario = janus_loadgen_videoroom;
+	} else if(!strcasecmp(package, "janus.plugin.audiobridge")) {
+		scenario = janus_loadgen_audiobridge;
+		no_video = TRUE;
+	} else if(!strcasecmp(package, "janus.plugin.streaming")) {
+		scenario = janus_loadgen_streaming;
+	} else {
+		JANUS_LOG(LOG_FATAL, "Unsupported plugin '%s' (only VideoRoom, AudioBridge and Streaming are supported)\n", package);
+		exit(1);
+	}
+	if(negotiations > 0 && scenario != janus_loadgen_videoroom) {
+		JANUS_LOG(LOG_FATAL, "Negotiations can only be measured with the VideoRoom plugin\n");
+		exit(1);
+	}
+	if(plugin->init(&janus_loadgen_callbacks, configs_folder ? configs_folder : "/nonexistent") < 0) {
+		JANUS_LOG(LOG_FATAL, "The '%s' plugin could not be initialized\n", package);
+		exit(1);
+	}
+
+	/* Create the handles and PeerConnections, and negotiate them */
+	peers_num = publishers + subscribers;
+	peers = g_malloc0(peers_num * sizeof(janus_loadgen_peer *));
+	int i = 0;
+	for(i=0; i<peers_num; i++)
+		peers[i] = janus_loadgen_peer_create(i, i < publishers);
+	JANUS_LOG(LOG_INFO, "Setting up %d publishers and %d subscribers (%s)...\n", publishers, subscribers, plugin->get_name());
+	int res = -1;
+	if(scenario == janus_loadgen_videoroom)
+		res = janus_loadgen_setup_videoroom();
+	else if(scenario == janus_loadgen_audiobridge)
+		res = janus_loadgen_setup_audiobridge();
+	else
+		res = janus_loadgen_setup_streaming();
+	if(res < 0) {
+		JANUS_LOG(LOG_FATAL, "Error setting up the scenario\n");
+		exit(1);
+	}
+
+	if(negotiations > 0) {
+		/* We only measure how fast the first publisher can renegotiate */
+		JANUS_LOG(LOG_INFO, "Performing %d renegotiations per test...\n", negotiations);
+		json_t *results = janus_loadgen_negotiations(peers[0]);
+		janus_loadgen_teardown();
+		if(json_output) {
+			char *text = json_dumps(results, JSON_INDENT(3) | JSON_PRESERVE_ORDER);
+			g_print("%s\n", text);
+			free(text);
+		} else {
+			g_print("%s: publisher renegotiations\n", plugin->get_name());
+			size_t index = 0;
+			json_t *value = NULL;
+			json_array_foreach(results, index, value) {
+				g_print("  %2d m-lines, %-6s SDP: %d negotiations, %.1f/s\n",
+					(int)json_integer_value(json_object_get(value, "mlines")),
+					json_string_value(json_object_get(value, "sdp")),
+					(int)json_integer_value(json_object_get(value, "negotiations")),
+					json_real_value(json_object_get(value, "per-second")));
+			}
+		}
+		res = json_array_size(results) > 0 ? 0 : 1;
+		json_decref(results);
+		janus_loadgen_cleanup();
+		return res;
+	}
+
+	/* Start injecting packets */
+	janus_loadgen_cpu cpu_start[1024], cpu_end[1024];
+	int cores = janus_loadgen_cpu_read(cpu_start, 1024);
+	struct rusage usage_start, usage_end;
+	getrusage(RUSAGE_SELF, &usage_start);
+	gint64 run_start = janus_get_monotonic_time();
+	janus_loadgen_thread *workers = g_malloc0(threads * sizeof(janus_loadgen_thread));
+	for(i=0; i<threads; i++) {
+		workers[i].index = i;
+		char tname[16];
+		g_snprintf(tname, sizeof(tname), "loadgen %d", i);
+		workers[i].thread = g_thread_try_new(tname, janus_loadgen_thread_func, &workers[i], &error);
+		if(error != NULL) {
+			JANUS_LOG(LOG_FATAL, "Got error %d (%s) trying to launch the injecting thread...\n",
+				error->code, error->message ? error->message : "??");
+			exit(1);
+		}
+	}
+	JANUS_LOG(LOG_INFO, "Running for %d seconds...\n", duration);
+	gint64 run_end = run_start + (gint64)duration * G_USEC_PER_SEC;
+	while(g_atomic_int_get(&working) && janus_get_monotonic_time() < run_end)
+		g_usleep(100000);
+	g_atomic_int_set(&working, 0);
+	for(i=0; i<threads; i++)
+		g_thread_join(workers[i].thread);
+	/* Give the core a moment to send what's still queued */
+	g_usleep(200000);
+	gint64 elapsed = janus_get_monotonic_time() - run_start;
+	getrusage(RUSAGE_SELF, &usage_end);
+	janus_loadgen_cpu_read(cpu_end, 1024);
+
+	/* Tear everything down */
+	janus_loadgen_teardown();
+
+	/* Gather the results */
+	guint64 packets_in = 0, bytes_in = 0, errors_in = 0, dropped_in = 0, packets_out = 0, bytes_out = 0,
+		errors_out = 0, rtx_out = 0, lost_out = 0, rtcp_out = 0, plis = 0, nacks = 0, twcc = 0;
+	GArray *latencies = g_array_new(FALSE, FALSE, sizeof(guint32));
+	for(i=0; i<peers_num; i++) {
+		janus_loadgen_peer *peer = peers[i];
+		packets_in += peer->packets_in;
+		bytes_in += peer->bytes_in;
+		errors_in += peer->errors_in;
+		dropped_in += peer->dropped_in;
+		janus_mutex_lock(&peer->mutex);
+		packets_out += peer->packets_out;
+		bytes_out += peer->bytes_out;
+		errors_out += peer->errors_out;
+		rtx_out += peer->rtx_out;
+		lost_out += peer->lost_out;
+		rtcp_out += peer->rtcp_out;
+		plis += peer->plis;
+		nacks += peer->nacks;
+		twcc += peer->twcc;
+		g_array_append_vals(latencies, peer->latencies->data, peer->latencies->len);
+		janus_mutex_unlock(&peer->mutex);
+	}
+	guint32 p50 = 0, p90 = 0, p99 = 0, p999 = 0, pmax = 0;
+	if(latencies->len > 0) {
+		qsort(latencies->data, latencies->len, sizeof(guint32), janus_loadgen_compare_latency);
+		guint32 *l = (guint32 *)latencies->data;
+		guint last = latencies->len - 1;
+		p50 = l[(guint64)last * 500 / 1000];
+		p90 = l[(guint64)last * 900 / 1000];
+		p99 = l[(guint64)last * 990 / 1000];
+		p999 = l[(guint64)last * 999 / 1000];
+		pmax = l[last];
+	}
+	double seconds = (double)elapsed / G_USEC_PER_SEC;
+	double cpu_user = (usage_end.ru_utime.tv_sec - usage_start.ru_utime.tv_sec) +
+		(double)(usage_end.ru_utime.tv_usec - usage_start.ru_utime.tv_usec) / G_USEC_PER_SEC;
+	double cpu_system = (usage_end.ru_stime.tv_sec - usage_start.ru_stime.tv_sec) +
+		(double)(usage_end.ru_stime.tv_usec - usage_start.ru_stime.tv_usec) / G_USEC_PER_SEC;
+	double cpu_peers = 0;
+	for(i=0; i<threads; i++)
+		cpu_peers += (double)workers[i].peer_cpu / G_USEC_PER_SEC;
+
+	json_t *results = json_object();
+	json_object_set_new(results, "plugin", json_string(package));
+	json_object_set_new(results, "publishers", json_integer(publishers));
+	json_object_set_new(results, "subscribers", json_integer(subscribers));
+	json_object_set_new(results, "event-loops", json_integer(event_loops));
+	json_object_set_new(results, "loss", json_integer(loss));
+	json_object_set_new(results, "seed", json_integer(seed));
+	json_object_set_new(results, "duration", json_real(seconds));
+	json_t *in = json_object();
+	json_object_set_new(in, "packets", json_integer(packets_in));
+	json_object_set_new(in, "bytes", json_integer(bytes_in));
+	json_object_set_new(in, "errors", json_integer(errors_in));
+	json_object_set_new(in, "dropped", json_integer(dropped_in));
+	json_object_set_new(in, "pps", json_real(packets_in / seconds));
+	json_object_set_new(in, "mbps", json_real(bytes_in * 8 / seconds / 1000000));
+	json_object_set_new(results, "in", in);
+	json_t *out = json_object();
+	json_object_set_new(out, "packets", json_integer(packets_out));
+	json_object_set_new(out, "bytes", json_integer(bytes_out));
+	json_object_set_new(out, "errors", json_integer(errors_out));
+	json_object_set_new(out, "retransmissions", json_integer(rtx_out));
+	json_object_set_new(out, "lost", json_integer(lost_out));
+	json_object_set_new(out, "pps", json_real(packets_out / seconds));
+	json_object_set_new(out, "mbps", json_real(bytes_out * 8 / seconds / 1000000));
+	json_t *rtcp = json_object();
+	json_object_set_new(rtcp, "packets", json_integer(rtcp_out));
+	json_object_set_new(rtcp, "plis", json_integer(plis));
+	json_object_set_new(rtcp, "nacks", json_integer(nacks));
+	json_object_set_new(rtcp, "twcc", json_integer(twcc));
+	json_object_set_new(out, "rtcp", rtcp);
+	json_object_set_new(results, "out", out);
+	if(latencies->len > 0) {
+		json_t *latency = json_object();
+		json_object_set_new(latency, "samples", json_integer(latencies->len));
+		json_object_set_new(latency, "p50", json_integer(p50));
+		json_object_set_new(latency, "p90", json_integer(p90));
+		json_object_set_new(latency, "p99", json_integer(p99));
+		json_object_set_new(latency, "p99.9", json_integer(p999));
+		json_object_set_new(latency, "max", json_integer(pmax));
+		json_object_set_new(results, "latency-us", latency);
+	}
+	json_t *cpu = json_object();
+	json_object_set_new(cpu, "user", json_real(cpu_user));
+	json_object_set_new(cpu, "system", json_real(cpu_system));
+	json_object_set_new(cpu, "peers", json_real(cpu_peers));
+	json_object_set_new(cpu, "usage", json_real((cpu_user + cpu_system) * 100 / seconds));
+	json_t *per_core = json_array();
+	for(i=0; i<cores; i++) {
+		guint64 busy = cpu_end[i].busy - cpu_start[i].busy, total = cpu_end[i].total - cpu_start[i].total;
+		json_array_append_new(per_core, json_real(total ? (double)busy * 100 / total : 0));
+	}
+	json_object_set_new(cpu, "cores", per_core);
+	json_object_set_new(results, "cpu", cpu);
+
+	if(json_output) {
+		char *text = json_dumps(results, JSON_INDENT(3) | JSON_PRESERVE_ORDER);
+		g_print("%s\n", text);
+		free(text);
+	} else {
+		g_print("%s: %d publishers, %d subscribers, %d event loops, %d%% loss, %.2fs (seed %"SCNi64")\n",
+			plugin->get_name(), publishers, subscribers, event_loops, loss, seconds, seed);
+		g_print("  In:      %"SCNu64" packets (%.0f pps, %.2f Mbps), %"SCNu64" errors, %"SCNu64" dropped\n",
+			packets_in, packets_in / seconds, bytes_in * 8 / seconds / 1000000, errors_in, dropped_in);
+		g_print("  Out:     %"SCNu64" packets (%.0f pps, %.2f Mbps), %"SCNu64" errors, %"SCNu64" retransmissions, %"SCNu64" lost\n",
+			packets_out, packets_out / seconds, bytes_out * 8 / seconds / 1000000, errors_out, rtx_out, lost_out);
+		g_print("  RTCP:    %"SCNu64" packets, %"SCNu64" PLIs, %"SCNu64" NACKs, %"SCNu64" transport-wide CC feedbacks\n",
+			rtcp_out, plis, nacks, twcc);
+		if(latencies->len > 0) {
+			g_print("  Latency: p50=%"SCNu32"us p90=%"SCNu32"us p99=%"SCNu32"us p99.9=%"SCNu32"us max=%"SCNu32"us (%u samples)\n",
+				p50, p90, p99, p999, pmax, latencies->len);
+		} else {
+			g_print("  Latency: n/a\n");
+		}
+		g_print("  CPU:     %.2fs user, %.2fs system (%.1f%%), of which %.2fs spent generating packets\n",
+			cpu_user, cpu_system, (cpu_user + cpu_system) * 100 / seconds, cpu_peers);
+		for(i=0; i<cores; i++) {
+			guint64 busy = cpu_end[i].busy - cpu_start[i].busy, total = cpu_end[i].total - cpu_start[i].total;
+			g_print("    cpu%-3d %5.1f%%\n", i, total ? (double)busy * 100 / total : 0);
+		}
+	}
+	json_decref(results);
+
+	g_array_free(latencies, TRUE);
+	g_free(workers);
+	janus_loadgen_cleanup();
+
+	return 0;
+}
@@ -189,6 +189,9 @@ static struct janus_json_parameter text2pcap_parameters[] = {
 	{"filename", JSON_STRING, 0},
 	{"truncate", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE}
 };
+static struct janus_json_parameter migratehandle_parameters[] = {
+	{"loop_index", JSON_INTEGER, JANUS_JSON_PARAM_REQUIRED | JANUS_JSON_PARAM_POSITIVE}
+};
 static struct janus_json_parameter handleinfo_parameters[] = {
 	{"plugin_only", JANUS_JSON_BOOL, 0}
 };
@@ -337,6 +340,7 @@ static json_t *janus_info(const char *transaction) {
 		json_object_set_new(info, "log-path", json_string(janus_log_get_logfile_path()));
 #ifdef HAVE_SCTP
 	json_object_set_new(info, "data_channels", json_true());
+	json_object_set_new(info, "data_channels_workers", janus_sctp_get_stats());
 #else
 	json_object_set_new(info, "data_channels", json_false());
 #endif
@@ -363,6 +367,8 @@ static json_t *janus_info(const char *transaction) {
 		json_object_set_new(info, "ipv6-link-local", janus_ice_is_ipv6_linklocal_enabled() ? json_true() : json_false());
 	json_object_set_new(info, "ice-lite", janus_ice_is_ice_lite_enabled() ? json_true() : json_false());
 	json_object_set_new(info, "ice-tcp", janus_ice_is_ice_tcp_enabled() ? json_true() : json_false());
+	if(janus_ice_is_single_port_enabled())
+		json_object_set_new(info, "ice-single-port", json_integer(janus_ice_get_single_port()));
 #ifdef HAVE_ICE_NOMINATION
 	json_object_set_new(info, "ice-nomination", json_string(janus_ice_get_nomination_mode()));
 #endif
@@ -374,9 +380,12 @@ static json_t *janus_info(const char *transaction) {
 	json_object_set_new(info, "min-nack-queue", json_integer(janus_get_min_nack_queue()));
 	json_object_set_new(info, "nack-optimizations", janus_is_nack_optimizations_enabled() ? json_true() : json_false());
 	json_object_set_new(info, "twcc-period", json_integer(janus_get_twcc_period()));
+	if(janus_get_pacing_multiplier() > 0)
+		json_object_set_new(info, "pacing-multiplier", json_real(janus_get_pacing_multiplier()));
 	if(janus_get_dscp() > 0)
 		json_object_set_new(info, "dscp", json_integer(janus_get_dscp()));
 	json_object_set_new(info, "dtls-mtu", json_integer(janus_dtls_bio_agent_get_mtu()));
+	json_object_set_new(info, "dtls-handshakes", janus_dtls_get_handshake_stats());
 	if(janus_ice_get_stun_server() != NULL) {
 		char server[255];
 		g_snprintf(server, 255, "%s:%"SCNu16, janus_ice_get_stun_server(), janus_ice_get_stun_port());
@@ -387,6 +396,9 @@ static json_t *janus_info(const char *transaction) {
 		g_snprintf(server, 255, "%s:%"SCNu16, janus_ice_get_turn_server(), janus_ice_get_turn_port());
 		json_object_set_new(info, "turn-server", json_string(server));
 	}
+	json_t *turnrest_stats = janus_ice_get_turn_rest_api_stats();
+	if(turnrest_stats != NULL)
+		json_object_set_new(info, "turn-rest-api", turnrest_stats);
 	if(janus_ice_is_force_relay_allowed())
 		json_object_set_new(info, "allow-force-relay", json_true());
 	json_object_set_new(info, "static-event-loops", json_integer(janus_ice_get_static_event_loops()));
@@ -453,6 +465,8 @@ static json_t *janus_info(const char *transaction) {
 			json_object_set_new(eventhandler, "description", json_string(e->get_description()));
 			json_object_set_new(eventhandler, "version_string", json_string(e->get_version_string()));
 			json_object_set_new(eventhandler, "version", json_integer(e->get_version()));
+			if(janus_events_is_stats_aggregated(e->get_package()))
+				json_object_set_new(eventhandler, "stats-aggregation", json_integer(janus_events_get_stats_aggregation_window()));
 			json_object_set_new(e_data, e->get_package(), eventhandler);
 		}
 	}
@@ -614,7 +628,9 @@ void janus_transport_task(gpointer data, gpointer user_data);
  */
 ///@{
 int janus_plugin_push_event(janus_plugin_session *plugin_session, janus_plugin *plugin, const char *transaction, json_t *message, json_t *jsep);
+int janus_plugin_push_event_sdp(janus_plugin_session *plugin_session, janus_plugin *plugin, const char *transaction, json_t *message, json_t *jsep, janus_sdp *sdp);
 json_t *janus_plugin_handle_sdp(janus_plugin_session *plugin_session, janus_plugin *plugin, const char *sdp_type, const char *sdp, gboolean restart);
+json_t *janus_plugin_handle_parsed_sdp(janus_plugin_session *plugin_session, janus_plugin *plugin, const char *sdp_type, janus_sdp *parsed_sdp, gboolean restart);
 void janus_plugin_relay_rtp(janus_plugin_session *plugin_session, janus_plugin_rtp *packet);
 void janus_plugin_relay_rtcp(janus_plugin_session *plugin_session, janus_plugin_rtcp *packet);
 void janus_plugin_relay_data(janus_plugin_session *plugin_session, janus_plugin_data *message);
@@ -630,6 +646,7 @@ gboolean janus_plugin_auth_signature_contains(janus_plugin *plugin, const char *
 static janus_callbacks janus_handler_plugin =
 	{
 		.push_event = janus_plugin_push_event,
+		.push_event_sdp = janus_plugin_push_event_sdp,
 		.relay_rtp = janus_plugin_relay_rtp,
 		.relay_rtcp = janus_plugin_relay_rtcp,
 		.relay_data = janus_plugin_relay_data,
@@ -1406,6 +1423,7 @@ int janus_process_incoming_request(janus_request *request) {
 		json_t *jsep = json_object_get(root, "jsep");
 		char *jsep_type = NULL;
 		char *jsep_sdp = NULL, *jsep_sdp_stripped = NULL;
+		janus_sdp *jsep_sdp_parsed = NULL;
 		gboolean renegotiation = FALSE;
 		if(jsep != NULL) {
 			if(!json_is_object(jsep)) {
@@ -1746,6 +1764,8 @@ int janus_process_incoming_request(janus_request *request) {
 					handle->pc->dependencydesc_ext_id = janus_rtp_header_extension_get_id(jsep_sdp, JANUS_RTP_EXTMAP_DEPENDENCY_DESC);
 				}
 			}
+			/* Update the map of negotiated RTP extensions */
+			janus_ice_peerconnection_update_extmap(handle->pc);
 			char *tmp = handle->remote_sdp;
 			handle->remote_sdp = g_strdup(jsep_sdp);
 			g_free(tmp);
@@ -1759,8 +1779,13 @@ int janus_process_incoming_request(janus_request *request) {
 				janus_flags_clear(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_PROCESSING_OFFER);
 				goto jsondone;
 			}
-			jsep_sdp_stripped = janus_sdp_write(parsed_sdp);
-			janus_sdp_destroy(parsed_sdp);
+			if(plugin_t->handle_message_sdp != NULL) {
+				/* The plugin can take the parsed SDP as it is, no need to serialize it */
+				jsep_sdp_parsed = parsed_sdp;
+			} else {
+				jsep_sdp_stripped = janus_sdp_write(parsed_sdp);
+				janus_sdp_destroy(parsed_sdp);
+			}
 			sdp = NULL;
 			if(e2ee)
 				janus_flags_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_E2EE);
@@ -1770,18 +1795,21 @@ int janus_process_incoming_request(janus_request *request) {
 		/* Make sure the app handle is still valid */
 		if(handle->app == NULL || !janus_plugin_session_is_alive(handle->app_handle)) {
 			ret = janus_process_error(request, session_id, transaction_text, JANUS_ERROR_PLUGIN_MESSAGE, "No plugin to handle this message");
-			if(jsep_sdp_stripped != NULL)
+			if(jsep_sdp_stripped != NULL || jsep_sdp_parsed != NULL)
 				janus_flags_clear(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_PROCESSING_OFFER);
 			g_free(jsep_type);
 			g_free(jsep_sdp_stripped);
+			janus_sdp_destroy(jsep_sdp_parsed);
 			goto jsondone;
 		}
 
 		/* Send the message to the plugin (which must eventually free transaction_text and unref the two objects, body and jsep) */
 		json_incref(body);
 		json_t *body_jsep = NULL;
-		if(jsep_sdp_stripped) {
-			body_jsep = json_pack("{ssss}", "type", jsep_type, "sdp", jsep_sdp_stripped);
+		if(jsep_sdp_stripped || jsep_sdp_parsed) {
+			body_jsep = json_pack("{ss}", "type", jsep_type);
+			if(jsep_sdp_stripped)
+				json_object_set_new(body_jsep, "sdp", json_string(jsep_sdp_stripped));
 			/* Check if simulcasting is enabled in one of the media streams */
 			janus_mutex_lock(&handle->mutex);
 			if(handle->pc == NULL) {
@@ -1790,6 +1818,7 @@ int janus_process_incoming_request(janus_request *request) {
 				json_decref(body_jsep);
 				g_free(jsep_type);
 				g_free(jsep_sdp_stripped);
+				janus_sdp_destroy(jsep_sdp_parsed);
 				janus_flags_clear(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_PROCESSING_OFFER);
 				janus_mutex_unlock(&handle->mutex);
 				goto jsondone;
@@ -1844,8 +1873,15 @@ int janus_process_incoming_request(janus_request *request) {
 			if(janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_E2EE))
 				json_object_set_new(body_jsep, "e2ee", json_true());
 		}
-		janus_plugin_result *result = plugin_t->handle_message(handle->app_handle,
-			g_strdup((char *)transaction_text), body, body_jsep);
+		janus_plugin_result *result = NULL;
+		if(jsep_sdp_parsed != NULL) {
+			/* The plugin will own the parsed SDP too */
+			result = plugin_t->handle_message_sdp(handle->app_handle,
+				g_strdup((char *)transaction_text), body, body_jsep, jsep_sdp_parsed);
+		} else {
+			result = plugin_t->handle_message(handle->app_handle,
+				g_strdup((char *)transaction_text), body, body_jsep);
+		}
 		g_free(jsep_type);
 		g_free(jsep_sdp_stripped);
 		if(result == NULL) {
@@ -2955,6 +2991,33 @@ int janus_process_incoming_admin_request(janus_request *request) {
 			/* Send the success reply */
 			ret = janus_process_success(request, reply);
 			goto jsondone;
+		} else if(!strcasecmp(message_text, "migrate_handle")) {
+			/* Move the handle to a different static event loop */
+			JANUS_VALIDATE_JSON_OBJECT(root, migratehandle_parameters,
+				error_code, error_cause, FALSE,
+				JANUS_ERROR_MISSING_MANDATORY_ELEMENT, JANUS_ERROR_INVALID_ELEMENT_TYPE);
+			if(error_code != 0) {
+				ret = janus_process_error_string(request, session_id, transaction_text, error_code, error_cause);
+				goto jsondone;
+			}
+			if(janus_ice_get_static_event_loops() < 1) {
+				ret = janus_process_error(request, session_id, transaction_text, JANUS_ERROR_UNKNOWN, "Static event loops not enabled");
+				goto jsondone;
+			}
+			int loop_index = json_integer_value(json_object_get(root, "loop_index"));
+			int res = janus_ice_handle_migrate(handle, loop_index);
+			if(res == -2) {
+				ret = janus_process_error(request, session_id, transaction_text, JANUS_ERROR_INVALID_ELEMENT_TYPE, "Invalid loop index %d", loop_index);
+				goto jsondone;
+			} else if(res < 0) {
+				ret = janus_process_error(request, session_id, transaction_text, JANUS_ERROR_UNKNOWN, "Can't migrate the handle while the PeerConnection is being set up");
+				goto jsondone;
+			}
+			/* Prepare JSON reply */
+			json_t *reply = janus_create_message("success", session_id, transaction_text);
+			/* Send the success reply */
+			ret = janus_process_success(request, reply);
+			goto jsondone;
 		} else if(!strcasecmp(message_text, "start_pcap") || !strcasecmp(message_text, "start_text2pcap")) {
 			/* Start dumping RTP and RTCP packets to a pcap or text2pcap file */
 			JANUS_VALIDATE_JSON_OBJECT(root, text2pcap_parameters,
@@ -3243,6 +3306,12 @@ json_t *janus_admin_peerconnection_summary(janus_ice_peerconnection *pc) {
 #ifdef HAVE_SCTP
 		/* FIXME Actually check if this succeeded? */
 		json_object_set_new(d, "sctp-association", dtls->sctp ? json_true() : json_false());
+		janus_sctp_association *sctp = dtls->sctp;
+		if(sctp != NULL) {
+			janus_refcount_increase(&sctp->ref);
+			json_object_set_new(d, "sctp-stats", janus_sctp_association_stats(sctp));
+			janus_refcount_decrease(&sctp->ref);
+		}
 #endif
 		json_t *stats = json_object();
 		json_t *in_stats = json_object();
@@ -3284,7 +3353,31 @@ json_t *janus_admin_peerconnection_summary(janus_ice_peerconnection *pc) {
 	json_object_set_new(bwe, "twcc", pc->do_transport_wide_cc ? json_true() : json_false());
 	if(pc->transport_wide_cc_ext_id >= 0)
 		json_object_set_new(bwe, "twcc-ext-id", json_integer(pc->transport_wide_cc_ext_id));
+	/* The estimator and the pacer belong to the loop, so we only look at the snapshot it publishes */
+	janus_ice_peerconnection_bwe_snapshot snapshot;
+	janus_ice_peerconnection_get_bwe_snapshot(pc, &snapshot);
+	if(snapshot.bwe) {
+		json_object_set_new(bwe, "estimate", json_integer(snapshot.estimate));
+		json_object_set_new(bwe, "acked", json_integer(snapshot.acked_bitrate));
+		json_object_set_new(bwe, "status", json_string(janus_bwe_status_str(snapshot.status)));
+		json_object_set_new(bwe, "loss", json_real(snapshot.loss));
+	}
 	json_object_set_new(w, "bwe", bwe);
+	if(snapshot.pacer) {
+		json_t *pacer = json_object();
+		json_object_set_new(pacer, "rate", json_integer(snapshot.rate));
+		json_object_set_new(pacer, "queued-packets", json_integer(snapshot.queued_packets));
+		json_object_set_new(pacer, "queued-bytes", json_integer(snapshot.queued_bytes));
+		/* How long packets waited in the queue recently, in microseconds */
+		if(snapshot.delay_samples > 0) {
+			json_t *delay = json_object();
+			json_object_set_new(delay, "p50", json_integer(snapshot.delay_p50));
+			json_object_set_new(delay, "p95", json_integer(snapshot.delay_p95));
+			json_object_set_new(delay, "p99", json_integer(snapshot.delay_p99));
+			json_object_set_new(pacer, "queue-delay", delay);
+		}
+		json_object_set_new(w, "pacer", pacer);
+	}
 	json_t *media = json_object();
 	/* Iterate on all media */
 	janus_ice_peerconnection_medium *medium = NULL;
@@ -3663,7 +3756,24 @@ janus_plugin *janus_plugin_find(const gchar *package) {
 
 
 /* Plugin callback interface */
+static int janus_plugin_push_event_internal(janus_plugin_session *plugin_session, janus_plugin *plugin,
+		const char *transaction, json_t *message, json_t *jsep, janus_sdp *parsed_sdp);
 int janus_plugin_push_event(janus_plugin_session *plugin_session, janus_plugin *plugin, const char *transaction, json_t *message, json_t *jsep) {
+	return janus_plugin_push_event_internal(plugin_session, plugin, transaction, message, jsep, NULL);
+}
+
+int janus_plugin_push_event_sdp(janus_plugin_session *plugin_session, janus_plugin *plugin, const char *transaction, json_t *message, json_t *jsep, janus_sdp *sdp) {
+	if(sdp == NULL)
+		return janus_plugin_push_event_internal(plugin_session, plugin, transaction, message, jsep, NULL);
+	/* The plugin will get rid of its own reference, keep one while we use the SDP */
+	janus_refcount_increase(&sdp->ref);
+	int res = janus_plugin_push_event_internal(plugin_session, plugin, transaction, message, jsep, sdp);
+	janus_refcount_decrease(&sdp->ref);
+	return res;
+}
+
+static int janus_plugin_push_event_internal(janus_plugin_session *plugin_session, janus_plugin *plugin,
+		const char *transaction, json_t *message, json_t *jsep, janus_sdp *parsed_sdp) {
 	if(!plugin || !message)
 		return -1;
 	if(!janus_plugin_session_is_alive(plugin_session))
@@ -3691,11 +3801,15 @@ int janus_plugin_push_event(janus_plugin_session *plugin_session, janus_plugin *
 	/* Attach JSEP if possible? */
 	const char *sdp_type = json_string_value(json_object_get(jsep, "type"));
 	const char *sdp = json_string_value(json_object_get(jsep, "sdp"));
-	gboolean restart = json_object_get(jsep, "sdp") ? json_is_true(json_object_get(jsep, "restart")) : FALSE;
-	gboolean e2ee = json_object_get(jsep, "sdp") ? json_is_true(json_object_get(jsep, "e2ee")) : FALSE;
+	gboolean has_sdp = (sdp != NULL || parsed_sdp != NULL);
+	gboolean restart = has_sdp ? json_is_true(json_object_get(jsep, "restart")) : FALSE;
+	gboolean e2ee = has_sdp ? json_is_true(json_object_get(jsep, "e2ee")) : FALSE;
 	json_t *merged_jsep = NULL;
-	if(sdp_type != NULL && sdp != NULL) {
-		merged_jsep = janus_plugin_handle_sdp(plugin_session, plugin, sdp_type, sdp, restart);
+	if(sdp_type != NULL && has_sdp) {
+		if(parsed_sdp != NULL)
+			merged_jsep = janus_plugin_handle_parsed_sdp(plugin_session, plugin, sdp_type, parsed_sdp, restart);
+		else
+			merged_jsep = janus_plugin_handle_sdp(plugin_session, plugin, sdp_type, sdp, restart);
 		if(merged_jsep == NULL) {
 			if(ice_handle == NULL || janus_flags_is_set(&ice_handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_STOP)
 					|| janus_flags_is_set(&ice_handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_ALERT)) {
@@ -3759,6 +3873,30 @@ json_t *janus_plugin_handle_sdp(janus_plugin_session *plugin_session, janus_plug
 		return NULL;
 	}
 	janus_ice_handle *ice_handle = (janus_ice_handle *)plugin_session->gateway_handle;
+	if(ice_handle == NULL) {
+		JANUS_LOG(LOG_ERR, "Invalid ICE handle\n");
+		return NULL;
+	}
+	/* Is this valid SDP? */
+	char error_str[512];
+	error_str[0] = '\0';
+	janus_sdp *parsed_sdp = janus_sdp_parse(sdp, error_str, sizeof(error_str));
+	if(parsed_sdp == NULL) {
+		JANUS_LOG(LOG_ERR, "[%"SCNu64"] Couldn't parse SDP... %s\n", ice_handle->handle_id, error_str);
+		return NULL;
+	}
+	json_t *jsep = janus_plugin_handle_parsed_sdp(plugin_session, plugin, sdp_type, parsed_sdp, restart);
+	janus_sdp_destroy(parsed_sdp);
+	return jsep;
+}
+
+json_t *janus_plugin_handle_parsed_sdp(janus_plugin_session *plugin_session, janus_plugin *plugin, const char *sdp_type, janus_sdp *parsed_sdp, gboolean restart) {
+	if(!janus_plugin_session_is_alive(plugin_session) ||
+			plugin == NULL || sdp_type == NULL || parsed_sdp == NULL) {
+		JANUS_LOG(LOG_ERR, "Invalid arguments\n");
+		return NULL;
+	}
+	janus_ice_handle *ice_handle = (janus_ice_handle *)plugin_session->gateway_handle;
 	//~ if(ice_handle == NULL || janus_flags_is_set(&ice_handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_READY)) {
 	if(ice_handle == NULL) {
 		JANUS_LOG(LOG_ERR, "Invalid ICE handle\n");
@@ -3781,12 +3919,9 @@ json_t *janus_plugin_handle_sdp(janus_plugin_session *plugin_session, janus_plug
 		return NULL;
 	}
 	/* Is this valid SDP? */
-	char error_str[512];
-	error_str[0] = '\0';
 	int audio = 0, video = 0, data = 0;
-	janus_sdp *parsed_sdp = janus_sdp_preparse(ice_handle, sdp, error_str, sizeof(error_str), NULL, &audio, &video, &data);
-	if(parsed_sdp == NULL) {
-		JANUS_LOG(LOG_ERR, "[%"SCNu64"] Couldn't parse SDP... %s\n", ice_handle->handle_id, error_str);
+	if(janus_sdp_preparse_parsed(ice_handle, parsed_sdp, NULL, &audio, &video, &data) < 0) {
+		JANUS_LOG(LOG_ERR, "[%"SCNu64"] Invalid SDP\n", ice_handle->handle_id);
 		return NULL;
 	}
 	JANUS_LOG(LOG_VERB, "[%"SCNu64"] There are %d audio, %d video and %d data m-lines\n",
@@ -3804,7 +3939,6 @@ json_t *janus_plugin_handle_sdp(janus_plugin_session *plugin_session, janus_plug
 				if(waited >= 3*G_USEC_PER_SEC) {
 					JANUS_LOG(LOG_VERB, "[%"SCNu64"]   -- Waited 3 seconds, that's enough!\n", ice_handle->handle_id);
 					JANUS_LOG(LOG_ERR, "[%"SCNu64"] Still cleaning a previous session\n", ice_handle->handle_id);
-					janus_sdp_destroy(parsed_sdp);
 					return NULL;
 				}
 			}
@@ -3816,14 +3950,12 @@ json_t *janus_plugin_handle_sdp(janus_plugin_session *plugin_session, janus_plug
 			/* Process SDP in order to setup ICE locally (this is going to result in an answer from the browser) */
 			if(janus_ice_setup_local(ice_handle, FALSE, TRUE, JANUS_DTLS_ROLE_ACTPASS) < 0) {
 				JANUS_LOG(LOG_ERR, "[%"SCNu64"] Error setting ICE locally\n", ice_handle->handle_id);
-				janus_sdp_destroy(parsed_sdp);
 				janus_mutex_unlock(&ice_handle->mutex);
 				return NULL;
 			}
 			/* Create medium instances */
 			if(janus_sdp_process_local(ice_handle, parsed_sdp, FALSE) < 0) {
 				JANUS_LOG(LOG_ERR, "[%"SCNu64"] Error processing SDP\n", ice_handle->handle_id);
-				janus_sdp_destroy(parsed_sdp);
 				janus_mutex_unlock(&ice_handle->mutex);
 				return NULL;
 			}
@@ -3834,7 +3966,6 @@ json_t *janus_plugin_handle_sdp(janus_plugin_session *plugin_session, janus_plug
 				/* Check what changed */
 				if(janus_sdp_process_local(ice_handle, parsed_sdp, TRUE) < 0) {
 					JANUS_LOG(LOG_ERR, "[%"SCNu64"] Error processing SDP\n", ice_handle->handle_id);
-					janus_sdp_destroy(parsed_sdp);
 					janus_mutex_unlock(&ice_handle->mutex);
 					return NULL;
 				}
@@ -3913,6 +4044,7 @@ json_t *janus_plugin_handle_sdp(janus_plugin_session *plugin_session, janus_plug
 			ice_handle->pc->dependencydesc_ext_id = dependencydesc_ext_id;
 		if(ice_handle->pc && ice_handle->pc->videolayers_ext_id != videolayers_ext_id)
 			ice_handle->pc->videolayers_ext_id = videolayers_ext_id;
+		janus_ice_peerconnection_update_extmap(ice_handle->pc);
 		janus_mutex_unlock(&ice_handle->mutex);
 	} else {
 		/* Check if the answer does contain the mid/rid/repaired-rid/abs-send-time/twcc extmaps */
@@ -3942,7 +4074,6 @@ json_t *janus_plugin_handle_sdp(janus_plugin_session *plugin_session, janus_plug
 					if(sscanf(a->value, "%64s %64s", msid, mstid) != 2) {
 						JANUS_LOG(LOG_ERR, "[%"SCNu64"] Invalid msid on m-line #%d\n",
 							ice_handle->handle_id, m->index);
-						janus_sdp_destroy(parsed_sdp);
 						janus_mutex_unlock(&ice_handle->mutex);
 						return NULL;
 					}
@@ -4038,6 +4169,7 @@ json_t *janus_plugin_handle_sdp(janus_plugin_session *plugin_session, janus_plug
 			ice_handle->pc->abs_capture_time_ext_id = 0;
 		if(!do_video_layers_alloc && ice_handle->pc)
 			ice_handle->pc->videolayers_ext_id = 0;
+		janus_ice_peerconnection_update_extmap(ice_handle->pc);
 		janus_mutex_unlock(&ice_handle->mutex);
 	}
 	if(!updating && !janus_ice_is_full_trickle_enabled()) {
@@ -4047,12 +4179,10 @@ json_t *janus_plugin_handle_sdp(janus_plugin_session *plugin_session, janus_plug
 			if(ice_handle == NULL || janus_flags_is_set(&ice_handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_STOP)
 					|| janus_flags_is_set(&ice_handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_ALERT)) {
 				JANUS_LOG(LOG_WARN, "[%"SCNu64"] Handle detached or PC closed, giving up...!\n", ice_handle ? ice_handle->handle_id : 0);
-				janus_sdp_destroy(parsed_sdp);
 				return NULL;
 			}
 			if(ice_handle->cdone < 0) {
 				JANUS_LOG(LOG_ERR, "[%"SCNu64"] Error gathering candidates!\n", ice_handle->handle_id);
-				janus_sdp_destroy(parsed_sdp);
 				return NULL;
 			}
 			if(waiting && (waiting % 5000) == 0) {
@@ -4071,7 +4201,6 @@ json_t *janus_plugin_handle_sdp(janus_plugin_session *plugin_session, janus_plug
 	if(janus_sdp_anonymize(parsed_sdp) < 0) {
 		/* Invalid SDP */
 		JANUS_LOG(LOG_ERR, "[%"SCNu64"] Invalid SDP\n", ice_handle->handle_id);
-		janus_sdp_destroy(parsed_sdp);
 		return NULL;
 	}
 
@@ -4083,7 +4212,6 @@ json_t *janus_plugin_handle_sdp(janus_plugin_session *plugin_session, janus_plug
 	janus_ice_peerconnection *pc = ice_handle->pc;
 	if(pc == NULL) {
 		JANUS_LOG(LOG_ERR, "[%"SCNu64"] No WebRTC PeerConnection\n", ice_handle->handle_id);
-		janus_sdp_destroy(parsed_sdp);
 		janus_mutex_unlock(&ice_handle->mutex);
 		return NULL;
 	}
@@ -4186,11 +4314,9 @@ json_t *janus_plugin_handle_sdp(janus_plugin_session *plugin_session, janus_plug
 	if(sdp_merged == NULL) {
 		/* Couldn't merge SDP */
 		JANUS_LOG(LOG_ERR, "[%"SCNu64"] Error merging SDP\n", ice_handle->handle_id);
-		janus_sdp_destroy(parsed_sdp);
 		janus_mutex_unlock(&ice_handle->mutex);
 		return NULL;
 	}
-	janus_sdp_destroy(parsed_sdp);
 
 	if(!updating) {
 		if(offer) {
@@ -5100,6 +5226,8 @@ gint main(int argc, char *argv[]) {
 #ifdef HAVE_TURNRESTAPI
 	char *turn_rest_api_method = NULL;
 	uint turn_rest_api_timeout = 10;
+	uint turn_rest_api_cache = 50;
+	char *turn_rest_api_username = NULL;
 #endif
 	uint16_t rtp_min_port = 0, rtp_max_port = 0;
 	gboolean ice_lite = FALSE, ice_tcp = FALSE, full_trickle = FALSE, ipv6 = FALSE,
@@ -5227,6 +5355,18 @@ gint main(int argc, char *argv[]) {
 			turn_rest_api_timeout = rst;
 		}
 	}
+	item = janus_config_get(config, config_nat, janus_config_type_item, "turn_rest_api_cache");
+	if(item && item->value) {
+		int rcache = atoi(item->value);
+		if(rcache < 0 || rcache > 100) {
+			JANUS_LOG(LOG_WARN, "Ignoring turn_rest_api_cache as it's not a valid percentage, leaving at default (50%%)\n");
+		} else {
+			turn_rest_api_cache = rcache;
+		}
+	}
+	item = janus_config_get(config, config_nat, janus_config_type_item, "turn_rest_api_username");
+	if(item && item->value)
+		turn_rest_api_username = (char *)item->value;
 #endif
 	item = janus_config_get(config, config_nat, janus_config_type_item, "allow_force_relay");
 	if(item && item->value && janus_is_true(item->value)) {
@@ -5237,12 +5377,29 @@ gint main(int argc, char *argv[]) {
 	item = janus_config_get(config, config_general, janus_config_type_item, "event_loops");
 	if(item && item->value) {
 		int loops = atoi(item->value);
+		/* Check if the loop threads should be pinned to specific CPUs */
+		janus_config_item *affinity = janus_config_get(config, config_general, janus_config_type_item, "event_loops_affinity");
+		if(affinity && affinity->value)
+			janus_ice_set_static_event_loops_affinity(affinity->value);
 		/* Check if we should allow API calls to specify which loops to use for new handles */
 		gboolean loops_api = FALSE;
 		item = janus_config_get(config, config_general, janus_config_type_item, "allow_loop_indication");
 		if(item && item->value)
 			loops_api = janus_is_true(item->value);
 		janus_ice_set_static_event_loops(loops, loops_api);
+		/* Check if handles should be moved automatically from busy loops to idle ones */
+		uint32_t rebalance_period = 0, rebalance_threshold = 25;
+		item = janus_config_get(config, config_general, janus_config_type_item, "loops_rebalance_period");
+		if(item && item->value && janus_string_to_uint32(item->value, &rebalance_period) < 0) {
+			JANUS_LOG(LOG_WARN, "Invalid loops rebalance period, disabling\n");
+			rebalance_period = 0;
+		}
+		item = janus_config_get(config, config_general, janus_config_type_item, "loops_rebalance_threshold");
+		if(item && item->value && janus_string_to_uint32(item->value, &rebalance_threshold) < 0) {
+			JANUS_LOG(LOG_WARN, "Invalid loops rebalance threshold, using default (25%%)\n");
+			rebalance_threshold = 25;
+		}
+		janus_ice_set_static_event_loops_rebalancing(rebalance_period, rebalance_threshold);
 	}
 	/* Also check if we need a cap on the size of the task pool (default is no limit) */
 	int task_pool_size = -1;
@@ -5299,6 +5456,7 @@ gint main(int argc, char *argv[]) {
 		janus_options_destroy();
 		exit(1);
 	}
+	janus_ice_set_turn_rest_api_cache(turn_rest_api_cache, turn_rest_api_username);
 #endif
 	item = janus_config_get(config, config_nat, janus_config_type_item, "nice_debug");
 	if(item && item->value && janus_is_true(item->value)) {
@@ -5358,6 +5516,24 @@ gint main(int argc, char *argv[]) {
 			janus_set_dscp(dscp);
 		}
 	}
+	/* Check if all PeerConnections should share the same UDP port (needs the DSCP value, if any) */
+	item = janus_config_get(config, config_nat, janus_config_type_item, "ice_single_port");
+	if(item && item->value) {
+		uint16_t single_port = 0;
+		if(janus_string_to_uint16(item->value, &single_port) < 0 || single_port == 0) {
+			JANUS_LOG(LOG_WARN, "Invalid ice_single_port value, ignoring\n");
+		} else {
+			int sockets = 0;
+			item = janus_config_get(config, config_nat, janus_config_type_item, "ice_single_port_sockets");
+			if(item && item->value)
+				sockets = atoi(item->value);
+			if(janus_ice_set_single_port(single_port, sockets) < 0) {
+				JANUS_LOG(LOG_FATAL, "Couldn't enable single-port ICE mode on port %"SCNu16"\n", single_port);
+				janus_options_destroy();
+				exit(1);
+			}
+		}
+	}
 
 	/* NACK related stuff */
 	item = janus_config_get(config, config_media, janus_config_type_item, "min_nack_queue");
@@ -5404,6 +5580,16 @@ gint main(int argc, char *argv[]) {
 			janus_set_twcc_period(tp);
 		}
 	}
+	/* Pacing of outgoing video */
+	item = janus_config_get(config, config_media, janus_config_type_item, "pacing_multiplier");
+	if(item && item->value) {
+		double pm = atof(item->value);
+		if(pm < 0) {
+			JANUS_LOG(LOG_WARN, "Ignoring pacing_multiplier value as it's negative\n");
+		} else {
+			janus_set_pacing_multiplier(pm);
+		}
+	}
 
 	/* Setup OpenSSL stuff */
 	const char *server_pem;
@@ -5461,6 +5647,20 @@ gint main(int argc, char *argv[]) {
 		janus_options_destroy();
 		exit(1);
 	}
+	/* Check if DTLS handshakes should be offloaded to worker threads, and if sessions can be resumed */
+	item = janus_config_get(config, config_media, janus_config_type_item, "dtls_workers");
+	if(item && item->value) {
+		int dtls_workers = atoi(item->value);
+		if(dtls_workers < 0) {
+			JANUS_LOG(LOG_WARN, "Ignoring dtls_workers value as it's negative\n");
+		} else if(janus_dtls_set_handshake_workers(dtls_workers) < 0) {
+			janus_options_destroy();
+			exit(1);
+		}
+	}
+	item = janus_config_get(config, config_media, janus_config_type_item, "dtls_resumption");
+	if(item && item->value)
+		janus_dtls_set_session_resumption(janus_is_true(item->value));
 	/* Check if there's any custom value for the starting MTU to use in the BIO filter */
 	item = janus_config_get(config, config_media, janus_config_type_item, "dtls_mtu");
 	if(item && item->value)
@@ -5472,6 +5672,17 @@ gint main(int argc, char *argv[]) {
 		janus_options_destroy();
 		exit(1);
 	}
+	/* Check if DataChannel processing should be offloaded to worker threads */
+	item = janus_config_get(config, config_media, janus_config_type_item, "sctp_workers");
+	if(item && item->value) {
+		int sctp_workers = atoi(item->value);
+		if(sctp_workers < 0) {
+			JANUS_LOG(LOG_WARN, "Ignoring sctp_workers value as it's negative\n");
+		} else if(janus_sctp_set_workers(sctp_workers) < 0) {
+			janus_options_destroy();
+			exit(1);
+		}
+	}
 #else
 	JANUS_LOG(LOG_WARN, "Data Channels support not compiled\n");
 #endif
@@ -5563,6 +5774,34 @@ gint main(int argc, char *argv[]) {
 				if(combine)
 					JANUS_LOG(LOG_INFO, "Event handler configured to send media stats combined in a single event\n");
 			}
+			item = janus_config_get(config, config_events, janus_config_type_item, "stats_aggregation");
+			if(item && item->value) {
+				/* Check if we should aggregate media statistics, rather than sending them all */
+				int window = atoi(item->value);
+				if(window < 0) {
+					JANUS_LOG(LOG_WARN, "Invalid media statistics aggregation window, ignoring\n");
+				} else if(window > 0) {
+					const char *handlers = NULL;
+					int rtt = 0, jitter = 0, lost = 0;
+					gboolean by_opaque_id = FALSE;
+					item = janus_config_get(config, config_events, janus_config_type_item, "stats_aggregation_handlers");
+					if(item && item->value)
+						handlers = item->value;
+					item = janus_config_get(config, config_events, janus_config_type_item, "stats_aggregation_opaque_id");
+					if(item && item->value)
+						by_opaque_id = janus_is_true(item->value);
+					item = janus_config_get(config, config_events, janus_config_type_item, "stats_outlier_rtt");
+					if(item && item->value)
+						rtt = atoi(item->value);
+					item = janus_config_get(config, config_events, janus_config_type_item, "stats_outlier_jitter");
+					if(item && item->value)
+						jitter = atoi(item->value);
+					item = janus_config_get(config, config_events, janus_config_type_item, "stats_outlier_lost");
+					if(item && item->value)
+						lost = atoi(item->value);
+					janus_events_set_stats_aggregation(window, handlers, by_opaque_id, rtt, jitter, lost);
+				}
+			}
 			/* Any event handlers to ignore? */
 			item = janus_config_get(config, config_events, janus_config_type_item, "disable");
 			if(item && item->value)
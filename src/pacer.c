@@ -0,0 +1,197 @@
+/*! \file    pacer.c
+ * \author   Lorenzo Miniero <lorenzo@meetecho.com>
+ * \copyright GNU General Public License v3
+ * \brief    Outgoing media pacer
+ * \details  Implementation of a simple leaky bucket pacer, that the core
+ * can use to smooth the video it sends on a PeerConnection. Without it,
+ * packets are sent as soon as plugins relay them, which means that, e.g.,
+ * a keyframe made of many packets goes out as a single burst at line
+ * rate, which may overflow queues along the path and cause losses. The
+ * pacer queues packets and releases them at a configurable rate, keeping
+ * track of how long packets waited in the queue.
+ *
+ * \ingroup protocols
+ * \ref protocols
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "pacer.h"
+
+/* Initial size of the queue (grows as needed) */
+#define JANUS_PACER_QUEUE_SIZE		256
+/* Maximum burst we allow after an idle period, in microseconds worth of rate */
+#define JANUS_PACER_BURST_TIME		5000
+/* Whatever the rate, we always allow a full MTU worth of bits in a burst */
+#define JANUS_PACER_BURST_MIN		12000
+/* Shortest time (in microseconds) we'll try to drain a late queue in */
+#define JANUS_PACER_MIN_DRAIN		10000
+/* Window (in microseconds) we compute the input bitrate on */
+#define JANUS_PACER_INPUT_WINDOW	G_USEC_PER_SEC
+
+janus_pacer *janus_pacer_create(void) {
+	janus_pacer *pacer = g_malloc0(sizeof(janus_pacer));
+	pacer->capacity = JANUS_PACER_QUEUE_SIZE;
+	pacer->queue = g_malloc0(pacer->capacity * sizeof(janus_pacer_packet));
+	pacer->rate = JANUS_PACER_MIN_RATE;
+	/* Let the first packet go right away */
+	pacer->budget = JANUS_PACER_BURST_MIN;
+	return pacer;
+}
+
+void janus_pacer_destroy(janus_pacer *pacer, GDestroyNotify free_packet) {
+	if(pacer == NULL)
+		return;
+	if(free_packet != NULL) {
+		guint i = 0;
+		for(i=0; i<pacer->count; i++)
+			free_packet(pacer->queue[(pacer->head + i) & (pacer->capacity - 1)].data);
+	}
+	g_free(pacer->queue);
+	g_free(pacer);
+}
+
+void janus_pacer_set_rate(janus_pacer *pacer, uint32_t rate) {
+	if(pacer == NULL)
+		return;
+	pacer->rate = rate < JANUS_PACER_MIN_RATE ? JANUS_PACER_MIN_RATE : rate;
+}
+
+/* Helper to figure out the rate to use right now: if what's queued can't be sent
+ * at the configured rate before it waited too long, we temporarily go faster */
+static uint32_t janus_pacer_current_rate(janus_pacer *pacer, gint64 now) {
+	if(pacer->count == 0)
+		return pacer->rate;
+	gint64 left = JANUS_PACER_MAX_DELAY - (now - pacer->queue[pacer->head].queued);
+	if(left < JANUS_PACER_MIN_DRAIN)
+		left = JANUS_PACER_MIN_DRAIN;
+	guint64 needed = (guint64)pacer->queued_bytes * 8 * G_USEC_PER_SEC / left;
+	return needed > pacer->rate ? (uint32_t)needed : pacer->rate;
+}
+
+/* Helper to add to the budget what we earned since the last refill */
+static void janus_pacer_refill(janus_pacer *pacer, gint64 now) {
+	if(pacer->last_refill == 0 || now <= pacer->last_refill) {
+		if(pacer->last_refill == 0)
+			pacer->last_refill = now;
+		return;
+	}
+	uint32_t rate = janus_pacer_current_rate(pacer, now);
+	pacer->budget += (gint64)rate * (now - pacer->last_refill) / G_USEC_PER_SEC;
+	pacer->last_refill = now;
+	/* Don't accumulate too much while idle, or we'd burst again */
+	gint64 max_budget = (gint64)rate * JANUS_PACER_BURST_TIME / G_USEC_PER_SEC;
+	if(max_budget < JANUS_PACER_BURST_MIN)
+		max_budget = JANUS_PACER_BURST_MIN;
+	if(pacer->budget > max_budget)
+		pacer->budget = max_budget;
+}
+
+/* Helper to keep track of the bitrate of what we're asked to send */
+static void janus_pacer_update_input(janus_pacer *pacer, int size, gint64 now) {
+	if(pacer->input_start == 0)
+		pacer->input_start = now;
+	pacer->input_bytes += size;
+	if(now - pacer->input_start >= JANUS_PACER_INPUT_WINDOW) {
+		pacer->input_bitrate = (uint32_t)((guint64)pacer->input_bytes * 8 * G_USEC_PER_SEC / (now - pacer->input_start));
+		pacer->input_bytes = 0;
+		pacer->input_start = now;
+	}
+}
+
+void janus_pacer_enqueue(janus_pacer *pacer, gpointer packet, int size, gint64 now) {
+	if(pacer == NULL || packet == NULL)
+		return;
+	if(pacer->count == pacer->capacity) {
+		/* The queue is full, make it larger (unrolling the circular buffer) */
+		guint capacity = pacer->capacity * 2;
+		janus_pacer_packet *queue = g_malloc0(capacity * sizeof(janus_pacer_packet));
+		guint first = pacer->capacity - pacer->head;
+		memcpy(queue, pacer->queue + pacer->head, first * sizeof(janus_pacer_packet));
+		memcpy(queue + first, pacer->queue, pacer->head * sizeof(janus_pacer_packet));
+		g_free(pacer->queue);
+		pacer->queue = queue;
+		pacer->capacity = capacity;
+		pacer->head = 0;
+	}
+	janus_pacer_packet *p = &pacer->queue[(pacer->head + pacer->count) & (pacer->capacity - 1)];
+	p->data = packet;
+	p->size = size;
+	p->queued = now;
+	pacer->count++;
+	pacer->queued_bytes += size;
+	janus_pacer_update_input(pacer, size, now);
+}
+
+void janus_pacer_bypass(janus_pacer *pacer, int size, gint64 now) {
+	if(pacer == NULL)
+		return;
+	/* The packet was sent already, but it still consumes our budget */
+	janus_pacer_refill(pacer, now);
+	pacer->budget -= (gint64)size * 8;
+}
+
+gpointer janus_pacer_dequeue(janus_pacer *pacer, gint64 now) {
+	if(pacer == NULL || pacer->count == 0)
+		return NULL;
+	janus_pacer_refill(pacer, now);
+	janus_pacer_packet *p = &pacer->queue[pacer->head];
+	gint64 waited = now - p->queued;
+	if(pacer->budget <= 0 && waited < JANUS_PACER_MAX_DELAY)
+		return NULL;
+	/* Send this packet */
+	gpointer packet = p->data;
+	pacer->budget -= (gint64)p->size * 8;
+	pacer->queued_bytes -= p->size;
+	p->data = NULL;
+	pacer->head = (pacer->head + 1) & (pacer->capacity - 1);
+	pacer->count--;
+	/* Keep track of how long it waited */
+	pacer->delays[pacer->delays_index] = (guint32)(waited > 0 ? waited : 0);
+	pacer->delays_index = (pacer->delays_index + 1) % JANUS_PACER_DELAY_SAMPLES;
+	if(pacer->delays_count < JANUS_PACER_DELAY_SAMPLES)
+		pacer->delays_count++;
+	return packet;
+}
+
+gint64 janus_pacer_next(janus_pacer *pacer, gint64 now) {
+	if(pacer == NULL || pacer->count == 0)
+		return -1;
+	janus_pacer_refill(pacer, now);
+	if(pacer->budget > 0)
+		return 0;
+	/* How long until the budget is positive again, or the first packet waited too long */
+	gint64 wait = (-pacer->budget * G_USEC_PER_SEC) / janus_pacer_current_rate(pacer, now) + 1;
+	gint64 left = JANUS_PACER_MAX_DELAY - (now - pacer->queue[pacer->head].queued);
+	if(left < 0)
+		left = 0;
+	return wait < left ? wait : left;
+}
+
+static int janus_pacer_delay_compare(const void *a, const void *b) {
+	guint32 da = *(const guint32 *)a, db = *(const guint32 *)b;
+	return (da > db) - (da < db);
+}
+
+guint janus_pacer_delay_percentiles(janus_pacer *pacer, guint32 *p50, guint32 *p95, guint32 *p99) {
+	if(p50)
+		*p50 = 0;
+	if(p95)
+		*p95 = 0;
+	if(p99)
+		*p99 = 0;
+	if(pacer == NULL || pacer->delays_count == 0)
+		return 0;
+	guint count = pacer->delays_count;
+	guint32 delays[JANUS_PACER_DELAY_SAMPLES];
+	memcpy(delays, pacer->delays, count * sizeof(guint32));
+	qsort(delays, count, sizeof(guint32), janus_pacer_delay_compare);
+	if(p50)
+		*p50 = delays[(count - 1) * 50 / 100];
+	if(p95)
+		*p95 = delays[(count - 1) * 95 / 100];
+	if(p99)
+		*p99 = delays[(count - 1) * 99 / 100];
+	return count;
+}
@@ -0,0 +1,107 @@
+/*! \file    pacer.h
+ * \author   Lorenzo Miniero <lorenzo@meetecho.com>
+ * \copyright GNU General Public License v3
+ * \brief    Outgoing media pacer (headers)
+ * \details  Implementation of a simple leaky bucket pacer, that the core
+ * can use to smooth the video it sends on a PeerConnection. Without it,
+ * packets are sent as soon as plugins relay them, which means that, e.g.,
+ * a keyframe made of many packets goes out as a single burst at line
+ * rate, which may overflow queues along the path and cause losses. The
+ * pacer queues packets and releases them at a configurable rate, keeping
+ * track of how long packets waited in the queue.
+ *
+ * \ingroup protocols
+ * \ref protocols
+ */
+
+#ifndef JANUS_PACER_H
+#define JANUS_PACER_H
+
+#include <glib.h>
+
+/*! \brief Lowest rate we'll ever pace at, in bits per second */
+#define JANUS_PACER_MIN_RATE		500000
+/*! \brief Maximum time, in microseconds, a packet should wait in the queue: the pacer goes
+ * faster than the configured rate when needed to respect it, and sends late packets anyway */
+#define JANUS_PACER_MAX_DELAY		250000
+/*! \brief Number of queue delay samples we keep to compute percentiles */
+#define JANUS_PACER_DELAY_SAMPLES	512
+
+/*! \brief Packet waiting in the pacer queue */
+typedef struct janus_pacer_packet {
+	/*! \brief Opaque packet, owned by whoever enqueued it */
+	gpointer data;
+	/*! \brief Size of the packet, in bytes */
+	int size;
+	/*! \brief When the packet was enqueued (monotonic time) */
+	gint64 queued;
+} janus_pacer_packet;
+
+/*! \brief Leaky bucket pacer
+ * @note The pacer is not thread safe: the core only uses it from the
+ * loop of the handle that owns the PeerConnection */
+typedef struct janus_pacer {
+	/*! \brief Circular queue of packets waiting to be sent */
+	janus_pacer_packet *queue;
+	/*! \brief Size of the circular queue (a power of 2), index of the first packet, and number of packets */
+	guint capacity, head, count;
+	/*! \brief Bytes currently waiting in the queue */
+	guint32 queued_bytes;
+	/*! \brief Rate we're pacing at, in bits per second */
+	uint32_t rate;
+	/*! \brief Bits we can currently send (may be negative, if we're in debt) */
+	gint64 budget;
+	/*! \brief When we last refilled the budget */
+	gint64 last_refill;
+	/*! \brief Bytes enqueued in the current window, and when the window started */
+	guint32 input_bytes;
+	gint64 input_start;
+	/*! \brief Bitrate of what's being enqueued, in bits per second */
+	uint32_t input_bitrate;
+	/*! \brief Circular history of how long packets waited in the queue, in microseconds */
+	guint32 delays[JANUS_PACER_DELAY_SAMPLES];
+	/*! \brief Number of delay samples, and where the next one goes */
+	guint delays_count, delays_index;
+} janus_pacer;
+
+/*! \brief Helper to create a new pacer
+ * @returns A new janus_pacer instance */
+janus_pacer *janus_pacer_create(void);
+/*! \brief Helper to destroy a pacer
+ * @param[in] pacer The janus_pacer instance to destroy
+ * @param[in] free_packet Function to invoke on the packets still in the queue, if any */
+void janus_pacer_destroy(janus_pacer *pacer, GDestroyNotify free_packet);
+/*! \brief Helper to change the rate a pacer releases packets at
+ * @param[in] pacer The janus_pacer instance to update
+ * @param[in] rate The new rate, in bits per second (JANUS_PACER_MIN_RATE at the very least) */
+void janus_pacer_set_rate(janus_pacer *pacer, uint32_t rate);
+/*! \brief Helper to add a packet to the queue
+ * @param[in] pacer The janus_pacer instance to update
+ * @param[in] packet The opaque packet to queue
+ * @param[in] size The size of the packet, in bytes
+ * @param[in] now The current monotonic time */
+void janus_pacer_enqueue(janus_pacer *pacer, gpointer packet, int size, gint64 now);
+/*! \brief Helper to account for a packet that was sent without going through the queue (e.g., a retransmission)
+ * @param[in] pacer The janus_pacer instance to update
+ * @param[in] size The size of the packet, in bytes
+ * @param[in] now The current monotonic time */
+void janus_pacer_bypass(janus_pacer *pacer, int size, gint64 now);
+/*! \brief Helper to get the next packet to send, if the budget allows for it
+ * @param[in] pacer The janus_pacer instance to query
+ * @param[in] now The current monotonic time
+ * @returns The opaque packet to send, or NULL if there's nothing to send right now */
+gpointer janus_pacer_dequeue(janus_pacer *pacer, gint64 now);
+/*! \brief Helper to figure out when the next packet can be sent
+ * @param[in] pacer The janus_pacer instance to query
+ * @param[in] now The current monotonic time
+ * @returns How many microseconds until the next packet can be sent, 0 if it can be sent right away, -1 if the queue is empty */
+gint64 janus_pacer_next(janus_pacer *pacer, gint64 now);
+/*! \brief Helper to compute percentiles of the time packets recently waited in the queue
+ * @param[in] pacer The janus_pacer instance to query
+ * @param[out] p50 The median delay, in microseconds
+ * @param[out] p95 The 95th percentile of the delay, in microseconds
+ * @param[out] p99 The 99th percentile of the delay, in microseconds
+ * @returns The number of samples the percentiles were computed on */
+guint janus_pacer_delay_percentiles(janus_pacer *pacer, guint32 *p50, guint32 *p95, guint32 *p99);
+
+#endif
@@ -38,6 +38,10 @@ room-<unique room ID>: {
 	audiolevel_event = true|false (whether to emit event to other users or not, default=false)
 	audio_active_packets = 100 (number of packets with audio level, default=100, 2 seconds)
 	audio_level_average = 25 (average value of audio level, 127=muted, 0='too loud', default=25)
+	silence_suppression = true|false (whether participants whose audio level has been above silence_threshold
+		for a while should not be decoded and mixed, and whether DTX should be used when encoding for
+		participants; requires audiolevel_ext, default=false)
+	silence_threshold = 60 (audio level, in dBov, above which a packet is considered silence, default=60)
 	default_expectedloss = percent of packets we expect participants may miss, to help with outgoing FEC (default=0, max=20; automatically used for forwarders too)
 	default_bitrate = default bitrate in bps to use for the all participants (default=0, which means libopus decides; automatically used for forwarders too)
 	denoise = true|false (whether denoising via RNNoise should be performed for each participant by default)
@@ -143,6 +147,8 @@ room-<unique room ID>: {
 	"audiolevel_event" : <true|false (whether to emit event to other users or not)>,
 	"audio_active_packets" : <number of packets with audio level (default=100, 2 seconds)>,
 	"audio_level_average" : <average value of audio level (127=muted, 0='too loud', default=25)>,
+	"silence_suppression" : <true|false, whether participants that have been quiet for a while should not be decoded and mixed, and DTX used when encoding, default=false>,
+	"silence_threshold" : <audio level above which a packet is considered silence (127=muted, 0='too loud', default=60)>,
 	"default_expectedloss" : <percent of packets we expect participants may miss, to help with outgoing FEC (default=0, max=20; automatically used for forwarders too)>,
 	"default_bitrate" : <bitrate in bps to use for the all participants (default=0, which means libopus decides; automatically used for forwarders too)>,
 	"denoise" : <true|false, whether denoising via RNNoise should be performed for each participant by default, default=false>,
@@ -1360,6 +1366,8 @@ static struct janus_json_parameter create_parameters[] = {
 	{"audiolevel_event", JANUS_JSON_BOOL, 0},
 	{"audio_active_packets", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
 	{"audio_level_average", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
+	{"silence_suppression", JANUS_JSON_BOOL, 0},
+	{"silence_threshold", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
 	{"default_expectedloss", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
 	{"default_bitrate", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
 	{"denoise", JANUS_JSON_BOOL, 0},
@@ -1532,6 +1540,8 @@ typedef struct janus_audiobridge_room {
 	int32_t default_bitrate;	/* Default bitrate to use for all Opus streams when encoding */
 	int audio_active_packets;	/* Amount of packets with audio level for checkup */
 	int audio_level_average;	/* Average audio level */
+	gboolean silence_suppression;	/* Whether participants that have been quiet for a while are not decoded and mixed, and DTX is used */
+	int silence_threshold;		/* Audio level above which a packet is considered silence */
 #ifdef HAVE_RNNOISE
 	gboolean denoise;			/* Whether we should denoise participants by default */
 #endif
@@ -1796,6 +1806,10 @@ typedef struct janus_audiobridge_participant {
 	int user_audio_active_packets; /* Participant's number of audio packets to evaluate */
 	int user_audio_level_average;	 /* Participant's average level of dBov value */
 	gboolean talking;		/* Whether this participant is currently talking (uses audio levels extension) */
+	int quiet_packets;		/* Number of consecutive packets the audio level said were silence */
+	gboolean silence_suppressed;	/* Whether we're currently not decoding this participant, because they've been quiet for a while */
+	gboolean dtx;			/* Whether DTX is currently enabled in the encoder */
+	uint16_t dtx_skipped;	/* Number of encoded packets we didn't send because of DTX (to keep sequence numbers contiguous) */
 	janus_rtp_switching_context context;	/* Needed in case the participant changes room */
 	janus_audiocodec codec;	/* Codec this participant is using (most often Opus, but G.711 is supported too) */
 	/* Plain RTP, in case this is not a WebRTC participant */
@@ -1861,6 +1875,7 @@ static void janus_audiobridge_buffer_packet_destroy(janus_audiobridge_buffer_pac
 
 static void janus_audiobridge_participant_istalking(janus_audiobridge_session *session,
 	janus_audiobridge_participant *participant, janus_plugin_rtp *packet, gboolean *silence);
+static gboolean janus_audiobridge_participant_isquiet(janus_audiobridge_participant *participant, janus_plugin_rtp *packet);
 
 static void janus_audiobridge_participant_clear_jitter_buffer(janus_audiobridge_participant *participant) {
 	if(participant->jitter) {
@@ -2277,6 +2292,9 @@ static int janus_audiobridge_resample(int16_t *input, int input_num, int input_r
 #define JITTER_BUFFER_MAX_GAP_SIZE 20
 #define JITTER_BUFFER_CHECK_USECS 1*G_USEC_PER_SEC
 #define QUEUE_IN_MAX_PACKETS 4
+/* Number of consecutive silent packets (~500ms) before we stop decoding a participant, if silence suppression is enabled */
+#define SILENCE_HANGOVER_PACKETS 25
+#define DEFAULT_SILENCE_THRESHOLD 60
 
 
 /* Error codes */
@@ -2665,6 +2683,8 @@ int janus_audiobridge_init(janus_callbacks *callback, const char *config_path) {
 			janus_config_item *audiolevel_event = janus_config_get(config, cat, janus_config_type_item, "audiolevel_event");
 			janus_config_item *audio_active_packets = janus_config_get(config, cat, janus_config_type_item, "audio_active_packets");
 			janus_config_item *audio_level_average = janus_config_get(config, cat, janus_config_type_item, "audio_level_average");
+			janus_config_item *silence_suppression = janus_config_get(config, cat, janus_config_type_item, "silence_suppression");
+			janus_config_item *silence_threshold = janus_config_get(config, cat, janus_config_type_item, "silence_threshold");
 			janus_config_item *default_expectedloss = janus_config_get(config, cat, janus_config_type_item, "default_expectedloss");
 			janus_config_item *default_bitrate = janus_config_get(config, cat, janus_config_type_item, "default_bitrate");
 			janus_config_item *denoise = janus_config_get(config, cat, janus_config_type_item, "denoise");
@@ -2765,6 +2785,20 @@ int janus_audiobridge_init(janus_callbacks *callback, const char *config_path) {
 					}
 				}
 			}
+			audiobridge->silence_suppression = FALSE;
+			if(audiobridge->audiolevel_ext && silence_suppression != NULL && silence_suppression->value != NULL)
+				audiobridge->silence_suppression = janus_is_true(silence_suppression->value);
+			if(audiobridge->silence_suppression) {
+				audiobridge->silence_threshold = DEFAULT_SILENCE_THRESHOLD;
+				if(silence_threshold != NULL && silence_threshold->value != NULL) {
+					int threshold = atoi(silence_threshold->value);
+					if(threshold > 0 && threshold <= 127) {
+						audiobridge->silence_threshold = threshold;
+					} else {
+						JANUS_LOG(LOG_WARN, "Invalid silence_threshold value provided, using default: %d\n", audiobridge->silence_threshold);
+					}
+				}
+			}
 			audiobridge->default_expectedloss = 0;
 			if(default_expectedloss != NULL && default_expectedloss->value != NULL) {
 				int expectedloss = atoi(default_expectedloss->value);
@@ -3123,6 +3157,8 @@ json_t *janus_audiobridge_query_session(janus_plugin_session *handle) {
 		if(participant->extmap_id > 0) {
 			json_object_set_new(info, "audio-level-dBov", json_integer(participant->dBov_level));
 			json_object_set_new(info, "talking", participant->talking ? json_true() : json_false());
+			if(participant->room && participant->room->silence_suppression)
+				json_object_set_new(info, "silence-suppressed", participant->silence_suppressed ? json_true() : json_false());
 		}
 		json_object_set_new(info, "fec", participant->fec ? json_true() : json_false());
 		if(participant->fec)
@@ -3253,6 +3289,8 @@ static json_t *janus_audiobridge_process_synchronous_request(janus_audiobridge_s
 		json_t *audiolevel_event = json_object_get(root, "audiolevel_event");
 		json_t *audio_active_packets = json_object_get(root, "audio_active_packets");
 		json_t *audio_level_average = json_object_get(root, "audio_level_average");
+		json_t *silence_suppression = json_object_get(root, "silence_suppression");
+		json_t *silence_threshold = json_object_get(root, "silence_threshold");
 		json_t *default_expectedloss = json_object_get(root, "default_expectedloss");
 		json_t *default_bitrate = json_object_get(root, "default_bitrate");
 		json_t *denoise = json_object_get(root, "denoise");
@@ -3406,6 +3444,19 @@ static json_t *janus_audiobridge_process_synchronous_request(janus_audiobridge_s
 					audiobridge->audio_level_average);
 			}
 		}
+		audiobridge->silence_suppression = audiobridge->audiolevel_ext && silence_suppression ? json_is_true(silence_suppression) : FALSE;
+		if(audiobridge->silence_suppression) {
+			audiobridge->silence_threshold = DEFAULT_SILENCE_THRESHOLD;
+			if(silence_threshold != NULL) {
+				int threshold = json_integer_value(silence_threshold);
+				if(threshold > 0 && threshold <= 127) {
+					audiobridge->silence_threshold = threshold;
+				} else {
+					JANUS_LOG(LOG_WARN, "Invalid silence_threshold value provided, using default: %d\n",
+						audiobridge->silence_threshold);
+				}
+			}
+		}
 		audiobridge->default_expectedloss = 0;
 		if(default_expectedloss != NULL) {
 			int expectedloss = json_integer_value(default_expectedloss);
@@ -3578,6 +3629,11 @@ static json_t *janus_audiobridge_process_synchronous_request(janus_audiobridge_s
 					g_snprintf(value, BUFSIZ, "%d", audiobridge->audio_level_average);
 					janus_config_add(config, c, janus_config_item_create("audio_level_average", value));
 				}
+				if(audiobridge->silence_suppression) {
+					janus_config_add(config, c, janus_config_item_create("silence_suppression", "true"));
+					g_snprintf(value, BUFSIZ, "%d", audiobridge->silence_threshold);
+					janus_config_add(config, c, janus_config_item_create("silence_threshold", value));
+				}
 			}
 			if(audiobridge->allow_plainrtp)
 				janus_config_add(config, c, janus_config_item_create("allow_rtp_participants", "true"));
@@ -3759,6 +3815,11 @@ static json_t *janus_audiobridge_process_synchronous_request(janus_audiobridge_s
 					g_snprintf(value, BUFSIZ, "%d", audiobridge->audio_level_average);
 					janus_config_add(config, c, janus_config_item_create("audio_level_average", value));
 				}
+				if(audiobridge->silence_suppression) {
+					janus_config_add(config, c, janus_config_item_create("silence_suppression", "true"));
+					g_snprintf(value, BUFSIZ, "%d", audiobridge->silence_threshold);
+					janus_config_add(config, c, janus_config_item_create("silence_threshold", value));
+				}
 			}
 			if(audiobridge->allow_plainrtp)
 				janus_config_add(config, c, janus_config_item_create("allow_rtp_participants", "true"));
@@ -4086,6 +4147,7 @@ static json_t *janus_audiobridge_process_synchronous_request(janus_audiobridge_s
 			json_object_set_new(rl, "pin_required", room->room_pin ? json_true() : json_false());
 			json_object_set_new(rl, "record", g_atomic_int_get(&room->record) ? json_true() : json_false());
 			json_object_set_new(rl, "muted", room->muted ? json_true() : json_false());
+			json_object_set_new(rl, "silence_suppression", room->silence_suppression ? json_true() : json_false());
 			json_object_set_new(rl, "num_participants", json_integer(g_hash_table_size(room->participants)));
 			json_array_append_new(list, rl);
 			janus_refcount_decrease(&room->ref);
@@ -7821,6 +7883,7 @@ static void *janus_audiobridge_handler(void *data) {
 					opus_encoder_destroy(participant->encoder);
 				participant->sampling_rate = audiobridge->sampling_rate;
 				participant->encoder = new_encoder;
+				participant->dtx = FALSE;
 				g_atomic_int_set(&participant->encoding, 0);
 				while(!g_atomic_int_compare_and_exchange(&participant->decoding, 0, 1))
 					g_usleep(5000);
@@ -9145,7 +9208,8 @@ static void *janus_audiobridge_participant_thread(void *data) {
 				janus_mutex_unlock(&participant->qmutex);
 				if(ret != JITTER_BUFFER_OK) {
 					/* We didn't get a packet: check if PLC can help */
-					if(!first && participant->codec == JANUS_AUDIOCODEC_OPUS && lost_packets_gap <= JITTER_BUFFER_MAX_GAP_SIZE && !participant->muted) {
+					if(!first && participant->codec == JANUS_AUDIOCODEC_OPUS && lost_packets_gap <= JITTER_BUFFER_MAX_GAP_SIZE &&
+							!participant->muted && !participant->silence_suppressed) {
 						lost_packets_gap++;
 						if(!g_atomic_int_compare_and_exchange(&participant->decoding, 0, 1)) {
 							/* This means we're cleaning up, so don't try to decode */
@@ -9216,15 +9280,24 @@ static void *janus_audiobridge_participant_thread(void *data) {
 					rtp = (janus_rtp_header *)buffer;
 					first = FALSE;
 					lost_packets_gap = 0;
+					/* Check the audio level extension to see if this is silence */
+					gboolean silence = FALSE;
+					janus_audiobridge_participant_istalking(session, participant, bpkt->rtp, &silence);
+					if(janus_audiobridge_participant_isquiet(participant, bpkt->rtp)) {
+						/* This participant has been quiet for a while, don't waste time decoding and mixing */
+						participant->last_seq = ntohs(rtp->seq_number);
+						participant->last_timestamp = ntohl(rtp->timestamp);
+						g_atomic_int_set(&participant->decoding, 0);
+						janus_audiobridge_buffer_packet_destroy(bpkt);
+						continue;
+					}
 					/* Decode the packet */
 					pkt = g_malloc(sizeof(janus_audiobridge_rtp_relay_packet));
 					pkt->data = g_malloc0(BUFFER_SAMPLES*sizeof(opus_int16));
 					pkt->ssrc = 0;
 					pkt->timestamp = ntohl(rtp->timestamp);
 					pkt->seq_number = ntohs(rtp->seq_number);
-					/* Check the audio level extension to see if this is silence */
-					pkt->silence = FALSE;
-					janus_audiobridge_participant_istalking(session, participant, bpkt->rtp, &pkt->silence);
+					pkt->silence = silence;
 					pkt->length = 0;
 					if(participant->codec == JANUS_AUDIOCODEC_OPUS) {
 						/* Opus */
@@ -9321,6 +9394,13 @@ static void *janus_audiobridge_participant_thread(void *data) {
 				janus_audiobridge_relay_rtp_packet(participant->session, outpkt);
 			} else if(g_atomic_int_get(&participant->active) && participant->encoder &&
 					g_atomic_int_compare_and_exchange(&participant->encoding, 0, 1)) {
+				/* Check if we need to enable or disable DTX (e.g., because we changed room) */
+				janus_audiobridge_room *audiobridge = participant->room;
+				gboolean dtx = audiobridge && audiobridge->silence_suppression;
+				if(dtx != participant->dtx) {
+					opus_encoder_ctl(participant->encoder, OPUS_SET_DTX(dtx ? 1 : 0));
+					participant->dtx = dtx;
+				}
 				/* Encode raw frame to Opus */
 				opus_int16 *outBuffer = (opus_int16 *)mixedpkt->data;
 				outpkt->length = opus_encode(participant->encoder, outBuffer,
@@ -9328,18 +9408,22 @@ static void *janus_audiobridge_participant_thread(void *data) {
 				g_atomic_int_set(&participant->encoding, 0);
 				if(outpkt->length < 0) {
 					JANUS_LOG(LOG_ERR, "[Opus] Ops! got an error encoding the Opus frame: %d (%s)\n", outpkt->length, opus_strerror(outpkt->length));
+				} else if(participant->dtx && outpkt->length <= 2) {
+					/* DTX kicked in, there's no need to send this packet: we'll
+					 * skip its sequence number too, to avoid gaps for the recipient */
+					participant->dtx_skipped++;
 				} else {
 					outpkt->length += 12;	/* Take the RTP header into consideration */
 					/* Update RTP header */
 					outpkt->data->version = 2;
 					outpkt->data->markerbit = 0;	/* FIXME Should be 1 for the first packet */
-					outpkt->data->seq_number = htons(mixedpkt->seq_number);
+					outpkt->data->seq_number = htons(mixedpkt->seq_number - participant->dtx_skipped);
 					outpkt->data->timestamp = htonl(mixedpkt->timestamp);
 					outpkt->data->ssrc = htonl(mixedpkt->ssrc);	/* The Janus core will fix this anyway */
 					/* Backup the actual timestamp and sequence number set by the audiobridge, in case a room is changed */
 					outpkt->ssrc = mixedpkt->ssrc;
 					outpkt->timestamp = mixedpkt->timestamp;
-					outpkt->seq_number = mixedpkt->seq_number;
+					outpkt->seq_number = mixedpkt->seq_number - participant->dtx_skipped;
 					janus_audiobridge_relay_rtp_packet(participant->session, outpkt);
 				}
 			}
@@ -9683,6 +9767,32 @@ static void janus_audiobridge_participant_istalking(janus_audiobridge_session *s
 	}
 }
 
+static gboolean janus_audiobridge_participant_isquiet(janus_audiobridge_participant *participant, janus_plugin_rtp *packet) {
+	/* Check if this participant has been quiet long enough that we can skip decoding and mixing their audio */
+	janus_audiobridge_room *audiobridge = participant->room;
+	if(audiobridge == NULL || !audiobridge->silence_suppression || participant->extmap_id < 1)
+		return FALSE;
+	int level = packet ? packet->extensions.audio_level : -1;
+	if(level == -1 || level < audiobridge->silence_threshold) {
+		/* No info on the audio level, or the participant is talking */
+		if(participant->silence_suppressed) {
+			JANUS_LOG(LOG_HUGE, "[AudioBridge] Participant %s is not quiet anymore, decoding again\n", participant->user_id_str);
+		}
+		participant->quiet_packets = 0;
+		participant->silence_suppressed = FALSE;
+		return FALSE;
+	}
+	if(participant->quiet_packets < SILENCE_HANGOVER_PACKETS) {
+		participant->quiet_packets++;
+		return FALSE;
+	}
+	if(!participant->silence_suppressed) {
+		JANUS_LOG(LOG_HUGE, "[AudioBridge] Participant %s has been quiet for a while, not decoding\n", participant->user_id_str);
+		participant->silence_suppressed = TRUE;
+	}
+	return TRUE;
+}
+
 #ifdef HAVE_RNNOISE
 static void janus_audiobridge_participant_denoise(janus_audiobridge_participant *participant, char *data, int len) {
 	if(len < 0 || data == NULL)
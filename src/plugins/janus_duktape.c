@@ -74,7 +74,18 @@
  * receive events on substream and/or temporal layer changes happening
  * for receiving sessions via the \c substreamChanged() and the
  * \c temporalLayerChanged() callbacks: this may be useful to track
- * which layer is actually being sent, vs. what was requested.
+ * which layer is actually being sent, vs. what was requested. These
+ * two callbacks are invoked asynchronously by the C scheduler, so that
+ * the media path never has to wait for the Duktape context to be available.
+ *
+ * \note When the script implements \c incomingRtp() or \c incomingRtcp()
+ * all media goes through JavaScript, which is expensive. Scripts that only
+ * need to inspect media for some sessions can use \c setNativeRelay() to
+ * have the C code route the media of all other sessions itself instead,
+ * according to what was configured via \c addRecipient() \c setSubstream()
+ * \c setTemporalLayer() and so on: in that case, packets are relayed
+ * (and rewritten, for simulcast) on the core media loops, without ever
+ * involving the Duktape context.
  *
  * \section dtcapi C interfaces
  *
@@ -98,10 +109,14 @@
  * - \c setSubstream(): set the target simulcast substream;
  * - \c setTemporalLayer(): set the target simulcast temporal layer;
  * - \c sendPli(): send a PLI (keyframe request);
+ * - \c setNativeRelay(): specify whether the C code should route this user's media even if the script implements \c incomingRtp() / \c incomingRtcp();
  * - \c startRecording(): start recording audio, video and or data for a user;
  * - \c stopRecording(): start recording audio, video and or data for a user;
  * - \c pokeScheduler(): notify the C code that there's a coroutine to resume;
- * - \c timeCallback(): trigger the execution of a JavaScript function after X milliseconds.
+ * - \c timeCallback(): trigger the execution of a JavaScript function after X milliseconds;
+ * - \c getSharedData(): read a value shared by all Duktape contexts (see \ref jscontexts);
+ * - \c setSharedData(): set (or remove, if \c null ) a value shared by all Duktape contexts;
+ * - \c incrementSharedData(): atomically add to a numeric value shared by all Duktape contexts.
  *
  * As anticipated in the previous section, almost all these methods also
  * expect the unique session identifier to address a specific user in the
@@ -186,6 +201,46 @@ timeCallback("resumeScheduler", null, 0);
  * compact and less verbose, and as such is preferred in cases where
  * timing and opaque arguments are not needed.
  *
+ * \section jscontexts Multiple Duktape contexts
+ *
+ * By default, the script is evaluated in a single Duktape heap, which
+ * means that all callbacks, for all sessions, are serialized on the same
+ * interpreter. To take advantage of multiple cores, you can set the
+ * \c contexts property in the plugin configuration: the script will then
+ * be evaluated in as many independent heaps, each with its own lock
+ * and its own coroutines scheduler, and each new session will be pinned
+ * to one of them (picked by hashing the session identifier). All the
+ * callbacks involving a session (e.g., \c handleMessage(), \c setupMedia()
+ * or \c incomingRtp() ) are always invoked on the context the session
+ * is pinned to, while \c timeCallback() and \c pokeScheduler() only
+ * affect the context they're invoked from. Plugin information callbacks
+ * (e.g., \c getVersion() ) and \c handleAdminMessage() are always
+ * invoked on the first context.
+ *
+ * The \c init() and \c destroy() callbacks are invoked on all contexts:
+ * besides the path to the configuration file, \c init() also receives
+ * the index of the context it's invoked on, and how many contexts there are.
+ *
+ * Since contexts don't share any JavaScript global, scripts that need to
+ * keep track of resources spanning multiple sessions (e.g., rooms) must
+ * not rely on JavaScript objects only when more than one context is
+ * configured. The \c getSharedData() \c setSharedData() and
+ * \c incrementSharedData() functions give access to a simple key/value
+ * store (where values are strings) that all contexts can read and update, e.g.:
+ *
+ * \verbatim
+// Store info on a room where all contexts can see it
+setSharedData("room-1234", JSON.stringify(room));
+// Allocate a unique ID, whatever the context we're running on
+var id = incrementSharedData("room-ids", 1);
+// Remove it
+setSharedData("room-1234", null);
+\endverbatim
+ *
+ * All the functions the C code exposes that address sessions (e.g.,
+ * \c pushEvent() or \c addRecipient() ) work on any session, whatever
+ * context it's pinned to.
+ *
  * Refer to the \ref jspapi section for more information on how you
  * can register your own C functions.
  */
@@ -270,8 +325,15 @@ janus_callbacks *duktape_janus_core = NULL;
 static char *duktape_folder = NULL;
 
 /* Duktape stuff */
-duk_context *duktape_ctx = NULL;
-janus_mutex duktape_mutex = JANUS_MUTEX_INITIALIZER;
+janus_duktape_context **duktape_contexts = NULL;
+guint duktape_contexts_count = 0;
+/* Maximum number of Duktape contexts we'll create */
+#define JANUS_DUKTAPE_MAX_CONTEXTS	64
+/* Key we use to save the janus_duktape_context pointer in the heap stash of each context */
+static const char *duktape_context_key = "janus_duktape_context";
+/* Data scripts can share across contexts */
+static GHashTable *duktape_shared_data = NULL;
+static janus_mutex duktape_shared_data_mutex = JANUS_MUTEX_INITIALIZER;
 static const char *duktape_functions[] = {
 	"init", "destroy", "resumeScheduler",
 	"createSession", "destroySession", "querySession",
@@ -302,15 +364,21 @@ static gboolean has_data_ready = FALSE;
 static gboolean has_slow_link = FALSE;
 static gboolean has_substream_changed = FALSE;
 static gboolean has_temporal_changed = FALSE;
-/* JavaScript C scheduler (for coroutines) */
-static GThread *scheduler_thread = NULL;
+/* JavaScript C scheduler (for coroutines), one per context */
 static void *janus_duktape_scheduler(void *data);
-static GAsyncQueue *events = NULL;
 typedef enum janus_duktape_event {
 	janus_duktape_event_none = 0,
 	janus_duktape_event_resume,		/* Resume one or more pending coroutines */
+	janus_duktape_event_notify,		/* Notify a simulcast change to the script */
 	janus_duktape_event_exit		/* Break the scheduler loop */
 } janus_duktape_event;
+/* Simulcast changes are notified to the script by the scheduler of the
+ * context the session is pinned to, and not by the thread relaying media */
+typedef struct janus_duktape_notification {
+	uint32_t id;
+	gboolean temporal;
+	int value;
+} janus_duktape_notification;
 /* JavaScript timer loop (for scheduled callbacks) */
 static GMainContext *timer_context = NULL;
 static GMainLoop *timer_loop = NULL;
@@ -319,12 +387,14 @@ static void *janus_duktape_timer(void *data);
 static gboolean janus_duktape_timer_cb(void *data);
 typedef struct janus_duktape_callback {
 	guint id;
+	janus_duktape_context *dctx;
 	uint32_t ms;
 	GSource *source;
 	char *function;
 	char *argument;
 } janus_duktape_callback;
 static GHashTable *callbacks = NULL;
+static janus_mutex callbacks_mutex = JANUS_MUTEX_INITIALIZER;
 static void janus_duktape_callback_free(janus_duktape_callback *cb) {
 	if(!cb)
 		return;
@@ -357,6 +427,8 @@ static void janus_duktape_session_free(const janus_refcount *session_ref) {
 	janus_refcount_decrease(&session->handle->ref);
 	/* This session can be destroyed, free all the resources */
 	g_hash_table_remove(duktape_ids, GUINT_TO_POINTER(session->id));
+	if(session->dctx != NULL)
+		g_atomic_int_add(&session->dctx->sessions, -1);
 	janus_recorder_destroy(session->arc);
 	janus_recorder_destroy(session->vrc);
 	janus_recorder_destroy(session->drc);
@@ -492,7 +564,12 @@ static duk_ret_t janus_duktape_method_readfile(duk_context *ctx) {
 
 static duk_ret_t janus_duktape_method_pokescheduler(duk_context *ctx) {
 	/* This method allows the JavaScript script to poke the scheduler and have it wake up ASAP */
-	g_async_queue_push(events, GUINT_TO_POINTER(janus_duktape_event_resume));
+	janus_duktape_context *dctx = janus_duktape_context_get(ctx);
+	if(dctx == NULL) {
+		duk_push_int(ctx, -1);
+		return 1;
+	}
+	g_async_queue_push(dctx->events, GUINT_TO_POINTER(janus_duktape_event_resume));
 	duk_push_int(ctx, 0);
 	return 1;
 }
@@ -517,22 +594,91 @@ static duk_ret_t janus_duktape_method_timecallback(duk_context *ctx) {
 	const char *function = duk_get_string(ctx, 0);
 	const char *argument = duk_get_string(ctx, 1);
 	uint32_t ms = (uint32_t)duk_get_number(ctx, 2);
-	/* Create a callback instance */
+	/* Create a callback instance: it will be invoked on the same context */
 	janus_duktape_callback *cb = g_malloc0(sizeof(janus_duktape_callback));
+	cb->dctx = janus_duktape_context_get(ctx);
 	cb->function = g_strdup(function);
 	if(argument != NULL)
 		cb->argument = g_strdup(argument);
 	cb->ms = ms;
 	cb->source = g_timeout_source_new(ms);
 	g_source_set_callback(cb->source, janus_duktape_timer_cb, cb, NULL);
+	janus_mutex_lock(&callbacks_mutex);
 	g_hash_table_insert(callbacks, cb, cb);
 	cb->id = g_source_attach(cb->source, timer_context);
+	janus_mutex_unlock(&callbacks_mutex);
 	JANUS_LOG(LOG_VERB, "Created scheduled callback (%"SCNu32"ms) with ID %u\n", cb->ms, cb->id);
 	/* Done */
 	duk_push_int(ctx, 0);
 	return 1;
 }
 
+static duk_ret_t janus_duktape_method_getshareddata(duk_context *ctx) {
+	/* This method allows the JS script to read data shared by all contexts */
+	if(duk_get_type(ctx, 0) != DUK_TYPE_STRING) {
+		duk_push_error_object(ctx, DUK_RET_TYPE_ERROR, "Invalid argument (expected %s, got %s)\n",
+			janus_duktape_type_string(DUK_TYPE_STRING), janus_duktape_type_string(duk_get_type(ctx, 0)));
+		return duk_throw(ctx);
+	}
+	const char *key = duk_get_string(ctx, 0);
+	janus_mutex_lock(&duktape_shared_data_mutex);
+	const char *value = g_hash_table_lookup(duktape_shared_data, key);
+	if(value != NULL)
+		duk_push_string(ctx, value);
+	else
+		duk_push_null(ctx);
+	janus_mutex_unlock(&duktape_shared_data_mutex);
+	return 1;
+}
+
+static duk_ret_t janus_duktape_method_setshareddata(duk_context *ctx) {
+	/* This method allows the JS script to update data shared by all contexts (null removes it) */
+	if(duk_get_type(ctx, 0) != DUK_TYPE_STRING) {
+		duk_push_error_object(ctx, DUK_RET_TYPE_ERROR, "Invalid argument (expected %s, got %s)\n",
+			janus_duktape_type_string(DUK_TYPE_STRING), janus_duktape_type_string(duk_get_type(ctx, 0)));
+		return duk_throw(ctx);
+	}
+	if(duk_get_type(ctx, 1) != DUK_TYPE_STRING && duk_get_type(ctx, 1) != DUK_TYPE_NULL &&
+			duk_get_type(ctx, 1) != DUK_TYPE_UNDEFINED) {
+		duk_push_error_object(ctx, DUK_RET_TYPE_ERROR, "Invalid argument (expected %s, got %s)\n",
+			janus_duktape_type_string(DUK_TYPE_STRING), janus_duktape_type_string(duk_get_type(ctx, 1)));
+		return duk_throw(ctx);
+	}
+	const char *key = duk_get_string(ctx, 0);
+	const char *value = duk_get_string(ctx, 1);
+	janus_mutex_lock(&duktape_shared_data_mutex);
+	if(value == NULL)
+		g_hash_table_remove(duktape_shared_data, key);
+	else
+		g_hash_table_insert(duktape_shared_data, g_strdup(key), g_strdup(value));
+	janus_mutex_unlock(&duktape_shared_data_mutex);
+	duk_push_int(ctx, 0);
+	return 1;
+}
+
+static duk_ret_t janus_duktape_method_incrementshareddata(duk_context *ctx) {
+	/* This method allows the JS script to atomically update a numeric value shared by all contexts */
+	if(duk_get_type(ctx, 0) != DUK_TYPE_STRING) {
+		duk_push_error_object(ctx, DUK_RET_TYPE_ERROR, "Invalid argument (expected %s, got %s)\n",
+			janus_duktape_type_string(DUK_TYPE_STRING), janus_duktape_type_string(duk_get_type(ctx, 0)));
+		return duk_throw(ctx);
+	}
+	if(duk_get_type(ctx, 1) != DUK_TYPE_NUMBER) {
+		duk_push_error_object(ctx, DUK_RET_TYPE_ERROR, "Invalid argument (expected %s, got %s)\n",
+			janus_duktape_type_string(DUK_TYPE_NUMBER), janus_duktape_type_string(duk_get_type(ctx, 1)));
+		return duk_throw(ctx);
+	}
+	const char *key = duk_get_string(ctx, 0);
+	gint64 delta = (gint64)duk_get_number(ctx, 1);
+	janus_mutex_lock(&duktape_shared_data_mutex);
+	const char *value = g_hash_table_lookup(duktape_shared_data, key);
+	gint64 result = (value ? g_ascii_strtoll(value, NULL, 10) : 0) + delta;
+	g_hash_table_insert(duktape_shared_data, g_strdup(key), g_strdup_printf("%"SCNi64, result));
+	janus_mutex_unlock(&duktape_shared_data_mutex);
+	duk_push_number(ctx, (double)result);
+	return 1;
+}
+
 static duk_ret_t janus_duktape_method_pushevent(duk_context *ctx) {
 	/* Get the arguments from the provided context */
 	if(duk_get_type(ctx, 0) != DUK_TYPE_NUMBER) {
@@ -1060,6 +1206,37 @@ static duk_ret_t janus_duktape_method_sendpli(duk_context *ctx) {
 	return 1;
 }
 
+static duk_ret_t janus_duktape_method_setnativerelay(duk_context *ctx) {
+	if(duk_get_type(ctx, 0) != DUK_TYPE_NUMBER) {
+		duk_push_error_object(ctx, DUK_RET_TYPE_ERROR, "Invalid argument (expected %s, got %s)\n",
+			janus_duktape_type_string(DUK_TYPE_NUMBER), janus_duktape_type_string(duk_get_type(ctx, 0)));
+		return duk_throw(ctx);
+	}
+	if(duk_get_type(ctx, 1) != DUK_TYPE_BOOLEAN) {
+		duk_push_error_object(ctx, DUK_RET_TYPE_ERROR, "Invalid argument (expected %s, got %s)\n",
+			janus_duktape_type_string(DUK_TYPE_BOOLEAN), janus_duktape_type_string(duk_get_type(ctx, 1)));
+		return duk_throw(ctx);
+	}
+	uint32_t id = (uint32_t)duk_get_number(ctx, 0);
+	gboolean native_relay = duk_get_boolean(ctx, 1);
+	/* Find the session */
+	janus_mutex_lock(&duktape_sessions_mutex);
+	janus_duktape_session *session = g_hash_table_lookup(duktape_ids, GUINT_TO_POINTER(id));
+	if(session == NULL || g_atomic_int_get(&session->destroyed)) {
+		janus_mutex_unlock(&duktape_sessions_mutex);
+		duk_push_error_object(ctx, DUK_ERR_ERROR, "Session %"SCNu32" doesn't exist", id);
+		return duk_throw(ctx);
+	}
+	janus_refcount_increase(&session->ref);
+	janus_mutex_unlock(&duktape_sessions_mutex);
+	g_atomic_int_set(&session->native_relay, native_relay ? 1 : 0);
+	JANUS_LOG(LOG_VERB, "Media from session %"SCNu32" will be routed by %s\n", session->id, native_relay ? "the C code" : "the script");
+	/* Done */
+	janus_refcount_decrease(&session->ref);
+	duk_push_int(ctx, 0);
+	return 1;
+}
+
 static duk_ret_t janus_duktape_method_relayrtp(duk_context *ctx) {
 	if(duk_get_type(ctx, 0) != DUK_TYPE_NUMBER) {
 		duk_push_error_object(ctx, DUK_RET_TYPE_ERROR, "Invalid argument (expected %s, got %s)\n",
@@ -1482,6 +1659,152 @@ static duk_ret_t janus_duktape_method_stoprecording(duk_context *ctx) {
 
 
 /* Plugin implementation */
+/* Duktape contexts management */
+janus_duktape_context *janus_duktape_context_get(duk_context *ctx) {
+	if(ctx == NULL)
+		return NULL;
+	/* Threads share the heap stash of the context they were created from */
+	duk_push_heap_stash(ctx);
+	duk_get_prop_string(ctx, -1, duktape_context_key);
+	janus_duktape_context *dctx = (janus_duktape_context *)duk_get_pointer(ctx, -1);
+	duk_pop_2(ctx);
+	return dctx;
+}
+
+static void janus_duktape_context_destroy(janus_duktape_context *dctx) {
+	if(dctx == NULL)
+		return;
+	if(dctx->scheduler != NULL) {
+		g_async_queue_push(dctx->events, GUINT_TO_POINTER(janus_duktape_event_exit));
+		g_thread_join(dctx->scheduler);
+		dctx->scheduler = NULL;
+	}
+	janus_mutex_lock(&dctx->mutex);
+	if(dctx->ctx != NULL)
+		duk_destroy_heap(dctx->ctx);
+	dctx->ctx = NULL;
+	janus_mutex_unlock(&dctx->mutex);
+	g_async_queue_unref(dctx->events);
+	g_async_queue_unref(dctx->notifications);
+	janus_mutex_destroy(&dctx->mutex);
+	g_free(dctx);
+}
+
+static void janus_duktape_contexts_free(void) {
+	guint i = 0;
+	for(i=0; i<duktape_contexts_count; i++)
+		janus_duktape_context_destroy(duktape_contexts[i]);
+	g_free(duktape_contexts);
+	duktape_contexts = NULL;
+	duktape_contexts_count = 0;
+}
+
+/* Helper to create a new Duktape heap, and evaluate the script in it */
+static janus_duktape_context *janus_duktape_context_create(guint index, const char *duktape_file, const char *buf, size_t len) {
+	duk_context *ctx = duk_create_heap_default();
+	if(ctx == NULL) {
+		JANUS_LOG(LOG_ERR, "Error creating Duktape heap...\n");
+		return NULL;
+	}
+	duk_console_init(ctx, DUK_CONSOLE_PROXY_WRAPPER);
+	duk_module_duktape_init(ctx);
+
+	/* Register our functions */
+	duk_push_c_function(ctx, janus_duktape_method_getmodulesfolder, 0);
+	duk_put_global_string(ctx, "getModulesFolder");
+	duk_push_c_function(ctx, janus_duktape_method_readfile, 1);
+	duk_put_global_string(ctx, "readFile");
+	duk_push_c_function(ctx, janus_duktape_method_pokescheduler, 0);
+	duk_put_global_string(ctx, "pokeScheduler");
+	duk_push_c_function(ctx, janus_duktape_method_timecallback, 3);
+	duk_put_global_string(ctx, "timeCallback");
+	duk_push_c_function(ctx, janus_duktape_method_getshareddata, 1);
+	duk_put_global_string(ctx, "getSharedData");
+	duk_push_c_function(ctx, janus_duktape_method_setshareddata, 2);
+	duk_put_global_string(ctx, "setSharedData");
+	duk_push_c_function(ctx, janus_duktape_method_incrementshareddata, 2);
+	duk_put_global_string(ctx, "incrementSharedData");
+	duk_push_c_function(ctx, janus_duktape_method_pushevent, 4);
+	duk_put_global_string(ctx, "pushEvent");
+	duk_push_c_function(ctx, janus_duktape_method_notifyevent, 2);
+	duk_put_global_string(ctx, "notifyEvent");
+	duk_push_c_function(ctx, janus_duktape_method_eventsisenabled, 0);
+	duk_put_global_string(ctx, "eventsIsEnabled");
+	duk_push_c_function(ctx, janus_duktape_method_closepc, 1);
+	duk_put_global_string(ctx, "closePc");
+	duk_push_c_function(ctx, janus_duktape_method_endsession, 1);
+	duk_put_global_string(ctx, "endSession");
+	duk_push_c_function(ctx, janus_duktape_method_configuremedium, 4);
+	duk_put_global_string(ctx, "configureMedium");
+	duk_push_c_function(ctx, janus_duktape_method_addrecipient, 2);
+	duk_put_global_string(ctx, "addRecipient");
+	duk_push_c_function(ctx, janus_duktape_method_removerecipient, 2);
+	duk_put_global_string(ctx, "removeRecipient");
+	duk_push_c_function(ctx, janus_duktape_method_setbitrate, 2);
+	duk_put_global_string(ctx, "setBitrate");
+	duk_push_c_function(ctx, janus_duktape_method_setplifreq, 2);
+	duk_put_global_string(ctx, "setPliFreq");
+	duk_push_c_function(ctx, janus_duktape_method_setsubstream, 2);
+	duk_put_global_string(ctx, "setSubstream");
+	duk_push_c_function(ctx, janus_duktape_method_settemporallayer, 2);
+	duk_put_global_string(ctx, "setTemporalLayer");
+	duk_push_c_function(ctx, janus_duktape_method_sendpli, 1);
+	duk_put_global_string(ctx, "sendPli");
+	duk_push_c_function(ctx, janus_duktape_method_setnativerelay, 2);
+	duk_put_global_string(ctx, "setNativeRelay");
+	duk_push_c_function(ctx, janus_duktape_method_relayrtp, 4);
+	duk_put_global_string(ctx, "relayRtp");
+	duk_push_c_function(ctx, janus_duktape_method_relayrtcp, 4);
+	duk_put_global_string(ctx, "relayRtcp");
+	duk_push_c_function(ctx, janus_duktape_method_relaydata, 5);	/* Legacy function, deprecated */
+	duk_put_global_string(ctx, "relayData");
+	duk_push_c_function(ctx, janus_duktape_method_relaytextdata, 5);
+	duk_put_global_string(ctx, "relayTextData");
+	duk_push_c_function(ctx, janus_duktape_method_relaybinarydata, 5);
+	duk_put_global_string(ctx, "relayBinaryData");
+	duk_push_c_function(ctx, janus_duktape_method_startrecording, 13);
+	duk_put_global_string(ctx, "startRecording");
+	duk_push_c_function(ctx, janus_duktape_method_stoprecording, 4);
+	duk_put_global_string(ctx, "stopRecording");
+	duk_push_c_function(ctx, janus_duktape_method_getversion, 0);
+	duk_put_global_string(ctx, "getDuktapeVersion");
+	/* Register all extra functions, if any were added */
+	janus_duktape_register_extra_functions(ctx);
+
+	/* Keep track of the janus_duktape_context instance in the heap stash, for the functions that need it */
+	janus_duktape_context *dctx = g_malloc0(sizeof(janus_duktape_context));
+	dctx->index = index;
+	dctx->ctx = ctx;
+	janus_mutex_init(&dctx->mutex);
+	dctx->events = g_async_queue_new();
+	dctx->notifications = g_async_queue_new_full((GDestroyNotify)g_free);
+	duk_push_heap_stash(ctx);
+	duk_push_pointer(ctx, dctx);
+	duk_put_prop_string(ctx, -2, duktape_context_key);
+	duk_pop(ctx);
+
+	/* Now evaluate the script */
+	duk_push_lstring(ctx, buf, (duk_size_t)len);
+	if(duk_peval(ctx) != 0) {
+		JANUS_LOG(LOG_ERR, "Error loading JS script %s: %s\n", duktape_file, duk_safe_to_string(ctx, -1));
+		janus_duktape_context_destroy(dctx);
+		return NULL;
+	}
+	duk_pop(ctx);
+	/* Make sure that all the functions we need are there */
+	uint i=0;
+	for(i=0; i<duktape_funcsize; i++) {
+		duk_get_global_string(ctx, duktape_functions[i]);
+		if(duk_is_function(ctx, duk_get_top(ctx)-1) == 0) {
+			JANUS_LOG(LOG_ERR, "Function '%s' is missing in %s\n", duktape_functions[i], duktape_file);
+			janus_duktape_context_destroy(dctx);
+			return NULL;
+		}
+		duk_pop(ctx);
+	}
+	return dctx;
+}
+
 int janus_duktape_init(janus_callbacks *callback, const char *config_path) {
 	if(g_atomic_int_get(&duktape_stopping)) {
 		/* Still stopping from before */
@@ -1525,79 +1848,26 @@ int janus_duktape_init(janus_callbacks *callback, const char *config_path) {
 	janus_config_item *conf = janus_config_get(config, config_general, janus_config_type_item, "config");
 	if(conf && conf->value)
 		duktape_config = g_strdup(conf->value);
-	janus_config_destroy(config);
-
-	/* Initialize Duktape */
-	duktape_ctx = duk_create_heap_default();
-	if(duktape_ctx == NULL) {
-		JANUS_LOG(LOG_ERR, "Error creating Duktape heap...\n");
-		g_free(duktape_folder);
-		return -1;
+	guint contexts = 1;
+	janus_config_item *item = janus_config_get(config, config_general, janus_config_type_item, "contexts");
+	if(item && item->value) {
+		int num = atoi(item->value);
+		if(num < 1 || num > JANUS_DUKTAPE_MAX_CONTEXTS) {
+			JANUS_LOG(LOG_WARN, "Invalid number of Duktape contexts (%s), using %d instead\n",
+				item->value, num < 1 ? 1 : JANUS_DUKTAPE_MAX_CONTEXTS);
+			num = num < 1 ? 1 : JANUS_DUKTAPE_MAX_CONTEXTS;
+		}
+		contexts = num;
 	}
-	duk_console_init(duktape_ctx, DUK_CONSOLE_PROXY_WRAPPER);
-	duk_module_duktape_init(duktape_ctx);
-
-	/* Register our functions */
-	duk_push_c_function(duktape_ctx, janus_duktape_method_getmodulesfolder, 0);
-	duk_put_global_string(duktape_ctx, "getModulesFolder");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_readfile, 1);
-	duk_put_global_string(duktape_ctx, "readFile");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_pokescheduler, 0);
-	duk_put_global_string(duktape_ctx, "pokeScheduler");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_timecallback, 3);
-	duk_put_global_string(duktape_ctx, "timeCallback");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_pushevent, 4);
-	duk_put_global_string(duktape_ctx, "pushEvent");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_notifyevent, 2);
-	duk_put_global_string(duktape_ctx, "notifyEvent");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_eventsisenabled, 0);
-	duk_put_global_string(duktape_ctx, "eventsIsEnabled");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_closepc, 1);
-	duk_put_global_string(duktape_ctx, "closePc");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_endsession, 1);
-	duk_put_global_string(duktape_ctx, "endSession");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_configuremedium, 4);
-	duk_put_global_string(duktape_ctx, "configureMedium");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_addrecipient, 2);
-	duk_put_global_string(duktape_ctx, "addRecipient");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_removerecipient, 2);
-	duk_put_global_string(duktape_ctx, "removeRecipient");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_setbitrate, 2);
-	duk_put_global_string(duktape_ctx, "setBitrate");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_setplifreq, 2);
-	duk_put_global_string(duktape_ctx, "setPliFreq");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_setsubstream, 2);
-	duk_put_global_string(duktape_ctx, "setSubstream");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_settemporallayer, 2);
-	duk_put_global_string(duktape_ctx, "setTemporalLayer");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_sendpli, 1);
-	duk_put_global_string(duktape_ctx, "sendPli");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_relayrtp, 4);
-	duk_put_global_string(duktape_ctx, "relayRtp");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_relayrtcp, 4);
-	duk_put_global_string(duktape_ctx, "relayRtcp");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_relaydata, 5);	/* Legacy function, deprecated */
-	duk_put_global_string(duktape_ctx, "relayData");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_relaytextdata, 5);
-	duk_put_global_string(duktape_ctx, "relayTextData");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_relaybinarydata, 5);
-	duk_put_global_string(duktape_ctx, "relayBinaryData");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_startrecording, 13);
-	duk_put_global_string(duktape_ctx, "startRecording");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_stoprecording, 4);
-	duk_put_global_string(duktape_ctx, "stopRecording");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_getversion, 0);
-	duk_put_global_string(duktape_ctx, "getDuktapeVersion");
-	/* Register all extra functions, if any were added */
-	janus_duktape_register_extra_functions(duktape_ctx);
+	janus_config_destroy(config);
 
-	/* Now load the script (FIXME badly) */
+	/* Read the script (FIXME badly) */
 	FILE *f = fopen(duktape_file, "rb");
 	if(f == NULL) {
 		JANUS_LOG(LOG_ERR, "Error loading JS script %s: no such file\n", duktape_file);
-		duk_destroy_heap(duktape_ctx);
 		g_free(duktape_folder);
 		g_free(duktape_file);
+		g_free(duktape_config);
 		return -1;
 	}
 	fseek(f, 0, SEEK_END);
@@ -1605,9 +1875,9 @@ int janus_duktape_init(janus_callbacks *callback, const char *config_path) {
 	if(fs < 1) {
 		JANUS_LOG(LOG_ERR, "Error loading JS script %s: empty file\n", duktape_file);
 		fclose(f);
-		duk_destroy_heap(duktape_ctx);
 		g_free(duktape_folder);
 		g_free(duktape_file);
+		g_free(duktape_config);
 		return -1;
 	}
 	size_t len = fs;
@@ -1617,37 +1887,35 @@ int janus_duktape_init(janus_callbacks *callback, const char *config_path) {
 		JANUS_LOG(LOG_ERR, "Error reading JS script %s: %s\n", duktape_file, g_strerror(errno));
 		g_free(buf);
 		fclose(f);
-		duk_destroy_heap(duktape_ctx);
 		g_free(duktape_folder);
 		g_free(duktape_file);
+		g_free(duktape_config);
 		return -1;
 	}
 	fclose(f);
-	duk_push_lstring(duktape_ctx, (const char *)buf, (duk_size_t)len);
-	g_free(buf);
-	if(duk_peval(duktape_ctx) != 0) {
-		JANUS_LOG(LOG_ERR, "Error loading JS script %s: %s\n", duktape_file, duk_safe_to_string(duktape_ctx, -1));
-		duk_destroy_heap(duktape_ctx);
-		g_free(duktape_folder);
-		g_free(duktape_file);
-		return -1;
-	}
-	duk_pop(duktape_ctx);
-	/* Make sure that all the functions we need are there */
-	uint i=0;
-	for(i=0; i<duktape_funcsize; i++) {
-		duk_get_global_string(duktape_ctx, duktape_functions[i]);
-		if(duk_is_function(duktape_ctx, duk_get_top(duktape_ctx)-1) == 0) {
-			JANUS_LOG(LOG_ERR, "Function '%s' is missing in %s\n", duktape_functions[i], duktape_file);
-			duk_destroy_heap(duktape_ctx);
+
+	/* Initialize Duktape: we evaluate the script in as many heaps as configured */
+	duktape_contexts = g_malloc0(contexts * sizeof(janus_duktape_context *));
+	guint i = 0;
+	for(i=0; i<contexts; i++) {
+		duktape_contexts[i] = janus_duktape_context_create(i, duktape_file, buf, len);
+		if(duktape_contexts[i] == NULL) {
+			janus_duktape_contexts_free();
+			g_free(buf);
 			g_free(duktape_folder);
 			g_free(duktape_file);
+			g_free(duktape_config);
 			return -1;
 		}
+		duktape_contexts_count++;
 	}
+	g_free(buf);
+	JANUS_LOG(LOG_VERB, "Loaded %s in %u Duktape context(s)\n", duktape_file, duktape_contexts_count);
 	/* Some JS functions are optional (e.g., those to directly handle RTP, RTCP and
 	 * data, as those will typically be kept at a C level, with JavaScript only dictating
-	 * the logic, or those overriding the plugin namespace and versioning information */
+	 * the logic, or those overriding the plugin namespace and versioning information:
+	 * since all contexts run the same script, we only check the first one */
+	duk_context *duktape_ctx = duktape_contexts[0]->ctx;
 	duk_get_global_string(duktape_ctx, "getVersion");
 	if(duk_is_function(duktape_ctx, duk_get_top(duktape_ctx)-1) != 0)
 		has_get_version = TRUE;
@@ -1699,27 +1967,32 @@ int janus_duktape_init(janus_callbacks *callback, const char *config_path) {
 	duk_get_global_string(duktape_ctx, "temporalLayerChanged");
 	if(duk_is_function(duktape_ctx, duk_get_top(duktape_ctx)-1) != 0)
 		has_temporal_changed = TRUE;
+	duk_set_top(duktape_ctx, 0);
 
 	duktape_sessions = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify)janus_duktape_session_destroy);
 	duktape_ids = g_hash_table_new(NULL, NULL);
-	events = g_async_queue_new();
 	callbacks = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify)janus_duktape_callback_free);
+	duktape_shared_data = g_hash_table_new_full(g_str_hash, g_str_equal, (GDestroyNotify)g_free, (GDestroyNotify)g_free);
 
 	g_atomic_int_set(&duktape_initialized, 1);
 
-	/* Launch the scheduler thread (which will be responsible for resuming asynchronous coroutines) */
+	/* Launch the scheduler threads (each responsible for resuming the asynchronous coroutines of a context) */
 	GError *error = NULL;
-	scheduler_thread = g_thread_try_new("duktape scheduler", janus_duktape_scheduler, NULL, &error);
-	if(error != NULL) {
-		g_atomic_int_set(&duktape_initialized, 0);
-		JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch the Duktape scheduler thread...\n",
-			error->code, error->message ? error->message : "??");
-		g_error_free(error);
-		duk_destroy_heap(duktape_ctx);
-		g_free(duktape_folder);
-		g_free(duktape_file);
-		g_free(duktape_config);
-		return -1;
+	for(i=0; i<duktape_contexts_count; i++) {
+		char tname[16];
+		g_snprintf(tname, sizeof(tname), "duktape sched %u", i);
+		duktape_contexts[i]->scheduler = g_thread_try_new(tname, janus_duktape_scheduler, duktape_contexts[i], &error);
+		if(error != NULL) {
+			g_atomic_int_set(&duktape_initialized, 0);
+			JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch the Duktape scheduler thread...\n",
+				error->code, error->message ? error->message : "??");
+			g_error_free(error);
+			janus_duktape_contexts_free();
+			g_free(duktape_folder);
+			g_free(duktape_file);
+			g_free(duktape_config);
+			return -1;
+		}
 	}
 	/* Launch the timer loop thread (which will be responsible for scheduling timed callbacks) */
 	timer_context = g_main_context_new();
@@ -1734,7 +2007,7 @@ int janus_duktape_init(janus_callbacks *callback, const char *config_path) {
 			g_main_loop_unref(timer_loop);
 		if(timer_context != NULL)
 			g_main_context_unref(timer_context);
-		duk_destroy_heap(duktape_ctx);
+		janus_duktape_contexts_free();
 		g_free(duktape_folder);
 		g_free(duktape_file);
 		g_free(duktape_config);
@@ -1744,23 +2017,39 @@ int janus_duktape_init(janus_callbacks *callback, const char *config_path) {
 	/* This is the callback we'll need to invoke to contact the Janus core */
 	duktape_janus_core = callback;
 
-	/* Init the JS script, in case it's needed */
-	duk_get_global_string(duktape_ctx, "init");
-	duk_push_string(duktape_ctx, duktape_config);
-	int res = duk_pcall(duktape_ctx, 1);
-	if(res != DUK_EXEC_SUCCESS) {
-		g_atomic_int_set(&duktape_initialized, 0);
-		JANUS_LOG(LOG_ERR, "Duktape error: %s\n", duk_safe_to_string(duktape_ctx, -1));
-		duk_pop(duktape_ctx);
-		if(timer_loop != NULL)
-			g_main_loop_unref(timer_loop);
-		if(timer_context != NULL)
-			g_main_context_unref(timer_context);
-		duk_destroy_heap(duktape_ctx);
-		g_free(duktape_folder);
-		g_free(duktape_file);
-		g_free(duktape_config);
-		return -1;
+	/* Init the JS script in all contexts, in case it's needed: besides the
+	 * configuration file, we pass the index of the context and how many there are */
+	for(i=0; i<duktape_contexts_count; i++) {
+		janus_duktape_context *dctx = duktape_contexts[i];
+		janus_mutex_lock(&dctx->mutex);
+		duk_get_global_string(dctx->ctx, "init");
+		duk_push_string(dctx->ctx, duktape_config);
+		duk_push_uint(dctx->ctx, dctx->index);
+		duk_push_uint(dctx->ctx, duktape_contexts_count);
+		int res = duk_pcall(dctx->ctx, 3);
+		if(res != DUK_EXEC_SUCCESS) {
+			g_atomic_int_set(&duktape_initialized, 0);
+			JANUS_LOG(LOG_ERR, "Duktape error: %s\n", duk_safe_to_string(dctx->ctx, -1));
+			duk_pop(dctx->ctx);
+			janus_mutex_unlock(&dctx->mutex);
+			if(timer_loop != NULL)
+				g_main_loop_quit(timer_loop);
+			if(timer_thread != NULL) {
+				g_thread_join(timer_thread);
+				timer_thread = NULL;
+			}
+			if(timer_loop != NULL)
+				g_main_loop_unref(timer_loop);
+			if(timer_context != NULL)
+				g_main_context_unref(timer_context);
+			janus_duktape_contexts_free();
+			g_free(duktape_folder);
+			g_free(duktape_file);
+			g_free(duktape_config);
+			return -1;
+		}
+		duk_pop(dctx->ctx);
+		janus_mutex_unlock(&dctx->mutex);
 	}
 
 	g_free(duktape_file);
@@ -1775,10 +2064,14 @@ void janus_duktape_destroy(void) {
 		return;
 	g_atomic_int_set(&duktape_stopping, 1);
 
-	g_async_queue_push(events, GUINT_TO_POINTER(janus_duktape_event_exit));
-	if(scheduler_thread != NULL) {
-		g_thread_join(scheduler_thread);
-		scheduler_thread = NULL;
+	guint i = 0;
+	for(i=0; i<duktape_contexts_count; i++) {
+		janus_duktape_context *dctx = duktape_contexts[i];
+		g_async_queue_push(dctx->events, GUINT_TO_POINTER(janus_duktape_event_exit));
+		if(dctx->scheduler != NULL) {
+			g_thread_join(dctx->scheduler);
+			dctx->scheduler = NULL;
+		}
 	}
 	if(timer_loop != NULL)
 		g_main_loop_quit(timer_loop);
@@ -1795,31 +2088,34 @@ void janus_duktape_destroy(void) {
 		timer_context = NULL;
 	}
 
-	/* Deinit the JS script, in case it's needed */
-	janus_mutex_lock(&duktape_mutex);
-	duk_get_global_string(duktape_ctx, "destroy");
-	int res = duk_pcall(duktape_ctx, 0);
-	if(res != DUK_EXEC_SUCCESS) {
-		JANUS_LOG(LOG_ERR, "Duktape error: %s\n", duk_safe_to_string(duktape_ctx, -1));
-		duk_pop(duktape_ctx);
+	/* Deinit the JS script in all contexts, in case it's needed */
+	for(i=0; i<duktape_contexts_count; i++) {
+		janus_duktape_context *dctx = duktape_contexts[i];
+		janus_mutex_lock(&dctx->mutex);
+		duk_get_global_string(dctx->ctx, "destroy");
+		int res = duk_pcall(dctx->ctx, 0);
+		if(res != DUK_EXEC_SUCCESS)
+			JANUS_LOG(LOG_ERR, "Duktape error: %s\n", duk_safe_to_string(dctx->ctx, -1));
+		duk_pop(dctx->ctx);
+		janus_mutex_unlock(&dctx->mutex);
 	}
+	janus_mutex_lock(&callbacks_mutex);
 	g_hash_table_destroy(callbacks);
 	callbacks = NULL;
-	janus_mutex_unlock(&duktape_mutex);
+	janus_mutex_unlock(&callbacks_mutex);
 
 	janus_mutex_lock(&duktape_sessions_mutex);
 	g_hash_table_destroy(duktape_sessions);
 	duktape_sessions = NULL;
 	g_hash_table_destroy(duktape_ids);
 	duktape_ids = NULL;
-	g_async_queue_unref(events);
-	events = NULL;
 	janus_mutex_unlock(&duktape_sessions_mutex);
 
-	janus_mutex_lock(&duktape_mutex);
-	duk_destroy_heap(duktape_ctx);
-	duktape_ctx = NULL;
-	janus_mutex_unlock(&duktape_mutex);
+	janus_duktape_contexts_free();
+	janus_mutex_lock(&duktape_shared_data_mutex);
+	g_hash_table_destroy(duktape_shared_data);
+	duktape_shared_data = NULL;
+	janus_mutex_unlock(&duktape_shared_data_mutex);
 
 	g_free(duktape_script_version_string);
 	g_free(duktape_script_description);
@@ -1843,28 +2139,28 @@ int janus_duktape_get_version(void) {
 	/* Check if the JS script wants to override this method and return info itself */
 	if(has_get_version) {
 		/* Yep, pass the request to the JS script and return the info */
-		janus_mutex_lock(&duktape_mutex);
+		janus_mutex_lock(&duktape_contexts[0]->mutex);
 		if(duktape_script_version != -1) {
 			/* Unless we asked already */
-			janus_mutex_unlock(&duktape_mutex);
+			janus_mutex_unlock(&duktape_contexts[0]->mutex);
 			return duktape_script_version;
 		}
-		duk_idx_t thr_idx = duk_push_thread(duktape_ctx);
-		duk_context *t = duk_get_context(duktape_ctx, thr_idx);
+		duk_idx_t thr_idx = duk_push_thread(duktape_contexts[0]->ctx);
+		duk_context *t = duk_get_context(duktape_contexts[0]->ctx, thr_idx);
 		duk_get_global_string(t, "getVersion");
 		int res = duk_pcall(t, 0);
 		if(res != DUK_EXEC_SUCCESS) {
 			/* Something went wrong... return the Janus Duktape plugin info */
 			JANUS_LOG(LOG_ERR, "Duktape error: %s\n", duk_safe_to_string(t, -1));
 			duk_pop(t);
-			duk_pop(duktape_ctx);
-			janus_mutex_unlock(&duktape_mutex);
+			duk_pop(duktape_contexts[0]->ctx);
+			janus_mutex_unlock(&duktape_contexts[0]->mutex);
 			return JANUS_DUKTAPE_VERSION;
 		}
 		duktape_script_version = (int)duk_get_number(t, -1);
 		duk_pop(t);
-		duk_pop(duktape_ctx);
-		janus_mutex_unlock(&duktape_mutex);
+		duk_pop(duktape_contexts[0]->ctx);
+		janus_mutex_unlock(&duktape_contexts[0]->mutex);
 		return duktape_script_version;
 	}
 	/* No override, return the Janus Duktape plugin info */
@@ -1875,30 +2171,30 @@ const char *janus_duktape_get_version_string(void) {
 	/* Check if the JS script wants to override this method and return info itself */
 	if(has_get_version_string) {
 		/* Yep, pass the request to the JS script and return the info */
-		janus_mutex_lock(&duktape_mutex);
+		janus_mutex_lock(&duktape_contexts[0]->mutex);
 		if(duktape_script_version_string != NULL) {
 			/* Unless we asked already */
-			janus_mutex_unlock(&duktape_mutex);
+			janus_mutex_unlock(&duktape_contexts[0]->mutex);
 			return duktape_script_version_string;
 		}
-		duk_idx_t thr_idx = duk_push_thread(duktape_ctx);
-		duk_context *t = duk_get_context(duktape_ctx, thr_idx);
+		duk_idx_t thr_idx = duk_push_thread(duktape_contexts[0]->ctx);
+		duk_context *t = duk_get_context(duktape_contexts[0]->ctx, thr_idx);
 		duk_get_global_string(t, "getVersionString");
 		int res = duk_pcall(t, 0);
 		if(res != DUK_EXEC_SUCCESS) {
 			/* Something went wrong... return the Janus Duktape plugin info */
 			JANUS_LOG(LOG_ERR, "Duktape error: %s\n", duk_safe_to_string(t, -1));
 			duk_pop(t);
-			duk_pop(duktape_ctx);
-			janus_mutex_unlock(&duktape_mutex);
+			duk_pop(duktape_contexts[0]->ctx);
+			janus_mutex_unlock(&duktape_contexts[0]->mutex);
 			return JANUS_DUKTAPE_VERSION_STRING;
 		}
 		const char *version = duk_get_string(t, -1);
 		if(version != NULL)
 			duktape_script_version_string = g_strdup(version);
 		duk_pop(t);
-		duk_pop(duktape_ctx);
-		janus_mutex_unlock(&duktape_mutex);
+		duk_pop(duktape_contexts[0]->ctx);
+		janus_mutex_unlock(&duktape_contexts[0]->mutex);
 		return duktape_script_version_string;
 	}
 	/* No override, return the Janus Duktape plugin info */
@@ -1909,30 +2205,30 @@ const char *janus_duktape_get_description(void) {
 	/* Check if the JS script wants to override this method and return info itself */
 	if(has_get_description) {
 		/* Yep, pass the request to the JS script and return the info */
-		janus_mutex_lock(&duktape_mutex);
+		janus_mutex_lock(&duktape_contexts[0]->mutex);
 		if(duktape_script_description != NULL) {
 			/* Unless we asked already */
-			janus_mutex_unlock(&duktape_mutex);
+			janus_mutex_unlock(&duktape_contexts[0]->mutex);
 			return duktape_script_description;
 		}
-		duk_idx_t thr_idx = duk_push_thread(duktape_ctx);
-		duk_context *t = duk_get_context(duktape_ctx, thr_idx);
+		duk_idx_t thr_idx = duk_push_thread(duktape_contexts[0]->ctx);
+		duk_context *t = duk_get_context(duktape_contexts[0]->ctx, thr_idx);
 		duk_get_global_string(t, "getDescription");
 		int res = duk_pcall(t, 0);
 		if(res != DUK_EXEC_SUCCESS) {
 			/* Something went wrong... return the Janus Duktape plugin info */
 			JANUS_LOG(LOG_ERR, "Duktape error: %s\n", duk_safe_to_string(t, -1));
 			duk_pop(t);
-			duk_pop(duktape_ctx);
-			janus_mutex_unlock(&duktape_mutex);
+			duk_pop(duktape_contexts[0]->ctx);
+			janus_mutex_unlock(&duktape_contexts[0]->mutex);
 			return JANUS_DUKTAPE_DESCRIPTION;
 		}
 		const char *description = duk_get_string(t, -1);
 		if(description != NULL)
 			duktape_script_description = g_strdup(description);
 		duk_pop(t);
-		duk_pop(duktape_ctx);
-		janus_mutex_unlock(&duktape_mutex);
+		duk_pop(duktape_contexts[0]->ctx);
+		janus_mutex_unlock(&duktape_contexts[0]->mutex);
 		return duktape_script_description;
 	}
 	/* No override, return the Janus Duktape plugin info */
@@ -1943,30 +2239,30 @@ const char *janus_duktape_get_name(void) {
 	/* Check if the JS script wants to override this method and return info itself */
 	if(has_get_name) {
 		/* Yep, pass the request to the JS script and return the info */
-		janus_mutex_lock(&duktape_mutex);
+		janus_mutex_lock(&duktape_contexts[0]->mutex);
 		if(duktape_script_name != NULL) {
 			/* Unless we asked already */
-			janus_mutex_unlock(&duktape_mutex);
+			janus_mutex_unlock(&duktape_contexts[0]->mutex);
 			return duktape_script_name;
 		}
-		duk_idx_t thr_idx = duk_push_thread(duktape_ctx);
-		duk_context *t = duk_get_context(duktape_ctx, thr_idx);
+		duk_idx_t thr_idx = duk_push_thread(duktape_contexts[0]->ctx);
+		duk_context *t = duk_get_context(duktape_contexts[0]->ctx, thr_idx);
 		duk_get_global_string(t, "getName");
 		int res = duk_pcall(t, 0);
 		if(res != DUK_EXEC_SUCCESS) {
 			/* Something went wrong... return the Janus Duktape plugin info */
 			JANUS_LOG(LOG_ERR, "Duktape error: %s\n", duk_safe_to_string(t, -1));
 			duk_pop(t);
-			duk_pop(duktape_ctx);
-			janus_mutex_unlock(&duktape_mutex);
+			duk_pop(duktape_contexts[0]->ctx);
+			janus_mutex_unlock(&duktape_contexts[0]->mutex);
 			return JANUS_DUKTAPE_NAME;
 		}
 		const char *name = duk_get_string(t, -1);
 		if(name != NULL)
 			duktape_script_name = g_strdup(name);
 		duk_pop(t);
-		duk_pop(duktape_ctx);
-		janus_mutex_unlock(&duktape_mutex);
+		duk_pop(duktape_contexts[0]->ctx);
+		janus_mutex_unlock(&duktape_contexts[0]->mutex);
 		return duktape_script_name;
 	}
 	/* No override, return the Janus Duktape plugin info */
@@ -1977,30 +2273,30 @@ const char *janus_duktape_get_author(void) {
 	/* Check if the JS script wants to override this method and return info itself */
 	if(has_get_author) {
 		/* Yep, pass the request to the JS script and return the info */
-		janus_mutex_lock(&duktape_mutex);
+		janus_mutex_lock(&duktape_contexts[0]->mutex);
 		if(duktape_script_author != NULL) {
 			/* Unless we asked already */
-			janus_mutex_unlock(&duktape_mutex);
+			janus_mutex_unlock(&duktape_contexts[0]->mutex);
 			return duktape_script_author;
 		}
-		duk_idx_t thr_idx = duk_push_thread(duktape_ctx);
-		duk_context *t = duk_get_context(duktape_ctx, thr_idx);
+		duk_idx_t thr_idx = duk_push_thread(duktape_contexts[0]->ctx);
+		duk_context *t = duk_get_context(duktape_contexts[0]->ctx, thr_idx);
 		duk_get_global_string(t, "getAuthor");
 		int res = duk_pcall(t, 0);
 		if(res != DUK_EXEC_SUCCESS) {
 			/* Something went wrong... return the Janus Duktape plugin info */
 			JANUS_LOG(LOG_ERR, "Duktape error: %s\n", duk_safe_to_string(t, -1));
 			duk_pop(t);
-			duk_pop(duktape_ctx);
-			janus_mutex_unlock(&duktape_mutex);
+			duk_pop(duktape_contexts[0]->ctx);
+			janus_mutex_unlock(&duktape_contexts[0]->mutex);
 			return JANUS_DUKTAPE_AUTHOR;
 		}
 		const char *author = duk_get_string(t, -1);
 		if(author != NULL)
 			duktape_script_author = g_strdup(author);
 		duk_pop(t);
-		duk_pop(duktape_ctx);
-		janus_mutex_unlock(&duktape_mutex);
+		duk_pop(duktape_contexts[0]->ctx);
+		janus_mutex_unlock(&duktape_contexts[0]->mutex);
 		return duktape_script_author;
 	}
 	/* No override, return the Janus Duktape plugin info */
@@ -2011,30 +2307,30 @@ const char *janus_duktape_get_package(void) {
 	/* Check if the JS script wants to override this method and return info itself */
 	if(has_get_package) {
 		/* Yep, pass the request to the JS script and return the info */
-		janus_mutex_lock(&duktape_mutex);
+		janus_mutex_lock(&duktape_contexts[0]->mutex);
 		if(duktape_script_package != NULL) {
 			/* Unless we asked already */
-			janus_mutex_unlock(&duktape_mutex);
+			janus_mutex_unlock(&duktape_contexts[0]->mutex);
 			return duktape_script_package;
 		}
-		duk_idx_t thr_idx = duk_push_thread(duktape_ctx);
-		duk_context *t = duk_get_context(duktape_ctx, thr_idx);
+		duk_idx_t thr_idx = duk_push_thread(duktape_contexts[0]->ctx);
+		duk_context *t = duk_get_context(duktape_contexts[0]->ctx, thr_idx);
 		duk_get_global_string(t, "getPackage");
 		int res = duk_pcall(t, 0);
 		if(res != DUK_EXEC_SUCCESS) {
 			/* Something went wrong... return the Janus Duktape plugin info */
 			JANUS_LOG(LOG_ERR, "Duktape error: %s\n", duk_safe_to_string(t, -1));
 			duk_pop(t);
-			duk_pop(duktape_ctx);
-			janus_mutex_unlock(&duktape_mutex);
+			duk_pop(duktape_contexts[0]->ctx);
+			janus_mutex_unlock(&duktape_contexts[0]->mutex);
 			return JANUS_DUKTAPE_PACKAGE;
 		}
 		const char *package = duk_get_string(t, -1);
 		if(package != NULL)
 			duktape_script_package = g_strdup(package);
 		duk_pop(t);
-		duk_pop(duktape_ctx);
-		janus_mutex_unlock(&duktape_mutex);
+		duk_pop(duktape_contexts[0]->ctx);
+		janus_mutex_unlock(&duktape_contexts[0]->mutex);
 		return duktape_script_package;
 	}
 	/* No override, return the Janus Duktape plugin info */
@@ -2078,6 +2374,12 @@ void janus_duktape_create_session(janus_plugin_session *handle, int *error) {
 	janus_mutex_init(&session->recipients_mutex);
 	janus_mutex_init(&session->rec_mutex);
 	session->vcodec = JANUS_VIDEOCODEC_NONE;
+	/* Pin the session to one of the Duktape contexts: all the script callbacks
+	 * involving this session will be invoked on that context only */
+	session->dctx = duktape_contexts[id % duktape_contexts_count];
+	g_atomic_int_inc(&session->dctx->sessions);
+	JANUS_LOG(LOG_VERB, "Duktape session %"SCNu32" pinned to context #%u (%d sessions)\n",
+		id, session->dctx->index, g_atomic_int_get(&session->dctx->sessions));
 	g_atomic_int_set(&session->hangingup, 0);
 	g_atomic_int_set(&session->destroyed, 0);
 	janus_refcount_init(&session->ref, janus_duktape_session_free);
@@ -2087,9 +2389,10 @@ void janus_duktape_create_session(janus_plugin_session *handle, int *error) {
 	janus_mutex_unlock(&duktape_sessions_mutex);
 
 	/* Notify the JS script */
-	janus_mutex_lock(&duktape_mutex);
-	duk_idx_t thr_idx = duk_push_thread(duktape_ctx);
-	duk_context *t = duk_get_context(duktape_ctx, thr_idx);
+	janus_duktape_context *dctx = session->dctx;
+	janus_mutex_lock(&dctx->mutex);
+	duk_idx_t thr_idx = duk_push_thread(dctx->ctx);
+	duk_context *t = duk_get_context(dctx->ctx, thr_idx);
 	duk_get_global_string(t, "createSession");
 	duk_push_number(t, session->id);
 	int res = duk_pcall(t, 1);
@@ -2098,8 +2401,8 @@ void janus_duktape_create_session(janus_plugin_session *handle, int *error) {
 		JANUS_LOG(LOG_ERR, "Duktape error: %s\n", duk_safe_to_string(t, -1));
 	}
 	duk_pop(t);
-	duk_pop(duktape_ctx);
-	janus_mutex_unlock(&duktape_mutex);
+	duk_pop(dctx->ctx);
+	janus_mutex_unlock(&dctx->mutex);
 
 	return;
 }
@@ -2123,9 +2426,10 @@ void janus_duktape_destroy_session(janus_plugin_session *handle, int *error) {
 	janus_mutex_unlock(&duktape_sessions_mutex);
 
 	/* Notify the JS script */
-	janus_mutex_lock(&duktape_mutex);
-	duk_idx_t thr_idx = duk_push_thread(duktape_ctx);
-	duk_context *t = duk_get_context(duktape_ctx, thr_idx);
+	janus_duktape_context *dctx = session->dctx;
+	janus_mutex_lock(&dctx->mutex);
+	duk_idx_t thr_idx = duk_push_thread(dctx->ctx);
+	duk_context *t = duk_get_context(dctx->ctx, thr_idx);
 	duk_get_global_string(t, "destroySession");
 	duk_push_number(t, id);
 	int res = duk_pcall(t, 1);
@@ -2134,8 +2438,8 @@ void janus_duktape_destroy_session(janus_plugin_session *handle, int *error) {
 		JANUS_LOG(LOG_ERR, "Duktape error: %s\n", duk_safe_to_string(t, -1));
 	}
 	duk_pop(t);
-	duk_pop(duktape_ctx);
-	janus_mutex_unlock(&duktape_mutex);
+	duk_pop(dctx->ctx);
+	janus_mutex_unlock(&dctx->mutex);
 
 	/* Get any rid references recipients of this sessions may have */
 	janus_mutex_lock(&session->recipients_mutex);
@@ -2173,9 +2477,10 @@ json_t *janus_duktape_query_session(janus_plugin_session *handle) {
 	janus_refcount_increase(&session->ref);
 	janus_mutex_unlock(&duktape_sessions_mutex);
 	/* Ask the JS script for information on this session */
-	janus_mutex_lock(&duktape_mutex);
-	duk_idx_t thr_idx = duk_push_thread(duktape_ctx);
-	duk_context *t = duk_get_context(duktape_ctx, thr_idx);
+	janus_duktape_context *dctx = session->dctx;
+	janus_mutex_lock(&dctx->mutex);
+	duk_idx_t thr_idx = duk_push_thread(dctx->ctx);
+	duk_context *t = duk_get_context(dctx->ctx, thr_idx);
 	duk_get_global_string(t, "querySession");
 	duk_push_number(t, session->id);
 	int res = duk_pcall(t, 1);
@@ -2185,19 +2490,19 @@ json_t *janus_duktape_query_session(janus_plugin_session *handle) {
 		json_t *json = json_object();
 		json_object_set_new(json, "error", json_string(duk_safe_to_string(t, -1)));
 		duk_pop(t);
-		duk_pop(duktape_ctx);
+		duk_pop(dctx->ctx);
 		janus_refcount_decrease(&session->ref);
-		janus_mutex_unlock(&duktape_mutex);
+		janus_mutex_unlock(&dctx->mutex);
 		return json;
 	}
 	janus_refcount_decrease(&session->ref);
 	const char *info = duk_get_string(t, -1);
 	duk_pop(t);
-	duk_pop(duktape_ctx);
+	duk_pop(dctx->ctx);
 	/* We need a Jansson object */
 	json_error_t error;
 	json_t *json = json_loads(info, 0, &error);
-	janus_mutex_unlock(&duktape_mutex);
+	janus_mutex_unlock(&dctx->mutex);
 	if(!json) {
 		JANUS_LOG(LOG_ERR, "JSON error: on line %d: %s", error.line, error.text);
 		return NULL;
@@ -2262,9 +2567,10 @@ struct janus_plugin_result *janus_duktape_handle_message(janus_plugin_session *h
 		json_decref(jsep);
 	}
 	/* Invoke the script function */
-	janus_mutex_lock(&duktape_mutex);
-	duk_idx_t thr_idx = duk_push_thread(duktape_ctx);
-	duk_context *t = duk_get_context(duktape_ctx, thr_idx);
+	janus_duktape_context *dctx = session->dctx;
+	janus_mutex_lock(&dctx->mutex);
+	duk_idx_t thr_idx = duk_push_thread(dctx->ctx);
+	duk_context *t = duk_get_context(dctx->ctx, thr_idx);
 	duk_get_global_string(t, "handleMessage");
 	duk_push_number(t, session->id);
 	duk_push_string(t, transaction);
@@ -2275,8 +2581,8 @@ struct janus_plugin_result *janus_duktape_handle_message(janus_plugin_session *h
 		/* Something went wrong... */
 		JANUS_LOG(LOG_ERR, "Duktape error: %s\n", duk_safe_to_string(t, -1));
 		duk_pop(t);
-		duk_pop(duktape_ctx);
-		janus_mutex_unlock(&duktape_mutex);
+		duk_pop(dctx->ctx);
+		janus_mutex_unlock(&dctx->mutex);
 		return janus_plugin_result_new(JANUS_PLUGIN_ERROR, "Duktape error", NULL);
 	}
 	janus_refcount_decrease(&session->ref);
@@ -2290,8 +2596,8 @@ struct janus_plugin_result *janus_duktape_handle_message(janus_plugin_session *h
 		/* Either an error or an asynchronous response */
 		int res = (int)duk_get_number(t, 0);
 		duk_pop(t);
-		duk_pop(duktape_ctx);
-		janus_mutex_unlock(&duktape_mutex);
+		duk_pop(dctx->ctx);
+		janus_mutex_unlock(&dctx->mutex);
 		if(res < 0) {
 			/* We got an error */
 			return janus_plugin_result_new(JANUS_PLUGIN_ERROR, "Duktape error", NULL);
@@ -2304,8 +2610,8 @@ struct janus_plugin_result *janus_duktape_handle_message(janus_plugin_session *h
 		json_error_t error;
 		json_t *json = json_loads(response, 0, &error);
 		duk_pop(t);
-		duk_pop(duktape_ctx);
-		janus_mutex_unlock(&duktape_mutex);
+		duk_pop(dctx->ctx);
+		janus_mutex_unlock(&dctx->mutex);
 		if(!json) {
 			JANUS_LOG(LOG_ERR, "JSON error: on line %d: %s\n", error.line, error.text);
 			return janus_plugin_result_new(JANUS_PLUGIN_ERROR, "Duktape error", NULL);
@@ -2314,8 +2620,8 @@ struct janus_plugin_result *janus_duktape_handle_message(janus_plugin_session *h
 	}
 	/* If we got here, we didn't get what we expect */
 	duk_pop(t);
-	duk_pop(duktape_ctx);
-	janus_mutex_unlock(&duktape_mutex);
+	duk_pop(dctx->ctx);
+	janus_mutex_unlock(&dctx->mutex);
 	return janus_plugin_result_new(JANUS_PLUGIN_ERROR, "Duktape error", NULL);
 }
 
@@ -2328,9 +2634,10 @@ json_t *janus_duktape_handle_admin_message(json_t *message) {
 		return NULL;
 	}
 	/* Invoke the script function */
-	janus_mutex_lock(&duktape_mutex);
-	duk_idx_t thr_idx = duk_push_thread(duktape_ctx);
-	duk_context *t = duk_get_context(duktape_ctx, thr_idx);
+	janus_duktape_context *dctx = duktape_contexts[0];
+	janus_mutex_lock(&dctx->mutex);
+	duk_idx_t thr_idx = duk_push_thread(dctx->ctx);
+	duk_context *t = duk_get_context(dctx->ctx, thr_idx);
 	duk_get_global_string(t, "handleAdminMessage");
 	duk_push_string(t, message_text);
 	int res = duk_pcall(t, 1);
@@ -2338,8 +2645,8 @@ json_t *janus_duktape_handle_admin_message(json_t *message) {
 		/* Something went wrong... */
 		JANUS_LOG(LOG_ERR, "Duktape error: %s\n", duk_safe_to_string(t, -1));
 		duk_pop(t);
-		duk_pop(duktape_ctx);
-		janus_mutex_unlock(&duktape_mutex);
+		duk_pop(dctx->ctx);
+		janus_mutex_unlock(&dctx->mutex);
 		return NULL;
 	}
 	if(message_text != NULL)
@@ -2349,8 +2656,8 @@ json_t *janus_duktape_handle_admin_message(json_t *message) {
 	json_error_t error;
 	json_t *json = json_loads(response, 0, &error);
 	duk_pop(t);
-	duk_pop(duktape_ctx);
-	janus_mutex_unlock(&duktape_mutex);
+	duk_pop(dctx->ctx);
+	janus_mutex_unlock(&dctx->mutex);
 	if(!json) {
 		JANUS_LOG(LOG_ERR, "JSON error: on line %d: %s\n", error.line, error.text);
 		return NULL;
@@ -2380,9 +2687,10 @@ void janus_duktape_setup_media(janus_plugin_session *handle) {
 	session->pli_latest = janus_get_monotonic_time();
 
 	/* Notify the JS script */
-	janus_mutex_lock(&duktape_mutex);
-	duk_idx_t thr_idx = duk_push_thread(duktape_ctx);
-	duk_context *t = duk_get_context(duktape_ctx, thr_idx);
+	janus_duktape_context *dctx = session->dctx;
+	janus_mutex_lock(&dctx->mutex);
+	duk_idx_t thr_idx = duk_push_thread(dctx->ctx);
+	duk_context *t = duk_get_context(dctx->ctx, thr_idx);
 	duk_get_global_string(t, "setupMedia");
 	duk_push_number(t, session->id);
 	int res = duk_pcall(t, 1);
@@ -2391,8 +2699,8 @@ void janus_duktape_setup_media(janus_plugin_session *handle) {
 		JANUS_LOG(LOG_ERR, "Duktape error: %s\n", duk_safe_to_string(t, -1));
 	}
 	duk_pop(t);
-	duk_pop(duktape_ctx);
-	janus_mutex_unlock(&duktape_mutex);
+	duk_pop(dctx->ctx);
+	janus_mutex_unlock(&dctx->mutex);
 	janus_refcount_decrease(&session->ref);
 }
 
@@ -2410,11 +2718,12 @@ void janus_duktape_incoming_rtp(janus_plugin_session *handle, janus_plugin_rtp *
 	char *buf = rtp_packet->buffer;
 	uint16_t len = rtp_packet->length;
 	/* Check if the JS script wants to handle/manipulate RTP packets itself */
-	if(has_incoming_rtp) {
+	if(has_incoming_rtp && !g_atomic_int_get(&session->native_relay)) {
 		/* Yep, pass the data to the JS script and return */
-		janus_mutex_lock(&duktape_mutex);
-		duk_idx_t thr_idx = duk_push_thread(duktape_ctx);
-		duk_context *t = duk_get_context(duktape_ctx, thr_idx);
+		janus_duktape_context *dctx = session->dctx;
+		janus_mutex_lock(&dctx->mutex);
+		duk_idx_t thr_idx = duk_push_thread(dctx->ctx);
+		duk_context *t = duk_get_context(dctx->ctx, thr_idx);
 		duk_get_global_string(t, "incomingRtp");
 		duk_push_number(t, session->id);
 		duk_push_boolean(t, video);
@@ -2426,8 +2735,8 @@ void janus_duktape_incoming_rtp(janus_plugin_session *handle, janus_plugin_rtp *
 			JANUS_LOG(LOG_ERR, "Duktape error: %s\n", duk_safe_to_string(t, -1));
 		}
 		duk_pop(t);
-		duk_pop(duktape_ctx);
-		janus_mutex_unlock(&duktape_mutex);
+		duk_pop(dctx->ctx);
+		janus_mutex_unlock(&dctx->mutex);
 		return;
 	}
 	/* Is this session allowed to send media? */
@@ -2527,11 +2836,12 @@ void janus_duktape_incoming_rtcp(janus_plugin_session *handle, janus_plugin_rtcp
 	char *buf = packet->buffer;
 	uint16_t len = packet->length;
 	/* Check if the JS script wants to handle/manipulate RTCP packets itself */
-	if(has_incoming_rtcp) {
+	if(has_incoming_rtcp && !g_atomic_int_get(&session->native_relay)) {
 		/* Yep, pass the data to the JS script and return */
-		janus_mutex_lock(&duktape_mutex);
-		duk_idx_t thr_idx = duk_push_thread(duktape_ctx);
-		duk_context *t = duk_get_context(duktape_ctx, thr_idx);
+		janus_duktape_context *dctx = session->dctx;
+		janus_mutex_lock(&dctx->mutex);
+		duk_idx_t thr_idx = duk_push_thread(dctx->ctx);
+		duk_context *t = duk_get_context(dctx->ctx, thr_idx);
 		duk_get_global_string(t, "incomingRtcp");
 		duk_push_number(t, session->id);
 		duk_push_boolean(t, video);
@@ -2543,18 +2853,20 @@ void janus_duktape_incoming_rtcp(janus_plugin_session *handle, janus_plugin_rtcp
 			JANUS_LOG(LOG_ERR, "Duktape error: %s\n", duk_safe_to_string(t, -1));
 		}
 		duk_pop(t);
-		duk_pop(duktape_ctx);
-		janus_mutex_unlock(&duktape_mutex);
+		duk_pop(dctx->ctx);
+		janus_mutex_unlock(&dctx->mutex);
 		return;
 	}
 	/* If a REMB arrived, make sure we cap it to our configuration, and send it as a video RTCP */
-	uint32_t bitrate = janus_rtcp_get_remb(buf, len);
-	if(bitrate > 0) {
+	janus_rtcp_compound *compound = packet->compound;
+	if(compound == NULL)
+		return;
+	if(compound->remb_bitrate > 0) {
 		/* No limit ~= 10000000 */
 		duktape_janus_core->send_remb(handle, session->bitrate ? session->bitrate : 10000000);
 	}
 	/* If there's an incoming PLI, instead, relay it to the source of the media if any */
-	if(janus_rtcp_has_pli(buf, len)) {
+	if(compound->has_pli) {
 		if(session->sender != NULL) {
 			janus_mutex_lock_nodebug(&session->sender->recipients_mutex);
 			/* Send a PLI */
@@ -2587,9 +2899,10 @@ void janus_duktape_incoming_data(janus_plugin_session *handle, janus_plugin_data
 		/* Yep, pass the data to the JS script and return */
 		if(packet->binary && !has_incoming_text_data)
 			JANUS_LOG(LOG_WARN, "Missing 'incomingTextData', invoking deprecated function 'incomingData' instead\n");
-		janus_mutex_lock(&duktape_mutex);
-		duk_idx_t thr_idx = duk_push_thread(duktape_ctx);
-		duk_context *t = duk_get_context(duktape_ctx, thr_idx);
+		janus_duktape_context *dctx = session->dctx;
+		janus_mutex_lock(&dctx->mutex);
+		duk_idx_t thr_idx = duk_push_thread(dctx->ctx);
+		duk_context *t = duk_get_context(dctx->ctx, thr_idx);
 		duk_get_global_string(t, packet->binary ? "incomingBinaryData" : (has_incoming_text_data ? "incomingTextData" : "incomingData"));
 		duk_push_number(t, session->id);
 		/* We use a string for both text and binary data */
@@ -2603,8 +2916,8 @@ void janus_duktape_incoming_data(janus_plugin_session *handle, janus_plugin_data
 			JANUS_LOG(LOG_ERR, "Duktape error: %s\n", duk_safe_to_string(t, -1));
 		}
 		duk_pop(t);
-		duk_pop(duktape_ctx);
-		janus_mutex_unlock(&duktape_mutex);
+		duk_pop(dctx->ctx);
+		janus_mutex_unlock(&dctx->mutex);
 		return;
 	}
 	/* Is this session allowed to send data? */
@@ -2641,9 +2954,10 @@ void janus_duktape_data_ready(janus_plugin_session *handle) {
 	/* Check if the JS script wants to receive this event */
 	if(has_data_ready) {
 		/* Yep, pass the event to the JS script and return */
-		janus_mutex_lock(&duktape_mutex);
-		duk_idx_t thr_idx = duk_push_thread(duktape_ctx);
-		duk_context *t = duk_get_context(duktape_ctx, thr_idx);
+		janus_duktape_context *dctx = session->dctx;
+		janus_mutex_lock(&dctx->mutex);
+		duk_idx_t thr_idx = duk_push_thread(dctx->ctx);
+		duk_context *t = duk_get_context(dctx->ctx, thr_idx);
 		duk_get_global_string(t, "dataReady");
 		duk_push_number(t, session->id);
 		int res = duk_pcall(t, 1);
@@ -2652,8 +2966,8 @@ void janus_duktape_data_ready(janus_plugin_session *handle) {
 			JANUS_LOG(LOG_ERR, "Duktape error: %s\n", duk_safe_to_string(t, -1));
 		}
 		duk_pop(t);
-		duk_pop(duktape_ctx);
-		janus_mutex_unlock(&duktape_mutex);
+		duk_pop(dctx->ctx);
+		janus_mutex_unlock(&dctx->mutex);
 		return;
 	}
 }
@@ -2675,9 +2989,10 @@ void janus_duktape_slow_link(janus_plugin_session *handle, int mindex, gboolean
 	janus_refcount_increase(&session->ref);
 	if(has_slow_link) {
 		/* Notify the JS script */
-		janus_mutex_lock(&duktape_mutex);
-		duk_idx_t thr_idx = duk_push_thread(duktape_ctx);
-		duk_context *t = duk_get_context(duktape_ctx, thr_idx);
+		janus_duktape_context *dctx = session->dctx;
+		janus_mutex_lock(&dctx->mutex);
+		duk_idx_t thr_idx = duk_push_thread(dctx->ctx);
+		duk_context *t = duk_get_context(dctx->ctx, thr_idx);
 		duk_get_global_string(t, "slowLink");
 		duk_push_number(t, session->id);
 		duk_push_boolean(t, uplink);
@@ -2688,8 +3003,8 @@ void janus_duktape_slow_link(janus_plugin_session *handle, int mindex, gboolean
 			JANUS_LOG(LOG_ERR, "Duktape error: %s\n", duk_safe_to_string(t, -1));
 		}
 		duk_pop(t);
-		duk_pop(duktape_ctx);
-		janus_mutex_unlock(&duktape_mutex);
+		duk_pop(dctx->ctx);
+		janus_mutex_unlock(&dctx->mutex);
 	}
 	janus_refcount_decrease(&session->ref);
 }
@@ -2750,9 +3065,10 @@ void janus_duktape_hangup_media(janus_plugin_session *handle) {
 	janus_mutex_unlock(&session->recipients_mutex);
 
 	/* Notify the JS script */
-	janus_mutex_lock(&duktape_mutex);
-	duk_idx_t thr_idx = duk_push_thread(duktape_ctx);
-	duk_context *t = duk_get_context(duktape_ctx, thr_idx);
+	janus_duktape_context *dctx = session->dctx;
+	janus_mutex_lock(&dctx->mutex);
+	duk_idx_t thr_idx = duk_push_thread(dctx->ctx);
+	duk_context *t = duk_get_context(dctx->ctx, thr_idx);
 	duk_get_global_string(t, "hangupMedia");
 	duk_push_number(t, session->id);
 	int res = duk_pcall(t, 1);
@@ -2761,12 +3077,25 @@ void janus_duktape_hangup_media(janus_plugin_session *handle) {
 		JANUS_LOG(LOG_ERR, "Duktape error: %s\n", duk_safe_to_string(t, -1));
 	}
 	duk_pop(t);
-	duk_pop(duktape_ctx);
-	janus_mutex_unlock(&duktape_mutex);
+	duk_pop(dctx->ctx);
+	janus_mutex_unlock(&dctx->mutex);
 	janus_refcount_decrease(&session->ref);
 }
 
 /* Helpers to quickly relay RTP and data packets to the intended recipients */
+/* Helper to queue a simulcast change notification for the scheduler of the session's context */
+static void janus_duktape_notify_simulcast(janus_duktape_session *session, gboolean temporal, int value) {
+	janus_duktape_context *dctx = session->dctx;
+	if(dctx == NULL)
+		return;
+	janus_duktape_notification *notification = g_malloc(sizeof(janus_duktape_notification));
+	notification->id = session->id;
+	notification->temporal = temporal;
+	notification->value = value;
+	g_async_queue_push(dctx->notifications, notification);
+	g_async_queue_push(dctx->events, GUINT_TO_POINTER(janus_duktape_event_notify));
+}
+
 static void janus_duktape_relay_rtp_packet(gpointer data, gpointer user_data) {
 	janus_duktape_rtp_relay_packet *packet = (janus_duktape_rtp_relay_packet *)user_data;
 	if(!packet || !packet->data || packet->length < 1) {
@@ -2805,41 +3134,13 @@ static void janus_duktape_relay_rtp_packet(gpointer data, gpointer user_data) {
 		/* Any event we should notify? */
 		if(session->sim_context.changed_substream) {
 			/* Notify the script about the substream change */
-			if(has_substream_changed) {
-				janus_mutex_lock(&duktape_mutex);
-				duk_idx_t thr_idx = duk_push_thread(duktape_ctx);
-				duk_context *t = duk_get_context(duktape_ctx, thr_idx);
-				duk_get_global_string(t, "substreamChanged");
-				duk_push_number(t, session->id);
-				duk_push_number(t, session->sim_context.substream);
-				int res = duk_pcall(t, 2);
-				if(res != DUK_EXEC_SUCCESS) {
-					/* Something went wrong... */
-					JANUS_LOG(LOG_ERR, "Duktape error: %s\n", duk_safe_to_string(t, -1));
-				}
-				duk_pop(t);
-				duk_pop(duktape_ctx);
-				janus_mutex_unlock(&duktape_mutex);
-			}
+			if(has_substream_changed)
+				janus_duktape_notify_simulcast(session, FALSE, session->sim_context.substream);
 		}
 		if(session->sim_context.changed_temporal) {
 			/* Notify the user about the temporal layer change */
-			if(has_substream_changed) {
-				janus_mutex_lock(&duktape_mutex);
-				duk_idx_t thr_idx = duk_push_thread(duktape_ctx);
-				duk_context *t = duk_get_context(duktape_ctx, thr_idx);
-				duk_get_global_string(t, "temporalLayerChanged");
-				duk_push_number(t, session->id);
-				duk_push_number(t, session->sim_context.templayer);
-				int res = duk_pcall(t, 2);
-				if(res != DUK_EXEC_SUCCESS) {
-					/* Something went wrong... */
-					JANUS_LOG(LOG_ERR, "Duktape error: %s\n", duk_safe_to_string(t, -1));
-				}
-				duk_pop(t);
-				duk_pop(duktape_ctx);
-				janus_mutex_unlock(&duktape_mutex);
-			}
+			if(has_temporal_changed)
+				janus_duktape_notify_simulcast(session, TRUE, session->sim_context.templayer);
 		}
 		/* If we got here, update the RTP header and send the packet */
 		janus_rtp_header_update(packet->data, &session->vrtpctx, TRUE, 0);
@@ -2910,28 +3211,49 @@ static void janus_duktape_relay_data_packet(gpointer data, gpointer user_data) {
 /* This is a scheduler thread: if we know there are coroutines to resume in
  * JavaScript (e.g., for asynchronous requests), we do that ourselves here */
 static void *janus_duktape_scheduler(void *data) {
-	JANUS_LOG(LOG_VERB, "Joining Duktape scheduler thread\n");
+	janus_duktape_context *dctx = (janus_duktape_context *)data;
+	JANUS_LOG(LOG_VERB, "Joining Duktape scheduler thread (context #%u)\n", dctx->index);
 	janus_duktape_event *event = NULL;
 	/* Wait until there are events to process */
 	while(g_atomic_int_get(&duktape_initialized) && !g_atomic_int_get(&duktape_stopping)) {
-		event = g_async_queue_pop(events);
+		event = g_async_queue_pop(dctx->events);
 		if(event == GUINT_TO_POINTER(janus_duktape_event_exit))
 			break;
 		if(event == GUINT_TO_POINTER(janus_duktape_event_resume)) {
 			/* There are coroutines to resume */
-			janus_mutex_lock(&duktape_mutex);
-			duk_get_global_string(duktape_ctx, "resumeScheduler");
-			int res = duk_pcall(duktape_ctx, 0);
+			janus_mutex_lock(&dctx->mutex);
+			duk_get_global_string(dctx->ctx, "resumeScheduler");
+			int res = duk_pcall(dctx->ctx, 0);
 			if(res != DUK_EXEC_SUCCESS) {
-				JANUS_LOG(LOG_ERR, "Duktape error: %s\n", duk_safe_to_string(duktape_ctx, -1));
+				JANUS_LOG(LOG_ERR, "Duktape error: %s\n", duk_safe_to_string(dctx->ctx, -1));
 			}
-			duk_pop(duktape_ctx);
+			duk_pop(dctx->ctx);
 			/* Print the count of elements into Duktape stack */
-			janus_duktape_stackdump(duktape_ctx);
-			janus_mutex_unlock(&duktape_mutex);
+			janus_duktape_stackdump(dctx->ctx);
+			janus_mutex_unlock(&dctx->mutex);
+		} else if(event == GUINT_TO_POINTER(janus_duktape_event_notify)) {
+			/* A session we relay media to switched simulcast substream or temporal layer */
+			janus_duktape_notification *notification = g_async_queue_try_pop(dctx->notifications);
+			if(notification == NULL)
+				continue;
+			janus_mutex_lock(&dctx->mutex);
+			duk_idx_t thr_idx = duk_push_thread(dctx->ctx);
+			duk_context *t = duk_get_context(dctx->ctx, thr_idx);
+			duk_get_global_string(t, notification->temporal ? "temporalLayerChanged" : "substreamChanged");
+			duk_push_number(t, notification->id);
+			duk_push_number(t, notification->value);
+			int res = duk_pcall(t, 2);
+			if(res != DUK_EXEC_SUCCESS) {
+				/* Something went wrong... */
+				JANUS_LOG(LOG_ERR, "Duktape error: %s\n", duk_safe_to_string(t, -1));
+			}
+			duk_pop(t);
+			duk_pop(dctx->ctx);
+			janus_mutex_unlock(&dctx->mutex);
+			g_free(notification);
 		}
 	}
-	JANUS_LOG(LOG_VERB, "Leaving Duktape scheduler thread\n");
+	JANUS_LOG(LOG_VERB, "Leaving Duktape scheduler thread (context #%u)\n", dctx->index);
 	return NULL;
 }
 
@@ -2956,9 +3278,10 @@ static gboolean janus_duktape_timer_cb(void *data) {
 		return FALSE;
 	/* Invoke the callback with the provided argument, if available */
 	JANUS_LOG(LOG_VERB, "Invoking scheduled callback (waited %"SCNu32"ms) with ID %u\n", cb->ms, cb->id);
-	janus_mutex_lock(&duktape_mutex);
-	duk_idx_t thr_idx = duk_push_thread(duktape_ctx);
-	duk_context *t = duk_get_context(duktape_ctx, thr_idx);
+	janus_duktape_context *dctx = cb->dctx ? cb->dctx : duktape_contexts[0];
+	janus_mutex_lock(&dctx->mutex);
+	duk_idx_t thr_idx = duk_push_thread(dctx->ctx);
+	duk_context *t = duk_get_context(dctx->ctx, thr_idx);
 	duk_get_global_string(t, cb->function);
 	if(cb->argument) {
 		duk_push_string(t, cb->argument);
@@ -2968,9 +3291,11 @@ static gboolean janus_duktape_timer_cb(void *data) {
 		JANUS_LOG(LOG_ERR, "Duktape error: %s\n", duk_safe_to_string(t, -1));
 	}
 	duk_pop(t);
-	duk_pop(duktape_ctx);
+	duk_pop(dctx->ctx);
+	janus_mutex_unlock(&dctx->mutex);
 	/* Done */
+	janus_mutex_lock(&callbacks_mutex);
 	g_hash_table_remove(callbacks, cb);
-	janus_mutex_unlock(&duktape_mutex);
+	janus_mutex_unlock(&callbacks_mutex);
 	return FALSE;
 }
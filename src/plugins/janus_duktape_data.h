@@ -43,9 +43,24 @@
 extern volatile gint duktape_initialized, duktape_stopping;
 extern janus_callbacks *duktape_janus_core;
 
-/* Duktape context: we define context and mutex as extern */
-extern duk_context *duktape_ctx;
-extern janus_mutex duktape_mutex;
+/* Duktape contexts: the script is loaded in a pool of contexts (each
+ * in its own heap), each with its own mutex and scheduler, and sessions
+ * are pinned to one of them, so that sessions assigned to different
+ * contexts don't serialize on the same interpreter. We define the pool
+ * as extern, so that extra code can use it */
+typedef struct janus_duktape_context {
+	guint index;						/* Index of this context in the pool */
+	duk_context *ctx;					/* The Duktape context itself */
+	janus_mutex mutex;					/* Mutex to lock the context */
+	GThread *scheduler;					/* Thread resuming coroutines for this context */
+	GAsyncQueue *events;				/* Events for the scheduler */
+	GAsyncQueue *notifications;			/* Simulcast changes the scheduler must notify to the script */
+	volatile gint sessions;				/* Number of sessions pinned to this context */
+} janus_duktape_context;
+extern janus_duktape_context **duktape_contexts;
+extern guint duktape_contexts_count;
+/* Helper to find the context a duk_context (or one of its threads) belongs to */
+janus_duktape_context *janus_duktape_context_get(duk_context *ctx);
 
 /* Duktape session: we keep only the barebone stuff here, the rest will be in the JavaScript script */
 typedef struct janus_duktape_session {
@@ -70,6 +85,7 @@ typedef struct janus_duktape_session {
 	uint32_t bitrate;					/* Bitrate limit */
 	uint16_t pli_freq;					/* Regular PLI frequency (0=disabled) */
 	gint64 pli_latest;					/* Time of latest sent PLI (to avoid flooding) */
+	volatile gint native_relay;			/* Whether RTP/RTCP from this session is routed in C even if the script handles media */
 	GSList *recipients;					/* Sessions that should receive media from this session */
 	struct janus_duktape_session *sender;	/* Other session this session is receiving media from */
 	janus_mutex recipients_mutex;		/* Mutex to lock the recipients list */
@@ -84,6 +100,7 @@ typedef struct janus_duktape_session {
 	volatile gint dataready;			/* Whether the data channel was established on this sessions's PeerConnection */
 	volatile gint hangingup;			/* Whether this session's PeerConnection is hanging up */
 	volatile gint destroyed;			/* Whether this session's been marked as destroyed */
+	janus_duktape_context *dctx;		/* Duktape context this session is pinned to */
 	/* If you need any additional property (e.g., for hooks you added in janus_duktape_extra.c) add them below this line */
 
 	/* Reference counter */
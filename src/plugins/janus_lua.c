@@ -74,7 +74,18 @@
  * events on substream and/or temporal layer changes happening for
  * receiving sessions via the \c substreamChanged() and the
  * \c temporalLayerChanged() callbacks: this may be useful to track
- * which layer is actually being sent, vs. what was requested.
+ * which layer is actually being sent, vs. what was requested. These
+ * two callbacks are invoked asynchronously by the C scheduler, so that
+ * the media path never has to wait for the Lua state to be available.
+ *
+ * \note When the script implements \c incomingRtp() or \c incomingRtcp()
+ * all media goes through Lua, which is expensive. Scripts that only need
+ * to inspect media for some sessions can use \c setNativeRelay() to have
+ * the C code route the media of all other sessions itself instead,
+ * according to what was configured via \c addRecipient() \c setSubstream()
+ * \c setTemporalLayer() and so on: in that case, packets are relayed
+ * (and rewritten, for simulcast) on the core media loops, without ever
+ * involving the Lua state.
  *
  * \section capi C interfaces
  *
@@ -99,10 +110,14 @@
  * - \c setSubstream(): set the target simulcast substream;
  * - \c setTemporalLayer(): set the target simulcast temporal layer;
  * - \c sendPli(): send a PLI (keyframe request);
+ * - \c setNativeRelay(): specify whether the C code should route this user's media even if the script implements \c incomingRtp() / \c incomingRtcp();
  * - \c startRecording(): start recording audio, video and or data for a user;
  * - \c stopRecording(): start recording audio, video and or data for a user;
  * - \c pokeScheduler(): notify the C code that there's a coroutine to resume;
- * - \c timeCallback(): trigger the execution of a Lua function after X milliseconds.
+ * - \c timeCallback(): trigger the execution of a Lua function after X milliseconds;
+ * - \c getSharedData(): read a value shared by all Lua states (see \ref luastates);
+ * - \c setSharedData(): set (or remove, if \c nil ) a value shared by all Lua states;
+ * - \c incrementSharedData(): atomically add to a numeric value shared by all Lua states.
  *
  * As anticipated in the previous section, almost all these methods also
  * expect the unique session identifier to address a specific user in the
@@ -187,6 +202,46 @@ timeCallback("resumeScheduler", nil, 0)
  * compact and less verbose, and as such is preferred in cases where
  * timing and opaque arguments are not needed.
  *
+ * \section luastates Multiple Lua states
+ *
+ * By default, the script is loaded in a single Lua state, which means
+ * that all callbacks, for all sessions, are serialized on the same
+ * interpreter. To take advantage of multiple cores, you can set the
+ * \c states property in the plugin configuration: the script will then
+ * be loaded in as many independent Lua states, each with its own lock
+ * and its own coroutines scheduler, and each new session will be pinned
+ * to one of them (picked by hashing the session identifier). All the
+ * callbacks involving a session (e.g., \c handleMessage(), \c setupMedia()
+ * or \c incomingRtp() ) are always invoked on the state the session
+ * is pinned to, while \c timeCallback() and \c pokeScheduler() only
+ * affect the state they're invoked from. Plugin information callbacks
+ * (e.g., \c getVersion() ) and \c handleAdminMessage() are always
+ * invoked on the first state.
+ *
+ * The \c init() and \c destroy() callbacks are invoked on all states:
+ * besides the path to the configuration file, \c init() also receives
+ * the index of the state it's invoked on, and how many states there are.
+ *
+ * Since states don't share any Lua global, scripts that need to keep
+ * track of resources spanning multiple sessions (e.g., rooms) must not
+ * rely on Lua tables only when more than one state is configured. The
+ * \c getSharedData() \c setSharedData() and \c incrementSharedData()
+ * functions give access to a simple key/value store (where values are
+ * strings) that all states can read and update, e.g.:
+ *
+ * \verbatim
+-- Store info on a room where all states can see it
+setSharedData("room-1234", json.encode(room))
+-- Allocate a unique ID, whatever the state we're running on
+local id = incrementSharedData("room-ids", 1)
+-- Remove it
+setSharedData("room-1234", nil)
+\endverbatim
+ *
+ * All the functions the C code exposes that address sessions (e.g.,
+ * \c pushEvent() or \c addRecipient() ) work on any session, whatever
+ * state it's pinned to.
+ *
  * Refer to the \ref luapapi section for more information on how you
  * can register your own C functions.
  */
@@ -270,8 +325,15 @@ volatile gint lua_initialized = 0, lua_stopping = 0;
 janus_callbacks *lua_janus_core = NULL;
 
 /* Lua stuff */
-lua_State *lua_state = NULL;
-janus_mutex lua_mutex = JANUS_MUTEX_INITIALIZER;
+janus_lua_state **lua_states = NULL;
+guint lua_states_count = 0;
+/* Maximum number of Lua states we'll create */
+#define JANUS_LUA_MAX_STATES	64
+/* Key we use to save the janus_lua_state pointer in the registry of each state */
+static const char *lua_state_key = "janus_lua_state";
+/* Data scripts can share across states */
+static GHashTable *lua_shared_data = NULL;
+static janus_mutex lua_shared_data_mutex = JANUS_MUTEX_INITIALIZER;
 static const char *lua_functions[] = {
 	"init", "destroy", "resumeScheduler",
 	"createSession", "destroySession", "querySession",
@@ -303,14 +365,20 @@ static gboolean has_slow_link = FALSE;
 static gboolean has_substream_changed = FALSE;
 static gboolean has_temporal_changed = FALSE;
 /* Lua C scheduler (for coroutines) */
-static GThread *scheduler_thread = NULL;
 static void *janus_lua_scheduler(void *data);
-static GAsyncQueue *events = NULL;
 typedef enum janus_lua_event {
 	janus_lua_event_none = 0,
 	janus_lua_event_resume,		/* Resume one or more pending coroutines */
+	janus_lua_event_notify,		/* Notify a simulcast change to the script */
 	janus_lua_event_exit		/* Break the scheduler loop */
 } janus_lua_event;
+/* Simulcast changes are notified to the script by the scheduler of the
+ * state the session is pinned to, and not by the thread relaying media */
+typedef struct janus_lua_notification {
+	uint32_t id;
+	gboolean temporal;
+	int value;
+} janus_lua_notification;
 /* Lua timer loop (for scheduled callbacks) */
 static GMainContext *timer_context = NULL;
 static GMainLoop *timer_loop = NULL;
@@ -319,12 +387,14 @@ static void *janus_lua_timer(void *data);
 static gboolean janus_lua_timer_cb(void *data);
 typedef struct janus_lua_callback {
 	guint id;
+	janus_lua_state *lstate;
 	uint32_t ms;
 	GSource *source;
 	char *function;
 	char *argument;
 } janus_lua_callback;
 static GHashTable *callbacks = NULL;
+static janus_mutex callbacks_mutex = JANUS_MUTEX_INITIALIZER;
 static void janus_lua_callback_free(janus_lua_callback *cb) {
 	if(!cb)
 		return;
@@ -357,6 +427,8 @@ static void janus_lua_session_free(const janus_refcount *session_ref) {
 	janus_refcount_decrease(&session->handle->ref);
 	/* This session can be destroyed, free all the resources */
 	g_hash_table_remove(lua_ids, GUINT_TO_POINTER(session->id));
+	if(session->lstate != NULL)
+		g_atomic_int_add(&session->lstate->sessions, -1);
 	janus_recorder_destroy(session->arc);
 	janus_recorder_destroy(session->vrc);
 	janus_recorder_destroy(session->drc);
@@ -438,7 +510,12 @@ static int janus_lua_method_januslog(lua_State *s) {
 
 static int janus_lua_method_pokescheduler(lua_State *s) {
 	/* This method allows the Lua script to poke the scheduler and have it wake up ASAP */
-	g_async_queue_push(events, GUINT_TO_POINTER(janus_lua_event_resume));
+	janus_lua_state *lstate = janus_lua_state_get(s);
+	if(lstate == NULL) {
+		lua_pushnumber(s, -1);
+		return 1;
+	}
+	g_async_queue_push(lstate->events, GUINT_TO_POINTER(janus_lua_event_resume));
 	lua_pushnumber(s, 0);
 	return 1;
 }
@@ -459,22 +536,98 @@ static int janus_lua_method_timecallback(lua_State *s) {
 	}
 	const char *argument = lua_tostring(s, 2);
 	guint32 ms = lua_tonumber(s, 3);
-	/* Create a callback instance */
+	/* Create a callback instance: it will be invoked on the same state */
 	janus_lua_callback *cb = g_malloc0(sizeof(janus_lua_callback));
+	cb->lstate = janus_lua_state_get(s);
 	cb->function = g_strdup(function);
 	if(argument != NULL)
 		cb->argument = g_strdup(argument);
 	cb->ms = ms;
 	cb->source = g_timeout_source_new(ms);
 	g_source_set_callback(cb->source, janus_lua_timer_cb, cb, NULL);
+	janus_mutex_lock(&callbacks_mutex);
 	g_hash_table_insert(callbacks, cb, cb);
 	cb->id = g_source_attach(cb->source, timer_context);
+	janus_mutex_unlock(&callbacks_mutex);
 	JANUS_LOG(LOG_VERB, "Created scheduled callback (%"SCNu32"ms) with ID %u\n", cb->ms, cb->id);
 	/* Done */
 	lua_pushnumber(s, 0);
 	return 1;
 }
 
+static int janus_lua_method_getshareddata(lua_State *s) {
+	/* This method allows the Lua script to read data shared by all states */
+	int n = lua_gettop(s);
+	if(n != 1) {
+		JANUS_LOG(LOG_ERR, "Wrong number of arguments: %d (expected 1)\n", n);
+		lua_pushnil(s);
+		return 1;
+	}
+	const char *key = lua_tostring(s, 1);
+	if(key == NULL) {
+		JANUS_LOG(LOG_ERR, "Invalid argument (missing key)\n");
+		lua_pushnil(s);
+		return 1;
+	}
+	janus_mutex_lock(&lua_shared_data_mutex);
+	const char *value = g_hash_table_lookup(lua_shared_data, key);
+	if(value != NULL)
+		lua_pushstring(s, value);
+	else
+		lua_pushnil(s);
+	janus_mutex_unlock(&lua_shared_data_mutex);
+	return 1;
+}
+
+static int janus_lua_method_setshareddata(lua_State *s) {
+	/* This method allows the Lua script to update data shared by all states (nil removes it) */
+	int n = lua_gettop(s);
+	if(n != 2) {
+		JANUS_LOG(LOG_ERR, "Wrong number of arguments: %d (expected 2)\n", n);
+		lua_pushnumber(s, -1);
+		return 1;
+	}
+	const char *key = lua_tostring(s, 1);
+	if(key == NULL) {
+		JANUS_LOG(LOG_ERR, "Invalid argument (missing key)\n");
+		lua_pushnumber(s, -1);
+		return 1;
+	}
+	const char *value = lua_isnil(s, 2) ? NULL : lua_tostring(s, 2);
+	janus_mutex_lock(&lua_shared_data_mutex);
+	if(value == NULL)
+		g_hash_table_remove(lua_shared_data, key);
+	else
+		g_hash_table_insert(lua_shared_data, g_strdup(key), g_strdup(value));
+	janus_mutex_unlock(&lua_shared_data_mutex);
+	lua_pushnumber(s, 0);
+	return 1;
+}
+
+static int janus_lua_method_incrementshareddata(lua_State *s) {
+	/* This method allows the Lua script to atomically update a numeric value shared by all states */
+	int n = lua_gettop(s);
+	if(n != 2) {
+		JANUS_LOG(LOG_ERR, "Wrong number of arguments: %d (expected 2)\n", n);
+		lua_pushnil(s);
+		return 1;
+	}
+	const char *key = lua_tostring(s, 1);
+	if(key == NULL) {
+		JANUS_LOG(LOG_ERR, "Invalid argument (missing key)\n");
+		lua_pushnil(s);
+		return 1;
+	}
+	gint64 delta = (gint64)lua_tonumber(s, 2);
+	janus_mutex_lock(&lua_shared_data_mutex);
+	const char *value = g_hash_table_lookup(lua_shared_data, key);
+	gint64 result = (value ? g_ascii_strtoll(value, NULL, 10) : 0) + delta;
+	g_hash_table_insert(lua_shared_data, g_strdup(key), g_strdup_printf("%"SCNi64, result));
+	janus_mutex_unlock(&lua_shared_data_mutex);
+	lua_pushnumber(s, result);
+	return 1;
+}
+
 static int janus_lua_method_pushevent(lua_State *s) {
 	/* Get the arguments from the provided state */
 	int n = lua_gettop(s);
@@ -962,6 +1115,34 @@ static int janus_lua_method_sendpli(lua_State *s) {
 	return 1;
 }
 
+static int janus_lua_method_setnativerelay(lua_State *s) {
+	/* Get the arguments from the provided state */
+	int n = lua_gettop(s);
+	if(n != 2) {
+		JANUS_LOG(LOG_ERR, "Wrong number of arguments: %d (expected 2)\n", n);
+		lua_pushnumber(s, -1);
+		return 1;
+	}
+	guint32 id = lua_tonumber(s, 1);
+	gboolean native_relay = lua_toboolean(s, 2);
+	/* Find the session */
+	janus_mutex_lock(&lua_sessions_mutex);
+	janus_lua_session *session = g_hash_table_lookup(lua_ids, GUINT_TO_POINTER(id));
+	if(session == NULL || g_atomic_int_get(&session->destroyed)) {
+		janus_mutex_unlock(&lua_sessions_mutex);
+		lua_pushnumber(s, -1);
+		return 1;
+	}
+	janus_refcount_increase(&session->ref);
+	janus_mutex_unlock(&lua_sessions_mutex);
+	g_atomic_int_set(&session->native_relay, native_relay ? 1 : 0);
+	JANUS_LOG(LOG_VERB, "Media from session %"SCNu32" will be routed by %s\n", session->id, native_relay ? "the C code" : "the script");
+	/* Done */
+	janus_refcount_decrease(&session->ref);
+	lua_pushnumber(s, 0);
+	return 1;
+}
+
 static int janus_lua_method_relayrtp(lua_State *s) {
 	/* Get the arguments from the provided state */
 	int n = lua_gettop(s);
@@ -1321,6 +1502,126 @@ static int janus_lua_method_stoprecording(lua_State *s) {
 
 
 /* Plugin implementation */
+/* Lua states management */
+janus_lua_state *janus_lua_state_get(lua_State *s) {
+	if(s == NULL)
+		return NULL;
+	/* Threads share the registry of the state they were created from */
+	lua_getfield(s, LUA_REGISTRYINDEX, lua_state_key);
+	janus_lua_state *lstate = (janus_lua_state *)lua_touserdata(s, -1);
+	lua_pop(s, 1);
+	return lstate;
+}
+
+static void janus_lua_state_destroy(janus_lua_state *lstate) {
+	if(lstate == NULL)
+		return;
+	if(lstate->scheduler != NULL) {
+		g_async_queue_push(lstate->events, GUINT_TO_POINTER(janus_lua_event_exit));
+		g_thread_join(lstate->scheduler);
+		lstate->scheduler = NULL;
+	}
+	janus_mutex_lock(&lstate->mutex);
+	if(lstate->state != NULL)
+		lua_close(lstate->state);
+	lstate->state = NULL;
+	janus_mutex_unlock(&lstate->mutex);
+	g_async_queue_unref(lstate->events);
+	g_async_queue_unref(lstate->notifications);
+	janus_mutex_destroy(&lstate->mutex);
+	g_free(lstate);
+}
+
+static void janus_lua_states_free(void) {
+	guint i = 0;
+	for(i=0; i<lua_states_count; i++)
+		janus_lua_state_destroy(lua_states[i]);
+	g_free(lua_states);
+	lua_states = NULL;
+	lua_states_count = 0;
+}
+
+/* Helper to create a new Lua state, and load the script in it */
+static janus_lua_state *janus_lua_state_create(guint index, const char *lua_folder, const char *lua_file) {
+	lua_State *state = luaL_newstate();
+	luaL_openlibs(state);
+
+	if(lua_folder != NULL) {
+		/* Add the script folder to the path, so that we can load other scripts from there */
+		lua_getglobal(state, "package");
+		lua_getfield(state, -1, "path");
+		const char *cur_path = lua_tostring(state, -1);
+		char new_path[1024];
+		memset(new_path, 0, sizeof(new_path));
+		g_snprintf(new_path, sizeof(new_path), "%s;%s/?.lua", cur_path, lua_folder);
+		lua_pop(state, 1);
+		lua_pushstring(state, new_path);
+		lua_setfield(state, -2, "path");
+		lua_pop(state, 1);
+	}
+
+	/* Register our functions */
+	lua_register(state, "janusLog", janus_lua_method_januslog);
+	lua_register(state, "pokeScheduler", janus_lua_method_pokescheduler);
+	lua_register(state, "timeCallback", janus_lua_method_timecallback);
+	lua_register(state, "getSharedData", janus_lua_method_getshareddata);
+	lua_register(state, "setSharedData", janus_lua_method_setshareddata);
+	lua_register(state, "incrementSharedData", janus_lua_method_incrementshareddata);
+	lua_register(state, "pushEvent", janus_lua_method_pushevent);
+	lua_register(state, "notifyEvent", janus_lua_method_notifyevent);
+	lua_register(state, "eventsIsEnabled", janus_lua_method_eventsisenabled);
+	lua_register(state, "closePc", janus_lua_method_closepc);
+	lua_register(state, "endSession", janus_lua_method_endsession);
+	lua_register(state, "configureMedium", janus_lua_method_configuremedium);
+	lua_register(state, "addRecipient", janus_lua_method_addrecipient);
+	lua_register(state, "removeRecipient", janus_lua_method_removerecipient);
+	lua_register(state, "setBitrate", janus_lua_method_setbitrate);
+	lua_register(state, "setPliFreq", janus_lua_method_setplifreq);
+	lua_register(state, "setSubstream", janus_lua_method_setsubstream);
+	lua_register(state, "setTemporalLayer", janus_lua_method_settemporallayer);
+	lua_register(state, "sendPli", janus_lua_method_sendpli);
+	lua_register(state, "setNativeRelay", janus_lua_method_setnativerelay);
+	lua_register(state, "relayRtp", janus_lua_method_relayrtp);
+	lua_register(state, "relayRtcp", janus_lua_method_relayrtcp);
+	lua_register(state, "relayData", janus_lua_method_relaydata);	/* Legacy function, deprecated */
+	lua_register(state, "relayTextData", janus_lua_method_relaytextdata);
+	lua_register(state, "relayBinaryData", janus_lua_method_relaybinarydata);
+	lua_register(state, "startRecording", janus_lua_method_startrecording);
+	lua_register(state, "stopRecording", janus_lua_method_stoprecording);
+	/* Register all extra functions, if any were added */
+	janus_lua_register_extra_functions(state);
+
+	/* Keep track of the janus_lua_state instance in the registry, for the functions that need it */
+	janus_lua_state *lstate = g_malloc0(sizeof(janus_lua_state));
+	lstate->index = index;
+	lstate->state = state;
+	janus_mutex_init(&lstate->mutex);
+	lstate->events = g_async_queue_new();
+	lstate->notifications = g_async_queue_new_full((GDestroyNotify)g_free);
+	lua_pushlightuserdata(state, lstate);
+	lua_setfield(state, LUA_REGISTRYINDEX, lua_state_key);
+
+	/* Now load the script */
+	int err = luaL_dofile(state, lua_file);
+	if(err) {
+		JANUS_LOG(LOG_ERR, "Error loading Lua script %s: %s\n", lua_file, lua_tostring(state, -1));
+		janus_lua_state_destroy(lstate);
+		return NULL;
+	}
+	/* Make sure that all the functions we need are there */
+	uint i=0;
+	for(i=0; i<lua_funcsize; i++) {
+		lua_getglobal(state, lua_functions[i]);
+		if(lua_isfunction(state, lua_gettop(state)) == 0) {
+			JANUS_LOG(LOG_ERR, "Function '%s' is missing in %s\n", lua_functions[i], lua_file);
+			janus_lua_state_destroy(lstate);
+			return NULL;
+		}
+		lua_pop(state, 1);
+	}
+	return lstate;
+}
+
 int janus_lua_init(janus_callbacks *callback, const char *config_path) {
 	if(g_atomic_int_get(&lua_stopping)) {
 		/* Still stopping from before */
@@ -1365,77 +1666,39 @@ int janus_lua_init(janus_callbacks *callback, const char *config_path) {
 	janus_config_item *conf = janus_config_get(config, config_general, janus_config_type_item, "config");
 	if(conf && conf->value)
 		lua_config = g_strdup(conf->value);
-	janus_config_destroy(config);
-
-	/* Initialize Lua */
-	lua_state = luaL_newstate();
-	luaL_openlibs(lua_state);
-
-	if(lua_folder != NULL) {
-		/* Add the script folder to the path, so that we can load other scripts from there */
-		lua_getglobal(lua_state, "package");
-		lua_getfield(lua_state, -1, "path");
-		const char *cur_path = lua_tostring(lua_state, -1);
-		char new_path[1024];
-		memset(new_path, 0, sizeof(new_path));
-		g_snprintf(new_path, sizeof(new_path), "%s;%s/?.lua", cur_path, lua_folder);
-		lua_pop(lua_state, 1);
-		lua_pushstring(lua_state, new_path);
-		lua_setfield(lua_state, -2, "path");
-		lua_pop(lua_state, 1);
+	guint states = 1;
+	janus_config_item *item = janus_config_get(config, config_general, janus_config_type_item, "states");
+	if(item && item->value) {
+		int num = atoi(item->value);
+		if(num < 1 || num > JANUS_LUA_MAX_STATES) {
+			JANUS_LOG(LOG_WARN, "Invalid number of Lua states (%s), using %d instead\n",
+				item->value, num < 1 ? 1 : JANUS_LUA_MAX_STATES);
+			num = num < 1 ? 1 : JANUS_LUA_MAX_STATES;
+		}
+		states = num;
 	}
+	janus_config_destroy(config);
 
-	/* Register our functions */
-	lua_register(lua_state, "janusLog", janus_lua_method_januslog);
-	lua_register(lua_state, "pokeScheduler", janus_lua_method_pokescheduler);
-	lua_register(lua_state, "timeCallback", janus_lua_method_timecallback);
-	lua_register(lua_state, "pushEvent", janus_lua_method_pushevent);
-	lua_register(lua_state, "notifyEvent", janus_lua_method_notifyevent);
-	lua_register(lua_state, "eventsIsEnabled", janus_lua_method_eventsisenabled);
-	lua_register(lua_state, "closePc", janus_lua_method_closepc);
-	lua_register(lua_state, "endSession", janus_lua_method_endsession);
-	lua_register(lua_state, "configureMedium", janus_lua_method_configuremedium);
-	lua_register(lua_state, "addRecipient", janus_lua_method_addrecipient);
-	lua_register(lua_state, "removeRecipient", janus_lua_method_removerecipient);
-	lua_register(lua_state, "setBitrate", janus_lua_method_setbitrate);
-	lua_register(lua_state, "setPliFreq", janus_lua_method_setplifreq);
-	lua_register(lua_state, "setSubstream", janus_lua_method_setsubstream);
-	lua_register(lua_state, "setTemporalLayer", janus_lua_method_settemporallayer);
-	lua_register(lua_state, "sendPli", janus_lua_method_sendpli);
-	lua_register(lua_state, "relayRtp", janus_lua_method_relayrtp);
-	lua_register(lua_state, "relayRtcp", janus_lua_method_relayrtcp);
-	lua_register(lua_state, "relayData", janus_lua_method_relaydata);	/* Legacy function, deprecated */
-	lua_register(lua_state, "relayTextData", janus_lua_method_relaytextdata);
-	lua_register(lua_state, "relayBinaryData", janus_lua_method_relaybinarydata);
-	lua_register(lua_state, "startRecording", janus_lua_method_startrecording);
-	lua_register(lua_state, "stopRecording", janus_lua_method_stoprecording);
-	/* Register all extra functions, if any were added */
-	janus_lua_register_extra_functions(lua_state);
-
-	/* Now load the script */
-	int err = luaL_dofile(lua_state, lua_file);
-	if(err) {
-		JANUS_LOG(LOG_ERR, "Error loading Lua script %s: %s\n", lua_file, lua_tostring(lua_state, -1));
-		lua_close(lua_state);
-		g_free(lua_folder);
-		g_free(lua_file);
-		return -1;
-	}
-	/* Make sure that all the functions we need are there */
-	uint i=0;
-	for(i=0; i<lua_funcsize; i++) {
-		lua_getglobal(lua_state, lua_functions[i]);
-		if(lua_isfunction(lua_state, lua_gettop(lua_state)) == 0) {
-			JANUS_LOG(LOG_ERR, "Function '%s' is missing in %s\n", lua_functions[i], lua_file);
-			lua_close(lua_state);
+	/* Initialize Lua: we load the script in as many states as configured */
+	lua_states = g_malloc0(states * sizeof(janus_lua_state *));
+	guint i = 0;
+	for(i=0; i<states; i++) {
+		lua_states[i] = janus_lua_state_create(i, lua_folder, lua_file);
+		if(lua_states[i] == NULL) {
+			janus_lua_states_free();
 			g_free(lua_folder);
 			g_free(lua_file);
+			g_free(lua_config);
 			return -1;
 		}
+		lua_states_count++;
 	}
+	JANUS_LOG(LOG_VERB, "Loaded %s in %u Lua state(s)\n", lua_file, lua_states_count);
 	/* Some Lua functions are optional (e.g., those to directly handle RTP, RTCP and
 	 * data, as those will typically be kept at a C level, with Lua only dictating
-	 * the logic, or those overriding the plugin namespace and versioning information */
+	 * the logic, or those overriding the plugin namespace and versioning information:
+	 * since all states run the same script, we only check the first one */
+	lua_State *lua_state = lua_states[0]->state;
 	lua_getglobal(lua_state, "getVersion");
 	if(lua_isfunction(lua_state, lua_gettop(lua_state)) != 0)
 		has_get_version = TRUE;
@@ -1487,27 +1750,32 @@ int janus_lua_init(janus_callbacks *callback, const char *config_path) {
 	lua_getglobal(lua_state, "temporalLayerChanged");
 	if(lua_isfunction(lua_state, lua_gettop(lua_state)) != 0)
 		has_temporal_changed = TRUE;
+	lua_settop(lua_state, 0);
 
 	lua_sessions = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify)janus_lua_session_destroy);
 	lua_ids = g_hash_table_new(NULL, NULL);
-	events = g_async_queue_new();
 	callbacks = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify)janus_lua_callback_free);
+	lua_shared_data = g_hash_table_new_full(g_str_hash, g_str_equal, (GDestroyNotify)g_free, (GDestroyNotify)g_free);
 
 	g_atomic_int_set(&lua_initialized, 1);
 
-	/* Launch the scheduler thread (which will be responsible for resuming asynchronous coroutines) */
+	/* Launch the scheduler threads (each responsible for resuming the asynchronous coroutines of a state) */
 	GError *error = NULL;
-	scheduler_thread = g_thread_try_new("lua scheduler", janus_lua_scheduler, NULL, &error);
-	if(error != NULL) {
-		g_atomic_int_set(&lua_initialized, 0);
-		JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch the Lua scheduler thread...\n",
-			error->code, error->message ? error->message : "??");
-		g_error_free(error);
-		lua_close(lua_state);
-		g_free(lua_folder);
-		g_free(lua_file);
-		g_free(lua_config);
-		return -1;
+	for(i=0; i<lua_states_count; i++) {
+		char tname[16];
+		g_snprintf(tname, sizeof(tname), "lua sched %u", i);
+		lua_states[i]->scheduler = g_thread_try_new(tname, janus_lua_scheduler, lua_states[i], &error);
+		if(error != NULL) {
+			g_atomic_int_set(&lua_initialized, 0);
+			JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch the Lua scheduler thread...\n",
+				error->code, error->message ? error->message : "??");
+			g_error_free(error);
+			janus_lua_states_free();
+			g_free(lua_folder);
+			g_free(lua_file);
+			g_free(lua_config);
+			return -1;
+		}
 	}
 	/* Launch the timer loop thread (which will be responsible for scheduling timed callbacks) */
 	timer_context = g_main_context_new();
@@ -1522,7 +1790,7 @@ int janus_lua_init(janus_callbacks *callback, const char *config_path) {
 			g_main_loop_unref(timer_loop);
 		if(timer_context != NULL)
 			g_main_context_unref(timer_context);
-		lua_close(lua_state);
+		janus_lua_states_free();
 		g_free(lua_folder);
 		g_free(lua_file);
 		g_free(lua_config);
@@ -1532,10 +1800,18 @@ int janus_lua_init(janus_callbacks *callback, const char *config_path) {
 	/* This is the callback we'll need to invoke to contact the Janus core */
 	lua_janus_core = callback;
 
-	/* Init the Lua script, in case it's needed */
-	lua_getglobal(lua_state, "init");
-	lua_pushstring(lua_state, lua_config);
-	lua_call(lua_state, 1, 0);
+	/* Init the Lua script in all states, in case it's needed: besides the
+	 * configuration file, we pass the index of the state and how many there are */
+	for(i=0; i<lua_states_count; i++) {
+		janus_lua_state *lstate = lua_states[i];
+		janus_mutex_lock(&lstate->mutex);
+		lua_getglobal(lstate->state, "init");
+		lua_pushstring(lstate->state, lua_config);
+		lua_pushnumber(lstate->state, lstate->index);
+		lua_pushnumber(lstate->state, lua_states_count);
+		lua_call(lstate->state, 3, 0);
+		janus_mutex_unlock(&lstate->mutex);
+	}
 
 	g_free(lua_folder);
 	g_free(lua_file);
@@ -1550,10 +1826,14 @@ void janus_lua_destroy(void) {
 		return;
 	g_atomic_int_set(&lua_stopping, 1);
 
-	g_async_queue_push(events, GUINT_TO_POINTER(janus_lua_event_exit));
-	if(scheduler_thread != NULL) {
-		g_thread_join(scheduler_thread);
-		scheduler_thread = NULL;
+	guint i = 0;
+	for(i=0; i<lua_states_count; i++) {
+		janus_lua_state *lstate = lua_states[i];
+		g_async_queue_push(lstate->events, GUINT_TO_POINTER(janus_lua_event_exit));
+		if(lstate->scheduler != NULL) {
+			g_thread_join(lstate->scheduler);
+			lstate->scheduler = NULL;
+		}
 	}
 	if(timer_loop != NULL)
 		g_main_loop_quit(timer_loop);
@@ -1570,27 +1850,31 @@ void janus_lua_destroy(void) {
 		timer_context = NULL;
 	}
 
-	/* Deinit the Lua script, in case it's needed */
-	janus_mutex_lock(&lua_mutex);
-	lua_getglobal(lua_state, "destroy");
-	lua_call(lua_state, 0, 0);
+	/* Deinit the Lua script in all states, in case it's needed */
+	for(i=0; i<lua_states_count; i++) {
+		janus_lua_state *lstate = lua_states[i];
+		janus_mutex_lock(&lstate->mutex);
+		lua_getglobal(lstate->state, "destroy");
+		lua_call(lstate->state, 0, 0);
+		janus_mutex_unlock(&lstate->mutex);
+	}
+	janus_mutex_lock(&callbacks_mutex);
 	g_hash_table_destroy(callbacks);
 	callbacks = NULL;
-	janus_mutex_unlock(&lua_mutex);
+	janus_mutex_unlock(&callbacks_mutex);
 
 	janus_mutex_lock(&lua_sessions_mutex);
 	g_hash_table_destroy(lua_sessions);
 	lua_sessions = NULL;
 	g_hash_table_destroy(lua_ids);
 	lua_ids = NULL;
-	g_async_queue_unref(events);
-	events = NULL;
 	janus_mutex_unlock(&lua_sessions_mutex);
 
-	janus_mutex_lock(&lua_mutex);
-	lua_close(lua_state);
-	lua_state = NULL;
-	janus_mutex_unlock(&lua_mutex);
+	janus_lua_states_free();
+	janus_mutex_lock(&lua_shared_data_mutex);
+	g_hash_table_destroy(lua_shared_data);
+	lua_shared_data = NULL;
+	janus_mutex_unlock(&lua_shared_data_mutex);
 
 	g_free(lua_script_version_string);
 	g_free(lua_script_description);
@@ -1612,18 +1896,18 @@ int janus_lua_get_version(void) {
 	/* Check if the Lua script wants to override this method and return info itself */
 	if(has_get_version) {
 		/* Yep, pass the request to the Lua script and return the info */
-		janus_mutex_lock(&lua_mutex);
+		janus_mutex_lock(&lua_states[0]->mutex);
 		if(lua_script_version != -1) {
 			/* Unless we asked already */
-			janus_mutex_unlock(&lua_mutex);
+			janus_mutex_unlock(&lua_states[0]->mutex);
 			return lua_script_version;
 		}
-		lua_State *t = lua_newthread(lua_state);
+		lua_State *t = lua_newthread(lua_states[0]->state);
 		lua_getglobal(t, "getVersion");
 		lua_call(t, 0, 1);
 		lua_script_version = (int)lua_tonumber(t, -1);
 		lua_pop(t, 1);
-		janus_mutex_unlock(&lua_mutex);
+		janus_mutex_unlock(&lua_states[0]->mutex);
 		return lua_script_version;
 	}
 	/* No override, return the Janus Lua plugin info */
@@ -1634,20 +1918,20 @@ const char *janus_lua_get_version_string(void) {
 	/* Check if the Lua script wants to override this method and return info itself */
 	if(has_get_version_string) {
 		/* Yep, pass the request to the Lua script and return the info */
-		janus_mutex_lock(&lua_mutex);
+		janus_mutex_lock(&lua_states[0]->mutex);
 		if(lua_script_version_string != NULL) {
 			/* Unless we asked already */
-			janus_mutex_unlock(&lua_mutex);
+			janus_mutex_unlock(&lua_states[0]->mutex);
 			return lua_script_version_string;
 		}
-		lua_State *t = lua_newthread(lua_state);
+		lua_State *t = lua_newthread(lua_states[0]->state);
 		lua_getglobal(t, "getVersionString");
 		lua_call(t, 0, 1);
 		const char *version = lua_tostring(t, -1);
 		if(version != NULL)
 			lua_script_version_string = g_strdup(version);
 		lua_pop(t, 1);
-		janus_mutex_unlock(&lua_mutex);
+		janus_mutex_unlock(&lua_states[0]->mutex);
 		return lua_script_version_string;
 	}
 	/* No override, return the Janus Lua plugin info */
@@ -1658,20 +1942,20 @@ const char *janus_lua_get_description(void) {
 	/* Check if the Lua script wants to override this method and return info itself */
 	if(has_get_description) {
 		/* Yep, pass the request to the Lua script and return the info */
-		janus_mutex_lock(&lua_mutex);
+		janus_mutex_lock(&lua_states[0]->mutex);
 		if(lua_script_description != NULL) {
 			/* Unless we asked already */
-			janus_mutex_unlock(&lua_mutex);
+			janus_mutex_unlock(&lua_states[0]->mutex);
 			return lua_script_description;
 		}
-		lua_State *t = lua_newthread(lua_state);
+		lua_State *t = lua_newthread(lua_states[0]->state);
 		lua_getglobal(t, "getDescription");
 		lua_call(t, 0, 1);
 		const char *description = lua_tostring(t, -1);
 		if(description != NULL)
 			lua_script_description = g_strdup(description);
 		lua_pop(t, 1);
-		janus_mutex_unlock(&lua_mutex);
+		janus_mutex_unlock(&lua_states[0]->mutex);
 		return lua_script_description;
 	}
 	/* No override, return the Janus Lua plugin info */
@@ -1682,20 +1966,20 @@ const char *janus_lua_get_name(void) {
 	/* Check if the Lua script wants to override this method and return info itself */
 	if(has_get_name) {
 		/* Yep, pass the request to the Lua script and return the info */
-		janus_mutex_lock(&lua_mutex);
+		janus_mutex_lock(&lua_states[0]->mutex);
 		if(lua_script_name != NULL) {
 			/* Unless we asked already */
-			janus_mutex_unlock(&lua_mutex);
+			janus_mutex_unlock(&lua_states[0]->mutex);
 			return lua_script_name;
 		}
-		lua_State *t = lua_newthread(lua_state);
+		lua_State *t = lua_newthread(lua_states[0]->state);
 		lua_getglobal(t, "getName");
 		lua_call(t, 0, 1);
 		const char *name = lua_tostring(t, -1);
 		if(name != NULL)
 			lua_script_name = g_strdup(name);
 		lua_pop(t, 1);
-		janus_mutex_unlock(&lua_mutex);
+		janus_mutex_unlock(&lua_states[0]->mutex);
 		return lua_script_name;
 	}
 	/* No override, return the Janus Lua plugin info */
@@ -1706,20 +1990,20 @@ const char *janus_lua_get_author(void) {
 	/* Check if the Lua script wants to override this method and return info itself */
 	if(has_get_author) {
 		/* Yep, pass the request to the Lua script and return the info */
-		janus_mutex_lock(&lua_mutex);
+		janus_mutex_lock(&lua_states[0]->mutex);
 		if(lua_script_author != NULL) {
 			/* Unless we asked already */
-			janus_mutex_unlock(&lua_mutex);
+			janus_mutex_unlock(&lua_states[0]->mutex);
 			return lua_script_author;
 		}
-		lua_State *t = lua_newthread(lua_state);
+		lua_State *t = lua_newthread(lua_states[0]->state);
 		lua_getglobal(t, "getAuthor");
 		lua_call(t, 0, 1);
 		const char *author = lua_tostring(t, -1);
 		if(author != NULL)
 			lua_script_author = g_strdup(author);
 		lua_pop(t, 1);
-		janus_mutex_unlock(&lua_mutex);
+		janus_mutex_unlock(&lua_states[0]->mutex);
 		return lua_script_author;
 	}
 	/* No override, return the Janus Lua plugin info */
@@ -1730,20 +2014,20 @@ const char *janus_lua_get_package(void) {
 	/* Check if the Lua script wants to override this method and return info itself */
 	if(has_get_package) {
 		/* Yep, pass the request to the Lua script and return the info */
-		janus_mutex_lock(&lua_mutex);
+		janus_mutex_lock(&lua_states[0]->mutex);
 		if(lua_script_package != NULL) {
 			/* Unless we asked already */
-			janus_mutex_unlock(&lua_mutex);
+			janus_mutex_unlock(&lua_states[0]->mutex);
 			return lua_script_package;
 		}
-		lua_State *t = lua_newthread(lua_state);
+		lua_State *t = lua_newthread(lua_states[0]->state);
 		lua_getglobal(t, "getPackage");
 		lua_call(t, 0, 1);
 		const char *package = lua_tostring(t, -1);
 		if(package != NULL)
 			lua_script_package = g_strdup(package);
 		lua_pop(t, 1);
-		janus_mutex_unlock(&lua_mutex);
+		janus_mutex_unlock(&lua_states[0]->mutex);
 		return lua_script_package;
 	}
 	/* No override, return the Janus Lua plugin info */
@@ -1787,6 +2071,12 @@ void janus_lua_create_session(janus_plugin_session *handle, int *error) {
 	janus_mutex_init(&session->recipients_mutex);
 	janus_mutex_init(&session->rec_mutex);
 	session->vcodec = JANUS_VIDEOCODEC_NONE;
+	/* Pin the session to one of the Lua states: all the script callbacks
+	 * involving this session will be invoked on that state only */
+	session->lstate = lua_states[id % lua_states_count];
+	g_atomic_int_inc(&session->lstate->sessions);
+	JANUS_LOG(LOG_VERB, "Lua session %"SCNu32" pinned to state #%u (%d sessions)\n",
+		id, session->lstate->index, g_atomic_int_get(&session->lstate->sessions));
 	g_atomic_int_set(&session->hangingup, 0);
 	g_atomic_int_set(&session->destroyed, 0);
 	janus_refcount_init(&session->ref, janus_lua_session_free);
@@ -1796,13 +2086,14 @@ void janus_lua_create_session(janus_plugin_session *handle, int *error) {
 	janus_mutex_unlock(&lua_sessions_mutex);
 
 	/* Notify the Lua script */
-	janus_mutex_lock(&lua_mutex);
-	lua_State *t = lua_newthread(lua_state);
+	janus_lua_state *lstate = session->lstate;
+	janus_mutex_lock(&lstate->mutex);
+	lua_State *t = lua_newthread(lstate->state);
 	lua_getglobal(t, "createSession");
 	lua_pushnumber(t, session->id);
 	lua_call(t, 1, 0);
-	lua_pop(lua_state, 1);
-	janus_mutex_unlock(&lua_mutex);
+	lua_pop(lstate->state, 1);
+	janus_mutex_unlock(&lstate->mutex);
 
 	return;
 }
@@ -1826,13 +2117,14 @@ void janus_lua_destroy_session(janus_plugin_session *handle, int *error) {
 	janus_mutex_unlock(&lua_sessions_mutex);
 
 	/* Notify the Lua script */
-	janus_mutex_lock(&lua_mutex);
-	lua_State *t = lua_newthread(lua_state);
+	janus_lua_state *lstate = session->lstate;
+	janus_mutex_lock(&lstate->mutex);
+	lua_State *t = lua_newthread(lstate->state);
 	lua_getglobal(t, "destroySession");
 	lua_pushnumber(t, id);
 	lua_call(t, 1, 0);
-	lua_pop(lua_state, 1);
-	janus_mutex_unlock(&lua_mutex);
+	lua_pop(lstate->state, 1);
+	janus_mutex_unlock(&lstate->mutex);
 
 	/* Get any rid references recipients of this sessions may have */
 	janus_mutex_lock(&session->recipients_mutex);
@@ -1870,19 +2162,20 @@ json_t *janus_lua_query_session(janus_plugin_session *handle) {
 	janus_refcount_increase(&session->ref);
 	janus_mutex_unlock(&lua_sessions_mutex);
 	/* Ask the Lua script for information on this session */
-	janus_mutex_lock(&lua_mutex);
-	lua_State *t = lua_newthread(lua_state);
+	janus_lua_state *lstate = session->lstate;
+	janus_mutex_lock(&lstate->mutex);
+	lua_State *t = lua_newthread(lstate->state);
 	lua_getglobal(t, "querySession");
 	lua_pushnumber(t, session->id);
 	lua_call(t, 1, 1);
-	lua_pop(lua_state, 1);
+	lua_pop(lstate->state, 1);
 	janus_refcount_decrease(&session->ref);
 	const char *info = lua_tostring(t, -1);
 	lua_pop(t, 1);
 	/* We need a Jansson object */
 	json_error_t error;
 	json_t *json = json_loads(info, 0, &error);
-	janus_mutex_unlock(&lua_mutex);
+	janus_mutex_unlock(&lstate->mutex);
 	if(!json) {
 		JANUS_LOG(LOG_ERR, "JSON error: on line %d: %s", error.line, error.text);
 		return NULL;
@@ -1948,15 +2241,16 @@ struct janus_plugin_result *janus_lua_handle_message(janus_plugin_session *handl
 		json_decref(jsep);
 	}
 	/* Invoke the script function */
-	janus_mutex_lock(&lua_mutex);
-	lua_State *t = lua_newthread(lua_state);
+	janus_lua_state *lstate = session->lstate;
+	janus_mutex_lock(&lstate->mutex);
+	lua_State *t = lua_newthread(lstate->state);
 	lua_getglobal(t, "handleMessage");
 	lua_pushnumber(t, session->id);
 	lua_pushstring(t, transaction);
 	lua_pushstring(t, message_text);
 	lua_pushstring(t, jsep_text);
 	lua_call(t, 4, 2);
-	lua_pop(lua_state, 1);
+	lua_pop(lstate->state, 1);
 	janus_refcount_decrease(&session->ref);
 	if(message_text != NULL)
 		free(message_text);
@@ -1965,7 +2259,7 @@ struct janus_plugin_result *janus_lua_handle_message(janus_plugin_session *handl
 	g_free(transaction);
 	int n = lua_gettop(t);
 	if(n != 2) {
-		janus_mutex_unlock(&lua_mutex);
+		janus_mutex_unlock(&lstate->mutex);
 		JANUS_LOG(LOG_ERR, "Wrong number of arguments: %d (expected 2)\n", n);
 		return janus_plugin_result_new(JANUS_PLUGIN_ERROR, "Lua error", NULL);
 	}
@@ -1975,20 +2269,20 @@ struct janus_plugin_result *janus_lua_handle_message(janus_plugin_session *handl
 	lua_pop(t, 2);
 	if(res < 0) {
 		/* We got an error */
-		janus_mutex_unlock(&lua_mutex);
+		janus_mutex_unlock(&lstate->mutex);
 		return janus_plugin_result_new(JANUS_PLUGIN_ERROR, response ? response : "Lua error", NULL);
 	} else if(res == 0) {
 		/* Synchronous response: we need a Jansson object */
 		json_error_t error;
 		json_t *json = json_loads(response, 0, &error);
-		janus_mutex_unlock(&lua_mutex);
+		janus_mutex_unlock(&lstate->mutex);
 		if(!json) {
 			JANUS_LOG(LOG_ERR, "JSON error: on line %d: %s\n", error.line, error.text);
 			return janus_plugin_result_new(JANUS_PLUGIN_ERROR, "Lua error", NULL);
 		}
 		return janus_plugin_result_new(JANUS_PLUGIN_OK, NULL, json);
 	}
-	janus_mutex_unlock(&lua_mutex);
+	janus_mutex_unlock(&lstate->mutex);
 	/* If we got here, it's an asynchronous response */
 	return janus_plugin_result_new(JANUS_PLUGIN_OK_WAIT, NULL, NULL);
 }
@@ -2002,17 +2296,18 @@ json_t *janus_lua_handle_admin_message(json_t *message) {
 		return NULL;
 	}
 	/* Invoke the script function */
-	janus_mutex_lock(&lua_mutex);
-	lua_State *t = lua_newthread(lua_state);
+	janus_lua_state *lstate = lua_states[0];
+	janus_mutex_lock(&lstate->mutex);
+	lua_State *t = lua_newthread(lstate->state);
 	lua_getglobal(t, "handleAdminMessage");
 	lua_pushstring(t, message_text);
 	lua_call(t, 1, 1);
-	lua_pop(lua_state, 1);
+	lua_pop(lstate->state, 1);
 	if(message_text != NULL)
 		free(message_text);
 	int n = lua_gettop(t);
 	if(n != 1) {
-		janus_mutex_unlock(&lua_mutex);
+		janus_mutex_unlock(&lstate->mutex);
 		JANUS_LOG(LOG_ERR, "Wrong number of arguments: %d (expected 1)\n", n);
 		return NULL;
 	}
@@ -2020,7 +2315,7 @@ json_t *janus_lua_handle_admin_message(json_t *message) {
 	const char *response = lua_tostring(t, 1);
 	json_error_t error;
 	json_t *json = json_loads(response, 0, &error);
-	janus_mutex_unlock(&lua_mutex);
+	janus_mutex_unlock(&lstate->mutex);
 	if(!json) {
 		JANUS_LOG(LOG_ERR, "JSON error: on line %d: %s\n", error.line, error.text);
 		return NULL;
@@ -2050,13 +2345,14 @@ void janus_lua_setup_media(janus_plugin_session *handle) {
 	session->pli_latest = janus_get_monotonic_time();
 
 	/* Notify the Lua script */
-	janus_mutex_lock(&lua_mutex);
-	lua_State *t = lua_newthread(lua_state);
+	janus_lua_state *lstate = session->lstate;
+	janus_mutex_lock(&lstate->mutex);
+	lua_State *t = lua_newthread(lstate->state);
 	lua_getglobal(t, "setupMedia");
 	lua_pushnumber(t, session->id);
 	lua_call(t, 1, 0);
-	lua_pop(lua_state, 1);
-	janus_mutex_unlock(&lua_mutex);
+	lua_pop(lstate->state, 1);
+	janus_mutex_unlock(&lstate->mutex);
 	janus_refcount_decrease(&session->ref);
 }
 
@@ -2074,18 +2370,19 @@ void janus_lua_incoming_rtp(janus_plugin_session *handle, janus_plugin_rtp *rtp_
 	char *buf = rtp_packet->buffer;
 	uint16_t len = rtp_packet->length;
 	/* Check if the Lua script wants to handle/manipulate RTP packets itself */
-	if(has_incoming_rtp) {
+	if(has_incoming_rtp && !g_atomic_int_get(&session->native_relay)) {
 		/* Yep, pass the data to the Lua script and return */
-		janus_mutex_lock(&lua_mutex);
-		lua_State *t = lua_newthread(lua_state);
+		janus_lua_state *lstate = session->lstate;
+		janus_mutex_lock(&lstate->mutex);
+		lua_State *t = lua_newthread(lstate->state);
 		lua_getglobal(t, "incomingRtp");
 		lua_pushnumber(t, session->id);
 		lua_pushboolean(t, video);
 		lua_pushlstring(t, buf, len);
 		lua_pushnumber(t, len);
 		lua_call(t, 4, 0);
-		lua_pop(lua_state, 1);
-		janus_mutex_unlock(&lua_mutex);
+		lua_pop(lstate->state, 1);
+		janus_mutex_unlock(&lstate->mutex);
 		return;
 	}
 	/* Is this session allowed to send media? */
@@ -2187,28 +2484,31 @@ void janus_lua_incoming_rtcp(janus_plugin_session *handle, janus_plugin_rtcp *pa
 	char *buf = packet->buffer;
 	uint16_t len = packet->length;
 	/* Check if the Lua script wants to handle/manipulate RTCP packets itself */
-	if(has_incoming_rtcp) {
+	if(has_incoming_rtcp && !g_atomic_int_get(&session->native_relay)) {
 		/* Yep, pass the data to the Lua script and return */
-		janus_mutex_lock(&lua_mutex);
-		lua_State *t = lua_newthread(lua_state);
+		janus_lua_state *lstate = session->lstate;
+		janus_mutex_lock(&lstate->mutex);
+		lua_State *t = lua_newthread(lstate->state);
 		lua_getglobal(t, "incomingRtcp");
 		lua_pushnumber(t, session->id);
 		lua_pushboolean(t, video);
 		lua_pushlstring(t, buf, len);
 		lua_pushnumber(t, len);
 		lua_call(t, 4, 0);
-		lua_pop(lua_state, 1);
-		janus_mutex_unlock(&lua_mutex);
+		lua_pop(lstate->state, 1);
+		janus_mutex_unlock(&lstate->mutex);
 		return;
 	}
 	/* If a REMB arrived, make sure we cap it to our configuration, and send it as a video RTCP */
-	guint32 bitrate = janus_rtcp_get_remb(buf, len);
-	if(bitrate > 0) {
+	janus_rtcp_compound *compound = packet->compound;
+	if(compound == NULL)
+		return;
+	if(compound->remb_bitrate > 0) {
 		/* No limit ~= 10000000 */
 		lua_janus_core->send_remb(handle, session->bitrate ? session->bitrate : 10000000);
 	}
 	/* If there's an incoming PLI, instead, relay it to the source of the media if any */
-	if(janus_rtcp_has_pli(buf, len)) {
+	if(compound->has_pli) {
 		if(session->sender != NULL) {
 			janus_mutex_lock_nodebug(&session->sender->recipients_mutex);
 			/* Send a PLI */
@@ -2241,8 +2541,9 @@ void janus_lua_incoming_data(janus_plugin_session *handle, janus_plugin_data *pa
 		/* Yep, pass the data to the Lua script and return */
 		if(!packet->binary && !has_incoming_text_data)
 			JANUS_LOG(LOG_WARN, "Missing 'incomingTextData', invoking deprecated function 'incomingData' instead\n");
-		janus_mutex_lock(&lua_mutex);
-		lua_State *t = lua_newthread(lua_state);
+		janus_lua_state *lstate = session->lstate;
+		janus_mutex_lock(&lstate->mutex);
+		lua_State *t = lua_newthread(lstate->state);
 		lua_getglobal(t, packet->binary ? "incomingBinaryData" : (has_incoming_text_data ? "incomingTextData" : "incomingData"));
 		lua_pushnumber(t, session->id);
 		/* We use a string for both text and binary data */
@@ -2251,8 +2552,8 @@ void janus_lua_incoming_data(janus_plugin_session *handle, janus_plugin_data *pa
 		lua_pushlstring(t, label, label ? strlen(label) : 0);
 		lua_pushlstring(t, protocol, protocol ? strlen(protocol) : 0);
 		lua_call(t, 5, 0);
-		lua_pop(lua_state, 1);
-		janus_mutex_unlock(&lua_mutex);
+		lua_pop(lstate->state, 1);
+		janus_mutex_unlock(&lstate->mutex);
 		return;
 	}
 	/* Is this session allowed to send data? */
@@ -2289,13 +2590,14 @@ void janus_lua_data_ready(janus_plugin_session *handle) {
 	/* Check if the Lua script wants to receive this event */
 	if(has_data_ready) {
 		/* Yep, pass the event to the Lua script and return */
-		janus_mutex_lock(&lua_mutex);
-		lua_State *t = lua_newthread(lua_state);
+		janus_lua_state *lstate = session->lstate;
+		janus_mutex_lock(&lstate->mutex);
+		lua_State *t = lua_newthread(lstate->state);
 		lua_getglobal(t, "dataReady");
 		lua_pushnumber(t, session->id);
 		lua_call(t, 1, 0);
-		lua_pop(lua_state, 1);
-		janus_mutex_unlock(&lua_mutex);
+		lua_pop(lstate->state, 1);
+		janus_mutex_unlock(&lstate->mutex);
 		return;
 	}
 }
@@ -2317,15 +2619,16 @@ void janus_lua_slow_link(janus_plugin_session *handle, int mindex, gboolean vide
 	janus_refcount_increase(&session->ref);
 	if(has_slow_link) {
 		/* Notify the Lua script */
-		janus_mutex_lock(&lua_mutex);
-		lua_State *t = lua_newthread(lua_state);
+		janus_lua_state *lstate = session->lstate;
+		janus_mutex_lock(&lstate->mutex);
+		lua_State *t = lua_newthread(lstate->state);
 		lua_getglobal(t, "slowLink");
 		lua_pushnumber(t, session->id);
 		lua_pushboolean(t, uplink);
 		lua_pushboolean(t, video);
 		lua_call(t, 3, 0);
-		lua_pop(lua_state, 1);
-		janus_mutex_unlock(&lua_mutex);
+		lua_pop(lstate->state, 1);
+		janus_mutex_unlock(&lstate->mutex);
 	}
 	janus_refcount_decrease(&session->ref);
 }
@@ -2386,17 +2689,31 @@ void janus_lua_hangup_media(janus_plugin_session *handle) {
 	janus_mutex_unlock(&session->recipients_mutex);
 
 	/* Notify the Lua script */
-	janus_mutex_lock(&lua_mutex);
-	lua_State *t = lua_newthread(lua_state);
+	janus_lua_state *lstate = session->lstate;
+	janus_mutex_lock(&lstate->mutex);
+	lua_State *t = lua_newthread(lstate->state);
 	lua_getglobal(t, "hangupMedia");
 	lua_pushnumber(t, session->id);
 	lua_call(t, 1, 0);
-	lua_pop(lua_state, 1);
-	janus_mutex_unlock(&lua_mutex);
+	lua_pop(lstate->state, 1);
+	janus_mutex_unlock(&lstate->mutex);
 	janus_refcount_decrease(&session->ref);
 }
 
 /* Helpers to quickly relay RTP and data packets to the intended recipients */
+/* Helper to queue a simulcast change notification for the scheduler of the session's state */
+static void janus_lua_notify_simulcast(janus_lua_session *session, gboolean temporal, int value) {
+	janus_lua_state *lstate = session->lstate;
+	if(lstate == NULL)
+		return;
+	janus_lua_notification *notification = g_malloc(sizeof(janus_lua_notification));
+	notification->id = session->id;
+	notification->temporal = temporal;
+	notification->value = value;
+	g_async_queue_push(lstate->notifications, notification);
+	g_async_queue_push(lstate->events, GUINT_TO_POINTER(janus_lua_event_notify));
+}
+
 static void janus_lua_relay_rtp_packet(gpointer data, gpointer user_data) {
 	janus_lua_rtp_relay_packet *packet = (janus_lua_rtp_relay_packet *)user_data;
 	if(!packet || !packet->data || packet->length < 1) {
@@ -2435,29 +2752,13 @@ static void janus_lua_relay_rtp_packet(gpointer data, gpointer user_data) {
 		/* Any event we should notify? */
 		if(session->sim_context.changed_substream) {
 			/* Notify the script about the substream change */
-			if(has_substream_changed) {
-				janus_mutex_lock(&lua_mutex);
-				lua_State *t = lua_newthread(lua_state);
-				lua_getglobal(t, "substreamChanged");
-				lua_pushnumber(t, session->id);
-				lua_pushnumber(t, session->sim_context.substream);
-				lua_call(t, 2, 0);
-				lua_pop(lua_state, 1);
-				janus_mutex_unlock(&lua_mutex);
-			}
+			if(has_substream_changed)
+				janus_lua_notify_simulcast(session, FALSE, session->sim_context.substream);
 		}
 		if(session->sim_context.changed_temporal) {
 			/* Notify the user about the temporal layer change */
-			if(has_substream_changed) {
-				janus_mutex_lock(&lua_mutex);
-				lua_State *t = lua_newthread(lua_state);
-				lua_getglobal(t, "temporalLayerChanged");
-				lua_pushnumber(t, session->id);
-				lua_pushnumber(t, session->sim_context.templayer);
-				lua_call(t, 2, 0);
-				lua_pop(lua_state, 1);
-				janus_mutex_unlock(&lua_mutex);
-			}
+			if(has_temporal_changed)
+				janus_lua_notify_simulcast(session, TRUE, session->sim_context.templayer);
 		}
 		/* If we got here, update the RTP header and send the packet */
 		janus_rtp_header_update(packet->data, &session->vrtpctx, TRUE, 0);
@@ -2526,26 +2827,43 @@ static void janus_lua_relay_data_packet(gpointer data, gpointer user_data) {
 }
 
 /* This is a scheduler thread: if we know there are coroutines to resume
- * in Lua (e.g., for asynchronous requests), we do that ourselves here */
+ * in Lua (e.g., for asynchronous requests), we do that ourselves here;
+ * each Lua state has its own scheduler thread, so that they don't wait
+ * for each other */
 static void *janus_lua_scheduler(void *data) {
-	JANUS_LOG(LOG_VERB, "Joining Lua scheduler thread\n");
+	janus_lua_state *lstate = (janus_lua_state *)data;
+	JANUS_LOG(LOG_VERB, "Joining Lua scheduler thread (state #%u)\n", lstate->index);
 	janus_lua_event *event = NULL;
 	/* Wait until there are events to process */
 	while(g_atomic_int_get(&lua_initialized) && !g_atomic_int_get(&lua_stopping)) {
-		event = g_async_queue_pop(events);
+		event = g_async_queue_pop(lstate->events);
 		if(event == GUINT_TO_POINTER(janus_lua_event_exit))
 			break;
 		if(event == GUINT_TO_POINTER(janus_lua_event_resume)) {
 			/* There are coroutines to resume */
-			janus_mutex_lock(&lua_mutex);
-			lua_getglobal(lua_state, "resumeScheduler");
-			lua_call(lua_state, 0, 0);
+			janus_mutex_lock(&lstate->mutex);
+			lua_getglobal(lstate->state, "resumeScheduler");
+			lua_call(lstate->state, 0, 0);
 			/* Print the count of elements into Lua stack */
-			janus_lua_stackdump(lua_state);
-			janus_mutex_unlock(&lua_mutex);
+			janus_lua_stackdump(lstate->state);
+			janus_mutex_unlock(&lstate->mutex);
+		} else if(event == GUINT_TO_POINTER(janus_lua_event_notify)) {
+			/* A session we relay media to switched simulcast substream or temporal layer */
+			janus_lua_notification *notification = g_async_queue_try_pop(lstate->notifications);
+			if(notification == NULL)
+				continue;
+			janus_mutex_lock(&lstate->mutex);
+			lua_State *t = lua_newthread(lstate->state);
+			lua_getglobal(t, notification->temporal ? "temporalLayerChanged" : "substreamChanged");
+			lua_pushnumber(t, notification->id);
+			lua_pushnumber(t, notification->value);
+			lua_call(t, 2, 0);
+			lua_pop(lstate->state, 1);
+			janus_mutex_unlock(&lstate->mutex);
+			g_free(notification);
 		}
 	}
-	JANUS_LOG(LOG_VERB, "Leaving Lua scheduler thread\n");
+	JANUS_LOG(LOG_VERB, "Leaving Lua scheduler thread (state #%u)\n", lstate->index);
 	return NULL;
 }
 
@@ -2570,8 +2888,9 @@ static gboolean janus_lua_timer_cb(void *data) {
 		return FALSE;
 	/* Invoke the callback with the provided argument, if available */
 	JANUS_LOG(LOG_VERB, "Invoking scheduled callback (waited %"SCNu32"ms) with ID %u\n", cb->ms, cb->id);
-	janus_mutex_lock(&lua_mutex);
-	lua_State *t = lua_newthread(lua_state);
+	janus_lua_state *lstate = cb->lstate ? cb->lstate : lua_states[0];
+	janus_mutex_lock(&lstate->mutex);
+	lua_State *t = lua_newthread(lstate->state);
 	lua_getglobal(t, cb->function);
 	if(cb->argument == NULL) {
 		lua_call(t, 0, 0);
@@ -2579,9 +2898,11 @@ static gboolean janus_lua_timer_cb(void *data) {
 		lua_pushstring(t, cb->argument);
 		lua_call(t, 1, 0);
 	}
-	lua_pop(lua_state, 1);
+	lua_pop(lstate->state, 1);
+	janus_mutex_unlock(&lstate->mutex);
 	/* Done */
+	janus_mutex_lock(&callbacks_mutex);
 	g_hash_table_remove(callbacks, cb);
-	janus_mutex_unlock(&lua_mutex);
+	janus_mutex_unlock(&callbacks_mutex);
 	return FALSE;
 }
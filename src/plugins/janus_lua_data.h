@@ -43,9 +43,23 @@
 extern volatile gint lua_initialized, lua_stopping;
 extern janus_callbacks *lua_janus_core;
 
-/* Lua state: we define state and mutex as extern */
-extern lua_State *lua_state;
-extern janus_mutex lua_mutex;
+/* Lua states: the script is loaded in a pool of states, each with its
+ * own mutex and scheduler, and sessions are pinned to one of them, so
+ * that sessions assigned to different states don't serialize on the same
+ * interpreter. We define the pool as extern, so that extra code can use it */
+typedef struct janus_lua_state {
+	guint index;						/* Index of this state in the pool */
+	lua_State *state;					/* The Lua state itself */
+	janus_mutex mutex;					/* Mutex to lock the state */
+	GThread *scheduler;					/* Thread resuming coroutines for this state */
+	GAsyncQueue *events;				/* Events for the scheduler */
+	GAsyncQueue *notifications;			/* Simulcast changes the scheduler must notify to the script */
+	volatile gint sessions;				/* Number of sessions pinned to this state */
+} janus_lua_state;
+extern janus_lua_state **lua_states;
+extern guint lua_states_count;
+/* Helper to find the state a lua_State (or one of its threads) belongs to */
+janus_lua_state *janus_lua_state_get(lua_State *s);
 
 /* Lua session: we keep only the barebone stuff here, the rest will be in the Lua script */
 typedef struct janus_lua_session {
@@ -69,6 +83,7 @@ typedef struct janus_lua_session {
 	uint32_t bitrate;					/* Bitrate limit */
 	uint16_t pli_freq;					/* Regular PLI frequency (0=disabled) */
 	gint64 pli_latest;					/* Time of latest sent PLI (to avoid flooding) */
+	volatile gint native_relay;			/* Whether RTP/RTCP from this session is routed in C even if the script handles media */
 	GSList *recipients;					/* Sessions that should receive media from this session */
 	struct janus_lua_session *sender;	/* Other session this session is receiving media from */
 	janus_mutex recipients_mutex;		/* Mutex to lock the recipients list */
@@ -83,6 +98,7 @@ typedef struct janus_lua_session {
 	volatile gint dataready;			/* Whether the data channel was established on this sessions's PeerConnection */
 	volatile gint hangingup;			/* Whether this session's PeerConnection is hanging up */
 	volatile gint destroyed;			/* Whether this session's been marked as destroyed */
+	janus_lua_state *lstate;			/* Lua state this session is pinned to */
 	/* If you need any additional property (e.g., for hooks you added in janus_lua_extra.c) add them below this line */
 
 	/* Reference counter */
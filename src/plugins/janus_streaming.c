@@ -5876,22 +5876,22 @@ void janus_streaming_incoming_rtcp(janus_plugin_session *handle, janus_plugin_rt
 	if(stream == NULL)
 		return;
 	gboolean video = packet->video;
-	char *buf = packet->buffer;
-	uint16_t len = packet->length;
+	/* The core parsed the compound packet for us already */
+	janus_rtcp_compound *compound = packet->compound;
+	if(compound == NULL)
+		return;
 	if(!video && (stream->rtcp_fd > -1) && (stream->rtcp_addr.ss_family != 0)) {
-		JANUS_LOG(LOG_HUGE, "Got audio RTCP feedback from a viewer: SSRC %"SCNu32"\n",
-			janus_rtcp_get_sender_ssrc(buf, len));
+		JANUS_LOG(LOG_HUGE, "Got audio RTCP feedback from a viewer: SSRC %"SCNu32"\n", compound->sender_ssrc);
 		/* FIXME We don't forward RR packets, so what should we check here? */
 	} else if(video && (stream->rtcp_fd > -1) && (stream->rtcp_addr.ss_family != 0)) {
-		JANUS_LOG(LOG_HUGE, "Got video RTCP feedback from a viewer: SSRC %"SCNu32"\n",
-			janus_rtcp_get_sender_ssrc(buf, len));
+		JANUS_LOG(LOG_HUGE, "Got video RTCP feedback from a viewer: SSRC %"SCNu32"\n", compound->sender_ssrc);
 		/* We only relay PLI/FIR and REMB packets, but in a selective way */
-		if(janus_rtcp_has_fir(buf, len) || janus_rtcp_has_pli(buf, len)) {
+		if((compound->has_fir || compound->has_pli)) {
 			/* We got a PLI/FIR, pass it along unless we just sent one */
 			JANUS_LOG(LOG_HUGE, "  -- Keyframe request\n");
 			janus_streaming_rtcp_pli_send(stream);
 		}
-		uint64_t bw = janus_rtcp_get_remb(buf, len);
+		uint64_t bw = compound->remb_bitrate;
 		if(bw > 0) {
 			/* Keep track of this value, if this is the lowest right now */
 			JANUS_LOG(LOG_HUGE, "  -- REMB for this PeerConnection: %"SCNu64"\n", bw);
@@ -67,6 +67,7 @@ secret = <optional password needed for manipulating (e.g. destroying) the room>
 pin = <optional password needed for joining the room>
 history = <number of messages to store as a history, and send back to new participants (default=0, no history)>
 post = <optional backend to contact via HTTP post for all incoming messages>
+coalesce = <time window, in milliseconds, to coalesce public messages in before sending them (default=0, each message is sent immediately)>
 \endverbatim
  *
  * As explained in the next sections, you can also create rooms programmatically.
@@ -159,7 +160,14 @@ post = <optional backend to contact via HTTP post for all incoming messages>
 			"description" : "<Name of the room>",
 			"pin_required" : <true|false, depending on whether the room is PIN-protected>,
 			"num_participants" : <count of the participants>,
-			"history" : <size of history, if any>
+			"history" : <size of history, if any>,
+			"coalesce" : <coalescing window, in milliseconds, if any>,
+			"fanout_latency" : {	// Time messages waited before being handed to the recipients' datachannels
+				"p50" : <median, in microseconds>,
+				"p95" : <95th percentile, in microseconds>,
+				"p99" : <99th percentile, in microseconds>,
+				"samples" : <number of recent deliveries the percentiles were computed on>
+			}
 		},
 		// Other rooms
 	]
@@ -209,6 +217,7 @@ post = <optional backend to contact via HTTP post for all incoming messages>
 	"is_private" : <true|false, whether the room should be listable; optional, true by default>,
 	"history" : <number of messages to store as a history, and send back to new participants (default=0, no history)>,
 	"post" : "<backend to contact via HTTP post for all incoming messages; optional>",
+	"coalesce" : <time window, in milliseconds, to coalesce public messages in (see below); optional, 0 by default>,
 	"permanent" : <true|false, whether the mountpoint should be saved to configuration file or not; false by default>
 }
 \endverbatim
@@ -519,6 +528,28 @@ post = <optional backend to contact via HTTP post for all incoming messages>
  * In case the \c whisper attribute is \c true it means the user actually
  * received a  private message from another participant in the room.
  *
+ * Public messages are serialized only once, and the same copy is handed
+ * to the datachannels of all participants. In very busy rooms, you can
+ * also reduce the number of datachannel messages by configuring a
+ * \c coalesce window (in milliseconds) for the room: when you do,
+ * public messages sent within the same window are delivered together
+ * in a single \c messages event, which wraps the individual \c message
+ * events in an array. Whispers and announcements are never coalesced:
+ *
+\verbatim
+{
+	"textroom" : "messages",
+	"room" : <room ID the messages were sent to>,
+	"messages" : [
+		// Array of message events, formatted as above
+	]
+}
+\endverbatim
+ *
+ * Each \c messages event is kept below 16KB, to make sure all peers can
+ * receive it: if more messages are sent within the same window, they're
+ * delivered in more \c messages events, in the same order.
+ *
  * Another way of injecting text into rooms is by means of announcements.
  * Announcements are basically messages sent by the room itself, rather
  * than individual users: as such, only users or applications managing
@@ -672,6 +703,7 @@ static struct janus_json_parameter create_parameters[] = {
 	{"post", JSON_STRING, 0},
 	{"is_private", JANUS_JSON_BOOL, 0},
 	{"history", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
+	{"coalesce", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
 	{"allowed", JSON_ARRAY, 0},
 	{"permanent", JANUS_JSON_BOOL, 0}
 };
@@ -726,6 +758,8 @@ static gboolean string_ids = FALSE;
 static janus_callbacks *gateway = NULL;
 static GThread *handler_thread;
 static void *janus_textroom_handler(void *data);
+static GThread *coalescer_thread;
+static void *janus_textroom_coalescer(void *data);
 static void janus_textroom_hangup_media_internal(janus_plugin_session *handle);
 
 /* JSON serialization options */
@@ -743,6 +777,11 @@ typedef struct janus_textroom_room {
 	GHashTable *participants;	/* Map of participants */
 	uint16_t history_size;		/* Number of messages we should store in the history */
 	GQueue *history;			/* History of past messages */
+	guint coalesce;				/* Window (in ms) to coalesce public messages in, if any */
+	json_t *pending;			/* Public messages waiting for the coalescing window to end */
+	size_t pending_bytes;		/* Size of the pending messages, once serialized */
+	gint64 pending_deadline;	/* When the pending messages should be sent */
+	janus_plugin_data_stats *fanout;	/* Fan-out latency of the messages we sent */
 	gboolean check_tokens;		/* Whether to check tokens when participants join (see below) */
 	GHashTable *allowed;		/* Map of participants (as tokens) allowed to join */
 	volatile gint destroyed;	/* Whether this room has been destroyed */
@@ -794,6 +833,9 @@ static void janus_textroom_room_free(const janus_refcount *textroom_ref) {
 	g_hash_table_destroy(textroom->allowed);
 	if(textroom->history)
 		g_queue_free_full(textroom->history, (GDestroyNotify)g_free);
+	if(textroom->pending)
+		json_decref(textroom->pending);
+	janus_plugin_data_stats_destroy(textroom->fanout);
 	janus_mutex_destroy(&textroom->mutex);
 	g_free(textroom);
 }
@@ -840,6 +882,13 @@ typedef struct janus_textroom_message {
 static GAsyncQueue *messages = NULL;
 static janus_textroom_message exit_message;
 
+/* Rooms with public messages waiting to be coalesced */
+static GAsyncQueue *coalesce_queue = NULL;
+/* Maximum size of an event with coalesced messages: datachannel messages
+ * larger than 16KB may not be supported by all peers (RFC 8831) */
+#define JANUS_TEXTROOM_COALESCE_MAX_SIZE	16384
+static janus_textroom_room coalesce_exit;
+
 static void janus_textroom_message_free(janus_textroom_message *msg) {
 	if(!msg || msg == &exit_message)
 		return;
@@ -862,6 +911,104 @@ static void janus_textroom_message_free(janus_textroom_message *msg) {
 	g_free(msg);
 }
 
+/* Helper to send an array of coalesced public messages as a single event (the
+ * room mutex must be locked): if the event would be larger than what we can
+ * send on a datachannel, the messages are split in more events */
+static void janus_textroom_coalesce_send(janus_textroom_room *textroom, json_t *pending) {
+	if(textroom->participants == NULL || json_array_size(pending) == 0) {
+		json_decref(pending);
+		return;
+	}
+	json_t *event = json_object();
+	json_object_set_new(event, "textroom", json_string("messages"));
+	json_object_set_new(event, "room", string_ids ? json_string(textroom->room_id_str) : json_integer(textroom->room_id));
+	json_object_set(event, "messages", pending);
+	char *event_text = json_dumps(event, json_format);
+	json_decref(event);
+	if(event_text == NULL) {
+		json_decref(pending);
+		JANUS_LOG(LOG_ERR, "Failed to stringify coalesced messages...\n");
+		return;
+	}
+	size_t len = strlen(event_text);
+	if(len > JANUS_TEXTROOM_COALESCE_MAX_SIZE && json_array_size(pending) > 1) {
+		/* Too large, send the first half and the second half separately */
+		free(event_text);
+		size_t i = 0, half = json_array_size(pending)/2;
+		json_t *first = json_array(), *second = json_array();
+		for(i=0; i<json_array_size(pending); i++)
+			json_array_append(i < half ? first : second, json_array_get(pending, i));
+		json_decref(pending);
+		janus_textroom_coalesce_send(textroom, first);
+		janus_textroom_coalesce_send(textroom, second);
+		return;
+	}
+	json_decref(pending);
+	if(len > G_MAXUINT16) {
+		/* A single message that's this large can't be sent anyway */
+		free(event_text);
+		JANUS_LOG(LOG_ERR, "Coalesced message too large (%zu bytes), dropping it...\n", len);
+		return;
+	}
+	/* Serialize once, and send the same copy to everybody in the room */
+	janus_plugin_data_shared *shared = janus_plugin_data_shared_create(event_text, len, textroom->fanout);
+	GHashTableIter iter;
+	gpointer value;
+	g_hash_table_iter_init(&iter, textroom->participants);
+	while(g_hash_table_iter_next(&iter, NULL, &value)) {
+		janus_textroom_participant *top = value;
+		JANUS_LOG(LOG_HUGE, "  >> To %s in %s (coalesced)\n", top->username, textroom->room_id_str);
+		janus_refcount_increase(&top->ref);
+		janus_plugin_data data = { .label = NULL, .protocol = NULL, .binary = FALSE,
+			.buffer = event_text, .length = len, .shared = shared };
+		gateway->relay_data(top->session->handle, &data);
+		janus_refcount_decrease(&top->ref);
+	}
+	janus_plugin_data_shared_unref(shared);
+	free(event_text);
+}
+
+/* Helper to add a public message to those waiting for the end of the
+ * coalescing window of a room (the room mutex must be locked) */
+static void janus_textroom_coalesce(janus_textroom_room *textroom, json_t *msg, size_t len) {
+	if(textroom->pending != NULL && json_array_size(textroom->pending) > 0 &&
+			textroom->pending_bytes + len > JANUS_TEXTROOM_COALESCE_MAX_SIZE) {
+		/* This message would make the event too large: send what we have
+		 * now, and keep on coalescing the next ones in the same window */
+		json_t *pending = textroom->pending;
+		textroom->pending = json_array();
+		textroom->pending_bytes = 0;
+		janus_textroom_coalesce_send(textroom, pending);
+	}
+	gboolean first = (textroom->pending == NULL);
+	if(first)
+		textroom->pending = json_array();
+	json_array_append_new(textroom->pending, msg);
+	textroom->pending_bytes += len;
+	if(first) {
+		/* First message in this window, let the coalescer thread know */
+		textroom->pending_deadline = janus_get_monotonic_time() + (gint64)textroom->coalesce*1000;
+		janus_refcount_increase(&textroom->ref);
+		g_async_queue_push(coalesce_queue, textroom);
+	}
+}
+
+/* Helper to send all the public messages that were coalesced in a room when the window ends */
+static void janus_textroom_coalesce_flush(janus_textroom_room *textroom) {
+	janus_mutex_lock(&textroom->mutex);
+	json_t *pending = textroom->pending;
+	textroom->pending = NULL;
+	textroom->pending_bytes = 0;
+	if(pending == NULL || g_atomic_int_get(&textroom->destroyed)) {
+		janus_mutex_unlock(&textroom->mutex);
+		if(pending != NULL)
+			json_decref(pending);
+		return;
+	}
+	janus_textroom_coalesce_send(textroom, pending);
+	janus_mutex_unlock(&textroom->mutex);
+}
+
 
 /* SDP template: we only offer data channels */
 #define sdp_template \
@@ -941,6 +1088,7 @@ int janus_textroom_init(janus_callbacks *callback, const char *config_path) {
 		janus_config_print(config);
 	sessions = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify)janus_textroom_session_destroy);
 	messages = g_async_queue_new_full((GDestroyNotify) janus_textroom_message_free);
+	coalesce_queue = g_async_queue_new();
 	/* This is the callback we'll need to invoke to contact the Janus core */
 	gateway = callback;
 
@@ -999,6 +1147,7 @@ int janus_textroom_init(janus_callbacks *callback, const char *config_path) {
 			janus_config_item *pin = janus_config_get(config, cat, janus_config_type_item, "pin");
 			janus_config_item *history = janus_config_get(config, cat, janus_config_type_item, "history");
 			janus_config_item *post = janus_config_get(config, cat, janus_config_type_item, "post");
+			janus_config_item *coalesce = janus_config_get(config, cat, janus_config_type_item, "coalesce");
 			/* Create the text room */
 			janus_textroom_room *textroom = g_malloc0(sizeof(janus_textroom_room));
 			const char *room_num = cat->name;
@@ -1063,6 +1212,14 @@ int janus_textroom_init(janus_callbacks *callback, const char *config_path) {
 				JANUS_LOG(LOG_WARN, "HTTP backend specified, but libcurl support was not built in...\n");
 #endif
 			}
+			if(coalesce != NULL && coalesce->value != NULL) {
+				uint16_t window = 0;
+				if(janus_string_to_uint16(coalesce->value, &window) < 0)
+					JANUS_LOG(LOG_WARN, "Invalid coalesce value (%s), disabling coalescing...\n", coalesce->value);
+				else
+					textroom->coalesce = window;
+			}
+			textroom->fanout = janus_plugin_data_stats_create();
 			textroom->participants = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify)janus_textroom_participant_dereference);
 			textroom->check_tokens = FALSE;	/* Static rooms can't have an "allowed" list yet, no hooks to the configuration file */
 			textroom->allowed = g_hash_table_new_full(g_str_hash, g_str_equal, (GDestroyNotify)g_free, NULL);
@@ -1110,6 +1267,15 @@ int janus_textroom_init(janus_callbacks *callback, const char *config_path) {
 		g_error_free(error);
 		return -1;
 	}
+	/* Launch the thread that will send coalesced public messages */
+	coalescer_thread = g_thread_try_new("textroom coalescer", janus_textroom_coalescer, NULL, &error);
+	if(error != NULL) {
+		g_atomic_int_set(&initialized, 0);
+		JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch the TextRoom coalescer thread...\n",
+			error->code, error->message ? error->message : "??");
+		g_error_free(error);
+		return -1;
+	}
 	JANUS_LOG(LOG_INFO, "%s initialized!\n", JANUS_TEXTROOM_NAME);
 	return 0;
 }
@@ -1124,6 +1290,11 @@ void janus_textroom_destroy(void) {
 		g_thread_join(handler_thread);
 		handler_thread = NULL;
 	}
+	g_async_queue_push(coalesce_queue, &coalesce_exit);
+	if(coalescer_thread != NULL) {
+		g_thread_join(coalescer_thread);
+		coalescer_thread = NULL;
+	}
 
 	/* FIXME We should destroy the sessions cleanly */
 	janus_mutex_lock(&sessions_mutex);
@@ -1136,6 +1307,8 @@ void janus_textroom_destroy(void) {
 	janus_mutex_unlock(&rooms_mutex);
 	g_async_queue_unref(messages);
 	messages = NULL;
+	g_async_queue_unref(coalesce_queue);
+	coalesce_queue = NULL;
 
 #ifdef HAVE_LIBCURL
 	curl_global_cleanup();
@@ -1611,6 +1784,10 @@ janus_plugin_result *janus_textroom_handle_incoming_request(janus_plugin_session
 			g_snprintf(error_cause, 512, "Failed to stringify message");
 			goto msg_response;
 		}
+		/* Public messages may have to be coalesced with others */
+		json_t *pending = NULL;
+		if(!username && !usernames && textroom->coalesce > 0)
+			pending = json_copy(msg);
 		char *history_text = NULL;
 		if(textroom->history) {
 			json_object_set_new(msg, "display", json_string(participant->display));
@@ -1641,6 +1818,7 @@ janus_plugin_result *janus_textroom_handle_incoming_request(janus_plugin_session
 		} else if(usernames) {
 			/* A limited number of users */
 			json_t *sent = json_object();
+			janus_plugin_data_shared *shared = janus_plugin_data_shared_create(msg_text, strlen(msg_text), textroom->fanout);
 			size_t i = 0;
 			for(i=0; i<json_array_size(usernames); i++) {
 				json_t *u = json_array_get(usernames, i);
@@ -1649,7 +1827,8 @@ janus_plugin_result *janus_textroom_handle_incoming_request(janus_plugin_session
 				janus_textroom_participant *top = g_hash_table_lookup(textroom->participants, to);
 				if(top) {
 					janus_refcount_increase(&top->ref);
-					janus_plugin_data data = { .label = NULL, .protocol = NULL, .binary = FALSE, .buffer = msg_text, .length = strlen(msg_text) };
+					janus_plugin_data data = { .label = NULL, .protocol = NULL, .binary = FALSE,
+						.buffer = msg_text, .length = strlen(msg_text), .shared = shared };
 					gateway->relay_data(top->session->handle, &data);
 					janus_refcount_decrease(&top->ref);
 					json_object_set_new(sent, to, json_true());
@@ -1658,11 +1837,17 @@ janus_plugin_result *janus_textroom_handle_incoming_request(janus_plugin_session
 					json_object_set_new(sent, to, json_false());
 				}
 			}
+			janus_plugin_data_shared_unref(shared);
 			json_object_set_new(reply, "sent", sent);
 		} else {
 			/* Everybody in the room */
 			JANUS_LOG(LOG_VERB, "To everybody in %s: %s\n", room_id_str, message);
-			if(textroom->participants) {
+			if(pending != NULL) {
+				/* Add to the messages to send when the coalescing window ends */
+				janus_textroom_coalesce(textroom, pending, strlen(msg_text));
+				pending = NULL;
+			} else if(textroom->participants) {
+				janus_plugin_data_shared *shared = janus_plugin_data_shared_create(msg_text, strlen(msg_text), textroom->fanout);
 				GHashTableIter iter;
 				gpointer value;
 				g_hash_table_iter_init(&iter, textroom->participants);
@@ -1670,10 +1855,12 @@ janus_plugin_result *janus_textroom_handle_incoming_request(janus_plugin_session
 					janus_textroom_participant *top = value;
 					JANUS_LOG(LOG_VERB, "  >> To %s in %s: %s\n", top->username, room_id_str, message);
 					janus_refcount_increase(&top->ref);
-					janus_plugin_data data = { .label = NULL, .protocol = NULL, .binary = FALSE, .buffer = msg_text, .length = strlen(msg_text) };
+					janus_plugin_data data = { .label = NULL, .protocol = NULL, .binary = FALSE,
+						.buffer = msg_text, .length = strlen(msg_text), .shared = shared };
 					gateway->relay_data(top->session->handle, &data);
 					janus_refcount_decrease(&top->ref);
 				}
+				janus_plugin_data_shared_unref(shared);
 			}
 			if(textroom->history && history_text) {
 				/* Store in the history */
@@ -1867,7 +2054,9 @@ janus_plugin_result *janus_textroom_handle_incoming_request(janus_plugin_session
 				g_snprintf(error_cause, 512, "Failed to stringify message");
 				goto msg_response;
 			}
-			janus_plugin_data data = { .label = NULL, .protocol = NULL, .binary = FALSE, .buffer = event_text, .length = strlen(event_text) };
+			janus_plugin_data_shared *shared = janus_plugin_data_shared_create(event_text, strlen(event_text), textroom->fanout);
+			janus_plugin_data data = { .label = NULL, .protocol = NULL, .binary = FALSE,
+				.buffer = event_text, .length = strlen(event_text), .shared = shared };
 			gateway->relay_data(handle, &data);
 			/* Broadcast */
 			GHashTableIter iter;
@@ -1888,6 +2077,7 @@ janus_plugin_result *janus_textroom_handle_incoming_request(janus_plugin_session
 				json_array_append_new(list, p);
 				janus_refcount_decrease(&top->ref);
 			}
+			janus_plugin_data_shared_unref(shared);
 			free(event_text);
 		}
 		janus_mutex_unlock(&session->mutex);
@@ -1982,7 +2172,9 @@ janus_plugin_result *janus_textroom_handle_incoming_request(janus_plugin_session
 				g_snprintf(error_cause, 512, "Failed to stringify message");
 				goto msg_response;
 			}
-			janus_plugin_data data = { .label = NULL, .protocol = NULL, .binary = FALSE, .buffer = event_text, .length = strlen(event_text) };
+			janus_plugin_data_shared *shared = janus_plugin_data_shared_create(event_text, strlen(event_text), textroom->fanout);
+			janus_plugin_data data = { .label = NULL, .protocol = NULL, .binary = FALSE,
+				.buffer = event_text, .length = strlen(event_text), .shared = shared };
 			gateway->relay_data(handle, &data);
 			/* Broadcast */
 			GHashTableIter iter;
@@ -1997,6 +2189,7 @@ janus_plugin_result *janus_textroom_handle_incoming_request(janus_plugin_session
 				gateway->relay_data(top->session->handle, &data);
 				janus_refcount_decrease(&top->ref);
 			}
+			janus_plugin_data_shared_unref(shared);
 			free(event_text);
 		}
 		/* Also notify event handlers */
@@ -2058,6 +2251,18 @@ janus_plugin_result *janus_textroom_handle_incoming_request(janus_plugin_session
 			json_object_set_new(rl, "pin_required", room->room_pin ? json_true() : json_false());
 			json_object_set_new(rl, "num_participants", json_integer(g_hash_table_size(room->participants)));
 			json_object_set_new(rl, "history", json_integer(room->history_size));
+			if(room->coalesce)
+				json_object_set_new(rl, "coalesce", json_integer(room->coalesce));
+			guint32 p50 = 0, p95 = 0, p99 = 0;
+			guint samples = janus_plugin_data_stats_percentiles(room->fanout, &p50, &p95, &p99);
+			if(samples > 0) {
+				json_t *fl = json_object();
+				json_object_set_new(fl, "p50", json_integer(p50));
+				json_object_set_new(fl, "p95", json_integer(p95));
+				json_object_set_new(fl, "p99", json_integer(p99));
+				json_object_set_new(fl, "samples", json_integer(samples));
+				json_object_set_new(rl, "fanout_latency", fl);
+			}
 			json_array_append_new(list, rl);
 			janus_mutex_unlock(&room->mutex);
 			janus_refcount_decrease(&room->ref);
@@ -2322,15 +2527,18 @@ janus_plugin_result *janus_textroom_handle_incoming_request(janus_plugin_session
 				goto msg_response;
 			}
 			/* Broadcast */
+			janus_plugin_data_shared *shared = janus_plugin_data_shared_create(event_text, strlen(event_text), textroom->fanout);
 			GHashTableIter iter;
 			gpointer value;
 			g_hash_table_iter_init(&iter, textroom->participants);
 			while(g_hash_table_iter_next(&iter, NULL, &value)) {
 				janus_textroom_participant *top = value;
 				JANUS_LOG(LOG_VERB, "  >> To %s in %s\n", top->username, room_id_str);
-				janus_plugin_data data = { .label = NULL, .protocol = NULL, .binary = FALSE, .buffer = event_text, .length = strlen(event_text) };
+				janus_plugin_data data = { .label = NULL, .protocol = NULL, .binary = FALSE,
+					.buffer = event_text, .length = strlen(event_text), .shared = shared };
 				gateway->relay_data(top->session->handle, &data);
 			}
+			janus_plugin_data_shared_unref(shared);
 			free(event_text);
 		}
 		/* Also notify event handlers */
@@ -2431,6 +2639,7 @@ janus_plugin_result *janus_textroom_handle_incoming_request(janus_plugin_session
 		}
 		/* Send the announcement to everybody in the room */
 		if(textroom->participants) {
+			janus_plugin_data_shared *shared = janus_plugin_data_shared_create(msg_text, strlen(msg_text), textroom->fanout);
 			GHashTableIter iter;
 			gpointer value;
 			g_hash_table_iter_init(&iter, textroom->participants);
@@ -2438,10 +2647,12 @@ janus_plugin_result *janus_textroom_handle_incoming_request(janus_plugin_session
 				janus_textroom_participant *top = value;
 				JANUS_LOG(LOG_VERB, "  >> To %s in %s: %s\n", top->username, room_id_str, message);
 				janus_refcount_increase(&top->ref);
-				janus_plugin_data data = { .label = NULL, .protocol = NULL, .binary = FALSE, .buffer = msg_text, .length = strlen(msg_text) };
+				janus_plugin_data data = { .label = NULL, .protocol = NULL, .binary = FALSE,
+					.buffer = msg_text, .length = strlen(msg_text), .shared = shared };
 				gateway->relay_data(top->session->handle, &data);
 				janus_refcount_decrease(&top->ref);
 			}
+			janus_plugin_data_shared_unref(shared);
 		}
 		if(textroom->history) {
 			/* Store in the history */
@@ -2525,6 +2736,7 @@ janus_plugin_result *janus_textroom_handle_incoming_request(janus_plugin_session
 		json_t *pin = json_object_get(root, "pin");
 		json_t *history = json_object_get(root, "history");
 		json_t *post = json_object_get(root, "post");
+		json_t *coalesce = json_object_get(root, "coalesce");
 		json_t *permanent = json_object_get(root, "permanent");
 		if(allowed) {
 			/* Make sure the "allowed" array only contains strings */
@@ -2630,6 +2842,9 @@ janus_plugin_result *janus_textroom_handle_incoming_request(janus_plugin_session
 			JANUS_LOG(LOG_WARN, "HTTP backend specified, but libcurl support was not built in...\n");
 #endif
 		}
+		if(coalesce)
+			textroom->coalesce = json_integer_value(coalesce);
+		textroom->fanout = janus_plugin_data_stats_create();
 		textroom->participants = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify)janus_textroom_participant_dereference);
 		textroom->allowed = g_hash_table_new_full(g_str_hash, g_str_equal, (GDestroyNotify)g_free, NULL);
 		if(allowed != NULL) {
@@ -2678,6 +2893,10 @@ janus_plugin_result *janus_textroom_handle_incoming_request(janus_plugin_session
 			}
 			if(textroom->http_backend)
 				janus_config_add(config, c, janus_config_item_create("post", textroom->http_backend));
+			if(textroom->coalesce) {
+				g_snprintf(value, BUFSIZ, "%u", textroom->coalesce);
+				janus_config_add(config, c, janus_config_item_create("coalesce", value));
+			}
 			/* Save modified configuration */
 			if(janus_config_save(config, config_folder, JANUS_TEXTROOM_PACKAGE) < 0)
 				save = FALSE;	/* This will notify the user the room is not permanent */
@@ -2853,6 +3072,10 @@ janus_plugin_result *janus_textroom_handle_incoming_request(janus_plugin_session
 			}
 			if(textroom->http_backend)
 				janus_config_add(config, c, janus_config_item_create("post", textroom->http_backend));
+			if(textroom->coalesce) {
+				g_snprintf(value, BUFSIZ, "%u", textroom->coalesce);
+				janus_config_add(config, c, janus_config_item_create("coalesce", value));
+			}
 			/* Save modified configuration */
 			if(janus_config_save(config, config_folder, JANUS_TEXTROOM_PACKAGE) < 0)
 				save = FALSE;	/* This will notify the user the room changes are not permanent */
@@ -2965,7 +3188,9 @@ janus_plugin_result *janus_textroom_handle_incoming_request(janus_plugin_session
 				g_snprintf(error_cause, 512, "Failed to stringify message");
 				goto msg_response;
 			}
-			janus_plugin_data data = { .label = NULL, .protocol = NULL, .binary = FALSE, .buffer = event_text, .length = strlen(event_text) };
+			janus_plugin_data_shared *shared = janus_plugin_data_shared_create(event_text, strlen(event_text), textroom->fanout);
+			janus_plugin_data data = { .label = NULL, .protocol = NULL, .binary = FALSE,
+				.buffer = event_text, .length = strlen(event_text), .shared = shared };
 			gateway->relay_data(handle, &data);
 			/* Broadcast */
 			GHashTableIter iter;
@@ -2982,6 +3207,7 @@ janus_plugin_result *janus_textroom_handle_incoming_request(janus_plugin_session
 				janus_refcount_decrease(&top->ref);
 				janus_textroom_participant_destroy(top);
 			}
+			janus_plugin_data_shared_unref(shared);
 			free(event_text);
 		}
 		janus_mutex_unlock(&textroom->mutex);
@@ -3243,3 +3469,49 @@ error:
 	JANUS_LOG(LOG_VERB, "Leaving TextRoom handler thread\n");
 	return NULL;
 }
+
+/* Thread to send the public messages coalesced in rooms, when their window ends */
+static void *janus_textroom_coalescer(void *data) {
+	JANUS_LOG(LOG_VERB, "Joining TextRoom coalescer thread\n");
+	GList *waiting = NULL, *l = NULL;
+	janus_textroom_room *textroom = NULL;
+	while(TRUE) {
+		/* Wait until the first window ends, or until a room starts a new one */
+		gint64 now = janus_get_monotonic_time(), wait = G_USEC_PER_SEC;
+		for(l = waiting; l != NULL; l = l->next) {
+			textroom = (janus_textroom_room *)l->data;
+			if(textroom->pending_deadline - now < wait)
+				wait = textroom->pending_deadline - now;
+		}
+		textroom = wait > 0 ? g_async_queue_timeout_pop(coalesce_queue, wait) : g_async_queue_try_pop(coalesce_queue);
+		if(textroom == &coalesce_exit)
+			break;
+		if(textroom != NULL)
+			waiting = g_list_append(waiting, textroom);
+		/* Send the messages of all the rooms whose window ended */
+		now = janus_get_monotonic_time();
+		l = waiting;
+		while(l != NULL) {
+			GList *next = l->next;
+			textroom = (janus_textroom_room *)l->data;
+			if(textroom->pending_deadline <= now) {
+				janus_textroom_coalesce_flush(textroom);
+				janus_refcount_decrease(&textroom->ref);
+				waiting = g_list_delete_link(waiting, l);
+			}
+			l = next;
+		}
+	}
+	/* We're done, get rid of the references we still have */
+	for(l = waiting; l != NULL; l = l->next) {
+		textroom = (janus_textroom_room *)l->data;
+		janus_refcount_decrease(&textroom->ref);
+	}
+	g_list_free(waiting);
+	while((textroom = g_async_queue_try_pop(coalesce_queue)) != NULL) {
+		if(textroom != &coalesce_exit)
+			janus_refcount_decrease(&textroom->ref);
+	}
+	JANUS_LOG(LOG_VERB, "Leaving TextRoom coalescer thread\n");
+	return NULL;
+}
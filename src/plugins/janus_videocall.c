@@ -858,7 +858,7 @@ void janus_videocall_incoming_rtcp(janus_plugin_session *handle, janus_plugin_rt
 		}
 		if(g_atomic_int_get(&session->destroyed) || g_atomic_int_get(&peer->destroyed))
 			return;
-		guint32 bitrate = janus_rtcp_get_remb(packet->buffer, packet->length);
+		guint32 bitrate = packet->compound ? packet->compound->remb_bitrate : 0;
 		if(bitrate > 0) {
 			/* If a REMB arrived, make sure we cap it to our configuration, and send it as a video RTCP */
 			session->peer_bitrate = bitrate;
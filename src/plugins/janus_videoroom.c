@@ -122,6 +122,19 @@ room-<unique room ID>: {
 	threads = number of threads to assist with the relaying of publishers in the room; as
 				in the Streaming plugin, this setting can help if you expect a lot of subscribers
 				that may cause the plugin to slow down and fail to catch up (default=0)
+	shared_retransmissions = true|false (whether subscribers that negotiated RFC4588
+				retransmissions should reference a single copy of each publisher video
+				packet for NACKs, rather than storing one each; VP8 simulcast publishers
+				are excluded, as their payload is rewritten per subscriber; default=false)
+	auto_layers = true|false (whether the simulcast substream or SVC layers relayed to
+				subscribers should be automatically capped, according to the bandwidth the
+				core estimates each subscriber can receive; requires transport-wide CC to
+				be negotiated, and only affects simulcast and VP9 SVC publishers; default=false)
+	silence_suppression = true|false (whether audio from publishers that have been quiet for a while,
+				according to the audio level extension, should mostly not be relayed to subscribers,
+				as Opus DTX would do; only affects publishers that didn't negotiate DTX themselves,
+				requires audiolevel_ext, default=false)
+	silence_threshold = 60 (audio level above which a packet is considered silence, default=60)
 }
 \endverbatim
  *
@@ -416,6 +429,14 @@ room-<unique room ID>: {
 			"require_e2ee": <true|false, whether end-to-end encrypted publishers are required>,
 			"dummy_publisher": <true|false, whether a dummy publisher exists for placeholder subscriptions>,
 			"notify_joining": <true|false, whether an event is sent to notify all participants if a new participant joins the room>,
+			"shared_retransmissions": <true|false, whether RFC4588 retransmissions for subscribers share the publishers' copy of packets>,
+			"shared_retransmissions_stats": {	// Only present when shared_retransmissions is true
+				"packets": <number of shared packets currently kept around for retransmissions>,
+				"bytes": <bytes currently allocated for shared packets>,
+				"saved_bytes": <bytes saved by sharing packets, compared to a copy per subscriber>
+			},
+			"auto_layers": <true|false, whether layers relayed to subscribers are capped according to the estimated bandwidth>,
+			"silence_suppression": <true|false, whether audio from quiet publishers is mostly not relayed to subscribers>,
 			"audiocodec" : "<comma separated list of allowed audio codecs>",
 			"videocodec" : "<comma separated list of allowed video codecs>",
 			"opus_fec": <true|false, whether inband FEC must be negotiated (note: only available for Opus) (optional)>,
@@ -1851,6 +1872,7 @@ const char *janus_videoroom_get_author(void);
 const char *janus_videoroom_get_package(void);
 void janus_videoroom_create_session(janus_plugin_session *handle, int *error);
 struct janus_plugin_result *janus_videoroom_handle_message(janus_plugin_session *handle, char *transaction, json_t *message, json_t *jsep);
+struct janus_plugin_result *janus_videoroom_handle_message_sdp(janus_plugin_session *handle, char *transaction, json_t *message, json_t *jsep, janus_sdp *sdp);
 json_t *janus_videoroom_handle_admin_message(json_t *message);
 void janus_videoroom_setup_media(janus_plugin_session *handle);
 void janus_videoroom_incoming_rtp(janus_plugin_session *handle, janus_plugin_rtp *packet);
@@ -1858,6 +1880,7 @@ void janus_videoroom_incoming_rtcp(janus_plugin_session *handle, janus_plugin_rt
 void janus_videoroom_incoming_data(janus_plugin_session *handle, janus_plugin_data *packet);
 void janus_videoroom_data_ready(janus_plugin_session *handle);
 void janus_videoroom_slow_link(janus_plugin_session *handle, int mindex, gboolean video, gboolean uplink);
+void janus_videoroom_estimated_bandwidth(janus_plugin_session *handle, uint32_t estimate);
 void janus_videoroom_hangup_media(janus_plugin_session *handle);
 void janus_videoroom_destroy_session(janus_plugin_session *handle, int *error);
 json_t *janus_videoroom_query_session(janus_plugin_session *handle);
@@ -1878,6 +1901,7 @@ static janus_plugin janus_videoroom_plugin =
 
 		.create_session = janus_videoroom_create_session,
 		.handle_message = janus_videoroom_handle_message,
+		.handle_message_sdp = janus_videoroom_handle_message_sdp,
 		.handle_admin_message = janus_videoroom_handle_admin_message,
 		.setup_media = janus_videoroom_setup_media,
 		.incoming_rtp = janus_videoroom_incoming_rtp,
@@ -1885,6 +1909,7 @@ static janus_plugin janus_videoroom_plugin =
 		.incoming_data = janus_videoroom_incoming_data,
 		.data_ready = janus_videoroom_data_ready,
 		.slow_link = janus_videoroom_slow_link,
+		.estimated_bandwidth = janus_videoroom_estimated_bandwidth,
 		.hangup_media = janus_videoroom_hangup_media,
 		.destroy_session = janus_videoroom_destroy_session,
 		.query_session = janus_videoroom_query_session,
@@ -1938,6 +1963,10 @@ static struct janus_json_parameter create_parameters[] = {
 	{"dummy_streams", JANUS_JSON_ARRAY, 0},
 	{"dummy_e2ee", JANUS_JSON_BOOL, 0},
 	{"threads", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
+	{"shared_retransmissions", JANUS_JSON_BOOL, 0},
+	{"auto_layers", JANUS_JSON_BOOL, 0},
+	{"silence_suppression", JANUS_JSON_BOOL, 0},
+	{"silence_threshold", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
 };
 static struct janus_json_parameter edit_parameters[] = {
 	{"secret", JSON_STRING, 0},
@@ -2315,6 +2344,7 @@ typedef struct janus_videoroom_message {
 	char *transaction;
 	json_t *message;
 	json_t *jsep;
+	janus_sdp *sdp;
 } janus_videoroom_message;
 static GAsyncQueue *messages = NULL;
 static janus_videoroom_message exit_message;
@@ -2359,6 +2389,13 @@ typedef struct janus_videoroom {
 	gboolean notify_joining;	/* Whether an event is sent to notify all participants if a new participant joins the room */
 	int helper_threads;			/* Number of helper threads for relaying purposes */
 	GList *threads;				/* List of helper threads, if any */
+	gboolean shared_retransmissions;	/* Whether subscribers share the publishers' copy of video packets for retransmissions */
+	janus_rtp_shared_stats *rtx_stats;	/* Stats on shared retransmission packets, if enabled */
+	gboolean auto_layers;		/* Whether layers sent to subscribers are capped according to their estimated bandwidth */
+	gboolean silence_suppression;	/* Whether audio from publishers that have been quiet for a while is mostly not relayed */
+	int silence_threshold;		/* Audio level above which a packet is considered silence */
+	GHashTable *offers;			/* Cache of subscriber offers, indexed by what they're generated from */
+	janus_mutex offers_mutex;	/* Mutex to lock the offers cache */
 	janus_mutex mutex;			/* Mutex to lock this room instance */
 	janus_refcount ref;			/* Reference counter for this room */
 } janus_videoroom;
@@ -2517,6 +2554,14 @@ typedef struct janus_videoroom_publisher_stream {
 	char *srtp_crypto;
 	srtp_t srtp_ctx;
 	srtp_policy_t srtp_policy;
+	/* Bitrate of each simulcast substream or VP9 SVC spatial layer, if the room caps layers automatically */
+	uint32_t layer_bytes[3], layer_bitrate[3];
+	gint64 layer_bitrate_updated;
+	/* Silence suppression: consecutive quiet packets, whether we're currently suppressing, and how
+	 * many packets we dropped so far (to keep sequence numbers contiguous for subscribers) */
+	int quiet_packets;
+	gboolean silence_suppressed;
+	uint16_t silence_dropped;
 	/* Subscriptions to this publisher stream (who's receiving it)  */
 	GSList *subscribers;
 	janus_mutex subscribers_mutex;
@@ -2543,6 +2588,13 @@ static uint16_t rtp_range_slider = DEFAULT_RTP_RANGE_MIN;
 static janus_mutex fd_mutex = JANUS_MUTEX_INITIALIZER;
 #define REMOTE_PUBLISHER_BASE_SSRC	1000
 #define REMOTE_PUBLISHER_SSRC_STEP	10
+/* Silence suppression: default threshold, number of quiet packets (~500ms) before we start
+ * dropping audio, and how often (~400ms) we still relay a packet while suppressing */
+#define JANUS_VIDEOROOM_SILENCE_THRESHOLD	60
+#define JANUS_VIDEOROOM_SILENCE_HANGOVER	25
+#define JANUS_VIDEOROOM_SILENCE_KEEPALIVE	20
+/* Maximum number of subscriber offers we cache in a room (the cache is emptied when full) */
+#define JANUS_VIDEOROOM_OFFERS_CACHE_SIZE	32
 /* Helpers to create a listener filedescriptor */
 static int janus_videoroom_create_fd(int port, in_addr_t mcast, const janus_network_address *iface, char *host, size_t hostlen);
 /* Helper to return fd port */
@@ -2595,6 +2647,8 @@ typedef struct janus_videoroom_subscriber_stream {
 	janus_rtp_svc_context svc_context;
 	/* Playout delays to enforce when relaying this stream, if the extension has been negotiated */
 	int16_t min_delay, max_delay;
+	/* When we last changed the layer caps because of the estimated bandwidth */
+	gint64 layers_changed;
 	volatile gint ready, destroyed;
 	janus_refcount ref;
 } janus_videoroom_subscriber_stream;
@@ -2624,11 +2678,14 @@ typedef struct janus_videoroom_rtp_relay_packet {
 	janus_vp9_svc_info svc_info;
 	/* The following is only relevant for datachannels */
 	gboolean textdata;
+	/* Shared copy of the payload for retransmissions, if enabled in the room */
+	janus_rtp_shared_packet *shared;
 } janus_videoroom_rtp_relay_packet;
 static janus_videoroom_rtp_relay_packet exit_packet;
 static void janus_videoroom_rtp_relay_packet_free(janus_videoroom_rtp_relay_packet *pkt) {
 	if(pkt == NULL || pkt == &exit_packet)
 		return;
+	janus_rtp_shared_packet_unref(pkt->shared);
 	g_free(pkt->data);
 	g_free(pkt);
 }
@@ -2886,6 +2943,7 @@ static void janus_videoroom_room_free(const janus_refcount *room_ref) {
 		l = l->next;
 	}
 	g_list_free(room->threads);
+	janus_rtp_shared_stats_destroy(room->rtx_stats);
 	g_free(room->room_id_str);
 	g_free(room->room_name);
 	g_free(room->room_secret);
@@ -2896,6 +2954,8 @@ static void janus_videoroom_room_free(const janus_refcount *room_ref) {
 	g_hash_table_destroy(room->participants);
 	g_hash_table_destroy(room->private_ids);
 	g_hash_table_destroy(room->allowed);
+	if(room->offers != NULL)
+		g_hash_table_destroy(room->offers);
 	g_free(room);
 }
 
@@ -2917,10 +2977,17 @@ static void janus_videoroom_message_free(janus_videoroom_message *msg) {
 	if(msg->jsep)
 		json_decref(msg->jsep);
 	msg->jsep = NULL;
+	janus_sdp_destroy(msg->sdp);
+	msg->sdp = NULL;
 
 	g_free(msg);
 }
 
+/* Helper to check whether a message has an SDP attached, whether as a string or parsed */
+static gboolean janus_videoroom_message_has_sdp(janus_videoroom_message *msg) {
+	return msg->sdp != NULL || json_string_value(json_object_get(msg->jsep, "sdp")) != NULL;
+}
+
 static void janus_videoroom_codecstr(janus_videoroom *videoroom, char *audio_codecs, char *video_codecs, int str_len, const char *split) {
 	if (audio_codecs) {
 		audio_codecs[0] = 0;
@@ -3598,6 +3665,10 @@ static json_t *janus_videoroom_subscriber_streams_summary(janus_videoroom_subscr
 				json_object_set_new(simulcast, "substream-target", json_integer(stream->sim_context.substream_target));
 				json_object_set_new(simulcast, "temporal-layer", json_integer(stream->sim_context.templayer));
 				json_object_set_new(simulcast, "temporal-layer-target", json_integer(stream->sim_context.templayer_target));
+				if(stream->sim_context.substream_max > -1)
+					json_object_set_new(simulcast, "substream-max", json_integer(stream->sim_context.substream_max));
+				if(stream->sim_context.templayer_max > -1)
+					json_object_set_new(simulcast, "temporal-layer-max", json_integer(stream->sim_context.templayer_max));
 				if(stream->sim_context.drop_trigger > 0)
 					json_object_set_new(simulcast, "fallback", json_integer(stream->sim_context.drop_trigger));
 				json_object_set_new(m, "simulcast", simulcast);
@@ -3608,6 +3679,10 @@ static json_t *janus_videoroom_subscriber_streams_summary(janus_videoroom_subscr
 				json_object_set_new(svc, "target-spatial-layer", json_integer(stream->svc_context.spatial_target));
 				json_object_set_new(svc, "temporal-layer", json_integer(stream->svc_context.temporal));
 				json_object_set_new(svc, "target-temporal-layer", json_integer(stream->svc_context.temporal_target));
+				if(stream->svc_context.spatial_max > -1)
+					json_object_set_new(svc, "max-spatial-layer", json_integer(stream->svc_context.spatial_max));
+				if(stream->svc_context.temporal_max > -1)
+					json_object_set_new(svc, "max-temporal-layer", json_integer(stream->svc_context.temporal_max));
 				json_object_set_new(m, "svc", svc);
 			}
 		}
@@ -3620,74 +3695,155 @@ static json_t *janus_videoroom_subscriber_streams_summary(janus_videoroom_subscr
 	return media;
 }
 
-/* Helper to generate a new offer with the subscriber streams */
-static json_t *janus_videoroom_subscriber_offer(janus_videoroom_subscriber *subscriber) {
-	g_atomic_int_set(&subscriber->answered, 0);
-	char s_name[100], audio_fmtp[256];
-	g_snprintf(s_name, sizeof(s_name), "VideoRoom %s", subscriber->room->room_id_str);
-	janus_sdp *offer = janus_sdp_generate_offer(s_name, "0.0.0.0",
-		JANUS_SDP_OA_DONE);
+/* Helper to get rid of the cached subscriber offers of a room, e.g., because a publisher changed */
+static void janus_videoroom_offers_invalidate(janus_videoroom *room) {
+	if(room == NULL)
+		return;
+	janus_mutex_lock(&room->offers_mutex);
+	if(room->offers != NULL)
+		g_hash_table_remove_all(room->offers);
+	janus_mutex_unlock(&room->offers_mutex);
+}
+
+/* Helper to prepare the fmtp we offer for an audio stream */
+static void janus_videoroom_subscriber_audio_fmtp(janus_videoroom_publisher_stream *ps, char *audio_fmtp, size_t len) {
+	audio_fmtp[0] = '\0';
+	if(ps == NULL)
+		return;
+	if(ps->opusfec)
+		g_snprintf(audio_fmtp, len, "useinbandfec=1");
+	if(ps->opusdtx) {
+		if(strlen(audio_fmtp) == 0) {
+			g_snprintf(audio_fmtp, len, "usedtx=1");
+		} else {
+			janus_strlcat(audio_fmtp, ";usedtx=1", len);
+		}
+	}
+	if(ps->opusstereo) {
+		if(strlen(audio_fmtp) == 0) {
+			g_snprintf(audio_fmtp, len, "stereo=1");
+		} else {
+			janus_strlcat(audio_fmtp, ";stereo=1", len);
+		}
+	}
+}
+
+/* Helper to append a string to an offer key: strings are length-prefixed, since
+ * some of them come from publishers and may contain the separators we use */
+static void janus_videoroom_offer_key_append(GString *key, const char *value) {
+	if(value == NULL)
+		g_string_append(key, ",-");
+	else
+		g_string_append_printf(key, ",%zu:%s", strlen(value), value);
+}
+
+/* Helper to build the key we cache subscriber offers with: since it contains everything
+ * the offer is generated from, subscribers to the same streams can share the same offer */
+static char *janus_videoroom_subscriber_offer_key(janus_videoroom_subscriber *subscriber) {
+	GString *key = g_string_sized_new(256);
+	char audio_fmtp[256];
+	g_string_append_printf(key, "%d", subscriber->room->transport_wide_cc_ext);
 	GList *temp = subscriber->streams;
 	while(temp) {
 		janus_videoroom_subscriber_stream *stream = (janus_videoroom_subscriber_stream *)temp->data;
 		janus_videoroom_publisher_stream *ps = stream->publisher_streams ? stream->publisher_streams->data : NULL;
-		int pt = -1;
-		const char *codec = NULL;
 		audio_fmtp[0] = '\0';
-		if(ps && stream->type == JANUS_VIDEOROOM_MEDIA_AUDIO) {
-			if(ps->opusfec)
-				g_snprintf(audio_fmtp, sizeof(audio_fmtp), "useinbandfec=1");
-			if(ps->opusdtx) {
-				if(strlen(audio_fmtp) == 0) {
-					g_snprintf(audio_fmtp, sizeof(audio_fmtp), "usedtx=1");
-				} else {
-					janus_strlcat(audio_fmtp, ";usedtx=1", sizeof(audio_fmtp));
-				}
-			}
-			if(ps->opusstereo) {
-				if(strlen(audio_fmtp) == 0) {
-					g_snprintf(audio_fmtp, sizeof(audio_fmtp), "stereo=1");
-				} else {
-					janus_strlcat(audio_fmtp, ";stereo=1", sizeof(audio_fmtp));
-				}
-			}
-		}
-		if(stream->type != JANUS_VIDEOROOM_MEDIA_DATA) {
-			pt = stream->pt;
-			codec = (stream->type == JANUS_VIDEOROOM_MEDIA_AUDIO ?
-				janus_audiocodec_name(stream->acodec) : janus_videocodec_name(stream->vcodec));
-		}
+		if(stream->type == JANUS_VIDEOROOM_MEDIA_AUDIO)
+			janus_videoroom_subscriber_audio_fmtp(ps, audio_fmtp, sizeof(audio_fmtp));
 		gboolean add_msid = (subscriber->use_msid && ps && !ps->disabled);
-		janus_sdp_generate_offer_mline(offer,
-			JANUS_SDP_OA_MLINE, janus_videoroom_media_sdptype(stream->type),
-			JANUS_SDP_OA_MID, stream->mid,
-			JANUS_SDP_OA_MSID, add_msid ? stream->msid : NULL, add_msid ? stream->mstid : NULL,
-			JANUS_SDP_OA_PT, pt,
-			JANUS_SDP_OA_CODEC, codec,
-			JANUS_SDP_OA_FMTP, (stream->type == JANUS_VIDEOROOM_MEDIA_AUDIO && strlen(audio_fmtp) ? audio_fmtp : NULL),
-			JANUS_SDP_OA_H264_PROFILE, (stream->type == JANUS_VIDEOROOM_MEDIA_VIDEO ? stream->h264_profile : NULL),
-			JANUS_SDP_OA_VP9_PROFILE, (stream->type == JANUS_VIDEOROOM_MEDIA_VIDEO ? stream->vp9_profile : NULL),
-			JANUS_SDP_OA_DIRECTION, ((ps && !ps->disabled) || stream->type == JANUS_VIDEOROOM_MEDIA_DATA) ? JANUS_SDP_SENDONLY : JANUS_SDP_INACTIVE,
-			JANUS_SDP_OA_EXTENSION, JANUS_RTP_EXTMAP_AUDIO_LEVEL,
-				(stream->type == JANUS_VIDEOROOM_MEDIA_AUDIO && (ps && ps->audio_level_extmap_id > 0)) ? janus_rtp_extension_id(JANUS_RTP_EXTMAP_AUDIO_LEVEL) : 0,
-			JANUS_SDP_OA_EXTENSION, JANUS_RTP_EXTMAP_MID, janus_rtp_extension_id(JANUS_RTP_EXTMAP_MID),
-			JANUS_SDP_OA_EXTENSION, JANUS_RTP_EXTMAP_VIDEO_ORIENTATION,
-				(stream->type == JANUS_VIDEOROOM_MEDIA_VIDEO && (ps && ps->video_orient_extmap_id > 0)) ? janus_rtp_extension_id(JANUS_RTP_EXTMAP_VIDEO_ORIENTATION) : 0,
-			JANUS_SDP_OA_EXTENSION, JANUS_RTP_EXTMAP_PLAYOUT_DELAY,
-				(stream->type == JANUS_VIDEOROOM_MEDIA_VIDEO && (ps && ps->playout_delay_extmap_id > 0)) ? janus_rtp_extension_id(JANUS_RTP_EXTMAP_PLAYOUT_DELAY) : 0,
-			JANUS_SDP_OA_EXTENSION, JANUS_RTP_EXTMAP_TRANSPORT_WIDE_CC,
-				(stream->type == JANUS_VIDEOROOM_MEDIA_VIDEO && subscriber->room->transport_wide_cc_ext) ? janus_rtp_extension_id(JANUS_RTP_EXTMAP_TRANSPORT_WIDE_CC) : 0,
-			JANUS_SDP_OA_EXTENSION, JANUS_RTP_EXTMAP_ABS_SEND_TIME,
-				(stream->type == JANUS_VIDEOROOM_MEDIA_VIDEO) ? janus_rtp_extension_id(JANUS_RTP_EXTMAP_ABS_SEND_TIME) : 0,
-			/* TODO Add other properties from original SDP */
-			JANUS_SDP_OA_DONE);
+		g_string_append_printf(key, "|%d,%d,%d,%d,%d,%d,%d,%d",
+			stream->type, stream->pt, stream->acodec, stream->vcodec,
+			(ps && !ps->disabled), (ps && ps->audio_level_extmap_id > 0),
+			(ps && ps->video_orient_extmap_id > 0), (ps && ps->playout_delay_extmap_id > 0));
+		janus_videoroom_offer_key_append(key, stream->mid);
+		janus_videoroom_offer_key_append(key, add_msid ? stream->msid : NULL);
+		janus_videoroom_offer_key_append(key, add_msid ? stream->mstid : NULL);
+		janus_videoroom_offer_key_append(key, audio_fmtp);
+		janus_videoroom_offer_key_append(key, stream->h264_profile);
+		janus_videoroom_offer_key_append(key, stream->vp9_profile);
 		temp = temp->next;
 	}
+	return g_string_free(key, FALSE);
+}
+
+/* Helper to generate a new offer with the subscriber streams */
+static json_t *janus_videoroom_subscriber_offer(janus_videoroom_subscriber *subscriber) {
+	g_atomic_int_set(&subscriber->answered, 0);
 	/* Update (or set) the SDP version */
 	subscriber->session->sdp_version++;
-	offer->o_version = subscriber->session->sdp_version;
-	char *sdp = janus_sdp_write(offer);
-	janus_sdp_destroy(offer);
+	janus_videoroom *room = subscriber->room;
+	/* Check if we generated an offer for the same streams already: if so,
+	 * we only need to prepend an origin line with our own session version */
+	char *key = janus_videoroom_subscriber_offer_key(subscriber), *sdp = NULL;
+	janus_mutex_lock(&room->offers_mutex);
+	const char *cached = room->offers ? g_hash_table_lookup(room->offers, key) : NULL;
+	if(cached != NULL) {
+		sdp = g_strdup_printf("v=0\r\no=- %"SCNu64" %"SCNu64" IN IP4 0.0.0.0\r\n%s",
+			janus_get_real_time(), subscriber->session->sdp_version, cached);
+	}
+	janus_mutex_unlock(&room->offers_mutex);
+	if(sdp == NULL) {
+		char s_name[100], audio_fmtp[256];
+		g_snprintf(s_name, sizeof(s_name), "VideoRoom %s", room->room_id_str);
+		janus_sdp *offer = janus_sdp_generate_offer(s_name, "0.0.0.0",
+			JANUS_SDP_OA_DONE);
+		GList *temp = subscriber->streams;
+		while(temp) {
+			janus_videoroom_subscriber_stream *stream = (janus_videoroom_subscriber_stream *)temp->data;
+			janus_videoroom_publisher_stream *ps = stream->publisher_streams ? stream->publisher_streams->data : NULL;
+			int pt = -1;
+			const char *codec = NULL;
+			audio_fmtp[0] = '\0';
+			if(stream->type == JANUS_VIDEOROOM_MEDIA_AUDIO)
+				janus_videoroom_subscriber_audio_fmtp(ps, audio_fmtp, sizeof(audio_fmtp));
+			if(stream->type != JANUS_VIDEOROOM_MEDIA_DATA) {
+				pt = stream->pt;
+				codec = (stream->type == JANUS_VIDEOROOM_MEDIA_AUDIO ?
+					janus_audiocodec_name(stream->acodec) : janus_videocodec_name(stream->vcodec));
+			}
+			gboolean add_msid = (subscriber->use_msid && ps && !ps->disabled);
+			janus_sdp_generate_offer_mline(offer,
+				JANUS_SDP_OA_MLINE, janus_videoroom_media_sdptype(stream->type),
+				JANUS_SDP_OA_MID, stream->mid,
+				JANUS_SDP_OA_MSID, add_msid ? stream->msid : NULL, add_msid ? stream->mstid : NULL,
+				JANUS_SDP_OA_PT, pt,
+				JANUS_SDP_OA_CODEC, codec,
+				JANUS_SDP_OA_FMTP, (stream->type == JANUS_VIDEOROOM_MEDIA_AUDIO && strlen(audio_fmtp) ? audio_fmtp : NULL),
+				JANUS_SDP_OA_H264_PROFILE, (stream->type == JANUS_VIDEOROOM_MEDIA_VIDEO ? stream->h264_profile : NULL),
+				JANUS_SDP_OA_VP9_PROFILE, (stream->type == JANUS_VIDEOROOM_MEDIA_VIDEO ? stream->vp9_profile : NULL),
+				JANUS_SDP_OA_DIRECTION, ((ps && !ps->disabled) || stream->type == JANUS_VIDEOROOM_MEDIA_DATA) ? JANUS_SDP_SENDONLY : JANUS_SDP_INACTIVE,
+				JANUS_SDP_OA_EXTENSION, JANUS_RTP_EXTMAP_AUDIO_LEVEL,
+					(stream->type == JANUS_VIDEOROOM_MEDIA_AUDIO && (ps && ps->audio_level_extmap_id > 0)) ? janus_rtp_extension_id(JANUS_RTP_EXTMAP_AUDIO_LEVEL) : 0,
+				JANUS_SDP_OA_EXTENSION, JANUS_RTP_EXTMAP_MID, janus_rtp_extension_id(JANUS_RTP_EXTMAP_MID),
+				JANUS_SDP_OA_EXTENSION, JANUS_RTP_EXTMAP_VIDEO_ORIENTATION,
+					(stream->type == JANUS_VIDEOROOM_MEDIA_VIDEO && (ps && ps->video_orient_extmap_id > 0)) ? janus_rtp_extension_id(JANUS_RTP_EXTMAP_VIDEO_ORIENTATION) : 0,
+				JANUS_SDP_OA_EXTENSION, JANUS_RTP_EXTMAP_PLAYOUT_DELAY,
+					(stream->type == JANUS_VIDEOROOM_MEDIA_VIDEO && (ps && ps->playout_delay_extmap_id > 0)) ? janus_rtp_extension_id(JANUS_RTP_EXTMAP_PLAYOUT_DELAY) : 0,
+				JANUS_SDP_OA_EXTENSION, JANUS_RTP_EXTMAP_TRANSPORT_WIDE_CC,
+					(stream->type == JANUS_VIDEOROOM_MEDIA_VIDEO && room->transport_wide_cc_ext) ? janus_rtp_extension_id(JANUS_RTP_EXTMAP_TRANSPORT_WIDE_CC) : 0,
+				JANUS_SDP_OA_EXTENSION, JANUS_RTP_EXTMAP_ABS_SEND_TIME,
+					(stream->type == JANUS_VIDEOROOM_MEDIA_VIDEO) ? janus_rtp_extension_id(JANUS_RTP_EXTMAP_ABS_SEND_TIME) : 0,
+				/* TODO Add other properties from original SDP */
+				JANUS_SDP_OA_DONE);
+			temp = temp->next;
+		}
+		offer->o_version = subscriber->session->sdp_version;
+		sdp = janus_sdp_write(offer);
+		janus_sdp_destroy(offer);
+		/* Cache what follows the origin line, for the next subscriber to the same streams */
+		char *body = sdp ? strstr(sdp, "\r\ns=") : NULL;
+		if(body != NULL) {
+			janus_mutex_lock(&room->offers_mutex);
+			if(room->offers == NULL)
+				room->offers = g_hash_table_new_full(g_str_hash, g_str_equal, (GDestroyNotify)g_free, (GDestroyNotify)g_free);
+			if(g_hash_table_size(room->offers) >= JANUS_VIDEOROOM_OFFERS_CACHE_SIZE)
+				g_hash_table_remove_all(room->offers);
+			g_hash_table_insert(room->offers, key, g_strdup(body + 2));
+			key = NULL;
+			janus_mutex_unlock(&room->offers_mutex);
+		}
+	}
+	g_free(key);
 	json_t *jsep = json_pack("{ssss}", "type", "offer", "sdp", sdp);
 	if(subscriber->e2ee)
 		json_object_set_new(jsep, "e2ee", json_true());
@@ -3796,6 +3952,10 @@ int janus_videoroom_init(janus_callbacks *callback, const char *config_path) {
 			janus_config_item *rec_dir = janus_config_get(config, cat, janus_config_type_item, "rec_dir");
 			janus_config_item *lock_record = janus_config_get(config, cat, janus_config_type_item, "lock_record");
 			janus_config_item *threads = janus_config_get(config, cat, janus_config_type_item, "threads");
+			janus_config_item *shared_rtx = janus_config_get(config, cat, janus_config_type_item, "shared_retransmissions");
+			janus_config_item *auto_layers = janus_config_get(config, cat, janus_config_type_item, "auto_layers");
+			janus_config_item *silence_suppression = janus_config_get(config, cat, janus_config_type_item, "silence_suppression");
+			janus_config_item *silence_threshold = janus_config_get(config, cat, janus_config_type_item, "silence_threshold");
 			/* Create the video room */
 			janus_videoroom *videoroom = g_malloc0(sizeof(janus_videoroom));
 			const char *room_num = cat->name;
@@ -4001,8 +4161,28 @@ int janus_videoroom_init(janus_callbacks *callback, const char *config_path) {
 			videoroom->notify_joining = FALSE;
 			if(notify_joining != NULL && notify_joining->value != NULL)
 				videoroom->notify_joining = janus_is_true(notify_joining->value);
+			if(shared_rtx != NULL && shared_rtx->value != NULL && janus_is_true(shared_rtx->value)) {
+				videoroom->shared_retransmissions = TRUE;
+				videoroom->rtx_stats = janus_rtp_shared_stats_create();
+			}
+			if(auto_layers != NULL && auto_layers->value != NULL)
+				videoroom->auto_layers = janus_is_true(auto_layers->value);
+			if(videoroom->audiolevel_ext && silence_suppression != NULL && silence_suppression->value != NULL)
+				videoroom->silence_suppression = janus_is_true(silence_suppression->value);
+			if(videoroom->silence_suppression) {
+				videoroom->silence_threshold = JANUS_VIDEOROOM_SILENCE_THRESHOLD;
+				if(silence_threshold != NULL && silence_threshold->value != NULL) {
+					int threshold = atoi(silence_threshold->value);
+					if(threshold > 0 && threshold <= 127) {
+						videoroom->silence_threshold = threshold;
+					} else {
+						JANUS_LOG(LOG_WARN, "Invalid silence_threshold value provided, using default: %d\n", videoroom->silence_threshold);
+					}
+				}
+			}
 			g_atomic_int_set(&videoroom->destroyed, 0);
 			janus_mutex_init(&videoroom->mutex);
+			janus_mutex_init(&videoroom->offers_mutex);
 			janus_refcount_init(&videoroom->ref, janus_videoroom_room_free);
 			videoroom->participants = g_hash_table_new_full(string_ids ? g_str_hash : g_int64_hash, string_ids ? g_str_equal : g_int64_equal,
 				(GDestroyNotify)g_free, (GDestroyNotify)janus_videoroom_publisher_dereference);
@@ -4310,6 +4490,8 @@ static void janus_videoroom_notify_participants(janus_videoroom_publisher *parti
 static void janus_videoroom_notify_about_publisher(janus_videoroom_publisher *p, gboolean update) {
 	if(p == NULL)
 		return;
+	/* The streams of this publisher may have changed, so cached offers may be stale */
+	janus_videoroom_offers_invalidate(p->room);
 	/* Notify all other participants that there's a new boy in town */
 	json_t *list = json_array();
 	json_t *pl = json_object();
@@ -4466,6 +4648,7 @@ static void janus_videoroom_leave_or_unpublish(janus_videoroom_publisher *partic
 	}
 	janus_refcount_increase(&room->ref);
 	janus_mutex_unlock(&rooms_mutex);
+	janus_videoroom_offers_invalidate(room);
 	janus_mutex_lock(&room->mutex);
 	if (!participant->room) {
 		janus_mutex_unlock(&room->mutex);
@@ -4802,6 +4985,10 @@ static json_t *janus_videoroom_process_synchronous_request(janus_videoroom_sessi
 		json_t *dummy_str = json_object_get(root, "dummy_streams");
 		json_t *dummy_e2ee = json_object_get(root, "dummy_e2ee");
 		json_t *threads = json_object_get(root, "threads");
+		json_t *shared_rtx = json_object_get(root, "shared_retransmissions");
+		json_t *auto_layers = json_object_get(root, "auto_layers");
+		json_t *silence_suppression = json_object_get(root, "silence_suppression");
+		json_t *silence_threshold = json_object_get(root, "silence_threshold");
 		json_t *secret = json_object_get(root, "secret");
 		json_t *pin = json_object_get(root, "pin");
 		json_t *bitrate = json_object_get(root, "bitrate");
@@ -5130,6 +5317,23 @@ static json_t *janus_videoroom_process_synchronous_request(janus_videoroom_sessi
 		/* By default, the VideoRoom plugin does not notify about participants simply joining the room.
 		   It only notifies when the participant actually starts publishing media. */
 		videoroom->notify_joining = notify_joining ? json_is_true(notify_joining) : FALSE;
+		if(shared_rtx && json_is_true(shared_rtx)) {
+			videoroom->shared_retransmissions = TRUE;
+			videoroom->rtx_stats = janus_rtp_shared_stats_create();
+		}
+		videoroom->auto_layers = auto_layers ? json_is_true(auto_layers) : FALSE;
+		videoroom->silence_suppression = videoroom->audiolevel_ext && silence_suppression ? json_is_true(silence_suppression) : FALSE;
+		if(videoroom->silence_suppression) {
+			videoroom->silence_threshold = JANUS_VIDEOROOM_SILENCE_THRESHOLD;
+			if(silence_threshold != NULL) {
+				int threshold = json_integer_value(silence_threshold);
+				if(threshold > 0 && threshold <= 127) {
+					videoroom->silence_threshold = threshold;
+				} else {
+					JANUS_LOG(LOG_WARN, "Invalid silence_threshold value provided, using default: %d\n", videoroom->silence_threshold);
+				}
+			}
+		}
 		if(record) {
 			videoroom->record = json_is_true(record);
 		}
@@ -5141,6 +5345,7 @@ static json_t *janus_videoroom_process_synchronous_request(janus_videoroom_sessi
 		}
 		g_atomic_int_set(&videoroom->destroyed, 0);
 		janus_mutex_init(&videoroom->mutex);
+		janus_mutex_init(&videoroom->offers_mutex);
 		janus_refcount_init(&videoroom->ref, janus_videoroom_room_free);
 		videoroom->participants = g_hash_table_new_full(string_ids ? g_str_hash : g_int64_hash, string_ids ? g_str_equal : g_int64_equal,
 			(GDestroyNotify)g_free, (GDestroyNotify)janus_videoroom_publisher_dereference);
@@ -5289,6 +5494,15 @@ static json_t *janus_videoroom_process_synchronous_request(janus_videoroom_sessi
 				g_snprintf(value, BUFSIZ, "%"SCNu32, videoroom->helper_threads);
 				janus_config_add(config, c, janus_config_item_create("threads", value));
 			}
+			if(videoroom->shared_retransmissions)
+				janus_config_add(config, c, janus_config_item_create("shared_retransmissions", "true"));
+			if(videoroom->auto_layers)
+				janus_config_add(config, c, janus_config_item_create("auto_layers", "true"));
+			if(videoroom->silence_suppression) {
+				janus_config_add(config, c, janus_config_item_create("silence_suppression", "true"));
+				g_snprintf(value, BUFSIZ, "%d", videoroom->silence_threshold);
+				janus_config_add(config, c, janus_config_item_create("silence_threshold", value));
+			}
 			/* Save modified configuration */
 			if(janus_config_save(config, config_folder, JANUS_VIDEOROOM_PACKAGE) < 0)
 				save = FALSE;	/* This will notify the user the room is not permanent */
@@ -5486,6 +5700,15 @@ static json_t *janus_videoroom_process_synchronous_request(janus_videoroom_sessi
 				g_snprintf(value, BUFSIZ, "%"SCNu32, videoroom->helper_threads);
 				janus_config_add(config, c, janus_config_item_create("threads", value));
 			}
+			if(videoroom->shared_retransmissions)
+				janus_config_add(config, c, janus_config_item_create("shared_retransmissions", "true"));
+			if(videoroom->auto_layers)
+				janus_config_add(config, c, janus_config_item_create("auto_layers", "true"));
+			if(videoroom->silence_suppression) {
+				janus_config_add(config, c, janus_config_item_create("silence_suppression", "true"));
+				g_snprintf(value, BUFSIZ, "%d", videoroom->silence_threshold);
+				janus_config_add(config, c, janus_config_item_create("silence_threshold", value));
+			}
 			/* Save modified configuration */
 			if(janus_config_save(config, config_folder, JANUS_VIDEOROOM_PACKAGE) < 0)
 				save = FALSE;	/* This will notify the user the room changes are not permanent */
@@ -5652,6 +5875,16 @@ static json_t *janus_videoroom_process_synchronous_request(janus_videoroom_sessi
 				json_object_set_new(rl, "require_e2ee", room->require_e2ee ? json_true() : json_false());
 				json_object_set_new(rl, "dummy_publisher", room->dummy_publisher ? json_true() : json_false());
 				json_object_set_new(rl, "notify_joining", room->notify_joining ? json_true() : json_false());
+				json_object_set_new(rl, "shared_retransmissions", room->shared_retransmissions ? json_true() : json_false());
+				if(room->rtx_stats) {
+					json_t *rtx = json_object();
+					json_object_set_new(rtx, "packets", json_integer(g_atomic_int_get(&room->rtx_stats->packets)));
+					json_object_set_new(rtx, "bytes", json_integer(g_atomic_int_get(&room->rtx_stats->bytes)));
+					json_object_set_new(rtx, "saved_bytes", json_integer(janus_rtp_shared_stats_saved_bytes(room->rtx_stats)));
+					json_object_set_new(rl, "shared_retransmissions_stats", rtx);
+				}
+				json_object_set_new(rl, "auto_layers", room->auto_layers ? json_true() : json_false());
+				json_object_set_new(rl, "silence_suppression", room->silence_suppression ? json_true() : json_false());
 				char audio_codecs[100];
 				char video_codecs[100];
 				janus_videoroom_codecstr(room, audio_codecs, video_codecs, sizeof(audio_codecs), ",");
@@ -8474,9 +8707,23 @@ prepare_response:
 
 }
 
+static struct janus_plugin_result *janus_videoroom_handle_message_internal(janus_plugin_session *handle,
+	char *transaction, json_t *message, json_t *jsep, janus_sdp *sdp);
 struct janus_plugin_result *janus_videoroom_handle_message(janus_plugin_session *handle, char *transaction, json_t *message, json_t *jsep) {
-	if(g_atomic_int_get(&stopping) || !g_atomic_int_get(&initialized))
+	return janus_videoroom_handle_message_internal(handle, transaction, message, jsep, NULL);
+}
+
+struct janus_plugin_result *janus_videoroom_handle_message_sdp(janus_plugin_session *handle, char *transaction, json_t *message, json_t *jsep, janus_sdp *sdp) {
+	/* Same as above, but the core passed us the SDP already parsed */
+	return janus_videoroom_handle_message_internal(handle, transaction, message, jsep, sdp);
+}
+
+static struct janus_plugin_result *janus_videoroom_handle_message_internal(janus_plugin_session *handle,
+		char *transaction, json_t *message, json_t *jsep, janus_sdp *sdp) {
+	if(g_atomic_int_get(&stopping) || !g_atomic_int_get(&initialized)) {
+		janus_sdp_destroy(sdp);
 		return janus_plugin_result_new(JANUS_PLUGIN_ERROR, g_atomic_int_get(&stopping) ? "Shutting down" : "Plugin not initialized", NULL);
+	}
 
 	/* Pre-parse the message */
 	int error_code = 0;
@@ -8541,6 +8788,7 @@ struct janus_plugin_result *janus_videoroom_handle_message(janus_plugin_session
 		msg->transaction = transaction;
 		msg->message = root;
 		msg->jsep = jsep;
+		msg->sdp = sdp;
 		g_async_queue_push(messages, msg);
 
 		return janus_plugin_result_new(JANUS_PLUGIN_OK_WAIT, NULL, NULL);
@@ -8568,6 +8816,7 @@ plugin_response:
 				json_decref(root);
 			if(jsep != NULL)
 				json_decref(jsep);
+			janus_sdp_destroy(sdp);
 			g_free(transaction);
 
 			if(session != NULL)
@@ -8865,6 +9114,33 @@ static void janus_videoroom_incoming_rtp_internal(janus_videoroom_session *sessi
 				rtp->seq_number = htons(seq_number);
 			}
 		}
+		/* If the publisher has been quiet for a while, don't relay everything */
+		if(!video && videoroom->silence_suppression && !ps->opusdtx && ps->audio_level_extmap_id > 0) {
+			int level = pkt->extensions.audio_level;
+			if(level == -1 || level < videoroom->silence_threshold) {
+				if(ps->silence_suppressed) {
+					/* The publisher is talking again, mark the start of the talkspurt */
+					rtp->markerbit = 1;
+					ps->silence_suppressed = FALSE;
+				}
+				ps->quiet_packets = 0;
+			} else if(ps->quiet_packets < JANUS_VIDEOROOM_SILENCE_HANGOVER) {
+				ps->quiet_packets++;
+			} else {
+				ps->silence_suppressed = TRUE;
+				/* Only relay a packet every now and then, as DTX would do for comfort noise */
+				ps->quiet_packets++;
+				if(ps->quiet_packets % JANUS_VIDEOROOM_SILENCE_KEEPALIVE != 0) {
+					ps->silence_dropped++;
+					janus_refcount_decrease_nodebug(&ps->ref);
+					janus_videoroom_publisher_dereference_nodebug(participant);
+					janus_refcount_decrease_nodebug(&videoroom->ref);
+					return;
+				}
+			}
+			if(ps->silence_dropped > 0)
+				rtp->seq_number = htons(ntohs(rtp->seq_number) - ps->silence_dropped);
+		}
 		/* Done, relay it */
 		janus_videoroom_rtp_relay_packet packet = { 0 };
 		packet.source = ps;
@@ -8895,6 +9171,24 @@ static void janus_videoroom_incoming_rtp_internal(janus_videoroom_session *sessi
 		}
 		if(video && ps->simulcast)
 			packet.simulcast = TRUE;
+		if(video && videoroom->auto_layers && (ps->simulcast || packet.svc)) {
+			/* Keep track of the bitrate of each substream or spatial layer, as we'll
+			 * need it to figure out which layers subscribers can receive */
+			int layer = ps->simulcast ? sc : (ps->vcodec == JANUS_VIDEOCODEC_VP9 ? packet.svc_info.spatial_layer : -1);
+			if(layer >= 0 && layer <= 2)
+				ps->layer_bytes[layer] += len;
+			gint64 now = janus_get_monotonic_time();
+			if(ps->layer_bitrate_updated == 0) {
+				ps->layer_bitrate_updated = now;
+			} else if(now - ps->layer_bitrate_updated >= G_USEC_PER_SEC) {
+				int i = 0;
+				for(i=0; i<3; i++) {
+					ps->layer_bitrate[i] = (uint32_t)((guint64)ps->layer_bytes[i] * 8 * G_USEC_PER_SEC / (now - ps->layer_bitrate_updated));
+					ps->layer_bytes[i] = 0;
+				}
+				ps->layer_bitrate_updated = now;
+			}
+		}
 		packet.ssrc[0] = (sc != -1 ? ps->vssrc[0] : 0);
 		packet.ssrc[1] = (sc != -1 ? ps->vssrc[1] : 0);
 		packet.ssrc[2] = (sc != -1 ? ps->vssrc[2] : 0);
@@ -8905,6 +9199,11 @@ static void janus_videoroom_incoming_rtp_internal(janus_videoroom_session *sessi
 			packet.extensions.min_delay = ps->min_delay;
 			packet.extensions.max_delay = ps->max_delay;
 		}
+		/* If the room is configured to do that, create a single copy of the payload that subscribers
+		 * will reference for retransmissions: we can't do that for VP8 simulcast, as in that case
+		 * we rewrite the payload descriptor for each subscriber */
+		if(video && videoroom->shared_retransmissions && !(ps->simulcast && ps->vcodec == JANUS_VIDEOCODEC_VP8))
+			packet.shared = janus_rtp_shared_packet_create(buf, len, videoroom->rtx_stats);
 		/* Go: some viewers may decide to drop the packet, but that's up to them */
 		janus_mutex_lock_nodebug(&ps->subscribers_mutex);
 		if(videoroom->helper_threads > 0) {
@@ -8913,6 +9212,7 @@ static void janus_videoroom_incoming_rtp_internal(janus_videoroom_session *sessi
 			g_slist_foreach(ps->subscribers, janus_videoroom_relay_rtp_packet, &packet);
 		}
 		janus_mutex_unlock_nodebug(&ps->subscribers_mutex);
+		janus_rtp_shared_packet_unref(packet.shared);
 
 		/* Check if we need to send any REMB, FIR or PLI back to this publisher */
 		if(video && ps->active && !ps->muted) {
@@ -8992,8 +9292,6 @@ void janus_videoroom_incoming_rtcp(janus_plugin_session *handle, janus_plugin_rt
 	}
 	if(g_atomic_int_get(&session->destroyed))
 		return;
-	char *buf = packet->buffer;
-	uint16_t len = packet->length;
 	if(session->participant_type == janus_videoroom_p_type_subscriber) {
 		/* A subscriber sent some RTCP, check what it is and if we need to forward it to the publisher */
 		janus_videoroom_subscriber *s = janus_videoroom_session_get_subscriber_nodebug(session);
@@ -9020,13 +9318,15 @@ void janus_videoroom_incoming_rtcp(janus_plugin_session *handle, janus_plugin_rt
 		}
 		janus_refcount_increase_nodebug(&ps->ref);
 		janus_mutex_unlock(&s->streams_mutex);
-		if(janus_rtcp_has_fir(buf, len) || janus_rtcp_has_pli(buf, len)) {
+		/* The core parsed the compound packet for us already */
+		janus_rtcp_compound *compound = packet->compound;
+		if(compound && (compound->has_fir || compound->has_pli)) {
 			/* We got a FIR or PLI, forward a PLI to the publisher */
 			janus_videoroom_publisher *p = ps->publisher;
 			if(p && p->session)
 				janus_videoroom_reqpli(ps, "PLI from subscriber");
 		}
-		uint32_t bitrate = janus_rtcp_get_remb(buf, len);
+		uint32_t bitrate = compound ? compound->remb_bitrate : 0;
 		if(bitrate > 0) {
 			/* FIXME We got a REMB from this subscriber, should we do something about it? */
 		}
@@ -9227,6 +9527,106 @@ void janus_videoroom_slow_link(janus_plugin_session *handle, int mindex, gboolea
 	janus_refcount_decrease(&session->ref);
 }
 
+/* Helper to figure out the highest layer that fits a bandwidth budget: returns -1 if not even the lowest does */
+static int janus_videoroom_pick_layer(janus_videoroom_publisher_stream *ps, uint32_t budget) {
+	int layer = -1, i = 0;
+	guint64 needed = 0;
+	for(i=0; i<3; i++) {
+		uint32_t bitrate = ps->layer_bitrate[i];
+		if(bitrate == 0)
+			continue;
+		/* Simulcast substreams are independent, while SVC layers depend on the lower ones */
+		needed = ps->simulcast ? bitrate : needed + bitrate;
+		/* Leave some headroom, as the bitrate of a layer is not constant */
+		if(needed + needed/10 > budget)
+			break;
+		layer = i;
+	}
+	return layer;
+}
+
+void janus_videoroom_estimated_bandwidth(janus_plugin_session *handle, uint32_t estimate) {
+	/* The core is telling us how much it thinks it can send to a peer: if this is a subscriber
+	 * in a room that caps layers automatically, figure out which layers fit the estimate */
+	if(handle == NULL || g_atomic_int_get(&handle->stopped) || g_atomic_int_get(&stopping) || !g_atomic_int_get(&initialized))
+		return;
+	janus_mutex_lock(&sessions_mutex);
+	janus_videoroom_session *session = janus_videoroom_lookup_session(handle);
+	if(!session || g_atomic_int_get(&session->destroyed) || !session->participant ||
+			session->participant_type != janus_videoroom_p_type_subscriber) {
+		janus_mutex_unlock(&sessions_mutex);
+		return;
+	}
+	janus_refcount_increase(&session->ref);
+	janus_mutex_unlock(&sessions_mutex);
+	janus_videoroom_subscriber *subscriber = janus_videoroom_session_get_subscriber(session);
+	if(subscriber == NULL) {
+		janus_refcount_decrease(&session->ref);
+		return;
+	}
+	if(g_atomic_int_get(&subscriber->destroyed) || subscriber->room == NULL || !subscriber->room->auto_layers) {
+		janus_refcount_decrease(&subscriber->ref);
+		janus_refcount_decrease(&session->ref);
+		return;
+	}
+	JANUS_LOG(LOG_HUGE, "[%s-%p] Estimated bandwidth for subscriber: %"SCNu32"\n", JANUS_VIDEOROOM_PACKAGE, handle, estimate);
+	gint64 now = janus_get_monotonic_time();
+	janus_mutex_lock(&subscriber->streams_mutex);
+	/* Reserve some bandwidth for audio, and split the rest among the video streams we're sending */
+	int video_streams = 0;
+	uint32_t budget = estimate;
+	GList *temp = subscriber->streams;
+	while(temp) {
+		janus_videoroom_subscriber_stream *stream = (janus_videoroom_subscriber_stream *)temp->data;
+		temp = temp->next;
+		if(!stream->send || stream->publisher_streams == NULL)
+			continue;
+		if(stream->type == JANUS_VIDEOROOM_MEDIA_AUDIO)
+			budget = budget > 64000 ? budget - 64000 : 0;
+		else if(stream->type == JANUS_VIDEOROOM_MEDIA_VIDEO)
+			video_streams++;
+	}
+	if(video_streams == 0) {
+		janus_mutex_unlock(&subscriber->streams_mutex);
+		janus_refcount_decrease(&subscriber->ref);
+		janus_refcount_decrease(&session->ref);
+		return;
+	}
+	budget /= video_streams;
+	temp = subscriber->streams;
+	while(temp) {
+		janus_videoroom_subscriber_stream *stream = (janus_videoroom_subscriber_stream *)temp->data;
+		temp = temp->next;
+		if(stream->type != JANUS_VIDEOROOM_MEDIA_VIDEO || !stream->send || stream->publisher_streams == NULL)
+			continue;
+		janus_videoroom_publisher_stream *ps = stream->publisher_streams->data;
+		if(ps == NULL || !(ps->simulcast || (ps->svc && ps->vcodec == JANUS_VIDEOCODEC_VP9)) || ps->layer_bitrate_updated == 0)
+			continue;
+		int layer = janus_videoroom_pick_layer(ps, budget);
+		/* If not even the lowest layer fits, drop to the base temporal layer as well */
+		int temporal = (layer == -1 ? 0 : -1);
+		if(layer == -1)
+			layer = 0;
+		int *layer_max = ps->simulcast ? &stream->sim_context.substream_max : &stream->svc_context.spatial_max;
+		int *temporal_max = ps->simulcast ? &stream->sim_context.templayer_max : &stream->svc_context.temporal_max;
+		int current = (*layer_max == -1 ? 2 : *layer_max);
+		gboolean upgrade = (layer > current || (temporal == -1 && *temporal_max != -1));
+		if(layer == current && temporal == *temporal_max)
+			continue;
+		/* Downgrade right away, but wait a bit before upgrading again, to avoid oscillations */
+		if(upgrade && now - stream->layers_changed < 5*G_USEC_PER_SEC)
+			continue;
+		JANUS_LOG(LOG_VERB, "[%s-%p] Capping layers for subscriber stream #%d (%"SCNu32" bps available): %d/%d --> %d/%d\n",
+			JANUS_VIDEOROOM_PACKAGE, handle, stream->mindex, budget, *layer_max, *temporal_max, layer, temporal);
+		*layer_max = layer;
+		*temporal_max = temporal;
+		stream->layers_changed = now;
+	}
+	janus_mutex_unlock(&subscriber->streams_mutex);
+	janus_refcount_decrease(&subscriber->ref);
+	janus_refcount_decrease(&session->ref);
+}
+
 static void janus_videoroom_recorder_create(janus_videoroom_publisher_stream *ps) {
 	char filename[255];
 	janus_recorder *rc = NULL;
@@ -9816,7 +10216,7 @@ static void *janus_videoroom_handler(void *data) {
 				janus_mutex_init(&publisher->mutex);
 				janus_refcount_init(&publisher->ref, janus_videoroom_publisher_free);
 				/* In case we also wanted to configure */
-				if(audiocodec && json_string_value(json_object_get(msg->jsep, "sdp")) != NULL) {
+				if(audiocodec && janus_videoroom_message_has_sdp(msg)) {
 					janus_audiocodec acodec = janus_audiocodec_from_name(json_string_value(audiocodec));
 					if(acodec == JANUS_AUDIOCODEC_NONE ||
 							(acodec != publisher->room->acodec[0] &&
@@ -9838,7 +10238,7 @@ static void *janus_videoroom_handler(void *data) {
 						json_string_value(audiocodec), publisher->room_id_str, publisher->user_id_str);
 					publisher->acodec = acodec;
 				}
-				if(videocodec && json_string_value(json_object_get(msg->jsep, "sdp")) != NULL) {
+				if(videocodec && janus_videoroom_message_has_sdp(msg)) {
 					/* The publisher would like to use a video codec in particular */
 					janus_videocodec vcodec = janus_videocodec_from_name(json_string_value(videocodec));
 					if(vcodec == JANUS_VIDEOCODEC_NONE ||
@@ -10082,7 +10482,7 @@ static void *janus_videoroom_handler(void *data) {
 					continue;
 				}
 				/* Make sure there's no SDP attached here */
-				if(json_string_value(json_object_get(msg->jsep, "sdp")) != NULL) {
+				if(janus_videoroom_message_has_sdp(msg)) {
 					JANUS_LOG(LOG_ERR, "Can't send an offer to create subscribers\n");
 					error_code = JANUS_VIDEOROOM_ERROR_INVALID_REQUEST;
 					g_snprintf(error_cause, 512, "Can't send an offer to create subscribers");
@@ -10875,7 +11275,7 @@ static void *janus_videoroom_handler(void *data) {
 					do_update = FALSE;
 				}
 				/* Check if there's an SDP to take into account */
-				if(json_string_value(json_object_get(msg->jsep, "sdp"))) {
+				if(janus_videoroom_message_has_sdp(msg)) {
 					if(audiocodec) {
 						/* The participant would like to use an audio codec in particular */
 						janus_audiocodec acodec = janus_audiocodec_from_name(json_string_value(audiocodec));
@@ -11112,7 +11512,7 @@ static void *janus_videoroom_handler(void *data) {
 					janus_mutex_unlock(&participant->room->mutex);
 				}
 				/* Are we updating the description? */
-				if(descriptions != NULL && json_array_size(descriptions) > 0 && json_string_value(json_object_get(msg->jsep, "sdp")) == NULL) {
+				if(descriptions != NULL && json_array_size(descriptions) > 0 && !janus_videoroom_message_has_sdp(msg)) {
 					/* We only do this here if this is an SDP-less configure: in case
 					 * a renegotiation is involved, descriptions are updated later */
 					gboolean desc_updated = FALSE;
@@ -12607,14 +13007,14 @@ static void *janus_videoroom_handler(void *data) {
 		json_t *msg_simulcast = json_object_get(msg->jsep, "simulcast");
 		json_t *msg_svc = json_object_get(msg->jsep, "svc");
 		gboolean e2ee = json_is_true(json_object_get(msg->jsep, "e2ee"));
-		if(!msg_sdp) {
+		if(!msg_sdp && msg->sdp == NULL) {
 			/* No SDP to send */
 			int ret = gateway->push_event(msg->handle, &janus_videoroom_plugin, msg->transaction, event, NULL);
 			JANUS_LOG(LOG_VERB, "  >> %d (%s)\n", ret, janus_get_api_error(ret));
 			json_decref(event);
 		} else {
 			/* Generate offer or answer */
-			JANUS_LOG(LOG_VERB, "This is involving a negotiation (%s) as well:\n%s\n", msg_sdp_type, msg_sdp);
+			JANUS_LOG(LOG_VERB, "This is involving a negotiation (%s) as well:\n%s\n", msg_sdp_type, msg_sdp ? msg_sdp : "(parsed)");
 			if(sdp_update) {
 				/* Renegotiation: make sure the user provided an offer, and send answer */
 				JANUS_LOG(LOG_VERB, "  -- Updating existing publisher\n");
@@ -12645,8 +13045,11 @@ static void *janus_videoroom_handler(void *data) {
 				janus_mutex_lock(&subscriber->streams_mutex);
 				/* Mark all streams that were answered to as ready */
 				char error_str[512];
-				janus_sdp *answer = janus_sdp_parse(msg_sdp, error_str, sizeof(error_str));
-				GList *temp = answer->m_lines;
+				janus_sdp *answer = msg->sdp;
+				msg->sdp = NULL;
+				if(answer == NULL)
+					answer = janus_sdp_parse(msg_sdp, error_str, sizeof(error_str));
+				GList *temp = answer ? answer->m_lines : NULL;
 				while(temp) {
 					janus_sdp_mline *m = (janus_sdp_mline *)temp->data;
 					if(m->direction != JANUS_SDP_INACTIVE) {
@@ -12771,12 +13174,19 @@ static void *janus_videoroom_handler(void *data) {
 					goto error;
 				}
 				/* Now prepare the SDP to give back */
-				if(strstr(msg_sdp, "mozilla") || strstr(msg_sdp, "Mozilla")) {
+				if(msg_sdp && (strstr(msg_sdp, "mozilla") || strstr(msg_sdp, "Mozilla"))) {
 					participant->firefox = TRUE;
 				}
-				/* Start by parsing the offer */
+				/* Start by parsing the offer, unless the core did that for us already */
 				char error_str[512];
-				janus_sdp *offer = janus_sdp_parse(msg_sdp, error_str, sizeof(error_str));
+				error_str[0] = '\0';
+				gboolean parsed = (msg->sdp != NULL);
+				janus_sdp *offer = msg->sdp;
+				msg->sdp = NULL;
+				if(offer == NULL)
+					offer = janus_sdp_parse(msg_sdp, error_str, sizeof(error_str));
+				else if(offer->o_name && (strstr(offer->o_name, "mozilla") || strstr(offer->o_name, "Mozilla")))
+					participant->firefox = TRUE;
 				if(offer == NULL) {
 					janus_refcount_decrease(&videoroom->ref);
 					janus_refcount_decrease(&participant->ref);
@@ -13222,9 +13632,14 @@ static void *janus_videoroom_handler(void *data) {
 				char s_name[100];
 				g_snprintf(s_name, sizeof(s_name), "VideoRoom %s", videoroom->room_id_str);
 				answer->s_name = g_strdup(s_name);
-				/* Generate an SDP string we can send back to the publisher */
-				char *answer_sdp = janus_sdp_write(answer);
-				janus_sdp_destroy(answer);
+				/* Generate an SDP string we can send back to the publisher, unless
+				 * we got the offer parsed, in which case we pass the answer as it is */
+				char *answer_sdp = NULL;
+				if(!parsed) {
+					answer_sdp = janus_sdp_write(answer);
+					janus_sdp_destroy(answer);
+					answer = NULL;
+				}
 				/* For backwards compatibility, update the event with info on the codecs that we'll be handling
 				 * TODO This will make no sense in the future, as different streams may use different codecs */
 				if(event) {
@@ -13249,9 +13664,12 @@ static void *janus_videoroom_handler(void *data) {
 				}
 				janus_mutex_unlock(&participant->rec_mutex);
 				/* Send the answer back to the publisher */
-				JANUS_LOG(LOG_VERB, "Handling publisher: turned this into an '%s':\n%s\n", type, answer_sdp);
-				json_t *jsep = json_pack("{ssss}", "type", type, "sdp", answer_sdp);
-				g_free(answer_sdp);
+				json_t *jsep = json_pack("{ss}", "type", type);
+				if(answer_sdp != NULL) {
+					JANUS_LOG(LOG_VERB, "Handling publisher: turned this into an '%s':\n%s\n", type, answer_sdp);
+					json_object_set_new(jsep, "sdp", json_string(answer_sdp));
+					g_free(answer_sdp);
+				}
 				if(e2ee)
 					participant->e2ee = TRUE;
 				if(participant->e2ee) {
@@ -13261,8 +13679,11 @@ static void *janus_videoroom_handler(void *data) {
 				/* How long will the Janus core take to push the event? */
 				g_atomic_int_set(&session->hangingup, 0);
 				gint64 start = janus_get_monotonic_time();
-				int res = gateway->push_event(msg->handle, &janus_videoroom_plugin, msg->transaction, event, jsep);
+				int res = answer ?
+					gateway->push_event_sdp(msg->handle, &janus_videoroom_plugin, msg->transaction, event, jsep, answer) :
+					gateway->push_event(msg->handle, &janus_videoroom_plugin, msg->transaction, event, jsep);
 				JANUS_LOG(LOG_VERB, "  >> Pushing event: %d (took %"SCNu64" us)\n", res, janus_get_monotonic_time()-start);
+				janus_sdp_destroy(answer);
 				/* If this is an update/renegotiation, notify participants about this */
 				if(sdp_update && g_atomic_int_get(&session->started)) {
 					/* Notify all other participants this publisher's media has changed */
@@ -13378,7 +13799,7 @@ static void janus_videoroom_relay_rtp_packet(gpointer data, gpointer user_data)
 			/* Send the packet */
 			if(gateway != NULL) {
 				janus_plugin_rtp rtp = { .mindex = stream->mindex, .video = packet->is_video, .buffer = (char *)packet->data, .length = packet->length,
-					.extensions = packet->extensions };
+					.extensions = packet->extensions, .shared = packet->shared };
 				if(stream->min_delay > -1 && stream->max_delay > -1) {
 					rtp.extensions.min_delay = stream->min_delay;
 					rtp.extensions.max_delay = stream->max_delay;
@@ -13445,7 +13866,7 @@ static void janus_videoroom_relay_rtp_packet(gpointer data, gpointer user_data)
 			/* Send the packet */
 			if(gateway != NULL) {
 				janus_plugin_rtp rtp = { .mindex = stream->mindex, .video = packet->is_video, .buffer = (char *)packet->data, .length = packet->length,
-					.extensions = packet->extensions };
+					.extensions = packet->extensions, .shared = packet->shared };
 				if(stream->min_delay > -1 && stream->max_delay > -1) {
 					rtp.extensions.min_delay = stream->min_delay;
 					rtp.extensions.max_delay = stream->max_delay;
@@ -13465,7 +13886,7 @@ static void janus_videoroom_relay_rtp_packet(gpointer data, gpointer user_data)
 			/* Send the packet */
 			if(gateway != NULL) {
 				janus_plugin_rtp rtp = { .mindex = stream->mindex, .video = packet->is_video, .buffer = (char *)packet->data, .length = packet->length,
-					.extensions = packet->extensions };
+					.extensions = packet->extensions, .shared = packet->shared };
 				if(stream->min_delay > -1 && stream->max_delay > -1) {
 					rtp.extensions.min_delay = stream->min_delay;
 					rtp.extensions.max_delay = stream->max_delay;
@@ -14210,6 +14631,10 @@ static void janus_videoroom_helper_rtpdata_packet(gpointer data, gpointer user_d
 	copy->svc_info = packet->svc_info;
 	copy->timestamp = packet->timestamp;
 	copy->seq_number = packet->seq_number;
+	if(packet->shared) {
+		janus_rtp_shared_packet_ref(packet->shared);
+		copy->shared = packet->shared;
+	}
 	g_async_queue_push(helper->queued_packets, copy);
 }
 
@@ -15,6 +15,7 @@
 
 #include "../apierror.h"
 #include "../debug.h"
+#include "../utils.h"
 
 /* Plugin results */
 janus_plugin_result *janus_plugin_result_new(janus_plugin_result_type type, const char *text, json_t *content) {
@@ -74,6 +75,7 @@ janus_plugin_rtp *janus_plugin_rtp_duplicate(janus_plugin_rtp *packet) {
 			p->length = packet->length;
 		}
 		p->extensions = packet->extensions;
+		p->shared = NULL;
 	}
 	return p;
 }
@@ -87,3 +89,101 @@ void janus_plugin_data_reset(janus_plugin_data *packet) {
 	if(packet)
 		memset(packet, 0, sizeof(janus_plugin_data));
 }
+
+/* Data messages shared by many PeerConnections */
+static void janus_plugin_data_stats_free(const janus_refcount *stats_ref) {
+	janus_plugin_data_stats *stats = janus_refcount_containerof(stats_ref, janus_plugin_data_stats, ref);
+	janus_mutex_destroy(&stats->mutex);
+	g_free(stats);
+}
+
+janus_plugin_data_stats *janus_plugin_data_stats_create(void) {
+	janus_plugin_data_stats *stats = g_malloc0(sizeof(janus_plugin_data_stats));
+	janus_mutex_init(&stats->mutex);
+	janus_refcount_init(&stats->ref, janus_plugin_data_stats_free);
+	return stats;
+}
+
+void janus_plugin_data_stats_destroy(janus_plugin_data_stats *stats) {
+	if(stats)
+		janus_refcount_decrease(&stats->ref);
+}
+
+static int janus_plugin_data_stats_compare(const void *a, const void *b) {
+	guint32 la = *(const guint32 *)a, lb = *(const guint32 *)b;
+	return (la > lb) - (la < lb);
+}
+
+guint janus_plugin_data_stats_percentiles(janus_plugin_data_stats *stats, guint32 *p50, guint32 *p95, guint32 *p99) {
+	if(p50)
+		*p50 = 0;
+	if(p95)
+		*p95 = 0;
+	if(p99)
+		*p99 = 0;
+	if(stats == NULL)
+		return 0;
+	janus_mutex_lock(&stats->mutex);
+	guint count = stats->count;
+	if(count == 0) {
+		janus_mutex_unlock(&stats->mutex);
+		return 0;
+	}
+	guint32 *latencies = g_malloc(count * sizeof(guint32));
+	memcpy(latencies, stats->latencies, count * sizeof(guint32));
+	janus_mutex_unlock(&stats->mutex);
+	qsort(latencies, count, sizeof(guint32), janus_plugin_data_stats_compare);
+	if(p50)
+		*p50 = latencies[(count - 1) * 50 / 100];
+	if(p95)
+		*p95 = latencies[(count - 1) * 95 / 100];
+	if(p99)
+		*p99 = latencies[(count - 1) * 99 / 100];
+	g_free(latencies);
+	return count;
+}
+
+static void janus_plugin_data_shared_free(const janus_refcount *shared_ref) {
+	janus_plugin_data_shared *shared = janus_refcount_containerof(shared_ref, janus_plugin_data_shared, ref);
+	janus_plugin_data_stats_destroy(shared->stats);
+	g_free(shared->buffer);
+	g_free(shared);
+}
+
+janus_plugin_data_shared *janus_plugin_data_shared_create(const char *buf, uint16_t len, janus_plugin_data_stats *stats) {
+	if(buf == NULL || len == 0)
+		return NULL;
+	janus_plugin_data_shared *shared = g_malloc(sizeof(janus_plugin_data_shared));
+	shared->buffer = g_malloc(len);
+	memcpy(shared->buffer, buf, len);
+	shared->length = len;
+	shared->created = janus_get_monotonic_time();
+	shared->stats = stats;
+	if(stats)
+		janus_refcount_increase(&stats->ref);
+	janus_refcount_init(&shared->ref, janus_plugin_data_shared_free);
+	return shared;
+}
+
+void janus_plugin_data_shared_ref(janus_plugin_data_shared *shared) {
+	if(shared)
+		janus_refcount_increase(&shared->ref);
+}
+
+void janus_plugin_data_shared_unref(janus_plugin_data_shared *shared) {
+	if(shared)
+		janus_refcount_decrease(&shared->ref);
+}
+
+void janus_plugin_data_shared_sent(janus_plugin_data_shared *shared) {
+	if(shared == NULL || shared->stats == NULL)
+		return;
+	janus_plugin_data_stats *stats = shared->stats;
+	gint64 latency = janus_get_monotonic_time() - shared->created;
+	janus_mutex_lock(&stats->mutex);
+	stats->latencies[stats->index] = (guint32)(latency > 0 ? latency : 0);
+	stats->index = (stats->index + 1) % JANUS_PLUGIN_DATA_STATS_SAMPLES;
+	if(stats->count < JANUS_PLUGIN_DATA_STATS_SAMPLES)
+		stats->count++;
+	janus_mutex_unlock(&stats->mutex);
+}
@@ -18,6 +18,8 @@
  * the syntax of the message/event is completely up to you, the only
  * important thing is that it MUST be a JSON object, as it will be included
  * as such within the Janus session/handle protocol;
+ * - \c push_event_sdp(): same as \c push_event(), but with the SDP passed
+ * as a parsed janus_sdp instance, rather than as a string in the JSEP object;
  * - \c relay_rtp(): to send/relay the peer an RTP packet;
  * - \c relay_rtcp(): to send/relay the peer an RTCP message.
  * - \c relay_data(): to send/relay the peer a SCTP DataChannel message.
@@ -60,6 +62,7 @@ janus_plugin *create(void) {
  * - \c get_package(): this method should return a unique package identifier for your plugin (e.g., "janus.plugin.myplugin");
  * - \c create_session(): this method is called by the core to create a session between you and a peer;
  * - \c handle_message(): a callback to notify you the peer sent you a message/request;
+ * - \c handle_message_sdp(): same as \c handle_message(), but with the SDP passed as a parsed janus_sdp instance;
  * - \c handle_admin_message(): a callback to notify you a message/request came from the Admin API;
  * - \c setup_media(): a callback to notify you the peer PeerConnection is now ready to be used;
  * - \c incoming_rtp(): a callback to notify you a peer has sent you a RTP packet;
@@ -67,12 +70,14 @@ janus_plugin *create(void) {
  * - \c incoming_data(): a callback to notify you a peer has sent you a message on a SCTP DataChannel;
  * - \c data_ready(): a callback to notify you data can be sent on the SCTP DataChannel;
  * - \c slow_link(): a callback to notify you Janus or the peer have lost packets recently, and the media path may be slow;
+ * - \c estimated_bandwidth(): a callback to notify you how much Janus thinks it can send to the peer;
  * - \c hangup_media(): a callback to notify you the peer PeerConnection has been closed (e.g., after a DTLS alert);
  * - \c query_session(): this method is called by the core to get plugin-specific info on a session between you and a peer;
  * - \c destroy_session(): this method is called by the core to destroy a session between you and a peer.
  *
- * All the above methods and callbacks, except for \c incoming_rtp ,
- * \c incoming_rtcp , \c incoming_data and \c slow_link , are mandatory:
+ * All the above methods and callbacks, except for \c handle_message_sdp ,
+ * \c incoming_rtp , \c incoming_rtcp , \c incoming_data , \c slow_link and
+ * \c estimated_bandwidth , are mandatory:
  * the Janus core will reject a plugin that doesn't implement any of the
  * mandatory callbacks. The previously mentioned ones, instead, are
  * optional, so you're free to implement only those you care about. If
@@ -80,9 +85,9 @@ janus_plugin *create(void) {
  * sense to not implement the \c incoming_data callback at all. At the
  * same time, if your plugin is ONLY going to use data channels and
  * can't care less about RTP or RTCP, \c incoming_rtp and \c incoming_rtcp
- * can be left out. Finally, \c slow_link is just there as a helper, some
- * additional information you may be interested about, but you're not
- * forced to receive it if you don't care.
+ * can be left out. Finally, \c slow_link and \c estimated_bandwidth are
+ * just there as a helper, some additional information you may be interested
+ * about, but you're not forced to receive it if you don't care.
  *
  * The Janus core \c janus_callbacks interface is provided to a plugin, together
  * with the path to the configurations files folder, in the \c init() method.
@@ -138,6 +143,22 @@ janus_plugin *create(void) {
  * SDP-provided information (e.g., payload types, increasing versions in
  * case of renegotiations) coherently.
  *
+ * Since the core needs to parse, validate and anonymize an SDP before
+ * passing it to a plugin, and most plugins parse it again with
+ * janus_sdp_parse() only to generate an answer with janus_sdp_generate_answer()
+ * and serialize it with janus_sdp_write(), which the core then parses once
+ * more, plugins can choose to skip those text round-trips. Plugins that
+ * implement \c handle_message_sdp() will have it invoked instead of
+ * \c handle_message() whenever a JSEP offer or answer is attached to a
+ * message: the JSEP object will still contain the \c type and all other
+ * properties, but not the \c sdp string, which will be passed as a
+ * janus_sdp instance instead. Likewise, plugins can use \c push_event_sdp()
+ * to pass their own offer or answer as a janus_sdp instance: in that case,
+ * the JSEP object must only contain the \c type (plus \c restart and \c e2ee,
+ * if needed). Both are optional, and can be mixed freely with the text
+ * based methods, e.g., to keep on using \c push_event() when sending a
+ * static SDP.
+ *
  * \todo Right now plugins can only interact with peers through the Janus core.
  * Besides, a single PeerConnection can at the moment be used by only one
  * plugin, as that plugin is actually the "owner" of the PeerConnection itself.
@@ -171,7 +192,7 @@ janus_plugin *create(void) {
  * Janus instance or it will crash.
  *
  */
-#define JANUS_PLUGIN_API_VERSION	106
+#define JANUS_PLUGIN_API_VERSION	111
 
 /*! \brief Initialization of all plugin properties to NULL
  *
@@ -201,6 +222,7 @@ static janus_plugin janus_echotest_plugin =
 		.get_package = NULL,			\
 		.create_session = NULL,			\
 		.handle_message = NULL,			\
+		.handle_message_sdp = NULL,		\
 		.handle_admin_message = NULL,	\
 		.setup_media = NULL,			\
 		.incoming_rtp = NULL,			\
@@ -208,6 +230,7 @@ static janus_plugin janus_echotest_plugin =
 		.incoming_data = NULL,			\
 		.data_ready = NULL,				\
 		.slow_link = NULL,				\
+		.estimated_bandwidth = NULL,	\
 		.hangup_media = NULL,			\
 		.destroy_session = NULL,		\
 		.query_session = NULL, 			\
@@ -234,6 +257,8 @@ typedef struct janus_plugin_data janus_plugin_data;
 
 /* Use forward declaration to avoid including jansson.h */
 typedef struct json_t json_t;
+/* Use forward declaration to avoid including sdp-utils.h */
+typedef struct janus_sdp janus_sdp;
 
 /*! \brief Plugin-Gateway session mapping */
 struct janus_plugin_session {
@@ -294,6 +319,21 @@ struct janus_plugin {
 	 * @returns A janus_plugin_result instance that may contain a response (for immediate/synchronous replies), an ack
 	 * (for asynchronously managed requests) or an error */
 	struct janus_plugin_result * (* const handle_message)(janus_plugin_session *handle, char *transaction, json_t *message, json_t *jsep);
+	/*! \brief Method to handle an incoming message/request from a peer, with the SDP already parsed
+	 * \details If a plugin implements this method, the core invokes it instead of
+	 * \c handle_message whenever the peer attached a JSEP offer or answer
+	 * to the message, which saves the core the serialization of the SDP, and
+	 * the plugin its parsing. Messages with no JSEP are still passed to \c handle_message.
+	 * @note Besides what \c handle_message expects, plugins also get ownership of
+	 * the \c sdp object, which they'll have to release with \c janus_sdp_destroy when done
+	 * @param[in] handle The plugin/gateway session used for this peer
+	 * @param[in] transaction The transaction identifier for this message/request
+	 * @param[in] message The json_t object containing the message/request JSON
+	 * @param[in] jsep The json_t object containing the JSEP type and any other property, but not the SDP itself
+	 * @param[in] sdp The parsed and anonymized SDP the peer sent
+	 * @returns A janus_plugin_result instance that may contain a response (for immediate/synchronous replies), an ack
+	 * (for asynchronously managed requests) or an error */
+	struct janus_plugin_result * (* const handle_message_sdp)(janus_plugin_session *handle, char *transaction, json_t *message, json_t *jsep, janus_sdp *sdp);
 	/*! \brief Method to handle an incoming Admin API message/request
 	 * @param[in] message The json_t object containing the message/request JSON
 	 * @returns A json_t instance containing the response */
@@ -339,6 +379,19 @@ struct janus_plugin {
 	 * @param[in] uplink Whether this is related to the uplink (Janus to peer)
 	 * or downlink (peer to Janus) */
 	void (* const slow_link)(janus_plugin_session *handle, int mindex, gboolean video, gboolean uplink);
+	/*! \brief Callback to be notified about the bandwidth Janus estimates it can send to a peer
+	 * \details The estimate is computed by the core out of the transport-wide
+	 * CC feedback the peer sends for the packets we send it, and so is only
+	 * available when the transport-wide CC extension was negotiated for video.
+	 * Plugins can use it to decide what to send, e.g., which simulcast substream
+	 * or SVC layer to relay, without waiting for the peer to ask. The callback
+	 * is invoked right away when the estimate decreases noticeably (e.g., when
+	 * congestion is detected), and at most once per second otherwise.
+	 * @note This callback is invoked from the loop thread of the handle: don't
+	 * do anything blocking or expensive in it.
+	 * @param[in] handle The plugin/gateway session used for this peer
+	 * @param[in] estimate The estimated bandwidth, in bits per second */
+	void (* const estimated_bandwidth)(janus_plugin_session *handle, uint32_t estimate);
 	/*! \brief Callback to be notified about DTLS alerts from a peer (i.e., the PeerConnection is not valid any more)
 	 * @param[in] handle The plugin/gateway session used for this peer */
 	void (* const hangup_media)(janus_plugin_session *handle);
@@ -367,6 +420,21 @@ struct janus_callbacks {
 	 * @param[in] message The json_t object containing the JSON message
 	 * @param[in] jsep The json_t object containing the JSEP type, the SDP attached to the message/event, if any (offer/answer), and whether this is an update */
 	int (* const push_event)(janus_plugin_session *handle, janus_plugin *plugin, const char *transaction, json_t *message, json_t *jsep);
+	/*! \brief Callback to push events/messages to a peer, with a parsed SDP attached
+	 * \details Same as \c push_event, but the SDP is passed as a janus_sdp instance,
+	 * which spares the core from having to parse it again before enriching it
+	 * @note As with \c push_event, the core increases the references to \c message,
+	 * \c jsep and \c sdp, so you'll have to release your own references when done.
+	 * Notice that the core will modify the \c sdp object (e.g., to remove attributes
+	 * it doesn't support), so don't pass objects you're going to reuse afterwards
+	 * (e.g., a template for offers you send to many peers): use \c push_event for those
+	 * @param[in] handle The plugin/gateway session used for this peer
+	 * @param[in] plugin The plugin instance that is sending the message/event
+	 * @param[in] transaction The transaction identifier this message refers to
+	 * @param[in] message The json_t object containing the JSON message
+	 * @param[in] jsep The json_t object containing the JSEP type, and optionally whether an ICE restart is needed and if media is end-to-end encrypted
+	 * @param[in] sdp The Janus SDP object to attach to the message/event */
+	int (* const push_event_sdp)(janus_plugin_session *handle, janus_plugin *plugin, const char *transaction, json_t *message, json_t *jsep, janus_sdp *sdp);
 
 	/*! \brief Callback to relay RTP packets to a peer
 	 * @param[in] handle The plugin/gateway session used for this peer
@@ -543,7 +611,11 @@ void janus_plugin_result_destroy(janus_plugin_result *result);
  * The janus_plugin_rtcp, instead, represents an RTCP packet, which may
  * contain one or more RTCP compound messages. The only info it contains
  * are whether it's related to the audio or video stream, and a pointer
- * to the data itself and its length. When creating a new packet, it should
+ * to the data itself and its length. Incoming packets also come with the
+ * result of the validation the core performed on them, as a
+ * janus_rtcp_compound instance: checking its summary (e.g., whether
+ * there's a PLI, or the REMB bitrate) is cheaper than scanning the packet
+ * again with the methods in rtcp.h. When creating a new packet, it should
  * be initialized with janus_plugin_rtcp_init. To make the generation of
  * some of the most common RTCP messages easier, a few helper core
  * callbacks are provided: this means that, while you can craft RTCP
@@ -609,6 +681,12 @@ struct janus_plugin_rtp {
 	uint16_t length;
 	/*! \brief RTP extensions */
 	janus_plugin_rtp_extensions extensions;
+	/*! \brief Optional shared copy of the payload (see rtp.h), only used on
+	 * outgoing video packets: if set, PeerConnections that negotiated RFC4588
+	 * retransmissions will reference it for NACKs, rather than storing a copy
+	 * of their own; the plugin keeps ownership of its reference, and the core
+	 * adds its own as needed. It's ignored on incoming packets, where it's NULL */
+	struct janus_rtp_shared_packet *shared;
 };
 /*! \brief Helper method to initialise/reset the RTP packet
  * @note The main motivation for this method comes from the presence of the
@@ -639,12 +717,78 @@ struct janus_plugin_rtcp {
 	char *buffer;
 	/*! \brief The packet length */
 	uint16_t length;
+	/*! \brief The packet as parsed by the core (see rtcp.h), only available on
+	 * incoming packets: it's ignored on outgoing packets, where it can be NULL */
+	struct janus_rtcp_compound *compound;
 };
 /*! \brief Helper method to initialise/reset the RTCP packet
  * @param[in] packet Pointer to the janus_plugin_rtcp packet to reset
 */
 void janus_plugin_rtcp_reset(janus_plugin_rtcp *packet);
 
+/*! \brief Number of fan-out latency samples janus_plugin_data_stats keeps */
+#define JANUS_PLUGIN_DATA_STATS_SAMPLES	4096
+/*! \brief Fan-out statistics for data messages shared by many PeerConnections
+ * @note Plugins can use a single instance for a whole room, and pass it to
+ * all the janus_plugin_data_shared instances they create: the core then
+ * keeps track of how long each reference waited before being handed to
+ * the SCTP stack of its PeerConnection */
+typedef struct janus_plugin_data_stats {
+	/*! \brief Circular history of fan-out latencies, in microseconds */
+	guint32 latencies[JANUS_PLUGIN_DATA_STATS_SAMPLES];
+	/*! \brief Number of samples, and where the next one goes */
+	guint count, index;
+	/*! \brief Mutex to lock/unlock the samples */
+	janus_mutex mutex;
+	/*! \brief Atomic reference counter */
+	janus_refcount ref;
+} janus_plugin_data_stats;
+/*! \brief Helper method to create a new janus_plugin_data_stats instance
+ * @returns A pointer to a new janus_plugin_data_stats instance */
+janus_plugin_data_stats *janus_plugin_data_stats_create(void);
+/*! \brief Helper method to release a reference to a janus_plugin_data_stats instance
+ * @param[in] stats The janus_plugin_data_stats instance to release */
+void janus_plugin_data_stats_destroy(janus_plugin_data_stats *stats);
+/*! \brief Helper method to compute percentiles of the recent fan-out latencies
+ * @param[in] stats The janus_plugin_data_stats instance to query
+ * @param[out] p50 The median latency, in microseconds
+ * @param[out] p95 The 95th percentile of the latency, in microseconds
+ * @param[out] p99 The 99th percentile of the latency, in microseconds
+ * @returns The number of samples the percentiles were computed on */
+guint janus_plugin_data_stats_percentiles(janus_plugin_data_stats *stats, guint32 *p50, guint32 *p95, guint32 *p99);
+
+/*! \brief Refcounted, immutable copy of a data message, that plugins can
+ * create once and attach to what they relay to many PeerConnections, so
+ * that the core references it rather than copying it for each of them */
+typedef struct janus_plugin_data_shared {
+	/*! \brief Copy of the message */
+	char *buffer;
+	/*! \brief Length of the message */
+	uint16_t length;
+	/*! \brief When the shared copy was created (monotonic time) */
+	gint64 created;
+	/*! \brief Stats to update, if any */
+	janus_plugin_data_stats *stats;
+	/*! \brief Atomic reference counter */
+	janus_refcount ref;
+} janus_plugin_data_shared;
+/*! \brief Helper method to create a shared copy of a data message
+ * @note The new instance has a single reference, owned by the caller
+ * @param[in] buf The message
+ * @param[in] len The message length
+ * @param[in] stats The janus_plugin_data_stats instance to update, if any
+ * @returns A pointer to a new janus_plugin_data_shared instance, or NULL if the message is empty */
+janus_plugin_data_shared *janus_plugin_data_shared_create(const char *buf, uint16_t len, janus_plugin_data_stats *stats);
+/*! \brief Helper method to add a reference to a janus_plugin_data_shared instance
+ * @param[in] shared The janus_plugin_data_shared instance to reference */
+void janus_plugin_data_shared_ref(janus_plugin_data_shared *shared);
+/*! \brief Helper method to release a reference to a janus_plugin_data_shared instance
+ * @param[in] shared The janus_plugin_data_shared instance to release */
+void janus_plugin_data_shared_unref(janus_plugin_data_shared *shared);
+/*! \brief Helper method the core uses to account for a reference that was handed to the SCTP stack
+ * @param[in] shared The janus_plugin_data_shared instance that was sent */
+void janus_plugin_data_shared_sent(janus_plugin_data_shared *shared);
+
 /*! \brief Janus plugin data message
  * @note At the moment, we only support text based datachannels. In the
  * future, once we add support for binary data, this structure may be
@@ -660,6 +804,11 @@ struct janus_plugin_data {
 	char *buffer;
 	/*! \brief The message length */
 	uint16_t length;
+	/*! \brief Optional shared copy of the message, only used on outgoing
+	 * messages: if set (and as long as \c buffer has the same length), the
+	 * core references it rather than copying \c buffer; the plugin keeps
+	 * ownership of its reference, and the core adds its own as needed */
+	struct janus_plugin_data_shared *shared;
 };
 /*! \brief Helper method to initialise/reset the data message
  * @param[in] packet Pointer to the janus_plugin_data message to reset
@@ -234,109 +234,122 @@ static void janus_rtcp_incoming_sr(janus_rtcp_context *ctx, janus_rtcp_sr *sr) {
 	ctx->lsr = (ntp >> 16);
 }
 
-/* Helper to handle an incoming transport-cc feedback: triggered by a call to janus_rtcp_fix_ssrc a valid context pointer */
-static void janus_rtcp_incoming_transport_cc(janus_rtcp_context *ctx, janus_rtcp_fb *twcc, int total) {
-	if(ctx == NULL || twcc == NULL || total < 20)
-		return;
-	if(!janus_rtcp_check_fci((janus_rtcp_header *)twcc, total, 4))
-		return;
+/* Parse a transport-cc feedback, invoking the callback for each packet it reports on */
+int janus_rtcp_transport_wide_cc_parse(char *packet, int len, janus_rtcp_transport_wide_cc_cb cb, void *user_data) {
+	if(packet == NULL || len < 20)
+		return -1;
+	janus_rtcp_header *rtcp = (janus_rtcp_header *)packet;
+	if(!janus_rtcp_check_fci(rtcp, len, 4))
+		return -1;
+	/* Don't look past the end of this message, in case it's part of a compound packet */
+	int total = 4*(int)ntohs(rtcp->length) + 4;
+	if(total > len)
+		total = len;
 	/* Parse the header first */
+	janus_rtcp_fb *twcc = (janus_rtcp_fb *)packet;
 	uint8_t *data = (uint8_t *)twcc->fci;
 	uint16_t base_seq = 0, status_count = 0;
 	uint32_t reference = 0;
-	uint8_t fb_pkt = 0;
 	memcpy(&base_seq, data, sizeof(uint16_t));
 	base_seq = ntohs(base_seq);
 	memcpy(&status_count, data+2, sizeof(uint16_t));
 	status_count = ntohs(status_count);
 	memcpy(&reference, data+4, sizeof(uint32_t));
-	reference = ntohl(reference) >> 8;
-	fb_pkt = *(data+7);
-	JANUS_LOG(LOG_HUGE, "[TWCC] seq=%"SCNu16", psc=%"SCNu16", ref=%"SCNu32", fbpc=%"SCNu8"\n",
-		base_seq, status_count, reference, fb_pkt);
-	/* Now traverse the feedback: packet chunks first, and then recv deltas */
+	/* The reference time is a signed 24 bits integer, in multiples of 64ms */
+	int32_t reference_time = (int32_t)ntohl(reference) >> 8;
+	JANUS_LOG(LOG_HUGE, "[TWCC] seq=%"SCNu16", psc=%"SCNu16", ref=%"SCNi32", fbpc=%"SCNu8"\n",
+		base_seq, status_count, reference_time, *(data+7));
 	total -= 20;
 	data += 8;
-	uint16_t psc = status_count;
-	uint16_t chunk = 0;
-	uint8_t t = 0, ss = 0, s = 0, length = 0;
-	/* Iterate on all packet chunks */
-	JANUS_LOG(LOG_HUGE, "[TWCC] Chunks:\n");
-	uint16_t num = 0;
-	GList *list = NULL;
-	while(psc > 0 && total > 1) {
-		num++;
-		memcpy(&chunk, data, sizeof(uint16_t));
+	/* The recv deltas follow the packet chunks: find out where they start first,
+	 * so that we can then go through both at the same time with no allocation */
+	uint8_t *chunks = data;
+	int chunks_len = 0;
+	uint16_t psc = status_count, chunk = 0, length = 0;
+	while(psc > 0) {
+		if(total - chunks_len < 2)
+			return -1;	/* Incomplete feedback */
+		memcpy(&chunk, chunks + chunks_len, sizeof(uint16_t));
+		chunk = ntohs(chunk);
+		if(!(chunk & 0x8000))
+			length = (chunk & 0x1FFF);		/* Run length */
+		else
+			length = (chunk & 0x4000) ? 7 : 14;	/* Status vector */
+		psc -= (length < psc ? length : psc);
+		chunks_len += 2;
+	}
+	uint8_t *deltas = chunks + chunks_len;
+	int deltas_len = total - chunks_len;
+	/* Now go through the packet chunks again, and match them with their recv deltas */
+	int64_t arrival = (int64_t)reference_time * 64000;
+	uint16_t seq = base_seq;
+	uint8_t t = 0, ss = 0, s = 0;
+	int ci = 0, reported = 0;
+	psc = status_count;
+	while(psc > 0 && ci < chunks_len) {
+		memcpy(&chunk, chunks + ci, sizeof(uint16_t));
 		chunk = ntohs(chunk);
+		ci += 2;
 		t = (chunk & 0x8000) >> 15;
 		if(t == 0) {
-			/* Run length */
 			s = (chunk & 0x6000) >> 13;
 			length = (chunk & 0x1FFF);
-			JANUS_LOG(LOG_HUGE, "  [%"SCNu16"] t=run-length, s=%s, l=%"SCNu8"\n", num,
+			JANUS_LOG(LOG_HUGE, "[TWCC] t=run-length, s=%s, l=%"SCNu16"\n",
 				janus_rtp_packet_status_description(s), length);
-			while(length > 0 && psc > 0) {
-				list = g_list_prepend(list, GUINT_TO_POINTER(s));
-				length--;
-				psc--;
-			}
 		} else {
-			/* Status vector */
 			ss = (chunk & 0x4000) >> 14;
 			length = (ss ? 7 : 14);
-			JANUS_LOG(LOG_HUGE, "  [%"SCNu16"] t=status-vector, ss=%ss, l=%"SCNu8"\n", num,
+			JANUS_LOG(LOG_HUGE, "[TWCC] t=status-vector, ss=%s, l=%"SCNu16"\n",
 				ss ? "2-bit" : "bit", length);
-			while(length > 0 && psc > 0) {
+		}
+		uint16_t i = 0;
+		for(i=0; i<length && psc > 0; i++) {
+			if(t == 1) {
 				if(!ss)
-					s = (chunk & (1 << (length-1))) ? janus_rtp_packet_status_smalldelta : janus_rtp_packet_status_notreceived;
+					s = (chunk & (1 << (length-i-1))) ? janus_rtp_packet_status_smalldelta : janus_rtp_packet_status_notreceived;
 				else
-					s = (chunk & (3 << (2*length-2))) >> (2*length-2);
-				list = g_list_prepend(list, GUINT_TO_POINTER(s));
-				length--;
-				psc--;
+					s = (chunk >> (2*(length-i-1))) & 0x03;
+			}
+			gboolean received = FALSE;
+			if(s == janus_rtp_packet_status_smalldelta) {
+				/* Small delta = 1 byte */
+				if(deltas_len < 1)
+					return reported;
+				arrival += (int64_t)(*deltas) * 250;
+				deltas++;
+				deltas_len--;
+				received = TRUE;
+			} else if(s == janus_rtp_packet_status_largeornegativedelta) {
+				/* Large or negative delta = 2 bytes, signed */
+				if(deltas_len < 2)
+					return reported;
+				int16_t delta = 0;
+				memcpy(&delta, deltas, sizeof(int16_t));
+				arrival += (int64_t)((int16_t)ntohs(delta)) * 250;
+				deltas += 2;
+				deltas_len -= 2;
+				received = TRUE;
 			}
+			if(cb != NULL)
+				cb(seq, received, received ? arrival : 0, user_data);
+			reported++;
+			seq++;
+			psc--;
 		}
-		total -= 2;
-		data += 2;
 	}
-	if(psc > 0) {
-		/* Incomplete feedback? Drop... */
-		g_list_free(list);
+	return reported;
+}
+
+/* Helper to handle an incoming transport-cc feedback: triggered by a call to janus_rtcp_fix_ssrc a valid context pointer */
+static void janus_rtcp_incoming_transport_cc_packet(guint16 seq, gboolean received, gint64 arrival, void *user_data) {
+	JANUS_LOG(LOG_HUGE, "  [%"SCNu16"] %s (%"SCNi64"us)\n", seq, received ? "received" : "notreceived", arrival);
+}
+static void janus_rtcp_incoming_transport_cc(janus_rtcp_context *ctx, janus_rtcp_fb *twcc, int total) {
+	if(ctx == NULL || twcc == NULL || total < 20)
 		return;
-	}
-	list = g_list_reverse(list);
-	/* Iterate on all recv deltas */
-	JANUS_LOG(LOG_HUGE, "[TWCC] Recv Deltas (%d/%"SCNu16"):\n", g_list_length(list), status_count);
-	num = 0;
-	uint16_t delta = 0;
-	uint32_t delta_us = 0;
-	GList *iter = list;
-	while(iter != NULL && total > 0) {
-		num++;
-		delta = 0;
-		s = GPOINTER_TO_UINT(iter->data);
-		if(s == janus_rtp_packet_status_smalldelta) {
-			/* Small delta = 1 byte */
-			delta = *data;
-			total--;
-			data++;
-		} else if(s == janus_rtp_packet_status_largeornegativedelta) {
-			/* Large or negative delta = 2 bytes */
-			if(total < 2)
-				break;
-			memcpy(&delta, data, sizeof(uint16_t));
-			delta = ntohs(delta);
-			total -= 2;
-			data += 2;
-		}
-		delta_us = delta*250;
-		/* Print summary */
-		JANUS_LOG(LOG_HUGE, "  [%02"SCNu16"][%"SCNu16"] %s (%"SCNu32"us)\n", num, (uint16_t)(base_seq+num-1),
-			janus_rtp_packet_status_description(s), delta_us);
-		iter = iter->next;
-	}
-	/* TODO Update the context with the feedback we got */
-	g_list_free(list);
+	/* TODO Update the context with the feedback we got: at the moment it's
+	 * only used by the bandwidth estimator, which the core feeds separately */
+	janus_rtcp_transport_wide_cc_parse((char *)twcc, total, janus_rtcp_incoming_transport_cc_packet, NULL);
 }
 
 /* Link quality estimate filter coefficient */
@@ -767,12 +780,323 @@ int janus_rtcp_fix_ssrc(janus_rtcp_context *ctx, char *packet, int len, int fixs
 	return 0;
 }
 
+const char *janus_rtcp_block_type_str(janus_rtcp_block_type type) {
+	switch(type) {
+		case JANUS_RTCP_BLOCK_SR: return "SR";
+		case JANUS_RTCP_BLOCK_RR: return "RR";
+		case JANUS_RTCP_BLOCK_SDES: return "SDES";
+		case JANUS_RTCP_BLOCK_BYE: return "BYE";
+		case JANUS_RTCP_BLOCK_APP: return "APP";
+		case JANUS_RTCP_BLOCK_NACK: return "NACK";
+		case JANUS_RTCP_BLOCK_TMMBR: return "TMMBR";
+		case JANUS_RTCP_BLOCK_TWCC: return "TWCC";
+		case JANUS_RTCP_BLOCK_PLI: return "PLI";
+		case JANUS_RTCP_BLOCK_FIR: return "FIR";
+		case JANUS_RTCP_BLOCK_REMB: return "REMB";
+		case JANUS_RTCP_BLOCK_XR: return "XR";
+		case JANUS_RTCP_BLOCK_OTHER:
+		default:
+			break;
+	}
+	return "other";
+}
+
+/* Helper to validate a single message in a compound packet, and describe it in a block */
+static int janus_rtcp_block_parse(char *packet, janus_rtcp_header *rtcp, int bytes, janus_rtcp_block *block) {
+	memset(block, 0, sizeof(*block));
+	block->type = JANUS_RTCP_BLOCK_OTHER;
+	block->offset = (char *)rtcp - packet;
+	block->length = bytes;
+	int length = ntohs(rtcp->length);
+	janus_rtcp_fb *rtcpfb = (janus_rtcp_fb *)rtcp;
+	switch(rtcp->type) {
+		case RTCP_SR: {
+			if(!janus_rtcp_check_sr(rtcp, bytes))
+				return -2;
+			janus_rtcp_sr *sr = (janus_rtcp_sr *)rtcp;
+			block->type = JANUS_RTCP_BLOCK_SR;
+			block->ssrc = ntohl(sr->ssrc);
+			block->count = rtcp->rc;
+			if(rtcp->rc > 0)
+				block->media = ntohl(sr->rb[0].ssrc);
+			break;
+		}
+		case RTCP_RR: {
+			if(!janus_rtcp_check_rr(rtcp, bytes))
+				return -2;
+			janus_rtcp_rr *rr = (janus_rtcp_rr *)rtcp;
+			block->type = JANUS_RTCP_BLOCK_RR;
+			block->ssrc = ntohl(rr->ssrc);
+			block->count = rtcp->rc;
+			if(rtcp->rc > 0)
+				block->media = ntohl(rr->rb[0].ssrc);
+			break;
+		}
+		case RTCP_SDES: {
+			block->type = JANUS_RTCP_BLOCK_SDES;
+			if(bytes >= 8)
+				block->ssrc = ntohl(((janus_rtcp_sdes *)rtcp)->chunk.ssrc);
+			break;
+		}
+		case RTCP_BYE: {
+			block->type = JANUS_RTCP_BLOCK_BYE;
+			if(rtcp->rc > 0 && bytes >= 8)
+				block->ssrc = ntohl(((janus_rtcp_bye *)rtcp)->ssrc[0]);
+			break;
+		}
+		case RTCP_APP: {
+			block->type = JANUS_RTCP_BLOCK_APP;
+			if(bytes >= 8)
+				block->ssrc = ntohl(((janus_rtcp_app *)rtcp)->ssrc);
+			break;
+		}
+		case RTCP_FIR: {
+			/* Legacy FIR, rfc2032 */
+			block->type = JANUS_RTCP_BLOCK_FIR;
+			break;
+		}
+		case RTCP_RTPFB: {
+			if(!janus_rtcp_check_fci(rtcp, bytes, 0))
+				return -2;
+			block->ssrc = ntohl(rtcpfb->ssrc);
+			block->media = ntohl(rtcpfb->media);
+			if(rtcp->rc == 1) {
+				/* NACK FCI size is 4 bytes */
+				if(!janus_rtcp_check_fci(rtcp, bytes, 4))
+					return -2;
+				block->type = JANUS_RTCP_BLOCK_NACK;
+				block->count = length-2;
+			} else if(rtcp->rc == 3) {
+				block->type = JANUS_RTCP_BLOCK_TMMBR;
+				block->count = (length-2)/2;
+			} else if(rtcp->rc == 15) {
+				block->type = JANUS_RTCP_BLOCK_TWCC;
+			}
+			break;
+		}
+		case RTCP_PSFB: {
+			if(!janus_rtcp_check_fci(rtcp, bytes, 0))
+				return -2;
+			block->ssrc = ntohl(rtcpfb->ssrc);
+			block->media = ntohl(rtcpfb->media);
+			if(rtcp->rc == 1) {
+				block->type = JANUS_RTCP_BLOCK_PLI;
+			} else if(rtcp->rc == 4) {
+				block->type = JANUS_RTCP_BLOCK_FIR;
+				block->count = (length-2)/2;
+			} else if(rtcp->rc == 15) {
+				janus_rtcp_fb_remb *remb = (janus_rtcp_fb_remb *)rtcpfb->fci;
+				if(janus_rtcp_check_remb(rtcp, bytes) && remb->id[0] == 'R' && remb->id[1] == 'E' && remb->id[2] == 'M' && remb->id[3] == 'B') {
+					/* FIXME From rtcp_utility.cc */
+					unsigned char *_ptrRTCPData = (unsigned char *)remb;
+					_ptrRTCPData += 4;	/* Skip unique identifier */
+					uint8_t brExp = (_ptrRTCPData[1] >> 2) & 0x3F;
+					uint32_t brMantissa = (_ptrRTCPData[1] & 0x03) << 16;
+					brMantissa += (_ptrRTCPData[2] << 8);
+					brMantissa += (_ptrRTCPData[3]);
+					block->type = JANUS_RTCP_BLOCK_REMB;
+					block->count = _ptrRTCPData[0];
+					block->bitrate = (uint64_t)brMantissa << brExp;
+				}
+			}
+			break;
+		}
+		case RTCP_XR: {
+			block->type = JANUS_RTCP_BLOCK_XR;
+			block->ssrc = ntohl(((janus_rtcp_xr *)rtcp)->ssrc);
+			break;
+		}
+		default:
+			break;
+	}
+	return 0;
+}
+
+int janus_rtcp_parse_compound(char *packet, int len, janus_rtcp_compound *compound) {
+	if(packet == NULL || len <= 0 || compound == NULL)
+		return -1;
+	memset(compound, 0, sizeof(*compound));
+	compound->length = len;
+	janus_rtcp_header *rtcp = (janus_rtcp_header *)packet;
+	int total = len;
+	while(rtcp) {
+		if(!janus_rtcp_check_len(rtcp, total))
+			return -2;
+		if(rtcp->version != 2)
+			return -2;
+		int length = ntohs(rtcp->length);
+		int bytes = length*4+4;
+		/* All the checks below refer to this message only, and not to the rest of the packet */
+		janus_rtcp_block block;
+		if(janus_rtcp_block_parse(packet, rtcp, bytes, &block) < 0)
+			return -2;
+		if(block.type == JANUS_RTCP_BLOCK_OTHER && rtcp->type != RTCP_RTPFB && rtcp->type != RTCP_PSFB)
+			JANUS_LOG(LOG_ERR, "     Unknown RTCP PT %d\n", rtcp->type);
+		JANUS_LOG(LOG_HUGE, "     #%d %s (PT %d, fmt %d, %d bytes)\n", compound->count+1,
+			janus_rtcp_block_type_str(block.type), rtcp->type, rtcp->rc, bytes);
+		/* Update the summary, which covers all messages, even those that don't fit in blocks */
+		if(block.type == JANUS_RTCP_BLOCK_BYE)
+			compound->has_bye = TRUE;
+		else if(block.type == JANUS_RTCP_BLOCK_PLI)
+			compound->has_pli = TRUE;
+		else if(block.type == JANUS_RTCP_BLOCK_FIR)
+			compound->has_fir = TRUE;
+		else if(block.type == JANUS_RTCP_BLOCK_REMB && compound->remb_bitrate == 0)
+			compound->remb_bitrate = block.bitrate;
+		else if(block.type == JANUS_RTCP_BLOCK_NACK) {
+			/* Count the sequence numbers this NACK refers to */
+			janus_rtcp_nack *nack = (janus_rtcp_nack *)((janus_rtcp_fb *)rtcp)->fci;
+			int i = 0;
+			for(i=0; i<block.count; i++) {
+				uint16_t blp = ntohs(nack[i].blp);
+				compound->nacks++;
+				while(blp) {
+					compound->nacks++;
+					blp &= blp-1;
+				}
+			}
+		}
+		/* Take note of the SSRCs we'd use to demultiplex this packet */
+		if(compound->sender_ssrc == 0 && (rtcp->type == RTCP_SR || rtcp->type == RTCP_RR ||
+				rtcp->type == RTCP_RTPFB || rtcp->type == RTCP_PSFB || rtcp->type == RTCP_XR))
+			compound->sender_ssrc = block.ssrc;
+		if(compound->receiver_ssrc == 0) {
+			if((block.type == JANUS_RTCP_BLOCK_SR || block.type == JANUS_RTCP_BLOCK_RR) && block.count > 0)
+				compound->receiver_ssrc = block.media;
+			else if(block.type == JANUS_RTCP_BLOCK_PLI ||
+					(rtcp->type == RTCP_RTPFB && janus_rtcp_check_fci(rtcp, bytes, 4)))
+				compound->receiver_ssrc = block.media;
+		}
+		if(compound->count < JANUS_RTCP_MAX_BLOCKS) {
+			compound->blocks[compound->count] = block;
+			compound->count++;
+		} else {
+			compound->truncated = TRUE;
+		}
+		/* Is this a compound packet? */
+		if(length == 0)
+			break;
+		total -= bytes;
+		if(total <= 0)
+			break;
+		rtcp = (janus_rtcp_header *)((uint32_t*)rtcp + length + 1);
+	}
+	return 0;
+}
+
+const janus_rtcp_block *janus_rtcp_compound_next(char *packet, janus_rtcp_compound *compound, janus_rtcp_compound_iter *iter) {
+	if(packet == NULL || compound == NULL || iter == NULL)
+		return NULL;
+	if(!compound->truncated) {
+		/* All the messages are in blocks already */
+		if(iter->index >= compound->count)
+			return NULL;
+		return &compound->blocks[iter->index++];
+	}
+	/* Some messages didn't fit in blocks, so walk the whole packet again: it was
+	 * validated when it was parsed, so we don't need to check it as thoroughly */
+	if(iter->index >= compound->length)
+		return NULL;
+	janus_rtcp_header *rtcp = (janus_rtcp_header *)(packet + iter->index);
+	int total = compound->length - iter->index;
+	if(!janus_rtcp_check_len(rtcp, total))
+		return NULL;
+	int length = ntohs(rtcp->length);
+	int bytes = length*4+4;
+	if(janus_rtcp_block_parse(packet, rtcp, bytes, &iter->block) < 0)
+		return NULL;
+	/* A zero length means there's nothing else we should look at */
+	iter->index = (length == 0) ? compound->length : iter->index + bytes;
+	return &iter->block;
+}
+
+void janus_rtcp_compound_update_context(janus_rtcp_context *ctx, char *packet, janus_rtcp_compound *compound) {
+	if(ctx == NULL || packet == NULL || compound == NULL)
+		return;
+	janus_rtcp_compound_iter iter = { 0 };
+	const janus_rtcp_block *block = NULL;
+	while((block = janus_rtcp_compound_next(packet, compound, &iter)) != NULL) {
+		if(block->type == JANUS_RTCP_BLOCK_SR)
+			janus_rtcp_incoming_sr(ctx, (janus_rtcp_sr *)(packet + block->offset));
+		else if(block->type == JANUS_RTCP_BLOCK_RR)
+			janus_rtcp_incoming_rr(ctx, (janus_rtcp_rr *)(packet + block->offset));
+		else if(block->type == JANUS_RTCP_BLOCK_TWCC)
+			janus_rtcp_incoming_transport_cc(ctx, (janus_rtcp_fb *)(packet + block->offset), block->length);
+	}
+}
+
+int janus_rtcp_compound_remove(char *packet, int len, janus_rtcp_compound *compound, janus_rtcp_block_type type) {
+	if(packet == NULL || len <= 0 || compound == NULL)
+		return len;
+	if(compound->truncated) {
+		/* Not all messages are in blocks: walk the whole packet, and then parse it
+		 * again, as the messages that didn't fit before may fit now */
+		int removed = 0, end = 0;
+		janus_rtcp_compound_iter iter = { 0 };
+		const janus_rtcp_block *block = NULL;
+		while((block = janus_rtcp_compound_next(packet, compound, &iter)) != NULL) {
+			end = block->offset + block->length;
+			if(block->type == type)
+				removed += block->length;
+			else if(removed > 0)
+				memmove(packet + block->offset - removed, packet + block->offset, block->length);
+		}
+		if(removed == 0)
+			return len;
+		if(end < len)
+			memmove(packet + end - removed, packet + end, len - end);
+		janus_rtcp_parse_compound(packet, len - removed, compound);
+		return len - removed;
+	}
+	int removed = 0, end = 0;
+	uint8_t i = 0, kept = 0;
+	for(i=0; i<compound->count; i++) {
+		janus_rtcp_block *block = &compound->blocks[i];
+		end = block->offset + block->length;
+		if(block->type == type) {
+			removed += block->length;
+			continue;
+		}
+		if(removed > 0) {
+			/* Move this message back, to fill the gap */
+			memmove(packet + block->offset - removed, packet + block->offset, block->length);
+			block->offset -= removed;
+		}
+		if(kept != i)
+			compound->blocks[kept] = *block;
+		kept++;
+	}
+	if(removed == 0)
+		return len;
+	/* Move whatever follows the messages we're tracking too, if anything */
+	if(end < len)
+		memmove(packet + end - removed, packet + end, len - end);
+	compound->count = kept;
+	compound->length = len - removed;
+	if(type == JANUS_RTCP_BLOCK_NACK)
+		compound->nacks = 0;
+	return len - removed;
+}
+
 char *janus_rtcp_filter(char *packet, int len, int *newlen) {
 	if(packet == NULL || len <= 0 || newlen == NULL)
 		return NULL;
 	*newlen = 0;
+	char *filtered = g_malloc0(len);
+	int res = janus_rtcp_filter_into(packet, len, filtered, len);
+	if(res <= 0) {
+		g_free(filtered);
+		return NULL;
+	}
+	*newlen = res;
+	return filtered;
+}
+
+int janus_rtcp_filter_into(char *packet, int len, char *filtered, int size) {
+	if(packet == NULL || len <= 0 || filtered == NULL || size <= 0)
+		return -1;
 	janus_rtcp_header *rtcp = (janus_rtcp_header *)packet;
-	char *filtered = NULL;
+	int newlen = 0;
 	int total = len, length = 0, bytes = 0;
 	/* Iterate on the compound packets */
 	gboolean keep = TRUE;
@@ -825,23 +1149,20 @@ char *janus_rtcp_filter(char *packet, int len, int *newlen) {
 				break;
 		}
 		if(keep) {
-			/* Keep this packet */
-			if(filtered == NULL)
-				filtered = g_malloc0(total);
-			memcpy(filtered+*newlen, (char *)rtcp, bytes);
-			*newlen += bytes;
+			/* Keep this packet, if there's room for it */
+			if(newlen + bytes > size)
+				break;
+			memcpy(filtered+newlen, (char *)rtcp, bytes);
+			newlen += bytes;
 		}
 		total -= bytes;
 		if(total <= 0)
 			break;
 		rtcp = (janus_rtcp_header *)((uint32_t*)rtcp + length + 1);
 	}
-	if (error) {
-		g_free(filtered);
-		filtered = NULL;
-		*newlen = 0;
-	}
-	return filtered;
+	if(error)
+		return -2;
+	return newlen;
 }
 
 
@@ -1591,9 +1912,75 @@ int janus_rtcp_nacks(char *packet, int len, GSList *nacks) {
 	return words*4+4;
 }
 
-int janus_rtcp_transport_wide_cc_feedback(char *packet, size_t size, guint32 ssrc, guint32 media, guint8 feedback_packet_count, GQueue *transport_wide_cc_stats) {
-	if(packet == NULL || size < sizeof(janus_rtcp_header) || transport_wide_cc_stats == NULL || g_queue_is_empty(transport_wide_cc_stats))
+janus_rtcp_transport_wide_cc_history *janus_rtcp_transport_wide_cc_history_create(guint32 size) {
+	/* Round the size to the next power of two, so that we can use a mask */
+	guint32 slots = 64;
+	while(slots < size && slots < 0x10000)
+		slots <<= 1;
+	janus_rtcp_transport_wide_cc_history *history = g_malloc0(sizeof(janus_rtcp_transport_wide_cc_history) +
+		slots * sizeof(janus_rtcp_transport_wide_cc_stats));
+	history->size = slots;
+	history->mask = slots - 1;
+	return history;
+}
+
+void janus_rtcp_transport_wide_cc_history_destroy(janus_rtcp_transport_wide_cc_history *history) {
+	g_free(history);
+}
+
+void janus_rtcp_transport_wide_cc_history_add(janus_rtcp_transport_wide_cc_history *history, guint32 transport_seq_num, guint64 timestamp) {
+	if(history == NULL)
+		return;
+	if(!history->started) {
+		/* First packet */
+		history->started = TRUE;
+		history->begin = transport_seq_num;
+		history->end = transport_seq_num + 1;
+	} else if((gint32)(transport_seq_num - history->begin) < 0) {
+		/* Out of order packet: if we sent feedback already, it was reported as lost */
+		if(history->reported || (history->end - transport_seq_num) > history->size)
+			return;
+		history->begin = transport_seq_num;
+	} else if((gint32)(transport_seq_num - history->end) >= 0) {
+		history->end = transport_seq_num + 1;
+		if(history->end - history->begin > history->size) {
+			/* We got more packets than we can track since the last feedback: forget the oldest ones */
+			history->begin = history->end - history->size;
+		}
+	}
+	janus_rtcp_transport_wide_cc_stats *stat = &history->packets[transport_seq_num & history->mask];
+	stat->transport_seq_num = transport_seq_num;
+	stat->timestamp = timestamp;
+}
+
+guint32 janus_rtcp_transport_wide_cc_history_pending(janus_rtcp_transport_wide_cc_history *history) {
+	if(history == NULL || !history->started)
+		return 0;
+	return history->end - history->begin;
+}
+
+int janus_rtcp_transport_wide_cc_feedback(char *packet, size_t size, guint32 ssrc, guint32 media, guint8 feedback_packet_count,
+		janus_rtcp_transport_wide_cc_history *history, guint max_packets) {
+	if(packet == NULL || size < sizeof(janus_rtcp_header) || history == NULL)
 		return -1;
+	guint32 packet_status_count = janus_rtcp_transport_wide_cc_history_pending(history);
+	if(packet_status_count == 0)
+		return 0;
+	if(max_packets == 0 || max_packets > JANUS_RTCP_TWCC_MAX_PACKETS)
+		max_packets = JANUS_RTCP_TWCC_MAX_PACKETS;
+	if(packet_status_count > max_packets)
+		packet_status_count = max_packets;
+	/* Make sure the worst case fits in the buffer: a large delta per packet, and
+	 * a chunk every 7 packets (the smallest a chunk can cover, except the last) */
+	size_t header_len = sizeof(janus_rtcp_header) + 8 + 8;
+	if(size < header_len + 2*packet_status_count + 2*((packet_status_count+6)/7) + 3) {
+		if(size < header_len + 2 + 2 + 3)
+			return -1;
+		/* 7 packets take 16 bytes at most */
+		packet_status_count = ((size - header_len - 3) / 16) * 7;
+		if(packet_status_count == 0)
+			packet_status_count = 1;
+	}
 
 	memset(packet, 0, size);
 	janus_rtcp_header *rtcp = (janus_rtcp_header *)packet;
@@ -1606,13 +1993,10 @@ int janus_rtcp_transport_wide_cc_feedback(char *packet, size_t size, guint32 ssr
 	rtcpfb->ssrc = htonl(ssrc);
 	rtcpfb->media = htonl(media);
 
-	/* Get first packet */
-	janus_rtcp_transport_wide_cc_stats *stat = (janus_rtcp_transport_wide_cc_stats *) g_queue_pop_head (transport_wide_cc_stats);
 	/* Calculate temporal info */
-	guint16 base_seq_num = stat->transport_seq_num;
+	guint32 base_seq_num = history->begin;
 	gboolean first_received	= FALSE;
 	guint64 reference_time = 0;
-	guint packet_status_count = g_queue_get_length(transport_wide_cc_stats) + 1;
 
 	/*
 		0                   1                   2                   3
@@ -1630,7 +2014,7 @@ int janus_rtcp_transport_wide_cc_feedback(char *packet, size_t size, guint32 ssr
 	size_t len = sizeof(janus_rtcp_header) + 8;
 
 	/* Set header data */
-	janus_set2(data, len, base_seq_num);
+	janus_set2(data, len, base_seq_num & 0xFFFF);
 	janus_set2(data, len+2, packet_status_count);
 	/* Set3 referenceTime when first received */
 	size_t reference_time_pos = len + 4;
@@ -1639,104 +2023,89 @@ int janus_rtcp_transport_wide_cc_feedback(char *packet, size_t size, guint32 ssr
 	/* Next byte */
 	len += 8;
 
-	/* Initial time in us */
+	/* First pass: walk the history to figure out the status and delta of each packet */
+	guint8 statuses[JANUS_RTCP_TWCC_MAX_PACKETS];
+	gint deltas[JANUS_RTCP_TWCC_MAX_PACKETS];
 	guint64 timestamp = 0;
-
-	/* Store delta array */
-	GQueue *deltas = g_queue_new();
-	GQueue *statuses = g_queue_new();
-	janus_rtp_packet_status last_status = janus_rtp_packet_status_reserved;
-	janus_rtp_packet_status max_status = janus_rtp_packet_status_notreceived;
-	gboolean all_same = TRUE;
-
-	/* For each packet  */
-	while (stat != NULL) {
-		janus_rtp_packet_status status = janus_rtp_packet_status_notreceived;
-
-		/* If got packet */
-		if (stat->timestamp) {
-			int delta = 0;
-			/* If first received */
-			if (!first_received) {
-				/* Got it  */
-				first_received = TRUE;
-				/* Set it */
-				reference_time = stat->timestamp / 64000;
-				/* Get initial time */
-				timestamp = reference_time * 64000;
-				/* also in buffer */
-				/* (use only 23 bits of reference_time) */
-				janus_set3(data, reference_time_pos, (reference_time & 0x007FFFFF));
-			}
-
-			/* Get delta */
-			if (stat->timestamp>timestamp)
-				delta = (stat->timestamp-timestamp)/250;
-			else
-				delta = -(int)((timestamp-stat->timestamp)/250);
-			/* If it is negative or too big */
-			if (delta<0 || delta> 255) {
-				/* Big one */
-				status = janus_rtp_packet_status_largeornegativedelta;
-			} else {
-				/* Small */
-				status = janus_rtp_packet_status_smalldelta;
-			}
-			/* Store delta */
-			/* Overflows are possible here */
-			g_queue_push_tail(deltas, GINT_TO_POINTER(delta));
-			/* Set last time */
-			timestamp = stat->timestamp;
+	guint32 i = 0;
+	for(i=0; i<packet_status_count; i++) {
+		guint32 seq = base_seq_num + i;
+		janus_rtcp_transport_wide_cc_stats *stat = &history->packets[seq & history->mask];
+		deltas[i] = 0;
+		if(stat->transport_seq_num != seq || stat->timestamp == 0) {
+			/* Not received (or slot reused by a later packet) */
+			statuses[i] = janus_rtp_packet_status_notreceived;
+			continue;
+		}
+		if(!first_received) {
+			first_received = TRUE;
+			reference_time = stat->timestamp / 64000;
+			/* Get initial time */
+			timestamp = reference_time * 64000;
+			/* (use only 23 bits of reference_time) */
+			janus_set3(data, reference_time_pos, (reference_time & 0x007FFFFF));
 		}
+		/* Get delta */
+		gint delta = 0;
+		if(stat->timestamp > timestamp)
+			delta = (stat->timestamp-timestamp)/250;
+		else
+			delta = -(int)((timestamp-stat->timestamp)/250);
+		deltas[i] = delta;
+		statuses[i] = (delta < 0 || delta > 255) ?
+			janus_rtp_packet_status_largeornegativedelta : janus_rtp_packet_status_smalldelta;
+		/* Set last time */
+		timestamp = stat->timestamp;
+	}
 
-		/* Check if all previoues ones were equal and this one the first different */
-		if (all_same && last_status!=janus_rtp_packet_status_reserved && status!=last_status) {
-			/* How big was the same run */
-			if (g_queue_get_length(statuses)>7) {
-				guint32 word = 0;
-				/* Write run! */
+	/* Second pass: write the packet status chunks */
+	i = 0;
+	while(i < packet_status_count) {
+		guint32 remaining = packet_status_count - i;
+		/* How long is the run of identical statuses starting here? */
+		guint32 run = 1;
+		while(run < remaining && run < 8191 && statuses[i+run] == statuses[i])
+			run++;
+		guint32 word = 0;
+		if(run >= 14 || run == remaining) {
+			/*
+				0                   1
+				0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5
+				+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+				|T| S |       Run Length        |
+				+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+				T = 0
+			 */
+			word = janus_push_bits(word, 1, 0);
+			word = janus_push_bits(word, 2, statuses[i]);
+			word = janus_push_bits(word, 13, run);
+			i += run;
+		} else {
+			/* Can we use one bit per status for the next 14 packets? */
+			guint32 symbols = remaining < 14 ? remaining : 14, j = 0;
+			gboolean large = FALSE;
+			for(j=0; j<symbols; j++) {
+				if(statuses[i+j] == janus_rtp_packet_status_largeornegativedelta) {
+					large = TRUE;
+					break;
+				}
+			}
+			if(!large) {
 				/*
 					0                   1
 					0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5
 					+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-					|T| S |       Run Length        |
+					|T|S|       symbol list         |
 					+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-					T = 0
+					T = 1
+					S = 0
 				 */
+				word = janus_push_bits(word, 1, 1);
 				word = janus_push_bits(word, 1, 0);
-				word = janus_push_bits(word, 2, last_status);
-				word = janus_push_bits(word, 13, g_queue_get_length(statuses));
-				/* Write word */
-				janus_set2(data, len, word);
-				len += 2;
-				/* Remove all statuses */
-				g_queue_clear(statuses);
-				/* Reset status */
-				last_status = janus_rtp_packet_status_reserved;
-				max_status = janus_rtp_packet_status_notreceived;
-				all_same = TRUE;
+				for(j=0; j<symbols; j++)
+					word = janus_push_bits(word, 1, statuses[i+j]);
+				word = janus_push_bits(word, 14-symbols, 0);
 			} else {
-				/* Not same */
-				all_same = FALSE;
-			}
-		}
-
-		/* Push back statuses, it will be handled later */
-		g_queue_push_tail(statuses, GUINT_TO_POINTER(status));
-
-		/* If it is bigger */
-		if (status>max_status) {
-			/* Store it */
-			max_status = status;
-		}
-		/* Store las status */
-		last_status = status;
-
-		/* Check if we can still be enqueuing for a run */
-		if (!all_same) {
-			/* Check  */
-			if (!all_same && max_status==janus_rtp_packet_status_largeornegativedelta && g_queue_get_length(statuses)>6) {
-				guint32 word = 0;
 				/*
 					0                   1
 					0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5
@@ -1746,138 +2115,27 @@ int janus_rtcp_transport_wide_cc_feedback(char *packet, size_t size, guint32 ssr
 					T = 1
 					S = 1
 				 */
+				symbols = remaining < 7 ? remaining : 7;
 				word = janus_push_bits(word, 1, 1);
 				word = janus_push_bits(word, 1, 1);
-				/* Set next 7 */
-				size_t i = 0;
-				for (i=0;i<7;++i) {
-					/* Get status */
-					janus_rtp_packet_status status = (janus_rtp_packet_status) GPOINTER_TO_UINT(g_queue_pop_head (statuses));
-					/* Write */
-					word = janus_push_bits(word, 2, (guint8)status);
-				}
-				/* Write word */
-				janus_set2(data, len, word);
-				len += 2;
-				/* Reset */
-				last_status = janus_rtp_packet_status_reserved;
-				max_status = janus_rtp_packet_status_notreceived;
-				all_same = TRUE;
-
-				/* We need to restore the values, as there may be more elements on the buffer */
-				for (i=0; i<g_queue_get_length(statuses); ++i) {
-					/* Get status */
-					status = (janus_rtp_packet_status) GPOINTER_TO_UINT(g_queue_peek_nth(statuses, i));
-					/* If it is bigger */
-					if (status>max_status) {
-						/* Store it */
-						max_status = status;
-					}
-					//Check if it is the same */
-					if (all_same && last_status!=janus_rtp_packet_status_reserved && status!=last_status) {
-						/* Not the same */
-						all_same = FALSE;
-					}
-					/* Store las status */
-					last_status = status;
-				}
-			} else if (!all_same && g_queue_get_length(statuses)>13) {
-				guint32 word = 0;
-				/*
-					0                   1
-					0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5
-					+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-					|T|S|       symbol list         |
-					+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-					T = 1
-					S = 0
-				 */
-				word = janus_push_bits(word, 1, 1);
-				word = janus_push_bits(word, 1, 0);
-				/* Set next 7 */
-				guint32 i = 0;
-				for (i=0;i<14;++i) {
-					/* Get status */
-					janus_rtp_packet_status status = (janus_rtp_packet_status) GPOINTER_TO_UINT(g_queue_pop_head (statuses));
-					/* Write */
-					word = janus_push_bits(word, 1, (guint8)status);
-				}
-				/* Write word */
-				janus_set2(data, len, word);
-				len += 2;
-				/* Reset */
-				last_status = janus_rtp_packet_status_reserved;
-				max_status = janus_rtp_packet_status_notreceived;
-				all_same = TRUE;
+				for(j=0; j<symbols; j++)
+					word = janus_push_bits(word, 2, statuses[i+j]);
+				word = janus_push_bits(word, 14-symbols*2, 0);
 			}
+			i += symbols;
 		}
-		/* Free mem */
-		g_free(stat);
-
-		/* Get next packet stat */
-		stat = (janus_rtcp_transport_wide_cc_stats *) g_queue_pop_head (transport_wide_cc_stats);
-	}
-
-	/* Get status len */
-	size_t statuses_len = g_queue_get_length(statuses);
-
-	/* If not finished yet */
-	if (statuses_len>0) {
-		/* How big was the same run */
-		if (all_same) {
-			guint32 word = 0;
-			/* Write run! */
-			word = janus_push_bits(word, 1, 0);
-			word = janus_push_bits(word, 2, last_status);
-			word = janus_push_bits(word, 13, statuses_len);
-			/* Write word */
-			janus_set2(data, len, word);
-			len += 2;
-		} else if (max_status == janus_rtp_packet_status_largeornegativedelta) {
-			guint32 word = 0;
-			/* Write chunk */
-			word = janus_push_bits(word, 1, 1);
-			word = janus_push_bits(word, 1, 1);
-			/* Write all the statuses */
-			unsigned int i = 0;
-			for (i=0;i<statuses_len;i++) {
-				/* Get each status */
-				janus_rtp_packet_status status = (janus_rtp_packet_status) GPOINTER_TO_UINT(g_queue_pop_head (statuses));
-				/* Write */
-				word = janus_push_bits(word, 2, (guint8)status);
-			}
-			/* Write pending */
-			word = janus_push_bits(word, 14-statuses_len*2, 0);
-			/* Write word */
-			janus_set2(data , len, word);
-			len += 2;
-		} else {
-			guint32 word = 0;
-			/* Write chunk */
-			word = janus_push_bits(word, 1, 1);
-			word = janus_push_bits(word, 1, 0);
-			/* Write all the statuses */
-			unsigned int i = 0;
-			for (i=0;i<statuses_len;i++) {
-				/* Get each status */
-				janus_rtp_packet_status status = (janus_rtp_packet_status) GPOINTER_TO_UINT(g_queue_pop_head (statuses));
-				/* Write */
-				word = janus_push_bits(word, 1, (guint8)status);
-			}
-			/* Write pending */
-			word = janus_push_bits(word, 14-statuses_len, 0);
-			/* Write word */
-			janus_set2(data, len, word);
-			len += 2;
-		}
+		/* Write word */
+		janus_set2(data, len, word);
+		len += 2;
 	}
 
 	/* Write now the deltas */
-	while (!g_queue_is_empty(deltas)) {
-		/* Get next delta */
-		gint delta = GPOINTER_TO_INT(g_queue_pop_head (deltas));
+	for(i=0; i<packet_status_count; i++) {
+		if(statuses[i] == janus_rtp_packet_status_notreceived)
+			continue;
+		gint delta = deltas[i];
 		/* Check size */
-		if (delta<0 || delta>255) {
+		if(statuses[i] == janus_rtp_packet_status_largeornegativedelta) {
 			short reported_delta = (short)delta;
 			/* Overflow */
 			if (reported_delta != delta) {
@@ -1886,19 +2144,17 @@ int janus_rtcp_transport_wide_cc_feedback(char *packet, size_t size, guint32 ssr
 			}
 			/* 2 bytes */
 			janus_set2(data, len, reported_delta);
-			/* Inc */
 			len += 2;
 		} else {
 			/* 1 byte */
 			janus_set1(data, len, (guint8)delta);
-			/* Inc */
-			len ++;
+			len++;
 		}
 	}
 
-	/* Clean mem */
-	g_queue_free(statuses);
-	g_queue_free(deltas);
+	/* These packets have been reported, move the window forward */
+	history->begin += packet_status_count;
+	history->reported = TRUE;
 
 	/* Add zero padding */
 	while (len%4) {
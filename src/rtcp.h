@@ -296,6 +296,138 @@ typedef struct rtcp_transport_wide_cc_stats
 } rtcp_transport_wide_cc_stats;
 typedef rtcp_transport_wide_cc_stats janus_rtcp_transport_wide_cc_stats;
 
+/*! \brief Maximum number of packets reported in a single transport wide feedback message */
+#define JANUS_RTCP_TWCC_MAX_PACKETS	400
+/*! \brief Circular history of transport wide packet arrival times, indexed by
+ * extended transport sequence number: slots are preallocated, and reused as
+ * the window of packets still to report on moves forward */
+typedef struct janus_rtcp_transport_wide_cc_history {
+	/*! \brief Number of slots (always a power of two) */
+	guint32 size;
+	/*! \brief Mask to get the slot of a sequence number */
+	guint32 mask;
+	/*! \brief Whether we received any packet yet */
+	gboolean started;
+	/*! \brief Whether we sent any feedback yet */
+	gboolean reported;
+	/*! \brief First extended sequence number we didn't send feedback for yet */
+	guint32 begin;
+	/*! \brief Extended sequence number following the highest one we received */
+	guint32 end;
+	/*! \brief Slots, each containing the extended sequence number and the arrival time */
+	janus_rtcp_transport_wide_cc_stats packets[];
+} janus_rtcp_transport_wide_cc_history;
+/*! \brief Method to create a new transport wide packet arrival history
+ * @param[in] size Minimum number of packets the history should be able to track between feedbacks
+ * @returns A new janus_rtcp_transport_wide_cc_history instance */
+janus_rtcp_transport_wide_cc_history *janus_rtcp_transport_wide_cc_history_create(guint32 size);
+/*! \brief Method to destroy a transport wide packet arrival history
+ * @param[in] history The janus_rtcp_transport_wide_cc_history instance to destroy */
+void janus_rtcp_transport_wide_cc_history_destroy(janus_rtcp_transport_wide_cc_history *history);
+/*! \brief Method to track the arrival of a packet in a transport wide packet arrival history
+ * @note Packets older than the last feedback sent are ignored, as they've been reported as lost already
+ * @param[in] history The janus_rtcp_transport_wide_cc_history instance to update
+ * @param[in] transport_seq_num The extended transport wide sequence number of the packet
+ * @param[in] timestamp The arrival time of the packet, in microseconds */
+void janus_rtcp_transport_wide_cc_history_add(janus_rtcp_transport_wide_cc_history *history, guint32 transport_seq_num, guint64 timestamp);
+/*! \brief Method to check how many packets we still have to send feedback for
+ * @param[in] history The janus_rtcp_transport_wide_cc_history instance to check
+ * @returns The number of packets (received or lost) still to report */
+guint32 janus_rtcp_transport_wide_cc_history_pending(janus_rtcp_transport_wide_cc_history *history);
+
+/*! \brief Types of messages a parsed RTCP compound packet can contain */
+typedef enum janus_rtcp_block_type {
+	/*! \brief Message we don't parse any further (e.g., SLI, RPSI, unknown AFB) */
+	JANUS_RTCP_BLOCK_OTHER = 0,
+	/*! \brief Sender Report */
+	JANUS_RTCP_BLOCK_SR,
+	/*! \brief Receiver Report */
+	JANUS_RTCP_BLOCK_RR,
+	/*! \brief Source Description */
+	JANUS_RTCP_BLOCK_SDES,
+	/*! \brief Goodbye */
+	JANUS_RTCP_BLOCK_BYE,
+	/*! \brief Application-defined */
+	JANUS_RTCP_BLOCK_APP,
+	/*! \brief Generic NACK (RTPFB, fmt=1) */
+	JANUS_RTCP_BLOCK_NACK,
+	/*! \brief Temporary Maximum Media Stream Bit Rate Request (RTPFB, fmt=3) */
+	JANUS_RTCP_BLOCK_TMMBR,
+	/*! \brief Transport-wide congestion control feedback (RTPFB, fmt=15) */
+	JANUS_RTCP_BLOCK_TWCC,
+	/*! \brief Picture Loss Indication (PSFB, fmt=1) */
+	JANUS_RTCP_BLOCK_PLI,
+	/*! \brief Full Intra Request (PSFB, fmt=4, or the legacy rfc2032 one) */
+	JANUS_RTCP_BLOCK_FIR,
+	/*! \brief Receiver Estimated Maximum Bitrate (PSFB, fmt=15) */
+	JANUS_RTCP_BLOCK_REMB,
+	/*! \brief Extended Report */
+	JANUS_RTCP_BLOCK_XR
+} janus_rtcp_block_type;
+/*! \brief Helper to get a string representation of an RTCP message type
+ * @param[in] type The janus_rtcp_block_type value
+ * @returns A string representation of the type */
+const char *janus_rtcp_block_type_str(janus_rtcp_block_type type);
+
+/*! \brief A single message in a parsed RTCP compound packet */
+typedef struct janus_rtcp_block {
+	/*! \brief Type of message */
+	janus_rtcp_block_type type;
+	/*! \brief Offset of the message in the compound packet, in bytes */
+	uint16_t offset;
+	/*! \brief Length of the message, in bytes */
+	uint16_t length;
+	/*! \brief Number of entries in the message (report blocks for SR/RR, FCI entries for NACK/FIR, SSRCs for REMB) */
+	uint16_t count;
+	/*! \brief Sender SSRC of the message, if any */
+	uint32_t ssrc;
+	/*! \brief SSRC the message refers to (first report block for SR/RR, media source for feedback), if any */
+	uint32_t media;
+	/*! \brief Reported bitrate, for REMB messages */
+	uint32_t bitrate;
+} janus_rtcp_block;
+
+/*! \brief Maximum number of messages we keep track of in a parsed RTCP compound packet */
+#define JANUS_RTCP_MAX_BLOCKS	16
+/*! \brief RTCP compound packet, validated and split in its messages by janus_rtcp_parse_compound
+ * @note This is meant to be allocated on the stack: parsing a packet doesn't allocate
+ * any memory, and messages are only referenced by their offset in the packet buffer */
+typedef struct janus_rtcp_compound {
+	/*! \brief Messages in the compound packet, in the order they were found */
+	janus_rtcp_block blocks[JANUS_RTCP_MAX_BLOCKS];
+	/*! \brief Number of messages in blocks */
+	uint8_t count;
+	/*! \brief Whether there were more than JANUS_RTCP_MAX_BLOCKS messages: the ones that
+	 * didn't fit are still validated and reflected in the summary below, but not in blocks,
+	 * which is why messages should be accessed with janus_rtcp_compound_next instead */
+	gboolean truncated;
+	/*! \brief Length of the compound packet, in bytes */
+	int length;
+	/*! \brief Sender SSRC, as janus_rtcp_get_sender_ssrc would return it */
+	uint32_t sender_ssrc;
+	/*! \brief Receiver SSRC, as janus_rtcp_get_receiver_ssrc would return it */
+	uint32_t receiver_ssrc;
+	/*! \brief Whether the packet contains a BYE */
+	gboolean has_bye;
+	/*! \brief Whether the packet contains a PLI */
+	gboolean has_pli;
+	/*! \brief Whether the packet contains a FIR */
+	gboolean has_fir;
+	/*! \brief Number of sequence numbers NACKed in the packet */
+	uint16_t nacks;
+	/*! \brief Bitrate in the first REMB in the packet, or 0 if there was none */
+	uint32_t remb_bitrate;
+} janus_rtcp_compound;
+
+/*! \brief Iterator on the messages of a parsed RTCP compound packet
+ * @note Initialize it to zero before the first janus_rtcp_compound_next call */
+typedef struct janus_rtcp_compound_iter {
+	/*! \brief Index of the next message in blocks, or offset of the next message in the packet if the compound was truncated */
+	int index;
+	/*! \brief Message returned by the iterator, if it wasn't in blocks */
+	janus_rtcp_block block;
+} janus_rtcp_compound_iter;
+
 /*! \brief Method to retrieve the estimated round-trip time from an existing RTCP context
  * @param[in] ctx The RTCP context to query
  * @returns The estimated round-trip time */
@@ -383,6 +515,42 @@ gboolean janus_is_rtcp(char *buf, guint len);
  * @returns 0 in case of success, -1 on errors */
 int janus_rtcp_parse(janus_rtcp_context *ctx, char *packet, int len);
 
+/*! \brief Method to validate an RTCP compound packet and split it in its messages in a single pass
+ * @note Nothing is allocated and the packet is not modified: once parsed, the compound
+ * can be used in place of janus_rtcp_get_sender_ssrc, janus_rtcp_has_pli, janus_rtcp_get_remb
+ * and the like, which would each scan the whole packet again. In case of errors, the
+ * compound only reflects the messages that preceded the invalid one
+ * @param[in] packet The message data
+ * @param[in] len The message data length in bytes
+ * @param[out] compound The janus_rtcp_compound instance to fill in
+ * @returns 0 in case of success, a negative integer if the packet is invalid */
+int janus_rtcp_parse_compound(char *packet, int len, janus_rtcp_compound *compound);
+
+/*! \brief Method to iterate on all the messages of a parsed RTCP compound packet
+ * @note Messages are taken from the blocks of the compound, unless it was truncated, in
+ * which case the packet is walked again, so that the messages that didn't fit are returned too
+ * @param[in] packet The message data the compound was parsed from
+ * @param[in] compound The parsed compound packet
+ * @param[in,out] iter The iterator to advance
+ * @returns The next message, or NULL if there are no more messages */
+const janus_rtcp_block *janus_rtcp_compound_next(char *packet, janus_rtcp_compound *compound, janus_rtcp_compound_iter *iter);
+
+/*! \brief Method to update an RTCP context with the SR, RR and transport-wide CC messages in a parsed compound packet
+ * @note This is the equivalent of janus_rtcp_parse, for packets parsed with janus_rtcp_parse_compound
+ * @param[in] ctx RTCP context to update
+ * @param[in] packet The message data the compound was parsed from
+ * @param[in] compound The parsed compound packet */
+void janus_rtcp_compound_update_context(janus_rtcp_context *ctx, char *packet, janus_rtcp_compound *compound);
+
+/*! \brief Method to remove all the messages of a specific type from a parsed RTCP compound packet, in place
+ * @note Offsets in the compound are updated accordingly, so it can still be used afterwards
+ * @param[in] packet The message data the compound was parsed from
+ * @param[in] len The message data length in bytes
+ * @param[in,out] compound The parsed compound packet
+ * @param[in] type The type of messages to remove (e.g., JANUS_RTCP_BLOCK_NACK)
+ * @returns The new message data length in bytes */
+int janus_rtcp_compound_remove(char *packet, int len, janus_rtcp_compound *compound, janus_rtcp_block_type type);
+
 /*! \brief Method to fix incoming RTCP SR and RR data
  * @param[in] packet The message data
  * @param[in] len The message data length in bytes
@@ -412,6 +580,14 @@ int janus_rtcp_fix_ssrc(janus_rtcp_context *ctx, char *packet, int len, int fixs
  * @returns A pointer to the new RTCP message data, NULL in case all messages have been filtered out */
 char *janus_rtcp_filter(char *packet, int len, int *newlen);
 
+/*! \brief Method to filter an outgoing RTCP message into an existing buffer, to avoid a separate allocation
+ * @param[in] packet The message data
+ * @param[in] len The message data length in bytes
+ * @param[out] filtered The buffer to copy the messages to keep to
+ * @param[in] size The size of the filtered buffer (messages that don't fit are dropped)
+ * @returns The data length of the filtered RTCP message (0 if all messages have been filtered out), or a negative integer in case of errors */
+int janus_rtcp_filter_into(char *packet, int len, char *filtered, int size);
+
 /*! \brief Method to quickly process the header of an incoming RTP packet to update the associated RTCP context
  * @param[in] ctx RTCP context to update, if needed (optional)
  * @param[in] packet The RTP packet
@@ -530,13 +706,34 @@ int janus_rtcp_pli(char *packet, int len);
 int janus_rtcp_nacks(char *packet, int len, GSList *nacks);
 
 /*! \brief Method to generate a new RTCP transport wide message to report reception stats
+ * @note The feedback covers the oldest packets in the history still to report on,
+ * which are then removed from the window: if more packets are pending than
+ * fit in a single message, just invoke the method again
  * @param[in] packet The buffer data (MUST be at least 16 chars)
  * @param[in] len The message data length in bytes
  * @param[in] ssrc SSRC of the origin stream
  * @param[in] media SSRC of the destination stream
  * @param[in] feedback_packet_count Feedback paccket count
- * @param[in] transport_wide_cc_stats List of rtp packet reception stats
- * @returns The message data length in bytes, if successful, -1 on errors */
-int janus_rtcp_transport_wide_cc_feedback(char *packet, size_t len, guint32 ssrc, guint32 media, guint8 feedback_packet_count, GQueue *transport_wide_cc_stats);
+ * @param[in] history History of rtp packet reception stats
+ * @param[in] max_packets Maximum number of packets to report on (capped to JANUS_RTCP_TWCC_MAX_PACKETS)
+ * @returns The message data length in bytes, if successful, 0 if there was nothing to report, -1 on errors */
+int janus_rtcp_transport_wide_cc_feedback(char *packet, size_t len, guint32 ssrc, guint32 media, guint8 feedback_packet_count,
+	janus_rtcp_transport_wide_cc_history *history, guint max_packets);
+
+/*! \brief Callback invoked by janus_rtcp_transport_wide_cc_parse for each packet a feedback reports on
+ * @param[in] seq The transport-wide sequence number of the packet
+ * @param[in] received Whether the packet was received or not
+ * @param[in] arrival When the packet was received, in microseconds (remote clock, so only useful
+ * to compute differences between packets), or 0 if it wasn't received
+ * @param[in] user_data The opaque pointer passed to janus_rtcp_transport_wide_cc_parse */
+typedef void (*janus_rtcp_transport_wide_cc_cb)(guint16 seq, gboolean received, gint64 arrival, void *user_data);
+/*! \brief Method to parse an incoming RTCP transport wide feedback message
+ * @note The callback is invoked in sequence number order, and no memory is allocated
+ * @param[in] packet The message data, which must start with the feedback message
+ * @param[in] len The message data length in bytes
+ * @param[in] cb The callback to invoke for each packet the feedback reports on
+ * @param[in] user_data Opaque pointer to pass to the callback
+ * @returns The number of packets the feedback reported on, or -1 on errors */
+int janus_rtcp_transport_wide_cc_parse(char *packet, int len, janus_rtcp_transport_wide_cc_cb cb, void *user_data);
 
 #endif
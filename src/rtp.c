@@ -61,6 +61,79 @@ char *janus_rtp_payload(char *buf, int len, int *plen) {
 	return buf+hlen;
 }
 
+/* Shared payloads for retransmissions */
+static void janus_rtp_shared_stats_free(const janus_refcount *stats_ref) {
+	janus_rtp_shared_stats *stats = janus_refcount_containerof(stats_ref, janus_rtp_shared_stats, ref);
+	g_free(stats);
+}
+
+janus_rtp_shared_stats *janus_rtp_shared_stats_create(void) {
+	janus_rtp_shared_stats *stats = g_malloc0(sizeof(janus_rtp_shared_stats));
+	janus_refcount_init(&stats->ref, janus_rtp_shared_stats_free);
+	return stats;
+}
+
+void janus_rtp_shared_stats_destroy(janus_rtp_shared_stats *stats) {
+	if(stats)
+		janus_refcount_decrease(&stats->ref);
+}
+
+gint janus_rtp_shared_stats_saved_bytes(janus_rtp_shared_stats *stats) {
+	if(stats == NULL)
+		return 0;
+	gint saved = g_atomic_int_get(&stats->referenced_bytes) - g_atomic_int_get(&stats->bytes);
+	return saved > 0 ? saved : 0;
+}
+
+static void janus_rtp_shared_packet_free(const janus_refcount *packet_ref) {
+	janus_rtp_shared_packet *packet = janus_refcount_containerof(packet_ref, janus_rtp_shared_packet, ref);
+	if(packet->stats) {
+		g_atomic_int_add(&packet->stats->packets, -1);
+		g_atomic_int_add(&packet->stats->bytes, -packet->length);
+		janus_refcount_decrease(&packet->stats->ref);
+	}
+	g_free(packet->payload);
+	g_free(packet);
+}
+
+janus_rtp_shared_packet *janus_rtp_shared_packet_create(char *buf, int len, janus_rtp_shared_stats *stats) {
+	int plen = 0;
+	char *payload = janus_rtp_payload(buf, len, &plen);
+	if(payload == NULL || plen < 1)
+		return NULL;
+	janus_rtp_shared_packet *packet = g_malloc(sizeof(janus_rtp_shared_packet));
+	packet->payload = g_malloc(plen);
+	memcpy(packet->payload, payload, plen);
+	packet->length = plen;
+	packet->stats = stats;
+	if(stats) {
+		janus_refcount_increase(&stats->ref);
+		g_atomic_int_inc(&stats->packets);
+		g_atomic_int_add(&stats->bytes, plen);
+		g_atomic_int_add(&stats->referenced_bytes, plen);
+	}
+	janus_refcount_init_nodebug(&packet->ref, janus_rtp_shared_packet_free);
+	return packet;
+}
+
+void janus_rtp_shared_packet_ref(janus_rtp_shared_packet *packet) {
+	if(packet == NULL)
+		return;
+	janus_refcount_increase_nodebug(&packet->ref);
+	if(packet->stats)
+		g_atomic_int_add(&packet->stats->referenced_bytes, packet->length);
+}
+
+void janus_rtp_shared_packet_unref(janus_rtp_shared_packet *packet) {
+	if(packet == NULL)
+		return;
+	/* Release the accounting first, as this may be the last reference */
+	janus_rtp_shared_stats *stats = packet->stats;
+	if(stats)
+		g_atomic_int_add(&stats->referenced_bytes, -packet->length);
+	janus_refcount_decrease_nodebug(&packet->ref);
+}
+
 int janus_rtp_header_extension_get_id(const char *sdp, const char *extension) {
 	if(!sdp || !extension)
 		return -1;
@@ -266,16 +339,17 @@ int janus_rtp_header_extension_parse_video_orientation(char *buf, int len, int i
 
 int janus_rtp_header_extension_parse_playout_delay(char *buf, int len, int id,
 		uint16_t *min_delay, uint16_t *max_delay) {
-	uint32_t bytes = 0;
+	char *ext = NULL;
 	uint8_t idlen = 0;
-	if(janus_rtp_header_extension_find(buf, len, id, NULL, &bytes, NULL, &idlen) < 0)
+	if(janus_rtp_header_extension_find(buf, len, id, NULL, NULL, &ext, &idlen) < 0)
 		return -1;
-	if(idlen < 3)
+	if(ext == NULL || idlen < 3)
 		return -2;
 	/* a=extmap:6 http://www.webrtc.org/experiments/rtp-hdrext/playout-delay */
-	uint16_t min = (bytes & 0x00FFF000) >> 12;
-	uint16_t max = bytes & 0x00000FFF;
-	JANUS_LOG(LOG_DBG, "%"SCNu32"x --> min=%"SCNu16", max=%"SCNu16"\n", bytes, min, max);
+	uint8_t *bytes = (uint8_t *)ext;
+	uint16_t min = (bytes[0] << 4) | (bytes[1] >> 4);
+	uint16_t max = ((bytes[1] & 0x0F) << 8) | bytes[2];
+	JANUS_LOG(LOG_DBG, "%02x%02x%02x --> min=%"SCNu16", max=%"SCNu16"\n", bytes[0], bytes[1], bytes[2], min, max);
 	if(min_delay)
 		*min_delay = min;
 	if(max_delay)
@@ -445,15 +519,9 @@ int janus_rtp_header_extension_set_transport_wide_cc(char *buf, int len, int id,
 	return 0;
 }
 
-int janus_rtp_header_extension_parse_video_layers_allocation(char *buf, int len, int id,
+/* Static helper to parse the content of a video layers allocation extension */
+static int janus_rtp_header_extension_parse_vla_content(char *ext, uint8_t idlen,
 		int8_t *spatial_layers, int8_t *temporal_layers) {
-	char *ext = NULL;
-	uint8_t idlen = 0;
-	if(janus_rtp_header_extension_find(buf, len, id, NULL, NULL, &ext, &idlen) < 0)
-		return -1;
-	/* a=extmap:9 http://www.webrtc.org/experiments/rtp-hdrext/video-layers-allocation00 */
-	if(ext == NULL || idlen < 2)
-		return -2;
 	/* Parse the extension to reconstruct the layers topology */
 	janus_rtp_vla_rtp_stream streams[4] = { 0 };
 	/* First byte */
@@ -512,6 +580,18 @@ int janus_rtp_header_extension_parse_video_layers_allocation(char *buf, int len,
 	return 0;
 }
 
+int janus_rtp_header_extension_parse_video_layers_allocation(char *buf, int len, int id,
+		int8_t *spatial_layers, int8_t *temporal_layers) {
+	char *ext = NULL;
+	uint8_t idlen = 0;
+	if(janus_rtp_header_extension_find(buf, len, id, NULL, NULL, &ext, &idlen) < 0)
+		return -1;
+	/* a=extmap:9 http://www.webrtc.org/experiments/rtp-hdrext/video-layers-allocation00 */
+	if(ext == NULL || idlen < 2)
+		return -2;
+	return janus_rtp_header_extension_parse_vla_content(ext, idlen, spatial_layers, temporal_layers);
+}
+
 int janus_rtp_header_extension_replace_id(char *buf, int len, int id, int new_id) {
 	if(!buf || len < 12)
 		return -1;
@@ -577,6 +657,187 @@ int janus_rtp_header_extension_replace_id(char *buf, int len, int id, int new_id
 	return -3;
 }
 
+void janus_rtp_extension_map_reset(janus_rtp_extension_map *map) {
+	if(map == NULL)
+		return;
+	memset(map->types, 0, sizeof(map->types));
+}
+
+void janus_rtp_extension_map_set(janus_rtp_extension_map *map, int id, janus_rtp_extension_type type) {
+	if(map == NULL || id < 1 || id > 255)
+		return;
+	map->types[id] = type;
+}
+
+/* Static helper to decode a single extension element, according to its type */
+static gboolean janus_rtp_header_extension_decode(janus_rtp_extension_type type, char *ext, uint8_t idlen,
+		janus_plugin_rtp_extensions *extensions, janus_rtp_header_extensions_info *info) {
+	uint8_t *bytes = (uint8_t *)ext;
+	switch(type) {
+		case JANUS_RTP_EXTENSION_AUDIO_LEVEL:
+			if(extensions == NULL || idlen < 1)
+				return FALSE;
+			extensions->audio_level = bytes[0] & 0x7F;
+			extensions->audio_level_vad = (bytes[0] & 0x80) >> 7;
+			return TRUE;
+		case JANUS_RTP_EXTENSION_VIDEO_ORIENTATION: {
+			if(extensions == NULL || idlen < 1)
+				return FALSE;
+			gboolean r1 = (bytes[0] & 0x02) >> 1, r0 = bytes[0] & 0x01;
+			extensions->video_rotation = 0;
+			if(r1 && r0)
+				extensions->video_rotation = 270;
+			else if(r1)
+				extensions->video_rotation = 180;
+			else if(r0)
+				extensions->video_rotation = 90;
+			extensions->video_back_camera = (bytes[0] & 0x08) >> 3;
+			extensions->video_flipped = (bytes[0] & 0x04) >> 2;
+			return TRUE;
+		}
+		case JANUS_RTP_EXTENSION_PLAYOUT_DELAY:
+			if(extensions == NULL || idlen < 3)
+				return FALSE;
+			extensions->min_delay = (bytes[0] << 4) | (bytes[1] >> 4);
+			extensions->max_delay = ((bytes[1] & 0x0F) << 8) | bytes[2];
+			return TRUE;
+		case JANUS_RTP_EXTENSION_DEPENDENCY_DESC:
+			if(extensions == NULL || idlen < 1)
+				return FALSE;
+			/* We copy the DD bytes as they are: it's up to plugins to parse it, if needed */
+			extensions->dd_len = idlen;
+			memcpy(extensions->dd_content, ext, idlen);
+			return TRUE;
+		case JANUS_RTP_EXTENSION_ABS_CAPTURE_TIME: {
+			if(extensions == NULL || idlen < 8)
+				return FALSE;
+			uint64_t abs64 = 0;
+			memcpy(&abs64, ext, 8);
+			extensions->abs_capture_ts = ntohll(abs64);
+			return TRUE;
+		}
+		case JANUS_RTP_EXTENSION_VIDEO_LAYERS: {
+			if(extensions == NULL || idlen < 2)
+				return FALSE;
+			int8_t spatial_layers = -1, temporal_layers = -1;
+			if(janus_rtp_header_extension_parse_vla_content(ext, idlen, &spatial_layers, &temporal_layers) < 0)
+				return FALSE;
+			extensions->spatial_layers = spatial_layers;
+			extensions->temporal_layers = temporal_layers;
+			return TRUE;
+		}
+		case JANUS_RTP_EXTENSION_TRANSPORT_WIDE_CC:
+			if(info == NULL || idlen < 2)
+				return FALSE;
+			info->transport_seq_num = (bytes[0] << 8) | bytes[1];
+			return TRUE;
+		case JANUS_RTP_EXTENSION_ABS_SEND_TIME:
+			if(info == NULL || idlen < 3)
+				return FALSE;
+			info->abs_send_time = (bytes[0] << 16) | (bytes[1] << 8) | bytes[2];
+			return TRUE;
+		case JANUS_RTP_EXTENSION_MID:
+			if(info == NULL || idlen < 1)
+				return FALSE;
+			info->mid = ext;
+			info->mid_len = idlen;
+			return TRUE;
+		case JANUS_RTP_EXTENSION_RID:
+			if(info == NULL || idlen < 1)
+				return FALSE;
+			info->rid = ext;
+			info->rid_len = idlen;
+			return TRUE;
+		case JANUS_RTP_EXTENSION_REPAIRED_RID:
+			if(info == NULL || idlen < 1)
+				return FALSE;
+			info->repaired_rid = ext;
+			info->repaired_rid_len = idlen;
+			return TRUE;
+		default:
+			break;
+	}
+	return FALSE;
+}
+
+int janus_rtp_header_extensions_parse(char *buf, int len, const janus_rtp_extension_map *map,
+		janus_plugin_rtp_extensions *extensions, janus_rtp_header_extensions_info *info) {
+	if(info != NULL) {
+		memset(info, 0, sizeof(*info));
+		info->transport_seq_num = -1;
+		info->abs_send_time = -1;
+	}
+	if(!buf || len < 12 || map == NULL)
+		return -1;
+	janus_rtp_header *rtp = (janus_rtp_header *)buf;
+	if(rtp->version != 2)
+		return -2;
+	int hlen = 12;
+	if(rtp->csrccount)	/* Skip CSRC if needed */
+		hlen += rtp->csrccount*4;
+	if(!rtp->extension || len <= hlen + (int)sizeof(janus_rtp_header_extension))
+		return 0;
+	janus_rtp_header_extension *ext = (janus_rtp_header_extension *)(buf+hlen);
+	int extlen = ntohs(ext->length)*4;
+	hlen += 4;
+	if(len <= (hlen + extlen))
+		return 0;
+	/* Keep track of the extensions we found: as janus_rtp_header_extension_find,
+	 * if an extension appears more than once only the first instance is used */
+	guint32 found = 0;
+	int parsed = 0, i = 0;
+	uint8_t extid = 0, idlen = 0, type = 0;
+	if(ntohs(ext->type) == 0xBEDE) {
+		/* 1-Byte extension */
+		const uint8_t padding = 0x00, reserved = 0xF;
+		while(i < extlen) {
+			extid = (uint8_t)buf[hlen+i] >> 4;
+			if(extid == reserved) {
+				break;
+			} else if(extid == padding) {
+				i++;
+				continue;
+			}
+			idlen = ((uint8_t)buf[hlen+i] & 0xF)+1;
+			i++;
+			if((i+idlen) > extlen)
+				break;
+			type = map->types[extid];
+			if(type != JANUS_RTP_EXTENSION_NONE && !(found & (1 << type)) &&
+					janus_rtp_header_extension_decode(type, &buf[hlen+i], idlen, extensions, info)) {
+				found |= (1 << type);
+				parsed++;
+			}
+			i += idlen;
+		}
+	} else if(ntohs(ext->type) == 0x1000) {
+		/* 2-Byte extension */
+		const uint8_t padding = 0x00;
+		while(i < extlen) {
+			if((extlen-i) < 2)
+				break;
+			extid = buf[hlen+i];
+			if(extid == padding) {
+				i += 2;
+				continue;
+			}
+			i++;
+			idlen = buf[hlen+i];
+			i++;
+			if((i+idlen) > extlen)
+				break;
+			type = map->types[extid];
+			if(type != JANUS_RTP_EXTENSION_NONE && !(found & (1 << type)) &&
+					janus_rtp_header_extension_decode(type, &buf[hlen+i], idlen, extensions, info)) {
+				found |= (1 << type);
+				parsed++;
+			}
+			i += idlen;
+		}
+	}
+	return parsed;
+}
+
 int janus_rtp_extension_id(const char *type) {
 	if(type == NULL)
 		return 0;
@@ -1147,7 +1408,9 @@ void janus_rtp_simulcasting_context_reset(janus_rtp_simulcasting_context *contex
 	context->rid_ext_id = -1;
 	context->substream = -1;
 	context->substream_target_temp = -1;
+	context->substream_max = -1;
 	context->templayer = -1;
+	context->templayer_max = -1;
 }
 
 void janus_rtp_simulcasting_prepare(json_t *simulcast, int *rid_ext_id, uint32_t *ssrcs, char **rids) {
@@ -1262,6 +1525,12 @@ gboolean janus_rtp_simulcasting_context_process_rtp(janus_rtp_simulcasting_conte
 		context->substream_target_temp = -1;
 	}
 	int target = (context->substream_target_temp == -1) ? context->substream_target : context->substream_target_temp;
+	/* Whatever the target, don't go higher than the caps we've been given, if any */
+	if(context->substream_max >= 0 && target > context->substream_max)
+		target = context->substream_max;
+	int templayer_target = context->templayer_target;
+	if(context->templayer_max >= 0 && templayer_target > context->templayer_max)
+		templayer_target = context->templayer_max;
 	/* Check what we need to do with the packet */
 	if(context->substream == -1) {
 		if((vcodec == JANUS_VIDEOCODEC_VP8 && janus_vp8_is_keyframe(payload, plen)) ||
@@ -1342,9 +1611,9 @@ gboolean janus_rtp_simulcasting_context_process_rtp(janus_rtp_simulcasting_conte
 		uint8_t keyidx = 0;
 		if(janus_vp8_parse_descriptor(payload, plen, &m, &picid, &tlzi, &tid, &ybit, &keyidx) == 0) {
 			//~ JANUS_LOG(LOG_WARN, "%"SCNu16", %u, %u, %u, %u\n", picid, tlzi, tid, ybit, keyidx);
-			if(context->templayer != context->templayer_target && tid == context->templayer_target) {
+			if(context->templayer != templayer_target && tid == templayer_target) {
 				/* FIXME We should be smarter in deciding when to switch */
-				context->templayer = context->templayer_target;
+				context->templayer = templayer_target;
 				/* Notify the caller that the temporal layer changed */
 				context->changed_temporal = TRUE;
 			}
@@ -1363,19 +1632,19 @@ gboolean janus_rtp_simulcasting_context_process_rtp(janus_rtp_simulcasting_conte
 		janus_vp9_svc_info svc_info = { 0 };
 		if(janus_vp9_parse_svc(payload, plen, &found, &svc_info) == 0 && found) {
 			int temporal_layer = context->templayer;
-			if(context->templayer_target > context->templayer) {
+			if(templayer_target > context->templayer) {
 				/* We need to upscale */
 				if(svc_info.ubit && svc_info.bbit &&
 						svc_info.temporal_layer > context->templayer &&
-						svc_info.temporal_layer <= context->templayer_target) {
+						svc_info.temporal_layer <= templayer_target) {
 					context->templayer = svc_info.temporal_layer;
 					temporal_layer = context->templayer;
 					context->changed_temporal = TRUE;
 				}
-			} else if(context->templayer_target < context->templayer) {
+			} else if(templayer_target < context->templayer) {
 				/* We need to downscale */
-				if(svc_info.ebit && svc_info.temporal_layer == context->templayer_target) {
-					context->templayer = context->templayer_target;
+				if(svc_info.ebit && svc_info.temporal_layer == templayer_target) {
+					context->templayer = templayer_target;
 					context->changed_temporal = TRUE;
 				}
 			}
@@ -1399,17 +1668,17 @@ gboolean janus_rtp_simulcasting_context_process_rtp(janus_rtp_simulcasting_conte
 				janus_av1_svc_template *t = g_hash_table_lookup(av1ctx->templates, GUINT_TO_POINTER(template));
 				if(t) {
 					int temporal_layer = context->templayer;
-					if(context->templayer_target > context->templayer) {
+					if(templayer_target > context->templayer) {
 						/* We need to upscale */
-						if(t->temporal > context->templayer && t->temporal <= context->templayer_target) {
+						if(t->temporal > context->templayer && t->temporal <= templayer_target) {
 							context->templayer = t->temporal;
 							temporal_layer = context->templayer;
 							context->changed_temporal = TRUE;
 						}
-					} else if(context->templayer_target < context->templayer) {
+					} else if(templayer_target < context->templayer) {
 						/* We need to downscale */
-						if(t->temporal == context->templayer_target) {
-							context->templayer = context->templayer_target;
+						if(t->temporal == templayer_target) {
+							context->templayer = templayer_target;
 							context->changed_temporal = TRUE;
 						}
 					}
@@ -1437,7 +1706,9 @@ void janus_rtp_svc_context_reset(janus_rtp_svc_context *context) {
 	janus_av1_svc_context_reset(&context->dd_context);
 	memset(context, 0, sizeof(*context));
 	context->spatial = -1;
+	context->spatial_max = -1;
 	context->temporal = -1;
+	context->temporal_max = -1;
 }
 
 gboolean janus_rtp_svc_context_process_rtp(janus_rtp_svc_context *context,
@@ -1446,6 +1717,13 @@ gboolean janus_rtp_svc_context_process_rtp(janus_rtp_svc_context *context,
 	if(!context || !buf || len < 1 || (vcodec != JANUS_VIDEOCODEC_VP9 && vcodec != JANUS_VIDEOCODEC_AV1))
 		return FALSE;
 	janus_rtp_header *header = (janus_rtp_header *)buf;
+	/* Check what our targets are, considering the caps we've been given, if any */
+	int spatial_target = context->spatial_target;
+	if(context->spatial_max >= 0 && spatial_target > context->spatial_max)
+		spatial_target = context->spatial_max;
+	int temporal_target = context->temporal_target;
+	if(context->temporal_max >= 0 && temporal_target > context->temporal_max)
+		temporal_target = context->temporal_max;
 	/* Reset the flags */
 	context->changed_spatial = FALSE;
 	context->changed_temporal = FALSE;
@@ -1479,12 +1757,12 @@ gboolean janus_rtp_svc_context_process_rtp(janus_rtp_svc_context *context,
 		int spatial_layer = context->spatial;
 		if(t->spatial >= 0 && t->spatial <= 2)
 			context->last_spatial_layer[t->spatial] = now;
-		if(context->spatial_target > context->spatial) {
+		if(spatial_target > context->spatial) {
 			JANUS_LOG(LOG_HUGE, "We need to upscale spatially: (%d < %d)\n",
-				context->spatial, context->spatial_target);
+				context->spatial, spatial_target);
 			/* We need to upscale: wait for a keyframe */
 			if(keyframe) {
-				int new_spatial_layer = context->spatial_target;
+				int new_spatial_layer = spatial_target;
 				while(new_spatial_layer > context->spatial && new_spatial_layer > 0) {
 					if(now - context->last_spatial_layer[new_spatial_layer] >= (context->drop_trigger ? context->drop_trigger : 250000)) {
 						/* We haven't received packets from this layer for a while, try a lower layer */
@@ -1497,21 +1775,21 @@ gboolean janus_rtp_svc_context_process_rtp(janus_rtp_svc_context *context,
 				}
 				if(new_spatial_layer > context->spatial) {
 					JANUS_LOG(LOG_HUGE, "  -- Upscaling spatial layer: %d --> %d (need %d)\n",
-						context->spatial, new_spatial_layer, context->spatial_target);
+						context->spatial, new_spatial_layer, spatial_target);
 					context->spatial = new_spatial_layer;
 					spatial_layer = context->spatial;
 					context->changed_spatial = TRUE;
 				}
 			}
-		} else if(context->spatial_target < context->spatial) {
+		} else if(spatial_target < context->spatial) {
 			/* We need to scale: wait for a keyframe */
 			JANUS_LOG(LOG_HUGE, "We need to downscale spatially: (%d > %d)\n",
-				context->spatial, context->spatial_target);
+				context->spatial, spatial_target);
 			/* Check the E bit to see if this is an end-of-frame */
 			if(ebit) {
 				JANUS_LOG(LOG_HUGE, "  -- Downscaling spatial layer: %d --> %d\n",
-					context->spatial, context->spatial_target);
-				context->spatial = context->spatial_target;
+					context->spatial, spatial_target);
+				context->spatial = spatial_target;
 				context->changed_spatial = TRUE;
 			}
 		}
@@ -1526,17 +1804,17 @@ gboolean janus_rtp_svc_context_process_rtp(janus_rtp_svc_context *context,
 			override_mark_bit = TRUE;
 		}
 		int temporal = context->temporal;
-		if(context->temporal_target > context->temporal) {
+		if(temporal_target > context->temporal) {
 			/* We need to upscale */
-			if(t->temporal > context->temporal && t->temporal <= context->temporal_target) {
+			if(t->temporal > context->temporal && t->temporal <= temporal_target) {
 				context->temporal = t->temporal;
 				temporal = context->temporal;
 				context->changed_temporal = TRUE;
 			}
-		} else if(context->temporal_target < context->temporal) {
+		} else if(temporal_target < context->temporal) {
 			/* We need to downscale */
-			if(t->temporal == context->temporal_target) {
-				context->temporal = context->temporal_target;
+			if(t->temporal == temporal_target) {
+				context->temporal = temporal_target;
 				context->changed_temporal = TRUE;
 			}
 		}
@@ -1579,12 +1857,12 @@ gboolean janus_rtp_svc_context_process_rtp(janus_rtp_svc_context *context,
 	int spatial_layer = context->spatial;
 	if(svc_info.spatial_layer >= 0 && svc_info.spatial_layer <= 2)
 		context->last_spatial_layer[svc_info.spatial_layer] = now;
-	if(context->spatial_target > context->spatial) {
+	if(spatial_target > context->spatial) {
 		JANUS_LOG(LOG_HUGE, "We need to upscale spatially: (%d < %d)\n",
-			context->spatial, context->spatial_target);
+			context->spatial, spatial_target);
 		/* We need to upscale: wait for a keyframe */
 		if(keyframe) {
-			int new_spatial_layer = context->spatial_target;
+			int new_spatial_layer = spatial_target;
 			while(new_spatial_layer > context->spatial && new_spatial_layer > 0) {
 				if(now - context->last_spatial_layer[new_spatial_layer] >= (context->drop_trigger ? context->drop_trigger : 250000)) {
 					/* We haven't received packets from this layer for a while, try a lower layer */
@@ -1597,16 +1875,16 @@ gboolean janus_rtp_svc_context_process_rtp(janus_rtp_svc_context *context,
 			}
 			if(new_spatial_layer > context->spatial) {
 				JANUS_LOG(LOG_HUGE, "  -- Upscaling spatial layer: %d --> %d (need %d)\n",
-					context->spatial, new_spatial_layer, context->spatial_target);
+					context->spatial, new_spatial_layer, spatial_target);
 				context->spatial = new_spatial_layer;
 				spatial_layer = context->spatial;
 				context->changed_spatial = TRUE;
 			}
 		}
-	} else if(context->spatial_target < context->spatial) {
+	} else if(spatial_target < context->spatial) {
 		/* We need to downscale */
 		JANUS_LOG(LOG_HUGE, "We need to downscale spatially: (%d > %d)\n",
-			context->spatial, context->spatial_target);
+			context->spatial, spatial_target);
 		gboolean downscaled = FALSE;
 		if(!svc_info.fbit && keyframe) {
 			/* Non-flexible mode: wait for a keyframe */
@@ -1617,8 +1895,8 @@ gboolean janus_rtp_svc_context_process_rtp(janus_rtp_svc_context *context,
 		}
 		if(downscaled) {
 			JANUS_LOG(LOG_HUGE, "  -- Downscaling spatial layer: %d --> %d\n",
-				context->spatial, context->spatial_target);
-			context->spatial = context->spatial_target;
+				context->spatial, spatial_target);
+			context->spatial = spatial_target;
 			context->changed_spatial = TRUE;
 		}
 	}
@@ -1633,27 +1911,27 @@ gboolean janus_rtp_svc_context_process_rtp(janus_rtp_svc_context *context,
 		override_mark_bit = TRUE;
 	}
 	int temporal_layer = context->temporal;
-	if(context->temporal_target > context->temporal) {
+	if(temporal_target > context->temporal) {
 		/* We need to upscale */
 		JANUS_LOG(LOG_HUGE, "We need to upscale temporally: (%d < %d)\n",
-			context->temporal, context->temporal_target);
+			context->temporal, temporal_target);
 		if(svc_info.ubit && svc_info.bbit &&
 				svc_info.temporal_layer > context->temporal &&
-				svc_info.temporal_layer <= context->temporal_target) {
+				svc_info.temporal_layer <= temporal_target) {
 			JANUS_LOG(LOG_HUGE, "  -- Upscaling temporal layer: %d --> %d (want %d)\n",
-				context->temporal, svc_info.temporal_layer, context->temporal_target);
+				context->temporal, svc_info.temporal_layer, temporal_target);
 			context->temporal = svc_info.temporal_layer;
 			temporal_layer = context->temporal;
 			context->changed_temporal = TRUE;
 		}
-	} else if(context->temporal_target < context->temporal) {
+	} else if(temporal_target < context->temporal) {
 		/* We need to downscale */
 		JANUS_LOG(LOG_HUGE, "We need to downscale temporally: (%d > %d)\n",
-			context->temporal, context->temporal_target);
-		if(svc_info.ebit && svc_info.temporal_layer == context->temporal_target) {
+			context->temporal, temporal_target);
+		if(svc_info.ebit && svc_info.temporal_layer == temporal_target) {
 			JANUS_LOG(LOG_HUGE, "  -- Downscaling temporal layer: %d --> %d\n",
-				context->temporal, context->temporal_target);
-			context->temporal = context->temporal_target;
+				context->temporal, temporal_target);
+			context->temporal = temporal_target;
 			context->changed_temporal = TRUE;
 		}
 	}
@@ -57,6 +57,61 @@ typedef struct rtp_header
 } rtp_header;
 typedef rtp_header janus_rtp_header;
 
+/*! \brief Counters for payloads shared by many PeerConnections for retransmissions
+ * @note Plugins can use a single instance for a whole room, and pass
+ * it to all the janus_rtp_shared_packet instances they create: the
+ * counters are updated atomically, as packets are referenced and released */
+typedef struct janus_rtp_shared_stats {
+	/*! \brief Number of shared payloads currently alive */
+	volatile gint packets;
+	/*! \brief Bytes currently allocated for shared payloads */
+	volatile gint bytes;
+	/*! \brief Bytes that would have been allocated, if each reference had its own copy */
+	volatile gint referenced_bytes;
+	/*! \brief Atomic reference counter */
+	janus_refcount ref;
+} janus_rtp_shared_stats;
+/*! \brief Helper method to create a new janus_rtp_shared_stats instance
+ * @returns A pointer to a new janus_rtp_shared_stats instance */
+janus_rtp_shared_stats *janus_rtp_shared_stats_create(void);
+/*! \brief Helper method to release a reference to a janus_rtp_shared_stats instance
+ * @param[in] stats The janus_rtp_shared_stats instance to release */
+void janus_rtp_shared_stats_destroy(janus_rtp_shared_stats *stats);
+/*! \brief Helper method to get how many bytes sharing payloads is currently saving
+ * @param[in] stats The janus_rtp_shared_stats instance to query
+ * @returns The number of bytes saved */
+gint janus_rtp_shared_stats_saved_bytes(janus_rtp_shared_stats *stats);
+
+/*! \brief Refcounted copy of the payload of an RTP packet, that many
+ * PeerConnections can reference for RFC4588 retransmissions, rather
+ * than each of them storing a copy of its own
+ * @note The payload MUST be the same that is being relayed: plugins that
+ * modify the payload for a specific recipient (e.g., VP8 simulcast) must
+ * not attach a shared packet to what they send to that recipient */
+typedef struct janus_rtp_shared_packet {
+	/*! \brief Copy of the payload */
+	char *payload;
+	/*! \brief Length of the payload */
+	gint length;
+	/*! \brief Stats to update, if any */
+	janus_rtp_shared_stats *stats;
+	/*! \brief Atomic reference counter */
+	janus_refcount ref;
+} janus_rtp_shared_packet;
+/*! \brief Helper method to create a shared copy of the payload of an RTP packet
+ * @note The new instance has a single reference, owned by the caller
+ * @param[in] buf The RTP packet
+ * @param[in] len The RTP packet length
+ * @param[in] stats The janus_rtp_shared_stats instance to update, if any
+ * @returns A pointer to a new janus_rtp_shared_packet instance, or NULL if the packet has no payload */
+janus_rtp_shared_packet *janus_rtp_shared_packet_create(char *buf, int len, janus_rtp_shared_stats *stats);
+/*! \brief Helper method to add a reference to a janus_rtp_shared_packet instance
+ * @param[in] packet The janus_rtp_shared_packet instance to reference */
+void janus_rtp_shared_packet_ref(janus_rtp_shared_packet *packet);
+/*! \brief Helper method to release a reference to a janus_rtp_shared_packet instance
+ * @param[in] packet The janus_rtp_shared_packet instance to release */
+void janus_rtp_shared_packet_unref(janus_rtp_shared_packet *packet);
+
 /*! \brief RTP packet */
 typedef struct janus_rtp_packet {
 	char *data;
@@ -64,6 +119,8 @@ typedef struct janus_rtp_packet {
 	gint64 created;
 	gint64 last_retransmit;
 	gint64 current_backoff;
+	/* If a shared payload is referenced, data only contains the RTP header we sent */
+	janus_rtp_shared_packet *shared;
 	janus_plugin_rtp_extensions extensions;
 } janus_rtp_packet;
 
@@ -304,6 +361,69 @@ int janus_rtp_header_extension_parse_video_layers_allocation(char *buf, int len,
  * @returns 0 if found, a negative integer otherwise */
 int janus_rtp_header_extension_replace_id(char *buf, int len, int id, int new_id);
 
+/*! \brief RTP extensions the core knows how to parse */
+typedef enum janus_rtp_extension_type {
+	JANUS_RTP_EXTENSION_NONE = 0,
+	JANUS_RTP_EXTENSION_AUDIO_LEVEL,
+	JANUS_RTP_EXTENSION_VIDEO_ORIENTATION,
+	JANUS_RTP_EXTENSION_PLAYOUT_DELAY,
+	JANUS_RTP_EXTENSION_TRANSPORT_WIDE_CC,
+	JANUS_RTP_EXTENSION_ABS_SEND_TIME,
+	JANUS_RTP_EXTENSION_ABS_CAPTURE_TIME,
+	JANUS_RTP_EXTENSION_MID,
+	JANUS_RTP_EXTENSION_RID,
+	JANUS_RTP_EXTENSION_REPAIRED_RID,
+	JANUS_RTP_EXTENSION_DEPENDENCY_DESC,
+	JANUS_RTP_EXTENSION_VIDEO_LAYERS
+} janus_rtp_extension_type;
+
+/*! \brief Lookup table mapping negotiated RTP extension IDs to their type,
+ * to be built once when negotiating, rather than for each packet */
+typedef struct janus_rtp_extension_map {
+	/*! \brief janus_rtp_extension_type of each extension ID (1-255) */
+	uint8_t types[256];
+} janus_rtp_extension_map;
+
+/*! \brief Helper to reset an RTP extension map, removing all mappings
+ * @param[in] map The janus_rtp_extension_map instance to reset */
+void janus_rtp_extension_map_reset(janus_rtp_extension_map *map);
+
+/*! \brief Helper to map an extension ID to an extension type
+ * @note Invalid IDs (e.g., 0 or -1 to mean "not negotiated") are ignored
+ * @param[in] map The janus_rtp_extension_map instance to update
+ * @param[in] id The negotiated extension ID
+ * @param[in] type The janus_rtp_extension_type to map the ID to */
+void janus_rtp_extension_map_set(janus_rtp_extension_map *map, int id, janus_rtp_extension_type type);
+
+/*! \brief RTP extensions parsed by janus_rtp_header_extensions_parse that
+ * are not exposed to plugins via janus_plugin_rtp_extensions
+ * @note The SDES items point to the packet buffer, and are NOT null-terminated */
+typedef struct janus_rtp_header_extensions_info {
+	/*! \brief Transport wide sequence number; -1 means no extension */
+	int32_t transport_seq_num;
+	/*! \brief Absolute Send Time (24 bits); -1 means no extension */
+	int32_t abs_send_time;
+	/*! \brief mid, rid and repaired-rid SDES items, if available */
+	const char *mid, *rid, *repaired_rid;
+	/*! \brief Length of the mid, rid and repaired-rid SDES items */
+	uint8_t mid_len, rid_len, repaired_rid_len;
+} janus_rtp_header_extensions_info;
+
+/*! \brief Helper to parse all the known RTP extensions in a packet in a single pass
+ * @note Unlike the individual janus_rtp_header_extension_parse_* helpers, which
+ * walk the extensions block each time they're invoked, this walks the block
+ * only once, and uses a map to figure out which extension each ID refers to.
+ * Extensions that are not found are left untouched in \c extensions, so it's
+ * up to the caller to reset it first, while \c info is always reset
+ * @param[in] buf The packet data
+ * @param[in] len The packet data length in bytes
+ * @param[in] map The janus_rtp_extension_map with the negotiated IDs
+ * @param[out] extensions The janus_plugin_rtp_extensions instance to fill in, if needed
+ * @param[out] info The janus_rtp_header_extensions_info instance to fill in, if needed
+ * @returns The number of extensions that were parsed, or a negative integer in case of errors */
+int janus_rtp_header_extensions_parse(char *buf, int len, const janus_rtp_extension_map *map,
+	janus_plugin_rtp_extensions *extensions, janus_rtp_header_extensions_info *info);
+
 /*! \brief RTP context, in order to make sure SSRC changes result in coherent seq/ts increases */
 typedef struct janus_rtp_switching_context {
 	uint32_t last_ssrc, last_ts, base_ts, base_ts_prev, prev_ts, target_ts, start_ts;
@@ -408,6 +528,9 @@ typedef struct janus_rtp_simulcasting_context {
 	int templayer;
 	/*! \brief As above, but to handle transitions (e.g., wait for keyframe) */
 	int templayer_target;
+	/*! \brief Highest substream and temporal layer we can relay, whatever the targets (e.g., because
+	 * of the bandwidth we estimated we can send), or -1 if there's no cap */
+	int substream_max, templayer_max;
 	/*! \brief How much time (in us, default 250000) without receiving packets will make us drop to the substream below */
 	guint32 drop_trigger;
 	/*! \brief When we relayed the last packet (used to detect when substreams become unavailable) */
@@ -474,6 +597,9 @@ typedef struct janus_rtp_svc_context {
 	int temporal;
 	/*! \brief As above, but to handle transitions (e.g., wait for keyframe) */
 	int temporal_target;
+	/*! \brief Highest spatial and temporal layer we can relay, whatever the targets (e.g., because
+	 * of the bandwidth we estimated we can send), or -1 if there's no cap */
+	int spatial_max, temporal_max;
 	/*! \brief How much time (in us, default 250000) without receiving packets will make us drop to the substream below */
 	guint32 drop_trigger;
 	/*! \brief When we relayed the last packet (used to detect when layers become unavailable) */
@@ -118,7 +118,7 @@ void janus_sctp_handle_adaptation_indication(struct sctp_adaptation_event *sai);
 void janus_sctp_handle_shutdown_event(struct sctp_shutdown_event *sse);
 void janus_sctp_handle_stream_reset_event(janus_sctp_association *sctp, struct sctp_stream_reset_event *strrst);
 void janus_sctp_handle_remote_error_event(struct sctp_remote_error *sre);
-void janus_sctp_handle_send_failed_event(struct sctp_send_failed_event *ssfe);
+void janus_sctp_handle_send_failed_event(janus_sctp_association *sctp, struct sctp_send_failed_event *ssfe);
 void janus_sctp_handle_notification(janus_sctp_association *sctp, union sctp_notification *notif, size_t n);
 
 /* We need to keep a map of associations with random IDs, as usrsctp will
@@ -127,6 +127,40 @@ static janus_mutex sctp_mutex = JANUS_MUTEX_INITIALIZER;
 static GHashTable *sctp_ids = NULL;
 static void janus_sctp_association_unref(janus_sctp_association *sctp);
 
+/* DataChannel workers: when enabled, each association is pinned to a
+ * worker, which takes care of all its incoming records and outgoing
+ * messages in batches, rather than the event loop of the handle */
+#define JANUS_SCTP_MAX_INCOMING		(1<<20)
+typedef struct janus_sctp_worker {
+	guint id;
+	GThread *thread;
+	/* Associations with something to process */
+	GAsyncQueue *queue;
+	/* How many associations are pinned to this worker */
+	volatile gint associations;
+} janus_sctp_worker;
+static janus_sctp_worker **sctp_workers = NULL;
+static guint sctp_workers_num = 0;
+static char sctp_worker_exit;
+/* Record from DTLS, or message from a plugin, waiting for the worker (or
+ * a request to close the association, once everything before it is done) */
+typedef struct janus_sctp_item {
+	gboolean outgoing, textdata, close;
+	char *label, *protocol;
+	size_t len;
+	char data[];
+} janus_sctp_item;
+static void janus_sctp_item_free(janus_sctp_item *item) {
+	if(item == NULL)
+		return;
+	g_free(item->label);
+	g_free(item->protocol);
+	g_free(item);
+}
+static void janus_sctp_conninput(janus_sctp_association *sctp, char *buf, int len);
+static void janus_sctp_association_close(janus_sctp_association *sctp);
+static void janus_sctp_send_data_internal(janus_sctp_association *sctp, char *label, char *protocol, gboolean textdata, char *buf, int len);
+
 /* SCTP management code */
 static gboolean sctp_running;
 int janus_sctp_init(void) {
@@ -148,6 +182,17 @@ int janus_sctp_init(void) {
 }
 
 void janus_sctp_deinit(void) {
+	/* Stop the workers, if any: they'll process what's still queued first */
+	guint i = 0;
+	for(i=0; i<sctp_workers_num; i++)
+		g_async_queue_push(sctp_workers[i]->queue, &sctp_worker_exit);
+	for(i=0; i<sctp_workers_num; i++) {
+		g_thread_join(sctp_workers[i]->thread);
+		g_async_queue_unref(sctp_workers[i]->queue);
+		g_free(sctp_workers[i]);
+	}
+	g_clear_pointer(&sctp_workers, g_free);
+	sctp_workers_num = 0;
 	usrsctp_finish();
 	sctp_running = FALSE;
 	janus_mutex_lock(&sctp_mutex);
@@ -160,6 +205,122 @@ static void janus_sctp_association_unref(janus_sctp_association *sctp) {
 		janus_refcount_decrease(&sctp->ref);
 }
 
+/* Thread processing the associations pinned to a worker */
+static void *janus_sctp_worker_thread(void *data) {
+	janus_sctp_worker *worker = (janus_sctp_worker *)data;
+	JANUS_LOG(LOG_VERB, "Joining DataChannel worker #%u\n", worker->id);
+	janus_sctp_association *sctp = NULL;
+	while((sctp = g_async_queue_pop(worker->queue)) != (janus_sctp_association *)&sctp_worker_exit) {
+		/* Take everything that's been queued so far for this association,
+		 * so that new records can be added while we process the batch */
+		janus_mutex_lock(&sctp->mutex);
+		GQueue batch = *sctp->incoming;
+		g_queue_init(sctp->incoming);
+		sctp->incoming_bytes = 0;
+		sctp->scheduled = FALSE;
+		if(batch.length > 0)
+			sctp->batches++;
+		janus_mutex_unlock(&sctp->mutex);
+		janus_sctp_item *item = NULL;
+		while((item = g_queue_pop_head(&batch)) != NULL) {
+			if(item->close) {
+				/* The socket is only ever used by this thread, so it's safe to close it here */
+				janus_sctp_association_close(sctp);
+			} else if(!g_atomic_int_get(&sctp->destroyed)) {
+				if(item->outgoing)
+					janus_sctp_send_data_internal(sctp, item->label, item->protocol, item->textdata, item->data, item->len);
+				else
+					janus_sctp_conninput(sctp, item->data, item->len);
+			}
+			janus_sctp_item_free(item);
+		}
+		janus_refcount_decrease(&sctp->ref);
+	}
+	JANUS_LOG(LOG_VERB, "Leaving DataChannel worker #%u\n", worker->id);
+	return NULL;
+}
+
+int janus_sctp_set_workers(guint workers) {
+	if(workers == 0 || sctp_workers != NULL)
+		return 0;
+	sctp_workers = g_malloc0(workers * sizeof(janus_sctp_worker *));
+	guint i = 0;
+	for(i=0; i<workers; i++) {
+		janus_sctp_worker *worker = g_malloc0(sizeof(janus_sctp_worker));
+		worker->id = i;
+		worker->queue = g_async_queue_new();
+		GError *error = NULL;
+		char tname[16];
+		g_snprintf(tname, sizeof(tname), "sctp %u", i);
+		worker->thread = g_thread_try_new(tname, janus_sctp_worker_thread, worker, &error);
+		if(error != NULL) {
+			JANUS_LOG(LOG_FATAL, "Got error %d (%s) trying to launch the DataChannel worker #%u...\n",
+				error->code, error->message ? error->message : "??", i);
+			g_error_free(error);
+			g_async_queue_unref(worker->queue);
+			g_free(worker);
+			return -1;
+		}
+		sctp_workers[i] = worker;
+		sctp_workers_num++;
+	}
+	JANUS_LOG(LOG_INFO, "DataChannels will be processed by %u worker threads\n", workers);
+	return 0;
+}
+
+guint janus_sctp_get_workers(void) {
+	return sctp_workers_num;
+}
+
+json_t *janus_sctp_get_stats(void) {
+	json_t *stats = json_object();
+	json_object_set_new(stats, "workers", json_integer(sctp_workers_num));
+	if(sctp_workers_num > 0) {
+		json_t *list = json_array();
+		guint i = 0;
+		for(i=0; i<sctp_workers_num; i++) {
+			json_t *w = json_object();
+			json_object_set_new(w, "id", json_integer(i));
+			json_object_set_new(w, "associations", json_integer(g_atomic_int_get(&sctp_workers[i]->associations)));
+			json_object_set_new(w, "scheduled", json_integer(g_async_queue_length(sctp_workers[i]->queue)));
+			json_array_append_new(list, w);
+		}
+		json_object_set_new(stats, "list", list);
+	}
+	return stats;
+}
+
+/* Helper to queue a record or a message for the worker of an association */
+static void janus_sctp_schedule(janus_sctp_association *sctp, janus_sctp_item *item) {
+	janus_mutex_lock(&sctp->mutex);
+	if(!item->outgoing && !item->close && sctp->incoming_bytes + item->len > JANUS_SCTP_MAX_INCOMING) {
+		/* The worker can't keep up, drop the record: SCTP will retransmit */
+		sctp->incoming_dropped++;
+		janus_mutex_unlock(&sctp->mutex);
+		JANUS_LOG(LOG_HUGE, "[%"SCNu64"] DataChannel worker queue full, dropping record (%zu bytes)\n",
+			sctp->handle_id, item->len);
+		janus_sctp_item_free(item);
+		return;
+	}
+	g_queue_push_tail(sctp->incoming, item);
+	sctp->incoming_bytes += item->len;
+	if(!sctp->scheduled) {
+		/* Wake up the worker, unless it knows about this association already */
+		sctp->scheduled = TRUE;
+		janus_refcount_increase(&sctp->ref);
+		g_async_queue_push(sctp->worker->queue, sctp);
+	}
+	janus_mutex_unlock(&sctp->mutex);
+}
+
+/* Helper to add a message to the queue of those waiting to be sent (must be called with the mutex locked) */
+static void janus_sctp_queue_pending_message(janus_sctp_association *sctp, janus_sctp_pending_message *m) {
+	if(sctp->pending_messages == NULL)
+		sctp->pending_messages = g_queue_new();
+	g_queue_push_tail(sctp->pending_messages, m);
+	sctp->queued_bytes += m->len;
+}
+
 static void janus_sctp_association_free(const janus_refcount *sctp_ref) {
 	janus_sctp_association *sctp = janus_refcount_containerof(sctp_ref, janus_sctp_association, ref);
 	/* This association can be destroyed, free all the resources */
@@ -167,6 +328,9 @@ static void janus_sctp_association_free(const janus_refcount *sctp_ref) {
 	janus_refcount_decrease(&sctp->dtls->ref);
 	if(sctp->pending_messages != NULL)
 		g_queue_free_full(sctp->pending_messages, (GDestroyNotify)janus_sctp_pending_message_free);
+	if(sctp->incoming != NULL)
+		g_queue_free_full(sctp->incoming, (GDestroyNotify)janus_sctp_item_free);
+	janus_mutex_destroy(&sctp->mutex);
 #ifdef DEBUG_SCTP
 	if(sctp->debug_dump != NULL)
 		fclose(sctp->debug_dump);
@@ -199,6 +363,21 @@ janus_sctp_association *janus_sctp_association_create(janus_dtls_srtp *dtls, jan
 	sctp->buflen = 0;
 	sctp->offset = 0;
 	sctp->pending_messages = NULL;
+	janus_mutex_init(&sctp->mutex);
+	if(sctp_workers_num > 0) {
+		/* Pin the association to the least loaded worker */
+		janus_sctp_worker *worker = NULL;
+		guint i = 0;
+		for(i=0; i<sctp_workers_num; i++) {
+			if(worker == NULL || g_atomic_int_get(&sctp_workers[i]->associations) < g_atomic_int_get(&worker->associations))
+				worker = sctp_workers[i];
+		}
+		g_atomic_int_inc(&worker->associations);
+		sctp->worker = worker;
+		sctp->incoming = g_queue_new();
+		JANUS_LOG(LOG_VERB, "[%"SCNu64"] SCTP association pinned to DataChannel worker #%u\n",
+			sctp->handle_id, worker->id);
+	}
 #ifdef DEBUG_SCTP
 	sctp->debug_dump = NULL;
 #endif
@@ -358,6 +537,20 @@ void janus_sctp_association_destroy(janus_sctp_association *sctp) {
 	if(sctp == NULL || !g_atomic_int_compare_and_exchange(&sctp->destroyed, 0, 1))
 		return;
 
+	if(sctp->worker != NULL) {
+		/* The worker may be using the socket right now: let it close the
+		 * association itself, after the records and messages queued so far */
+		g_atomic_int_dec_and_test(&sctp->worker->associations);
+		janus_sctp_item *item = g_malloc0(sizeof(janus_sctp_item));
+		item->close = TRUE;
+		janus_sctp_schedule(sctp, item);
+	} else {
+		janus_sctp_association_close(sctp);
+	}
+	janus_refcount_decrease(&sctp->ref);
+}
+
+static void janus_sctp_association_close(janus_sctp_association *sctp) {
 	if(sctp->map_id != 0) {
 		usrsctp_deregister_address(GUINT_TO_POINTER(sctp->map_id));
 		janus_mutex_lock(&sctp_mutex);
@@ -367,13 +560,25 @@ void janus_sctp_association_destroy(janus_sctp_association *sctp) {
 	if(sctp->sock != NULL) {
 		usrsctp_shutdown(sctp->sock, SHUT_RDWR);
 		usrsctp_close(sctp->sock);
+		sctp->sock = NULL;
 	}
-	janus_refcount_decrease(&sctp->ref);
 }
 
 void janus_sctp_data_from_dtls(janus_sctp_association *sctp, char *buf, int len) {
 	if(sctp == NULL || sctp->handle == NULL || buf == NULL || len <= 0)
 		return;
+	if(sctp->worker != NULL) {
+		/* Let the worker feed this to the SCTP stack */
+		janus_sctp_item *item = g_malloc0(sizeof(janus_sctp_item) + len);
+		item->len = len;
+		memcpy(item->data, buf, len);
+		janus_sctp_schedule(sctp, item);
+		return;
+	}
+	janus_sctp_conninput(sctp, buf, len);
+}
+
+static void janus_sctp_conninput(janus_sctp_association *sctp, char *buf, int len) {
 	JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Data from DTLS to SCTP stack: %d bytes\n", sctp->handle_id, len);
 #ifdef DEBUG_SCTP
 	if(sctp->debug_dump != NULL) {
@@ -436,6 +641,22 @@ void janus_sctp_send_data(janus_sctp_association *sctp, char *label, char *proto
 
 	if(buf == NULL || len <= 0)
 		return;
+	if(sctp->worker != NULL) {
+		/* Let the worker send this, after what it may have queued already */
+		janus_sctp_item *item = g_malloc0(sizeof(janus_sctp_item) + len);
+		item->outgoing = TRUE;
+		item->textdata = textdata;
+		item->label = g_strdup(label);
+		item->protocol = g_strdup(protocol);
+		item->len = len;
+		memcpy(item->data, buf, len);
+		janus_sctp_schedule(sctp, item);
+		return;
+	}
+	janus_sctp_send_data_internal(sctp, label, protocol, textdata, buf, len);
+}
+
+static void janus_sctp_send_data_internal(janus_sctp_association *sctp, char *label, char *protocol, gboolean textdata, char *buf, int len) {
 	if(label == NULL)
 		label = (char *)default_label;
 	JANUS_LOG(LOG_VERB, "[%"SCNu64"] SCTP data to send (label=%s, %d bytes) coming from a plugin.\n",
@@ -471,30 +692,53 @@ void janus_sctp_send_data(janus_sctp_association *sctp, char *label, char *proto
 		}
 	}
 	/* Send the data, whether it's text or binary */
-	if(sctp->pending_messages != NULL && !g_queue_is_empty(sctp->pending_messages)) {
+	janus_mutex_lock(&sctp->mutex);
+	if(sctp->flushing || (sctp->pending_messages != NULL && !g_queue_is_empty(sctp->pending_messages))) {
 		/* We couldn't send all pending messages, queue the new one as well */
-		if(buf != NULL && len > 0) {
-			JANUS_LOG(LOG_WARN, "[%"SCNu64"] Couldn't send all pending messages, queueing new message\n",
-				sctp->handle_id);
-			janus_sctp_pending_message *m = janus_sctp_pending_message_create(i, textdata, buf, len);
-			if(sctp->pending_messages == NULL)
-				sctp->pending_messages = g_queue_new();
-			g_queue_push_tail(sctp->pending_messages, m);
-		}
+		JANUS_LOG(LOG_WARN, "[%"SCNu64"] Couldn't send all pending messages, queueing new message\n",
+			sctp->handle_id);
+		janus_sctp_queue_pending_message(sctp, janus_sctp_pending_message_create(i, textdata, buf, len));
+		janus_mutex_unlock(&sctp->mutex);
 		return;
 	}
+	janus_mutex_unlock(&sctp->mutex);
 	int res = janus_sctp_send_text_or_binary(sctp, i, textdata, buf, len);
 	if(res == -2) {
 		/* Delivery failed with an EAGAIN, queue and retry later */
 		JANUS_LOG(LOG_WARN, "[%"SCNu64"] Got EAGAIN when trying to send message on channel %d, retrying later\n",
 			sctp->handle_id, i);
-		janus_sctp_pending_message *m = janus_sctp_pending_message_create(i, textdata, buf, len);
-		if(sctp->pending_messages == NULL)
-			sctp->pending_messages = g_queue_new();
-		g_queue_push_tail(sctp->pending_messages, m);
+		janus_mutex_lock(&sctp->mutex);
+		janus_sctp_queue_pending_message(sctp, janus_sctp_pending_message_create(i, textdata, buf, len));
+		janus_mutex_unlock(&sctp->mutex);
+	} else if(res == -1) {
+		janus_mutex_lock(&sctp->mutex);
+		sctp->send_failures++;
+		janus_mutex_unlock(&sctp->mutex);
 	}
 }
 
+json_t *janus_sctp_association_stats(janus_sctp_association *sctp) {
+	if(sctp == NULL)
+		return NULL;
+	json_t *stats = json_object();
+	janus_mutex_lock(&sctp->mutex);
+	json_object_set_new(stats, "messages-in", json_integer(sctp->messages_in));
+	json_object_set_new(stats, "messages-out", json_integer(sctp->messages_out));
+	json_object_set_new(stats, "queued-messages", json_integer(sctp->pending_messages ? g_queue_get_length(sctp->pending_messages) : 0));
+	json_object_set_new(stats, "queued-bytes", json_integer(sctp->queued_bytes));
+	json_object_set_new(stats, "send-failures", json_integer(sctp->send_failures));
+	if(sctp->worker != NULL) {
+		json_t *worker = json_object();
+		json_object_set_new(worker, "id", json_integer(sctp->worker->id));
+		json_object_set_new(worker, "queued-bytes", json_integer(sctp->incoming_bytes));
+		json_object_set_new(worker, "batches", json_integer(sctp->batches));
+		json_object_set_new(worker, "dropped", json_integer(sctp->incoming_dropped));
+		json_object_set_new(stats, "worker", worker);
+	}
+	janus_mutex_unlock(&sctp->mutex);
+	return stats;
+}
+
 
 /* From now on, it's SCTP stuff */
 janus_sctp_channel *janus_sctp_find_channel_by_stream(janus_sctp_association *sctp, uint16_t stream) {
@@ -828,6 +1072,9 @@ int janus_sctp_send_text_or_binary(janus_sctp_association *sctp, uint16_t id, gb
 		return -1;
 	}
 	JANUS_LOG(LOG_VERB, "[%"SCNu64"] Message sent on channel %"SCNu16"\n", sctp->handle_id, id);
+	janus_mutex_lock(&sctp->mutex);
+	sctp->messages_out++;
+	janus_mutex_unlock(&sctp->mutex);
 	return 0;
 }
 
@@ -891,21 +1138,31 @@ void janus_sctp_data_ready(janus_sctp_association *sctp) {
 	if(sctp == NULL || g_atomic_int_get(&sctp->destroyed))
 		return;
 
-	if(sctp->pending_messages != NULL && !g_queue_is_empty(sctp->pending_messages)) {
-		/* Messages waiting in the queue, send those first */
-		janus_sctp_pending_message *m = g_queue_peek_head(sctp->pending_messages);
+	janus_mutex_lock(&sctp->mutex);
+	if(!sctp->flushing && sctp->pending_messages != NULL && !g_queue_is_empty(sctp->pending_messages)) {
+		/* Messages waiting in the queue, send those first: we don't keep the
+		 * mutex locked while sending, as usrsctp may invoke our callbacks */
+		sctp->flushing = TRUE;
+		janus_sctp_pending_message *m = g_queue_pop_head(sctp->pending_messages);
 		while(m != NULL) {
+			janus_mutex_unlock(&sctp->mutex);
 			int res = janus_sctp_send_text_or_binary(sctp, m->id, m->textdata, m->buf, m->len);
+			janus_mutex_lock(&sctp->mutex);
 			if(res == -2) {
 				JANUS_LOG(LOG_WARN, "[%"SCNu64"] Got EAGAIN when trying to resend pending message on channel %"SCNu16"\n",
 					sctp->handle_id, m->id);
+				g_queue_push_head(sctp->pending_messages, m);
 				break;
 			}
-			(void)g_queue_pop_head(sctp->pending_messages);
+			if(res == -1)
+				sctp->send_failures++;
+			sctp->queued_bytes -= m->len;
 			janus_sctp_pending_message_free(m);
-			m = g_queue_peek_head(sctp->pending_messages);
+			m = g_queue_pop_head(sctp->pending_messages);
 		}
+		sctp->flushing = FALSE;
 	}
+	janus_mutex_unlock(&sctp->mutex);
 
 	janus_dtls_sctp_data_ready(sctp->dtls);
 }
@@ -1093,6 +1350,9 @@ void janus_sctp_handle_data_message(janus_sctp_association *sctp, gboolean textd
 			sctp->handle_id, length, channel->id);
 		JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Incoming SCTP contents: %.*s\n",
 			sctp->handle_id, (int)length, buffer);
+		janus_mutex_lock(&sctp->mutex);
+		sctp->messages_in++;
+		janus_mutex_unlock(&sctp->mutex);
 		/* Pass this to the core */
 		janus_dtls_notify_sctp_data(sctp->dtls, channel->label,
 			strlen(channel->protocol) ? channel->protocol : NULL,
@@ -1370,9 +1630,15 @@ void janus_sctp_handle_remote_error_event(struct sctp_remote_error *sre) {
 	return;
 }
 
-void janus_sctp_handle_send_failed_event(struct sctp_send_failed_event *ssfe) {
+void janus_sctp_handle_send_failed_event(janus_sctp_association *sctp, struct sctp_send_failed_event *ssfe) {
 	size_t i, n;
 
+	if(sctp != NULL) {
+		janus_mutex_lock(&sctp->mutex);
+		sctp->send_failures++;
+		janus_mutex_unlock(&sctp->mutex);
+	}
+
 	if(ssfe->ssfe_flags & SCTP_DATA_UNSENT) {
 		JANUS_LOG(LOG_VERB, "Unsent ");
 	}
@@ -1425,7 +1691,7 @@ void janus_sctp_handle_notification(janus_sctp_association *sctp, union sctp_not
 		case SCTP_NOTIFICATIONS_STOPPED_EVENT:
 			break;
 		case SCTP_SEND_FAILED_EVENT:
-			janus_sctp_handle_send_failed_event(&(notif->sn_send_failed_event));
+			janus_sctp_handle_send_failed_event(sctp, &(notif->sn_send_failed_event));
 			break;
 		case SCTP_STREAM_RESET_EVENT:
 			janus_sctp_handle_stream_reset_event(sctp, &(notif->sn_strreset_event));
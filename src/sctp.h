@@ -42,6 +42,7 @@
 #include <errno.h>
 #include <usrsctp.h>
 #include <glib.h>
+#include <jansson.h>
 
 #include "mutex.h"
 #include "refcount.h"
@@ -54,6 +55,25 @@ int janus_sctp_init(void);
 /*! \brief SCTP stuff de-initialization */
 void janus_sctp_deinit(void);
 
+/*! \brief Method to offload DataChannel processing to a set of worker threads
+ * @note By default, data coming from DTLS is fed to the SCTP stack, and
+ * messages from plugins are sent, on the event loop of the handle, which
+ * means heavy DataChannel traffic competes with the media of all the other
+ * handles on that loop. With workers, each association is pinned to one of
+ * them (the least loaded when it's created): both incoming records and
+ * outgoing messages are queued there and processed in batches, in order.
+ * Notice that, when enabled, the plugins' \c incoming_data callback is
+ * invoked by the worker thread, rather than by the event loop of the handle.
+ * @param[in] workers Number of worker threads to start (0 keeps processing on the loops)
+ * @returns 0 in case of success, a negative integer otherwise */
+int janus_sctp_set_workers(guint workers);
+/*! \brief Method to get the number of DataChannel workers, if any
+ * @returns The number of workers, or 0 if processing happens on the event loops */
+guint janus_sctp_get_workers(void);
+/*! \brief Method to get a summary of the DataChannel workers, for the info request
+ * @returns A JSON object with the number of workers, and how loaded each of them is */
+json_t *janus_sctp_get_stats(void);
+
 
 #define BUFFER_SIZE (1<<16)
 #define NUMBER_OF_CHANNELS (150)
@@ -129,6 +149,19 @@ typedef struct janus_sctp_association {
 	size_t offset;
 	/*! \brief Buffer of pending messages */
 	GQueue *pending_messages;
+	/*! \brief Whether the buffer of pending messages is being flushed right now */
+	gboolean flushing;
+	/*! \brief Worker this association is pinned to, if DataChannel processing is offloaded */
+	struct janus_sctp_worker *worker;
+	/*! \brief Records and messages waiting for the worker, and whether the association is already queued there */
+	GQueue *incoming;
+	gboolean scheduled;
+	/*! \brief Bytes waiting for the worker, and bytes waiting in the buffer of pending messages */
+	size_t incoming_bytes, queued_bytes;
+	/*! \brief Messages received and sent, and batches the worker processed */
+	guint64 messages_in, messages_out, batches;
+	/*! \brief Messages the SCTP stack refused or failed to deliver, and records dropped as the worker queue was full */
+	guint64 send_failures, incoming_dropped;
 #ifdef DEBUG_SCTP
 	FILE *debug_dump;
 #endif
@@ -215,6 +248,11 @@ void janus_sctp_data_from_dtls(janus_sctp_association *sctp, char *buf, int len)
  * \param[in] len The buffer length */
 void janus_sctp_send_data(janus_sctp_association *sctp, char *label, char *protocol, gboolean textdata, char *buf, int len);
 
+/*! \brief Method to get the counters of an SCTP association, for the handle info
+ * \param[in] sctp The SCTP association to inspect
+ * \returns A JSON object with messages, queued bytes and failures */
+json_t *janus_sctp_association_stats(janus_sctp_association *sctp);
+
 #endif
 
 #endif
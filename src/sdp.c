@@ -36,13 +36,27 @@ janus_sdp *janus_sdp_preparse(void *ice_handle, const char *jsep_sdp, char *erro
 		JANUS_LOG(LOG_ERR, "  Can't preparse, invalid arguments\n");
 		return NULL;
 	}
-	janus_ice_handle *handle = (janus_ice_handle *)ice_handle;
 	janus_sdp *parsed_sdp = janus_sdp_parse(jsep_sdp, error_str, errlen);
 	if(!parsed_sdp) {
 		JANUS_LOG(LOG_ERR, "  Error parsing SDP? %s\n", error_str ? error_str : "(unknown reason)");
 		/* Invalid SDP */
 		return NULL;
 	}
+	if(janus_sdp_preparse_parsed(ice_handle, parsed_sdp, dtls_role, audio, video, data) < 0) {
+		janus_sdp_destroy(parsed_sdp);
+		return NULL;
+	}
+	return parsed_sdp;
+}
+
+/* Same checks as above, but on an SDP that was parsed already */
+int janus_sdp_preparse_parsed(void *ice_handle, janus_sdp *parsed_sdp,
+		janus_dtls_role *dtls_role, int *audio, int *video, int *data) {
+	if(!ice_handle || !parsed_sdp) {
+		JANUS_LOG(LOG_ERR, "  Can't preparse, invalid arguments\n");
+		return -1;
+	}
+	janus_ice_handle *handle = (janus_ice_handle *)ice_handle;
 	gboolean dtls_role_found = FALSE;
 	if(dtls_role) {
 		/* We're interested in checking which role was advertised, traverse global attributes too */
@@ -52,8 +66,7 @@ janus_sdp *janus_sdp_preparse(void *ice_handle, const char *jsep_sdp, char *erro
 			if(a->name && !strcasecmp(a->name, "setup")) {
 				if(a->value == NULL) {
 					JANUS_LOG(LOG_ERR, "[%"SCNu64"] Invalid setup attribute (no value)\n", handle->handle_id);
-					janus_sdp_destroy(parsed_sdp);
-					return NULL;
+					return -1;
 				}
 				if(!strcasecmp(a->value, "actpass")) {
 					JANUS_LOG(LOG_VERB, "[%"SCNu64"] Peer advertised 'actpass' DTLS role, we'll be a DTLS client\n", handle->handle_id);
@@ -96,22 +109,19 @@ janus_sdp *janus_sdp_preparse(void *ice_handle, const char *jsep_sdp, char *erro
 					/* Found mid attribute */
 					if(a->value == NULL) {
 						JANUS_LOG(LOG_ERR, "[%"SCNu64"] Invalid mid attribute (no value)\n", handle->handle_id);
-						janus_sdp_destroy(parsed_sdp);
-						return NULL;
+						return -1;
 					}
 					if((m->type == JANUS_SDP_AUDIO || m->type == JANUS_SDP_VIDEO) && m->port > 0) {
 						if(strnlen(a->value, 16 + 1) > 16) {
 							JANUS_LOG(LOG_ERR, "[%"SCNu64"] mid on m-line #%d too large: (%zu > 16)\n",
 								handle->handle_id, m->index, strlen(a->value));
-							janus_sdp_destroy(parsed_sdp);
-							return NULL;
+							return -1;
 						}
 					}
 				} else if(dtls_role && !dtls_role_found && !strcasecmp(a->name, "setup")) {
 					if(a->value == NULL) {
 						JANUS_LOG(LOG_ERR, "[%"SCNu64"] Invalid setup attribute (no value)\n", handle->handle_id);
-						janus_sdp_destroy(parsed_sdp);
-						return NULL;
+						return -1;
 					}
 					if(!strcasecmp(a->value, "actpass")) {
 						JANUS_LOG(LOG_VERB, "[%"SCNu64"] Peer advertised 'actpass' DTLS role, we'll be a DTLS client\n", handle->handle_id);
@@ -139,7 +149,7 @@ janus_sdp *janus_sdp_preparse(void *ice_handle, const char *jsep_sdp, char *erro
 		temp = temp->next;
 	}
 
-	return parsed_sdp;
+	return 0;
 }
 
 /* Parse remote SDP */
@@ -659,8 +669,7 @@ int janus_sdp_process_remote(void *ice_handle, janus_sdp *remote_sdp, gboolean r
 							medium->rtcp_ctx[vindex]->out_link_quality = 100;
 							medium->rtcp_ctx[vindex]->out_media_link_quality = 100;
 						}
-						if(medium->last_seqs[vindex])
-							janus_seq_list_free(&medium->last_seqs[vindex]);
+						janus_seq_window_reset(medium->last_seqs[vindex]);
 						janus_mutex_unlock(&medium->mutex);
 					}
 					medium->ssrc_peer[vindex] = medium->ssrc_peer_new[vindex];
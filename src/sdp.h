@@ -48,6 +48,20 @@
 janus_sdp *janus_sdp_preparse(void *handle, const char *jsep_sdp, char *error_str, size_t errlen,
 	janus_dtls_role *dtls_role, int *audio, int *video, int *data);
 
+/*! \brief Method to pre-parse a session description that was parsed already
+ * \details Same as janus_sdp_preparse, but performed on an existing Janus SDP
+ * instance (e.g., one a plugin passed to the core without serializing it first)
+ * @note The Janus SDP instance may be modified, but is never destroyed, even in case of errors
+ * @param[in] handle Opaque pointer to the ICE handle this session description will modify
+ * @param[in] sdp The Janus SDP object to pre-parse
+ * @param[out] dtls_role The advertised DTLS role
+ * @param[out] audio The number of audio m-lines
+ * @param[out] video The number of video m-lines
+ * @param[out] data The number of SCTP m-lines
+ * @returns 0 in case of success, -1 in case the SDP is invalid */
+int janus_sdp_preparse_parsed(void *handle, janus_sdp *sdp,
+	janus_dtls_role *dtls_role, int *audio, int *video, int *data);
+
 /*! \brief Method to process a remote parsed session description
  * \details This method will process a session description coming from a peer, and set up the ICE candidates accordingly
  * @param[in] handle Opaque pointer to the ICE handle this session description will modify
@@ -0,0 +1,245 @@
+/*! \file    timerwheel.c
+ * \author   Lorenzo Miniero <lorenzo@meetecho.com>
+ * \copyright GNU General Public License v3
+ * \brief    Hierarchical timer wheel
+ * \details  Implementation of a hierarchical timer wheel, that the core
+ * can use to drive many recurring timers from a single GLib source. Each
+ * handle needs a few recurring timers (e.g., to send RTCP or compute
+ * stats), and when they're all GLib sources attached to the same context,
+ * GLib checks all of them at each iteration of the loop, which gets
+ * expensive when thousands of handles share the same loop. With a wheel,
+ * scheduling and cancelling a timer are O(1), and each tick only looks at
+ * the timers that are actually due.
+ *
+ * \ingroup core
+ * \ref core
+ */
+
+#include <string.h>
+
+#include "timerwheel.h"
+
+#define JANUS_TIMER_WHEEL_MASK		(JANUS_TIMER_WHEEL_SLOTS - 1)
+/* Farthest in the future (in ticks) a timer can be scheduled */
+#define JANUS_TIMER_WHEEL_MAX		(((guint64)1 << (JANUS_TIMER_WHEEL_BITS * JANUS_TIMER_WHEEL_LEVELS)) - 1)
+
+/* Helpers to manage the intrusive lists of timers */
+static void janus_timer_link(janus_timer **list, janus_timer *timer) {
+	timer->list = list;
+	timer->prev = NULL;
+	timer->next = *list;
+	if(*list != NULL)
+		(*list)->prev = timer;
+	*list = timer;
+}
+
+static void janus_timer_unlink(janus_timer *timer) {
+	if(timer->list == NULL)
+		return;
+	if(timer->prev != NULL)
+		timer->prev->next = timer->next;
+	else
+		*timer->list = timer->next;
+	if(timer->next != NULL)
+		timer->next->prev = timer->prev;
+	timer->list = NULL;
+	timer->prev = NULL;
+	timer->next = NULL;
+}
+
+/* Helper to put a timer in the right slot, depending on how far in the future it expires:
+ * the closer it is, the lower the level, and the finer the granularity (wheel locked) */
+static void janus_timer_wheel_insert(janus_timer_wheel *wheel, janus_timer *timer) {
+	if(timer->expires < wheel->now)
+		timer->expires = wheel->now;
+	guint64 delta = timer->expires - wheel->now;
+	if(delta > JANUS_TIMER_WHEEL_MAX) {
+		delta = JANUS_TIMER_WHEEL_MAX;
+		timer->expires = wheel->now + delta;
+	}
+	int level = 0;
+	while(level < JANUS_TIMER_WHEEL_LEVELS-1 && delta >= ((guint64)1 << (JANUS_TIMER_WHEEL_BITS * (level+1))))
+		level++;
+	guint slot = (timer->expires >> (JANUS_TIMER_WHEEL_BITS * level)) & JANUS_TIMER_WHEEL_MASK;
+	janus_timer_link(&wheel->slots[level][slot], timer);
+}
+
+/* Helper to convert an interval in milliseconds to a number of ticks */
+static guint64 janus_timer_wheel_ticks(guint interval) {
+	guint64 ticks = (interval + JANUS_TIMER_WHEEL_TICK - 1) / JANUS_TIMER_WHEEL_TICK;
+	return ticks > 0 ? ticks : 1;
+}
+
+janus_timer_wheel *janus_timer_wheel_create(gint64 now) {
+	janus_timer_wheel *wheel = g_malloc0(sizeof(janus_timer_wheel));
+	wheel->start = now;
+	janus_mutex_init(&wheel->mutex);
+	return wheel;
+}
+
+void janus_timer_wheel_destroy(janus_timer_wheel *wheel) {
+	if(wheel == NULL)
+		return;
+	janus_mutex_lock(&wheel->mutex);
+	int level = 0;
+	guint slot = 0;
+	for(level=0; level<JANUS_TIMER_WHEEL_LEVELS; level++) {
+		for(slot=0; slot<JANUS_TIMER_WHEEL_SLOTS; slot++) {
+			while(wheel->slots[level][slot] != NULL) {
+				janus_timer *timer = wheel->slots[level][slot];
+				janus_timer_unlink(timer);
+				timer->wheel = NULL;
+			}
+		}
+	}
+	while(wheel->expired != NULL) {
+		janus_timer *timer = wheel->expired;
+		janus_timer_unlink(timer);
+		timer->wheel = NULL;
+	}
+	janus_mutex_unlock(&wheel->mutex);
+	janus_mutex_destroy(&wheel->mutex);
+	g_free(wheel);
+}
+
+void janus_timer_init(janus_timer *timer, guint interval, GSourceFunc func, gpointer user_data) {
+	if(timer == NULL)
+		return;
+	memset(timer, 0, sizeof(janus_timer));
+	timer->interval = interval;
+	timer->func = func;
+	timer->user_data = user_data;
+}
+
+gboolean janus_timer_is_scheduled(janus_timer *timer) {
+	return timer != NULL && g_atomic_pointer_get(&timer->wheel) != NULL;
+}
+
+int janus_timer_wheel_add(janus_timer_wheel *wheel, janus_timer *timer) {
+	if(wheel == NULL || timer == NULL || timer->func == NULL)
+		return -1;
+	janus_mutex_lock(&wheel->mutex);
+	if(timer->wheel != NULL) {
+		janus_mutex_unlock(&wheel->mutex);
+		return -2;
+	}
+	timer->wheel = wheel;
+	timer->expires = wheel->now + janus_timer_wheel_ticks(timer->interval);
+	janus_timer_wheel_insert(wheel, timer);
+	g_atomic_int_inc(&wheel->count);
+	janus_mutex_unlock(&wheel->mutex);
+	return 0;
+}
+
+void janus_timer_wheel_remove(janus_timer *timer) {
+	if(timer == NULL)
+		return;
+	janus_timer_wheel *wheel = g_atomic_pointer_get(&timer->wheel);
+	if(wheel == NULL)
+		return;
+	janus_mutex_lock(&wheel->mutex);
+	if(timer->wheel == wheel) {
+		if(timer->list != NULL) {
+			janus_timer_unlink(timer);
+			g_atomic_int_add(&wheel->count, -1);
+		}
+		/* If the timer is firing right now, this prevents it from being rescheduled */
+		if(wheel->running == timer)
+			wheel->running = NULL;
+		timer->wheel = NULL;
+	}
+	janus_mutex_unlock(&wheel->mutex);
+}
+
+void janus_timer_wheel_move(janus_timer *timer, janus_timer_wheel *wheel) {
+	if(timer == NULL || wheel == NULL || !janus_timer_is_scheduled(timer) || timer->wheel == wheel)
+		return;
+	janus_timer_wheel_remove(timer);
+	janus_timer_wheel_add(wheel, timer);
+}
+
+/* Helper to move on to the next tick, and collect the timers that are due (wheel locked) */
+static void janus_timer_wheel_tick(janus_timer_wheel *wheel) {
+	wheel->now++;
+	/* When a level wraps, the timers in the next slot of the level above
+	 * are close enough to be spread on the lower levels */
+	int level = 0;
+	for(level=1; level<JANUS_TIMER_WHEEL_LEVELS; level++) {
+		if(wheel->now & (((guint64)1 << (JANUS_TIMER_WHEEL_BITS * level)) - 1))
+			break;
+		guint slot = (wheel->now >> (JANUS_TIMER_WHEEL_BITS * level)) & JANUS_TIMER_WHEEL_MASK;
+		while(wheel->slots[level][slot] != NULL) {
+			janus_timer *timer = wheel->slots[level][slot];
+			janus_timer_unlink(timer);
+			janus_timer_wheel_insert(wheel, timer);
+		}
+	}
+	/* All the timers in the current slot of the first level are due now */
+	guint slot = wheel->now & JANUS_TIMER_WHEEL_MASK;
+	while(wheel->slots[0][slot] != NULL) {
+		janus_timer *timer = wheel->slots[0][slot];
+		janus_timer_unlink(timer);
+		janus_timer_link(&wheel->expired, timer);
+	}
+}
+
+void janus_timer_wheel_advance(janus_timer_wheel *wheel, gint64 now) {
+	if(wheel == NULL)
+		return;
+	gint64 before = g_get_monotonic_time();
+	janus_mutex_lock(&wheel->mutex);
+	guint64 due = now > wheel->start ? (guint64)(now - wheel->start) / (JANUS_TIMER_WHEEL_TICK * 1000) : 0;
+	if(due > wheel->now + 1)
+		g_atomic_int_add(&wheel->overruns, (gint)(due - wheel->now - 1));
+	while(wheel->now < due) {
+		janus_timer_wheel_tick(wheel);
+		while(wheel->expired != NULL) {
+			janus_timer *timer = wheel->expired;
+			janus_timer_unlink(timer);
+			g_atomic_int_add(&wheel->count, -1);
+			wheel->running = timer;
+			janus_mutex_unlock(&wheel->mutex);
+			gboolean res = timer->func(timer->user_data);
+			janus_mutex_lock(&wheel->mutex);
+			if(wheel->running != timer) {
+				/* The timer was cancelled (and maybe rescheduled) while it was firing */
+				continue;
+			}
+			wheel->running = NULL;
+			if(res == G_SOURCE_REMOVE) {
+				timer->wheel = NULL;
+				continue;
+			}
+			/* Reschedule the timer, without drifting unless we're really late */
+			timer->expires += janus_timer_wheel_ticks(timer->interval);
+			if(timer->expires <= wheel->now)
+				timer->expires = wheel->now + 1;
+			janus_timer_wheel_insert(wheel, timer);
+			g_atomic_int_inc(&wheel->count);
+		}
+	}
+	janus_mutex_unlock(&wheel->mutex);
+	gint64 cost = g_get_monotonic_time() - before;
+	wheel->advances++;
+	wheel->cost += cost;
+	if(cost > wheel->cost_max)
+		wheel->cost_max = cost;
+}
+
+guint janus_timer_wheel_cost(janus_timer_wheel *wheel, gint64 *avg, gint64 *max) {
+	if(avg)
+		*avg = 0;
+	if(max)
+		*max = 0;
+	if(wheel == NULL || wheel->advances == 0)
+		return 0;
+	guint advances = wheel->advances;
+	if(avg)
+		*avg = wheel->cost / advances;
+	if(max)
+		*max = wheel->cost_max;
+	wheel->advances = 0;
+	wheel->cost = 0;
+	wheel->cost_max = 0;
+	return advances;
+}
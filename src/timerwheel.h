@@ -0,0 +1,122 @@
+/*! \file    timerwheel.h
+ * \author   Lorenzo Miniero <lorenzo@meetecho.com>
+ * \copyright GNU General Public License v3
+ * \brief    Hierarchical timer wheel (headers)
+ * \details  Implementation of a hierarchical timer wheel, that the core
+ * can use to drive many recurring timers from a single GLib source. Each
+ * handle needs a few recurring timers (e.g., to send RTCP or compute
+ * stats), and when they're all GLib sources attached to the same context,
+ * GLib checks all of them at each iteration of the loop, which gets
+ * expensive when thousands of handles share the same loop. With a wheel,
+ * scheduling and cancelling a timer are O(1), and each tick only looks at
+ * the timers that are actually due.
+ *
+ * \ingroup core
+ * \ref core
+ */
+
+#ifndef JANUS_TIMERWHEEL_H
+#define JANUS_TIMERWHEEL_H
+
+#include <glib.h>
+
+#include "mutex.h"
+
+/*! \brief Resolution of the wheel, in milliseconds */
+#define JANUS_TIMER_WHEEL_TICK		10
+/*! \brief Number of bits of the tick counter each level of the wheel covers */
+#define JANUS_TIMER_WHEEL_BITS		6
+/*! \brief Number of slots in each level of the wheel */
+#define JANUS_TIMER_WHEEL_SLOTS		(1 << JANUS_TIMER_WHEEL_BITS)
+/*! \brief Number of levels of the wheel (4 levels of 64 slots at 10ms cover about 46 hours) */
+#define JANUS_TIMER_WHEEL_LEVELS	4
+
+struct janus_timer_wheel;
+
+/*! \brief Recurring timer that can be scheduled on a wheel
+ * @note Timers are owned by whoever schedules them (e.g., they can be
+ * embedded in other structures): the wheel only links them in its slots */
+typedef struct janus_timer {
+	/*! \brief Siblings in the list the timer is in, if any */
+	struct janus_timer *prev, *next;
+	/*! \brief Head of the list the timer is in, if any */
+	struct janus_timer **list;
+	/*! \brief Wheel the timer is scheduled on, if any */
+	struct janus_timer_wheel *wheel;
+	/*! \brief Tick the timer will fire at */
+	guint64 expires;
+	/*! \brief Interval of the timer, in milliseconds */
+	guint interval;
+	/*! \brief Function to invoke when the timer fires: the timer is rescheduled if it returns G_SOURCE_CONTINUE */
+	GSourceFunc func;
+	/*! \brief Opaque data to pass to the function */
+	gpointer user_data;
+} janus_timer;
+
+/*! \brief Hierarchical timer wheel */
+typedef struct janus_timer_wheel {
+	/*! \brief Slots of the wheel, one list of timers each */
+	janus_timer *slots[JANUS_TIMER_WHEEL_LEVELS][JANUS_TIMER_WHEEL_SLOTS];
+	/*! \brief Timers that are due in the tick being processed */
+	janus_timer *expired;
+	/*! \brief Timer whose function is being invoked right now, if any */
+	janus_timer *running;
+	/*! \brief Monotonic time the wheel started at, and the current tick */
+	gint64 start;
+	guint64 now;
+	/*! \brief Number of timers currently scheduled */
+	volatile gint count;
+	/*! \brief Number of ticks that were processed late, because the wheel wasn't advanced in time */
+	volatile gint overruns;
+	/*! \brief Time spent advancing the wheel since the last janus_timer_wheel_cost call (only updated by the thread advancing the wheel) */
+	guint advances;
+	gint64 cost, cost_max;
+	/*! \brief Mutex to lock the wheel */
+	janus_mutex mutex;
+} janus_timer_wheel;
+
+/*! \brief Helper to create a new timer wheel
+ * @param[in] now The current monotonic time
+ * @returns A new janus_timer_wheel instance */
+janus_timer_wheel *janus_timer_wheel_create(gint64 now);
+/*! \brief Helper to destroy a timer wheel
+ * @note Timers still scheduled on the wheel are not freed, but only unlinked
+ * @param[in] wheel The janus_timer_wheel instance to destroy */
+void janus_timer_wheel_destroy(janus_timer_wheel *wheel);
+/*! \brief Helper to initialize a timer before scheduling it
+ * @param[in] timer The janus_timer instance to initialize
+ * @param[in] interval The interval of the timer, in milliseconds
+ * @param[in] func The function to invoke when the timer fires
+ * @param[in] user_data Opaque data to pass to the function */
+void janus_timer_init(janus_timer *timer, guint interval, GSourceFunc func, gpointer user_data);
+/*! \brief Helper to check whether a timer is scheduled on a wheel
+ * @param[in] timer The janus_timer instance to check
+ * @returns TRUE if the timer is scheduled, FALSE otherwise */
+gboolean janus_timer_is_scheduled(janus_timer *timer);
+/*! \brief Helper to schedule a timer on a wheel: it will first fire after its interval
+ * @param[in] wheel The janus_timer_wheel instance to schedule the timer on
+ * @param[in] timer The janus_timer instance to schedule
+ * @returns 0 in case of success, a negative integer otherwise (e.g., if the timer is scheduled already) */
+int janus_timer_wheel_add(janus_timer_wheel *wheel, janus_timer *timer);
+/*! \brief Helper to cancel a timer (does nothing if the timer is not scheduled)
+ * @param[in] timer The janus_timer instance to cancel */
+void janus_timer_wheel_remove(janus_timer *timer);
+/*! \brief Helper to move a timer to a different wheel (does nothing if the timer is not scheduled)
+ * @param[in] timer The janus_timer instance to move
+ * @param[in] wheel The janus_timer_wheel instance to move the timer to */
+void janus_timer_wheel_move(janus_timer *timer, janus_timer_wheel *wheel);
+/*! \brief Helper to process all the ticks up to the current time, invoking the timers that are due
+ * @note The timer functions are invoked without the wheel locked, so they
+ * can schedule and cancel timers themselves
+ * @param[in] wheel The janus_timer_wheel instance to advance
+ * @param[in] now The current monotonic time */
+void janus_timer_wheel_advance(janus_timer_wheel *wheel, gint64 now);
+/*! \brief Helper to get, and reset, how long advancing the wheel took since the last call
+ * @note Only meant to be called by the thread advancing the wheel
+ * @param[in] wheel The janus_timer_wheel instance to query
+ * @param[out] avg Average time each janus_timer_wheel_advance call took, in microseconds
+ * @param[out] max Longest time a janus_timer_wheel_advance call took, in microseconds
+ * @returns The number of janus_timer_wheel_advance calls since the last call */
+guint janus_timer_wheel_cost(janus_timer_wheel *wheel, gint64 *avg, gint64 *max);
+
+#endif
@@ -125,6 +125,26 @@ static enum MHD_FLAG mhd_debug_flag = MHD_NO_FLAG;
 /* JSON serialization options */
 static size_t json_format = JSON_INDENT(3) | JSON_PRESERVE_ORDER;
 
+/* Streaming long polls: when allowed, a GET can ask (via the 'stream' query
+ * string parameter) to be kept open, and events written as they arrive */
+static gboolean longpoll_streaming = FALSE;
+#define JANUS_HTTP_STREAM_NONE		0
+#define JANUS_HTTP_STREAM_NDJSON	1
+#define JANUS_HTTP_STREAM_SSE		2
+/* How often we send keep-alives on a streaming long poll */
+#define JANUS_HTTP_STREAM_KEEPALIVE	25
+
+/* Keep-alive effectiveness: how many requests we get per TCP connection */
+#if defined(MHD_VERSION) && MHD_VERSION >= 0x00095200
+#define JANUS_HTTP_CONNECTION_STATS
+#endif
+typedef struct janus_http_connection {
+	guint requests;						/* Requests received on this TCP connection */
+} janus_http_connection;
+static guint64 connections_opened = 0, connections_closed = 0,
+	connections_requests = 0, connections_max_requests = 0;
+static janus_mutex connections_mutex = JANUS_MUTEX_INITIALIZER;
+
 /* Parameter validation (for tweaking and queries via Admin API) */
 static struct janus_json_parameter request_parameters[] = {
 	{"request", JSON_STRING, JANUS_JSON_PARAM_REQUIRED}
@@ -158,6 +178,16 @@ typedef struct janus_http_msg {
 	size_t resplen;						/* Length of the response in octets */
 	GSource *timeout;					/* Timeout monitor, if any */
 	volatile gint timeout_flag;			/* Whether a timeout hasn't fired yet */
+	int stream;							/* In case this is a streaming long poll, the format to use (NDJSON or SSE) */
+	GString *stream_buffer;				/* Events written to the stream and not sent yet */
+	uint64_t stream_base;				/* Offset in the response stream the buffer starts from */
+	gboolean stream_suspended;			/* Whether the connection was suspended as there was nothing to send */
+	gboolean stream_closed;				/* Whether the stream should be closed once the buffer is sent */
+	GSource *stream_keepalive;			/* Keep-alive timer for the streaming long poll */
+	char *stream_secret;				/* API secret to use in keep-alives for the streaming long poll, if any */
+	char *stream_token;					/* Token to use in keep-alives for the streaming long poll, if any */
+	void *stream_session;				/* Session this streaming long poll is for */
+	janus_mutex stream_mutex;			/* Mutex to lock the stream buffer */
 	volatile gint destroyed;			/* Whether this session has been destroyed */
 	janus_refcount ref;					/* Reference counter for this message */
 } janus_http_msg;
@@ -176,6 +206,12 @@ static void janus_http_msg_free(const janus_refcount *msg_ref) {
 	g_free(request->acrm);
 	g_free(request->xff);
 	g_free(request->response);
+	if(request->stream_buffer != NULL) {
+		g_string_free(request->stream_buffer, TRUE);
+		janus_mutex_destroy(&request->stream_mutex);
+	}
+	g_free(request->stream_secret);
+	g_free(request->stream_token);
 	g_free(request);
 }
 
@@ -191,6 +227,7 @@ typedef struct janus_http_session {
 	guint64 session_id;			/* Core session identifier */
 	GAsyncQueue *events;		/* Events to notify for this session */
 	GList *longpolls;			/* Long poll connection */
+	GList *streams;				/* Streaming long poll connections */
 	janus_mutex mutex;			/* Mutex to lock this instance */
 	volatile gint destroyed;	/* Whether this session has been destroyed */
 	janus_refcount ref;			/* Reference counter for this session */
@@ -282,6 +319,14 @@ static void janus_http_request_completed(void *cls, struct MHD_Connection *conne
 	void **con_cls, enum MHD_RequestTerminationCode toe);
 /* Callback to send data back after resuming a connection */
 static ssize_t janus_http_response_callback(void *cls, uint64_t pos, char *buf, size_t max);
+/* Callback to send events on a streaming long poll as they're written */
+static ssize_t janus_http_stream_callback(void *cls, uint64_t pos, char *buf, size_t max);
+/* Helpers to write events to and close a streaming long poll */
+static void janus_http_stream_write(janus_http_msg *msg, json_t *event);
+static void janus_http_stream_close(janus_http_msg *msg);
+/* Keep-alive timer for streaming long polls */
+static gboolean janus_http_stream_keepalive(gpointer user_data);
+static void janus_http_stream_keepalive_done(gpointer user_data);
 /* Worker to handle requests that are actually long polls */
 static int janus_http_notifier(janus_http_msg *msg);
 /* Helper to quickly send a success response */
@@ -390,6 +435,41 @@ static gpointer janus_http_timer(gpointer user_data) {
 }
 
 
+#ifdef JANUS_HTTP_CONNECTION_STATS
+/* Callback (libmicrohttpd) invoked when a TCP connection is opened or closed */
+static void janus_http_connection_notify(void *cls, struct MHD_Connection *connection,
+		void **socket_context, enum MHD_ConnectionNotificationCode toe) {
+	if(toe == MHD_CONNECTION_NOTIFY_STARTED) {
+		*socket_context = g_malloc0(sizeof(janus_http_connection));
+		janus_mutex_lock(&connections_mutex);
+		connections_opened++;
+		janus_mutex_unlock(&connections_mutex);
+	} else if(toe == MHD_CONNECTION_NOTIFY_CLOSED) {
+		janus_http_connection *conn = (janus_http_connection *)*socket_context;
+		if(conn == NULL)
+			return;
+		janus_mutex_lock(&connections_mutex);
+		connections_closed++;
+		connections_requests += conn->requests;
+		if(conn->requests > connections_max_requests)
+			connections_max_requests = conn->requests;
+		janus_mutex_unlock(&connections_mutex);
+		g_free(conn);
+		*socket_context = NULL;
+	}
+}
+#endif
+/* Helper to keep track of a new request on an existing TCP connection */
+static void janus_http_connection_count_request(struct MHD_Connection *connection) {
+#ifdef JANUS_HTTP_CONNECTION_STATS
+	const union MHD_ConnectionInfo *info = MHD_get_connection_info(connection, MHD_CONNECTION_INFO_SOCKET_CONTEXT);
+	if(info == NULL || info->socket_context == NULL)
+		return;
+	janus_http_connection *conn = (janus_http_connection *)info->socket_context;
+	conn->requests++;
+#endif
+}
+
 /* Helper to create a MHD daemon */
 static struct MHD_Daemon *janus_http_create_daemon(gboolean admin, char *path,
 		const char *interface, const char *ip, int port,
@@ -516,6 +596,9 @@ static struct MHD_Daemon *janus_http_create_daemon(gboolean admin, char *path,
 				MHD_OPTION_NOTIFY_COMPLETED, &janus_http_request_completed, NULL,
 				MHD_OPTION_CONNECTION_TIMEOUT, 120,
 				MHD_OPTION_CONNECTION_LIMIT, connection_limit,
+#ifdef JANUS_HTTP_CONNECTION_STATS
+				MHD_OPTION_NOTIFY_CONNECTION, &janus_http_connection_notify, NULL,
+#endif
 				MHD_OPTION_END);
 		} else {
 			/* Bind to the interface that was specified */
@@ -533,6 +616,9 @@ static struct MHD_Daemon *janus_http_create_daemon(gboolean admin, char *path,
 				MHD_OPTION_SOCK_ADDR, ipv6 ? (struct sockaddr *)&addr6 : (struct sockaddr *)&addr,
 				MHD_OPTION_CONNECTION_TIMEOUT, 120,
 				MHD_OPTION_CONNECTION_LIMIT, connection_limit,
+#ifdef JANUS_HTTP_CONNECTION_STATS
+				MHD_OPTION_NOTIFY_CONNECTION, &janus_http_connection_notify, NULL,
+#endif
 				MHD_OPTION_END);
 		}
 	} else {
@@ -559,6 +645,9 @@ static struct MHD_Daemon *janus_http_create_daemon(gboolean admin, char *path,
 				MHD_OPTION_HTTPS_KEY_PASSWORD, password,
 				MHD_OPTION_CONNECTION_TIMEOUT, 120,
 				MHD_OPTION_CONNECTION_LIMIT, connection_limit,
+#ifdef JANUS_HTTP_CONNECTION_STATS
+				MHD_OPTION_NOTIFY_CONNECTION, &janus_http_connection_notify, NULL,
+#endif
 				MHD_OPTION_END);
 		} else {
 			/* Bind to the interface that was specified */
@@ -580,6 +669,9 @@ static struct MHD_Daemon *janus_http_create_daemon(gboolean admin, char *path,
 				MHD_OPTION_SOCK_ADDR, ipv6 ? (struct sockaddr *)&addr6 : (struct sockaddr *)&addr,
 				MHD_OPTION_CONNECTION_TIMEOUT, 120,
 				MHD_OPTION_CONNECTION_LIMIT, connection_limit,
+#ifdef JANUS_HTTP_CONNECTION_STATS
+				MHD_OPTION_NOTIFY_CONNECTION, &janus_http_connection_notify, NULL,
+#endif
 				MHD_OPTION_END);
 		}
 	}
@@ -685,6 +777,13 @@ int janus_http_init(janus_transport_callbacks *callback, const char *config_path
 			JANUS_LOG(LOG_WARN, "Notification of events to handlers disabled for %s\n", JANUS_HTTP_NAME);
 		}
 
+		/* Check if streaming long polls are allowed */
+		item = janus_config_get(config, config_general, janus_config_type_item, "longpoll_streaming");
+		if(item && item->value)
+			longpoll_streaming = janus_is_true(item->value);
+		if(longpoll_streaming)
+			JANUS_LOG(LOG_INFO, "Streaming long polls (NDJSON and Server-Sent Events) are allowed\n");
+
 		/* Check the base paths */
 		item = janus_config_get(config, config_general, janus_config_type_item, "base_path");
 		if(item && item->value) {
@@ -958,7 +1057,10 @@ void janus_http_destroy(void) {
 		janus_transport_session *transport = value;
 		janus_http_msg *msg = (janus_http_msg *)transport->transport_p;
 		if(msg != NULL && !g_atomic_int_get(&msg->destroyed)) {
-			MHD_resume_connection(msg->connection);
+			if(msg->stream != JANUS_HTTP_STREAM_NONE)
+				janus_http_stream_close(msg);
+			else
+				MHD_resume_connection(msg->connection);
 		}
 	}
 	janus_mutex_unlock(&messages_mutex);
@@ -1063,6 +1165,16 @@ int janus_http_send_message(janus_transport_session *transport, void *request_id
 		/* Are there long polls waiting? */
 		janus_mutex_lock(&session->mutex);
 		janus_http_msg *msg = NULL;
+		if(session->streams) {
+			/* There's a streaming long poll, write the events there right away */
+			transport = (janus_transport_session *)session->streams->data;
+			msg = (janus_http_msg *)(transport ? transport->transport_p : NULL);
+			json_t *event = NULL;
+			while(msg && (event = g_async_queue_try_pop(session->events)) != NULL) {
+				janus_http_stream_write(msg, event);
+				json_decref(event);
+			}
+		}
 		while(session->longpolls) {
 			transport = (janus_transport_session *)session->longpolls->data;
 			msg = (janus_http_msg *)(transport ? transport->transport_p : NULL);
@@ -1147,6 +1259,7 @@ void janus_http_session_created(janus_transport_session *transport, guint64 sess
 	session->session_id = session_id;
 	session->events = g_async_queue_new();
 	session->longpolls = NULL;
+	session->streams = NULL;
 	janus_mutex_init(&session->mutex);
 	g_atomic_int_set(&session->destroyed, 0);
 	janus_refcount_init(&session->ref, janus_http_session_free);
@@ -1160,6 +1273,20 @@ void janus_http_session_over(janus_transport_session *transport, guint64 session
 		claimed ? "but has been claimed" : "and has not been claimed", session_id);
 	/* Get rid of the session's queue of events */
 	janus_mutex_lock(&sessions_mutex);
+	janus_http_session *session = g_hash_table_lookup(sessions, &session_id);
+	if(session != NULL) {
+		/* Close the streaming long polls for this session, if any */
+		janus_mutex_lock(&session->mutex);
+		GList *temp = session->streams;
+		while(temp) {
+			janus_transport_session *ts = (janus_transport_session *)temp->data;
+			janus_http_msg *msg = (janus_http_msg *)(ts ? ts->transport_p : NULL);
+			if(msg != NULL)
+				janus_http_stream_close(msg);
+			temp = temp->next;
+		}
+		janus_mutex_unlock(&session->mutex);
+	}
 	g_hash_table_remove(sessions, &session_id);
 	janus_mutex_unlock(&sessions_mutex);
 }
@@ -1176,6 +1303,7 @@ void janus_http_session_claimed(janus_transport_session *transport, guint64 sess
 	session->session_id = session_id;
 	session->events = g_async_queue_new();
 	session->longpolls = NULL;
+	session->streams = NULL;
 	janus_mutex_init(&session->mutex);
 	g_atomic_int_set(&session->destroyed, 0);
 	janus_refcount_init(&session->ref, janus_http_session_free);
@@ -1298,6 +1426,19 @@ json_t *janus_http_query_transport(json_t *request) {
 			if(info != NULL)
 				json_object_set_new(connections, "admin_https", json_integer(info->num_connections));
 		}
+#ifdef JANUS_HTTP_CONNECTION_STATS
+		/* Return how many requests we got per TCP connection, to check keep-alive effectiveness */
+		json_t *keepalive = json_object();
+		janus_mutex_lock(&connections_mutex);
+		json_object_set_new(keepalive, "opened", json_integer(connections_opened));
+		json_object_set_new(keepalive, "closed", json_integer(connections_closed));
+		json_object_set_new(keepalive, "requests", json_integer(connections_requests));
+		json_object_set_new(keepalive, "requests-per-connection",
+			json_real(connections_closed ? (double)connections_requests/(double)connections_closed : 0.0));
+		json_object_set_new(keepalive, "max-requests-per-connection", json_integer(connections_max_requests));
+		janus_mutex_unlock(&connections_mutex);
+		json_object_set_new(response, "keepalive", keepalive);
+#endif
 		/* Also add the global number of messages we're serving */
 		janus_mutex_lock(&messages_mutex);
 		guint count = g_hash_table_size(messages);
@@ -1385,6 +1526,7 @@ static janus_MHD_Result janus_http_handler(void *cls, struct MHD_Connection *con
 		msg = g_malloc0(sizeof(janus_http_msg));
 		msg->connection = connection;
 		janus_refcount_init(&msg->ref, janus_http_msg_free);
+		janus_http_connection_count_request(connection);
 		ts = janus_transport_session_create(msg, janus_http_msg_destroy);
 		janus_mutex_lock(&messages_mutex);
 		g_hash_table_insert(messages, ts, ts);
@@ -1655,6 +1797,62 @@ static janus_MHD_Result janus_http_handler(void *cls, struct MHD_Connection *con
 				max_events = 1;
 			}
 		}
+		/* Is this a streaming long poll? */
+		int stream = JANUS_HTTP_STREAM_NONE;
+		const char *stream_format = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "stream");
+		if(stream_format != NULL) {
+			if(!strcasecmp(stream_format, "ndjson")) {
+				stream = JANUS_HTTP_STREAM_NDJSON;
+			} else if(!strcasecmp(stream_format, "sse")) {
+				stream = JANUS_HTTP_STREAM_SSE;
+			} else {
+				JANUS_LOG(LOG_WARN, "Unsupported stream format '%s', falling back to a regular long poll\n", stream_format);
+			}
+			if(stream != JANUS_HTTP_STREAM_NONE && !longpoll_streaming) {
+				JANUS_LOG(LOG_WARN, "Streaming long polls are disabled, falling back to a regular long poll\n");
+				stream = JANUS_HTTP_STREAM_NONE;
+			}
+		}
+		if(stream != JANUS_HTTP_STREAM_NONE) {
+			JANUS_LOG(LOG_VERB, "Session %"SCNu64" found... streaming events (%s)\n", session_id,
+				stream == JANUS_HTTP_STREAM_SSE ? "sse" : "ndjson");
+			response = MHD_create_response_from_callback(MHD_SIZE_UNKNOWN,
+				4096, &janus_http_stream_callback, msg, NULL);
+			if(response == NULL) {
+				ret = MHD_NO;
+				janus_refcount_decrease(&session->ref);
+				goto done;
+			}
+			janus_mutex_init(&msg->stream_mutex);
+			msg->stream_buffer = g_string_sized_new(1024);
+			msg->stream = stream;
+			msg->stream_secret = g_strdup(secret);
+			msg->stream_token = g_strdup(token);
+			MHD_add_response_header(response, "Content-Type",
+				stream == JANUS_HTTP_STREAM_SSE ? "text/event-stream" : "application/x-ndjson");
+			MHD_add_response_header(response, "Cache-Control", "no-cache");
+			janus_http_add_cors_headers(msg, response);
+			ret = MHD_queue_response(msg->connection, MHD_HTTP_OK, response);
+			MHD_destroy_response(response);
+			/* Write whatever we have already, and mark this as the stream for the session */
+			janus_mutex_lock(&session->mutex);
+			json_t *event = NULL;
+			while((event = g_async_queue_try_pop(session->events)) != NULL) {
+				janus_http_stream_write(msg, event);
+				json_decref(event);
+			}
+			janus_refcount_increase(&session->ref);
+			msg->stream_session = session;
+			session->streams = g_list_append(session->streams, ts);
+			janus_mutex_unlock(&session->mutex);
+			/* Periodically send keep-alives, both to the core and on the stream */
+			janus_refcount_increase(&ts->ref);
+			msg->stream_keepalive = g_timeout_source_new_seconds(JANUS_HTTP_STREAM_KEEPALIVE);
+			g_source_set_callback(msg->stream_keepalive, janus_http_stream_keepalive, ts, janus_http_stream_keepalive_done);
+			g_source_attach(msg->stream_keepalive, httpctx);
+			janus_refcount_decrease(&session->ref);
+			goto done;
+		}
 		JANUS_LOG(LOG_VERB, "Session %"SCNu64" found... returning up to %d messages\n", session_id, max_events);
 		/* Handle GET, taking the first message from the list */
 		janus_mutex_lock(&session->mutex);
@@ -1809,6 +2007,7 @@ static janus_MHD_Result janus_http_admin_handler(void *cls, struct MHD_Connectio
 		msg = g_malloc0(sizeof(janus_http_msg));
 		msg->connection = connection;
 		janus_refcount_init(&msg->ref, janus_http_msg_free);
+		janus_http_connection_count_request(connection);
 		ts = janus_transport_session_create(msg, janus_http_msg_destroy);
 		janus_mutex_lock(&messages_mutex);
 		g_hash_table_insert(messages, ts, ts);
@@ -2109,6 +2308,26 @@ static void janus_http_request_completed(void *cls, struct MHD_Connection *conne
 			janus_mutex_unlock(&session->mutex);
 			janus_refcount_decrease(&session->ref);
 		}
+		if(request->stream != JANUS_HTTP_STREAM_NONE) {
+			/* This was a streaming long poll, get rid of it */
+			janus_mutex_lock(&request->stream_mutex);
+			request->stream_closed = TRUE;
+			GSource *keepalive = request->stream_keepalive;
+			request->stream_keepalive = NULL;
+			janus_http_session *stream_session = (janus_http_session *)request->stream_session;
+			request->stream_session = NULL;
+			janus_mutex_unlock(&request->stream_mutex);
+			if(keepalive != NULL) {
+				g_source_destroy(keepalive);
+				g_source_unref(keepalive);
+			}
+			if(stream_session != NULL) {
+				janus_mutex_lock(&stream_session->mutex);
+				stream_session->streams = g_list_remove(stream_session->streams, ts);
+				janus_mutex_unlock(&stream_session->mutex);
+				janus_refcount_decrease(&stream_session->ref);
+			}
+		}
 		janus_refcount_decrease(&request->ref);
 	}
 	janus_mutex_lock(&messages_mutex);
@@ -2132,6 +2351,100 @@ static ssize_t janus_http_response_callback(void *cls, uint64_t pos, char *buf,
 	return bytes;
 }
 
+static ssize_t janus_http_stream_callback(void *cls, uint64_t pos, char *buf, size_t max) {
+	janus_http_msg *request = (janus_http_msg *)cls;
+	if(request == NULL || request->stream_buffer == NULL)
+		return MHD_CONTENT_READER_END_WITH_ERROR;
+	janus_mutex_lock(&request->stream_mutex);
+	size_t offset = pos - request->stream_base;
+	if(offset >= request->stream_buffer->len) {
+		/* We sent everything we had, reset the buffer */
+		request->stream_base += request->stream_buffer->len;
+		g_string_truncate(request->stream_buffer, 0);
+		if(request->stream_closed || g_atomic_int_get(&stopping)) {
+			janus_mutex_unlock(&request->stream_mutex);
+			return MHD_CONTENT_READER_END_OF_STREAM;
+		}
+		/* Nothing to send for now, suspend the connection until we have more */
+		request->stream_suspended = TRUE;
+		MHD_suspend_connection(request->connection);
+		janus_mutex_unlock(&request->stream_mutex);
+		return 0;
+	}
+	size_t bytes = request->stream_buffer->len - offset;
+	if(bytes > max)
+		bytes = max;
+	memcpy(buf, request->stream_buffer->str + offset, bytes);
+	janus_mutex_unlock(&request->stream_mutex);
+	return bytes;
+}
+
+static void janus_http_stream_write(janus_http_msg *msg, json_t *event) {
+	if(msg == NULL || msg->stream_buffer == NULL || event == NULL)
+		return;
+	/* Each event must fit in a single line, so we always use a compact format */
+	char *event_text = json_dumps(event, JSON_COMPACT | JSON_PRESERVE_ORDER);
+	if(event_text == NULL) {
+		JANUS_LOG(LOG_ERR, "Failed to stringify message...\n");
+		return;
+	}
+	janus_mutex_lock(&msg->stream_mutex);
+	if(!msg->stream_closed) {
+		if(msg->stream == JANUS_HTTP_STREAM_SSE)
+			g_string_append_printf(msg->stream_buffer, "data: %s\n\n", event_text);
+		else
+			g_string_append_printf(msg->stream_buffer, "%s\n", event_text);
+		if(msg->stream_suspended) {
+			msg->stream_suspended = FALSE;
+			MHD_resume_connection(msg->connection);
+		}
+	}
+	janus_mutex_unlock(&msg->stream_mutex);
+	free(event_text);
+}
+
+static void janus_http_stream_close(janus_http_msg *msg) {
+	if(msg == NULL || msg->stream_buffer == NULL)
+		return;
+	janus_mutex_lock(&msg->stream_mutex);
+	msg->stream_closed = TRUE;
+	if(msg->stream_suspended) {
+		msg->stream_suspended = FALSE;
+		MHD_resume_connection(msg->connection);
+	}
+	janus_mutex_unlock(&msg->stream_mutex);
+}
+
+/* Keep-alive timer for streaming long polls */
+static gboolean janus_http_stream_keepalive(gpointer user_data) {
+	janus_transport_session *ts = (janus_transport_session *)user_data;
+	janus_http_msg *msg = (janus_http_msg *)ts->transport_p;
+	if(g_atomic_int_get(&ts->destroyed) || msg == NULL || msg->stream_closed || g_atomic_int_get(&stopping))
+		return G_SOURCE_REMOVE;
+	/* Since there's no new GET acting as a keepalive, send one to the core */
+	char tr[12];
+	janus_http_random_string(12, (char *)&tr);
+	json_t *root = json_object();
+	json_object_set_new(root, "janus", json_string("keepalive"));
+	json_object_set_new(root, "session_id", json_integer(msg->session_id));
+	json_object_set_new(root, "transaction", json_string(tr));
+	if(msg->stream_secret)
+		json_object_set_new(root, "apisecret", json_string(msg->stream_secret));
+	if(msg->stream_token)
+		json_object_set_new(root, "token", json_string(msg->stream_token));
+	gateway->incoming_request(&janus_http_transport, ts, (void *)keepalive_id, FALSE, root, NULL);
+	/* Let the client know we're still here as well */
+	json_t *event = json_object();
+	json_object_set_new(event, "janus", json_string("keepalive"));
+	janus_http_stream_write(msg, event);
+	json_decref(event);
+	return G_SOURCE_CONTINUE;
+}
+static void janus_http_stream_keepalive_done(gpointer user_data) {
+	janus_transport_session *ts = (janus_transport_session *)user_data;
+	janus_refcount_decrease(&ts->ref);
+}
+
 /* Worker to handle notifications */
 static int janus_http_notifier(janus_http_msg *msg) {
 	if(!msg || !msg->connection)
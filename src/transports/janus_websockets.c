@@ -111,12 +111,14 @@ static gboolean notify_events = TRUE;
 
 /* Clients maps */
 #if (LWS_LIBRARY_VERSION_MAJOR >= 3)
-static GHashTable *clients = NULL, *writable_clients = NULL;
+static GHashTable *clients = NULL;
 #endif
 static janus_mutex writable_mutex = JANUS_MUTEX_INITIALIZER;
 
 /* JSON serialization options */
 static size_t json_format = JSON_INDENT(3) | JSON_PRESERVE_ORDER;
+/* Whether multiple pending messages should be sent in the same frame */
+static gboolean coalesce_messages = FALSE;
 
 /* Parameter validation (for tweaking and queries via Admin API) */
 static struct janus_json_parameter request_parameters[] = {
@@ -126,6 +128,7 @@ static struct janus_json_parameter configure_parameters[] = {
 	{"events", JANUS_JSON_BOOL, 0},
 	{"json", JSON_STRING, 0},
 	{"logging", JSON_STRING, 0},
+	{"coalesce", JANUS_JSON_BOOL, 0},
 };
 /* Error codes (for the tweaking and queries via Admin API) */
 #define JANUS_WEBSOCKETS_ERROR_INVALID_REQUEST		411
@@ -173,8 +176,18 @@ static void janus_websockets_log_emit_function(int level, const char *line) {
 	JANUS_LOG(LOG_INFO, "[libwebsockets][%s] %s", janus_websockets_get_level_str(level), line);
 }
 
-/* WebSockets service thread */
-static GThread *ws_thread = NULL;
+/* WebSockets service threads: when libwebsockets has been built with
+ * SMP support, connections are distributed across multiple threads */
+typedef struct janus_websockets_service {
+	int tsi;								/* Index of the libwebsockets service thread */
+	GThread *thread;						/* Thread servicing this index */
+	GHashTable *writable_clients;			/* Clients served by this thread that have something to send */
+	guint clients;							/* Number of clients served by this thread */
+} janus_websockets_service;
+static janus_websockets_service *ws_services = NULL;
+static int ws_services_count = 1;
+/* Service the current thread is responsible for, if any */
+static GPrivate ws_current_service = G_PRIVATE_INIT(NULL);
 void *janus_websockets_thread(void *data);
 
 
@@ -189,6 +202,7 @@ typedef struct janus_websockets_client {
 	size_t bufoffset;							/* Offset from where the interrupted previous write should resume */
 	volatile gint destroyed;				/* Whether this libwebsockets client instance has been closed */
 	janus_transport_session *ts;			/* Janus core-transport session */
+	janus_websockets_service *service;		/* Service thread this client has been assigned to */
 } janus_websockets_client;
 
 
@@ -737,8 +751,32 @@ int janus_websockets_init(janus_transport_callbacks *callback, const char *confi
 		}
 #endif
 #endif
-		/* Force single-thread server */
-		wscinfo.count_threads = 1;
+		/* By default we use a single service thread, unless libwebsockets
+		 * supports SMP and we've been asked to use more than one */
+		item = janus_config_get(config, config_general, janus_config_type_item, "service_threads");
+		if(item && item->value) {
+			int threads = atoi(item->value);
+			if(threads < 1) {
+				JANUS_LOG(LOG_WARN, "Invalid value for service_threads (%d), using 1...\n", threads);
+				threads = 1;
+			}
+#if (LWS_LIBRARY_VERSION_MAJOR >= 3) && defined(LWS_MAX_SMP) && (LWS_MAX_SMP > 1)
+			if(threads > LWS_MAX_SMP) {
+				JANUS_LOG(LOG_WARN, "libwebsockets supports at most %d service threads, using %d...\n", LWS_MAX_SMP, LWS_MAX_SMP);
+				threads = LWS_MAX_SMP;
+			}
+#else
+			if(threads > 1) {
+				JANUS_LOG(LOG_WARN, "Multiple service threads need libwebsockets >= 3.x built with SMP support, using 1...\n");
+				threads = 1;
+			}
+#endif
+			ws_services_count = threads;
+		}
+		wscinfo.count_threads = ws_services_count;
+		item = janus_config_get(config, config_general, janus_config_type_item, "coalesce_messages");
+		if(item && item->value)
+			coalesce_messages = janus_is_true(item->value);
 
 		/* Create the base context */
 		wsc = lws_create_context(&wscinfo);
@@ -769,24 +807,35 @@ int janus_websockets_init(janus_transport_callbacks *callback, const char *confi
 	ws_janus_api_enabled = wss || swss;
 	ws_admin_api_enabled = admin_wss || admin_swss;
 
+	ws_services = g_malloc0(ws_services_count * sizeof(janus_websockets_service));
+	int i = 0;
+	for(i=0; i<ws_services_count; i++)
+		ws_services[i].tsi = i;
 #if (LWS_LIBRARY_VERSION_MAJOR >= 3)
 	clients = g_hash_table_new(NULL, NULL);
-	writable_clients = g_hash_table_new(NULL, NULL);
+	for(i=0; i<ws_services_count; i++)
+		ws_services[i].writable_clients = g_hash_table_new(NULL, NULL);
 #endif
 
 	g_atomic_int_set(&initialized, 1);
 
 	GError *error = NULL;
-	/* Start the WebSocket service thread */
+	/* Start the WebSocket service thread(s) */
 	if(ws_janus_api_enabled || ws_admin_api_enabled) {
-		ws_thread = g_thread_try_new("ws thread", &janus_websockets_thread, wsc, &error);
-		if(error != NULL) {
-			g_atomic_int_set(&initialized, 0);
-			JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch the WebSockets thread...\n",
-				error->code, error->message ? error->message : "??");
-			g_error_free(error);
-			return -1;
+		for(i=0; i<ws_services_count; i++) {
+			char tname[16];
+			g_snprintf(tname, sizeof(tname), "ws thread %d", i);
+			ws_services[i].thread = g_thread_try_new(tname, &janus_websockets_thread, &ws_services[i], &error);
+			if(error != NULL) {
+				g_atomic_int_set(&initialized, 0);
+				JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch the WebSockets thread...\n",
+					error->code, error->message ? error->message : "??");
+				g_error_free(error);
+				return -1;
+			}
 		}
+		if(ws_services_count > 1)
+			JANUS_LOG(LOG_INFO, "Using %d WebSockets service threads\n", ws_services_count);
 	}
 
 	/* Done */
@@ -802,10 +851,13 @@ void janus_websockets_destroy(void) {
 	lws_cancel_service(wsc);
 #endif
 
-	/* Stop the service thread */
-	if(ws_thread != NULL) {
-		g_thread_join(ws_thread);
-		ws_thread = NULL;
+	/* Stop the service threads */
+	int i = 0;
+	for(i=0; i<ws_services_count; i++) {
+		if(ws_services[i].thread != NULL) {
+			g_thread_join(ws_services[i].thread);
+			ws_services[i].thread = NULL;
+		}
 	}
 
 	/* Destroy the context */
@@ -818,10 +870,14 @@ void janus_websockets_destroy(void) {
 	janus_mutex_lock(&writable_mutex);
 	g_hash_table_destroy(clients);
 	clients = NULL;
-	g_hash_table_destroy(writable_clients);
-	writable_clients = NULL;
+	for(i=0; i<ws_services_count; i++) {
+		g_hash_table_destroy(ws_services[i].writable_clients);
+		ws_services[i].writable_clients = NULL;
+	}
 	janus_mutex_unlock(&writable_mutex);
 #endif
+	g_free(ws_services);
+	ws_services = NULL;
 
 	g_atomic_int_set(&initialized, 0);
 	g_atomic_int_set(&stopping, 0);
@@ -843,8 +899,10 @@ static void janus_websockets_destroy_client(
 	JANUS_LOG(LOG_INFO, "[%s-%p] Destroying WebSocket client\n", log_prefix, wsi);
 #if (LWS_LIBRARY_VERSION_MAJOR >= 3)
 	janus_mutex_lock(&writable_mutex);
-	g_hash_table_remove(clients, ws_client);
-	g_hash_table_remove(writable_clients, ws_client);
+	if(g_hash_table_remove(clients, ws_client) && ws_client->service != NULL)
+		ws_client->service->clients--;
+	if(ws_client->service != NULL)
+		g_hash_table_remove(ws_client->service->writable_clients, ws_client);
 	janus_mutex_unlock(&writable_mutex);
 #endif
 	ws_client->wsi = NULL;
@@ -928,8 +986,9 @@ int janus_websockets_send_message(janus_transport_session *transport, void *requ
 		janus_mutex_unlock(&transport->mutex);
 		return -1;
 	}
-	/* Convert to string and enqueue */
-	char *payload = json_dumps(message, json_format);
+	/* Convert to string and enqueue: coalesced messages are separated by new
+	 * lines, so when coalescing we always serialize them as compact JSON */
+	char *payload = json_dumps(message, coalesce_messages ? (JSON_COMPACT | JSON_PRESERVE_ORDER) : json_format);
 	if(payload == NULL) {
 		JANUS_LOG(LOG_ERR, "Failed to stringify message...\n");
 		json_decref(message);
@@ -938,12 +997,13 @@ int janus_websockets_send_message(janus_transport_session *transport, void *requ
 	}
 	g_async_queue_push(client->messages, payload);
 #if (LWS_LIBRARY_VERSION_MAJOR >= 3)
-	/* On libwebsockets >= 3.x we use lws_cancel_service */
+	/* On libwebsockets >= 3.x we use lws_cancel_service_pt, so that
+	 * only the service thread handling this client is woken up */
 	janus_mutex_lock(&writable_mutex);
-	if(g_hash_table_lookup(clients, client) == client)
-		g_hash_table_insert(writable_clients, client, client);
+	if(g_hash_table_lookup(clients, client) == client && client->service != NULL)
+		g_hash_table_insert(client->service->writable_clients, client, client);
 	janus_mutex_unlock(&writable_mutex);
-	lws_cancel_service(wsc);
+	lws_cancel_service_pt(client->wsi);
 #else
 	/* On libwebsockets < 3.x we use lws_callback_on_writable */
 	janus_mutex_lock(&writable_mutex);
@@ -1028,6 +1088,9 @@ json_t *janus_websockets_query_transport(json_t *request) {
 				json_array_append_new(notes, json_string("Ignored unsupported indentation format"));
 			}
 		}
+		json_t *coalesce = json_object_get(request, "coalesce");
+		if(coalesce != NULL)
+			coalesce_messages = json_is_true(coalesce);
 		const char *logging = json_string_value(json_object_get(request, "logging"));
 		if(logging != NULL) {
 			/* libwebsockets uses a mask to set log levels, as documented here:
@@ -1082,8 +1145,33 @@ json_t *janus_websockets_query_transport(json_t *request) {
 #if (LWS_LIBRARY_VERSION_MAJOR >= 3)
 		janus_mutex_lock(&writable_mutex);
 		guint connections = g_hash_table_size(clients);
+		/* Also return how connections and queued messages are distributed across threads */
+		guint *queued = g_malloc0(ws_services_count * sizeof(guint));
+		GHashTableIter iter;
+		gpointer value;
+		g_hash_table_iter_init(&iter, clients);
+		while(g_hash_table_iter_next(&iter, NULL, &value)) {
+			janus_websockets_client *client = value;
+			if(client == NULL || client->service == NULL || client->messages == NULL)
+				continue;
+			gint qlen = g_async_queue_length(client->messages);
+			if(qlen > 0)
+				queued[client->service->tsi] += qlen;
+		}
+		json_t *threads = json_array();
+		int i = 0;
+		for(i=0; i<ws_services_count; i++) {
+			json_t *thread = json_object();
+			json_object_set_new(thread, "thread", json_integer(i));
+			json_object_set_new(thread, "connections", json_integer(ws_services[i].clients));
+			json_object_set_new(thread, "writable", json_integer(g_hash_table_size(ws_services[i].writable_clients)));
+			json_object_set_new(thread, "queued", json_integer(queued[i]));
+			json_array_append_new(threads, thread);
+		}
+		g_free(queued);
 		janus_mutex_unlock(&writable_mutex);
 		json_object_set_new(response, "connections", json_integer(connections));
+		json_object_set_new(response, "threads", threads);
 #endif
 	} else {
 		JANUS_LOG(LOG_VERB, "Unknown request '%s'\n", request_text);
@@ -1105,23 +1193,28 @@ plugin_response:
 
 /* Thread */
 void *janus_websockets_thread(void *data) {
-	struct lws_context *service = (struct lws_context *)data;
-	if(service == NULL) {
+	janus_websockets_service *service = (janus_websockets_service *)data;
+	if(service == NULL || wsc == NULL) {
 		JANUS_LOG(LOG_ERR, "Invalid service\n");
 		return NULL;
 	}
+	g_private_set(&ws_current_service, service);
 
-	JANUS_LOG(LOG_INFO, "WebSockets thread started\n");
+	JANUS_LOG(LOG_INFO, "WebSockets thread #%d started\n", service->tsi);
 
 	while(g_atomic_int_get(&initialized) && !g_atomic_int_get(&stopping)) {
-		/* libwebsockets is single thread, we cycle through events here */
-		lws_service(service, 50);
+		/* Each service thread cycles through the events of its own connections */
+#if (LWS_LIBRARY_VERSION_MAJOR >= 3)
+		lws_service_tsi(wsc, 50, service->tsi);
+#else
+		lws_service(wsc, 50);
+#endif
 	}
 
 	/* Get rid of the WebSockets server */
-	lws_cancel_service(service);
+	lws_cancel_service(wsc);
 	/* Done */
-	JANUS_LOG(LOG_INFO, "WebSockets thread ended\n");
+	JANUS_LOG(LOG_INFO, "WebSockets thread #%d ended\n", service->tsi);
 	return NULL;
 }
 
@@ -1164,6 +1257,8 @@ static int janus_websockets_callback_https(
 
 /* Use ~ 2xMTU as chunk size */
 #define MESSAGE_CHUNK_SIZE 2800
+/* Maximum size of a frame containing coalesced messages */
+#define MESSAGE_COALESCE_SIZE 65536
 
 /* This callback handles Janus API requests */
 static int janus_websockets_common_callback(
@@ -1217,9 +1312,14 @@ static int janus_websockets_common_callback(
 			ws_client->bufoffset = 0;
 			g_atomic_int_set(&ws_client->destroyed, 0);
 			ws_client->ts = janus_transport_session_create(ws_client, NULL);
+			/* Keep track of the service thread this connection has been assigned to */
+			ws_client->service = g_private_get(&ws_current_service);
+			if(ws_client->service == NULL)
+				ws_client->service = &ws_services[0];
 #if (LWS_LIBRARY_VERSION_MAJOR >= 3)
 			janus_mutex_lock(&writable_mutex);
 			g_hash_table_insert(clients, ws_client, ws_client);
+			ws_client->service->clients++;
 			janus_mutex_unlock(&writable_mutex);
 #endif
 			/* Let us know when the WebSocket channel becomes writeable */
@@ -1389,18 +1489,25 @@ static int janus_websockets_common_callback(
 #if (LWS_LIBRARY_VERSION_MAJOR >= 3)
 		/* On libwebsockets >= 3.x, we use this event to mark connections as writable in the event loop */
 		case LWS_CALLBACK_EVENT_WAIT_CANCELLED: {
+			janus_websockets_service *service = g_private_get(&ws_current_service);
+			if(service == NULL)
+				return 0;
 			janus_mutex_lock(&writable_mutex);
-			/* We iterate on all the clients we marked as writable and act on them */
+			/* We iterate on all the clients of this thread we marked as writable and act on them */
+			if(service->writable_clients == NULL) {
+				janus_mutex_unlock(&writable_mutex);
+				return 0;
+			}
 			GHashTableIter iter;
 			gpointer value;
-			g_hash_table_iter_init(&iter, writable_clients);
+			g_hash_table_iter_init(&iter, service->writable_clients);
 			while(g_hash_table_iter_next(&iter, NULL, &value)) {
 				janus_websockets_client *client = value;
 				if(client == NULL || client->wsi == NULL)
 					continue;
 				lws_callback_on_writable(client->wsi);
 			}
-			g_hash_table_remove_all(writable_clients);
+			g_hash_table_remove_all(service->writable_clients);
 			janus_mutex_unlock(&writable_mutex);
 			return 0;
 		}
@@ -1447,20 +1554,52 @@ static int janus_websockets_common_callback(
 						return 0;
 					}
 					/* Gotcha! */
-					JANUS_LOG(LOG_HUGE, "[%s-%p] Sending WebSocket message (%zu bytes)...\n", log_prefix, wsi, strlen(response));
-					size_t buflen = LWS_PRE + strlen(response);
+					size_t resplen = strlen(response);
+					JANUS_LOG(LOG_HUGE, "[%s-%p] Sending WebSocket message (%zu bytes)...\n", log_prefix, wsi, resplen);
+					size_t buflen = LWS_PRE + resplen;
 					if (buflen > ws_client->buflen) {
 						/* We need a larger shared buffer */
-						JANUS_LOG(LOG_HUGE, "[%s-%p] Re-allocating to %zu bytes (was %zu, response is %zu bytes)\n", log_prefix, wsi, buflen, ws_client->buflen, strlen(response));
+						JANUS_LOG(LOG_HUGE, "[%s-%p] Re-allocating to %zu bytes (was %zu, response is %zu bytes)\n", log_prefix, wsi, buflen, ws_client->buflen, resplen);
 						ws_client->buflen = buflen;
 						ws_client->buffer = g_realloc(ws_client->buffer, buflen);
 					}
-					memcpy(ws_client->buffer + LWS_PRE, response, strlen(response));
+					memcpy(ws_client->buffer + LWS_PRE, response, resplen);
 					/* Initialize pending bytes count and buffer offset */
-					ws_client->bufpending = strlen(response);
+					ws_client->bufpending = resplen;
 					ws_client->bufoffset = LWS_PRE;
+					/* Messages queued before coalescing was enabled via Admin API
+					 * may contain new lines, and so can't share a frame */
+					gboolean coalesce = coalesce_messages && memchr(response, '\n', resplen) == NULL;
 					/* We can get rid of the message */
 					free(response);
+					/* If coalescing is enabled, append other pending messages
+					 * to the same frame, separated by a new line, as long as
+					 * we don't exceed the maximum size of a coalesced frame */
+					int coalesced = 0;
+					while(coalesce && ws_client->bufpending < MESSAGE_COALESCE_SIZE &&
+							(response = g_async_queue_try_pop(ws_client->messages)) != NULL) {
+						resplen = strlen(response);
+						if(ws_client->bufpending + 1 + resplen > MESSAGE_COALESCE_SIZE ||
+								memchr(response, '\n', resplen) != NULL) {
+							/* Too large (or not compact), we'll send it in the next frame */
+							g_async_queue_push_front(ws_client->messages, response);
+							break;
+						}
+						buflen = LWS_PRE + ws_client->bufpending + 1 + resplen;
+						if (buflen > ws_client->buflen) {
+							ws_client->buflen = buflen;
+							ws_client->buffer = g_realloc(ws_client->buffer, buflen);
+						}
+						ws_client->buffer[LWS_PRE + ws_client->bufpending] = '\n';
+						memcpy(ws_client->buffer + LWS_PRE + ws_client->bufpending + 1, response, resplen);
+						ws_client->bufpending += 1 + resplen;
+						free(response);
+						coalesced++;
+					}
+					if(coalesced > 0) {
+						JANUS_LOG(LOG_HUGE, "[%s-%p]   -- Coalesced %d more messages (%zu bytes)\n",
+							log_prefix, wsi, coalesced, ws_client->bufpending);
+					}
 				}
 
 				if (g_atomic_int_get(&ws_client->destroyed) || g_atomic_int_get(&stopping)) {
@@ -6,7 +6,12 @@
  * draft, that is a REST API that can be used to access TURN services,
  * more specifically credentials to use. Currently implemented in both
  * rfc5766-turn-server and coturn, and so should be generic enough to
- * be usable here.
+ * be usable here. Requests are sent asynchronously by a dedicated
+ * thread using the libcurl multi interface: concurrent requests for the
+ * same username are coalesced in a single HTTP transaction and, if
+ * configured, credentials are cached and shared for a fraction of their TTL,
+ * and then served while they're refreshed in the background, as long as
+ * they're still valid.
  * \note This implementation depends on \c libcurl and is optional.
  *
  * \ingroup core
@@ -25,6 +30,7 @@
 #include "turnrest.h"
 #include "debug.h"
 #include "mutex.h"
+#include "refcount.h"
 #include "ip-utils.h"
 #include "utils.h"
 
@@ -34,6 +40,27 @@ static gboolean api_http_get = FALSE;
 static uint api_timeout;
 static janus_mutex api_mutex = JANUS_MUTEX_INITIALIZER;
 
+/* Credentials cache: responses are shared across handles with the same
+ * username until the configured fraction of their TTL has elapsed, and
+ * then until they expire, while new ones are being fetched */
+static guint cache_refresh = 0;
+static char *cache_username = NULL;
+typedef struct janus_turnrest_cached {
+	janus_turnrest_response *response;
+	gint64 fetched;
+	gint64 refresh_at;
+	gint64 expires_at;
+} janus_turnrest_cached;
+static GHashTable *cache = NULL;
+/* Requests in flight, indexed by username, so that concurrent requests
+ * for the same credentials result in a single HTTP transaction */
+static GHashTable *pending = NULL;
+static janus_mutex cache_mutex = JANUS_MUTEX_INITIALIZER;
+/* Statistics, protected by the cache mutex as well */
+static guint64 stats_hits = 0, stats_stale = 0, stats_misses = 0, stats_coalesced = 0,
+	stats_requests = 0, stats_failures = 0;
+static gint64 stats_latency_total = 0, stats_latency_last = 0;
+
 
 /* Buffer we use to receive the response via libcurl */
 typedef struct janus_turnrest_buffer {
@@ -56,12 +83,91 @@ static size_t janus_turnrest_callback(void *payload, size_t size, size_t nmemb,
 }
 
 
+/* A request in flight, shared by all the callers waiting for it */
+typedef struct janus_turnrest_pending {
+	char *user;
+	CURL *curl;
+	char *query_string;
+	char *request_uri;
+	janus_turnrest_buffer data;
+	gint64 started;
+	gboolean done;
+	janus_turnrest_response *response;
+	janus_condition cond;
+	janus_refcount ref;
+} janus_turnrest_pending;
+static void janus_turnrest_pending_free(const janus_refcount *pending_ref) {
+	janus_turnrest_pending *p = janus_refcount_containerof(pending_ref, janus_turnrest_pending, ref);
+	g_free(p->user);
+	if(p->curl != NULL)
+		curl_easy_cleanup(p->curl);
+	g_free(p->query_string);
+	g_free(p->request_uri);
+	g_free(p->data.buffer);
+	janus_turnrest_response_destroy(p->response);
+	janus_condition_destroy(&p->cond);
+	g_free(p);
+}
+static janus_turnrest_pending exit_request;
+
+/* Loop taking care of all the TURN REST API requests via libcurl's multi interface */
+static CURLM *multi = NULL;
+static GAsyncQueue *requests = NULL;
+static GThread *turnrest_thread = NULL;
+static volatile gint turnrest_running = 0;
+static void *janus_turnrest_thread(void *data);
+static janus_turnrest_response *janus_turnrest_parse(const char *payload);
+static void janus_turnrest_cached_destroy(gpointer data) {
+	janus_turnrest_cached *cached = (janus_turnrest_cached *)data;
+	if(cached == NULL)
+		return;
+	janus_turnrest_response_destroy(cached->response);
+	g_free(cached);
+}
+
+
 void janus_turnrest_init(void) {
 	/* Initialize libcurl, needed for contacting the TURN REST API backend */
 	curl_global_init(CURL_GLOBAL_ALL);
+	multi = curl_multi_init();
+	cache = g_hash_table_new_full(g_str_hash, g_str_equal, (GDestroyNotify)g_free, (GDestroyNotify)janus_turnrest_cached_destroy);
+	pending = g_hash_table_new(g_str_hash, g_str_equal);
+	requests = g_async_queue_new();
+	/* Start the thread that will take care of the requests */
+	GError *error = NULL;
+	g_atomic_int_set(&turnrest_running, 1);
+	turnrest_thread = g_thread_try_new("turnrest", janus_turnrest_thread, NULL, &error);
+	if(error != NULL) {
+		g_atomic_int_set(&turnrest_running, 0);
+		JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch the TURN REST API thread...\n",
+			error->code, error->message ? error->message : "??");
+		g_error_free(error);
+	}
 }
 
 void janus_turnrest_deinit(void) {
+	/* Stop the requests thread, if it was running */
+	if(turnrest_thread != NULL) {
+		g_atomic_int_set(&turnrest_running, 0);
+		g_async_queue_push(requests, &exit_request);
+#if LIBCURL_VERSION_NUM >= 0x074400
+		curl_multi_wakeup(multi);
+#endif
+		g_thread_join(turnrest_thread);
+		turnrest_thread = NULL;
+	}
+	janus_mutex_lock(&cache_mutex);
+	g_hash_table_destroy(cache);
+	cache = NULL;
+	g_hash_table_destroy(pending);
+	pending = NULL;
+	g_free(cache_username);
+	cache_username = NULL;
+	janus_mutex_unlock(&cache_mutex);
+	g_async_queue_unref(requests);
+	requests = NULL;
+	curl_multi_cleanup(multi);
+	multi = NULL;
 	/* Cleanup the libcurl initialization */
 	curl_global_cleanup();
 	janus_mutex_lock(&api_mutex);
@@ -120,20 +226,79 @@ void janus_turnrest_response_destroy(janus_turnrest_response *response) {
 	g_free(response);
 }
 
-janus_turnrest_response *janus_turnrest_request(const char *user) {
-	janus_mutex_lock(&api_mutex);
-	if(api_server == NULL) {
-		janus_mutex_unlock(&api_mutex);
+janus_turnrest_response *janus_turnrest_response_copy(janus_turnrest_response *response) {
+	if(response == NULL)
 		return NULL;
+	janus_turnrest_response *copy = g_malloc(sizeof(janus_turnrest_response));
+	copy->username = g_strdup(response->username);
+	copy->password = g_strdup(response->password);
+	copy->ttl = response->ttl;
+	copy->servers = NULL;
+	GList *temp = response->servers;
+	while(temp) {
+		janus_turnrest_instance *instance = (janus_turnrest_instance *)temp->data;
+		janus_turnrest_instance *ic = g_malloc(sizeof(janus_turnrest_instance));
+		ic->server = g_strdup(instance->server);
+		ic->port = instance->port;
+		ic->transport = instance->transport;
+		copy->servers = g_list_append(copy->servers, ic);
+		temp = temp->next;
 	}
-	/* Prepare the libcurl context */
-	CURLcode res;
+	return copy;
+}
+
+void janus_turnrest_set_cache(guint refresh, const char *username) {
+	if(refresh > 100) {
+		JANUS_LOG(LOG_WARN, "Invalid TURN REST API cache refresh percentage %u, using 100\n", refresh);
+		refresh = 100;
+	}
+	janus_mutex_lock(&cache_mutex);
+	cache_refresh = refresh;
+	g_free(cache_username);
+	cache_username = username ? g_strdup(username) : NULL;
+	/* Get rid of whatever we had cached, settings may have changed */
+	if(cache != NULL)
+		g_hash_table_remove_all(cache);
+	janus_mutex_unlock(&cache_mutex);
+}
+
+json_t *janus_turnrest_get_stats(void) {
+	json_t *stats = json_object();
+	janus_mutex_lock(&cache_mutex);
+	json_object_set_new(stats, "cache", cache_refresh > 0 ? json_true() : json_false());
+	if(cache_refresh > 0) {
+		json_object_set_new(stats, "cache-refresh", json_integer(cache_refresh));
+		json_object_set_new(stats, "cached", json_integer(cache ? g_hash_table_size(cache) : 0));
+	}
+	if(cache_username != NULL)
+		json_object_set_new(stats, "username", json_string(cache_username));
+	json_object_set_new(stats, "hits", json_integer(stats_hits));
+	json_object_set_new(stats, "stale-hits", json_integer(stats_stale));
+	json_object_set_new(stats, "misses", json_integer(stats_misses));
+	json_object_set_new(stats, "coalesced", json_integer(stats_coalesced));
+	json_object_set_new(stats, "requests", json_integer(stats_requests));
+	json_object_set_new(stats, "failures", json_integer(stats_failures));
+	json_object_set_new(stats, "in-flight", json_integer(pending ? g_hash_table_size(pending) : 0));
+	guint64 completed = stats_requests - (pending ? g_hash_table_size(pending) : 0);
+	json_object_set_new(stats, "avg-latency", json_integer(completed ? (stats_latency_total/completed)/1000 : 0));
+	json_object_set_new(stats, "last-latency", json_integer(stats_latency_last/1000));
+	janus_mutex_unlock(&cache_mutex);
+	return stats;
+}
+
+/* Prepare a new request for the TURN REST API backend: must be called
+ * with both the API and the cache mutex locked */
+static janus_turnrest_pending *janus_turnrest_pending_create(const char *user) {
 	CURL *curl = curl_easy_init();
 	if(curl == NULL) {
-		janus_mutex_unlock(&api_mutex);
 		JANUS_LOG(LOG_ERR, "libcurl error\n");
 		return NULL;
 	}
+	janus_turnrest_pending *p = g_malloc0(sizeof(janus_turnrest_pending));
+	p->user = g_strdup(user ? user : "");
+	p->curl = curl;
+	janus_condition_init(&p->cond);
+	janus_refcount_init(&p->ref, janus_turnrest_pending_free);
 	/* Prepare the request URI */
 	char query_string[512];
 	g_snprintf(query_string, 512, "service=turn");
@@ -161,75 +326,244 @@ janus_turnrest_response *janus_turnrest_request(const char *user) {
 		janus_strlcat(query_string, buffer, 512);
 		curl_free(encoded_user);
 	}
-	char request_uri[1024];
-	g_snprintf(request_uri, 1024, "%s?%s", api_server, query_string);
-	JANUS_LOG(LOG_VERB, "Sending request: %s\n", request_uri);
-	curl_easy_setopt(curl, CURLOPT_URL, request_uri);
+	p->query_string = g_strdup(query_string);
+	p->request_uri = g_strdup_printf("%s?%s", api_server, query_string);
+	JANUS_LOG(LOG_VERB, "Sending request: %s\n", p->request_uri);
+	curl_easy_setopt(curl, CURLOPT_URL, p->request_uri);
 	curl_easy_setopt(curl, (api_http_get ? CURLOPT_HTTPGET : CURLOPT_POST), 1);
 	if(!api_http_get) {
 		/* FIXME Some servers don't like a POST with no data */
-		curl_easy_setopt(curl, CURLOPT_POSTFIELDS, query_string);
+		curl_easy_setopt(curl, CURLOPT_POSTFIELDS, p->query_string);
 	}
 	curl_easy_setopt(curl, CURLOPT_TIMEOUT, api_timeout);
-	janus_mutex_unlock(&api_mutex);
+	curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
 	/* For getting data, we use an helper struct and the libcurl callback */
-	janus_turnrest_buffer data;
-	data.buffer = g_malloc0(1);
-	data.size = 0;
+	p->data.buffer = g_malloc0(1);
+	p->data.size = 0;
 	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, janus_turnrest_callback);
-	curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&data);
+	curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&p->data);
 	curl_easy_setopt(curl, CURLOPT_USERAGENT, "Janus/1.0");
-	/* Send the request */
-	res = curl_easy_perform(curl);
-	if(res != CURLE_OK) {
-		JANUS_LOG(LOG_ERR, "Couldn't send the request: %s\n", curl_easy_strerror(res));
-		g_free(data.buffer);
-		curl_easy_cleanup(curl);
+	curl_easy_setopt(curl, CURLOPT_PRIVATE, (void *)p);
+	/* Track the request and hand it to the loop: the loop owns a reference */
+	p->started = janus_get_monotonic_time();
+	g_hash_table_insert(pending, p->user, p);
+	janus_refcount_increase(&p->ref);
+	stats_requests++;
+	g_async_queue_push(requests, p);
+#if LIBCURL_VERSION_NUM >= 0x074400
+	curl_multi_wakeup(multi);
+#endif
+	return p;
+}
+
+janus_turnrest_response *janus_turnrest_request(const char *user) {
+	janus_mutex_lock(&api_mutex);
+	if(api_server == NULL || !g_atomic_int_get(&turnrest_running)) {
+		janus_mutex_unlock(&api_mutex);
 		return NULL;
 	}
-	/* Cleanup the libcurl context */
-	curl_easy_cleanup(curl);
-	/* Process the response */
-	JANUS_LOG(LOG_VERB, "Got %zu bytes from the TURN REST API server\n", data.size);
-	JANUS_LOG(LOG_VERB, "%s\n", data.buffer);
+	gint64 deadline = janus_get_monotonic_time() + (gint64)api_timeout*G_USEC_PER_SEC;
+	janus_mutex_lock(&cache_mutex);
+	if(cache_username != NULL)
+		user = cache_username;
+	const char *key = user ? user : "";
+	/* Any valid credentials we can reuse? */
+	if(cache_refresh > 0) {
+		janus_turnrest_cached *cached = g_hash_table_lookup(cache, key);
+		gint64 now = janus_get_monotonic_time();
+		if(cached != NULL && now < cached->expires_at) {
+			stats_hits++;
+			janus_turnrest_response *response = janus_turnrest_response_copy(cached->response);
+			response->ttl = (cached->expires_at - now)/G_USEC_PER_SEC;
+			/* If we're getting close to the refresh time, or past it already,
+			 * fetch new credentials in the background: until they arrive we
+			 * keep on serving these, since they're still valid, so that
+			 * callers never have to wait for the backend */
+			if(now >= cached->refresh_at)
+				stats_stale++;
+			if(now >= cached->refresh_at - (cached->refresh_at - cached->fetched)/4 &&
+					g_hash_table_lookup(pending, key) == NULL) {
+				janus_turnrest_pending *p = janus_turnrest_pending_create(user);
+				if(p != NULL)
+					janus_refcount_decrease(&p->ref);
+			}
+			janus_mutex_unlock(&cache_mutex);
+			janus_mutex_unlock(&api_mutex);
+			return response;
+		}
+	}
+	stats_misses++;
+	/* Is there a request for the same credentials in flight already? */
+	janus_turnrest_pending *p = g_hash_table_lookup(pending, key);
+	if(p != NULL) {
+		stats_coalesced++;
+		janus_refcount_increase(&p->ref);
+	} else {
+		p = janus_turnrest_pending_create(user);
+	}
+	janus_mutex_unlock(&api_mutex);
+	if(p == NULL) {
+		stats_failures++;
+		janus_mutex_unlock(&cache_mutex);
+		return NULL;
+	}
+	/* Wait for the loop to complete the request */
+	while(!p->done && janus_get_monotonic_time() < deadline) {
+		janus_condition_wait_until(&p->cond, &cache_mutex, deadline);
+	}
+	janus_turnrest_response *response = p->done ? janus_turnrest_response_copy(p->response) : NULL;
+	janus_mutex_unlock(&cache_mutex);
+	if(!p->done)
+		JANUS_LOG(LOG_ERR, "Timeout waiting for the TURN REST API backend\n");
+	janus_refcount_decrease(&p->ref);
+	return response;
+}
+
+/* Mark a request as completed, caching the credentials if needed, and wake up
+ * whoever was waiting for them: must be called with the cache mutex locked */
+static void janus_turnrest_complete(janus_turnrest_pending *p, janus_turnrest_response *response) {
+	gint64 now = janus_get_monotonic_time();
+	stats_latency_last = now - p->started;
+	stats_latency_total += stats_latency_last;
+	if(response == NULL)
+		stats_failures++;
+	if(response != NULL && response->ttl > 0 && cache_refresh > 0 && cache != NULL) {
+		janus_turnrest_cached *cached = g_malloc(sizeof(janus_turnrest_cached));
+		cached->response = janus_turnrest_response_copy(response);
+		cached->fetched = now;
+		cached->refresh_at = now + ((gint64)response->ttl*G_USEC_PER_SEC/100)*cache_refresh;
+		cached->expires_at = now + (gint64)response->ttl*G_USEC_PER_SEC;
+		g_hash_table_insert(cache, g_strdup(p->user), cached);
+	}
+	if(pending != NULL && g_hash_table_lookup(pending, p->user) == p)
+		g_hash_table_remove(pending, p->user);
+	p->response = response;
+	p->done = TRUE;
+	janus_condition_broadcast(&p->cond);
+}
+
+/* Thread taking care of all the requests */
+static void *janus_turnrest_thread(void *data) {
+	JANUS_LOG(LOG_VERB, "Joining TURN REST API thread\n");
+	GList *active = NULL;
+	int running = 0;
+	while(g_atomic_int_get(&turnrest_running)) {
+		/* Add any new request to the multi handle */
+		janus_turnrest_pending *p = NULL;
+		while((p = g_async_queue_try_pop(requests)) != NULL) {
+			if(p == &exit_request)
+				break;
+			curl_multi_add_handle(multi, p->curl);
+			active = g_list_prepend(active, p);
+		}
+		if(p == &exit_request)
+			break;
+		curl_multi_perform(multi, &running);
+		/* Check which transfers completed */
+		CURLMsg *msg = NULL;
+		int left = 0;
+		while((msg = curl_multi_info_read(multi, &left)) != NULL) {
+			if(msg->msg != CURLMSG_DONE)
+				continue;
+			CURL *curl = msg->easy_handle;
+			CURLcode res = msg->data.result;
+			p = NULL;
+			curl_easy_getinfo(curl, CURLINFO_PRIVATE, (char **)&p);
+			curl_multi_remove_handle(multi, curl);
+			if(p == NULL)
+				continue;
+			active = g_list_remove(active, p);
+			janus_turnrest_response *response = NULL;
+			if(res != CURLE_OK) {
+				JANUS_LOG(LOG_ERR, "Couldn't send the request: %s\n", curl_easy_strerror(res));
+			} else {
+				JANUS_LOG(LOG_VERB, "Got %zu bytes from the TURN REST API server\n", p->data.size);
+				JANUS_LOG(LOG_VERB, "%s\n", p->data.buffer);
+				response = janus_turnrest_parse(p->data.buffer);
+			}
+			janus_mutex_lock(&cache_mutex);
+			janus_turnrest_complete(p, response);
+			janus_mutex_unlock(&cache_mutex);
+			janus_refcount_decrease(&p->ref);
+		}
+		/* Wait for something to happen */
+#if LIBCURL_VERSION_NUM >= 0x074400
+		curl_multi_poll(multi, NULL, 0, 1000, NULL);
+#else
+		if(running == 0) {
+			/* Nothing in flight, wait for a new request */
+			p = g_async_queue_timeout_pop(requests, G_USEC_PER_SEC);
+			if(p != NULL)
+				g_async_queue_push_front(requests, p);
+		} else {
+			curl_multi_wait(multi, NULL, 0, 50, NULL);
+		}
+#endif
+	}
+	/* Fail whatever was still in flight or queued */
+	janus_turnrest_pending *p = NULL;
+	while((p = g_async_queue_try_pop(requests)) != NULL) {
+		if(p != &exit_request)
+			active = g_list_prepend(active, p);
+	}
+	janus_mutex_lock(&cache_mutex);
+	while(active) {
+		p = (janus_turnrest_pending *)active->data;
+		curl_multi_remove_handle(multi, p->curl);
+		janus_turnrest_complete(p, NULL);
+		janus_refcount_decrease(&p->ref);
+		active = g_list_delete_link(active, active);
+	}
+	janus_mutex_unlock(&cache_mutex);
+	JANUS_LOG(LOG_VERB, "Leaving TURN REST API thread\n");
+	return NULL;
+}
+
+/* Parse a response from the TURN REST API backend */
+static janus_turnrest_response *janus_turnrest_parse(const char *payload) {
 	json_error_t error;
-	json_t *root = json_loads(data.buffer, 0, &error);
+	json_t *root = json_loads(payload, 0, &error);
 	if(!root) {
 		JANUS_LOG(LOG_ERR, "Couldn't parse response: error on line %d: %s", error.line, error.text);
-		g_free(data.buffer);
 		return NULL;
 	}
-	g_free(data.buffer);
 	json_t *username = json_object_get(root, "username");
 	if(!username) {
 		JANUS_LOG(LOG_ERR, "Invalid response: missing username\n");
+		json_decref(root);
 		return NULL;
 	}
 	if(!json_is_string(username)) {
 		JANUS_LOG(LOG_ERR, "Invalid response: username should be a string\n");
+		json_decref(root);
 		return NULL;
 	}
 	json_t *password = json_object_get(root, "password");
 	if(!password) {
 		JANUS_LOG(LOG_ERR, "Invalid response: missing password\n");
+		json_decref(root);
 		return NULL;
 	}
 	if(!json_is_string(password)) {
 		JANUS_LOG(LOG_ERR, "Invalid response: password should be a string\n");
+		json_decref(root);
 		return NULL;
 	}
 	json_t *ttl = json_object_get(root, "ttl");
 	if(ttl && (!json_is_integer(ttl) || json_integer_value(ttl) < 0)) {
 		JANUS_LOG(LOG_ERR, "Invalid response: ttl should be a positive integer\n");
+		json_decref(root);
 		return NULL;
 	}
 	json_t *uris = json_object_get(root, "uris");
 	if(!uris) {
 		JANUS_LOG(LOG_ERR, "Invalid response: missing uris\n");
+		json_decref(root);
 		return NULL;
 	}
 	if(!json_is_array(uris) || json_array_size(uris) == 0) {
 		JANUS_LOG(LOG_ERR, "Invalid response: uris should be a non-empty array\n");
+		json_decref(root);
 		return NULL;
 	}
 	/* Turn the response into a janus_turnrest_response object we can use */
@@ -294,8 +628,10 @@ janus_turnrest_response *janus_turnrest_request(const char *user) {
 	if(response->servers == NULL) {
 		JANUS_LOG(LOG_ERR, "Couldn't find any valid TURN URI in the response...\n");
 		janus_turnrest_response_destroy(response);
+		json_decref(root);
 		return NULL;
 	}
+	json_decref(root);
 	/* Done */
 	return response;
 }
@@ -19,6 +19,7 @@
 #ifdef HAVE_TURNRESTAPI
 
 #include <glib.h>
+#include <jansson.h>
 
 /*! \brief Initialize the TURN REST API client stack */
 void janus_turnrest_init(void);
@@ -37,6 +38,20 @@ void janus_turnrest_set_backend(const char *server, const char *key, const char
 /*! \brief Get the currently set TURN REST API backend
  * @returns The currently set TURN REST API backend */
 const char *janus_turnrest_get_backend(void);
+/*! \brief Configure the credentials cache
+ * @note Credentials are cached per username and shared by all the handles
+ * using the same username, until the specified percentage of their TTL has
+ * elapsed: after that, they're still returned until they expire, while new
+ * ones are fetched in the background. Responses with no TTL are never cached. Setting a fixed username
+ * means the same credentials will be shared by all handles.
+ * @param refresh Percentage of the TTL after which cached credentials are
+ * refreshed (pass 0 to disable the cache)
+ * @param username Username to use in all requests, instead of the one
+ * provided by the core (pass NULL to use the one provided by the core) */
+void janus_turnrest_set_cache(guint refresh, const char *username);
+/*! \brief Get statistics on the TURN REST API client (cache hits and misses, latency, etc.)
+ * @returns A JSON object with the statistics */
+json_t *janus_turnrest_get_stats(void);
 
 
 /*! \brief Complete response from the TURN REST API service */
@@ -63,10 +78,20 @@ typedef struct janus_turnrest_instance {
 /*! \brief De-allocate a janus_turnrest_response instance
  * @param response The janus_turnrest_response instance to destroy */
 void janus_turnrest_response_destroy(janus_turnrest_response *response);
+/*! \brief Duplicate a janus_turnrest_response instance
+ * @param response The janus_turnrest_response instance to copy
+ * @returns A new janus_turnrest_response instance */
+janus_turnrest_response *janus_turnrest_response_copy(janus_turnrest_response *response);
 
 
 /*! \brief Retrieve address and credentials for one or more TURN servers
- * @note Use janus_turnrest_response_destroy to get rid of the response, once done
+ * @note Cached credentials that haven't expired yet are returned right away,
+ * even when they're being refreshed; otherwise the request is queued to the
+ * TURN REST API thread (or joins an identical request already in flight),
+ * and the method blocks until its completion, up to the configured timeout:
+ * this only happens the first time credentials for a username are needed,
+ * when caching is disabled, or when the backend failed to refresh them
+ * before they expired. Use janus_turnrest_response_destroy to get rid of the response, once done
  * @param[in] user Username to provide in the TURN REST API request
  * @returns A valid janus_turnrest_response instance, if successful, NULL otherwise */
 janus_turnrest_response *janus_turnrest_request(const char *user);
@@ -9,6 +9,14 @@
  * \ref core
  */
 
+#ifdef __linux__
+/* Needed for CPU affinity */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <pthread.h>
+#include <sched.h>
+#endif
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
@@ -1475,3 +1483,22 @@ size_t janus_gzip_compress(int compression, char *text, size_t tlen, char *compr
 	return zs.total_out;
 }
 #endif
+
+int janus_thread_set_cpu_affinity(int cpu) {
+	if(cpu < 0)
+		return -1;
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	int res = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	if(res != 0) {
+		JANUS_LOG(LOG_WARN, "Couldn't pin thread to CPU %d: %d (%s)\n", cpu, res, g_strerror(res));
+		return -2;
+	}
+	return 0;
+#else
+	JANUS_LOG(LOG_WARN, "CPU affinity not supported on this platform\n");
+	return -3;
+#endif
+}
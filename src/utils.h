@@ -512,4 +512,10 @@ uint32_t janus_bitstream_getbits(uint8_t *base, uint8_t num, uint32_t *offset);
  */
 size_t janus_gzip_compress(int compression, char *text, size_t tlen, char *compressed, size_t zlen);
 
+/*! \brief Helper method to pin the calling thread to a specific CPU
+ * \note Only supported on Linux: on other platforms this does nothing, and returns an error
+ * @param[in] cpu The CPU to pin the thread to
+ * @returns 0 in case of success, a negative integer otherwise */
+int janus_thread_set_cpu_affinity(int cpu);
+
 #endif